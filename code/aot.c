@@ -0,0 +1,946 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_DRIVER
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "aot.h"
+#include "aot_runtime.h"
+#include "builtin.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "resolver.h"
+#include "runner.h"
+#include "util.h"
+
+// NOTE(HS): set by the build to the headers and runtime library of the same build
+#ifndef TYGER_AOT_INCLUDE_DIR
+#define TYGER_AOT_INCLUDE_DIR "includes"
+#endif
+#ifndef TYGER_AOT_RUNTIME_LIB
+#define TYGER_AOT_RUNTIME_LIB "libtyger_runtime.a"
+#endif
+#ifndef TYGER_AOT_C_FLAGS
+#define TYGER_AOT_C_FLAGS ""
+#endif
+
+/// most words `Aot_Options.flags` can be split into
+#define AOT_MAX_FLAGS 32
+
+/// a function of the program being generated, `code` is its C definition once its
+/// body has been generated
+typedef struct aot_function
+{
+  /// NULL for the script
+  const Func_Expression *fexpr;
+  const char *code;
+  size_t max_stack;
+} Aot_Function;
+
+typedef struct aot_function_vaarray
+{
+  Aot_Function *elems;
+  size_t capacity;
+  size_t len;
+} Aot_Function_VaArray;
+
+typedef struct aot_constant
+{
+  Aot_Constant_Kind kind;
+  char *chars;
+  size_t len;
+} Aot_Constant;
+
+typedef struct aot_constant_vaarray
+{
+  Aot_Constant *elems;
+  size_t capacity;
+  size_t len;
+} Aot_Constant_VaArray;
+
+typedef struct aot_generator
+{
+  const Program *program;
+  const char *source;
+  Aot_Function_VaArray functions;
+  Aot_Constant_VaArray constants;
+  size_t global_count;
+} Aot_Generator;
+
+/// the body of one function being generated, `depth` is the stack depth the bytecode
+/// compiler would have at the same point
+typedef struct aot_emitter
+{
+  Aot_Generator *g;
+  String_Builder sb;
+  size_t depth;
+  size_t max_stack;
+  size_t indent;
+} Aot_Emitter;
+
+static const char *AOT_BUILTIN_IDS[BUILTIN_COUNT] = {
+#define X(ID, NAME, ARITY, PURE) "BUILTIN_" #ID,
+  #include "defs/builtin.def"
+#undef X
+};
+
+static void aot_gen_statement(Aot_Emitter *e, const Statement *stmt);
+static void aot_gen_expression(Aot_Emitter *e, const Expression *expr);
+static size_t aot_gen_function(Aot_Generator *g, const Func_Expression *fexpr);
+
+///
+/// internal functions
+///
+
+static void aot_report_error(const char *source_name, const char *source, const Tyger_Error *err)
+{
+  Location location = location_from_pos(source, err->location.pos);
+  fprintf(
+    stderr, "%s:%zu:%zu: [ERROR] %s: %s\n",
+    source_name, location.line + 1, location.col + 1,
+    tyger_error_kind_to_string(err->kind), err->message ? err->message : "syntax error"
+  );
+}
+
+/// appends `chars` as a C string literal, broken after each newline
+static void aot_append_c_string(String_Builder *sb, const char *chars, size_t len)
+{
+  string_builder_append(sb, "\"");
+  for (size_t i = 0; i < len; ++i)
+  {
+    unsigned char ch = (unsigned char) chars[i];
+    switch (ch)
+    {
+    case '"':  { string_builder_append(sb, "\\\""); } break;
+    case '\\': { string_builder_append(sb, "\\\\"); } break;
+    case '\t': { string_builder_append(sb, "\\t"); } break;
+    case '\r': { string_builder_append(sb, "\\r"); } break;
+
+    // NOTE(HS): escaped so two in a row can't make a trigraph
+    case '?':  { string_builder_append(sb, "\\?"); } break;
+
+    case '\n':
+    {
+      string_builder_append(sb, i + 1 < len ? "\\n\"\n  \"" : "\\n");
+    } break;
+
+    default:
+    {
+      if (ch >= 0x20 && ch < 0x7f)
+      {
+        char printable[2] = { (char) ch, '\0' };
+        string_builder_append(sb, printable);
+      }
+      else
+      {
+        string_builder_append_fmt(sb, "\\%03o", ch);
+      }
+    } break;
+    }
+  }
+  string_builder_append(sb, "\"");
+}
+
+static void aot_emit(Aot_Emitter *e, const char *fmt, ...)
+{
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+
+  string_builder_append_fmt(&e->sb, "%*s%s\n", (int) (e->indent * 2), "", line);
+}
+
+static void aot_set_depth(Aot_Emitter *e, size_t depth)
+{
+  e->depth = depth;
+  if (e->depth > e->max_stack)
+  {
+    e->max_stack = e->depth;
+  }
+}
+
+/// the slot the next value pushed goes into
+static size_t aot_push(Aot_Emitter *e)
+{
+  size_t slot = e->depth;
+  aot_set_depth(e, e->depth + 1);
+  return slot;
+}
+
+static size_t aot_add_constant(Aot_Generator *g, Aot_Constant_Kind kind, char *chars, size_t len)
+{
+  Aot_Constant constant = { .kind = kind, .chars = chars, .len = len };
+  va_array_append(g->constants, constant);
+  return g->constants.len - 1;
+}
+
+/// NOTE(HS): expands escapes the same way as the bytecode compiler
+static size_t aot_add_string(Aot_Generator *g, const char *literal, size_t len)
+{
+  char *chars = tmalloc(len + 1);
+  assert(chars);
+
+  size_t out = 0;
+  for (size_t i = 0; i < len; ++i)
+  {
+    char ch = literal[i];
+    if (ch == '\\' && i + 1 < len)
+    {
+      i += 1;
+      switch (literal[i])
+      {
+      case 'n':  { ch = '\n'; } break;
+      case 't':  { ch = '\t'; } break;
+      case 'r':  { ch = '\r'; } break;
+      case '0':  { ch = '\0'; } break;
+      default:   { ch = literal[i]; } break;
+      }
+    }
+    chars[out++] = ch;
+  }
+
+  return aot_add_constant(g, AOT_CONST_STRING, chars, out);
+}
+
+static inline const Expression *aot_expression(const Aot_Emitter *e, Expression_Handle hndl)
+{
+  const Expression *expr = expression_handle_to_expression(e->g->program, hndl);
+  assert(expr);
+  return expr;
+}
+
+static inline const Statement *aot_statement(const Aot_Emitter *e, Statement_Handle hndl)
+{
+  const Statement *stmt = statement_handle_to_statement(e->g->program, hndl);
+  assert(stmt);
+  return stmt;
+}
+
+static void aot_use_global(Aot_Emitter *e, size_t slot)
+{
+  if (slot + 1 > e->g->global_count)
+  {
+    e->g->global_count = slot + 1;
+  }
+}
+
+static void aot_gen_store(Aot_Emitter *e, const Binding *binding, size_t value)
+{
+  switch (binding->kind)
+  {
+  case BINDING_GLOBAL:
+  {
+    aot_use_global(e, binding->slot);
+    aot_emit(e, "AOT_STORE_GLOBAL(%zu, %zu);", binding->slot, value);
+  } break;
+
+  case BINDING_LOCAL:   { aot_emit(e, "AOT_STORE_LOCAL(%zu, %zu);", binding->slot, value); } break;
+  case BINDING_UPVALUE: { aot_emit(e, "AOT_STORE_UPVALUE(%zu, %zu);", binding->slot, value); } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Cannot store to binding %s\n", binding_kind_to_string(binding->kind));
+    assert(0);
+  } break;
+  }
+}
+
+/// runs the statement in a C block of its own
+static void aot_gen_nested_statement(Aot_Emitter *e, const Statement *stmt)
+{
+  aot_emit(e, "{");
+  e->indent += 1;
+  aot_gen_statement(e, stmt);
+  e->indent -= 1;
+  aot_emit(e, "}");
+}
+
+static void aot_gen_block_statement(Aot_Emitter *e, const Block_Statement *bs)
+{
+  size_t locals = 0;
+  for (size_t i = 0; i < bs->len; ++i)
+  {
+    const Statement *inner = aot_statement(e, bs->first + i);
+    aot_gen_statement(e, inner);
+    if (inner->kind == STMT_VAR && inner->statement.var_statement.binding.kind == BINDING_LOCAL)
+    {
+      locals += 1;
+    }
+  }
+
+  aot_set_depth(e, e->depth - locals);
+  if (locals > 0 && bs->captures)
+  {
+    aot_emit(e, "AOT_CLOSE_UPVALUES(%zu);", e->depth);
+  }
+}
+
+/// when `tail` the call replaces the running call, returns whether it did (calls to
+/// builtins never do)
+static bool aot_gen_call_expression(Aot_Emitter *e, const Expression *expr, bool tail)
+{
+  const Call_Expression *cexpr = &expr->expression.call_expression;
+  const Expression *function = aot_expression(e, cexpr->function);
+  size_t argc = cexpr->args_len;
+
+  const Binding *binding = NULL;
+  if (function->kind == EXPR_IDENT)
+  {
+    binding = &function->expression.ident_expression.binding;
+  }
+  bool is_builtin = binding && binding->kind == BINDING_BUILTIN;
+  bool is_global = binding && binding->kind == BINDING_GLOBAL;
+
+  // NOTE(HS): a global callee is read once the arguments have been evaluated, as the
+  // interpreter does, but still goes in the slot below them
+  size_t callee = e->depth;
+  if (is_global)
+  {
+    aot_push(e);
+  }
+  else if (!is_builtin)
+  {
+    aot_gen_expression(e, function);
+  }
+
+  for (size_t i = 0; i < argc; ++i)
+  {
+    aot_gen_expression(e, aot_expression(e, cexpr->args_first + i));
+  }
+  size_t pos = expr->location.pos;
+
+  if (is_builtin)
+  {
+    aot_emit(
+      e, "AOT_CALL_NATIVE(%s, %zu, %zu, %zu);", AOT_BUILTIN_IDS[binding->slot], callee, argc, pos
+    );
+    aot_set_depth(e, callee + 1);
+    return false;
+  }
+
+  if (is_global)
+  {
+    aot_use_global(e, binding->slot);
+    aot_emit(e, "AOT_LOAD_GLOBAL(%zu, %zu);", callee, binding->slot);
+  }
+  aot_emit(e, "%s(%zu, %zu, %zu);", tail ? "AOT_TAIL_CALL" : "AOT_CALL", callee, argc, pos);
+  aot_set_depth(e, callee + 1);
+  return tail;
+}
+
+static void aot_gen_statement(Aot_Emitter *e, const Statement *stmt)
+{
+  switch (stmt->kind)
+  {
+  case STMT_VAR:
+  {
+    const Var_Statement *vs = &stmt->statement.var_statement;
+    aot_gen_expression(e, aot_expression(e, vs->expression_handle));
+
+    // NOTE(HS): locals live in the stack slot their initialiser was evaluated into
+    if (vs->binding.kind == BINDING_GLOBAL)
+    {
+      aot_set_depth(e, e->depth - 1);
+      aot_gen_store(e, &vs->binding, e->depth);
+    }
+  } break;
+
+  case STMT_EXPRESSION:
+  {
+    Expression_Handle hndl = stmt->statement.expression_statement.expression_handle;
+    aot_gen_expression(e, aot_expression(e, hndl));
+    aot_set_depth(e, e->depth - 1);
+  } break;
+
+  case STMT_BLOCK:
+  {
+    aot_gen_block_statement(e, &stmt->statement.block_statement);
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    aot_gen_expression(e, aot_expression(e, as->expression_handle));
+    aot_set_depth(e, e->depth - 1);
+    aot_gen_store(e, &as->binding, e->depth);
+  } break;
+
+  case STMT_IF:
+  {
+    const If_Statement *is = &stmt->statement.if_statement;
+    aot_gen_expression(e, aot_expression(e, is->condition));
+    aot_set_depth(e, e->depth - 1);
+
+    aot_emit(e, "if (value_is_truthy(s[%zu]))", e->depth);
+    aot_gen_nested_statement(e, aot_statement(e, is->consequence));
+    if (is->has_alternative)
+    {
+      aot_emit(e, "else");
+      aot_gen_nested_statement(e, aot_statement(e, is->alternative));
+    }
+  } break;
+
+  case STMT_WHILE:
+  {
+    const While_Statement *ws = &stmt->statement.while_statement;
+    aot_emit(e, "for (;;)");
+    aot_emit(e, "{");
+    e->indent += 1;
+
+    aot_gen_expression(e, aot_expression(e, ws->condition));
+    aot_set_depth(e, e->depth - 1);
+    aot_emit(e, "if (!value_is_truthy(s[%zu]))", e->depth);
+    aot_emit(e, "{");
+    aot_emit(e, "  break;");
+    aot_emit(e, "}");
+    aot_gen_statement(e, aot_statement(e, ws->body));
+
+    e->indent -= 1;
+    aot_emit(e, "}");
+  } break;
+
+  case STMT_RETURN:
+  {
+    // NOTE(HS): `return f(...)` is a tail call, unless `f` is a builtin
+    const Return_Statement *rs = &stmt->statement.return_statement;
+    const Expression *value = rs->has_value ? aot_expression(e, rs->expression_handle) : NULL;
+    size_t depth = e->depth;
+    if (value && value->kind == EXPR_CALL)
+    {
+      if (aot_gen_call_expression(e, value, true))
+      {
+        aot_set_depth(e, depth);
+        break;
+      }
+    }
+    else if (value)
+    {
+      aot_gen_expression(e, value);
+    }
+    else
+    {
+      aot_emit(e, "s[%zu] = make_nil_value();", aot_push(e));
+    }
+    aot_emit(e, "AOT_RETURN(%zu);", depth);
+    aot_set_depth(e, depth);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Statement_Kind %s (%i)\n",
+      statement_kind_to_string(stmt->kind), stmt->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+static const char *aot_infix_operation(Operator op)
+{
+  const char *result = "AOT_ADD";
+  switch (op)
+  {
+  case OP_PLUS:     { result = "AOT_ADD"; } break;
+  case OP_MINUS:    { result = "AOT_SUB"; } break;
+  case OP_ASTERISK: { result = "AOT_MUL"; } break;
+  case OP_SLASH:    { result = "AOT_DIV"; } break;
+  case OP_EQ:       { result = "AOT_EQ"; } break;
+  case OP_NOT_EQ:   { result = "AOT_NOT_EQ"; } break;
+  case OP_LT:       { result = "AOT_LT"; } break;
+  case OP_GT:       { result = "AOT_GT"; } break;
+  case OP_LTE:      { result = "AOT_LTE"; } break;
+  case OP_GTE:      { result = "AOT_GTE"; } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid infix operator %s\n", operator_to_string(op));
+    assert(0);
+  } break;
+  }
+  return result;
+}
+
+static void aot_gen_expression(Aot_Emitter *e, const Expression *expr)
+{
+  switch (expr->kind)
+  {
+  case EXPR_INT:
+  {
+    const Int_Expression *iexpr = &expr->expression.int_expression;
+    if (iexpr->is_big)
+    {
+      const char *digits = string_handle_to_cstring(e->g->program, iexpr->digits_handle);
+      size_t len = strlen(digits);
+      char *chars = tmalloc(len + 1);
+      assert(chars);
+      memcpy(chars, digits, len + 1);
+      size_t index = aot_add_constant(e->g, AOT_CONST_BIGINT, chars, len);
+      aot_emit(e, "s[%zu] = aot->constants[%zu];", aot_push(e), index);
+    }
+    else
+    {
+      aot_emit(e, "s[%zu] = make_int_value(INT64_C(%" PRId64 "));", aot_push(e), iexpr->value);
+    }
+  } break;
+
+  case EXPR_STRING:
+  {
+    const String_Expression *sexpr = &expr->expression.string_expression;
+    const char *literal = string_handle_to_cstring(e->g->program, sexpr->string_handle);
+    size_t index = aot_add_string(e->g, literal, sexpr->len);
+    aot_emit(e, "s[%zu] = aot->constants[%zu];", aot_push(e), index);
+  } break;
+
+  case EXPR_BOOL:
+  {
+    bool value = expr->expression.bool_expression.value;
+    aot_emit(e, "s[%zu] = make_bool_value(%s);", aot_push(e), value ? "true" : "false");
+  } break;
+
+  case EXPR_IDENT:
+  {
+    const Binding *binding = &expr->expression.ident_expression.binding;
+    switch (binding->kind)
+    {
+    case BINDING_GLOBAL:
+    {
+      aot_use_global(e, binding->slot);
+      aot_emit(e, "AOT_LOAD_GLOBAL(%zu, %zu);", aot_push(e), binding->slot);
+    } break;
+
+    case BINDING_LOCAL:   { aot_emit(e, "AOT_LOAD_LOCAL(%zu, %zu);", aot_push(e), binding->slot); } break;
+    case BINDING_UPVALUE: { aot_emit(e, "AOT_LOAD_UPVALUE(%zu, %zu);", aot_push(e), binding->slot); } break;
+
+    default:
+    {
+      // NOTE(HS): builtins used as values are rejected by the bytecode compiler first
+      fprintf(stderr, "[ERROR] Unresolved identifier reached the C generator\n");
+      assert(0);
+    } break;
+    }
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+    aot_gen_expression(e, aot_expression(e, pexpr->rhs));
+    if (pexpr->op == OP_MINUS)
+    {
+      aot_emit(e, "AOT_NEGATE(%zu, %zu);", e->depth - 1, expr->location.pos);
+    }
+    else
+    {
+      aot_emit(e, "AOT_NOT(%zu);", e->depth - 1);
+    }
+  } break;
+
+  case EXPR_INFIX:
+  {
+    const Infix_Expression *iexpr = &expr->expression.infix_expression;
+    aot_gen_expression(e, aot_expression(e, iexpr->lhs));
+    aot_gen_expression(e, aot_expression(e, iexpr->rhs));
+    aot_set_depth(e, e->depth - 1);
+    aot_emit(
+      e, "%s(%zu, %zu);", aot_infix_operation(iexpr->op), e->depth - 1, expr->location.pos
+    );
+  } break;
+
+  case EXPR_CALL:
+  {
+    aot_gen_call_expression(e, expr, false);
+  } break;
+
+  case EXPR_FUNC:
+  {
+    const Func_Expression *fexpr = &expr->expression.func_expression;
+    size_t index = aot_gen_function(e->g, fexpr);
+    aot_emit(
+      e, "%s(%zu, %zu);", fexpr->upvalues_len > 0 ? "AOT_CLOSURE" : "AOT_LOAD_FUNCTION",
+      aot_push(e), index
+    );
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Expression_Kind %s (%i)\n",
+      expression_kind_to_string(expr->kind), expr->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+/// starts the C function for `fexpr` (the script when NULL), returning its index
+static size_t aot_begin_function(Aot_Generator *g, const Func_Expression *fexpr, Aot_Emitter *e)
+{
+  Aot_Function function = { .fexpr = fexpr, .code = NULL, .max_stack = 0 };
+  va_array_append(g->functions, function);
+  size_t index = g->functions.len - 1;
+
+  size_t arity = fexpr ? fexpr->params_len : 0;
+  *e = (Aot_Emitter) { .g = g, .depth = arity, .max_stack = arity, .indent = 0 };
+  string_builder_init(&e->sb);
+
+  aot_emit(e, "static bool tyger_function_%zu(Aot *aot, size_t slots, Obj_Upvalue **upvalues)", index);
+  aot_emit(e, "{");
+  e->indent += 1;
+  aot_emit(e, "Value *s = aot->vm.stack + slots;");
+  aot_emit(e, "(void) upvalues;");
+  return index;
+}
+
+/// returns `nil` from the end of the body, as every function does
+static void aot_end_function(Aot_Emitter *e, size_t index)
+{
+  size_t result = aot_push(e);
+  aot_emit(e, "s[%zu] = make_nil_value();", result);
+  aot_emit(e, "AOT_RETURN(%zu);", result);
+  e->indent -= 1;
+  aot_emit(e, "}");
+
+  Aot_Function *function = &e->g->functions.elems[index];
+  function->code = string_builder_to_cstring(&e->sb);
+  function->max_stack = e->max_stack;
+  string_builder_free(&e->sb);
+}
+
+static size_t aot_gen_function(Aot_Generator *g, const Func_Expression *fexpr)
+{
+  Aot_Emitter e;
+  size_t index = aot_begin_function(g, fexpr, &e);
+  aot_gen_statement(&e, statement_handle_to_statement(g->program, fexpr->body));
+  aot_end_function(&e, index);
+  return index;
+}
+
+static void aot_gen_tables(const Aot_Generator *g, const char *source_name, String_Builder *out)
+{
+  for (size_t i = 0; i < g->functions.len; ++i)
+  {
+    const Func_Expression *fexpr = g->functions.elems[i].fexpr;
+    if (!fexpr || fexpr->upvalues_len == 0)
+    {
+      continue;
+    }
+
+    string_builder_append_fmt(out, "static const Upvalue_Desc UPVALUES_%zu[] = {\n", i);
+    for (size_t j = 0; j < fexpr->upvalues_len; ++j)
+    {
+      Func_Upvalue upvalue = func_expression_upvalue(g->program, fexpr, j);
+      string_builder_append_fmt(
+        out, "  { %s, %zu },\n", upvalue.is_local ? "true" : "false", upvalue.index
+      );
+    }
+    string_builder_append(out, "};\n\n");
+  }
+
+  string_builder_append(out, "static const Aot_Function_Desc FUNCTIONS[] = {\n");
+  for (size_t i = 0; i < g->functions.len; ++i)
+  {
+    const Aot_Function *function = &g->functions.elems[i];
+    const Func_Expression *fexpr = function->fexpr;
+    string_builder_append_fmt(out, "  { tyger_function_%zu, ", i);
+    if (fexpr && fexpr->name != FUNC_ANONYMOUS)
+    {
+      string_builder_append_fmt(out, "\"%s\", ", ident_handle_to_ident(g->program, fexpr->name));
+    }
+    else
+    {
+      string_builder_append(out, "NULL, ");
+    }
+    string_builder_append_fmt(
+      out, "%zu, %zu, %s, ", fexpr ? fexpr->params_len : 0, function->max_stack,
+      fexpr && fexpr->memo ? "true" : "false"
+    );
+    if (fexpr && fexpr->upvalues_len > 0)
+    {
+      string_builder_append_fmt(out, "UPVALUES_%zu, %zu },\n", i, fexpr->upvalues_len);
+    }
+    else
+    {
+      string_builder_append(out, "NULL, 0 },\n");
+    }
+  }
+  string_builder_append(out, "};\n\n");
+
+  // NOTE(HS): C99 has no empty arrays, a program without constants gets a dummy one
+  string_builder_append(out, "static const Aot_Constant_Desc CONSTANTS[] = {\n");
+  for (size_t i = 0; i < g->constants.len; ++i)
+  {
+    const Aot_Constant *constant = &g->constants.elems[i];
+    string_builder_append_fmt(
+      out, "  { %s, ", constant->kind == AOT_CONST_STRING ? "AOT_CONST_STRING" : "AOT_CONST_BIGINT"
+    );
+    aot_append_c_string(out, constant->chars, constant->len);
+    string_builder_append_fmt(out, ", %zu },\n", constant->len);
+  }
+  if (g->constants.len == 0)
+  {
+    string_builder_append(out, "  { AOT_CONST_STRING, \"\", 0 },\n");
+  }
+  string_builder_append(out, "};\n\n");
+
+  string_builder_append(out, "static const Aot_Program PROGRAM = {\n  ");
+  aot_append_c_string(out, source_name, strlen(source_name));
+  string_builder_append_fmt(
+    out, ",\n  SOURCE,\n  FUNCTIONS, %zu,\n  CONSTANTS, %zu,\n  %zu,\n};\n\n",
+    g->functions.len, g->constants.len, g->global_count
+  );
+}
+
+/// runs `argv` (whose first element is the program) and waits for it, returns whether
+/// it exited successfully
+static bool aot_run_command(char *const *argv)
+{
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    return false;
+  }
+  if (pid == 0)
+  {
+    execvp(argv[0], argv);
+    fprintf(stderr, "[ERROR] Could not run %s\n", argv[0]);
+    _exit(127);
+  }
+
+  int status = 0;
+  if (waitpid(pid, &status, 0) < 0)
+  {
+    return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/// `path` without its extension, or with `.out` added when it has none
+static char *aot_default_output(const char *path)
+{
+  size_t len = strlen(path);
+  const char *slash = strrchr(path, '/');
+  const char *dot = strrchr(path, '.');
+  bool has_extension = dot && dot != path && (!slash || dot > slash + 1);
+
+  size_t stem = has_extension ? (size_t) (dot - path) : len;
+  char *output = tmalloc(stem + sizeof(".out"));
+  assert(output);
+  memcpy(output, path, stem);
+  strcpy(output + stem, has_extension ? "" : ".out");
+  return output;
+}
+
+/// whether `a` and `b` name the same existing file
+static bool aot_same_file(const char *a, const char *b)
+{
+  struct stat sa;
+  struct stat sb;
+  return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+/// writes `code` to `emit_c`, or when that's NULL to a new file in `$TMPDIR` (`/tmp`
+/// by default), leaving the path written in `c_path`. `*created` is whether a
+/// temporary file was made, which is then the caller's to remove.
+///
+/// NOTE(HS): the C only lives as long as the build unless asked for, so is never put
+/// where it could replace one of the user's files
+static bool aot_write_c(const char *emit_c, String_Builder *c_path, bool *created, const String_Builder *code)
+{
+  FILE *f = NULL;
+  *created = false;
+  if (emit_c)
+  {
+    string_builder_append(c_path, emit_c);
+    f = fopen(c_path->buffer, "wb");
+  }
+  else
+  {
+    const char *dir = getenv("TMPDIR");
+    string_builder_append(c_path, dir && dir[0] ? dir : "/tmp");
+    string_builder_append(c_path, "/tyger_build_XXXXXX");
+    int fd = mkstemp(c_path->buffer);
+    *created = fd >= 0;
+    f = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (fd >= 0 && !f)
+    {
+      close(fd);
+    }
+  }
+
+  bool ok = f && fwrite(code->buffer, 1, code->len, f) == code->len;
+  ok = f && fclose(f) == 0 && ok;
+  return ok;
+}
+
+
+///
+/// public functions
+///
+
+Aot_Options aot_default_options(void)
+{
+  const char *cc = getenv("CC");
+  Aot_Options options = {
+    .output = NULL,
+    .emit_c = NULL,
+    .cc = cc && cc[0] ? cc : "cc",
+    .include_dir = TYGER_AOT_INCLUDE_DIR,
+    .runtime_lib = TYGER_AOT_RUNTIME_LIB,
+    .flags = TYGER_AOT_C_FLAGS,
+  };
+  return options;
+}
+
+void aot_generate(const Program *prog, const char *source, const char *source_name, String_Builder *out)
+{
+  Aot_Generator g = { .program = prog, .source = source, .global_count = 0 };
+  va_array_init(Aot_Function, g.functions);
+  va_array_init(Aot_Constant, g.constants);
+
+  Aot_Emitter e;
+  size_t script = aot_begin_function(&g, NULL, &e);
+  for (size_t i = 0; i < prog->statements.len; ++i)
+  {
+    aot_gen_statement(&e, &prog->statements.elems[i]);
+  }
+  aot_end_function(&e, script);
+
+  string_builder_append(out, "// generated by `tyger build` from ");
+  string_builder_append(out, source_name);
+  string_builder_append(out, "\n#include \"aot_runtime.h\"\n\nstatic const char SOURCE[] =\n  ");
+  aot_append_c_string(out, source, strlen(source));
+  string_builder_append(out, ";\n\n");
+
+  for (size_t i = 0; i < g.functions.len; ++i)
+  {
+    string_builder_append(out, g.functions.elems[i].code);
+    string_builder_append(out, "\n");
+  }
+  aot_gen_tables(&g, source_name, out);
+  string_builder_append(out, "int main(void)\n{\n  return aot_main(&PROGRAM);\n}\n");
+
+  for (size_t i = 0; i < g.functions.len; ++i)
+  {
+    tfree((void*) g.functions.elems[i].code);
+  }
+  for (size_t i = 0; i < g.constants.len; ++i)
+  {
+    tfree(g.constants.elems[i].chars);
+  }
+  va_array_free(g.functions);
+  va_array_free(g.constants);
+}
+
+int aot_build_file(const char *path, Aot_Options options)
+{
+  char *source = read_entire_file(path);
+  if (!source)
+  {
+    fprintf(stderr, "[ERROR] Could not read file %s\n", path);
+    return 1;
+  }
+
+  Lexer lexer;
+  Parser parser;
+  lexer_init(&lexer, source);
+  parser_init(&parser, &lexer);
+
+  Program program = parser_parse_program(&parser);
+  Resolver resolver;
+  resolver_init(&resolver);
+  if (program.errors.len == 0)
+  {
+    resolver_resolve_program(&resolver, &program);
+  }
+
+  bool ok = program.errors.len == 0;
+  for (size_t i = 0; i < program.errors.len; ++i)
+  {
+    aot_report_error(path, source, &program.errors.elems[i]);
+  }
+
+  // NOTE(HS): the program is compiled to bytecode as well, for the errors the
+  // interpreter would report before running it
+  if (ok)
+  {
+    Chunk chunk;
+    chunk_init(&chunk);
+    Tyger_Error err = compiler_compile_program(&program, &chunk, compiler_default_options());
+    chunk_free(&chunk);
+    if (err.kind != TYERR_NONE)
+    {
+      aot_report_error(path, source, &err);
+      tyger_error_free(&err);
+      ok = false;
+    }
+  }
+
+  char *output = options.output ? NULL : aot_default_output(path);
+  const char *output_path = options.output ? options.output : output;
+  if (ok && ((options.emit_c && aot_same_file(options.emit_c, path)) || aot_same_file(output_path, path)))
+  {
+    fprintf(stderr, "[ERROR] Building %s would overwrite it\n", path);
+    ok = false;
+  }
+
+  String_Builder c_path;
+  string_builder_init(&c_path);
+  bool created = false;
+  if (ok)
+  {
+    String_Builder code;
+    string_builder_init(&code);
+    aot_generate(&program, source, path, &code);
+    ok = aot_write_c(options.emit_c, &c_path, &created, &code);
+    string_builder_free(&code);
+    if (!ok)
+    {
+      fprintf(stderr, "[ERROR] Could not write %s\n", c_path.buffer);
+    }
+  }
+
+  if (ok)
+  {
+    // NOTE(HS): a temporary file has no `.c` extension, so the language is given
+    char *argv[AOT_MAX_FLAGS + 13] = {
+      (char*) options.cc, "-std=c99", "-O2", "-I", (char*) options.include_dir,
+      "-o", (char*) output_path, "-x", "c", c_path.buffer, "-x", "none",
+      (char*) options.runtime_lib, "-lpthread",
+    };
+    size_t argc = 14;
+    const char *given = options.flags ? options.flags : "";
+    char *flags = tmalloc(strlen(given) + 1);
+    assert(flags);
+    memcpy(flags, given, strlen(given) + 1);
+    for (char *flag = strtok(flags, " "); flag && argc < AOT_MAX_FLAGS + 14; flag = strtok(NULL, " "))
+    {
+      argv[argc++] = flag;
+    }
+    argv[argc] = NULL;
+    ok = aot_run_command(argv);
+    tfree(flags);
+    if (!ok)
+    {
+      fprintf(stderr, "[ERROR] Could not compile %s with %s\n", c_path.buffer, options.cc);
+    }
+  }
+
+  // NOTE(HS): only the temporary file this build created is removed
+  if (created)
+  {
+    remove(c_path.buffer);
+  }
+
+  string_builder_free(&c_path);
+  tfree(output);
+  resolver_free(&resolver);
+  program_free(&program);
+  tfree(source);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,417 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aot_runtime.h"
+#include "tstrings.h"
+#include "tyger_error.h"
+
+/// room left on the C stack for builtins and the runtime once calls start failing
+#define AOT_STACK_MARGIN (256 * 1024)
+
+/// the smallest stack a program is run with, when a bigger one can't be had
+#define AOT_STACK_MIN (8 * 1024 * 1024)
+
+typedef struct aot_thread
+{
+  Aot *aot;
+  size_t stack_size;
+  bool ok;
+} Aot_Thread;
+
+///
+/// internal functions
+///
+
+/// sets `aot->err`, always returns false so runtime functions can return it
+static bool aot_error(Aot *aot, Tyger_Error_Kind kind, size_t pos, const char *fmt, ...)
+{
+  String_Builder sb;
+  string_builder_init(&sb);
+
+  va_list args;
+  va_start(args, fmt);
+  char message[256];
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  string_builder_append(&sb, message);
+
+  aot->err = (Tyger_Error) {
+    .kind = kind,
+    .location = { .pos = pos, .col = 0, .line = 0 },
+    .message = string_builder_to_cstring(&sb),
+  };
+  string_builder_free(&sb);
+  return false;
+}
+
+static bool aot_binary_type_error(Aot *aot, const char *op, Value lhs, Value rhs, size_t pos)
+{
+  return aot_error(
+    aot, TYERR_TYPE_MISMATCH, pos, "unsupported operand types for %s: %s and %s",
+    op, value_type_name(lhs), value_type_name(rhs)
+  );
+}
+
+static void aot_gc_safepoint(Aot *aot, const Value *sp)
+{
+  if (gc_should_step(&aot->vm.gc))
+  {
+    vm_gc_step(&aot->vm, sp);
+  }
+}
+
+/// whether the C stack is too deep for another call
+static bool aot_stack_exhausted(const Aot *aot)
+{
+  char here = 0;
+  return (uintptr_t) &here < aot->stack_limit;
+}
+
+static void aot_init(Aot *aot, const Aot_Program *program)
+{
+  vm_init(&aot->vm);
+  vm_ensure_globals(&aot->vm, program->global_count);
+  aot->program = program;
+  aot->objects = NULL;
+  aot->depth = 0;
+  aot->stack_limit = 0;
+  aot->tail_call = false;
+  aot->tail_argc = 0;
+  aot->tail_pos = 0;
+  aot->err = (Tyger_Error) {0};
+
+  aot->constants = tmalloc((program->constants_len + 1) * sizeof(Value));
+  assert(aot->constants);
+  for (size_t i = 0; i < program->constants_len; ++i)
+  {
+    const Aot_Constant_Desc *desc = &program->constants[i];
+    aot->constants[i] = desc->kind == AOT_CONST_STRING
+      ? value_string_new(&aot->objects, desc->chars, desc->len)
+      : bigint_from_decimal(&aot->objects, desc->chars, desc->len);
+  }
+
+  aot->functions = tmalloc(program->functions_len * sizeof(Obj_Function*));
+  assert(aot->functions);
+  for (size_t i = 0; i < program->functions_len; ++i)
+  {
+    const Aot_Function_Desc *desc = &program->functions[i];
+    Obj_String *name = desc->name
+      ? obj_string_new(&aot->objects, desc->name, strlen(desc->name))
+      : NULL;
+
+    Obj_Function *function = obj_function_new(&aot->objects, name, desc->arity);
+    function->chunk.max_stack = desc->max_stack;
+    function->memo = desc->memo;
+    function->native = desc->entry;
+    if (desc->upvalue_count > 0)
+    {
+      function->upvalue_count = desc->upvalue_count;
+      function->upvalues = tmalloc(desc->upvalue_count * sizeof(Upvalue_Desc));
+      assert(function->upvalues);
+      memcpy(function->upvalues, desc->upvalues, desc->upvalue_count * sizeof(Upvalue_Desc));
+    }
+    aot->functions[i] = function;
+  }
+}
+
+static void aot_free(Aot *aot)
+{
+  vm_free(&aot->vm);
+  objects_free(aot->objects);
+  tfree(aot->functions);
+  tfree(aot->constants);
+}
+
+/// runs the script, which is called like any other function from stack slot 0
+static bool aot_run(Aot *aot)
+{
+  aot->vm.stack[0] = make_obj_value(&aot->functions[0]->obj);
+  bool ok = aot_call(aot, 0, 0, 0);
+
+  // NOTE(HS): as at the end of `vm_run`
+  vm_close_upvalues(&aot->vm, aot->vm.stack);
+  output_flush(&aot->vm.out);
+  return ok;
+}
+
+static void *aot_thread_run(void *context)
+{
+  Aot_Thread *thread = context;
+  char top = 0;
+  thread->aot->stack_limit = (uintptr_t) &top - (thread->stack_size - AOT_STACK_MARGIN);
+  thread->ok = aot_run(thread->aot);
+  return NULL;
+}
+
+/// runs the script on a thread with a stack deep enough for `max_call_depth` calls,
+/// settling for a smaller one (and so failing sooner) if that can't be had
+static bool aot_run_thread(Aot *aot)
+{
+  size_t stack_size = aot->vm.max_call_depth * AOT_STACK_BYTES_PER_CALL + AOT_STACK_MARGIN;
+  for (; stack_size >= AOT_STACK_MIN; stack_size /= 2)
+  {
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0)
+    {
+      break;
+    }
+
+    Aot_Thread thread = { .aot = aot, .stack_size = stack_size, .ok = false };
+    pthread_t id;
+    bool started = pthread_attr_setstacksize(&attr, stack_size) == 0
+      && pthread_create(&id, &attr, aot_thread_run, &thread) == 0;
+    pthread_attr_destroy(&attr);
+
+    if (started)
+    {
+      pthread_join(id, NULL);
+      return thread.ok;
+    }
+  }
+
+  fprintf(stderr, "[ERROR] Could not allocate a stack to run %s on\n", aot->program->source_name);
+  return false;
+}
+
+
+///
+/// public functions
+///
+
+int aot_main(const Aot_Program *program)
+{
+  Aot aot;
+  aot_init(&aot, program);
+
+  bool ok = aot_run_thread(&aot);
+  if (!ok && aot.err.kind != TYERR_NONE)
+  {
+    Location location = location_from_pos(program->source, aot.err.location.pos);
+    fprintf(
+      stderr, "%s:%zu:%zu: [ERROR] %s: %s\n",
+      program->source_name, location.line + 1, location.col + 1,
+      tyger_error_kind_to_string(aot.err.kind), aot.err.message
+    );
+    tyger_error_free(&aot.err);
+  }
+
+  aot_free(&aot);
+  return ok ? 0 : 1;
+}
+
+/// NOTE(HS): mirrors `VM_LOOKUP_CALLEE`, `VM_ENTER_FUNCTION` and (for the calls which
+/// come back as tail calls) `VM_TAIL_ENTER_FUNCTION`, with the same errors in the same
+/// order. A tail call's `@memo` entry is chained in front of the one before it, the
+/// result fills them all.
+bool aot_call(Aot *aot, size_t callee, size_t argc, size_t pos)
+{
+  VM *vm = &aot->vm;
+  Memo_Ref memo = { .cache = NULL, .index = 0, .generation = 0 };
+
+  for (;;)
+  {
+    Value callee_value = vm->stack[callee];
+    Obj_Function *function = value_callee_function(callee_value);
+    if (!function)
+    {
+      aot_error(
+        aot, TYERR_NOT_CALLABLE, pos, "value of type %s is not callable",
+        value_type_name(callee_value)
+      );
+      break;
+    }
+    if (function->arity != argc)
+    {
+      aot_error(
+        aot, TYERR_ARITY_MISMATCH, pos, "%s expects %zu argument(s) but was given %u",
+        function->name ? function->name->chars : "function", function->arity, (unsigned) argc
+      );
+      break;
+    }
+
+    if (function->memo)
+    {
+      Memo_Ref ref;
+      Value result;
+      if (vm_memo_call(vm, function, vm->stack + callee + 1, memo, &result, &ref))
+      {
+        if (memo.cache)
+        {
+          memo_ref_fill(memo, result);
+        }
+        vm->stack[callee] = result;
+        return true;
+      }
+      memo = ref;
+    }
+
+    Value *sp = vm->stack + callee + 1 + argc;
+    size_t stack_len = callee + 1 + function->chunk.max_stack;
+    if (aot->depth + 1 > vm->max_call_depth || aot_stack_exhausted(aot)
+        || (stack_len > vm->stack_capacity && !vm_reserve(vm, 0, stack_len, &sp)))
+    {
+      aot_error(aot, TYERR_STACK_OVERFLOW, pos, "stack overflow");
+      break;
+    }
+
+    Obj_Upvalue **upvalues = value_is_closure(callee_value)
+      ? value_as_closure(callee_value)->upvalues
+      : NULL;
+
+    aot->depth += 1;
+    bool ok = function->native(aot, callee + 1, upvalues);
+    aot->depth -= 1;
+    if (!ok)
+    {
+      break;
+    }
+
+    if (!aot->tail_call)
+    {
+      if (memo.cache)
+      {
+        memo_ref_fill(memo, vm->stack[callee]);
+      }
+      return true;
+    }
+    aot->tail_call = false;
+    argc = aot->tail_argc;
+    pos = aot->tail_pos;
+  }
+
+  // NOTE(HS): calls cut short by an error never fill their entries
+  if (memo.cache)
+  {
+    memo_ref_abandon(memo);
+  }
+  return false;
+}
+
+bool aot_tail_call(Aot *aot, size_t slots, size_t callee, size_t argc, size_t pos)
+{
+  VM *vm = &aot->vm;
+  Value *base = vm->stack + slots - 1;
+  if (vm->open_upvalues && vm->open_upvalues->location >= base + 1)
+  {
+    vm_close_upvalues(vm, base + 1);
+  }
+  memmove(base, vm->stack + callee, (argc + 1) * sizeof(Value));
+
+  aot->tail_call = true;
+  aot->tail_argc = argc;
+  aot->tail_pos = pos;
+  return true;
+}
+
+bool aot_call_native(Aot *aot, Builtin_Id id, size_t args, size_t argc, size_t pos)
+{
+  Value_Span span = { aot->vm.stack + args, argc };
+  Value result = make_nil_value();
+  Tyger_Error err = BUILTINS[id].fn(&aot->vm, span, &result);
+  if (err.kind != TYERR_NONE)
+  {
+    aot_error(aot, err.kind, pos, "%s", err.message);
+    tyger_error_free(&err);
+    return false;
+  }
+
+  span.elems[0] = result;
+  aot_gc_safepoint(aot, span.elems + 1);
+  return true;
+}
+
+bool aot_binary(Aot *aot, Opcode op, Value *lhs, size_t pos)
+{
+  Gc *gc = &aot->vm.gc;
+  Value a = lhs[0];
+  Value b = lhs[1];
+  bool integers = value_is_integer(a) && value_is_integer(b);
+
+  switch (op)
+  {
+  case OPC_ADD:
+  {
+    if (integers)
+    {
+      lhs[0] = bigint_add(gc, a, b);
+    }
+    else if (value_is_string(a) && value_is_string(b))
+    {
+      lhs[0] = gc_string_concat(gc, a, b);
+    }
+    else
+    {
+      return aot_binary_type_error(aot, "+", a, b, pos);
+    }
+  } break;
+
+  case OPC_SUB:
+  case OPC_MUL:
+  {
+    const char *op_str = op == OPC_SUB ? "-" : "*";
+    if (!integers)
+    {
+      return aot_binary_type_error(aot, op_str, a, b, pos);
+    }
+    lhs[0] = op == OPC_SUB ? bigint_sub(gc, a, b) : bigint_mul(gc, a, b);
+  } break;
+
+  case OPC_DIV:
+  {
+    if (!integers)
+    {
+      return aot_binary_type_error(aot, "/", a, b, pos);
+    }
+    if (b.kind == VAL_INT && b.as.integer == 0)
+    {
+      return aot_error(aot, TYERR_DIVIDE_BY_ZERO, pos, "division by zero");
+    }
+    lhs[0] = bigint_div(gc, a, b);
+  } break;
+
+  case OPC_LT:
+  case OPC_GT:
+  case OPC_LTE:
+  case OPC_GTE:
+  {
+    const char *op_str = op == OPC_LT ? "<" : op == OPC_GT ? ">" : op == OPC_LTE ? "<=" : ">=";
+    if (!integers)
+    {
+      return aot_binary_type_error(aot, op_str, a, b, pos);
+    }
+    int cmp = bigint_compare(a, b);
+    bool result = op == OPC_LT ? cmp < 0 : op == OPC_GT ? cmp > 0 : op == OPC_LTE ? cmp <= 0 : cmp >= 0;
+    lhs[0] = make_bool_value(result);
+    return true;
+  } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid binary instruction %s\n", opcode_to_string(op));
+    assert(0);
+  } break;
+  }
+
+  aot_gc_safepoint(aot, lhs + 1);
+  return true;
+}
+
+bool aot_negate(Aot *aot, Value *operand, size_t pos)
+{
+  if (!value_is_integer(*operand))
+  {
+    return aot_error(
+      aot, TYERR_TYPE_MISMATCH, pos, "unsupported operand type for -: %s",
+      value_type_name(*operand)
+    );
+  }
+
+  *operand = bigint_negate(&aot->vm.gc, *operand);
+  aot_gc_safepoint(aot, operand + 1);
+  return true;
+}
@@ -0,0 +1,598 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bigint.h"
+
+#define LIMB_BITS 32
+#define LIMB_BASE ((uint64_t) 1 << LIMB_BITS)
+
+/// decimal conversion works in chunks of 9 digits, the largest power of 10 in a limb
+#define DECIMAL_CHUNK 1000000000u
+#define DECIMAL_CHUNK_DIGITS 9
+
+/// A signed magnitude being worked on, either borrowed from a value or owned
+typedef struct bignum
+{
+  bool negative;
+  size_t len;
+  const uint32_t *limbs;
+} Bignum;
+
+///
+/// internal functions
+///
+
+#if !defined(__GNUC__) && !defined(__clang__)
+bool int_add_overflow(int64_t a, int64_t b, int64_t *result)
+{
+  if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+  {
+    return true;
+  }
+  *result = a + b;
+  return false;
+}
+
+bool int_sub_overflow(int64_t a, int64_t b, int64_t *result)
+{
+  if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b))
+  {
+    return true;
+  }
+  *result = a - b;
+  return false;
+}
+
+bool int_mul_overflow(int64_t a, int64_t b, int64_t *result)
+{
+  if (a != 0 && b != 0)
+  {
+    if ((a == -1 && b == INT64_MIN) || (b == -1 && a == INT64_MIN))
+    {
+      return true;
+    }
+    if (a != -1 && b != -1 && (a * b) / b != a)
+    {
+      return true;
+    }
+  }
+  *result = (int64_t) ((uint64_t) a * (uint64_t) b);
+  return false;
+}
+#endif
+
+static int limb_clz(uint32_t x)
+{
+  assert(x != 0);
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clz(x);
+#else
+  int n = 0;
+  while (!(x & 0x80000000u))
+  {
+    x <<= 1;
+    n += 1;
+  }
+  return n;
+#endif
+}
+
+static uint32_t *limbs_alloc(size_t len)
+{
+  uint32_t *limbs = tcalloc(len > 0 ? len : 1, sizeof(uint32_t));
+  assert(limbs);
+  return limbs;
+}
+
+static size_t mag_normalize(const uint32_t *a, size_t len)
+{
+  while (len > 0 && a[len - 1] == 0)
+  {
+    len -= 1;
+  }
+  return len;
+}
+
+static int mag_compare(const uint32_t *a, size_t al, const uint32_t *b, size_t bl)
+{
+  al = mag_normalize(a, al);
+  bl = mag_normalize(b, bl);
+  if (al != bl)
+  {
+    return al < bl ? -1 : 1;
+  }
+  for (size_t i = al; i > 0; --i)
+  {
+    if (a[i - 1] != b[i - 1])
+    {
+      return a[i - 1] < b[i - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+/// `a += b`, the sum must fit in `al` limbs
+static void mag_add_in_place(uint32_t *a, size_t al, const uint32_t *b, size_t bl)
+{
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < bl; ++i)
+  {
+    uint64_t sum = (uint64_t) a[i] + b[i] + carry;
+    a[i] = (uint32_t) sum;
+    carry = sum >> LIMB_BITS;
+  }
+  for (; carry && i < al; ++i)
+  {
+    uint64_t sum = (uint64_t) a[i] + carry;
+    a[i] = (uint32_t) sum;
+    carry = sum >> LIMB_BITS;
+  }
+  assert(carry == 0);
+}
+
+/// `a -= b`, `a` must be at least `b`
+static void mag_sub_in_place(uint32_t *a, size_t al, const uint32_t *b, size_t bl)
+{
+  uint64_t borrow = 0;
+  size_t i = 0;
+  for (; i < bl; ++i)
+  {
+    uint64_t diff = (uint64_t) a[i] - b[i] - borrow;
+    a[i] = (uint32_t) diff;
+    borrow = (diff >> LIMB_BITS) & 1;
+  }
+  for (; borrow && i < al; ++i)
+  {
+    uint64_t diff = (uint64_t) a[i] - borrow;
+    a[i] = (uint32_t) diff;
+    borrow = (diff >> LIMB_BITS) & 1;
+  }
+  assert(borrow == 0);
+}
+
+/// `r = a + b`, `r` must have room for `max(al, bl) + 1` limbs
+static size_t mag_add(uint32_t *r, const uint32_t *a, size_t al, const uint32_t *b, size_t bl)
+{
+  if (al < bl)
+  {
+    const uint32_t *t = a; a = b; b = t;
+    size_t tl = al; al = bl; bl = tl;
+  }
+  memcpy(r, a, al * sizeof(uint32_t));
+  r[al] = 0;
+  mag_add_in_place(r, al + 1, b, bl);
+  return mag_normalize(r, al + 1);
+}
+
+static void mag_mul_schoolbook(uint32_t *r, const uint32_t *a, size_t al, const uint32_t *b, size_t bl)
+{
+  memset(r, 0, (al + bl) * sizeof(uint32_t));
+  for (size_t i = 0; i < al; ++i)
+  {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < bl; ++j)
+    {
+      uint64_t t = (uint64_t) a[i] * b[j] + r[i + j] + carry;
+      r[i + j] = (uint32_t) t;
+      carry = t >> LIMB_BITS;
+    }
+    r[i + bl] = (uint32_t) carry;
+  }
+}
+
+/// `r = a * b`, `r` must have room for `al + bl` limbs
+///
+/// NOTE(HS): Karatsuba splits both operands at `m` limbs, `a = a1 * B^m + a0`, and
+/// needs three half sized products instead of four:
+///   `a * b = z2 * B^2m + (z1 - z2 - z0) * B^m + z0`
+/// where `z0 = a0 * b0`, `z2 = a1 * b1` and `z1 = (a0 + a1) * (b0 + b1)`
+static void mag_mul(uint32_t *r, const uint32_t *a, size_t al, const uint32_t *b, size_t bl)
+{
+  if (al < bl)
+  {
+    const uint32_t *t = a; a = b; b = t;
+    size_t tl = al; al = bl; bl = tl;
+  }
+
+  if (bl < BIGINT_KARATSUBA_THRESHOLD)
+  {
+    mag_mul_schoolbook(r, a, al, b, bl);
+    return;
+  }
+
+  size_t m = al / 2;
+  if (bl <= m)
+  {
+    // NOTE(HS): too lopsided to split `b`, multiply it by each half of `a` instead
+    size_t hi_len = (al - m) + bl;
+    uint32_t *hi = limbs_alloc(hi_len);
+    memset(r, 0, (al + bl) * sizeof(uint32_t));
+    mag_mul(r, a, m, b, bl);
+    mag_mul(hi, a + m, al - m, b, bl);
+    mag_add_in_place(r + m, al + bl - m, hi, mag_normalize(hi, hi_len));
+    tfree(hi);
+    return;
+  }
+
+  const uint32_t *a0 = a, *a1 = a + m;
+  const uint32_t *b0 = b, *b1 = b + m;
+  size_t a1_len = al - m, b1_len = bl - m;
+
+  // NOTE(HS): z0 and z2 don't overlap so are computed straight into the result
+  memset(r, 0, (al + bl) * sizeof(uint32_t));
+  mag_mul(r, a0, m, b0, m);
+  mag_mul(r + 2 * m, a1, a1_len, b1, b1_len);
+
+  size_t sum_cap = (a1_len > m ? a1_len : m) + 1;
+  uint32_t *sa = limbs_alloc(sum_cap);
+  uint32_t *sb = limbs_alloc(sum_cap);
+  size_t sa_len = mag_add(sa, a0, m, a1, a1_len);
+  size_t sb_len = mag_add(sb, b0, m, b1, b1_len);
+
+  size_t z1_len = sa_len + sb_len;
+  uint32_t *z1 = limbs_alloc(z1_len);
+  if (sa_len > 0 && sb_len > 0)
+  {
+    mag_mul(z1, sa, sa_len, sb, sb_len);
+  }
+  mag_sub_in_place(z1, z1_len, r, mag_normalize(r, 2 * m));
+  mag_sub_in_place(z1, z1_len, r + 2 * m, mag_normalize(r + 2 * m, a1_len + b1_len));
+  mag_add_in_place(r + m, al + bl - m, z1, mag_normalize(z1, z1_len));
+
+  tfree(z1);
+  tfree(sb);
+  tfree(sa);
+}
+
+/// `a /= d` in place, returning the remainder
+static uint32_t mag_divmod_small(uint32_t *a, size_t len, uint32_t d)
+{
+  uint64_t rem = 0;
+  for (size_t i = len; i > 0; --i)
+  {
+    uint64_t cur = (rem << LIMB_BITS) | a[i - 1];
+    a[i - 1] = (uint32_t) (cur / d);
+    rem = cur % d;
+  }
+  return (uint32_t) rem;
+}
+
+/// `q = u / v` by Knuth's algorithm D, `q` must have room for `ul - vl + 1` limbs
+///
+/// NOTE(HS): follows `divmnu` from Hacker's Delight, both operands are shifted so
+/// the divisor's top bit is set, which keeps each estimated quotient limb within 2
+/// of the true one
+static void mag_div(uint32_t *q, const uint32_t *u, size_t ul, const uint32_t *v, size_t vl)
+{
+  assert(vl >= 2 && ul >= vl && v[vl - 1] != 0);
+
+  int s = limb_clz(v[vl - 1]);
+  uint32_t *vn = limbs_alloc(vl);
+  uint32_t *un = limbs_alloc(ul + 1);
+  for (size_t i = vl - 1; i > 0; --i)
+  {
+    vn[i] = (v[i] << s) | (s ? v[i - 1] >> (LIMB_BITS - s) : 0);
+  }
+  vn[0] = v[0] << s;
+  un[ul] = s ? u[ul - 1] >> (LIMB_BITS - s) : 0;
+  for (size_t i = ul - 1; i > 0; --i)
+  {
+    un[i] = (u[i] << s) | (s ? u[i - 1] >> (LIMB_BITS - s) : 0);
+  }
+  un[0] = u[0] << s;
+
+  for (size_t j = ul - vl + 1; j > 0; --j)
+  {
+    size_t k = j - 1;
+    uint64_t num = ((uint64_t) un[k + vl] << LIMB_BITS) | un[k + vl - 1];
+    uint64_t qhat = num / vn[vl - 1];
+    uint64_t rhat = num % vn[vl - 1];
+    while (qhat >= LIMB_BASE || qhat * vn[vl - 2] > ((rhat << LIMB_BITS) | un[k + vl - 2]))
+    {
+      qhat -= 1;
+      rhat += vn[vl - 1];
+      if (rhat >= LIMB_BASE)
+      {
+        break;
+      }
+    }
+
+    int64_t borrow = 0;
+    int64_t t = 0;
+    for (size_t i = 0; i < vl; ++i)
+    {
+      uint64_t p = qhat * vn[i];
+      t = (int64_t) un[i + k] - borrow - (int64_t) (p & 0xffffffffu);
+      un[i + k] = (uint32_t) t;
+      borrow = (int64_t) (p >> LIMB_BITS) - (t >> LIMB_BITS);
+    }
+    t = (int64_t) un[k + vl] - borrow;
+    un[k + vl] = (uint32_t) t;
+
+    q[k] = (uint32_t) qhat;
+    if (t < 0)
+    {
+      // NOTE(HS): the estimate was one too large, add a divisor back
+      q[k] -= 1;
+      uint64_t carry = 0;
+      for (size_t i = 0; i < vl; ++i)
+      {
+        uint64_t sum = (uint64_t) un[i + k] + vn[i] + carry;
+        un[i + k] = (uint32_t) sum;
+        carry = sum >> LIMB_BITS;
+      }
+      un[k + vl] += (uint32_t) carry;
+    }
+  }
+
+  tfree(un);
+  tfree(vn);
+}
+
+/// views an int of either size as a bignum, small ints use `scratch`
+static Bignum bignum_from_value(Value v, uint32_t scratch[2])
+{
+  Bignum n;
+  if (v.kind == VAL_INT)
+  {
+    uint64_t magnitude = v.as.integer < 0 ? (uint64_t) 0 - (uint64_t) v.as.integer : (uint64_t) v.as.integer;
+    scratch[0] = (uint32_t) magnitude;
+    scratch[1] = (uint32_t) (magnitude >> LIMB_BITS);
+    n.negative = v.as.integer < 0;
+    n.len = mag_normalize(scratch, 2);
+    n.limbs = scratch;
+  }
+  else
+  {
+    assert(value_is_bigint(v));
+    const Obj_Bigint *big = value_as_bigint(v);
+    n.negative = big->negative;
+    n.len = big->len;
+    n.limbs = big->limbs;
+  }
+  return n;
+}
+
+static Obj_Bigint *obj_bigint_new(Obj **objects, bool negative, const uint32_t *limbs, size_t len)
+{
+  Obj_Bigint *big = tmalloc(sizeof(Obj_Bigint) + len * sizeof(uint32_t));
+  assert(big);
+
+  big->obj.kind = OBJ_BIGINT;
+  big->obj.color = OBJ_UNMANAGED;
+  big->obj.next = *objects;
+  big->negative = negative;
+  big->len = len;
+  big->limbs = (uint32_t*) (big + 1);
+  memcpy(big->limbs, limbs, len * sizeof(uint32_t));
+
+  *objects = &big->obj;
+  return big;
+}
+
+/// makes the value for a result, an int when it fits, otherwise a bigint allocated from
+/// `gc` (or linked into `objects` when there's no collector)
+static Value bignum_to_value(Gc *gc, Obj **objects, bool negative, const uint32_t *limbs, size_t len)
+{
+  len = mag_normalize(limbs, len);
+  if (len <= 2)
+  {
+    uint64_t magnitude = len == 0 ? 0 : limbs[0] | (len == 2 ? (uint64_t) limbs[1] << LIMB_BITS : 0);
+    if (!negative && magnitude <= (uint64_t) INT64_MAX)
+    {
+      return make_int_value((int64_t) magnitude);
+    }
+    if (negative && magnitude <= (uint64_t) INT64_MAX + 1)
+    {
+      return make_int_value((int64_t) ((uint64_t) 0 - magnitude));
+    }
+  }
+
+  Obj_Bigint *big = obj_bigint_new(gc ? &gc->objects : objects, negative, limbs, len);
+  if (gc)
+  {
+    gc_track(gc, &big->obj);
+  }
+  return make_obj_value(&big->obj);
+}
+
+/// `a + b` with the signs taken from the bignums, shared by add and subtract
+static Value bignum_add(Gc *gc, Bignum a, Bignum b)
+{
+  size_t cap = (a.len > b.len ? a.len : b.len) + 1;
+  uint32_t *r = limbs_alloc(cap);
+  Value result;
+
+  if (a.negative == b.negative)
+  {
+    size_t len = mag_add(r, a.limbs, a.len, b.limbs, b.len);
+    result = bignum_to_value(gc, NULL, a.negative, r, len);
+  }
+  else if (mag_compare(a.limbs, a.len, b.limbs, b.len) >= 0)
+  {
+    memcpy(r, a.limbs, a.len * sizeof(uint32_t));
+    mag_sub_in_place(r, a.len, b.limbs, b.len);
+    result = bignum_to_value(gc, NULL, a.negative, r, a.len);
+  }
+  else
+  {
+    memcpy(r, b.limbs, b.len * sizeof(uint32_t));
+    mag_sub_in_place(r, b.len, a.limbs, a.len);
+    result = bignum_to_value(gc, NULL, b.negative, r, b.len);
+  }
+
+  tfree(r);
+  return result;
+}
+
+
+///
+/// public functions
+///
+
+Value bigint_add(Gc *gc, Value a, Value b)
+{
+  uint32_t sa[2], sb[2];
+  return bignum_add(gc, bignum_from_value(a, sa), bignum_from_value(b, sb));
+}
+
+Value bigint_sub(Gc *gc, Value a, Value b)
+{
+  uint32_t sa[2], sb[2];
+  Bignum rhs = bignum_from_value(b, sb);
+  rhs.negative = !rhs.negative;
+  return bignum_add(gc, bignum_from_value(a, sa), rhs);
+}
+
+Value bigint_mul(Gc *gc, Value a, Value b)
+{
+  uint32_t sa[2], sb[2];
+  Bignum lhs = bignum_from_value(a, sa);
+  Bignum rhs = bignum_from_value(b, sb);
+  if (lhs.len == 0 || rhs.len == 0)
+  {
+    return make_int_value(0);
+  }
+
+  uint32_t *r = limbs_alloc(lhs.len + rhs.len);
+  mag_mul(r, lhs.limbs, lhs.len, rhs.limbs, rhs.len);
+  Value result = bignum_to_value(gc, NULL, lhs.negative != rhs.negative, r, lhs.len + rhs.len);
+  tfree(r);
+  return result;
+}
+
+Value bigint_div(Gc *gc, Value a, Value b)
+{
+  uint32_t sa[2], sb[2];
+  Bignum lhs = bignum_from_value(a, sa);
+  Bignum rhs = bignum_from_value(b, sb);
+  assert(rhs.len > 0);
+
+  if (mag_compare(lhs.limbs, lhs.len, rhs.limbs, rhs.len) < 0)
+  {
+    return make_int_value(0);
+  }
+
+  size_t q_len = lhs.len - rhs.len + 1;
+  uint32_t *q = limbs_alloc(q_len);
+  if (rhs.len == 1)
+  {
+    memcpy(q, lhs.limbs, lhs.len * sizeof(uint32_t));
+    mag_divmod_small(q, lhs.len, rhs.limbs[0]);
+    q_len = lhs.len;
+  }
+  else
+  {
+    mag_div(q, lhs.limbs, lhs.len, rhs.limbs, rhs.len);
+  }
+
+  Value result = bignum_to_value(gc, NULL, lhs.negative != rhs.negative, q, q_len);
+  tfree(q);
+  return result;
+}
+
+Value bigint_negate(Gc *gc, Value a)
+{
+  uint32_t sa[2];
+  Bignum n = bignum_from_value(a, sa);
+  return bignum_to_value(gc, NULL, !n.negative, n.limbs, n.len);
+}
+
+int bigint_compare(Value a, Value b)
+{
+  uint32_t sa[2], sb[2];
+  Bignum lhs = bignum_from_value(a, sa);
+  Bignum rhs = bignum_from_value(b, sb);
+
+  // NOTE(HS): zero is never negative, so differing signs settle it
+  if (lhs.negative != rhs.negative)
+  {
+    return lhs.negative ? -1 : 1;
+  }
+  int cmp = mag_compare(lhs.limbs, lhs.len, rhs.limbs, rhs.len);
+  return lhs.negative ? -cmp : cmp;
+}
+
+Value bigint_from_decimal(Obj **objects, const char *digits, size_t len)
+{
+  // NOTE(HS): each decimal digit needs log2(10) < 3.33 bits
+  size_t cap = (len * 10 / 3) / LIMB_BITS + 2;
+  uint32_t *r = limbs_alloc(cap);
+  size_t r_len = 0;
+
+  size_t i = 0;
+  while (i < len)
+  {
+    size_t chunk_len = (len - i) % DECIMAL_CHUNK_DIGITS;
+    chunk_len = (i == 0 && chunk_len != 0) ? chunk_len : DECIMAL_CHUNK_DIGITS;
+
+    uint32_t chunk = 0;
+    uint32_t scale = 1;
+    for (size_t j = 0; j < chunk_len; ++j)
+    {
+      assert(digits[i + j] >= '0' && digits[i + j] <= '9');
+      chunk = chunk * 10 + (uint32_t) (digits[i + j] - '0');
+      scale *= 10;
+    }
+    i += chunk_len;
+
+    // NOTE(HS): `r = r * scale + chunk`
+    uint64_t carry = chunk;
+    for (size_t j = 0; j < r_len; ++j)
+    {
+      uint64_t t = (uint64_t) r[j] * scale + carry;
+      r[j] = (uint32_t) t;
+      carry = t >> LIMB_BITS;
+    }
+    if (carry)
+    {
+      assert(r_len < cap);
+      r[r_len++] = (uint32_t) carry;
+    }
+  }
+
+  Value result = bignum_to_value(NULL, objects, false, r, r_len);
+  tfree(r);
+  return result;
+}
+
+char *bigint_to_decimal(const Obj_Bigint *n)
+{
+  // NOTE(HS): the magnitude is split into base 10^9 chunks with one pass of single
+  // limb division per chunk, rather than one per digit
+  uint32_t *mag = limbs_alloc(n->len);
+  memcpy(mag, n->limbs, n->len * sizeof(uint32_t));
+  size_t mag_len = n->len;
+
+  size_t chunks_cap = (n->len * LIMB_BITS) / 29 + 1;
+  uint32_t *chunks = limbs_alloc(chunks_cap);
+  size_t chunks_len = 0;
+  while (mag_len > 0)
+  {
+    assert(chunks_len < chunks_cap);
+    chunks[chunks_len++] = mag_divmod_small(mag, mag_len, DECIMAL_CHUNK);
+    mag_len = mag_normalize(mag, mag_len);
+  }
+
+  size_t cap = chunks_len * DECIMAL_CHUNK_DIGITS + 2;
+  char *str = tmalloc(cap);
+  assert(str);
+
+  size_t pos = 0;
+  if (n->negative)
+  {
+    str[pos++] = '-';
+  }
+  pos += (size_t) snprintf(str + pos, cap - pos, "%u", chunks[chunks_len - 1]);
+  for (size_t i = chunks_len - 1; i > 0; --i)
+  {
+    pos += (size_t) snprintf(str + pos, cap - pos, "%09u", chunks[i - 1]);
+  }
+
+  tfree(chunks);
+  tfree(mag);
+  return str;
+}
@@ -0,0 +1,146 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "builtin.h"
+#include "vm.h"
+#include "tstrings.h"
+#include "defs/builtin-hash.def"
+
+#define X(ID, NAME, ARITY, PURE) \
+  static Tyger_Error builtin_##NAME(VM *vm, Value_Span args, Value *result);
+  #include "defs/builtin.def"
+#undef X
+
+const Builtin BUILTINS[BUILTIN_COUNT] = {
+#define X(ID, NAME, ARITY, PURE) \
+  [BUILTIN_##ID] = { #NAME, sizeof(#NAME) - 1, (ARITY), (PURE), builtin_##NAME },
+  #include "defs/builtin.def"
+#undef X
+};
+
+/// maps a hash slot to its builtin's id + 1, empty slots are 0
+static const uint8_t BUILTIN_HASH_TABLE[BUILTIN_HASH_SIZE] = {
+#define X(SLOT, ID) [SLOT] = BUILTIN_##ID + 1,
+  BUILTIN_HASH_SLOTS(X)
+#undef X
+};
+
+///
+/// internal functions
+///
+
+/// NOTE(HS): must match `builtin_slot` in scripts/builtin_hash_gen.py
+static inline uint32_t builtin_slot(const char *name, size_t len)
+{
+  uint32_t h = 2166136261u ^ BUILTIN_HASH_SEED;
+  for (size_t i = 0; i < len; ++i)
+  {
+    h ^= (uint8_t) name[i];
+    h *= 16777619u;
+  }
+  return (h ^ (h >> 16)) & (BUILTIN_HASH_SIZE - 1);
+}
+
+static Tyger_Error builtin_error(Tyger_Error_Kind kind, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  char message[256];
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+
+  String_Builder sb;
+  string_builder_init(&sb);
+  string_builder_append(&sb, message);
+
+  Tyger_Error err = {
+    .kind = kind,
+    .message = string_builder_to_cstring(&sb),
+  };
+  string_builder_free(&sb);
+  return err;
+}
+
+static void builtin_write_args(VM *vm, Value_Span args)
+{
+  for (size_t i = 0; i < args.len; ++i)
+  {
+    if (i > 0)
+    {
+      output_putc(&vm->out, ' ');
+    }
+    value_write(&vm->out, args.elems[i]);
+  }
+}
+
+///
+/// builtins
+///
+
+static Tyger_Error builtin_println(VM *vm, Value_Span args, Value *result)
+{
+  Tyger_Error ok = {0};
+  (void) result;
+
+  builtin_write_args(vm, args);
+  output_putc(&vm->out, '\n');
+  return ok;
+}
+
+static Tyger_Error builtin_print(VM *vm, Value_Span args, Value *result)
+{
+  Tyger_Error ok = {0};
+  (void) result;
+
+  builtin_write_args(vm, args);
+  return ok;
+}
+
+static Tyger_Error builtin_len(VM *vm, Value_Span args, Value *result)
+{
+  Tyger_Error ok = {0};
+  (void) vm;
+
+  Value v = args.elems[0];
+  if (!value_is_string(v))
+  {
+    return builtin_error(TYERR_TYPE_MISMATCH, "len expects a string, not %s", value_type_name(v));
+  }
+
+  *result = make_int_value((int64_t) value_string_len(v));
+  return ok;
+}
+
+static Tyger_Error builtin_type(VM *vm, Value_Span args, Value *result)
+{
+  Tyger_Error ok = {0};
+
+  const char *name = value_type_name(args.elems[0]);
+  *result = gc_string_new(&vm->gc, name, strlen(name));
+  return ok;
+}
+
+
+///
+/// public functions
+///
+
+bool builtin_lookup(const char *name, size_t len, Builtin_Id *id)
+{
+  uint8_t entry = BUILTIN_HASH_TABLE[builtin_slot(name, len)];
+  if (entry == 0)
+  {
+    return false;
+  }
+
+  const Builtin *builtin = &BUILTINS[entry - 1];
+  if (builtin->name_len != len || memcmp(builtin->name, name, len) != 0)
+  {
+    return false;
+  }
+
+  *id = (Builtin_Id) (entry - 1);
+  return true;
+}
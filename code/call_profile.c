@@ -0,0 +1,120 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_PROFILER
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "call_profile.h"
+#include "util.h"
+
+///
+/// internal functions
+///
+
+/// records that `site` called `callee`, a site seen calling two different functions
+/// (e.g. in two copies of the chunk it's in) is polymorphic
+static void call_profile_add(Call_Profile *profile, size_t site, size_t callee)
+{
+  for (size_t i = 0; i < profile->len; ++i)
+  {
+    Call_Profile_Entry *entry = &profile->elems[i];
+    if (entry->site == site)
+    {
+      if (entry->callee != callee)
+      {
+        entry->callee = CALL_PROFILE_POLYMORPHIC;
+      }
+      return;
+    }
+  }
+
+  Call_Profile_Entry entry = { .site = site, .callee = callee };
+  va_array_append(*profile, entry);
+}
+
+/// the cache of the call at `offset`, NULL when it isn't a call with one
+static const Call_Cache *call_profile_cache(const Chunk *chunk, size_t offset, Opcode op)
+{
+  size_t operand;
+  switch (opcode_generic_form(op))
+  {
+  case OPC_CALL: case OPC_TAIL_CALL:               { operand = 1; } break;
+  case OPC_CALL_GLOBAL: case OPC_TAIL_CALL_GLOBAL: { operand = 2; } break;
+  default:                                         { return NULL; } break;
+  }
+
+  size_t index = chunk_read_operand(&chunk->code.elems[offset + 1 + operand * CHUNK_OPERAND_SIZE]);
+  assert(index < chunk->call_caches.len);
+  return &chunk->call_caches.elems[index];
+}
+
+
+///
+/// public functions
+///
+
+void call_profile_init(Call_Profile *profile)
+{
+  va_array_init(Call_Profile_Entry, *profile);
+}
+
+void call_profile_free(Call_Profile *profile)
+{
+  va_array_free(*profile);
+}
+
+void call_profile_collect(Call_Profile *profile, const Chunk *chunk)
+{
+  size_t offset = 0;
+  while (offset < chunk->code.len)
+  {
+    Opcode op = (Opcode) chunk->code.elems[offset];
+    const Call_Cache *cache = call_profile_cache(chunk, offset, op);
+    if (cache && cache->len == 1 && !cache->megamorphic)
+    {
+      call_profile_add(profile, chunk_position_of(chunk, offset), cache->entries[0]->pos);
+    }
+    offset += opcode_length(op);
+  }
+
+  for (size_t i = 0; i < chunk->constants.len; ++i)
+  {
+    if (value_is_function(chunk->constants.elems[i]))
+    {
+      call_profile_collect(profile, &value_as_function(chunk->constants.elems[i])->chunk);
+    }
+  }
+}
+
+size_t call_profile_lookup(const Call_Profile *profile, size_t site)
+{
+  for (size_t i = 0; i < profile->len; ++i)
+  {
+    if (profile->elems[i].site == site)
+    {
+      return profile->elems[i].callee;
+    }
+  }
+  return CALL_PROFILE_POLYMORPHIC;
+}
+
+void call_profile_write(const Call_Profile *profile, FILE *f)
+{
+  for (size_t i = 0; i < profile->len; ++i)
+  {
+    const Call_Profile_Entry *entry = &profile->elems[i];
+    if (entry->callee != CALL_PROFILE_POLYMORPHIC)
+    {
+      fprintf(f, "%zu %zu\n", entry->site, entry->callee);
+    }
+  }
+}
+
+bool call_profile_read(Call_Profile *profile, FILE *f)
+{
+  size_t site, callee;
+  int matched;
+  while ((matched = fscanf(f, "%zu %zu", &site, &callee)) == 2)
+  {
+    call_profile_add(profile, site, callee);
+  }
+  return matched == EOF && !ferror(f);
+}
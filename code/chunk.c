@@ -0,0 +1,425 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_COMPILER
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chunk.h"
+#include "jit.h"
+#include "util.h"
+
+#if JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+void chunk_init(Chunk *chunk)
+{
+  va_array_init(uint8_t, chunk->code);
+  va_array_init(Value, chunk->constants);
+  va_array_init(Chunk_Position, chunk->positions);
+  va_array_init(Call_Cache, chunk->call_caches);
+  // NOTE(HS): only chunks with inlined calls have guards, the rest never allocate
+  chunk->guards = (Guard_VaArray) { NULL, 0, 0 };
+  chunk->objects = NULL;
+  chunk->max_stack = 0;
+  chunk->global_count = 0;
+  chunk->source = NULL;
+  chunk->arity = 0;
+  chunk->jit = NULL;
+  chunk->jit_hotness = 0;
+  chunk->jit_disabled = false;
+}
+
+void chunk_free(Chunk *chunk)
+{
+  va_array_free(chunk->code);
+  va_array_free(chunk->constants);
+  va_array_free(chunk->positions);
+  va_array_free(chunk->call_caches);
+  va_array_free(chunk->guards);
+  objects_free(chunk->objects);
+  jit_code_free(chunk->jit);
+  chunk->objects = NULL;
+  chunk->max_stack = 0;
+  chunk->global_count = 0;
+  chunk->source = NULL;
+  chunk->arity = 0;
+  chunk->jit = NULL;
+  chunk->jit_hotness = 0;
+  chunk->jit_disabled = false;
+}
+
+void chunk_write(Chunk *chunk, uint8_t byte, size_t pos)
+{
+  size_t offset = va_array_next_handle(chunk->code);
+  va_array_append(chunk->code, byte);
+
+  // NOTE(HS): only record a new entry when the position changes, runs of
+  // instructions from the same node share one entry
+  if (chunk->positions.len == 0 || chunk->positions.elems[chunk->positions.len - 1].pos != pos)
+  {
+    Chunk_Position position = { .offset = offset, .pos = pos };
+    va_array_append(chunk->positions, position);
+  }
+}
+
+void chunk_write_operand(Chunk *chunk, uint16_t operand, size_t pos)
+{
+  chunk_write(chunk, (uint8_t) (operand & 0xff), pos);
+  chunk_write(chunk, (uint8_t) ((operand >> 8) & 0xff), pos);
+}
+
+void chunk_patch_operand(Chunk *chunk, size_t offset, uint16_t operand)
+{
+  assert(offset + 1 < chunk->code.len);
+  chunk->code.elems[offset] = (uint8_t) (operand & 0xff);
+  chunk->code.elems[offset + 1] = (uint8_t) ((operand >> 8) & 0xff);
+}
+
+size_t chunk_add_constant(Chunk *chunk, Value value)
+{
+  // NOTE(HS): integer and short string constants are deduplicated, long strings are
+  // not as each literal owns its own object
+  if (value.kind == VAL_INT || value.kind == VAL_SHORT_STR)
+  {
+    for (size_t i = 0; i < chunk->constants.len; ++i)
+    {
+      const Value *c = &chunk->constants.elems[i];
+      if (c->kind == value.kind && value_equals(*c, value))
+      {
+        return i;
+      }
+    }
+  }
+
+  size_t handle = va_array_next_handle(chunk->constants);
+  va_array_append(chunk->constants, value);
+  return handle;
+}
+
+size_t chunk_add_call_cache(Chunk *chunk)
+{
+  Call_Cache cache = {0};
+  size_t handle = va_array_next_handle(chunk->call_caches);
+  va_array_append(chunk->call_caches, cache);
+  return handle;
+}
+
+void chunk_reset_call_caches(Chunk *chunk)
+{
+  for (size_t i = 0; i < chunk->call_caches.len; ++i)
+  {
+    chunk->call_caches.elems[i] = (Call_Cache) {0};
+  }
+
+  for (size_t i = 0; i < chunk->constants.len; ++i)
+  {
+    if (value_is_function(chunk->constants.elems[i]))
+    {
+      chunk_reset_call_caches(&value_as_function(chunk->constants.elems[i])->chunk);
+    }
+  }
+}
+
+/// the copy made of each function by `chunk_copy`
+typedef struct chunk_copied_function
+{
+  const Obj_Function *from;
+  Obj_Function *to;
+} Chunk_Copied_Function;
+
+typedef struct chunk_copied_function_vaarray
+{
+  Chunk_Copied_Function *elems;
+  size_t capacity;
+  size_t len;
+} Chunk_Copied_Function_VaArray;
+
+static Obj_Function *chunk_copied_function(const Chunk_Copied_Function_VaArray *copied, const Obj_Function *from)
+{
+  for (size_t i = 0; i < copied->len; ++i)
+  {
+    if (copied->elems[i].from == from)
+    {
+      return copied->elems[i].to;
+    }
+  }
+  return NULL;
+}
+
+static void chunk_copy_into(Chunk *to, const Chunk *from, Obj **objects, Chunk_Copied_Function_VaArray *copied);
+
+static Obj_Function *chunk_copy_function(
+  const Obj_Function *from, Obj **objects, Chunk_Copied_Function_VaArray *copied
+)
+{
+  // NOTE(HS): inlining can leave a function a constant of more than one chunk
+  Obj_Function *to = chunk_copied_function(copied, from);
+  if (to)
+  {
+    return to;
+  }
+
+  to = obj_function_new(objects, from->name, from->arity);
+  to->upvalue_count = from->upvalue_count;
+  if (from->upvalue_count > 0)
+  {
+    to->upvalues = tmalloc(from->upvalue_count * sizeof(Upvalue_Desc));
+    assert(to->upvalues);
+    memcpy(to->upvalues, from->upvalues, from->upvalue_count * sizeof(Upvalue_Desc));
+  }
+  to->memo = from->memo;
+  to->pos = from->pos;
+  to->lazy_source = from->lazy_source;
+  to->lazy_globals = from->lazy_globals;
+  to->native = from->native;
+
+  Chunk_Copied_Function entry = { .from = from, .to = to };
+  va_array_append(*copied, entry);
+  chunk_copy_into(&to->chunk, &from->chunk, objects, copied);
+  return to;
+}
+
+/// copies `from` into the empty chunk `to`, see `chunk_copy`
+static void chunk_copy_into(Chunk *to, const Chunk *from, Obj **objects, Chunk_Copied_Function_VaArray *copied)
+{
+  if (from->code.len > 0)
+  {
+    va_array_append_n(to->code, from->code.elems, from->code.len);
+  }
+  if (from->positions.len > 0)
+  {
+    va_array_append_n(to->positions, from->positions.elems, from->positions.len);
+  }
+  if (from->guards.len > 0)
+  {
+    va_array_append_n(to->guards, from->guards.elems, from->guards.len);
+  }
+  for (size_t i = 0; i < from->call_caches.len; ++i)
+  {
+    chunk_add_call_cache(to);
+  }
+
+  for (size_t i = 0; i < from->constants.len; ++i)
+  {
+    Value constant = from->constants.elems[i];
+    if (value_is_function(constant))
+    {
+      constant = make_obj_value(&chunk_copy_function(value_as_function(constant), objects, copied)->obj);
+    }
+    va_array_append(to->constants, constant);
+  }
+
+  to->max_stack = from->max_stack;
+  to->global_count = from->global_count;
+  to->source = from->source;
+  to->arity = from->arity;
+}
+
+void chunk_copy(Chunk *to, const Chunk *from)
+{
+  Chunk_Copied_Function_VaArray copied = { NULL, 0, 0 };
+  chunk_init(to);
+  chunk_copy_into(to, from, &to->objects, &copied);
+
+  // NOTE(HS): guards expect the copies of the functions they name, once every function
+  // has been copied. One naming a function from elsewhere is left as it is.
+  for (size_t i = 0; i <= copied.len; ++i)
+  {
+    Chunk *chunk = i < copied.len ? &copied.elems[i].to->chunk : to;
+    for (size_t j = 0; j < chunk->guards.len; ++j)
+    {
+      Obj_Function *guard = chunk_copied_function(&copied, chunk->guards.elems[j]);
+      if (guard)
+      {
+        chunk->guards.elems[j] = guard;
+      }
+    }
+  }
+  va_array_free(copied);
+}
+
+Obj_Function *obj_function_new(Obj **objects, Obj_String *name, size_t arity)
+{
+  Obj_Function *function = tmalloc(sizeof(Obj_Function));
+  assert(function);
+
+  function->obj.kind = OBJ_FUNCTION;
+  function->obj.color = OBJ_UNMANAGED;
+  function->obj.next = *objects;
+  function->arity = arity;
+  function->name = name;
+  chunk_init(&function->chunk);
+  function->chunk.arity = arity;
+  function->upvalue_count = 0;
+  function->upvalues = NULL;
+  function->memo = false;
+  function->pos = 0;
+  function->lazy_source = NULL;
+  function->lazy_globals = 0;
+  function->native = NULL;
+
+  *objects = &function->obj;
+  return function;
+}
+
+void obj_function_free(Obj_Function *function)
+{
+  chunk_free(&function->chunk);
+  tfree(function->upvalues);
+  tfree(function);
+}
+
+size_t chunk_position_of(const Chunk *chunk, size_t offset)
+{
+  assert(chunk->positions.len > 0);
+
+  size_t lo = 0;
+  size_t hi = chunk->positions.len;
+  while (hi - lo > 1)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (chunk->positions.elems[mid].offset <= offset)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  return chunk->positions.elems[lo].pos;
+}
+
+const char *opcode_to_string(Opcode op)
+{
+  const char *str;
+
+  switch (op)
+  {
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) case OPC_##NAME: { str = #NAME; } break;
+    #include "defs/opcode.def"
+#undef X
+#define X4(NAME, A, B, C, D) case OPC_##NAME: { str = #NAME; } break;
+#define X2(NAME, A, B) X4(NAME, A, B, _, _)
+#define X3(NAME, A, B, C) X4(NAME, A, B, C, _)
+    #include "defs/superinstruction.def"
+#undef X2
+#undef X3
+#undef X4
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid opcode encountered: %i\n", op);
+    str = NULL;
+    assert(0);
+  } break;
+  }
+
+  return str;
+}
+
+size_t opcode_operand_count(Opcode op)
+{
+  size_t count;
+
+  switch (op)
+  {
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) case OPC_##NAME: { count = (OPERANDS); } break;
+    #include "defs/opcode.def"
+#undef X
+    // NOTE(HS): a superinstruction replaces the opcode byte of its first component,
+    // the remaining components stay in the code after it
+#define X4(NAME, A, B, C, D) case OPC_##NAME: { count = opcode_operand_count(OPC_##A); } break;
+#define X2(NAME, A, B) X4(NAME, A, B, _, _)
+#define X3(NAME, A, B, C) X4(NAME, A, B, C, _)
+    #include "defs/superinstruction.def"
+#undef X2
+#undef X3
+#undef X4
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid opcode encountered: %i\n", op);
+    count = 0;
+    assert(0);
+  } break;
+  }
+
+  return count;
+}
+
+int opcode_stack_effect(Opcode op)
+{
+  int effect;
+
+  switch (op)
+  {
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) case OPC_##NAME: { effect = (STACK_EFFECT); } break;
+    #include "defs/opcode.def"
+#undef X
+#define X4(NAME, A, B, C, D) case OPC_##NAME: { effect = opcode_stack_effect(OPC_##A); } break;
+#define X2(NAME, A, B) X4(NAME, A, B, _, _)
+#define X3(NAME, A, B, C) X4(NAME, A, B, C, _)
+    #include "defs/superinstruction.def"
+#undef X2
+#undef X3
+#undef X4
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid opcode encountered: %i\n", op);
+    effect = 0;
+    assert(0);
+  } break;
+  }
+
+  return effect;
+}
+
+size_t opcode_length(Opcode op)
+{
+  return 1 + opcode_operand_count(op) * CHUNK_OPERAND_SIZE;
+}
+
+Opcode opcode_generic_form(Opcode op)
+{
+  Opcode generic;
+
+  switch (op)
+  {
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) case OPC_##NAME: { generic = OPC_##GENERIC; } break;
+    #include "defs/opcode.def"
+#undef X
+#define X4(NAME, A, B, C, D) case OPC_##NAME: { generic = OPC_##A; } break;
+#define X2(NAME, A, B) X4(NAME, A, B, _, _)
+#define X3(NAME, A, B, C) X4(NAME, A, B, C, _)
+    #include "defs/superinstruction.def"
+#undef X2
+#undef X3
+#undef X4
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid opcode encountered: %i\n", op);
+    generic = op;
+    assert(0);
+  } break;
+  }
+
+  return generic;
+}
+
+// NOTE(HS): here rather than in jit.c as chunks own the code compiled from them, and
+// programs built with `tyger build` free chunks without linking the JIT
+void jit_code_free(Jit_Code *code)
+{
+  if (code)
+  {
+#if JIT_SUPPORTED
+    munmap(code->code, code->size);
+    tfree(code->entries);
+#endif
+    tfree(code);
+  }
+}
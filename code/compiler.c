@@ -0,0 +1,1627 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_COMPILER
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "bigint.h"
+#include "builtin.h"
+#include "phase_trace.h"
+#include "superinstruction.h"
+#include "tstrings.h"
+#include "util.h"
+
+static void compile_statement(Compiler *c, const Statement *stmt);
+static void compile_expression(Compiler *c, const Expression *expr);
+static bool compile_call_expression(Compiler *c, const Expression *expr, bool tail);
+static void compile_func_expression(Compiler *c, const Func_Expression *fexpr);
+
+typedef struct compiler_function
+{
+  const Func_Expression *fexpr;
+  Obj_Function *function;
+} Compiler_Function;
+
+typedef struct compiler_function_vaarray
+{
+  Compiler_Function *elems;
+  size_t capacity;
+  size_t len;
+} Compiler_Function_VaArray;
+
+/// an `IS_FUNCTION` guard, entry `index` of `chunk->guards`
+typedef struct compiler_guard
+{
+  const Func_Expression *fexpr;
+  Chunk *chunk;
+  size_t index;
+} Compiler_Guard;
+
+typedef struct compiler_guard_vaarray
+{
+  Compiler_Guard *elems;
+  size_t capacity;
+  size_t len;
+} Compiler_Guard_VaArray;
+
+/// NOTE(HS): the function a guard expects may be compiled after the code it's in, so
+/// guards are only filled in once the whole program has been compiled
+typedef struct compiler_functions
+{
+  Compiler_Function_VaArray compiled;
+  Compiler_Guard_VaArray guards;
+} Compiler_Functions;
+
+///
+/// internal functions
+///
+
+static void compiler_error(Compiler *c, Tyger_Error_Kind kind, const char *message)
+{
+  // NOTE(HS): only the first error is reported, anything after it is likely to be
+  // a knock on effect
+  if (c->err.kind != TYERR_NONE)
+  {
+    return;
+  }
+
+  size_t len = strlen(message);
+  char *owned = tmalloc(len + 1);
+  memcpy(owned, message, len + 1);
+
+  c->err = (Tyger_Error) {
+    .kind = kind,
+    .location = { .pos = c->pos, .col = 0, .line = 0 },
+    .message = owned,
+  };
+}
+
+static void compiler_adjust_stack(Compiler *c, int delta)
+{
+  assert(delta >= 0 || c->stack_depth >= (size_t) -delta);
+  c->stack_depth += delta;
+  if (c->stack_depth > c->chunk->max_stack)
+  {
+    c->chunk->max_stack = c->stack_depth;
+  }
+}
+
+static void emit_op(Compiler *c, Opcode op)
+{
+  assert(opcode_operand_count(op) == 0);
+  chunk_write(c->chunk, (uint8_t) op, c->pos);
+  compiler_adjust_stack(c, opcode_stack_effect(op));
+}
+
+static void emit_op_operand(Compiler *c, Opcode op, size_t operand)
+{
+  assert(opcode_operand_count(op) == 1);
+  if (operand > CHUNK_OPERAND_MAX)
+  {
+    compiler_error(c, TYERR_COMPILE_LIMIT, "operand too large to encode");
+    operand = 0;
+  }
+
+  chunk_write(c->chunk, (uint8_t) op, c->pos);
+  chunk_write_operand(c->chunk, (uint16_t) operand, c->pos);
+  compiler_adjust_stack(c, opcode_stack_effect(op));
+}
+
+static void emit_op_operands(Compiler *c, Opcode op, const size_t *operands, size_t count)
+{
+  assert(opcode_operand_count(op) == count);
+  chunk_write(c->chunk, (uint8_t) op, c->pos);
+  for (size_t i = 0; i < count; ++i)
+  {
+    size_t operand = operands[i];
+    if (operand > CHUNK_OPERAND_MAX)
+    {
+      compiler_error(c, TYERR_COMPILE_LIMIT, "operand too large to encode");
+      operand = 0;
+    }
+    chunk_write_operand(c->chunk, (uint16_t) operand, c->pos);
+  }
+  compiler_adjust_stack(c, opcode_stack_effect(op));
+}
+
+/// emits `op` (`LOAD_CONST` or `CLOSURE`) with `value` added to the constants
+static void emit_constant_op(Compiler *c, Opcode op, Value value)
+{
+  size_t index = chunk_add_constant(c->chunk, value);
+  if (index > CHUNK_OPERAND_MAX)
+  {
+    compiler_error(c, TYERR_COMPILE_LIMIT, "too many constants in one chunk");
+    return;
+  }
+  emit_op_operand(c, op, index);
+}
+
+static void emit_constant(Compiler *c, Value value)
+{
+  emit_constant_op(c, OPC_LOAD_CONST, value);
+}
+
+/// emits a forward jump, returning the offset of its operand to be patched later
+static size_t emit_jump(Compiler *c, Opcode op)
+{
+  emit_op_operand(c, op, 0);
+  return c->chunk->code.len - CHUNK_OPERAND_SIZE;
+}
+
+/// patches the jump with its operand at `operand_offset` to land on the next
+/// instruction emitted
+static void patch_jump(Compiler *c, size_t operand_offset)
+{
+  size_t distance = c->chunk->code.len - (operand_offset + CHUNK_OPERAND_SIZE);
+  if (distance > CHUNK_OPERAND_MAX)
+  {
+    compiler_error(c, TYERR_COMPILE_LIMIT, "too much code to jump over");
+    return;
+  }
+  chunk_patch_operand(c->chunk, operand_offset, (uint16_t) distance);
+}
+
+static void emit_loop(Compiler *c, size_t loop_start)
+{
+  size_t distance = (c->chunk->code.len + 1 + CHUNK_OPERAND_SIZE) - loop_start;
+  if (distance > CHUNK_OPERAND_MAX)
+  {
+    compiler_error(c, TYERR_COMPILE_LIMIT, "loop body too large");
+    distance = 0;
+  }
+  emit_op_operand(c, OPC_LOOP, distance);
+}
+
+static void compiler_use_global(Compiler *c, size_t slot)
+{
+  if (slot + 1 > c->chunk->global_count)
+  {
+    c->chunk->global_count = slot + 1;
+  }
+}
+
+static void emit_store(Compiler *c, const Binding *binding)
+{
+  switch (binding->kind)
+  {
+  case BINDING_GLOBAL:
+  {
+    compiler_use_global(c, binding->slot);
+    emit_op_operand(c, OPC_STORE_GLOBAL, binding->slot);
+  } break;
+
+  case BINDING_LOCAL:   { emit_op_operand(c, OPC_STORE_LOCAL, binding->slot); } break;
+  case BINDING_UPVALUE: { emit_op_operand(c, OPC_STORE_UPVALUE, binding->slot); } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Cannot store to binding %s\n", binding_kind_to_string(binding->kind));
+    assert(0);
+  } break;
+  }
+}
+
+/// NOTE(HS): string literals are stored as written in the source, escape sequences
+/// are only expanded when the literal becomes a runtime string
+static Value compiler_make_string(Compiler *c, const char *literal, size_t len)
+{
+  // NOTE(HS): escapes only ever shrink a literal
+  char *chars = tmalloc(len + 1);
+  assert(chars);
+
+  size_t out = 0;
+  for (size_t i = 0; i < len; ++i)
+  {
+    char ch = literal[i];
+    if (ch == '\\' && i + 1 < len)
+    {
+      i += 1;
+      switch (literal[i])
+      {
+      case 'n':  { ch = '\n'; } break;
+      case 't':  { ch = '\t'; } break;
+      case 'r':  { ch = '\r'; } break;
+      case '0':  { ch = '\0'; } break;
+      default:   { ch = literal[i]; } break;
+      }
+    }
+    chars[out++] = ch;
+  }
+
+  Value str = value_string_new(&c->chunk->objects, chars, out);
+  tfree(chars);
+  return str;
+}
+
+static inline const Expression *compiler_expression(const Compiler *c, Expression_Handle hndl)
+{
+  const Expression *expr = expression_handle_to_expression(c->program, hndl);
+  assert(expr);
+  return expr;
+}
+
+static inline const Statement *compiler_statement(const Compiler *c, Statement_Handle hndl)
+{
+  const Statement *stmt = statement_handle_to_statement(c->program, hndl);
+  assert(stmt);
+  return stmt;
+}
+
+static void compile_block_statement(Compiler *c, const Block_Statement *bs)
+{
+  size_t locals = 0;
+  for (size_t i = 0; i < bs->len; ++i)
+  {
+    const Statement *inner = compiler_statement(c, bs->first + i);
+    compile_statement(c, inner);
+    if (inner->kind == STMT_VAR && inner->statement.var_statement.binding.kind == BINDING_LOCAL)
+    {
+      locals += 1;
+    }
+  }
+
+  // NOTE(HS): captured locals outlive the block, `CLOSE_UPVALUES` moves them into
+  // their upvalues as it pops them
+  if (locals > 0)
+  {
+    emit_op_operand(c, bs->captures ? OPC_CLOSE_UPVALUES : OPC_POPN, locals);
+    compiler_adjust_stack(c, -(int) locals);
+  }
+}
+
+static void compile_if_statement(Compiler *c, const If_Statement *is)
+{
+  compile_expression(c, compiler_expression(c, is->condition));
+  size_t else_jump = emit_jump(c, OPC_JUMP_IF_FALSE);
+
+  compile_statement(c, compiler_statement(c, is->consequence));
+
+  if (is->has_alternative)
+  {
+    size_t end_jump = emit_jump(c, OPC_JUMP);
+    patch_jump(c, else_jump);
+    compile_statement(c, compiler_statement(c, is->alternative));
+    patch_jump(c, end_jump);
+  }
+  else
+  {
+    patch_jump(c, else_jump);
+  }
+}
+
+static void compile_while_statement(Compiler *c, const While_Statement *ws)
+{
+  size_t loop_start = c->chunk->code.len;
+
+  compile_expression(c, compiler_expression(c, ws->condition));
+  size_t exit_jump = emit_jump(c, OPC_JUMP_IF_FALSE);
+
+  compile_statement(c, compiler_statement(c, ws->body));
+  emit_loop(c, loop_start);
+
+  patch_jump(c, exit_jump);
+}
+
+static void compile_statement(Compiler *c, const Statement *stmt)
+{
+  c->pos = stmt->location.pos;
+
+  switch (stmt->kind)
+  {
+  case STMT_VAR:
+  {
+    const Var_Statement *vs = &stmt->statement.var_statement;
+    compile_expression(c, compiler_expression(c, vs->expression_handle));
+    c->pos = stmt->location.pos;
+
+    // NOTE(HS): locals live in the stack slot their initialiser was evaluated into
+    if (vs->binding.kind == BINDING_GLOBAL)
+    {
+      emit_store(c, &vs->binding);
+    }
+  } break;
+
+  case STMT_EXPRESSION:
+  {
+    Expression_Handle hndl = stmt->statement.expression_statement.expression_handle;
+    compile_expression(c, compiler_expression(c, hndl));
+    emit_op(c, OPC_POP);
+  } break;
+
+  case STMT_BLOCK:
+  {
+    compile_block_statement(c, &stmt->statement.block_statement);
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    compile_expression(c, compiler_expression(c, as->expression_handle));
+    c->pos = stmt->location.pos;
+    emit_store(c, &as->binding);
+  } break;
+
+  case STMT_IF:
+  {
+    compile_if_statement(c, &stmt->statement.if_statement);
+  } break;
+
+  case STMT_WHILE:
+  {
+    compile_while_statement(c, &stmt->statement.while_statement);
+  } break;
+
+  case STMT_RETURN:
+  {
+    // NOTE(HS): `return f(...)` is always a tail call, which replaces the running
+    // call rather than returning to it
+    const Return_Statement *rs = &stmt->statement.return_statement;
+    const Expression *value = rs->has_value ? compiler_expression(c, rs->expression_handle) : NULL;
+    if (value && value->kind == EXPR_CALL)
+    {
+      // NOTE(HS): builtins aren't tail called, their result is returned as usual
+      if (compile_call_expression(c, value, true))
+      {
+        break;
+      }
+      c->pos = stmt->location.pos;
+    }
+    else if (value)
+    {
+      compile_expression(c, value);
+      c->pos = stmt->location.pos;
+    }
+    else
+    {
+      emit_op(c, OPC_LOAD_NIL);
+    }
+    emit_op(c, OPC_RETURN);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Statement_Kind %s (%i)\n",
+      statement_kind_to_string(stmt->kind), stmt->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+static Opcode infix_operator_to_opcode(Operator op)
+{
+  Opcode result = OPC_ADD;
+  switch (op)
+  {
+  case OP_PLUS:     { result = OPC_ADD; } break;
+  case OP_MINUS:    { result = OPC_SUB; } break;
+  case OP_ASTERISK: { result = OPC_MUL; } break;
+  case OP_SLASH:    { result = OPC_DIV; } break;
+  case OP_EQ:       { result = OPC_EQ; } break;
+  case OP_NOT_EQ:   { result = OPC_NOT_EQ; } break;
+  case OP_LT:       { result = OPC_LT; } break;
+  case OP_GT:       { result = OPC_GT; } break;
+  case OP_LTE:      { result = OPC_LTE; } break;
+  case OP_GTE:      { result = OPC_GTE; } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid infix operator %s\n", operator_to_string(op));
+    assert(0);
+  } break;
+  }
+  return result;
+}
+
+/// when `tail` the call replaces the running call, returns whether it did (calls to
+/// builtins never do, they don't have frames to replace)
+static bool compile_call_expression(Compiler *c, const Expression *expr, bool tail)
+{
+  const Call_Expression *cexpr = &expr->expression.call_expression;
+  const Expression *function = compiler_expression(c, cexpr->function);
+  size_t argc = cexpr->args_len;
+
+  const Binding *binding = NULL;
+  if (function->kind == EXPR_IDENT)
+  {
+    binding = &function->expression.ident_expression.binding;
+  }
+
+  // NOTE(HS): globals are called without pushing the callee, the function is
+  // read from the global table (or the call site's cache) once the arguments
+  // have been evaluated
+  bool is_direct = binding && (binding->kind == BINDING_BUILTIN || binding->kind == BINDING_GLOBAL);
+  if (!is_direct)
+  {
+    compile_expression(c, function);
+  }
+
+  for (size_t i = 0; i < argc; ++i)
+  {
+    compile_expression(c, compiler_expression(c, cexpr->args_first + i));
+  }
+  c->pos = expr->location.pos;
+
+  if (binding && binding->kind == BINDING_BUILTIN)
+  {
+    const Builtin *builtin = &BUILTINS[binding->slot];
+    if (!builtin_accepts(builtin, argc))
+    {
+      char message[128];
+      snprintf(
+        message, sizeof(message), "%s expects %i argument(s) but was given %zu",
+        builtin->name, builtin->arity, argc
+      );
+      compiler_error(c, TYERR_ARITY_MISMATCH, message);
+    }
+
+    size_t operands[] = { binding->slot, argc };
+    emit_op_operands(c, OPC_CALL_NATIVE, operands, 2);
+    compiler_adjust_stack(c, 1 - (int) argc);
+    return false;
+  }
+
+  if (binding && binding->kind == BINDING_GLOBAL)
+  {
+    compiler_use_global(c, binding->slot);
+    size_t operands[] = { binding->slot, argc, chunk_add_call_cache(c->chunk) };
+    emit_op_operands(c, tail ? OPC_TAIL_CALL_GLOBAL : OPC_CALL_GLOBAL, operands, 3);
+    compiler_adjust_stack(c, 1 - (int) argc);
+  }
+  else
+  {
+    size_t operands[] = { argc, chunk_add_call_cache(c->chunk) };
+    emit_op_operands(c, tail ? OPC_TAIL_CALL : OPC_CALL, operands, 2);
+    compiler_adjust_stack(c, -(int) argc);
+  }
+  return tail;
+}
+
+///
+/// compiling the optimised IR
+///
+
+/// NOTE(HS): values are kept in three ways. Constants and parameters are loaded
+/// wherever they're used. A value used once, later in the block it's made in, is left
+/// on the stack for its use when the operands in between leave it on top by then, a
+/// `temp`. Everything else (phis included) gets a slot of its own above the
+/// parameters, reserved when the function is entered and reused once the value in it
+/// is dead. Every block starts and ends with just the parameters and those slots on
+/// the stack.
+typedef struct ir_fixup
+{
+  size_t operand_offset;
+  Ir_Block_Id target;
+} Ir_Fixup;
+
+typedef struct ir_fixup_vaarray
+{
+  Ir_Fixup *elems;
+  size_t capacity;
+  size_t len;
+} Ir_Fixup_VaArray;
+
+typedef struct ir_lowering
+{
+  Compiler *c;
+  Ir_Function *fn;
+  bool is_script;
+
+  /// indexed by value
+  size_t *uses;
+  bool *temp;
+  size_t *slot;
+  size_t *constant;
+
+  /// indexed by block, the offset of its first instruction once emitted
+  size_t *block_start;
+  Ir_Fixup_VaArray fixups;
+  size_t registers;
+} Ir_Lowering;
+
+#define IR_NO_SLOT SIZE_MAX
+
+static bool ir_has_result(Ir_Op op)
+{
+  return !(ir_op_flags(op) & IR_TERMINATOR) && op != IR_STORE_GLOBAL && op != IR_STORE_UPVALUE;
+}
+
+static bool ir_is_loadable(Ir_Op op)
+{
+  return op == IR_CONST_INT || op == IR_CONST_BIGINT || op == IR_CONST_STRING
+    || op == IR_CONST_BOOL || op == IR_CONST_NIL || op == IR_PARAM;
+}
+
+static inline Ir_Value ir_operand(const Ir_Lowering *l, const Ir_Instr *instr, size_t i)
+{
+  return ir_resolve(l->fn, instr->args.elems[i]);
+}
+
+/// whether `v` needs a slot of its own
+static bool ir_needs_slot(const Ir_Lowering *l, Ir_Value v)
+{
+  const Ir_Instr *instr = &l->fn->instrs.elems[v];
+  return !instr->removed && ir_has_result(instr->op) && !ir_is_loadable(instr->op)
+    && l->uses[v] > 0 && !l->temp[v];
+}
+
+/// the number of operands of `instr` at the start of its list which are temps
+static size_t ir_leading_temps(const Ir_Lowering *l, const Ir_Instr *instr)
+{
+  size_t k = 0;
+  while (k < instr->args.len && l->temp[ir_operand(l, instr, k)])
+  {
+    k += 1;
+  }
+  return k;
+}
+
+/// Picks the temps of a block, starting from every value used once later in it and
+/// running through the block as it'll be emitted. When an instruction's temps aren't
+/// the first of its operands, or aren't on top of the stack in order, they're given
+/// slots and the block is run through again.
+static void ir_plan_temps(Ir_Lowering *l, Ir_Block_Id id, Ir_Id_VaArray *stack)
+{
+  const Ir_Block *block = &l->fn->blocks.elems[id];
+  bool replan = true;
+  while (replan)
+  {
+    replan = false;
+    stack->len = 0;
+    for (size_t i = 0; i < block->instrs.len && !replan; ++i)
+    {
+      Ir_Value v = block->instrs.elems[i];
+      const Ir_Instr *instr = &l->fn->instrs.elems[v];
+      size_t k = ir_leading_temps(l, instr);
+      for (size_t j = k; j < instr->args.len; ++j)
+      {
+        Ir_Value arg = ir_operand(l, instr, j);
+        if (l->temp[arg])
+        {
+          l->temp[arg] = false;
+          replan = true;
+        }
+      }
+
+      bool on_top = stack->len >= k;
+      for (size_t j = 0; on_top && j < k; ++j)
+      {
+        on_top = stack->elems[stack->len - k + j] == ir_operand(l, instr, j);
+      }
+      if (!on_top)
+      {
+        for (size_t j = 0; j < k; ++j)
+        {
+          l->temp[ir_operand(l, instr, j)] = false;
+        }
+        replan = true;
+      }
+      if (replan)
+      {
+        break;
+      }
+
+      stack->len -= k;
+      if (l->temp[v])
+      {
+        va_array_append(*stack, v);
+      }
+    }
+  }
+  assert(stack->len == 0);
+}
+
+static void ir_plan(Ir_Lowering *l)
+{
+  Ir_Function *fn = l->fn;
+  size_t len = fn->instrs.len;
+  Ir_Value *user = tmalloc(len * sizeof(Ir_Value));
+  assert(user);
+
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    const Ir_Block *block = &fn->blocks.elems[fn->order.elems[i]];
+    const Ir_Id_VaArray *lists[] = { &block->phis, &block->instrs };
+    for (size_t list = 0; list < 2; ++list)
+    {
+      for (size_t j = 0; j < lists[list]->len; ++j)
+      {
+        Ir_Value v = lists[list]->elems[j];
+        const Ir_Instr *instr = &fn->instrs.elems[v];
+        for (size_t k = 0; k < instr->args.len; ++k)
+        {
+          Ir_Value arg = ir_operand(l, instr, k);
+          l->uses[arg] += 1;
+          user[arg] = v;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    const Ir_Block *block = &fn->blocks.elems[fn->order.elems[i]];
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      Ir_Value v = block->instrs.elems[j];
+      const Ir_Instr *instr = &fn->instrs.elems[v];
+      if (l->uses[v] == 1 && ir_has_result(instr->op) && !ir_is_loadable(instr->op))
+      {
+        const Ir_Instr *use = &fn->instrs.elems[user[v]];
+        l->temp[v] = use->op != IR_PHI && use->block == instr->block;
+      }
+    }
+  }
+  tfree(user);
+
+  Ir_Id_VaArray stack = { NULL, 0, 0 };
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    ir_plan_temps(l, fn->order.elems[i], &stack);
+  }
+  va_array_free(stack);
+}
+
+/// A liveness range over the blocks as they're laid out, in which a value's slot
+/// can't be given to another.
+typedef struct ir_range
+{
+  Ir_Value value;
+  size_t first;
+  size_t last;
+} Ir_Range;
+
+static void ir_range_extend(Ir_Range *range, size_t point)
+{
+  if (point < range->first)
+  {
+    range->first = point;
+  }
+  if (point > range->last)
+  {
+    range->last = point;
+  }
+}
+
+static int ir_range_compare(const void *a, const void *b)
+{
+  const Ir_Range *lhs = a;
+  const Ir_Range *rhs = b;
+  return (lhs->first > rhs->first) - (lhs->first < rhs->first);
+}
+
+static inline bool ir_bit(const uint64_t *set, size_t i)
+{
+  return (set[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void ir_set_bit(uint64_t *set, size_t i)
+{
+  set[i / 64] |= (uint64_t) 1 << (i % 64);
+}
+
+/// Gives every value which needs one a slot, by linear scan over ranges found from
+/// the values live in and out of each block.
+///
+/// NOTE(HS): the copies into a block's phis happen at the end of each predecessor, so
+/// a phi's range covers those ends as well as its own block.
+static void ir_allocate_slots(Ir_Lowering *l)
+{
+  Ir_Function *fn = l->fn;
+  size_t len = fn->instrs.len;
+  size_t *dense = tmalloc(len * sizeof(size_t));
+  assert(dense);
+  size_t values = 0;
+  for (size_t v = 0; v < len; ++v)
+  {
+    dense[v] = ir_needs_slot(l, (Ir_Value) v) ? values++ : IR_NO_SLOT;
+  }
+
+  size_t words = (values + 63) / 64;
+  size_t blocks_len = fn->blocks.len;
+  uint64_t *live_in = tcalloc(blocks_len * words + 1, sizeof(uint64_t));
+  uint64_t *live_out = tcalloc(blocks_len * words + 1, sizeof(uint64_t));
+  uint64_t *gen = tcalloc(blocks_len * words + 1, sizeof(uint64_t));
+  uint64_t *kill = tcalloc(blocks_len * words + 1, sizeof(uint64_t));
+  assert(live_in && live_out && gen && kill);
+
+  // NOTE(HS): phi operands are used at the end of the predecessor they come from
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    const Ir_Block *block = &fn->blocks.elems[id];
+    uint64_t *block_gen = &gen[id * words];
+    uint64_t *block_kill = &kill[id * words];
+    for (size_t j = 0; j < block->phis.len; ++j)
+    {
+      Ir_Value phi = block->phis.elems[j];
+      if (dense[phi] != IR_NO_SLOT)
+      {
+        ir_set_bit(block_kill, dense[phi]);
+      }
+    }
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      Ir_Value v = block->instrs.elems[j];
+      const Ir_Instr *instr = &fn->instrs.elems[v];
+      for (size_t k = 0; k < instr->args.len; ++k)
+      {
+        size_t arg = dense[ir_operand(l, instr, k)];
+        if (arg != IR_NO_SLOT && !ir_bit(block_kill, arg))
+        {
+          ir_set_bit(block_gen, arg);
+        }
+      }
+      if (dense[v] != IR_NO_SLOT)
+      {
+        ir_set_bit(block_kill, dense[v]);
+      }
+    }
+  }
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i = fn->order.len; i-- > 0;)
+    {
+      Ir_Block_Id id = fn->order.elems[i];
+      const Ir_Block *block = &fn->blocks.elems[id];
+      uint64_t *out = &live_out[id * words];
+      for (size_t s = 0; s < block->succs_len; ++s)
+      {
+        Ir_Block_Id succ_id = block->succs[s];
+        const Ir_Block *succ = &fn->blocks.elems[succ_id];
+        for (size_t w = 0; w < words; ++w)
+        {
+          out[w] |= live_in[succ_id * words + w];
+        }
+        for (size_t p = 0; p < succ->preds.len; ++p)
+        {
+          if (succ->preds.elems[p] != id)
+          {
+            continue;
+          }
+          for (size_t j = 0; j < succ->phis.len; ++j)
+          {
+            size_t arg = dense[ir_operand(l, &fn->instrs.elems[succ->phis.elems[j]], p)];
+            if (arg != IR_NO_SLOT)
+            {
+              ir_set_bit(out, arg);
+            }
+          }
+        }
+      }
+
+      uint64_t *in = &live_in[id * words];
+      for (size_t w = 0; w < words; ++w)
+      {
+        uint64_t next = gen[id * words + w] | (out[w] & ~kill[id * words + w]);
+        changed = changed || next != in[w];
+        in[w] = next;
+      }
+    }
+  }
+
+  // NOTE(HS): each block takes up a point for its start, one for each instruction
+  // and one for its end
+  Ir_Range *ranges = tmalloc((values + 1) * sizeof(Ir_Range));
+  assert(ranges);
+  for (size_t v = 0; v < len; ++v)
+  {
+    if (dense[v] != IR_NO_SLOT)
+    {
+      ranges[dense[v]] = (Ir_Range) { .value = (Ir_Value) v, .first = SIZE_MAX, .last = 0 };
+    }
+  }
+
+  size_t *block_end = tmalloc((blocks_len + 1) * sizeof(size_t));
+  assert(block_end);
+  size_t point = 0;
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    point += fn->blocks.elems[id].instrs.len + 2;
+    block_end[id] = point - 1;
+  }
+
+  point = 0;
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    const Ir_Block *block = &fn->blocks.elems[id];
+    size_t start = point++;
+    for (size_t r = 0; r < values; ++r)
+    {
+      if (ir_bit(&live_in[id * words], r))
+      {
+        ir_range_extend(&ranges[r], start);
+      }
+      if (ir_bit(&live_out[id * words], r))
+      {
+        ir_range_extend(&ranges[r], block_end[id]);
+      }
+    }
+
+    for (size_t j = 0; j < block->phis.len; ++j)
+    {
+      Ir_Value phi = block->phis.elems[j];
+      const Ir_Instr *instr = &fn->instrs.elems[phi];
+      if (dense[phi] == IR_NO_SLOT)
+      {
+        continue;
+      }
+      ir_range_extend(&ranges[dense[phi]], start);
+      for (size_t p = 0; p < block->preds.len; ++p)
+      {
+        ir_range_extend(&ranges[dense[phi]], block_end[block->preds.elems[p]]);
+        size_t arg = dense[ir_operand(l, instr, p)];
+        if (arg != IR_NO_SLOT)
+        {
+          ir_range_extend(&ranges[arg], block_end[block->preds.elems[p]]);
+        }
+      }
+    }
+
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      Ir_Value v = block->instrs.elems[j];
+      const Ir_Instr *instr = &fn->instrs.elems[v];
+      size_t at = point++;
+      if (dense[v] != IR_NO_SLOT)
+      {
+        ir_range_extend(&ranges[dense[v]], at);
+      }
+      for (size_t k = 0; k < instr->args.len; ++k)
+      {
+        size_t arg = dense[ir_operand(l, instr, k)];
+        if (arg != IR_NO_SLOT)
+        {
+          ir_range_extend(&ranges[arg], at);
+        }
+      }
+    }
+    point += 1;
+  }
+
+  // NOTE(HS): ranges which overlap, even at one point, are given different slots
+  qsort(ranges, values, sizeof(Ir_Range), ir_range_compare);
+  size_t *slot_free_after = tmalloc((values + 1) * sizeof(size_t));
+  assert(slot_free_after);
+  l->registers = 0;
+  for (size_t r = 0; r < values; ++r)
+  {
+    size_t slot = 0;
+    while (slot < l->registers && slot_free_after[slot] >= ranges[r].first)
+    {
+      slot += 1;
+    }
+    if (slot == l->registers)
+    {
+      l->registers += 1;
+    }
+    slot_free_after[slot] = ranges[r].last;
+    l->slot[ranges[r].value] = fn->arity + slot;
+  }
+
+  tfree(slot_free_after);
+  tfree(block_end);
+  tfree(ranges);
+  tfree(kill);
+  tfree(gen);
+  tfree(live_out);
+  tfree(live_in);
+  tfree(dense);
+}
+
+/// adds a guard for the function compiled from `fexpr` to the chunk, returning its index
+static size_t compiler_add_guard(Compiler *c, const Func_Expression *fexpr)
+{
+  size_t index = va_array_next_handle(c->chunk->guards);
+  if (index > CHUNK_OPERAND_MAX)
+  {
+    compiler_error(c, TYERR_COMPILE_LIMIT, "too many inlined calls in one chunk");
+    return 0;
+  }
+
+  Obj_Function *expected = NULL;
+  va_array_append(c->chunk->guards, expected);
+  Compiler_Guard guard = { .fexpr = fexpr, .chunk = c->chunk, .index = index };
+  va_array_append(c->functions->guards, guard);
+  return index;
+}
+
+/// emits `op` with its constant `value`, which is only added to the chunk once
+static void ir_emit_constant(Ir_Lowering *l, Ir_Value v, Value value)
+{
+  if (l->constant[v] == IR_NO_SLOT)
+  {
+    l->constant[v] = chunk_add_constant(l->c->chunk, value);
+  }
+  if (l->constant[v] > CHUNK_OPERAND_MAX)
+  {
+    compiler_error(l->c, TYERR_COMPILE_LIMIT, "too many constants in one chunk");
+    return;
+  }
+  emit_op_operand(l->c, OPC_LOAD_CONST, l->constant[v]);
+}
+
+/// pushes a value which isn't a temp
+static void ir_emit_load(Ir_Lowering *l, Ir_Value v)
+{
+  Compiler *c = l->c;
+  const Ir_Instr *instr = &l->fn->instrs.elems[v];
+  switch (instr->op)
+  {
+  case IR_CONST_INT:  { emit_constant(c, make_int_value(instr->as.integer)); } break;
+  case IR_CONST_BOOL: { emit_op(c, instr->as.boolean ? OPC_LOAD_TRUE : OPC_LOAD_FALSE); } break;
+  case IR_CONST_NIL:  { emit_op(c, OPC_LOAD_NIL); } break;
+  case IR_PARAM:      { emit_op_operand(c, OPC_LOAD_LOCAL, instr->as.slot); } break;
+
+  case IR_CONST_STRING:
+  {
+    Value str = l->constant[v] == IR_NO_SLOT
+      ? compiler_make_string(c, instr->as.literal.chars, instr->as.literal.len)
+      : make_nil_value();
+    ir_emit_constant(l, v, str);
+  } break;
+
+  case IR_CONST_BIGINT:
+  {
+    Value big = l->constant[v] == IR_NO_SLOT
+      ? bigint_from_decimal(&c->chunk->objects, instr->as.literal.chars, instr->as.literal.len)
+      : make_nil_value();
+    ir_emit_constant(l, v, big);
+  } break;
+
+  default:
+  {
+    assert(l->slot[v] != IR_NO_SLOT);
+    emit_op_operand(c, OPC_LOAD_LOCAL, l->slot[v]);
+  } break;
+  }
+}
+
+/// pushes the operands of `instr` from `first` on, those before are temps already
+/// on the stack
+static void ir_emit_operands(Ir_Lowering *l, const Ir_Instr *instr, size_t first)
+{
+  for (size_t i = first; i < instr->args.len; ++i)
+  {
+    ir_emit_load(l, ir_operand(l, instr, i));
+  }
+}
+
+/// jumps to `target`, unless it's the block laid out next and `may_fall_through`
+static void ir_emit_goto(Ir_Lowering *l, size_t index, Ir_Block_Id target, bool may_fall_through)
+{
+  const Ir_Function *fn = l->fn;
+  if (may_fall_through && index + 1 < fn->order.len && fn->order.elems[index + 1] == target)
+  {
+    return;
+  }
+  if (l->block_start[target] != IR_NO_SLOT)
+  {
+    emit_loop(l->c, l->block_start[target]);
+    return;
+  }
+  Ir_Fixup fixup = { .operand_offset = emit_jump(l->c, OPC_JUMP), .target = target };
+  va_array_append(l->fixups, fixup);
+}
+
+/// the copies into the phis of the block `from` jumps to, every operand is pushed
+/// before any is stored so phis which read each other see the values from before
+static void ir_emit_phi_copies(Ir_Lowering *l, Ir_Block_Id from, Ir_Block_Id to)
+{
+  const Ir_Block *block = &l->fn->blocks.elems[to];
+  size_t pred = 0;
+  while (block->preds.elems[pred] != from)
+  {
+    pred += 1;
+  }
+
+  size_t copies = 0;
+  for (size_t i = 0; i < block->phis.len; ++i)
+  {
+    Ir_Value phi = block->phis.elems[i];
+    if (l->slot[phi] != IR_NO_SLOT)
+    {
+      ir_emit_load(l, ir_operand(l, &l->fn->instrs.elems[phi], pred));
+      copies += 1;
+    }
+  }
+  for (size_t i = block->phis.len; copies > 0 && i-- > 0;)
+  {
+    Ir_Value phi = block->phis.elems[i];
+    if (l->slot[phi] != IR_NO_SLOT)
+    {
+      emit_op_operand(l->c, OPC_STORE_LOCAL, l->slot[phi]);
+    }
+  }
+}
+
+static Opcode ir_op_to_opcode(Ir_Op op)
+{
+  Opcode result = OPC_ADD;
+  switch (op)
+  {
+  case IR_NEGATE: { result = OPC_NEGATE; } break;
+  case IR_NOT:    { result = OPC_NOT; } break;
+  case IR_ADD:    { result = OPC_ADD; } break;
+  case IR_SUB:    { result = OPC_SUB; } break;
+  case IR_MUL:    { result = OPC_MUL; } break;
+  case IR_DIV:    { result = OPC_DIV; } break;
+  case IR_EQ:     { result = OPC_EQ; } break;
+  case IR_NOT_EQ: { result = OPC_NOT_EQ; } break;
+  case IR_LT:     { result = OPC_LT; } break;
+  case IR_GT:     { result = OPC_GT; } break;
+  case IR_LTE:    { result = OPC_LTE; } break;
+  case IR_GTE:    { result = OPC_GTE; } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] IR op %s has no single opcode\n", ir_op_to_string(op));
+    assert(0);
+  } break;
+  }
+  return result;
+}
+
+static void ir_emit_instr(Ir_Lowering *l, size_t index, Ir_Value v)
+{
+  Compiler *c = l->c;
+  const Ir_Instr *instr = &l->fn->instrs.elems[v];
+  if (ir_is_loadable(instr->op))
+  {
+    return;
+  }
+
+  c->pos = instr->pos;
+  size_t argc = instr->args.len;
+  if (instr->op != IR_RETURN)
+  {
+    ir_emit_operands(l, instr, ir_leading_temps(l, instr));
+  }
+
+  switch (instr->op)
+  {
+  case IR_FUNCTION:
+  case IR_CLOSURE:
+  {
+    compile_func_expression(c, instr->as.function);
+  } break;
+
+  case IR_LOAD_GLOBAL:
+  {
+    compiler_use_global(c, instr->as.slot);
+    emit_op_operand(c, OPC_LOAD_GLOBAL, instr->as.slot);
+  } break;
+
+  case IR_STORE_GLOBAL:
+  {
+    compiler_use_global(c, instr->as.slot);
+    emit_op_operand(c, OPC_STORE_GLOBAL, instr->as.slot);
+  } break;
+
+  case IR_LOAD_UPVALUE:  { emit_op_operand(c, OPC_LOAD_UPVALUE, instr->as.slot); } break;
+  case IR_STORE_UPVALUE: { emit_op_operand(c, OPC_STORE_UPVALUE, instr->as.slot); } break;
+
+  case IR_IS_FUNCTION:
+  {
+    emit_op_operand(c, OPC_IS_FUNCTION, compiler_add_guard(c, instr->as.function));
+  } break;
+
+  case IR_CALL_NATIVE:
+  {
+    size_t operands[] = { instr->as.slot, argc };
+    emit_op_operands(c, OPC_CALL_NATIVE, operands, 2);
+    compiler_adjust_stack(c, 1 - (int) argc);
+  } break;
+
+  case IR_CALL:
+  case IR_TAIL_CALL:
+  {
+    size_t operands[] = { argc - 1, chunk_add_call_cache(c->chunk) };
+    emit_op_operands(c, instr->op == IR_CALL ? OPC_CALL : OPC_TAIL_CALL, operands, 2);
+    compiler_adjust_stack(c, 1 - (int) argc);
+  } break;
+
+  case IR_CALL_GLOBAL:
+  case IR_TAIL_CALL_GLOBAL:
+  {
+    compiler_use_global(c, instr->as.slot);
+    size_t operands[] = { instr->as.slot, argc, chunk_add_call_cache(c->chunk) };
+    emit_op_operands(c, instr->op == IR_CALL_GLOBAL ? OPC_CALL_GLOBAL : OPC_TAIL_CALL_GLOBAL, operands, 3);
+    compiler_adjust_stack(c, 1 - (int) argc);
+  } break;
+
+  case IR_RETURN:
+  {
+    // NOTE(HS): the script's stack has to be empty once it returns, it only ever
+    // returns nil
+    Ir_Value value = ir_operand(l, instr, 0);
+    if (l->is_script && l->registers > 0)
+    {
+      assert(ir_is_loadable(l->fn->instrs.elems[value].op));
+      emit_op_operand(c, OPC_POPN, l->registers);
+      compiler_adjust_stack(c, -(int) l->registers);
+    }
+    if (!l->temp[value])
+    {
+      ir_emit_load(l, value);
+    }
+    emit_op(c, OPC_RETURN);
+  } break;
+
+  case IR_JUMP:
+  {
+    Ir_Block_Id from = instr->block;
+    Ir_Block_Id to = l->fn->blocks.elems[from].succs[0];
+    ir_emit_phi_copies(l, from, to);
+    ir_emit_goto(l, index, to, true);
+  } break;
+
+  case IR_BRANCH:
+  {
+    const Ir_Block *block = &l->fn->blocks.elems[instr->block];
+    Ir_Block_Id if_true = block->succs[0];
+    Ir_Block_Id if_false = block->succs[1];
+    if (l->block_start[if_false] == IR_NO_SLOT)
+    {
+      Ir_Fixup fixup = { .operand_offset = emit_jump(c, OPC_JUMP_IF_FALSE), .target = if_false };
+      va_array_append(l->fixups, fixup);
+      ir_emit_goto(l, index, if_true, true);
+    }
+    else
+    {
+      // NOTE(HS): conditional jumps only go forwards, to a jump back
+      size_t skip = emit_jump(c, OPC_JUMP_IF_FALSE);
+      ir_emit_goto(l, index, if_true, false);
+      patch_jump(c, skip);
+      emit_loop(c, l->block_start[if_false]);
+    }
+  } break;
+
+  default:
+  {
+    emit_op(c, ir_op_to_opcode(instr->op));
+  } break;
+  }
+
+  if (!ir_has_result(instr->op) || l->temp[v])
+  {
+    return;
+  }
+  if (l->uses[v] == 0)
+  {
+    emit_op(c, OPC_POP);
+  }
+  else
+  {
+    emit_op_operand(c, OPC_STORE_LOCAL, l->slot[v]);
+  }
+}
+
+/// compiles `fn`, which has been optimised, into `c->chunk`
+static void compile_ir_function(Compiler *c, Ir_Function *fn)
+{
+  ir_split_critical_edges(fn);
+  size_t len = fn->instrs.len;
+  Ir_Lowering l = {
+    .c = c,
+    .fn = fn,
+    .is_script = fn->fexpr == NULL,
+    .uses = tcalloc(len + 1, sizeof(size_t)),
+    .temp = tcalloc(len + 1, sizeof(bool)),
+    .slot = tmalloc((len + 1) * sizeof(size_t)),
+    .constant = tmalloc((len + 1) * sizeof(size_t)),
+    .block_start = tmalloc((fn->blocks.len + 1) * sizeof(size_t)),
+    .fixups = { NULL, 0, 0 },
+    .registers = 0,
+  };
+  assert(l.uses && l.temp && l.slot && l.constant && l.block_start);
+  for (size_t i = 0; i < len; ++i)
+  {
+    l.slot[i] = IR_NO_SLOT;
+    l.constant[i] = IR_NO_SLOT;
+  }
+  for (size_t i = 0; i < fn->blocks.len; ++i)
+  {
+    l.block_start[i] = IR_NO_SLOT;
+  }
+
+  ir_plan(&l);
+  ir_allocate_slots(&l);
+
+  compiler_adjust_stack(c, (int) fn->arity);
+  if (l.registers > 0)
+  {
+    emit_op_operand(c, OPC_RESERVE, l.registers);
+    compiler_adjust_stack(c, (int) l.registers);
+  }
+
+  size_t depth = fn->arity + l.registers;
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    const Ir_Block *block = &fn->blocks.elems[id];
+    l.block_start[id] = c->chunk->code.len;
+    c->stack_depth = depth;
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      ir_emit_instr(&l, i, block->instrs.elems[j]);
+    }
+  }
+
+  for (size_t i = 0; i < l.fixups.len; ++i)
+  {
+    const Ir_Fixup *fixup = &l.fixups.elems[i];
+    size_t distance = l.block_start[fixup->target] - (fixup->operand_offset + CHUNK_OPERAND_SIZE);
+    if (distance > CHUNK_OPERAND_MAX)
+    {
+      compiler_error(c, TYERR_COMPILE_LIMIT, "too much code to jump over");
+      break;
+    }
+    chunk_patch_operand(c->chunk, fixup->operand_offset, (uint16_t) distance);
+  }
+  c->stack_depth = 0;
+
+  va_array_free(l.fixups);
+  tfree(l.block_start);
+  tfree(l.constant);
+  tfree(l.slot);
+  tfree(l.temp);
+  tfree(l.uses);
+}
+
+/// compiles the function `fexpr` (the script when NULL) through the IR, returns false
+/// without emitting anything when the IR can't represent it
+static bool compile_optimised(Compiler *c, const Func_Expression *fexpr)
+{
+  Phase_Scope phase = phase_begin("optimise");
+  Ir_Function fn;
+  bool ok = ir_build_function(&fn, c->program, fexpr);
+  if (ok)
+  {
+    ir_optimise(&fn, c->options.ir);
+  }
+  phase_end(phase);
+
+  if (ok)
+  {
+    compile_ir_function(c, &fn);
+  }
+  ir_function_free(&fn);
+  return ok;
+}
+
+static void compiler_finish(Compiler *c)
+{
+  assert(c->err.kind != TYERR_NONE || c->stack_depth == 0);
+  c->chunk->source = c->options.source;
+  if (c->err.kind == TYERR_NONE && c->options.superinstructions)
+  {
+    superinstructions_fuse(c->chunk);
+  }
+}
+
+/// compiles the body of `fexpr` into `inner`, a compiler of its own chunk
+static void compile_function_body(Compiler *inner, const Func_Expression *fexpr)
+{
+  // NOTE(HS): the arguments are already in slots `0..arity` when the body runs,
+  // and are discarded along with the rest of the frame by `RETURN`
+  if (!(inner->options.optimise && compile_optimised(inner, fexpr)))
+  {
+    compiler_adjust_stack(inner, (int) fexpr->params_len);
+    compile_statement(inner, compiler_statement(inner, fexpr->body));
+    emit_op(inner, OPC_LOAD_NIL);
+    emit_op(inner, OPC_RETURN);
+    compiler_adjust_stack(inner, -(int) fexpr->params_len);
+  }
+  compiler_finish(inner);
+}
+
+/// NOTE(HS): a guard whose literal was never compiled (e.g. it was only reached
+/// through code which was optimised away) is left NULL and never passes
+static void compiler_resolve_guards(Compiler_Functions *functions)
+{
+  for (size_t i = 0; i < functions->guards.len; ++i)
+  {
+    const Compiler_Guard *guard = &functions->guards.elems[i];
+    for (size_t j = 0; j < functions->compiled.len; ++j)
+    {
+      if (functions->compiled.elems[j].fexpr == guard->fexpr)
+      {
+        guard->chunk->guards.elems[guard->index] = functions->compiled.elems[j].function;
+        break;
+      }
+    }
+  }
+  va_array_free(functions->compiled);
+  va_array_free(functions->guards);
+}
+
+/// finds the globals of `prog` once for every function in it to inline with, returns
+/// whether `globals` was filled in and has to be freed
+static bool compiler_find_globals(const Program *prog, Compiler_Options *options, Ir_Globals *globals)
+{
+  if (!options->optimise || !options->ir.inline_calls || options->ir.globals)
+  {
+    return false;
+  }
+  ir_globals_init(globals, prog);
+  options->ir.globals = globals;
+  return true;
+}
+
+static void compile_func_expression(Compiler *c, const Func_Expression *fexpr)
+{
+  Obj_String *name = NULL;
+  if (fexpr->name != FUNC_ANONYMOUS)
+  {
+    const char *ident = ident_handle_to_ident(c->program, fexpr->name);
+    name = obj_string_new(&c->chunk->objects, ident, strlen(ident));
+  }
+  Obj_Function *function = obj_function_new(&c->chunk->objects, name, fexpr->params_len);
+  function->memo = fexpr->memo;
+  function->pos = func_expression_pos(fexpr);
+  Compiler_Function compiled = { .fexpr = fexpr, .function = function };
+  va_array_append(c->functions->compiled, compiled);
+
+  // NOTE(HS): a lazy literal never captures anything, see `resolve_func_expression`
+  if (fexpr->lazy)
+  {
+    assert(fexpr->upvalues_len == 0);
+    function->lazy_source = c->options.source;
+    function->lazy_globals = fexpr->visible_globals;
+    if (!c->options.source)
+    {
+      compiler_error(c, TYERR_UNSUPPORTED, "function body was only pre-parsed but no source was given");
+    }
+    emit_constant(c, make_obj_value(&function->obj));
+    return;
+  }
+
+  Compiler inner = {
+    .program = c->program,
+    .options = c->options,
+    .chunk = &function->chunk,
+    .stack_depth = 0,
+    .pos = c->pos,
+    .functions = c->functions,
+  };
+  compile_function_body(&inner, fexpr);
+
+  if (function->chunk.global_count > c->chunk->global_count)
+  {
+    c->chunk->global_count = function->chunk.global_count;
+  }
+
+  if (inner.err.kind != TYERR_NONE)
+  {
+    if (c->err.kind == TYERR_NONE)
+    {
+      c->err = inner.err;
+    }
+    else
+    {
+      tyger_error_free(&inner.err);
+    }
+  }
+
+  // NOTE(HS): only functions which capture variables need a closure made at runtime,
+  // the rest are called as constants
+  if (fexpr->upvalues_len == 0)
+  {
+    emit_constant(c, make_obj_value(&function->obj));
+    return;
+  }
+
+  function->upvalue_count = fexpr->upvalues_len;
+  function->upvalues = tmalloc(fexpr->upvalues_len * sizeof(Upvalue_Desc));
+  assert(function->upvalues);
+  for (size_t i = 0; i < fexpr->upvalues_len; ++i)
+  {
+    Func_Upvalue upvalue = func_expression_upvalue(c->program, fexpr, i);
+    function->upvalues[i] = (Upvalue_Desc) {
+      .is_local = upvalue.is_local,
+      .index = upvalue.index,
+    };
+  }
+  emit_constant_op(c, OPC_CLOSURE, make_obj_value(&function->obj));
+}
+
+static void compile_expression(Compiler *c, const Expression *expr)
+{
+  c->pos = expr->location.pos;
+
+  switch (expr->kind)
+  {
+  case EXPR_INT:
+  {
+    const Int_Expression *iexpr = &expr->expression.int_expression;
+    if (iexpr->is_big)
+    {
+      const char *digits = string_handle_to_cstring(c->program, iexpr->digits_handle);
+      emit_constant(c, bigint_from_decimal(&c->chunk->objects, digits, strlen(digits)));
+    }
+    else
+    {
+      emit_constant(c, make_int_value(iexpr->value));
+    }
+  } break;
+
+  case EXPR_STRING:
+  {
+    const String_Expression *sexpr = &expr->expression.string_expression;
+    const char *literal = string_handle_to_cstring(c->program, sexpr->string_handle);
+    emit_constant(c, compiler_make_string(c, literal, sexpr->len));
+  } break;
+
+  case EXPR_BOOL:
+  {
+    emit_op(c, expr->expression.bool_expression.value ? OPC_LOAD_TRUE : OPC_LOAD_FALSE);
+  } break;
+
+  case EXPR_IDENT:
+  {
+    const Binding *binding = &expr->expression.ident_expression.binding;
+    switch (binding->kind)
+    {
+    case BINDING_GLOBAL:
+    {
+      compiler_use_global(c, binding->slot);
+      emit_op_operand(c, OPC_LOAD_GLOBAL, binding->slot);
+    } break;
+
+    case BINDING_LOCAL:   { emit_op_operand(c, OPC_LOAD_LOCAL, binding->slot); } break;
+    case BINDING_UPVALUE: { emit_op_operand(c, OPC_LOAD_UPVALUE, binding->slot); } break;
+
+    case BINDING_BUILTIN:
+    {
+      // NOTE(HS): the placeholder keeps the stack depth right for the rest of the
+      // expression, the chunk is never run
+      compiler_error(c, TYERR_SYNTAX, "builtin functions can only be called");
+      emit_op(c, OPC_LOAD_NIL);
+    } break;
+
+    default:
+    {
+      fprintf(stderr, "[ERROR] Unresolved identifier reached the compiler\n");
+      assert(0);
+    } break;
+    }
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+    compile_expression(c, compiler_expression(c, pexpr->rhs));
+    c->pos = expr->location.pos;
+    emit_op(c, pexpr->op == OP_MINUS ? OPC_NEGATE : OPC_NOT);
+  } break;
+
+  case EXPR_INFIX:
+  {
+    const Infix_Expression *iexpr = &expr->expression.infix_expression;
+    compile_expression(c, compiler_expression(c, iexpr->lhs));
+    compile_expression(c, compiler_expression(c, iexpr->rhs));
+    c->pos = expr->location.pos;
+    emit_op(c, infix_operator_to_opcode(iexpr->op));
+  } break;
+
+  case EXPR_CALL:
+  {
+    compile_call_expression(c, expr, false);
+  } break;
+
+  case EXPR_FUNC:
+  {
+    compile_func_expression(c, &expr->expression.func_expression);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Expression_Kind %s (%i)\n",
+      expression_kind_to_string(expr->kind), expr->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+
+///
+/// public functions
+///
+
+Compiler_Options compiler_default_options(void)
+{
+  Compiler_Options options = {
+    .superinstructions = true,
+    .optimise = false,
+    .ir = ir_default_options(),
+    .source = NULL,
+  };
+  return options;
+}
+
+Tyger_Error compiler_compile_program(const Program *prog, Chunk *chunk, Compiler_Options options)
+{
+  Phase_Scope phase = phase_begin("compile");
+  Ir_Globals globals;
+  bool found_globals = compiler_find_globals(prog, &options, &globals);
+  Compiler_Functions functions = {
+    .compiled = { NULL, 0, 0 },
+    .guards = { NULL, 0, 0 },
+  };
+  Compiler c = {
+    .program = prog,
+    .options = options,
+    .chunk = chunk,
+    .stack_depth = 0,
+    .pos = 0,
+    .functions = &functions,
+  };
+
+  if (!(options.optimise && compile_optimised(&c, NULL)))
+  {
+    for (size_t i = 0; i < prog->statements.len; ++i)
+    {
+      compile_statement(&c, &prog->statements.elems[i]);
+    }
+    emit_op(&c, OPC_LOAD_NIL);
+    emit_op(&c, OPC_RETURN);
+  }
+
+  compiler_finish(&c);
+  compiler_resolve_guards(&functions);
+  if (found_globals)
+  {
+    ir_globals_free(&globals);
+  }
+  phase_end(phase);
+  return c.err;
+}
+
+Tyger_Error compiler_compile_function(
+  const Program *prog, const Func_Expression *fexpr, Obj_Function *function, Compiler_Options options
+)
+{
+  assert(function->chunk.code.len == 0 && fexpr->params_len == function->arity);
+  Phase_Scope phase = phase_begin("compile_function");
+  Ir_Globals globals;
+  bool found_globals = compiler_find_globals(prog, &options, &globals);
+  Compiler_Functions functions = {
+    .compiled = { NULL, 0, 0 },
+    .guards = { NULL, 0, 0 },
+  };
+  Compiler_Function compiled = { .fexpr = fexpr, .function = function };
+  va_array_append(functions.compiled, compiled);
+
+  Compiler c = {
+    .program = prog,
+    .options = options,
+    .chunk = &function->chunk,
+    .stack_depth = 0,
+    .pos = func_expression_pos(fexpr),
+    .functions = &functions,
+  };
+  compile_function_body(&c, fexpr);
+  compiler_resolve_guards(&functions);
+  if (found_globals)
+  {
+    ir_globals_free(&globals);
+  }
+
+  if (c.err.kind != TYERR_NONE)
+  {
+    chunk_free(&function->chunk);
+    chunk_init(&function->chunk);
+    function->chunk.arity = function->arity;
+  }
+  phase_end(phase);
+  return c.err;
+}
@@ -0,0 +1,353 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_PROFILER
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "exec_counters.h"
+#include "lexer.h"
+
+///
+/// internal functions
+///
+
+static size_t exec_site_hash(const void *key, size_t offset)
+{
+  // NOTE(HS): fibonacci hashing, spreads the aligned pointers and small offsets
+  uint64_t bits = (uint64_t) (uintptr_t) key ^ ((uint64_t) offset << 32);
+  return (size_t) ((bits * 11400714819323198485ull) >> 32);
+}
+
+static Exec_Site *exec_site_slot(Exec_Site *entries, size_t capacity, const void *key, size_t offset)
+{
+  size_t index = exec_site_hash(key, offset) & (capacity - 1);
+  while (entries[index].key && (entries[index].key != key || entries[index].offset != offset))
+  {
+    index = (index + 1) & (capacity - 1);
+  }
+  return &entries[index];
+}
+
+static void exec_site_table_grow(Exec_Site_Table *table)
+{
+  size_t capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+  Exec_Site *entries = tcalloc(capacity, sizeof(Exec_Site));
+  assert(entries);
+
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    const Exec_Site *site = &table->entries[i];
+    if (site->key)
+    {
+      *exec_site_slot(entries, capacity, site->key, site->offset) = *site;
+    }
+  }
+
+  tfree(table->entries);
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+static void exec_site_count(Exec_Site_Table *table, const void *key, size_t offset, size_t which)
+{
+  if ((table->len + 1) * 4 > table->capacity * 3)
+  {
+    exec_site_table_grow(table);
+  }
+
+  Exec_Site *site = exec_site_slot(table->entries, table->capacity, key, offset);
+  if (!site->key)
+  {
+    site->key = key;
+    site->offset = offset;
+    table->len += 1;
+  }
+  site->counts[which] += 1;
+}
+
+static uint64_t exec_site_total(const Exec_Site *site)
+{
+  return site->counts[0] + site->counts[1];
+}
+
+static int exec_site_compare(const void *a, const void *b)
+{
+  const Exec_Site *lhs = *(const Exec_Site* const*) a;
+  const Exec_Site *rhs = *(const Exec_Site* const*) b;
+  uint64_t lhs_total = exec_site_total(lhs);
+  uint64_t rhs_total = exec_site_total(rhs);
+  if (lhs_total != rhs_total)
+  {
+    return lhs_total < rhs_total ? 1 : -1;
+  }
+  // NOTE(HS): ties are broken by key then offset, so the order only depends on the
+  // addresses of what ran
+  if (lhs->key != rhs->key)
+  {
+    return (uintptr_t) lhs->key < (uintptr_t) rhs->key ? -1 : 1;
+  }
+  return lhs->offset < rhs->offset ? -1 : (lhs->offset > rhs->offset);
+}
+
+/// the entries of `table` in use, most counted first, freed by the caller
+static const Exec_Site **exec_site_table_sorted(const Exec_Site_Table *table)
+{
+  const Exec_Site **sorted = tmalloc((table->len + 1) * sizeof(Exec_Site*));
+  assert(sorted);
+
+  size_t len = 0;
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->entries[i].key)
+    {
+      sorted[len++] = &table->entries[i];
+    }
+  }
+  assert(len == table->len);
+
+  qsort(sorted, len, sizeof(Exec_Site*), exec_site_compare);
+  return sorted;
+}
+
+/// whether `lhs` is reported before `rhs`, the most frequent first
+static bool exec_opcode_before(const Exec_Counters *counters, Opcode lhs, Opcode rhs)
+{
+  if (counters->opcodes[lhs] != counters->opcodes[rhs])
+  {
+    return counters->opcodes[lhs] > counters->opcodes[rhs];
+  }
+  return lhs < rhs;
+}
+
+/// the opcodes which were dispatched, most frequent first, returning how many
+static size_t exec_opcodes_sorted(const Exec_Counters *counters, Opcode *ops)
+{
+  size_t len = 0;
+  for (size_t op = 0; op < OPC_COUNT; ++op)
+  {
+    if (counters->opcodes[op] > 0)
+    {
+      ops[len++] = (Opcode) op;
+    }
+  }
+
+  // NOTE(HS): there are few enough opcodes for an insertion sort, which also spares
+  // passing the counts through `qsort`
+  for (size_t i = 1; i < len; ++i)
+  {
+    Opcode op = ops[i];
+    size_t j = i;
+    while (j > 0 && exec_opcode_before(counters, op, ops[j - 1]))
+    {
+      ops[j] = ops[j - 1];
+      j -= 1;
+    }
+    ops[j] = op;
+  }
+  return len;
+}
+
+static const char *exec_function_name(const Obj_Function *function)
+{
+  return function->name ? function->name->chars : "<anonymous>";
+}
+
+/// where the instruction counted by `site` (or the function it counts) is in the source
+/// it was compiled from, `source` when that isn't known
+static Location exec_site_location(
+  const Exec_Site *site, const char *source, Line_Index_Set *lines, bool function
+)
+{
+  const Obj_Function *counted = function ? site->key : NULL;
+  const Chunk *chunk = counted ? &counted->chunk : (const Chunk*) site->key;
+  size_t pos = counted ? counted->pos : chunk_position_of(chunk, site->offset);
+  return line_index_set_location(lines, chunk->source ? chunk->source : source, pos);
+}
+
+static double exec_percent(uint64_t part, uint64_t total)
+{
+  return total == 0 ? 0.0 : 100.0 * (double) part / (double) total;
+}
+
+
+///
+/// public functions
+///
+
+void exec_counters_init(Exec_Counters *counters)
+{
+  memset(counters, 0, sizeof(*counters));
+}
+
+void exec_counters_free(Exec_Counters *counters)
+{
+  tfree(counters->functions.entries);
+  tfree(counters->branches.entries);
+  tfree(counters->call_sites.entries);
+  memset(counters, 0, sizeof(*counters));
+}
+
+void exec_counters_clear(Exec_Counters *counters)
+{
+  memset(counters->opcodes, 0, sizeof(counters->opcodes));
+  Exec_Site_Table *tables[] = { &counters->functions, &counters->branches, &counters->call_sites };
+  for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); ++i)
+  {
+    if (tables[i]->entries)
+    {
+      memset(tables[i]->entries, 0, tables[i]->capacity * sizeof(Exec_Site));
+    }
+    tables[i]->len = 0;
+  }
+}
+
+void exec_counters_call(Exec_Counters *counters, const Obj_Function *function)
+{
+  exec_site_count(&counters->functions, function, 0, 0);
+}
+
+void exec_counters_branch(Exec_Counters *counters, const Chunk *chunk, size_t offset, bool taken)
+{
+  exec_site_count(&counters->branches, chunk, offset, taken ? 0 : 1);
+}
+
+void exec_counters_cache(Exec_Counters *counters, const Chunk *chunk, size_t offset, bool hit)
+{
+  exec_site_count(&counters->call_sites, chunk, offset, hit ? 0 : 1);
+}
+
+const Exec_Site *exec_counters_find(const Exec_Site_Table *table, const void *key, size_t offset)
+{
+  if (table->capacity == 0)
+  {
+    return NULL;
+  }
+
+  const Exec_Site *site = exec_site_slot(table->entries, table->capacity, key, offset);
+  return site->key ? site : NULL;
+}
+
+void exec_counters_write_report(const Exec_Counters *counters, const char *source, FILE *f)
+{
+  Line_Index_Set lines;
+  line_index_set_init(&lines);
+
+  uint64_t total = 0;
+  for (size_t op = 0; op < OPC_COUNT; ++op)
+  {
+    total += counters->opcodes[op];
+  }
+
+  Opcode ops[OPC_COUNT];
+  size_t ops_len = exec_opcodes_sorted(counters, ops);
+  fprintf(f, "instructions: %llu\n", (unsigned long long) total);
+  for (size_t i = 0; i < ops_len; ++i)
+  {
+    uint64_t count = counters->opcodes[ops[i]];
+    fprintf(
+      f, "  %12llu %6.2f%%  %s\n",
+      (unsigned long long) count, exec_percent(count, total), opcode_to_string(ops[i])
+    );
+  }
+
+  const Exec_Site **sorted = exec_site_table_sorted(&counters->functions);
+  fprintf(f, "calls:\n");
+  for (size_t i = 0; i < counters->functions.len; ++i)
+  {
+    Location location = exec_site_location(sorted[i], source, &lines, true);
+    fprintf(
+      f, "  %12llu  %s %zu:%zu\n",
+      (unsigned long long) sorted[i]->counts[0],
+      exec_function_name(sorted[i]->key), location.line + 1, location.col + 1
+    );
+  }
+  tfree(sorted);
+
+  sorted = exec_site_table_sorted(&counters->branches);
+  fprintf(f, "branches (taken / not taken):\n");
+  for (size_t i = 0; i < counters->branches.len; ++i)
+  {
+    Location location = exec_site_location(sorted[i], source, &lines, false);
+    fprintf(
+      f, "  %12llu  %zu:%zu %llu / %llu (%.2f%% taken)\n",
+      (unsigned long long) exec_site_total(sorted[i]), location.line + 1, location.col + 1,
+      (unsigned long long) sorted[i]->counts[0], (unsigned long long) sorted[i]->counts[1],
+      exec_percent(sorted[i]->counts[0], exec_site_total(sorted[i]))
+    );
+  }
+  tfree(sorted);
+
+  sorted = exec_site_table_sorted(&counters->call_sites);
+  fprintf(f, "inline caches (hits / misses):\n");
+  for (size_t i = 0; i < counters->call_sites.len; ++i)
+  {
+    Location location = exec_site_location(sorted[i], source, &lines, false);
+    fprintf(
+      f, "  %12llu  %zu:%zu %llu / %llu (%.2f%% hits)\n",
+      (unsigned long long) exec_site_total(sorted[i]), location.line + 1, location.col + 1,
+      (unsigned long long) sorted[i]->counts[0], (unsigned long long) sorted[i]->counts[1],
+      exec_percent(sorted[i]->counts[0], exec_site_total(sorted[i]))
+    );
+  }
+  tfree(sorted);
+
+  line_index_set_free(&lines);
+}
+
+void exec_counters_write_json(const Exec_Counters *counters, const char *source, FILE *f)
+{
+  Line_Index_Set lines;
+  line_index_set_init(&lines);
+
+  Opcode ops[OPC_COUNT];
+  size_t ops_len = exec_opcodes_sorted(counters, ops);
+  fprintf(f, "{\"opcodes\":{");
+  for (size_t i = 0; i < ops_len; ++i)
+  {
+    fprintf(
+      f, "%s\"%s\":%llu",
+      i > 0 ? "," : "", opcode_to_string(ops[i]), (unsigned long long) counters->opcodes[ops[i]]
+    );
+  }
+
+  // NOTE(HS): names are identifiers, so never need escaping
+  const Exec_Site **sorted = exec_site_table_sorted(&counters->functions);
+  fprintf(f, "},\"functions\":[");
+  for (size_t i = 0; i < counters->functions.len; ++i)
+  {
+    Location location = exec_site_location(sorted[i], source, &lines, true);
+    fprintf(
+      f, "%s{\"name\":\"%s\",\"line\":%zu,\"col\":%zu,\"calls\":%llu}",
+      i > 0 ? "," : "", exec_function_name(sorted[i]->key), location.line + 1,
+      location.col + 1, (unsigned long long) sorted[i]->counts[0]
+    );
+  }
+  tfree(sorted);
+
+  sorted = exec_site_table_sorted(&counters->branches);
+  fprintf(f, "],\"branches\":[");
+  for (size_t i = 0; i < counters->branches.len; ++i)
+  {
+    Location location = exec_site_location(sorted[i], source, &lines, false);
+    fprintf(
+      f, "%s{\"line\":%zu,\"col\":%zu,\"taken\":%llu,\"not_taken\":%llu}",
+      i > 0 ? "," : "", location.line + 1, location.col + 1,
+      (unsigned long long) sorted[i]->counts[0], (unsigned long long) sorted[i]->counts[1]
+    );
+  }
+  tfree(sorted);
+
+  sorted = exec_site_table_sorted(&counters->call_sites);
+  fprintf(f, "],\"call_sites\":[");
+  for (size_t i = 0; i < counters->call_sites.len; ++i)
+  {
+    Location location = exec_site_location(sorted[i], source, &lines, false);
+    fprintf(
+      f, "%s{\"line\":%zu,\"col\":%zu,\"hits\":%llu,\"misses\":%llu}",
+      i > 0 ? "," : "", location.line + 1, location.col + 1,
+      (unsigned long long) sorted[i]->counts[0], (unsigned long long) sorted[i]->counts[1]
+    );
+  }
+  tfree(sorted);
+  fprintf(f, "]}\n");
+
+  line_index_set_free(&lines);
+}
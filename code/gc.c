@@ -0,0 +1,537 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gc.h"
+#include "chunk.h"
+#include "phase_trace.h"
+#include "util.h"
+
+/// smallest amount of work (in bytes) done by a step, so tiny allocations don't each
+/// pay for a step
+#define GC_MIN_STEP_WORK 4096
+
+/// work charged for scanning a root or keeping an object alive during sweeping
+#define GC_VISIT_WORK sizeof(Value)
+
+/// units of work between checks of the pause limit, reading the clock isn't free
+#define GC_CLOCK_INTERVAL 64
+
+///
+/// internal functions
+///
+
+static uint64_t gc_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static uint8_t gc_dead_white(const Gc *gc)
+{
+  return gc->white == OBJ_WHITE_0 ? OBJ_WHITE_1 : OBJ_WHITE_0;
+}
+
+static size_t gc_intern_slot(const Gc_Intern_Table *table, uint32_t hash)
+{
+  return hash & (table->capacity - 1);
+}
+
+static Obj_String *gc_intern_find(const Gc *gc, const char *chars, size_t len, uint32_t hash)
+{
+  const Gc_Intern_Table *table = &gc->strings;
+  if (table->len == 0)
+  {
+    return NULL;
+  }
+
+  for (size_t i = gc_intern_slot(table, hash);; i = (i + 1) & (table->capacity - 1))
+  {
+    Obj_String *str = table->entries[i];
+    if (!str)
+    {
+      return NULL;
+    }
+    if (str->hash == hash && str->len == len && memcmp(str->chars, chars, len) == 0)
+    {
+      return str;
+    }
+  }
+}
+
+static void gc_intern_insert(Gc *gc, Obj_String *str)
+{
+  Gc_Intern_Table *table = &gc->strings;
+  if ((table->len + 1) * 4 > table->capacity * 3)
+  {
+    Gc_Intern_Table grown = {
+      .capacity = table->capacity > 0 ? table->capacity * 2 : 64,
+      .len = table->len,
+    };
+    grown.entries = tcalloc(grown.capacity, sizeof(Obj_String*));
+    assert(grown.entries);
+
+    for (size_t i = 0; i < table->capacity; ++i)
+    {
+      Obj_String *entry = table->entries[i];
+      if (entry)
+      {
+        size_t j = gc_intern_slot(&grown, entry->hash);
+        while (grown.entries[j])
+        {
+          j = (j + 1) & (grown.capacity - 1);
+        }
+        grown.entries[j] = entry;
+      }
+    }
+
+    tfree(table->entries);
+    *table = grown;
+  }
+
+  size_t i = gc_intern_slot(table, str->hash);
+  while (table->entries[i])
+  {
+    i = (i + 1) & (table->capacity - 1);
+  }
+  table->entries[i] = str;
+  table->len += 1;
+  str->interned = true;
+}
+
+/// NOTE(HS): entries after the removed one are shifted back into the gap, rather than
+/// leaving a tombstone, so lookups never probe past dead entries
+static void gc_intern_remove(Gc *gc, const Obj_String *str)
+{
+  Gc_Intern_Table *table = &gc->strings;
+  size_t mask = table->capacity - 1;
+
+  size_t gap = gc_intern_slot(table, str->hash);
+  while (table->entries[gap] != str)
+  {
+    gap = (gap + 1) & mask;
+  }
+  table->entries[gap] = NULL;
+  table->len -= 1;
+
+  for (size_t i = (gap + 1) & mask; table->entries[i]; i = (i + 1) & mask)
+  {
+    // NOTE(HS): an entry can only fill the gap if the gap lies between its home
+    // slot and where it is now
+    size_t home = gc_intern_slot(table, table->entries[i]->hash);
+    if (((i - home) & mask) >= ((i - gap) & mask))
+    {
+      table->entries[gap] = table->entries[i];
+      table->entries[i] = NULL;
+      gap = i;
+    }
+  }
+}
+
+/// adds a rope's flattened bytes to the heap size the first time the collector sees
+/// them, flattening happens where the collector isn't around to be told
+static void gc_count_flat(Gc *gc, Obj *obj)
+{
+  Obj_Rope *rope = (Obj_Rope*) obj;
+  if (obj->kind == OBJ_ROPE && rope->flat && !rope->flat_counted)
+  {
+    rope->flat_counted = true;
+    gc->stats.heap_bytes += rope->len + 1;
+    gc->stats.bytes_allocated += rope->len + 1;
+  }
+}
+
+static size_t gc_blacken(Gc *gc, Obj *obj)
+{
+  obj->color = OBJ_BLACK;
+  gc_count_flat(gc, obj);
+
+  switch (obj->kind)
+  {
+  // NOTE(HS): none of these refer to any collected objects, a function's name and
+  // constants are owned by its chunk
+  case OBJ_STRING:   {} break;
+  case OBJ_FUNCTION: {} break;
+  case OBJ_BIGINT:   {} break;
+
+  // NOTE(HS): an open upvalue's variable is on the stack, `closed` is still nil
+  case OBJ_UPVALUE:
+  {
+    gc_mark_value(gc, ((Obj_Upvalue*) obj)->closed);
+  } break;
+
+  case OBJ_CLOSURE:
+  {
+    const Obj_Closure *closure = (const Obj_Closure*) obj;
+    for (size_t i = 0; i < closure->function->upvalue_count; ++i)
+    {
+      gc_mark_value(gc, make_obj_value(&closure->upvalues[i]->obj));
+    }
+  } break;
+
+  case OBJ_ROPE:
+  {
+    gc_mark_value(gc, ((Obj_Rope*) obj)->left);
+    gc_mark_value(gc, ((Obj_Rope*) obj)->right);
+  } break;
+
+  default:
+  {
+    assert(0 && "Invalid Object_Kind");
+  } break;
+  }
+
+  return obj_size(obj);
+}
+
+static void gc_mark_values(Gc *gc, const Value *values, size_t len)
+{
+  for (size_t i = 0; i < len; ++i)
+  {
+    gc_mark_value(gc, values[i]);
+  }
+}
+
+/// scans the stack again and finishes marking, then starts sweeping
+static size_t gc_finish_mark(Gc *gc, Gc_Roots roots)
+{
+  size_t work = roots.stack_len * GC_VISIT_WORK;
+  gc_mark_values(gc, roots.stack, roots.stack_len);
+  for (Obj_Upvalue *upvalue = roots.open_upvalues; upvalue; upvalue = upvalue->next_open)
+  {
+    gc_mark_value(gc, make_obj_value(&upvalue->obj));
+    work += GC_VISIT_WORK;
+  }
+  if (roots.mark_extra)
+  {
+    roots.mark_extra(gc, roots.context);
+  }
+  while (gc->gray.len > 0)
+  {
+    work += gc_blacken(gc, gc->gray.elems[--gc->gray.len]);
+  }
+
+  gc->white = gc_dead_white(gc);
+  gc->phase = GC_SWEEP;
+  gc->sweep = &gc->objects;
+  return work;
+}
+
+static size_t gc_sweep_one(Gc *gc)
+{
+  Obj *obj = *gc->sweep;
+  gc_count_flat(gc, obj);
+  if (obj->color == gc_dead_white(gc))
+  {
+    size_t size = obj_size(obj);
+    *gc->sweep = obj->next;
+    if (obj->kind == OBJ_STRING && ((Obj_String*) obj)->interned)
+    {
+      gc_intern_remove(gc, (Obj_String*) obj);
+    }
+    obj_free(obj);
+
+    gc->stats.heap_bytes -= size;
+    gc->stats.heap_objects -= 1;
+    gc->stats.bytes_freed += size;
+    gc->stats.objects_freed += 1;
+    return size;
+  }
+
+  obj->color = gc->white;
+  gc->sweep = &obj->next;
+  return GC_VISIT_WORK;
+}
+
+static void gc_finish_cycle(Gc *gc)
+{
+  gc->phase = GC_IDLE;
+  gc->sweep = NULL;
+  gc->debt = 0;
+  gc->stats.cycles += 1;
+
+  size_t threshold = gc->stats.heap_bytes / 100 * gc->options.pause_percent;
+  gc->threshold = threshold > gc->options.initial_threshold
+    ? threshold
+    : gc->options.initial_threshold;
+}
+
+/// does one unit of work of the current phase, returning its cost
+static size_t gc_work(Gc *gc, Gc_Roots roots)
+{
+  size_t work = 0;
+
+  switch (gc->phase)
+  {
+  case GC_IDLE: {} break;
+
+  case GC_MARK:
+  {
+    if (gc->gray.len > 0)
+    {
+      work = gc_blacken(gc, gc->gray.elems[--gc->gray.len]);
+    }
+    else if (gc->globals_scanned < roots.globals_len)
+    {
+      gc_mark_value(gc, roots.globals[gc->globals_scanned++]);
+      work = GC_VISIT_WORK;
+    }
+    else
+    {
+      work = gc_finish_mark(gc, roots);
+    }
+  } break;
+
+  case GC_SWEEP:
+  {
+    if (*gc->sweep)
+    {
+      work = gc_sweep_one(gc);
+    }
+    else
+    {
+      gc_finish_cycle(gc);
+    }
+  } break;
+  }
+
+  return work;
+}
+
+static void gc_record_pause(Gc *gc, uint64_t ns)
+{
+  gc->stats.steps += 1;
+  gc->stats.total_pause_ns += ns;
+  if (ns > gc->stats.max_pause_ns)
+  {
+    gc->stats.max_pause_ns = ns;
+  }
+
+  uint64_t us = ns / 1000;
+  size_t bucket = 0;
+  while (bucket < GC_PAUSE_BUCKETS - 1 && us >= (1ull << bucket))
+  {
+    bucket += 1;
+  }
+  gc->stats.pause_histogram[bucket] += 1;
+}
+
+
+///
+/// public functions
+///
+
+Gc_Options gc_default_options(void)
+{
+  Gc_Options options = {
+    .initial_threshold = 1024 * 1024,
+    .pause_percent = 200,
+    .step_percent = 200,
+    .max_pause_ns = 1000 * 1000,
+  };
+  return options;
+}
+
+void gc_init(Gc *gc, Gc_Options options)
+{
+  *gc = (Gc) {
+    .objects = NULL,
+    .options = options,
+    .phase = GC_IDLE,
+    .white = OBJ_WHITE_0,
+    .threshold = options.initial_threshold,
+  };
+  va_array_init(Obj*, gc->gray);
+}
+
+void gc_free(Gc *gc)
+{
+  objects_free(gc->objects);
+  gc->objects = NULL;
+  tfree(gc->strings.entries);
+  gc->strings = (Gc_Intern_Table) {0};
+  va_array_free(gc->gray);
+}
+
+void gc_set_options(Gc *gc, Gc_Options options)
+{
+  gc->options = options;
+  if (gc->phase == GC_IDLE && gc->stats.cycles == 0)
+  {
+    gc->threshold = options.initial_threshold;
+  }
+}
+
+void gc_track(Gc *gc, Obj *obj)
+{
+  size_t size = obj_size(obj);
+  obj->color = gc->white;
+
+  gc->stats.heap_bytes += size;
+  gc->stats.heap_objects += 1;
+  gc->stats.bytes_allocated += size;
+
+  if (gc->phase != GC_IDLE)
+  {
+    gc->debt += (int64_t) size;
+  }
+  else if (gc->stats.heap_bytes >= gc->threshold)
+  {
+    gc->phase = GC_MARK;
+    gc->globals_scanned = 0;
+    gc->debt = (int64_t) size;
+  }
+}
+
+Value gc_string_new(Gc *gc, const char *chars, size_t len)
+{
+  if (len <= VALUE_SHORT_STRING_MAX)
+  {
+    return make_short_string_value(chars, len);
+  }
+
+  Obj_String *str = NULL;
+  if (len <= GC_INTERN_MAX)
+  {
+    str = gc_intern_find(gc, chars, len, string_hash(chars, len));
+    if (str)
+    {
+      // NOTE(HS): a string found whilst sweeping may be garbage which hasn't been
+      // swept yet, making it the new white brings it back to life
+      if (str->obj.color == gc_dead_white(gc))
+      {
+        str->obj.color = gc->white;
+      }
+      return make_obj_value(&str->obj);
+    }
+
+    str = obj_string_new(&gc->objects, chars, len);
+    gc_intern_insert(gc, str);
+  }
+  else
+  {
+    str = obj_string_new(&gc->objects, chars, len);
+  }
+
+  gc_track(gc, &str->obj);
+  return make_obj_value(&str->obj);
+}
+
+Value gc_string_concat(Gc *gc, Value lhs, Value rhs)
+{
+  size_t len = value_string_len(lhs) + value_string_len(rhs);
+  if (len > GC_ROPE_MIN)
+  {
+    Obj_Rope *rope = obj_rope_new(&gc->objects, lhs, rhs);
+    gc_track(gc, &rope->obj);
+    return make_obj_value(&rope->obj);
+  }
+
+  String_View l = value_string_view(&lhs);
+  String_View r = value_string_view(&rhs);
+  if (len <= GC_INTERN_MAX)
+  {
+    char buffer[GC_INTERN_MAX];
+    memcpy(buffer, l.str, l.len);
+    memcpy(buffer + l.len, r.str, r.len);
+    return gc_string_new(gc, buffer, len);
+  }
+
+  Obj_String *str = obj_string_concat(&gc->objects, l, r);
+  gc_track(gc, &str->obj);
+  return make_obj_value(&str->obj);
+}
+
+void gc_step(Gc *gc, Gc_Roots roots)
+{
+  if (gc->phase == GC_IDLE)
+  {
+    gc->debt = 0;
+    return;
+  }
+
+  Phase_Scope phase = phase_begin("gc_step");
+  uint64_t start = gc_now_ns();
+  uint64_t budget = (uint64_t) gc->debt * gc->options.step_percent / 100;
+  if (budget < GC_MIN_STEP_WORK)
+  {
+    budget = GC_MIN_STEP_WORK;
+  }
+
+  uint64_t work = 0;
+  size_t units = 0;
+  while (gc->phase != GC_IDLE && work < budget)
+  {
+    work += gc_work(gc, roots);
+    units += 1;
+
+    if (gc->options.max_pause_ns > 0 && units % GC_CLOCK_INTERVAL == 0 &&
+        gc_now_ns() - start >= gc->options.max_pause_ns)
+    {
+      break;
+    }
+  }
+
+  // NOTE(HS): whatever isn't paid off now is carried into the next step, so a cycle
+  // cut short by the pause limit still keeps up with allocation
+  if (gc->phase == GC_IDLE)
+  {
+    gc->debt = 0;
+  }
+  else
+  {
+    gc->debt -= (int64_t) (work * 100 / gc->options.step_percent);
+  }
+
+  gc_record_pause(gc, gc_now_ns() - start);
+  phase_end(phase);
+}
+
+void gc_collect(Gc *gc, Gc_Roots roots)
+{
+  Phase_Scope phase = phase_begin("gc_collect");
+  uint64_t start = gc_now_ns();
+
+  // NOTE(HS): a cycle already marking may have missed objects which became garbage
+  // after it started, so it is finished before running a cycle from scratch
+  for (int cycle = gc->phase == GC_IDLE ? 1 : 2; cycle > 0; --cycle)
+  {
+    if (gc->phase == GC_IDLE)
+    {
+      gc->phase = GC_MARK;
+      gc->globals_scanned = 0;
+    }
+    while (gc->phase != GC_IDLE)
+    {
+      gc_work(gc, roots);
+    }
+  }
+
+  gc_record_pause(gc, gc_now_ns() - start);
+  phase_end(phase);
+}
+
+void gc_mark_value(Gc *gc, Value v)
+{
+  if (v.kind != VAL_OBJ)
+  {
+    return;
+  }
+
+  Obj *obj = v.as.obj;
+  // NOTE(HS): unmanaged objects are never white so are skipped here
+  if (obj->color == gc->white)
+  {
+    obj->color = OBJ_GRAY;
+    va_array_append(gc->gray, obj);
+  }
+}
+
+Gc_Stats gc_get_stats(const Gc *gc)
+{
+  Gc_Stats stats = gc->stats;
+  stats.interned_strings = gc->strings.len;
+  return stats;
+}
@@ -0,0 +1,906 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_COMPILER
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "builtin.h"
+#include "util.h"
+
+/// the IR of a function being built, `current` is the block statements are added to
+///
+/// NOTE(HS): SSA form is built straight from the AST as in Braun et al., "Simple and
+/// Efficient Construction of Static Single Assignment Form". Each block records the
+/// value each local was last given in it, a read of a local the block hasn't written
+/// looks through its predecessors, placing a phi where they meet. The predecessors of
+/// a loop header aren't all known until its body is built, reads there get phis whose
+/// operands are filled in once it's sealed.
+typedef struct ir_builder
+{
+  Ir_Function *fn;
+  Ir_Block_Id current;
+  size_t pos;
+} Ir_Builder;
+
+static void ir_build_statement(Ir_Builder *b, const Statement *stmt);
+static Ir_Value ir_build_expression(Ir_Builder *b, const Expression *expr);
+static Ir_Value ir_read_local(Ir_Builder *b, Ir_Block_Id block, size_t slot);
+
+///
+/// internal functions
+///
+
+static inline Ir_Instr *ir_instr(Ir_Function *fn, Ir_Value v)
+{
+  assert(v < fn->instrs.len);
+  return &fn->instrs.elems[v];
+}
+
+static inline Ir_Block *ir_block(Ir_Function *fn, Ir_Block_Id id)
+{
+  assert(id < fn->blocks.len);
+  return &fn->blocks.elems[id];
+}
+
+static Ir_Block_Id ir_new_block(Ir_Function *fn)
+{
+  Ir_Block block;
+  memset(&block, 0, sizeof(block));
+  block.idom = IR_NONE;
+  Ir_Block_Id id = (Ir_Block_Id) fn->blocks.len;
+  va_array_append(fn->blocks, block);
+  return id;
+}
+
+/// makes an instruction without adding it to a block
+static Ir_Value ir_new_instr(Ir_Function *fn, Ir_Op op, Ir_Block_Id block, size_t pos)
+{
+  Ir_Instr instr;
+  memset(&instr, 0, sizeof(instr));
+  instr.op = op;
+  instr.block = block;
+  instr.pos = pos;
+  instr.replacement = IR_NONE;
+  instr.type = IR_TYPE_ANY;
+  Ir_Value v = (Ir_Value) fn->instrs.len;
+  va_array_append(fn->instrs, instr);
+  return v;
+}
+
+static inline bool ir_block_terminated(Ir_Function *fn, Ir_Block_Id id)
+{
+  const Ir_Block *block = ir_block(fn, id);
+  return block->instrs.len > 0
+    && (ir_op_flags(ir_instr(fn, block->instrs.elems[block->instrs.len - 1])->op) & IR_TERMINATOR);
+}
+
+/// appends an instruction to the current block
+static Ir_Value ir_emit(Ir_Builder *b, Ir_Op op)
+{
+  assert(!ir_block_terminated(b->fn, b->current));
+  Ir_Value v = ir_new_instr(b->fn, op, b->current, b->pos);
+  va_array_append(ir_block(b->fn, b->current)->instrs, v);
+  return v;
+}
+
+static inline void ir_add_arg(Ir_Function *fn, Ir_Value v, Ir_Value arg)
+{
+  va_array_append(ir_instr(fn, v)->args, arg);
+}
+
+static Ir_Value ir_emit_unary(Ir_Builder *b, Ir_Op op, Ir_Value arg)
+{
+  Ir_Value v = ir_emit(b, op);
+  ir_add_arg(b->fn, v, arg);
+  return v;
+}
+
+static Ir_Value ir_emit_binary(Ir_Builder *b, Ir_Op op, Ir_Value lhs, Ir_Value rhs)
+{
+  Ir_Value v = ir_emit(b, op);
+  ir_add_arg(b->fn, v, lhs);
+  ir_add_arg(b->fn, v, rhs);
+  return v;
+}
+
+static void ir_add_edge(Ir_Function *fn, Ir_Block_Id from, Ir_Block_Id to)
+{
+  Ir_Block *pred = ir_block(fn, from);
+  assert(pred->succs_len < 2);
+  pred->succs[pred->succs_len++] = to;
+  va_array_append(ir_block(fn, to)->preds, from);
+}
+
+static void ir_emit_jump(Ir_Builder *b, Ir_Block_Id target)
+{
+  ir_emit(b, IR_JUMP);
+  ir_add_edge(b->fn, b->current, target);
+}
+
+/// nil, for reads of locals in blocks nothing reaches
+///
+/// NOTE(HS): made in the entry block, which dominates every other
+static Ir_Value ir_undefined(Ir_Function *fn)
+{
+  Ir_Value v = ir_new_instr(fn, IR_CONST_NIL, 0, 0);
+  Ir_Id_VaArray *instrs = &ir_block(fn, 0)->instrs;
+  va_array_append(*instrs, v);
+  memmove(instrs->elems + 1, instrs->elems, (instrs->len - 1) * sizeof(instrs->elems[0]));
+  instrs->elems[0] = v;
+  return v;
+}
+
+static void ir_write_local(Ir_Function *fn, Ir_Block_Id id, size_t slot, Ir_Value v)
+{
+  Ir_Block *block = ir_block(fn, id);
+  if (slot >= block->defs_len)
+  {
+    size_t len = va_array_capacity_for(block->defs_len, slot + 1);
+    block->defs = trealloc(block->defs, len * sizeof(Ir_Value));
+    assert(block->defs);
+    for (size_t i = block->defs_len; i < len; ++i)
+    {
+      block->defs[i] = IR_NONE;
+    }
+    block->defs_len = len;
+  }
+  block->defs[slot] = v;
+}
+
+static Ir_Value ir_new_phi(Ir_Function *fn, Ir_Block_Id id, size_t slot)
+{
+  Ir_Value phi = ir_new_instr(fn, IR_PHI, id, 0);
+  ir_instr(fn, phi)->as.slot = slot;
+  va_array_append(ir_block(fn, id)->phis, phi);
+  return phi;
+}
+
+/// replaces a phi whose operands are all the same value (or itself) with that value
+static Ir_Value ir_try_remove_trivial_phi(Ir_Function *fn, Ir_Value phi)
+{
+  Ir_Value same = IR_NONE;
+  const Ir_Instr *instr = ir_instr(fn, phi);
+  for (size_t i = 0; i < instr->args.len; ++i)
+  {
+    Ir_Value arg = ir_resolve(fn, instr->args.elems[i]);
+    if (arg == same || arg == phi)
+    {
+      continue;
+    }
+    if (same != IR_NONE)
+    {
+      return phi;
+    }
+    same = arg;
+  }
+
+  if (same == IR_NONE)
+  {
+    same = ir_undefined(fn);
+  }
+  Ir_Instr *removed = ir_instr(fn, phi);
+  removed->removed = true;
+  removed->replacement = same;
+  return same;
+}
+
+static Ir_Value ir_add_phi_operands(Ir_Builder *b, Ir_Value phi, size_t slot)
+{
+  Ir_Block_Id id = ir_instr(b->fn, phi)->block;
+  for (size_t i = 0; i < ir_block(b->fn, id)->preds.len; ++i)
+  {
+    Ir_Value arg = ir_read_local(b, ir_block(b->fn, id)->preds.elems[i], slot);
+    ir_add_arg(b->fn, phi, arg);
+  }
+  return ir_try_remove_trivial_phi(b->fn, phi);
+}
+
+static Ir_Value ir_read_local(Ir_Builder *b, Ir_Block_Id id, size_t slot)
+{
+  Ir_Block *block = ir_block(b->fn, id);
+  if (slot < block->defs_len && block->defs[slot] != IR_NONE)
+  {
+    return ir_resolve(b->fn, block->defs[slot]);
+  }
+
+  Ir_Value v;
+  if (!block->sealed)
+  {
+    v = ir_new_phi(b->fn, id, slot);
+    va_array_append(ir_block(b->fn, id)->incomplete_phis, v);
+  }
+  else if (block->preds.len == 0)
+  {
+    v = ir_undefined(b->fn);
+  }
+  else if (block->preds.len == 1)
+  {
+    v = ir_read_local(b, block->preds.elems[0], slot);
+  }
+  else
+  {
+    // NOTE(HS): the phi is written first so a loop reading the local again finds it
+    // rather than recursing forever
+    Ir_Value phi = ir_new_phi(b->fn, id, slot);
+    ir_write_local(b->fn, id, slot, phi);
+    v = ir_add_phi_operands(b, phi, slot);
+  }
+  ir_write_local(b->fn, id, slot, v);
+  return v;
+}
+
+static void ir_seal_block(Ir_Builder *b, Ir_Block_Id id)
+{
+  Ir_Block *block = ir_block(b->fn, id);
+  assert(!block->sealed);
+  for (size_t i = 0; i < block->incomplete_phis.len; ++i)
+  {
+    Ir_Value phi = ir_block(b->fn, id)->incomplete_phis.elems[i];
+    ir_add_phi_operands(b, phi, ir_instr(b->fn, phi)->as.slot);
+  }
+  block = ir_block(b->fn, id);
+  va_array_free(block->incomplete_phis);
+  block->sealed = true;
+}
+
+static Ir_Block_Id ir_new_sealed_block(Ir_Builder *b)
+{
+  Ir_Block_Id id = ir_new_block(b->fn);
+  ir_block(b->fn, id)->sealed = true;
+  return id;
+}
+
+static void ir_unsupported(Ir_Builder *b, const char *why)
+{
+  if (!b->fn->unsupported)
+  {
+    b->fn->unsupported = why;
+  }
+}
+
+static inline const Expression *ir_expression(const Ir_Builder *b, Expression_Handle hndl)
+{
+  const Expression *expr = expression_handle_to_expression(b->fn->program, hndl);
+  assert(expr);
+  return expr;
+}
+
+static inline const Statement *ir_statement(const Ir_Builder *b, Statement_Handle hndl)
+{
+  const Statement *stmt = statement_handle_to_statement(b->fn->program, hndl);
+  assert(stmt);
+  return stmt;
+}
+
+static void ir_build_store(Ir_Builder *b, const Binding *binding, Ir_Value v)
+{
+  switch (binding->kind)
+  {
+  case BINDING_LOCAL: { ir_write_local(b->fn, b->current, binding->slot, v); } break;
+
+  case BINDING_GLOBAL:
+  case BINDING_UPVALUE:
+  {
+    Ir_Value store = ir_emit_unary(b, binding->kind == BINDING_GLOBAL ? IR_STORE_GLOBAL : IR_STORE_UPVALUE, v);
+    ir_instr(b->fn, store)->as.slot = binding->slot;
+  } break;
+
+  default:
+  {
+    ir_unsupported(b, "assignment to a builtin");
+  } break;
+  }
+}
+
+static void ir_build_block_statement(Ir_Builder *b, const Block_Statement *bs)
+{
+  if (bs->captures)
+  {
+    ir_unsupported(b, "its locals are captured");
+    return;
+  }
+  for (size_t i = 0; i < bs->len; ++i)
+  {
+    ir_build_statement(b, ir_statement(b, bs->first + i));
+  }
+}
+
+static void ir_build_if_statement(Ir_Builder *b, const If_Statement *is)
+{
+  Ir_Value condition = ir_build_expression(b, ir_expression(b, is->condition));
+  Ir_Block_Id consequence = ir_new_block(b->fn);
+  Ir_Block_Id alternative = ir_new_block(b->fn);
+  Ir_Block_Id join = ir_new_block(b->fn);
+
+  // NOTE(HS): an `if` without an `else` still gets an empty block for it, so neither
+  // edge out of the branch goes straight to a block with other predecessors
+  ir_emit_unary(b, IR_BRANCH, condition);
+  ir_add_edge(b->fn, b->current, consequence);
+  ir_add_edge(b->fn, b->current, alternative);
+  ir_seal_block(b, consequence);
+  ir_seal_block(b, alternative);
+
+  b->current = consequence;
+  ir_build_statement(b, ir_statement(b, is->consequence));
+  if (!ir_block_terminated(b->fn, b->current))
+  {
+    ir_emit_jump(b, join);
+  }
+
+  b->current = alternative;
+  if (is->has_alternative)
+  {
+    ir_build_statement(b, ir_statement(b, is->alternative));
+  }
+  if (!ir_block_terminated(b->fn, b->current))
+  {
+    ir_emit_jump(b, join);
+  }
+
+  ir_seal_block(b, join);
+  b->current = join;
+}
+
+static void ir_build_while_statement(Ir_Builder *b, const While_Statement *ws)
+{
+  Ir_Block_Id header = ir_new_block(b->fn);
+  ir_emit_jump(b, header);
+  b->current = header;
+
+  Ir_Value condition = ir_build_expression(b, ir_expression(b, ws->condition));
+  Ir_Block_Id body = ir_new_block(b->fn);
+  Ir_Block_Id exit = ir_new_block(b->fn);
+  ir_emit_unary(b, IR_BRANCH, condition);
+  ir_add_edge(b->fn, header, body);
+  ir_add_edge(b->fn, header, exit);
+  ir_seal_block(b, body);
+  ir_seal_block(b, exit);
+
+  b->current = body;
+  ir_build_statement(b, ir_statement(b, ws->body));
+  if (!ir_block_terminated(b->fn, b->current))
+  {
+    ir_emit_jump(b, header);
+  }
+
+  ir_seal_block(b, header);
+  b->current = exit;
+}
+
+/// a call's callee and arguments, `tail` makes it the block's terminator (unless it
+/// calls a builtin)
+static Ir_Value ir_build_call(Ir_Builder *b, const Expression *expr, bool tail)
+{
+  const Call_Expression *cexpr = &expr->expression.call_expression;
+  const Expression *function = ir_expression(b, cexpr->function);
+  const Binding *binding = function->kind == EXPR_IDENT
+    ? &function->expression.ident_expression.binding
+    : NULL;
+  bool is_direct = binding && (binding->kind == BINDING_BUILTIN || binding->kind == BINDING_GLOBAL);
+
+  // NOTE(HS): evaluated in the same order as the bytecode compiler, a global callee is
+  // only read once the arguments have been
+  Ir_Value callee = is_direct ? IR_NONE : ir_build_expression(b, function);
+  size_t argc = cexpr->args_len;
+  Ir_Value *args = tmalloc((argc + 1) * sizeof(Ir_Value));
+  assert(args);
+  for (size_t i = 0; i < argc; ++i)
+  {
+    args[i] = ir_build_expression(b, ir_expression(b, cexpr->args_first + i));
+  }
+  b->pos = expr->location.pos;
+
+  Ir_Value v;
+  if (binding && binding->kind == BINDING_BUILTIN)
+  {
+    // NOTE(HS): arity errors are reported by the bytecode compiler
+    if (!builtin_accepts(&BUILTINS[binding->slot], argc))
+    {
+      ir_unsupported(b, "a builtin is called with the wrong number of arguments");
+    }
+    v = ir_emit(b, IR_CALL_NATIVE);
+    ir_instr(b->fn, v)->as.slot = binding->slot;
+  }
+  else if (binding && binding->kind == BINDING_GLOBAL)
+  {
+    v = ir_emit(b, tail ? IR_TAIL_CALL_GLOBAL : IR_CALL_GLOBAL);
+    ir_instr(b->fn, v)->as.slot = binding->slot;
+  }
+  else
+  {
+    v = ir_emit(b, tail ? IR_TAIL_CALL : IR_CALL);
+    ir_add_arg(b->fn, v, callee);
+  }
+
+  for (size_t i = 0; i < argc; ++i)
+  {
+    ir_add_arg(b->fn, v, args[i]);
+  }
+  tfree(args);
+  return v;
+}
+
+static void ir_build_statement(Ir_Builder *b, const Statement *stmt)
+{
+  if (b->fn->unsupported)
+  {
+    return;
+  }
+
+  // NOTE(HS): statements after a `return` are never run, but are still built into a
+  // block of their own which nothing jumps to
+  if (ir_block_terminated(b->fn, b->current))
+  {
+    b->current = ir_new_sealed_block(b);
+  }
+  b->pos = stmt->location.pos;
+
+  switch (stmt->kind)
+  {
+  case STMT_VAR:
+  {
+    const Var_Statement *vs = &stmt->statement.var_statement;
+    Ir_Value v = ir_build_expression(b, ir_expression(b, vs->expression_handle));
+    b->pos = stmt->location.pos;
+    ir_build_store(b, &vs->binding, v);
+  } break;
+
+  case STMT_EXPRESSION:
+  {
+    ir_build_expression(b, ir_expression(b, stmt->statement.expression_statement.expression_handle));
+  } break;
+
+  case STMT_BLOCK:
+  {
+    ir_build_block_statement(b, &stmt->statement.block_statement);
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    Ir_Value v = ir_build_expression(b, ir_expression(b, as->expression_handle));
+    b->pos = stmt->location.pos;
+    ir_build_store(b, &as->binding, v);
+  } break;
+
+  case STMT_IF:
+  {
+    ir_build_if_statement(b, &stmt->statement.if_statement);
+  } break;
+
+  case STMT_WHILE:
+  {
+    ir_build_while_statement(b, &stmt->statement.while_statement);
+  } break;
+
+  case STMT_RETURN:
+  {
+    const Return_Statement *rs = &stmt->statement.return_statement;
+    const Expression *value = rs->has_value ? ir_expression(b, rs->expression_handle) : NULL;
+    Ir_Value v;
+    if (value && value->kind == EXPR_CALL)
+    {
+      v = ir_build_call(b, value, true);
+      if (ir_instr(b->fn, v)->op != IR_CALL_NATIVE)
+      {
+        break;
+      }
+    }
+    else if (value)
+    {
+      v = ir_build_expression(b, value);
+    }
+    else
+    {
+      v = ir_emit(b, IR_CONST_NIL);
+    }
+    b->pos = stmt->location.pos;
+    ir_emit_unary(b, IR_RETURN, v);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Statement_Kind %s (%i)\n",
+      statement_kind_to_string(stmt->kind), stmt->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+static Ir_Op ir_infix_op(Operator op)
+{
+  Ir_Op result = IR_ADD;
+  switch (op)
+  {
+  case OP_PLUS:     { result = IR_ADD; } break;
+  case OP_MINUS:    { result = IR_SUB; } break;
+  case OP_ASTERISK: { result = IR_MUL; } break;
+  case OP_SLASH:    { result = IR_DIV; } break;
+  case OP_EQ:       { result = IR_EQ; } break;
+  case OP_NOT_EQ:   { result = IR_NOT_EQ; } break;
+  case OP_LT:       { result = IR_LT; } break;
+  case OP_GT:       { result = IR_GT; } break;
+  case OP_LTE:      { result = IR_LTE; } break;
+  case OP_GTE:      { result = IR_GTE; } break;
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid infix operator %s\n", operator_to_string(op));
+    assert(0);
+  } break;
+  }
+  return result;
+}
+
+static Ir_Value ir_build_expression(Ir_Builder *b, const Expression *expr)
+{
+  b->pos = expr->location.pos;
+  Ir_Value v = IR_NONE;
+
+  switch (expr->kind)
+  {
+  case EXPR_INT:
+  {
+    const Int_Expression *iexpr = &expr->expression.int_expression;
+    if (iexpr->is_big)
+    {
+      const char *digits = string_handle_to_cstring(b->fn->program, iexpr->digits_handle);
+      v = ir_emit(b, IR_CONST_BIGINT);
+      ir_instr(b->fn, v)->as.literal = (Ir_Literal) { .chars = digits, .len = strlen(digits) };
+    }
+    else
+    {
+      v = ir_emit(b, IR_CONST_INT);
+      ir_instr(b->fn, v)->as.integer = iexpr->value;
+    }
+  } break;
+
+  case EXPR_STRING:
+  {
+    const String_Expression *sexpr = &expr->expression.string_expression;
+    v = ir_emit(b, IR_CONST_STRING);
+    ir_instr(b->fn, v)->as.literal = (Ir_Literal) {
+      .chars = string_handle_to_cstring(b->fn->program, sexpr->string_handle),
+      .len = sexpr->len,
+    };
+  } break;
+
+  case EXPR_BOOL:
+  {
+    v = ir_emit(b, IR_CONST_BOOL);
+    ir_instr(b->fn, v)->as.boolean = expr->expression.bool_expression.value;
+  } break;
+
+  case EXPR_IDENT:
+  {
+    const Binding *binding = &expr->expression.ident_expression.binding;
+    switch (binding->kind)
+    {
+    case BINDING_LOCAL: { v = ir_read_local(b, b->current, binding->slot); } break;
+
+    case BINDING_GLOBAL:
+    case BINDING_UPVALUE:
+    {
+      v = ir_emit(b, binding->kind == BINDING_GLOBAL ? IR_LOAD_GLOBAL : IR_LOAD_UPVALUE);
+      ir_instr(b->fn, v)->as.slot = binding->slot;
+    } break;
+
+    default:
+    {
+      // NOTE(HS): reported by the bytecode compiler
+      ir_unsupported(b, "a builtin is used as a value");
+      v = ir_emit(b, IR_CONST_NIL);
+    } break;
+    }
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+    Ir_Value rhs = ir_build_expression(b, ir_expression(b, pexpr->rhs));
+    b->pos = expr->location.pos;
+    v = ir_emit_unary(b, pexpr->op == OP_MINUS ? IR_NEGATE : IR_NOT, rhs);
+  } break;
+
+  case EXPR_INFIX:
+  {
+    const Infix_Expression *iexpr = &expr->expression.infix_expression;
+    Ir_Value lhs = ir_build_expression(b, ir_expression(b, iexpr->lhs));
+    Ir_Value rhs = ir_build_expression(b, ir_expression(b, iexpr->rhs));
+    b->pos = expr->location.pos;
+    v = ir_emit_binary(b, ir_infix_op(iexpr->op), lhs, rhs);
+  } break;
+
+  case EXPR_CALL:
+  {
+    v = ir_build_call(b, expr, false);
+  } break;
+
+  case EXPR_FUNC:
+  {
+    const Func_Expression *fexpr = &expr->expression.func_expression;
+    for (size_t i = 0; i < fexpr->upvalues_len; ++i)
+    {
+      if (func_expression_upvalue(b->fn->program, fexpr, i).is_local)
+      {
+        ir_unsupported(b, "its locals are captured");
+      }
+    }
+    v = ir_emit(b, fexpr->upvalues_len > 0 ? IR_CLOSURE : IR_FUNCTION);
+    ir_instr(b->fn, v)->as.function = fexpr;
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Expression_Kind %s (%i)\n",
+      expression_kind_to_string(expr->kind), expr->kind
+    );
+    assert(0);
+  } break;
+  }
+
+  return v;
+}
+
+static void ir_append_value(const Ir_Function *fn, Ir_Value v, String_Builder *sb)
+{
+  string_builder_append_fmt(sb, "v%" PRIu32, ir_resolve(fn, v));
+}
+
+static void ir_append_block_list(const Ir_Id_VaArray *blocks, String_Builder *sb)
+{
+  for (size_t i = 0; i < blocks->len; ++i)
+  {
+    string_builder_append_fmt(sb, "%sb%" PRIu32, i > 0 ? ", " : "", blocks->elems[i]);
+  }
+}
+
+static void ir_append_instr(const Ir_Function *fn, Ir_Value v, String_Builder *sb)
+{
+  const Ir_Instr *instr = &fn->instrs.elems[v];
+  const Ir_Block *block = &fn->blocks.elems[instr->block];
+  string_builder_append(sb, "    ");
+  if (!(ir_op_flags(instr->op) & IR_TERMINATOR) && instr->op != IR_STORE_GLOBAL && instr->op != IR_STORE_UPVALUE)
+  {
+    string_builder_append_fmt(sb, "v%" PRIu32 " = ", v);
+  }
+  string_builder_append(sb, ir_op_to_string(instr->op));
+
+  switch (instr->op)
+  {
+  case IR_CONST_INT:  { string_builder_append_fmt(sb, " %" PRId64, instr->as.integer); } break;
+  case IR_CONST_BOOL: { string_builder_append(sb, instr->as.boolean ? " true" : " false"); } break;
+
+  case IR_CONST_BIGINT:
+  {
+    string_builder_append_fmt(sb, " %.*s", (int) instr->as.literal.len, instr->as.literal.chars);
+  } break;
+
+  case IR_CONST_STRING:
+  {
+    string_builder_append_fmt(sb, " \"%.*s\"", (int) instr->as.literal.len, instr->as.literal.chars);
+  } break;
+
+  case IR_FUNCTION:
+  case IR_CLOSURE:
+  case IR_IS_FUNCTION:
+  {
+    const Func_Expression *fexpr = instr->as.function;
+    if (fexpr->name != FUNC_ANONYMOUS)
+    {
+      string_builder_append_fmt(sb, " %s", ident_handle_to_ident(fn->program, fexpr->name));
+    }
+  } break;
+
+  case IR_PARAM:
+  case IR_LOAD_GLOBAL:
+  case IR_STORE_GLOBAL:
+  case IR_LOAD_UPVALUE:
+  case IR_STORE_UPVALUE:
+  case IR_CALL_GLOBAL:
+  case IR_TAIL_CALL_GLOBAL:
+  {
+    string_builder_append_fmt(sb, " %zu", instr->as.slot);
+  } break;
+
+  case IR_CALL_NATIVE:
+  {
+    string_builder_append_fmt(sb, " %s", BUILTINS[instr->as.slot].name);
+  } break;
+
+  default: {} break;
+  }
+
+  for (size_t i = 0; i < instr->args.len; ++i)
+  {
+    string_builder_append(sb, i > 0 ? ", " : " ");
+    if (instr->op == IR_PHI)
+    {
+      string_builder_append_fmt(sb, "[b%" PRIu32 ": ", block->preds.elems[i]);
+      ir_append_value(fn, instr->args.elems[i], sb);
+      string_builder_append(sb, "]");
+    }
+    else
+    {
+      ir_append_value(fn, instr->args.elems[i], sb);
+    }
+  }
+
+  if (instr->op == IR_JUMP || instr->op == IR_BRANCH)
+  {
+    for (size_t i = 0; i < block->succs_len; ++i)
+    {
+      string_builder_append_fmt(sb, "%sb%" PRIu32, instr->args.len > 0 || i > 0 ? ", " : " ", block->succs[i]);
+    }
+  }
+  string_builder_append(sb, "\n");
+}
+
+
+///
+/// public functions
+///
+
+Ir_Options ir_default_options(void)
+{
+  Ir_Options options = {
+    .fold = true,
+    .gvn = true,
+    .licm = true,
+    .dce = true,
+    .inline_calls = true,
+    .inline_max_size = 32,
+    .inline_budget = 256,
+    .inline_max_depth = 3,
+    .call_profile = NULL,
+    .globals = NULL,
+  };
+  return options;
+}
+
+bool ir_build_function(Ir_Function *fn, const Program *prog, const Func_Expression *fexpr)
+{
+  memset(fn, 0, sizeof(*fn));
+  fn->program = prog;
+  fn->fexpr = fexpr;
+  fn->arity = fexpr ? fexpr->params_len : 0;
+  va_array_init(Ir_Instr, fn->instrs);
+  va_array_init(Ir_Block, fn->blocks);
+
+  Ir_Builder b = { .fn = fn, .current = 0, .pos = 0 };
+  b.current = ir_new_sealed_block(&b);
+  for (size_t i = 0; i < fn->arity; ++i)
+  {
+    Ir_Value param = ir_emit(&b, IR_PARAM);
+    ir_instr(fn, param)->as.slot = i;
+    ir_write_local(fn, b.current, i, param);
+  }
+
+  if (fexpr && fexpr->lazy)
+  {
+    ir_unsupported(&b, "its body was only pre-parsed");
+  }
+  else if (fexpr)
+  {
+    b.pos = statement_handle_to_statement(prog, fexpr->body)->location.pos;
+    ir_build_statement(&b, ir_statement(&b, fexpr->body));
+  }
+  else
+  {
+    for (size_t i = 0; i < prog->statements.len && !fn->unsupported; ++i)
+    {
+      ir_build_statement(&b, &prog->statements.elems[i]);
+    }
+  }
+
+  if (!fn->unsupported && !ir_block_terminated(fn, b.current))
+  {
+    ir_emit_unary(&b, IR_RETURN, ir_emit(&b, IR_CONST_NIL));
+  }
+
+  // NOTE(HS): the construction state is only needed while the IR is being built
+  for (size_t i = 0; i < fn->blocks.len; ++i)
+  {
+    Ir_Block *block = &fn->blocks.elems[i];
+    tfree(block->defs);
+    block->defs = NULL;
+    block->defs_len = 0;
+    va_array_free(block->incomplete_phis);
+  }
+  return !fn->unsupported;
+}
+
+void ir_function_free(Ir_Function *fn)
+{
+  for (size_t i = 0; i < fn->instrs.len; ++i)
+  {
+    va_array_free(fn->instrs.elems[i].args);
+  }
+  for (size_t i = 0; i < fn->blocks.len; ++i)
+  {
+    Ir_Block *block = &fn->blocks.elems[i];
+    va_array_free(block->phis);
+    va_array_free(block->instrs);
+    va_array_free(block->preds);
+    tfree(block->defs);
+    va_array_free(block->incomplete_phis);
+  }
+  va_array_free(fn->instrs);
+  va_array_free(fn->blocks);
+  va_array_free(fn->order);
+}
+
+Ir_Value ir_resolve(const Ir_Function *fn, Ir_Value v)
+{
+  while (fn->instrs.elems[v].replacement != IR_NONE)
+  {
+    v = fn->instrs.elems[v].replacement;
+  }
+  return v;
+}
+
+size_t ir_op_flags(Ir_Op op)
+{
+  size_t flags = 0;
+  switch (op)
+  {
+#define X(NAME, FLAGS) case IR_##NAME: { flags = (FLAGS); } break;
+    #include "defs/ir-op.def"
+#undef X
+  }
+  return flags;
+}
+
+const char *ir_op_to_string(Ir_Op op)
+{
+  const char *str = "<invalid>";
+  switch (op)
+  {
+#define X(NAME, FLAGS) case IR_##NAME: { str = #NAME; } break;
+    #include "defs/ir-op.def"
+#undef X
+  }
+  return str;
+}
+
+void ir_function_append(const Ir_Function *fn, String_Builder *sb)
+{
+  const Ir_Id_VaArray *order = &fn->order;
+  size_t len = order->len > 0 ? order->len : fn->blocks.len;
+  for (size_t i = 0; i < len; ++i)
+  {
+    Ir_Block_Id id = order->len > 0 ? order->elems[i] : (Ir_Block_Id) i;
+    const Ir_Block *block = &fn->blocks.elems[id];
+    if (block->removed)
+    {
+      continue;
+    }
+
+    string_builder_append_fmt(sb, "b%" PRIu32 ":", id);
+    if (block->preds.len > 0)
+    {
+      string_builder_append(sb, " ; preds ");
+      ir_append_block_list(&block->preds, sb);
+    }
+    string_builder_append(sb, "\n");
+
+    for (size_t j = 0; j < block->phis.len; ++j)
+    {
+      if (!fn->instrs.elems[block->phis.elems[j]].removed)
+      {
+        ir_append_instr(fn, block->phis.elems[j], sb);
+      }
+    }
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      if (!fn->instrs.elems[block->instrs.elems[j]].removed)
+      {
+        ir_append_instr(fn, block->instrs.elems[j], sb);
+      }
+    }
+  }
+}
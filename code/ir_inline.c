@@ -0,0 +1,618 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_COMPILER
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "util.h"
+
+/// The state of inlining into one function, and into the functions inlined into it.
+///
+/// NOTE(HS): a callee has the calls in it inlined before it's inlined itself, so the
+/// size it's judged by is the size it'll add. `stack` holds the function being
+/// inlined into and every one it's being inlined into in turn, none of which are
+/// inlined again, which stops (mutual) recursion unrolling itself.
+typedef struct ir_inliner
+{
+  const Program *program;
+  Ir_Options options;
+
+  const Ir_Globals *globals;
+
+  const Func_Expression **stack;
+  size_t stack_len;
+} Ir_Inliner;
+
+/// the function a call calls, `guarded` when it's only a guess
+typedef struct ir_call_target
+{
+  const Func_Expression *fexpr;
+  bool guarded;
+} Ir_Call_Target;
+
+///
+/// internal functions
+///
+
+static inline Ir_Instr *ir_instr(Ir_Function *fn, Ir_Value v)
+{
+  assert(v < fn->instrs.len);
+  return &fn->instrs.elems[v];
+}
+
+static inline Ir_Block *ir_block(Ir_Function *fn, Ir_Block_Id id)
+{
+  assert(id < fn->blocks.len);
+  return &fn->blocks.elems[id];
+}
+
+static inline bool ir_is_call(Ir_Op op)
+{
+  return op == IR_CALL || op == IR_CALL_GLOBAL || op == IR_TAIL_CALL || op == IR_TAIL_CALL_GLOBAL;
+}
+
+static Ir_Block_Id ir_new_block(Ir_Function *fn)
+{
+  Ir_Block block;
+  memset(&block, 0, sizeof(block));
+  block.idom = IR_NONE;
+  block.sealed = true;
+  Ir_Block_Id id = (Ir_Block_Id) fn->blocks.len;
+  va_array_append(fn->blocks, block);
+  return id;
+}
+
+static Ir_Value ir_new_instr(Ir_Function *fn, Ir_Op op, size_t pos)
+{
+  Ir_Instr instr;
+  memset(&instr, 0, sizeof(instr));
+  instr.op = op;
+  instr.block = IR_NONE;
+  instr.pos = pos;
+  instr.replacement = IR_NONE;
+  instr.type = IR_TYPE_ANY;
+  Ir_Value v = (Ir_Value) fn->instrs.len;
+  va_array_append(fn->instrs, instr);
+  return v;
+}
+
+/// appends the instruction `v` to the block `id`
+static void ir_append(Ir_Function *fn, Ir_Block_Id id, Ir_Value v)
+{
+  ir_instr(fn, v)->block = id;
+  va_array_append(ir_block(fn, id)->instrs, v);
+}
+
+static inline void ir_add_arg(Ir_Function *fn, Ir_Value v, Ir_Value arg)
+{
+  va_array_append(ir_instr(fn, v)->args, arg);
+}
+
+static void ir_add_edge(Ir_Function *fn, Ir_Block_Id from, Ir_Block_Id to)
+{
+  Ir_Block *pred = ir_block(fn, from);
+  assert(pred->succs_len < 2);
+  pred->succs[pred->succs_len++] = to;
+  va_array_append(ir_block(fn, to)->preds, from);
+}
+
+/// counts the stores to each global in `stmts`, noting the literal of any `var` which
+/// declares one as a function
+static void ir_scan_globals(
+  Ir_Globals *globals, const Program *prog, const Statement_VaArray *stmts, size_t **stores
+)
+{
+  for (size_t i = 0; i < stmts->len; ++i)
+  {
+    const Statement *stmt = &stmts->elems[i];
+    const Binding *binding;
+    Expression_Handle value;
+    if (stmt->kind == STMT_VAR)
+    {
+      binding = &stmt->statement.var_statement.binding;
+      value = stmt->statement.var_statement.expression_handle;
+    }
+    else if (stmt->kind == STMT_ASSIGN)
+    {
+      binding = &stmt->statement.assign_statement.binding;
+      value = stmt->statement.assign_statement.expression_handle;
+    }
+    else
+    {
+      continue;
+    }
+    if (binding->kind != BINDING_GLOBAL)
+    {
+      continue;
+    }
+
+    size_t slot = binding->slot;
+    if (slot >= globals->len)
+    {
+      size_t len = va_array_capacity_for(globals->len, slot + 1);
+      globals->literals = trealloc(globals->literals, len * sizeof(globals->literals[0]));
+      *stores = trealloc(*stores, len * sizeof(size_t));
+      assert(globals->literals && *stores);
+      for (size_t j = globals->len; j < len; ++j)
+      {
+        globals->literals[j] = NULL;
+        (*stores)[j] = 0;
+      }
+      globals->len = len;
+    }
+
+    const Expression *expr = expression_handle_to_expression(prog, value);
+    (*stores)[slot] += 1;
+    globals->literals[slot] = stmt->kind == STMT_VAR && expr->kind == EXPR_FUNC
+      ? &expr->expression.func_expression
+      : NULL;
+  }
+}
+
+/// the function literal at `pos`, NULL when there isn't one
+static const Func_Expression *ir_literal_at(const Program *prog, size_t pos)
+{
+  const Expression_VaArray *exprs = &prog->context.expressions;
+  for (size_t i = 0; i < exprs->len; ++i)
+  {
+    if (exprs->elems[i].kind == EXPR_FUNC && exprs->elems[i].location.pos == pos)
+    {
+      return &exprs->elems[i].expression.func_expression;
+    }
+  }
+  return NULL;
+}
+
+static Ir_Call_Target ir_call_target(const Ir_Inliner *in, Ir_Function *fn, Ir_Value site)
+{
+  const Ir_Instr *call = ir_instr(fn, site);
+  Ir_Call_Target target = { .fexpr = NULL, .guarded = true };
+  if (call->op == IR_CALL || call->op == IR_TAIL_CALL)
+  {
+    const Ir_Instr *callee = ir_instr(fn, ir_resolve(fn, call->args.elems[0]));
+    if (callee->op == IR_FUNCTION)
+    {
+      target = (Ir_Call_Target) { .fexpr = callee->as.function, .guarded = false };
+    }
+  }
+  else if (call->as.slot < in->globals->len)
+  {
+    target.fexpr = in->globals->literals[call->as.slot];
+  }
+
+  const Call_Profile *profile = in->options.call_profile;
+  if (!target.fexpr && profile)
+  {
+    size_t callee = call_profile_lookup(profile, call->pos);
+    if (callee != CALL_PROFILE_POLYMORPHIC)
+    {
+      target.fexpr = ir_literal_at(in->program, callee);
+    }
+  }
+  return target;
+}
+
+/// instructions in the blocks of `fn` which are reached
+static size_t ir_size(const Ir_Function *fn)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    const Ir_Block *block = &fn->blocks.elems[fn->order.elems[i]];
+    size += block->phis.len + block->instrs.len;
+  }
+  return size;
+}
+
+static bool ir_calls_itself(const Ir_Inliner *in, Ir_Function *fn)
+{
+  for (size_t i = 0; i < fn->instrs.len; ++i)
+  {
+    const Ir_Instr *instr = &fn->instrs.elems[i];
+    if (!instr->removed && ir_is_call(instr->op) && ir_call_target(in, fn, (Ir_Value) i).fexpr == fn->fexpr)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void ir_inline_calls(Ir_Inliner *in, Ir_Function *fn);
+
+/// builds, inlines into and optimises `callee` for a call with `argc` arguments,
+/// returns false (having freed it) when it isn't to be inlined
+static bool ir_inline_prepare(Ir_Inliner *in, Ir_Function *callee, const Func_Expression *fexpr, size_t argc, size_t budget)
+{
+  // NOTE(HS): a call with the wrong number of arguments is left to report the error
+  if (fexpr->memo || fexpr->upvalues_len > 0 || fexpr->params_len != argc)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < in->stack_len; ++i)
+  {
+    if (in->stack[i] == fexpr)
+    {
+      return false;
+    }
+  }
+
+  bool ok = ir_build_function(callee, in->program, fexpr) && !ir_calls_itself(in, callee);
+  if (ok)
+  {
+    ir_inline_calls(in, callee);
+    Ir_Options options = in->options;
+    options.inline_calls = false;
+    ir_optimise(callee, options);
+
+    size_t size = ir_size(callee);
+    ok = size <= in->options.inline_max_size && size <= budget;
+  }
+  if (!ok)
+  {
+    ir_function_free(callee);
+  }
+  return ok;
+}
+
+/// Replaces the call `site` with the body of `callee`, after a guard when `guarded`.
+///
+/// NOTE(HS): the block the call is in is split after it, returns from the callee jump to
+/// the second half, where the call's value becomes the phi of what was returned (and
+/// what the call made in place of the body returned). A tail call stays one, the
+/// callee's returns are the caller's.
+static void ir_splice(Ir_Function *fn, Ir_Value site, const Ir_Function *callee, bool guarded)
+{
+  Ir_Instr call = *ir_instr(fn, site);
+  bool tail = call.op == IR_TAIL_CALL || call.op == IR_TAIL_CALL_GLOBAL;
+  bool global = call.op == IR_CALL_GLOBAL || call.op == IR_TAIL_CALL_GLOBAL;
+  size_t first_arg = global ? 0 : 1;
+  Ir_Block_Id from = call.block;
+
+  Ir_Value *args = tmalloc((call.args.len + 1) * sizeof(Ir_Value));
+  assert(args);
+  if (call.args.len > 0)
+  {
+    memcpy(args, call.args.elems, call.args.len * sizeof(Ir_Value));
+  }
+  size_t argc = call.args.len;
+
+  Ir_Id_VaArray *instrs = &ir_block(fn, from)->instrs;
+  size_t at = 0;
+  while (instrs->elems[at] != site)
+  {
+    at += 1;
+  }
+
+  Ir_Block_Id after = IR_NONE;
+  if (!tail)
+  {
+    after = ir_new_block(fn);
+    for (size_t i = at + 1; i < ir_block(fn, from)->instrs.len; ++i)
+    {
+      ir_append(fn, after, ir_block(fn, from)->instrs.elems[i]);
+    }
+    Ir_Block *split = ir_block(fn, from);
+    Ir_Block *rest = ir_block(fn, after);
+    rest->succs_len = split->succs_len;
+    for (size_t i = 0; i < split->succs_len; ++i)
+    {
+      rest->succs[i] = split->succs[i];
+      Ir_Block *succ = ir_block(fn, split->succs[i]);
+      for (size_t j = 0; j < succ->preds.len; ++j)
+      {
+        if (succ->preds.elems[j] == from)
+        {
+          succ->preds.elems[j] = after;
+        }
+      }
+    }
+    split->succs_len = 0;
+  }
+  ir_block(fn, from)->instrs.len = at;
+
+  Ir_Block_Id *blocks = tmalloc((callee->blocks.len + 1) * sizeof(Ir_Block_Id));
+  Ir_Value *values = tmalloc((callee->instrs.len + 1) * sizeof(Ir_Value));
+  assert(blocks && values);
+  for (size_t i = 0; i < callee->blocks.len; ++i)
+  {
+    blocks[i] = IR_NONE;
+  }
+  for (size_t i = 0; i < callee->instrs.len; ++i)
+  {
+    values[i] = IR_NONE;
+  }
+  for (size_t i = 0; i < callee->order.len; ++i)
+  {
+    blocks[callee->order.elems[i]] = ir_new_block(fn);
+  }
+
+  // NOTE(HS): every value is made before any operands are filled in, phis may refer to
+  // values from later blocks
+  for (size_t i = 0; i < callee->order.len; ++i)
+  {
+    Ir_Block_Id id = callee->order.elems[i];
+    const Ir_Block *block = &callee->blocks.elems[id];
+    for (size_t j = 0; j < block->phis.len; ++j)
+    {
+      const Ir_Instr *instr = &callee->instrs.elems[block->phis.elems[j]];
+      if (instr->removed)
+      {
+        continue;
+      }
+      Ir_Value v = ir_new_instr(fn, IR_PHI, instr->pos);
+      ir_instr(fn, v)->as = instr->as;
+      ir_instr(fn, v)->block = blocks[id];
+      va_array_append(ir_block(fn, blocks[id])->phis, v);
+      values[block->phis.elems[j]] = v;
+    }
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      const Ir_Instr *instr = &callee->instrs.elems[block->instrs.elems[j]];
+      if (instr->removed)
+      {
+        continue;
+      }
+      if (instr->op == IR_PARAM)
+      {
+        values[block->instrs.elems[j]] = args[first_arg + instr->as.slot];
+        continue;
+      }
+      Ir_Value v = ir_new_instr(fn, instr->op, instr->pos);
+      ir_instr(fn, v)->as = instr->as;
+      ir_append(fn, blocks[id], v);
+      values[block->instrs.elems[j]] = v;
+    }
+  }
+
+  Ir_Id_VaArray returns = { NULL, 0, 0 };
+  if (guarded)
+  {
+    Ir_Value callee_value = args[0];
+    if (global)
+    {
+      callee_value = ir_new_instr(fn, IR_LOAD_GLOBAL, call.pos);
+      ir_instr(fn, callee_value)->as.slot = call.as.slot;
+      ir_append(fn, from, callee_value);
+    }
+    Ir_Value test = ir_new_instr(fn, IR_IS_FUNCTION, call.pos);
+    ir_instr(fn, test)->as.function = callee->fexpr;
+    ir_add_arg(fn, test, callee_value);
+    ir_append(fn, from, test);
+    Ir_Value branch = ir_new_instr(fn, IR_BRANCH, call.pos);
+    ir_add_arg(fn, branch, test);
+    ir_append(fn, from, branch);
+    ir_add_edge(fn, from, blocks[0]);
+
+    Ir_Block_Id slow = ir_new_block(fn);
+    ir_add_edge(fn, from, slow);
+    Ir_Value made = ir_new_instr(fn, call.op, call.pos);
+    ir_instr(fn, made)->as = call.as;
+    for (size_t i = 0; i < argc; ++i)
+    {
+      ir_add_arg(fn, made, args[i]);
+    }
+    ir_append(fn, slow, made);
+    if (!tail)
+    {
+      ir_append(fn, slow, ir_new_instr(fn, IR_JUMP, call.pos));
+      ir_add_edge(fn, slow, after);
+      va_array_append(returns, made);
+    }
+  }
+  else
+  {
+    ir_append(fn, from, ir_new_instr(fn, IR_JUMP, call.pos));
+    ir_add_edge(fn, from, blocks[0]);
+  }
+
+  for (size_t i = 0; i < callee->order.len; ++i)
+  {
+    Ir_Block_Id id = callee->order.elems[i];
+    const Ir_Block *block = &callee->blocks.elems[id];
+    Ir_Block_Id copy = blocks[id];
+
+    // NOTE(HS): predecessors which weren't reached aren't copied, nor is what they give
+    // the block's phis
+    for (size_t p = 0; p < block->preds.len; ++p)
+    {
+      Ir_Block_Id pred = blocks[block->preds.elems[p]];
+      if (pred == IR_NONE)
+      {
+        continue;
+      }
+      va_array_append(ir_block(fn, copy)->preds, pred);
+      for (size_t j = 0; j < block->phis.len; ++j)
+      {
+        const Ir_Instr *phi = &callee->instrs.elems[block->phis.elems[j]];
+        if (phi->removed)
+        {
+          continue;
+        }
+        ir_add_arg(fn, values[block->phis.elems[j]], values[ir_resolve(callee, phi->args.elems[p])]);
+      }
+    }
+    ir_block(fn, copy)->succs_len = block->succs_len;
+    for (size_t s = 0; s < block->succs_len; ++s)
+    {
+      ir_block(fn, copy)->succs[s] = blocks[block->succs[s]];
+    }
+
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      const Ir_Instr *instr = &callee->instrs.elems[block->instrs.elems[j]];
+      if (instr->removed || instr->op == IR_PARAM)
+      {
+        continue;
+      }
+      Ir_Value v = values[block->instrs.elems[j]];
+      for (size_t k = 0; k < instr->args.len; ++k)
+      {
+        ir_add_arg(fn, v, values[ir_resolve(callee, instr->args.elems[k])]);
+      }
+      if (tail)
+      {
+        continue;
+      }
+
+      if (instr->op == IR_RETURN)
+      {
+        Ir_Instr *jump = ir_instr(fn, v);
+        jump->op = IR_JUMP;
+        va_array_append(returns, jump->args.elems[0]);
+        jump->args.len = 0;
+        ir_add_edge(fn, copy, after);
+      }
+      else if (instr->op == IR_TAIL_CALL || instr->op == IR_TAIL_CALL_GLOBAL)
+      {
+        ir_instr(fn, v)->op = instr->op == IR_TAIL_CALL ? IR_CALL : IR_CALL_GLOBAL;
+        va_array_append(returns, v);
+        ir_append(fn, copy, ir_new_instr(fn, IR_JUMP, instr->pos));
+        ir_add_edge(fn, copy, after);
+      }
+    }
+  }
+
+  // NOTE(HS): the call's own value stands for the result, so its uses needn't change
+  Ir_Instr *replaced = ir_instr(fn, site);
+  replaced->args.len = 0;
+  if (tail)
+  {
+    replaced->removed = true;
+  }
+  else if (returns.len == 1)
+  {
+    replaced->removed = true;
+    replaced->replacement = returns.elems[0];
+  }
+  else if (returns.len == 0)
+  {
+    // NOTE(HS): the callee never returns, nothing after the call is reached
+    replaced->op = IR_CONST_NIL;
+    replaced->block = after;
+    Ir_Id_VaArray *rest = &ir_block(fn, after)->instrs;
+    va_array_append(*rest, site);
+    memmove(rest->elems + 1, rest->elems, (rest->len - 1) * sizeof(rest->elems[0]));
+    rest->elems[0] = site;
+  }
+  else
+  {
+    replaced->op = IR_PHI;
+    replaced->block = after;
+    replaced->as.slot = 0;
+    for (size_t i = 0; i < returns.len; ++i)
+    {
+      ir_add_arg(fn, site, returns.elems[i]);
+    }
+    va_array_append(ir_block(fn, after)->phis, site);
+  }
+
+  va_array_free(returns);
+  tfree(values);
+  tfree(blocks);
+  tfree(args);
+}
+
+static void ir_inline_calls(Ir_Inliner *in, Ir_Function *fn)
+{
+  if (in->stack_len >= in->options.inline_max_depth)
+  {
+    return;
+  }
+  in->stack[in->stack_len++] = fn->fexpr;
+
+  // NOTE(HS): the sites are found up front, calls which were inlined into the callees
+  // already aren't looked at again
+  ir_compute_order(fn);
+  Ir_Id_VaArray sites = { NULL, 0, 0 };
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    const Ir_Block *block = &fn->blocks.elems[fn->order.elems[i]];
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      if (ir_is_call(fn->instrs.elems[block->instrs.elems[j]].op))
+      {
+        va_array_append(sites, block->instrs.elems[j]);
+      }
+    }
+  }
+
+  size_t budget = in->options.inline_budget;
+  for (size_t i = 0; i < sites.len; ++i)
+  {
+    Ir_Call_Target target = ir_call_target(in, fn, sites.elems[i]);
+    if (!target.fexpr)
+    {
+      continue;
+    }
+
+    const Ir_Instr *call = ir_instr(fn, sites.elems[i]);
+    size_t argc = call->args.len - (call->op == IR_CALL || call->op == IR_TAIL_CALL ? 1 : 0);
+    Ir_Function callee;
+    if (ir_inline_prepare(in, &callee, target.fexpr, argc, budget))
+    {
+      budget -= ir_size(&callee);
+      ir_splice(fn, sites.elems[i], &callee, target.guarded);
+      ir_function_free(&callee);
+    }
+  }
+
+  va_array_free(sites);
+  ir_compute_order(fn);
+  in->stack_len -= 1;
+}
+
+
+///
+/// public functions
+///
+
+void ir_globals_init(Ir_Globals *globals, const Program *prog)
+{
+  globals->literals = NULL;
+  globals->len = 0;
+
+  // NOTE(HS): a global set by more than one statement (or by anything but a literal)
+  // could hold any function
+  size_t *stores = NULL;
+  ir_scan_globals(globals, prog, &prog->statements, &stores);
+  ir_scan_globals(globals, prog, &prog->context.statements, &stores);
+  for (size_t i = 0; i < globals->len; ++i)
+  {
+    if (stores[i] != 1)
+    {
+      globals->literals[i] = NULL;
+    }
+  }
+  tfree(stores);
+}
+
+void ir_globals_free(Ir_Globals *globals)
+{
+  tfree(globals->literals);
+  globals->literals = NULL;
+  globals->len = 0;
+}
+
+void ir_inline(Ir_Function *fn, Ir_Options options)
+{
+  Ir_Globals globals;
+  if (!options.globals)
+  {
+    ir_globals_init(&globals, fn->program);
+  }
+
+  Ir_Inliner in = {
+    .program = fn->program,
+    .options = options,
+    .globals = options.globals ? options.globals : &globals,
+    .stack = tmalloc((options.inline_max_depth + 2) * sizeof(const Func_Expression*)),
+    .stack_len = 0,
+  };
+  assert(in.stack);
+
+  ir_inline_calls(&in, fn);
+  tfree(in.stack);
+  if (!options.globals)
+  {
+    ir_globals_free(&globals);
+  }
+}
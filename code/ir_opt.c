@@ -0,0 +1,1322 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_COMPILER
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "bigint.h"
+#include "util.h"
+
+/// a pass over the IR gives up on making further changes after this many rounds
+#define IR_MAX_ROUNDS 16
+
+///
+/// internal functions
+///
+
+static inline Ir_Instr *ir_instr(Ir_Function *fn, Ir_Value v)
+{
+  assert(v < fn->instrs.len);
+  return &fn->instrs.elems[v];
+}
+
+static inline Ir_Block *ir_block(Ir_Function *fn, Ir_Block_Id id)
+{
+  assert(id < fn->blocks.len);
+  return &fn->blocks.elems[id];
+}
+
+/// the instruction operand `i` of `instr` resolves to
+static inline const Ir_Instr *ir_arg(const Ir_Function *fn, const Ir_Instr *instr, size_t i)
+{
+  return &fn->instrs.elems[ir_resolve(fn, instr->args.elems[i])];
+}
+
+static inline Ir_Value ir_terminator(const Ir_Function *fn, Ir_Block_Id id)
+{
+  const Ir_Block *block = &fn->blocks.elems[id];
+  assert(block->instrs.len > 0);
+  return block->instrs.elems[block->instrs.len - 1];
+}
+
+static inline bool ir_is_const(const Ir_Instr *instr)
+{
+  return instr->op == IR_CONST_INT || instr->op == IR_CONST_BOOL || instr->op == IR_CONST_NIL;
+}
+
+static void ir_remove(Ir_Function *fn, Ir_Value v, Ir_Value replacement)
+{
+  Ir_Instr *instr = ir_instr(fn, v);
+  instr->removed = true;
+  instr->replacement = replacement;
+}
+
+/// turns an instruction into a constant in place, keeping its position
+static void ir_make_int(Ir_Function *fn, Ir_Value v, int64_t value)
+{
+  Ir_Instr *instr = ir_instr(fn, v);
+  instr->op = IR_CONST_INT;
+  instr->args.len = 0;
+  instr->as.integer = value;
+}
+
+static void ir_make_bool(Ir_Function *fn, Ir_Value v, bool value)
+{
+  Ir_Instr *instr = ir_instr(fn, v);
+  instr->op = IR_CONST_BOOL;
+  instr->args.len = 0;
+  instr->as.boolean = value;
+}
+
+static bool ir_is_truthy(const Ir_Instr *instr)
+{
+  return !(instr->op == IR_CONST_NIL || (instr->op == IR_CONST_BOOL && !instr->as.boolean));
+}
+
+/// whether the constants `a` and `b` are equal, as `value_equals` would judge them
+static bool ir_const_equals(const Ir_Instr *a, const Ir_Instr *b)
+{
+  if (a->op != b->op)
+  {
+    return false;
+  }
+  switch (a->op)
+  {
+  case IR_CONST_INT:  { return a->as.integer == b->as.integer; } break;
+  case IR_CONST_BOOL: { return a->as.boolean == b->as.boolean; } break;
+  default:            { return true; } break;
+  }
+}
+
+/// removes the edge from `pred` into `id`, along with the operand it gave each phi
+static void ir_remove_pred(Ir_Function *fn, Ir_Block_Id id, Ir_Block_Id pred)
+{
+  Ir_Block *block = ir_block(fn, id);
+  size_t i = 0;
+  while (i < block->preds.len && block->preds.elems[i] != pred)
+  {
+    i += 1;
+  }
+  assert(i < block->preds.len);
+
+  memmove(&block->preds.elems[i], &block->preds.elems[i + 1], (block->preds.len - i - 1) * sizeof(Ir_Block_Id));
+  block->preds.len -= 1;
+  for (size_t j = 0; j < block->phis.len; ++j)
+  {
+    Ir_Instr *phi = ir_instr(fn, block->phis.elems[j]);
+    memmove(&phi->args.elems[i], &phi->args.elems[i + 1], (phi->args.len - i - 1) * sizeof(Ir_Value));
+    phi->args.len -= 1;
+  }
+}
+
+/// drops removed instructions from the lists of their blocks
+static void ir_compact(Ir_Function *fn)
+{
+  for (size_t i = 0; i < fn->blocks.len; ++i)
+  {
+    Ir_Block *block = &fn->blocks.elems[i];
+    Ir_Id_VaArray *lists[] = { &block->phis, &block->instrs };
+    for (size_t l = 0; l < 2; ++l)
+    {
+      size_t len = 0;
+      for (size_t j = 0; j < lists[l]->len; ++j)
+      {
+        if (!fn->instrs.elems[lists[l]->elems[j]].removed)
+        {
+          lists[l]->elems[len++] = lists[l]->elems[j];
+        }
+      }
+      lists[l]->len = len;
+    }
+  }
+}
+
+/// marks blocks which are no longer reachable as removed, returns whether there were any
+static bool ir_remove_unreachable(Ir_Function *fn)
+{
+  ir_compute_order(fn);
+  bool changed = false;
+  for (size_t i = 0; i < fn->blocks.len; ++i)
+  {
+    Ir_Block *block = &fn->blocks.elems[i];
+    if (block->removed || block->order != SIZE_MAX)
+    {
+      continue;
+    }
+
+    block->removed = true;
+    changed = true;
+    for (size_t j = 0; j < block->succs_len; ++j)
+    {
+      ir_remove_pred(fn, block->succs[j], (Ir_Block_Id) i);
+    }
+    block = &fn->blocks.elems[i];
+    block->succs_len = 0;
+    for (size_t j = 0; j < block->phis.len; ++j)
+    {
+      ir_remove(fn, block->phis.elems[j], IR_NONE);
+    }
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      ir_remove(fn, block->instrs.elems[j], IR_NONE);
+    }
+  }
+  return changed;
+}
+
+static bool ir_fold_phi(Ir_Function *fn, Ir_Value phi)
+{
+  const Ir_Instr *instr = ir_instr(fn, phi);
+  Ir_Value same = IR_NONE;
+  for (size_t i = 0; i < instr->args.len; ++i)
+  {
+    Ir_Value arg = ir_resolve(fn, instr->args.elems[i]);
+    if (arg == same || arg == phi)
+    {
+      continue;
+    }
+    if (same != IR_NONE)
+    {
+      return false;
+    }
+    same = arg;
+  }
+
+  // NOTE(HS): a phi with no operands other than itself is in a loop nothing enters
+  if (same == IR_NONE)
+  {
+    return false;
+  }
+  ir_remove(fn, phi, same);
+  return true;
+}
+
+static bool ir_fold_binary(Ir_Function *fn, Ir_Value v)
+{
+  const Ir_Instr *instr = ir_instr(fn, v);
+  Ir_Value lhs_v = ir_resolve(fn, instr->args.elems[0]);
+  Ir_Value rhs_v = ir_resolve(fn, instr->args.elems[1]);
+  const Ir_Instr *lhs = ir_instr(fn, lhs_v);
+  const Ir_Instr *rhs = ir_instr(fn, rhs_v);
+  bool ints = lhs->op == IR_CONST_INT && rhs->op == IR_CONST_INT;
+  int64_t a = lhs->as.integer;
+  int64_t b = rhs->as.integer;
+  int64_t result;
+
+  switch (instr->op)
+  {
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  {
+    bool overflows = true;
+    if (ints)
+    {
+      overflows = instr->op == IR_ADD ? int_add_overflow(a, b, &result)
+        : instr->op == IR_SUB ? int_sub_overflow(a, b, &result)
+        : int_mul_overflow(a, b, &result);
+    }
+    if (!overflows)
+    {
+      ir_make_int(fn, v, result);
+      return true;
+    }
+
+    // NOTE(HS): `x + 0` is only `x` when the addition can't fail, or be a concatenation
+    bool is_number = (lhs->type & ~IR_TYPE_NUMBER) == 0 && lhs->type != 0;
+    bool identity = (instr->op != IR_MUL && rhs->op == IR_CONST_INT && b == 0)
+      || (instr->op == IR_MUL && rhs->op == IR_CONST_INT && b == 1);
+    if (identity && is_number)
+    {
+      ir_remove(fn, v, lhs_v);
+      return true;
+    }
+  } break;
+
+  case IR_DIV:
+  {
+    if (ints && b != 0 && !(a == INT64_MIN && b == -1))
+    {
+      ir_make_int(fn, v, a / b);
+      return true;
+    }
+  } break;
+
+  case IR_LT:  { if (ints) { ir_make_bool(fn, v, a < b); return true; } } break;
+  case IR_GT:  { if (ints) { ir_make_bool(fn, v, a > b); return true; } } break;
+  case IR_LTE: { if (ints) { ir_make_bool(fn, v, a <= b); return true; } } break;
+  case IR_GTE: { if (ints) { ir_make_bool(fn, v, a >= b); return true; } } break;
+
+  case IR_EQ:
+  case IR_NOT_EQ:
+  {
+    bool negate = instr->op == IR_NOT_EQ;
+    if (lhs_v == rhs_v)
+    {
+      ir_make_bool(fn, v, !negate);
+      return true;
+    }
+    if (ir_is_const(lhs) && ir_is_const(rhs))
+    {
+      ir_make_bool(fn, v, ir_const_equals(lhs, rhs) != negate);
+      return true;
+    }
+  } break;
+
+  default: {} break;
+  }
+  return false;
+}
+
+static bool ir_fold_instr(Ir_Function *fn, Ir_Value v)
+{
+  const Ir_Instr *instr = ir_instr(fn, v);
+  switch (instr->op)
+  {
+  case IR_NOT:
+  {
+    const Ir_Instr *operand = ir_arg(fn, instr, 0);
+    if (ir_is_const(operand))
+    {
+      ir_make_bool(fn, v, !ir_is_truthy(operand));
+      return true;
+    }
+  } break;
+
+  case IR_NEGATE:
+  {
+    const Ir_Instr *operand = ir_arg(fn, instr, 0);
+    if (operand->op == IR_CONST_INT && operand->as.integer != INT64_MIN)
+    {
+      ir_make_int(fn, v, -operand->as.integer);
+      return true;
+    }
+  } break;
+
+  case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+  case IR_EQ: case IR_NOT_EQ: case IR_LT: case IR_GT: case IR_LTE: case IR_GTE:
+  {
+    return ir_fold_binary(fn, v);
+  } break;
+
+  // NOTE(HS): distinct literals compile to distinct functions
+  case IR_IS_FUNCTION:
+  {
+    const Ir_Instr *operand = ir_arg(fn, instr, 0);
+    if (operand->op == IR_FUNCTION || operand->op == IR_CLOSURE)
+    {
+      ir_make_bool(fn, v, operand->as.function == instr->as.function);
+      return true;
+    }
+    if (ir_is_const(operand) || operand->op == IR_CONST_STRING || operand->op == IR_CONST_BIGINT)
+    {
+      ir_make_bool(fn, v, false);
+      return true;
+    }
+  } break;
+
+  case IR_BRANCH:
+  {
+    Ir_Block_Id id = instr->block;
+    const Ir_Instr *condition = ir_arg(fn, instr, 0);
+    Ir_Block *block = ir_block(fn, id);
+
+    // NOTE(HS): a branch on `!x` is a branch on `x` the other way round
+    if (condition->op == IR_NOT)
+    {
+      Ir_Value operand = condition->args.elems[0];
+      ir_instr(fn, v)->args.elems[0] = operand;
+      Ir_Block_Id swap = block->succs[0];
+      block->succs[0] = block->succs[1];
+      block->succs[1] = swap;
+      return true;
+    }
+
+    bool is_const = ir_is_const(condition) || condition->op == IR_FUNCTION || condition->op == IR_CLOSURE
+      || condition->op == IR_CONST_STRING || condition->op == IR_CONST_BIGINT;
+    if (is_const)
+    {
+      size_t taken = ir_is_truthy(condition) ? 0 : 1;
+      Ir_Block_Id target = block->succs[taken];
+      Ir_Block_Id dropped = block->succs[1 - taken];
+      block->succs[0] = target;
+      block->succs_len = 1;
+      Ir_Instr *jump = ir_instr(fn, v);
+      jump->op = IR_JUMP;
+      jump->args.len = 0;
+      ir_remove_pred(fn, dropped, id);
+      return true;
+    }
+  } break;
+
+  default: {} break;
+  }
+  return false;
+}
+
+/// constant and copy propagation, see `Ir_Options.fold`
+static void ir_fold(Ir_Function *fn)
+{
+  bool changed = true;
+  for (size_t round = 0; changed && round < IR_MAX_ROUNDS; ++round)
+  {
+    changed = ir_remove_unreachable(fn);
+    ir_infer_types(fn);
+    for (size_t i = 0; i < fn->order.len; ++i)
+    {
+      Ir_Block *block = ir_block(fn, fn->order.elems[i]);
+      for (size_t j = 0; j < block->phis.len; ++j)
+      {
+        Ir_Value phi = block->phis.elems[j];
+        changed = (!fn->instrs.elems[phi].removed && ir_fold_phi(fn, phi)) || changed;
+      }
+      for (size_t j = 0; j < block->instrs.len; ++j)
+      {
+        Ir_Value v = block->instrs.elems[j];
+        changed = (!fn->instrs.elems[v].removed && ir_fold_instr(fn, v)) || changed;
+      }
+    }
+  }
+  ir_remove_unreachable(fn);
+  ir_compact(fn);
+}
+
+///
+/// global value numbering
+///
+
+/// NOTE(HS): the table maps an instruction to the first instruction dominating it which
+/// computes the same value. It is scoped by the dominator tree, entries made in a block
+/// are removed once its subtree has been visited, latest first, which leaves the probe
+/// sequences of the remaining entries intact.
+typedef struct ir_gvn
+{
+  Ir_Function *fn;
+  Ir_Value *table;
+  size_t mask;
+  Ir_Id_VaArray undo;
+} Ir_Gvn;
+
+/// the operands of `instr` in the order they're compared, equality doesn't depend on the
+/// order of its operands, nor do `+` and `*` on numbers
+static void ir_gvn_operands(const Ir_Function *fn, const Ir_Instr *instr, Ir_Value *args)
+{
+  for (size_t i = 0; i < instr->args.len && i < 2; ++i)
+  {
+    args[i] = ir_resolve(fn, instr->args.elems[i]);
+  }
+  if (instr->args.len != 2)
+  {
+    return;
+  }
+
+  bool commutes = instr->op == IR_EQ || instr->op == IR_NOT_EQ;
+  if (instr->op == IR_ADD || instr->op == IR_MUL)
+  {
+    uint8_t types = fn->instrs.elems[args[0]].type | fn->instrs.elems[args[1]].type;
+    commutes = (types & ~IR_TYPE_NUMBER) == 0;
+  }
+  if (commutes && args[0] > args[1])
+  {
+    Ir_Value swap = args[0];
+    args[0] = args[1];
+    args[1] = swap;
+  }
+}
+
+static uint64_t ir_gvn_hash(const Ir_Function *fn, const Ir_Instr *instr)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  uint64_t parts[3] = { (uint64_t) instr->op, 0, 0 };
+  switch (instr->op)
+  {
+  case IR_CONST_INT:  { parts[1] = (uint64_t) instr->as.integer; } break;
+  case IR_CONST_BOOL: { parts[1] = instr->as.boolean; } break;
+  case IR_PARAM:      { parts[1] = instr->as.slot; } break;
+  case IR_FUNCTION:   { parts[1] = (uint64_t) (uintptr_t) instr->as.function; } break;
+
+  case IR_IS_FUNCTION:
+  {
+    parts[1] = ir_resolve(fn, instr->args.elems[0]);
+    parts[2] = (uint64_t) (uintptr_t) instr->as.function;
+  } break;
+
+  case IR_CONST_STRING:
+  case IR_CONST_BIGINT:
+  {
+    for (size_t i = 0; i < instr->as.literal.len; ++i)
+    {
+      hash = (hash ^ (uint8_t) instr->as.literal.chars[i]) * 1099511628211ULL;
+    }
+  } break;
+
+  default:
+  {
+    Ir_Value args[2];
+    ir_gvn_operands(fn, instr, args);
+    for (size_t i = 0; i < instr->args.len; ++i)
+    {
+      parts[i + 1] = args[i];
+    }
+  } break;
+  }
+
+  for (size_t i = 0; i < 3; ++i)
+  {
+    hash = (hash ^ parts[i]) * 1099511628211ULL;
+  }
+  return hash ^ (hash >> 32);
+}
+
+static bool ir_gvn_equal(const Ir_Function *fn, const Ir_Instr *a, const Ir_Instr *b)
+{
+  if (a->op != b->op || a->args.len != b->args.len)
+  {
+    return false;
+  }
+  switch (a->op)
+  {
+  case IR_CONST_INT:  { return a->as.integer == b->as.integer; } break;
+  case IR_CONST_BOOL: { return a->as.boolean == b->as.boolean; } break;
+  case IR_CONST_NIL:  { return true; } break;
+  case IR_PARAM:      { return a->as.slot == b->as.slot; } break;
+  case IR_FUNCTION:   { return a->as.function == b->as.function; } break;
+
+  case IR_IS_FUNCTION:
+  {
+    return a->as.function == b->as.function
+      && ir_resolve(fn, a->args.elems[0]) == ir_resolve(fn, b->args.elems[0]);
+  } break;
+
+  case IR_CONST_STRING:
+  case IR_CONST_BIGINT:
+  {
+    return a->as.literal.len == b->as.literal.len
+      && memcmp(a->as.literal.chars, b->as.literal.chars, a->as.literal.len) == 0;
+  } break;
+
+  default:
+  {
+    Ir_Value a_args[2];
+    Ir_Value b_args[2];
+    ir_gvn_operands(fn, a, a_args);
+    ir_gvn_operands(fn, b, b_args);
+    for (size_t i = 0; i < a->args.len; ++i)
+    {
+      if (a_args[i] != b_args[i])
+      {
+        return false;
+      }
+    }
+    return true;
+  } break;
+  }
+}
+
+/// the instruction `v` is the same as, entering it in the table when there isn't one
+static Ir_Value ir_gvn_lookup(Ir_Gvn *gvn, Ir_Value v)
+{
+  const Ir_Instr *instr = &gvn->fn->instrs.elems[v];
+  size_t i = ir_gvn_hash(gvn->fn, instr) & gvn->mask;
+  while (gvn->table[i] != IR_NONE)
+  {
+    if (ir_gvn_equal(gvn->fn, &gvn->fn->instrs.elems[gvn->table[i]], instr))
+    {
+      return gvn->table[i];
+    }
+    i = (i + 1) & gvn->mask;
+  }
+
+  gvn->table[i] = v;
+  uint32_t index = (uint32_t) i;
+  va_array_append(gvn->undo, index);
+  return v;
+}
+
+/// a global or upvalue whose value is known, within one block
+typedef struct ir_known_load
+{
+  Ir_Op op;
+  size_t slot;
+  Ir_Value value;
+} Ir_Known_Load;
+
+typedef struct ir_known_load_vaarray
+{
+  Ir_Known_Load *elems;
+  size_t capacity;
+  size_t len;
+} Ir_Known_Load_VaArray;
+
+static void ir_gvn_know(Ir_Known_Load_VaArray *known, Ir_Op op, size_t slot, Ir_Value value)
+{
+  for (size_t i = 0; i < known->len; ++i)
+  {
+    if (known->elems[i].op == op && known->elems[i].slot == slot)
+    {
+      known->elems[i].value = value;
+      return;
+    }
+  }
+  Ir_Known_Load load = { .op = op, .slot = slot, .value = value };
+  va_array_append(*known, load);
+}
+
+/// replaces loads of globals and upvalues whose value is already known in the block,
+/// from an earlier load or store
+static void ir_gvn_loads(Ir_Function *fn, Ir_Block_Id id, Ir_Known_Load_VaArray *known)
+{
+  known->len = 0;
+  Ir_Block *block = ir_block(fn, id);
+  for (size_t i = 0; i < block->instrs.len; ++i)
+  {
+    Ir_Value v = block->instrs.elems[i];
+    Ir_Instr *instr = ir_instr(fn, v);
+    if (instr->removed)
+    {
+      continue;
+    }
+
+    switch (instr->op)
+    {
+    case IR_LOAD_GLOBAL:
+    case IR_LOAD_UPVALUE:
+    {
+      bool found = false;
+      for (size_t j = 0; j < known->len && !found; ++j)
+      {
+        if (known->elems[j].op == instr->op && known->elems[j].slot == instr->as.slot)
+        {
+          ir_remove(fn, v, known->elems[j].value);
+          found = true;
+        }
+      }
+      if (!found)
+      {
+        ir_gvn_know(known, instr->op, instr->as.slot, v);
+      }
+    } break;
+
+    case IR_STORE_GLOBAL:
+    case IR_STORE_UPVALUE:
+    {
+      Ir_Op load = instr->op == IR_STORE_GLOBAL ? IR_LOAD_GLOBAL : IR_LOAD_UPVALUE;
+      ir_gvn_know(known, load, instr->as.slot, ir_resolve(fn, instr->args.elems[0]));
+    } break;
+
+    // NOTE(HS): a function may write to any global or upvalue, builtins don't
+    case IR_CALL:
+    case IR_CALL_GLOBAL:
+    {
+      known->len = 0;
+    } break;
+
+    default: {} break;
+    }
+  }
+}
+
+static void ir_gvn(Ir_Function *fn)
+{
+  ir_compute_order(fn);
+  ir_infer_types(fn);
+
+  size_t capacity = 64;
+  while (capacity < fn->instrs.len * 2)
+  {
+    capacity *= 2;
+  }
+  Ir_Gvn gvn = { .fn = fn, .table = tmalloc(capacity * sizeof(Ir_Value)), .mask = capacity - 1 };
+  assert(gvn.table);
+  for (size_t i = 0; i < capacity; ++i)
+  {
+    gvn.table[i] = IR_NONE;
+  }
+  va_array_init(uint32_t, gvn.undo);
+
+  // NOTE(HS): the dominator tree is walked depth first without recursion, `children`
+  // lists each block's children contiguously in `order`
+  size_t blocks_len = fn->order.len;
+  size_t *child_first = tcalloc(blocks_len + 1, sizeof(size_t));
+  Ir_Block_Id *children = tmalloc((blocks_len + 1) * sizeof(Ir_Block_Id));
+  assert(child_first && children);
+  for (size_t i = 1; i < blocks_len; ++i)
+  {
+    child_first[ir_block(fn, ir_block(fn, fn->order.elems[i])->idom)->order + 1] += 1;
+  }
+  for (size_t i = 0; i < blocks_len; ++i)
+  {
+    child_first[i + 1] += child_first[i];
+  }
+  size_t *fill = tcalloc(blocks_len, sizeof(size_t));
+  assert(fill);
+  for (size_t i = 1; i < blocks_len; ++i)
+  {
+    size_t parent = ir_block(fn, ir_block(fn, fn->order.elems[i])->idom)->order;
+    children[child_first[parent] + fill[parent]++] = fn->order.elems[i];
+  }
+  tfree(fill);
+
+  typedef struct { Ir_Block_Id block; size_t next_child; size_t undo_len; } Frame;
+  Frame *stack = tmalloc((blocks_len + 1) * sizeof(Frame));
+  assert(stack);
+  size_t depth = 0;
+  Ir_Known_Load_VaArray known = { NULL, 0, 0 };
+
+  stack[depth++] = (Frame) { .block = fn->order.elems[0], .next_child = SIZE_MAX, .undo_len = 0 };
+  while (depth > 0)
+  {
+    Frame *frame = &stack[depth - 1];
+    Ir_Block *block = ir_block(fn, frame->block);
+    if (frame->next_child == SIZE_MAX)
+    {
+      frame->undo_len = gvn.undo.len;
+      frame->next_child = child_first[block->order];
+      ir_gvn_loads(fn, frame->block, &known);
+      block = ir_block(fn, frame->block);
+      for (size_t i = 0; i < block->instrs.len; ++i)
+      {
+        Ir_Value v = block->instrs.elems[i];
+        const Ir_Instr *instr = ir_instr(fn, v);
+        if (instr->removed || !(ir_op_flags(instr->op) & IR_PURE))
+        {
+          continue;
+        }
+        Ir_Value same = ir_gvn_lookup(&gvn, v);
+        if (same != v)
+        {
+          ir_remove(fn, v, same);
+        }
+      }
+    }
+
+    if (frame->next_child < child_first[block->order + 1])
+    {
+      Ir_Block_Id child = children[frame->next_child++];
+      stack[depth++] = (Frame) { .block = child, .next_child = SIZE_MAX, .undo_len = 0 };
+      continue;
+    }
+
+    while (gvn.undo.len > frame->undo_len)
+    {
+      gvn.table[gvn.undo.elems[--gvn.undo.len]] = IR_NONE;
+    }
+    depth -= 1;
+  }
+
+  tfree(stack);
+  tfree(children);
+  tfree(child_first);
+  va_array_free(known);
+  va_array_free(gvn.undo);
+  tfree(gvn.table);
+  ir_compact(fn);
+}
+
+///
+/// loop invariant code motion
+///
+
+typedef struct ir_loop
+{
+  Ir_Block_Id header;
+
+  /// indexed by block, whether it's part of the loop
+  bool *body;
+  size_t size;
+} Ir_Loop;
+
+typedef struct ir_loop_vaarray
+{
+  Ir_Loop *elems;
+  size_t capacity;
+  size_t len;
+} Ir_Loop_VaArray;
+
+static bool ir_dominates(const Ir_Function *fn, Ir_Block_Id a, Ir_Block_Id b)
+{
+  while (b != a && fn->blocks.elems[b].idom != b)
+  {
+    b = fn->blocks.elems[b].idom;
+  }
+  return a == b;
+}
+
+/// the natural loops of `fn`, one per header, smallest (so innermost) first
+static Ir_Loop_VaArray ir_find_loops(Ir_Function *fn)
+{
+  Ir_Loop_VaArray loops = { NULL, 0, 0 };
+  Ir_Id_VaArray work = { NULL, 0, 0 };
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id header = fn->order.elems[i];
+    const Ir_Block *block = ir_block(fn, header);
+    Ir_Loop loop = { .header = header, .body = NULL, .size = 0 };
+    for (size_t j = 0; j < block->preds.len; ++j)
+    {
+      Ir_Block_Id latch = block->preds.elems[j];
+      if (!ir_dominates(fn, header, latch))
+      {
+        continue;
+      }
+      if (!loop.body)
+      {
+        loop.body = tcalloc(fn->blocks.len, sizeof(bool));
+        assert(loop.body);
+        loop.body[header] = true;
+        loop.size = 1;
+      }
+
+      // NOTE(HS): the blocks which reach the latch without passing through the header
+      va_array_append(work, latch);
+      while (work.len > 0)
+      {
+        Ir_Block_Id id = work.elems[--work.len];
+        if (loop.body[id])
+        {
+          continue;
+        }
+        loop.body[id] = true;
+        loop.size += 1;
+        const Ir_Block *member = ir_block(fn, id);
+        for (size_t k = 0; k < member->preds.len; ++k)
+        {
+          va_array_append(work, member->preds.elems[k]);
+        }
+      }
+    }
+    if (loop.body)
+    {
+      va_array_append(loops, loop);
+    }
+  }
+  va_array_free(work);
+
+  for (size_t i = 1; i < loops.len; ++i)
+  {
+    Ir_Loop loop = loops.elems[i];
+    size_t j = i;
+    while (j > 0 && loops.elems[j - 1].size > loop.size)
+    {
+      loops.elems[j] = loops.elems[j - 1];
+      j -= 1;
+    }
+    loops.elems[j] = loop;
+  }
+  return loops;
+}
+
+/// whether the loop may write the memory `load` reads
+static bool ir_loop_clobbers(Ir_Function *fn, const Ir_Loop *loop, const Ir_Instr *load)
+{
+  Ir_Op store = load->op == IR_LOAD_GLOBAL ? IR_STORE_GLOBAL : IR_STORE_UPVALUE;
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    if (!loop->body[id])
+    {
+      continue;
+    }
+    const Ir_Block *block = ir_block(fn, id);
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      const Ir_Instr *instr = ir_instr(fn, block->instrs.elems[j]);
+      if (instr->op == IR_CALL || instr->op == IR_CALL_GLOBAL
+          || (instr->op == store && instr->as.slot == load->as.slot))
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void ir_hoist_loop(Ir_Function *fn, const Ir_Loop *loop)
+{
+  // NOTE(HS): instructions are moved to the end of the loop's one way in, the only
+  // block outside it which jumps to the header
+  const Ir_Block *header = ir_block(fn, loop->header);
+  Ir_Block_Id preheader = IR_NONE;
+  for (size_t i = 0; i < header->preds.len; ++i)
+  {
+    Ir_Block_Id pred = header->preds.elems[i];
+    if (loop->body[pred])
+    {
+      continue;
+    }
+    if (preheader != IR_NONE)
+    {
+      return;
+    }
+    preheader = pred;
+  }
+  if (preheader == IR_NONE || ir_block(fn, preheader)->succs_len != 1)
+  {
+    return;
+  }
+
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    if (!loop->body[id])
+    {
+      continue;
+    }
+
+    // NOTE(HS): an instruction which may fail only moves when it's in the header with
+    // nothing before it which could fail or have an effect, so the loop reports the
+    // same error at the same point (the header runs as soon as the loop is entered)
+    bool may_fail_here = id == loop->header;
+    size_t kept = 0;
+    Ir_Block *block = ir_block(fn, id);
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      Ir_Value v = block->instrs.elems[j];
+      Ir_Instr *instr = ir_instr(fn, v);
+      size_t flags = ir_op_flags(instr->op);
+      bool invariant = (flags & (IR_PURE | IR_LOAD)) && instr->op != IR_PARAM;
+      for (size_t k = 0; invariant && k < instr->args.len; ++k)
+      {
+        invariant = !loop->body[ir_arg(fn, instr, k)->block];
+      }
+
+      bool fails = ir_instr_may_fail(fn, instr);
+      if (invariant && fails)
+      {
+        invariant = may_fail_here;
+      }
+      if (invariant && (flags & IR_LOAD))
+      {
+        invariant = !ir_loop_clobbers(fn, loop, instr);
+      }
+
+      if (!invariant)
+      {
+        if (fails || (flags & IR_EFFECT))
+        {
+          may_fail_here = false;
+        }
+        block->instrs.elems[kept++] = v;
+        continue;
+      }
+
+      Ir_Block *into = ir_block(fn, preheader);
+      Ir_Value terminator = into->instrs.elems[into->instrs.len - 1];
+      into->instrs.elems[into->instrs.len - 1] = v;
+      va_array_append(into->instrs, terminator);
+      instr->block = preheader;
+      block = ir_block(fn, id);
+    }
+    block->instrs.len = kept;
+  }
+}
+
+static void ir_licm(Ir_Function *fn)
+{
+  ir_compute_order(fn);
+  ir_infer_types(fn);
+  Ir_Loop_VaArray loops = ir_find_loops(fn);
+  for (size_t i = 0; i < loops.len; ++i)
+  {
+    ir_hoist_loop(fn, &loops.elems[i]);
+    tfree(loops.elems[i].body);
+  }
+  va_array_free(loops);
+}
+
+///
+/// dead code elimination
+///
+
+static void ir_dce(Ir_Function *fn)
+{
+  ir_compute_order(fn);
+  ir_infer_types(fn);
+  bool *live = tcalloc(fn->instrs.len, sizeof(bool));
+  assert(live);
+  Ir_Id_VaArray work = { NULL, 0, 0 };
+
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    const Ir_Block *block = ir_block(fn, fn->order.elems[i]);
+    for (size_t j = 0; j < block->instrs.len; ++j)
+    {
+      Ir_Value v = block->instrs.elems[j];
+      const Ir_Instr *instr = ir_instr(fn, v);
+      if ((ir_op_flags(instr->op) & (IR_EFFECT | IR_TERMINATOR)) || ir_instr_may_fail(fn, instr))
+      {
+        live[v] = true;
+        va_array_append(work, v);
+      }
+    }
+  }
+
+  while (work.len > 0)
+  {
+    const Ir_Instr *instr = ir_instr(fn, work.elems[--work.len]);
+    for (size_t i = 0; i < instr->args.len; ++i)
+    {
+      Ir_Value arg = ir_resolve(fn, instr->args.elems[i]);
+      if (!live[arg])
+      {
+        live[arg] = true;
+        va_array_append(work, arg);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < fn->order.len; ++i)
+  {
+    const Ir_Block *block = ir_block(fn, fn->order.elems[i]);
+    const Ir_Id_VaArray *lists[] = { &block->phis, &block->instrs };
+    for (size_t l = 0; l < 2; ++l)
+    {
+      for (size_t j = 0; j < lists[l]->len; ++j)
+      {
+        if (!live[lists[l]->elems[j]])
+        {
+          ir_remove(fn, lists[l]->elems[j], IR_NONE);
+        }
+      }
+    }
+  }
+
+  va_array_free(work);
+  tfree(live);
+  ir_compact(fn);
+}
+
+static uint8_t ir_transfer(const Ir_Function *fn, const Ir_Instr *instr)
+{
+  switch (instr->op)
+  {
+  case IR_CONST_INT:    { return IR_TYPE_INT; } break;
+  case IR_CONST_BIGINT: { return IR_TYPE_BIGINT; } break;
+  case IR_CONST_STRING: { return IR_TYPE_STRING; } break;
+  case IR_CONST_BOOL:   { return IR_TYPE_BOOL; } break;
+  case IR_CONST_NIL:    { return IR_TYPE_NIL; } break;
+
+  case IR_FUNCTION:
+  case IR_CLOSURE:
+  {
+    return IR_TYPE_FUNCTION;
+  } break;
+
+  case IR_PHI:
+  {
+    uint8_t type = 0;
+    for (size_t i = 0; i < instr->args.len; ++i)
+    {
+      type |= ir_arg(fn, instr, i)->type;
+    }
+    return type;
+  } break;
+
+  case IR_NEGATE: case IR_SUB: case IR_MUL: case IR_DIV:
+  {
+    return IR_TYPE_NUMBER;
+  } break;
+
+  // NOTE(HS): strings only concatenate with strings, anything else is a number or fails
+  case IR_ADD:
+  {
+    uint8_t both = ir_arg(fn, instr, 0)->type & ir_arg(fn, instr, 1)->type;
+    return IR_TYPE_NUMBER | (both & IR_TYPE_STRING);
+  } break;
+
+  case IR_NOT: case IR_EQ: case IR_NOT_EQ: case IR_LT: case IR_GT: case IR_LTE: case IR_GTE:
+  case IR_IS_FUNCTION:
+  {
+    return IR_TYPE_BOOL;
+  } break;
+
+  default:
+  {
+    return IR_TYPE_ANY;
+  } break;
+  }
+}
+
+
+///
+/// public functions
+///
+
+void ir_compute_order(Ir_Function *fn)
+{
+  size_t len = fn->blocks.len;
+  for (size_t i = 0; i < len; ++i)
+  {
+    fn->blocks.elems[i].order = SIZE_MAX;
+    fn->blocks.elems[i].idom = IR_NONE;
+  }
+  if (fn->order.elems == NULL)
+  {
+    va_array_init(uint32_t, fn->order);
+  }
+  fn->order.len = 0;
+
+  // NOTE(HS): a depth first search without recursion, the successors of a block are
+  // visited last to first so that in reverse post order the true side of a branch (the
+  // body of a loop) comes first
+  typedef struct { Ir_Block_Id block; size_t next; } Frame;
+  Frame *stack = tmalloc((len + 1) * sizeof(Frame));
+  bool *visited = tcalloc(len, sizeof(bool));
+  Ir_Block_Id *post = tmalloc((len + 1) * sizeof(Ir_Block_Id));
+  assert(stack && visited && post);
+  size_t post_len = 0;
+  size_t depth = 0;
+
+  stack[depth++] = (Frame) { .block = 0, .next = 0 };
+  visited[0] = true;
+  while (depth > 0)
+  {
+    Frame *frame = &stack[depth - 1];
+    const Ir_Block *block = &fn->blocks.elems[frame->block];
+    if (frame->next < block->succs_len)
+    {
+      Ir_Block_Id succ = block->succs[block->succs_len - 1 - frame->next++];
+      if (!visited[succ])
+      {
+        visited[succ] = true;
+        stack[depth++] = (Frame) { .block = succ, .next = 0 };
+      }
+      continue;
+    }
+    post[post_len++] = frame->block;
+    depth -= 1;
+  }
+
+  for (size_t i = 0; i < post_len; ++i)
+  {
+    Ir_Block_Id id = post[post_len - 1 - i];
+    va_array_append(fn->order, id);
+    fn->blocks.elems[id].order = i;
+  }
+
+  // NOTE(HS): Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+  Ir_Block_Id entry = fn->order.elems[0];
+  fn->blocks.elems[entry].idom = entry;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i = 1; i < fn->order.len; ++i)
+    {
+      Ir_Block *block = &fn->blocks.elems[fn->order.elems[i]];
+      Ir_Block_Id idom = IR_NONE;
+      for (size_t j = 0; j < block->preds.len; ++j)
+      {
+        Ir_Block_Id pred = block->preds.elems[j];
+        if (fn->blocks.elems[pred].idom == IR_NONE)
+        {
+          continue;
+        }
+        if (idom == IR_NONE)
+        {
+          idom = pred;
+          continue;
+        }
+
+        Ir_Block_Id a = pred;
+        Ir_Block_Id b = idom;
+        while (a != b)
+        {
+          while (fn->blocks.elems[a].order > fn->blocks.elems[b].order)
+          {
+            a = fn->blocks.elems[a].idom;
+          }
+          while (fn->blocks.elems[b].order > fn->blocks.elems[a].order)
+          {
+            b = fn->blocks.elems[b].idom;
+          }
+        }
+        idom = a;
+      }
+      if (block->idom != idom)
+      {
+        block->idom = idom;
+        changed = true;
+      }
+    }
+  }
+
+  tfree(post);
+  tfree(visited);
+  tfree(stack);
+}
+
+void ir_infer_types(Ir_Function *fn)
+{
+  // NOTE(HS): every value starts with no types (which a phi in a loop needs to not
+  // widen itself), and grows until nothing changes
+  for (size_t i = 0; i < fn->instrs.len; ++i)
+  {
+    fn->instrs.elems[i].type = 0;
+  }
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i = 0; i < fn->order.len; ++i)
+    {
+      const Ir_Block *block = &fn->blocks.elems[fn->order.elems[i]];
+      const Ir_Id_VaArray *lists[] = { &block->phis, &block->instrs };
+      for (size_t l = 0; l < 2; ++l)
+      {
+        for (size_t j = 0; j < lists[l]->len; ++j)
+        {
+          Ir_Instr *instr = &fn->instrs.elems[lists[l]->elems[j]];
+          if (instr->removed)
+          {
+            continue;
+          }
+          uint8_t type = instr->type | ir_transfer(fn, instr);
+          if (type != instr->type)
+          {
+            instr->type = type;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+}
+
+bool ir_instr_may_fail(const Ir_Function *fn, const Ir_Instr *instr)
+{
+  switch (instr->op)
+  {
+  case IR_CONST_INT: case IR_CONST_BIGINT: case IR_CONST_STRING: case IR_CONST_BOOL:
+  case IR_CONST_NIL: case IR_FUNCTION: case IR_CLOSURE: case IR_PARAM: case IR_PHI:
+  case IR_LOAD_GLOBAL: case IR_LOAD_UPVALUE: case IR_STORE_GLOBAL: case IR_STORE_UPVALUE:
+  case IR_NOT: case IR_EQ: case IR_NOT_EQ: case IR_IS_FUNCTION: case IR_JUMP: case IR_BRANCH:
+  case IR_RETURN:
+  {
+    return false;
+  } break;
+
+  case IR_NEGATE:
+  {
+    uint8_t type = ir_arg(fn, instr, 0)->type;
+    return type == 0 || (type & ~IR_TYPE_NUMBER) != 0;
+  } break;
+
+  case IR_ADD:
+  {
+    uint8_t types = ir_arg(fn, instr, 0)->type | ir_arg(fn, instr, 1)->type;
+    return types == 0 || ((types & ~IR_TYPE_NUMBER) != 0 && types != IR_TYPE_STRING);
+  } break;
+
+  case IR_SUB: case IR_MUL: case IR_LT: case IR_GT: case IR_LTE: case IR_GTE:
+  {
+    uint8_t types = ir_arg(fn, instr, 0)->type | ir_arg(fn, instr, 1)->type;
+    return types == 0 || (types & ~IR_TYPE_NUMBER) != 0;
+  } break;
+
+  case IR_DIV:
+  {
+    uint8_t types = ir_arg(fn, instr, 0)->type | ir_arg(fn, instr, 1)->type;
+    const Ir_Instr *divisor = ir_arg(fn, instr, 1);
+    return types == 0 || (types & ~IR_TYPE_NUMBER) != 0
+      || divisor->op != IR_CONST_INT || divisor->as.integer == 0;
+  } break;
+
+  default:
+  {
+    return true;
+  } break;
+  }
+}
+
+void ir_split_critical_edges(Ir_Function *fn)
+{
+  ir_compute_order(fn);
+  size_t len = fn->order.len;
+  for (size_t i = 0; i < len; ++i)
+  {
+    Ir_Block_Id id = fn->order.elems[i];
+    if (ir_block(fn, id)->succs_len < 2)
+    {
+      continue;
+    }
+
+    for (size_t j = 0; j < 2; ++j)
+    {
+      Ir_Block_Id succ = ir_block(fn, id)->succs[j];
+      if (ir_block(fn, succ)->preds.len < 2)
+      {
+        continue;
+      }
+
+      Ir_Block split;
+      memset(&split, 0, sizeof(split));
+      split.idom = IR_NONE;
+      split.sealed = true;
+      split.succs[0] = succ;
+      split.succs_len = 1;
+      Ir_Block_Id split_id = (Ir_Block_Id) fn->blocks.len;
+      va_array_append(fn->blocks, split);
+      va_array_append(fn->blocks.elems[split_id].preds, id);
+
+      Ir_Instr jump;
+      memset(&jump, 0, sizeof(jump));
+      jump.op = IR_JUMP;
+      jump.block = split_id;
+      jump.pos = ir_instr(fn, ir_terminator(fn, id))->pos;
+      jump.replacement = IR_NONE;
+      jump.type = IR_TYPE_ANY;
+      Ir_Value jump_v = (Ir_Value) fn->instrs.len;
+      va_array_append(fn->instrs, jump);
+      va_array_append(fn->blocks.elems[split_id].instrs, jump_v);
+
+      ir_block(fn, id)->succs[j] = split_id;
+      Ir_Block *into = ir_block(fn, succ);
+      for (size_t k = 0; k < into->preds.len; ++k)
+      {
+        if (into->preds.elems[k] == id)
+        {
+          into->preds.elems[k] = split_id;
+        }
+      }
+    }
+  }
+  ir_compute_order(fn);
+}
+
+void ir_optimise(Ir_Function *fn, Ir_Options options)
+{
+  if (options.inline_calls)
+  {
+    ir_inline(fn, options);
+  }
+  if (options.fold)
+  {
+    ir_fold(fn);
+  }
+  if (options.gvn)
+  {
+    ir_gvn(fn);
+  }
+  // NOTE(HS): values moved out of a loop are numbered again, they may now be the same
+  // as others before it
+  if (options.licm)
+  {
+    ir_licm(fn);
+    if (options.gvn)
+    {
+      ir_gvn(fn);
+    }
+  }
+  if (options.fold && (options.gvn || options.licm))
+  {
+    ir_fold(fn);
+  }
+  if (options.dce)
+  {
+    ir_dce(fn);
+  }
+  ir_compute_order(fn);
+  ir_infer_types(fn);
+}
@@ -0,0 +1,1570 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+
+#if JIT_SUPPORTED
+#include <sys/mman.h>
+#include "bigint.h"
+#include "superinstruction.h"
+#include "util.h"
+
+///
+/// internal functions
+///
+
+typedef enum jit_reg
+{
+  JIT_RAX, JIT_RCX, JIT_RDX, JIT_RBX, JIT_RSP, JIT_RBP, JIT_RSI, JIT_RDI,
+  JIT_R8, JIT_R9, JIT_R10, JIT_R11, JIT_R12, JIT_R13, JIT_R14, JIT_R15,
+} Jit_Reg;
+
+/// NOTE(HS): the frame, its slots and the globals stay in callee saved registers for
+/// as long as the code runs, rax, rcx and rdx are scratch and values are kept in the
+/// rest
+#define JIT_FRAME   JIT_RBX
+#define JIT_SLOTS   JIT_R12
+#define JIT_GLOBALS JIT_R13
+
+static const Jit_Reg JIT_POOL[] = {
+  JIT_RSI, JIT_RDI, JIT_R8, JIT_R9, JIT_R10, JIT_R11, JIT_R14, JIT_R15,
+};
+#define JIT_POOL_SIZE (sizeof(JIT_POOL) / sizeof(JIT_POOL[0]))
+
+/// x86 condition codes, inverted by flipping the low bit
+typedef enum jit_cc
+{
+  JIT_CC_O  = 0x0,
+  JIT_CC_E  = 0x4,
+  JIT_CC_NE = 0x5,
+  JIT_CC_L  = 0xC,
+  JIT_CC_GE = 0xD,
+  JIT_CC_LE = 0xE,
+  JIT_CC_G  = 0xF,
+} Jit_Cc;
+
+#define jit_cc_invert(CC) ((Jit_Cc) ((CC) ^ 1))
+
+/// the code reads values straight out of the stack and globals, so relies on their
+/// layout: a 4 byte kind then the payload 8 bytes in
+typedef char jit_value_layout_check[
+  (sizeof(Value) == 16 && sizeof(Value_Kind) == 4 && offsetof(Value, as) == 8) ? 1 : -1
+];
+
+#define JIT_PAYLOAD ((int32_t) offsetof(Value, as))
+#define jit_disp(INDEX) ((int32_t) ((INDEX) * sizeof(Value)))
+
+/// where a value on the stack is whilst the code runs
+typedef enum jit_slot_kind
+{
+  /// in its own stack slot, as the interpreter would have it
+  JIT_SLOT_MEMORY,
+  JIT_SLOT_CONST,
+
+  /// still in the local or global (`index` of `reg`) it was loaded from
+  JIT_SLOT_COPY,
+
+  /// an int or bool (0 or 1) in `reg`
+  JIT_SLOT_INT,
+  JIT_SLOT_BOOL,
+} Jit_Slot_Kind;
+
+typedef struct jit_slot
+{
+  Jit_Slot_Kind kind;
+  Jit_Reg reg;
+  size_t index;
+  Value constant;
+} Jit_Slot;
+
+/// the code writing back the stack as it was when a guard of the instruction at
+/// `offset` failed, then leaving
+typedef struct jit_stub
+{
+  size_t offset;
+  size_t depth;
+  Jit_Slot *stack;
+} Jit_Stub;
+
+typedef struct jit_stub_vaarray
+{
+  Jit_Stub *elems;
+  size_t capacity;
+  size_t len;
+} Jit_Stub_VaArray;
+
+/// a jump whose 32 bit displacement at `at` is filled once `target` (an instruction
+/// offset or stub index) has been placed
+typedef struct jit_patch
+{
+  size_t at;
+  size_t target;
+} Jit_Patch;
+
+typedef struct jit_patch_vaarray
+{
+  Jit_Patch *elems;
+  size_t capacity;
+  size_t len;
+} Jit_Patch_VaArray;
+
+typedef struct jit_offset_vaarray
+{
+  size_t *elems;
+  size_t capacity;
+  size_t len;
+} Jit_Offset_VaArray;
+
+typedef struct jit_compiler
+{
+  const Chunk *chunk;
+  Byte_VaArray code;
+
+  /// stack depth before each instruction, `SIZE_MAX` for those never reached, and
+  /// whether it starts a block
+  size_t *depths;
+  bool *labels;
+
+  Jit_Slot *stack;
+  size_t depth;
+
+  /// stack slots and globals known to hold ints, until the end of the block
+  bool *stack_int;
+  bool *global_int;
+
+  uint32_t regs_used;
+
+  /// the instruction being compiled, and its stub once a guard needs one
+  size_t offset;
+  size_t stub;
+
+  /// false after an unconditional jump or exit, until the next block
+  bool live;
+
+  size_t epilogue;
+  Jit_Entry *entries;
+  Jit_Stub_VaArray stubs;
+  Jit_Patch_VaArray label_patches;
+  Jit_Patch_VaArray stub_patches;
+} Jit_Compiler;
+
+/// the instruction at `offset` as the JIT sees it, the first component of a
+/// superinstruction (the rest follow as their own instructions), `*raw` is set to the
+/// instruction as written
+static Opcode jit_decode(const Chunk *chunk, size_t offset, Opcode *raw)
+{
+  Opcode op = (Opcode) chunk->code.elems[offset];
+  if (opcode_is_superinstruction(op))
+  {
+    op = superinstruction_lookup(op)->components[0];
+  }
+  *raw = op;
+  return opcode_generic_form(op);
+}
+
+static uint16_t jit_operand(const Chunk *chunk, size_t offset, size_t n)
+{
+  return chunk_read_operand(chunk->code.elems + offset + 1 + n * CHUNK_OPERAND_SIZE);
+}
+
+/// whether the interpreter runs `raw` (whose generic form is `op`) in place of the
+/// compiled code
+static bool jit_is_exit(Opcode op, Opcode raw)
+{
+  switch (op)
+  {
+    case OPC_LOAD_CONST: case OPC_LOAD_NIL: case OPC_LOAD_TRUE: case OPC_LOAD_FALSE:
+    case OPC_POP: case OPC_POPN:
+    case OPC_LOAD_GLOBAL: case OPC_STORE_GLOBAL: case OPC_LOAD_LOCAL: case OPC_STORE_LOCAL:
+    case OPC_NEGATE: case OPC_NOT: case OPC_SUB: case OPC_MUL: case OPC_DIV:
+    case OPC_EQ: case OPC_NOT_EQ: case OPC_LT: case OPC_GT: case OPC_LTE: case OPC_GTE:
+    case OPC_JUMP: case OPC_JUMP_IF_FALSE: case OPC_LOOP:
+    {
+      return false;
+    } break;
+
+    // NOTE(HS): an `ADD` which has been seen to concatenate strings allocates
+    case OPC_ADD:
+    {
+      return raw == OPC_CONCAT_STR_STR;
+    } break;
+
+    default:
+    {
+      return true;
+    } break;
+  }
+}
+
+/// whether execution carries on to the next instruction after `op`
+static bool jit_falls_through(Opcode op)
+{
+  return !(op == OPC_JUMP || op == OPC_LOOP || op == OPC_RETURN
+           || op == OPC_TAIL_CALL || op == OPC_TAIL_CALL_GLOBAL);
+}
+
+/// the stack depth after the instruction at `offset` runs from `depth`, false when it
+/// would pop more than there is
+static bool jit_stack_effect(const Chunk *chunk, size_t offset, Opcode op, size_t *depth)
+{
+  long effect;
+  switch (op)
+  {
+    case OPC_POPN: case OPC_CLOSE_UPVALUES:
+    {
+      effect = -(long) jit_operand(chunk, offset, 0);
+    } break;
+
+    case OPC_RESERVE:
+    {
+      effect = (long) jit_operand(chunk, offset, 0);
+    } break;
+
+    case OPC_CALL:
+    {
+      effect = -(long) jit_operand(chunk, offset, 0);
+    } break;
+
+    case OPC_CALL_NATIVE: case OPC_CALL_GLOBAL:
+    {
+      effect = 1 - (long) jit_operand(chunk, offset, 1);
+    } break;
+
+    default:
+    {
+      effect = opcode_stack_effect(op);
+    } break;
+  }
+
+  if (effect < 0 && (size_t) -effect > *depth)
+  {
+    return false;
+  }
+  *depth = (size_t) ((long) *depth + effect);
+  return true;
+}
+
+/// the target of the jump at `offset`
+static size_t jit_jump_target(const Chunk *chunk, size_t offset, Opcode op)
+{
+  size_t next = offset + opcode_length(op);
+  uint16_t distance = jit_operand(chunk, offset, 0);
+  return op == OPC_LOOP ? next - distance : next + distance;
+}
+
+/// finds the stack depth before every reachable instruction and the instructions
+/// starting blocks: jump targets and those after exits, where the interpreter
+/// re-enters the code. Returns false for code whose depth doesn't agree between
+/// paths, or whose globals aren't known.
+static bool jit_analyse(Jit_Compiler *j)
+{
+  const Chunk *chunk = j->chunk;
+  size_t len = chunk->code.len;
+  for (size_t i = 0; i < len; ++i)
+  {
+    j->depths[i] = SIZE_MAX;
+  }
+
+  Jit_Offset_VaArray work;
+  va_array_init(size_t, work);
+  size_t start = 0;
+  j->depths[0] = chunk->arity;
+  j->labels[0] = true;
+  va_array_append(work, start);
+
+  bool ok = true;
+  while (ok && work.len > 0)
+  {
+    size_t offset = work.elems[--work.len];
+    Opcode raw;
+    Opcode op = jit_decode(chunk, offset, &raw);
+    size_t depth = j->depths[offset];
+
+    size_t next = offset + opcode_length(raw);
+    size_t successors[2];
+    size_t successor_count = 0;
+    ok = jit_stack_effect(chunk, offset, op, &depth) && depth <= chunk->max_stack;
+
+    if (op == OPC_LOAD_GLOBAL || op == OPC_STORE_GLOBAL)
+    {
+      ok = ok && jit_operand(chunk, offset, 0) < chunk->global_count;
+    }
+    if (op == OPC_JUMP || op == OPC_JUMP_IF_FALSE || op == OPC_LOOP)
+    {
+      size_t target = jit_jump_target(chunk, offset, op);
+      if (target < len)
+      {
+        j->labels[target] = true;
+      }
+      successors[successor_count++] = target;
+    }
+    if (jit_falls_through(op))
+    {
+      successors[successor_count++] = next;
+      if (jit_is_exit(op, raw) && next < len)
+      {
+        j->labels[next] = true;
+      }
+    }
+
+    for (size_t i = 0; ok && i < successor_count; ++i)
+    {
+      size_t successor = successors[i];
+      if (successor >= len)
+      {
+        ok = false;
+      }
+      else if (j->depths[successor] == SIZE_MAX)
+      {
+        j->depths[successor] = depth;
+        va_array_append(work, successor);
+      }
+      else
+      {
+        ok = j->depths[successor] == depth;
+      }
+    }
+  }
+
+  va_array_free(work);
+  return ok;
+}
+
+///
+/// instruction encoding
+///
+
+static void jit_emit8(Jit_Compiler *j, uint8_t byte)
+{
+  va_array_append(j->code, byte);
+}
+
+static void jit_emit32(Jit_Compiler *j, uint32_t value)
+{
+  for (size_t i = 0; i < 4; ++i)
+  {
+    jit_emit8(j, (uint8_t) (value >> (8 * i)));
+  }
+}
+
+static void jit_emit64(Jit_Compiler *j, uint64_t value)
+{
+  jit_emit32(j, (uint32_t) value);
+  jit_emit32(j, (uint32_t) (value >> 32));
+}
+
+/// REX prefix, left out when it would be empty unless `force`d (byte registers above
+/// bl need one)
+static void jit_rex(Jit_Compiler *j, bool wide, Jit_Reg reg, Jit_Reg rm, bool force)
+{
+  uint8_t rex = (uint8_t) (0x40 | (wide ? 0x08 : 0) | ((reg >> 3) << 2) | (rm >> 3));
+  if (rex != 0x40 || force)
+  {
+    jit_emit8(j, rex);
+  }
+}
+
+static void jit_modrm_reg(Jit_Compiler *j, int reg, Jit_Reg rm)
+{
+  jit_emit8(j, (uint8_t) (0xC0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+/// `[base + disp]`, always with a 32 bit displacement
+static void jit_modrm_mem(Jit_Compiler *j, int reg, Jit_Reg base, int32_t disp)
+{
+  jit_emit8(j, (uint8_t) (0x80 | ((reg & 7) << 3) | (base & 7)));
+  if ((base & 7) == JIT_RSP)
+  {
+    jit_emit8(j, 0x24);
+  }
+  jit_emit32(j, (uint32_t) disp);
+}
+
+static void jit_mov_rr(Jit_Compiler *j, Jit_Reg dst, Jit_Reg src)
+{
+  if (dst != src)
+  {
+    jit_rex(j, true, src, dst, false);
+    jit_emit8(j, 0x89);
+    jit_modrm_reg(j, src, dst);
+  }
+}
+
+static void jit_mov_ri(Jit_Compiler *j, Jit_Reg dst, int64_t imm)
+{
+  if (imm == (int32_t) imm)
+  {
+    jit_rex(j, true, JIT_RAX, dst, false);
+    jit_emit8(j, 0xC7);
+    jit_modrm_reg(j, 0, dst);
+    jit_emit32(j, (uint32_t) imm);
+  }
+  else
+  {
+    jit_rex(j, true, JIT_RAX, dst, false);
+    jit_emit8(j, (uint8_t) (0xB8 + (dst & 7)));
+    jit_emit64(j, (uint64_t) imm);
+  }
+}
+
+static void jit_load(Jit_Compiler *j, Jit_Reg dst, Jit_Reg base, int32_t disp)
+{
+  jit_rex(j, true, dst, base, false);
+  jit_emit8(j, 0x8B);
+  jit_modrm_mem(j, dst, base, disp);
+}
+
+static void jit_store(Jit_Compiler *j, Jit_Reg base, int32_t disp, Jit_Reg src)
+{
+  jit_rex(j, true, src, base, false);
+  jit_emit8(j, 0x89);
+  jit_modrm_mem(j, src, base, disp);
+}
+
+static void jit_store_imm(Jit_Compiler *j, Jit_Reg base, int32_t disp, uint64_t imm)
+{
+  if ((int64_t) imm == (int32_t) imm)
+  {
+    jit_rex(j, true, JIT_RAX, base, false);
+    jit_emit8(j, 0xC7);
+    jit_modrm_mem(j, 0, base, disp);
+    jit_emit32(j, (uint32_t) imm);
+  }
+  else
+  {
+    jit_mov_ri(j, JIT_RDX, (int64_t) imm);
+    jit_store(j, base, disp, JIT_RDX);
+  }
+}
+
+static void jit_store_imm32(Jit_Compiler *j, Jit_Reg base, int32_t disp, uint32_t imm)
+{
+  jit_rex(j, false, JIT_RAX, base, false);
+  jit_emit8(j, 0xC7);
+  jit_modrm_mem(j, 0, base, disp);
+  jit_emit32(j, imm);
+}
+
+static void jit_store_imm8(Jit_Compiler *j, Jit_Reg base, int32_t disp, uint8_t imm)
+{
+  jit_rex(j, false, JIT_RAX, base, false);
+  jit_emit8(j, 0xC6);
+  jit_modrm_mem(j, 0, base, disp);
+  jit_emit8(j, imm);
+}
+
+/// `cmp dword [base + disp], imm`
+static void jit_cmp_mem32(Jit_Compiler *j, Jit_Reg base, int32_t disp, int8_t imm)
+{
+  jit_rex(j, false, JIT_RAX, base, false);
+  jit_emit8(j, 0x83);
+  jit_modrm_mem(j, 7, base, disp);
+  jit_emit8(j, (uint8_t) imm);
+}
+
+/// `cmp byte [base + disp], imm`
+static void jit_cmp_mem8(Jit_Compiler *j, Jit_Reg base, int32_t disp, int8_t imm)
+{
+  jit_rex(j, false, JIT_RAX, base, false);
+  jit_emit8(j, 0x80);
+  jit_modrm_mem(j, 7, base, disp);
+  jit_emit8(j, (uint8_t) imm);
+}
+
+static void jit_lea(Jit_Compiler *j, Jit_Reg dst, Jit_Reg base, int32_t disp)
+{
+  jit_rex(j, true, dst, base, false);
+  jit_emit8(j, 0x8D);
+  jit_modrm_mem(j, dst, base, disp);
+}
+
+static void jit_push(Jit_Compiler *j, Jit_Reg reg)
+{
+  jit_rex(j, false, JIT_RAX, reg, false);
+  jit_emit8(j, (uint8_t) (0x50 + (reg & 7)));
+}
+
+static void jit_pop(Jit_Compiler *j, Jit_Reg reg)
+{
+  jit_rex(j, false, JIT_RAX, reg, false);
+  jit_emit8(j, (uint8_t) (0x58 + (reg & 7)));
+}
+
+/// `jcc rel32`, returns where the displacement is
+static size_t jit_jcc(Jit_Compiler *j, Jit_Cc cc)
+{
+  jit_emit8(j, 0x0F);
+  jit_emit8(j, (uint8_t) (0x80 | cc));
+  size_t at = j->code.len;
+  jit_emit32(j, 0);
+  return at;
+}
+
+/// `jmp rel32`, returns where the displacement is
+static size_t jit_jmp(Jit_Compiler *j)
+{
+  jit_emit8(j, 0xE9);
+  size_t at = j->code.len;
+  jit_emit32(j, 0);
+  return at;
+}
+
+static void jit_patch(Jit_Compiler *j, size_t at, size_t target)
+{
+  uint32_t rel = (uint32_t) (int32_t) ((int64_t) target - (int64_t) (at + 4));
+  for (size_t i = 0; i < 4; ++i)
+  {
+    j->code.elems[at + i] = (uint8_t) (rel >> (8 * i));
+  }
+}
+
+/// an int operand of an arithmetic instruction
+typedef struct jit_operand
+{
+  enum { JIT_OPERAND_IMM, JIT_OPERAND_REG, JIT_OPERAND_MEM } kind;
+  int32_t imm;
+  Jit_Reg reg;
+  int32_t disp;
+} Jit_Operand;
+
+typedef enum jit_alu
+{
+  JIT_ALU_ADD,
+  JIT_ALU_SUB,
+  JIT_ALU_CMP,
+  JIT_ALU_IMUL,
+} Jit_Alu;
+
+/// `dst = dst <op> operand`
+static void jit_alu(Jit_Compiler *j, Jit_Alu op, Jit_Reg dst, Jit_Operand operand)
+{
+  static const uint8_t rm_opcodes[] = { 0x03, 0x2B, 0x3B };
+  static const int imm_extensions[] = { 0, 5, 7 };
+
+  switch (operand.kind)
+  {
+    case JIT_OPERAND_IMM:
+    {
+      if (op == JIT_ALU_IMUL)
+      {
+        jit_rex(j, true, dst, dst, false);
+        jit_emit8(j, 0x69);
+        jit_modrm_reg(j, dst, dst);
+      }
+      else
+      {
+        jit_rex(j, true, JIT_RAX, dst, false);
+        jit_emit8(j, 0x81);
+        jit_modrm_reg(j, imm_extensions[op], dst);
+      }
+      jit_emit32(j, (uint32_t) operand.imm);
+    } break;
+
+    case JIT_OPERAND_REG:
+    case JIT_OPERAND_MEM:
+    {
+      jit_rex(j, true, dst, operand.reg, false);
+      if (op == JIT_ALU_IMUL)
+      {
+        jit_emit8(j, 0x0F);
+        jit_emit8(j, 0xAF);
+      }
+      else
+      {
+        jit_emit8(j, rm_opcodes[op]);
+      }
+      if (operand.kind == JIT_OPERAND_REG)
+      {
+        jit_modrm_reg(j, dst, operand.reg);
+      }
+      else
+      {
+        jit_modrm_mem(j, dst, operand.reg, operand.disp);
+      }
+    } break;
+  }
+}
+
+static void jit_load_operand(Jit_Compiler *j, Jit_Reg dst, Jit_Operand operand)
+{
+  switch (operand.kind)
+  {
+    case JIT_OPERAND_IMM: { jit_mov_ri(j, dst, operand.imm); } break;
+    case JIT_OPERAND_REG: { jit_mov_rr(j, dst, operand.reg); } break;
+    case JIT_OPERAND_MEM: { jit_load(j, dst, operand.reg, operand.disp); } break;
+  }
+}
+
+///
+/// the modelled stack
+///
+
+/// the first and second 8 bytes of `v` as stored, padding zeroed
+static void jit_value_bits(Value v, uint64_t *head, uint64_t *payload)
+{
+  *head = (uint64_t) v.kind | ((uint64_t) v.short_len << 32);
+  memcpy(payload, &v.as, sizeof(*payload));
+}
+
+static Value jit_constant(Value_Kind kind, int64_t payload)
+{
+  Value v;
+  memset(&v, 0, sizeof(v));
+  v.kind = kind;
+  v.as.integer = payload;
+  return v;
+}
+
+static bool jit_copy_is_int(const Jit_Compiler *j, const Jit_Slot *slot)
+{
+  return slot->reg == JIT_SLOTS ? j->stack_int[slot->index] : j->global_int[slot->index];
+}
+
+static bool jit_slot_is_int(const Jit_Compiler *j, const Jit_Slot *slot, size_t position)
+{
+  switch (slot->kind)
+  {
+    case JIT_SLOT_MEMORY: return j->stack_int[position];
+    case JIT_SLOT_CONST:  return slot->constant.kind == VAL_INT;
+    case JIT_SLOT_COPY:   return jit_copy_is_int(j, slot);
+    case JIT_SLOT_INT:    return true;
+    case JIT_SLOT_BOOL:   return false;
+  }
+  return false;
+}
+
+/// copies the value at `src_index` of `src` to `dst_index` of `dst`
+static void jit_copy_value(
+  Jit_Compiler *j, Jit_Reg src, size_t src_index, Jit_Reg dst, size_t dst_index
+)
+{
+  if (src == dst && src_index == dst_index)
+  {
+    return;
+  }
+  for (int32_t half = 0; half < (int32_t) sizeof(Value); half += 8)
+  {
+    jit_load(j, JIT_RDX, src, jit_disp(src_index) + half);
+    jit_store(j, dst, jit_disp(dst_index) + half, JIT_RDX);
+  }
+}
+
+/// writes the value `slot` (at stack `position`) describes to `index` of `base`, only
+/// rdx is clobbered and the flags are left alone
+static void jit_write_slot(
+  Jit_Compiler *j, const Jit_Slot *slot, size_t position, Jit_Reg base, size_t index
+)
+{
+  int32_t disp = jit_disp(index);
+  switch (slot->kind)
+  {
+    case JIT_SLOT_MEMORY:
+    {
+      jit_copy_value(j, JIT_SLOTS, position, base, index);
+    } break;
+
+    case JIT_SLOT_COPY:
+    {
+      jit_copy_value(j, slot->reg, slot->index, base, index);
+    } break;
+
+    case JIT_SLOT_CONST:
+    {
+      uint64_t head, payload;
+      jit_value_bits(slot->constant, &head, &payload);
+      jit_store_imm(j, base, disp, head);
+      jit_store_imm(j, base, disp + JIT_PAYLOAD, payload);
+    } break;
+
+    case JIT_SLOT_INT:
+    case JIT_SLOT_BOOL:
+    {
+      jit_store_imm(j, base, disp, slot->kind == JIT_SLOT_INT ? VAL_INT : VAL_BOOL);
+      jit_store(j, base, disp + JIT_PAYLOAD, slot->reg);
+    } break;
+  }
+}
+
+/// writes every value of `stack` which isn't in its own slot there
+static void jit_write_stack(Jit_Compiler *j, const Jit_Slot *stack, size_t depth)
+{
+  for (size_t i = 0; i < depth; ++i)
+  {
+    if (stack[i].kind != JIT_SLOT_MEMORY)
+    {
+      jit_write_slot(j, &stack[i], i, JIT_SLOTS, i);
+    }
+  }
+}
+
+static void jit_release(Jit_Compiler *j, const Jit_Slot *slot)
+{
+  if (slot->kind == JIT_SLOT_INT || slot->kind == JIT_SLOT_BOOL)
+  {
+    j->regs_used &= ~(1u << slot->reg);
+  }
+}
+
+/// writes the value at `position` to its own slot
+static void jit_spill(Jit_Compiler *j, size_t position)
+{
+  Jit_Slot *slot = &j->stack[position];
+  if (slot->kind != JIT_SLOT_MEMORY)
+  {
+    bool is_int = jit_slot_is_int(j, slot, position);
+    jit_write_slot(j, slot, position, JIT_SLOTS, position);
+    jit_release(j, slot);
+    slot->kind = JIT_SLOT_MEMORY;
+    j->stack_int[position] = is_int;
+  }
+}
+
+/// writes the whole stack back, as it must be at the start of a block
+static void jit_flush(Jit_Compiler *j)
+{
+  for (size_t i = 0; i < j->depth; ++i)
+  {
+    jit_spill(j, i);
+  }
+}
+
+/// a free register, spilling the deepest value held in one when there are none
+static Jit_Reg jit_alloc(Jit_Compiler *j)
+{
+  for (size_t i = 0; i < JIT_POOL_SIZE; ++i)
+  {
+    if (!(j->regs_used & (1u << JIT_POOL[i])))
+    {
+      j->regs_used |= 1u << JIT_POOL[i];
+      return JIT_POOL[i];
+    }
+  }
+
+  for (size_t i = 0; i < j->depth; ++i)
+  {
+    if (j->stack[i].kind == JIT_SLOT_INT || j->stack[i].kind == JIT_SLOT_BOOL)
+    {
+      Jit_Reg reg = j->stack[i].reg;
+      jit_spill(j, i);
+      j->regs_used |= 1u << reg;
+      return reg;
+    }
+  }
+
+  assert(0 && "unreachable, every register holds a value on the stack");
+  return JIT_RAX;
+}
+
+static void jit_push_slot(Jit_Compiler *j, Jit_Slot slot)
+{
+  j->stack_int[j->depth] = false;
+  j->stack[j->depth++] = slot;
+}
+
+static void jit_push_const(Jit_Compiler *j, Value v)
+{
+  Jit_Slot slot = { .kind = JIT_SLOT_CONST, .reg = JIT_RAX, .index = 0, .constant = v };
+  jit_push_slot(j, slot);
+}
+
+/// pushes the value in `src` (a scratch register) as `kind`
+static void jit_push_reg(Jit_Compiler *j, Jit_Slot_Kind kind, Jit_Reg src)
+{
+  Jit_Reg reg = jit_alloc(j);
+  jit_mov_rr(j, reg, src);
+  Jit_Slot slot = { .kind = kind, .reg = reg, .index = 0, .constant = {0} };
+  jit_push_slot(j, slot);
+}
+
+static void jit_drop(Jit_Compiler *j, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    j->depth -= 1;
+    jit_release(j, &j->stack[j->depth]);
+    j->stack_int[j->depth] = false;
+  }
+}
+
+/// writes out every value still in `index` of `base`, before it's overwritten
+static void jit_detach_copies(Jit_Compiler *j, Jit_Reg base, size_t index)
+{
+  for (size_t i = 0; i < j->depth; ++i)
+  {
+    const Jit_Slot *slot = &j->stack[i];
+    if (slot->kind == JIT_SLOT_COPY && slot->reg == base && slot->index == index)
+    {
+      jit_spill(j, i);
+    }
+  }
+}
+
+///
+/// exits
+///
+
+/// returns to the interpreter at `offset` with `depth` values on the stack, which
+/// have already been written back
+static void jit_emit_exit(Jit_Compiler *j, size_t offset, size_t depth, bool deopt)
+{
+  jit_store_imm32(j, JIT_FRAME, (int32_t) offsetof(Jit_Frame, exit_offset), (uint32_t) offset);
+  jit_lea(j, JIT_RAX, JIT_SLOTS, jit_disp(depth));
+  jit_store(j, JIT_FRAME, (int32_t) offsetof(Jit_Frame, sp), JIT_RAX);
+  jit_store_imm8(j, JIT_FRAME, (int32_t) offsetof(Jit_Frame, deopt), deopt ? 1 : 0);
+  jit_patch(j, jit_jmp(j), j->epilogue);
+}
+
+/// leaves the interpreter to run the current instruction, for instructions which
+/// aren't compiled or whose operands are known to be of types the code doesn't handle
+static void jit_exit_here(Jit_Compiler *j)
+{
+  jit_flush(j);
+  jit_emit_exit(j, j->offset, j->depth, false);
+  j->live = false;
+}
+
+/// jumps to the current instruction's stub when `cc` holds, the first guard of an
+/// instruction snapshots the stack it writes back
+static void jit_deopt_if(Jit_Compiler *j, Jit_Cc cc)
+{
+  if (j->stub == SIZE_MAX)
+  {
+    Jit_Stub stub = {
+      .offset = j->offset,
+      .depth = j->depth,
+      .stack = tmalloc((j->depth + 1) * sizeof(Jit_Slot)),
+    };
+    memcpy(stub.stack, j->stack, j->depth * sizeof(Jit_Slot));
+    j->stub = j->stubs.len;
+    va_array_append(j->stubs, stub);
+  }
+
+  Jit_Patch patch = { .at = jit_jcc(j, cc), .target = j->stub };
+  va_array_append(j->stub_patches, patch);
+}
+
+/// jumps to the block starting at `target`, the stack has to have been written back
+static void jit_jump_to(Jit_Compiler *j, size_t at, size_t target)
+{
+  Jit_Patch patch = { .at = at, .target = target };
+  va_array_append(j->label_patches, patch);
+}
+
+///
+/// instructions
+///
+
+/// whether `slot` may be an int at runtime, instructions which need one leave with
+/// `jit_exit_here` when it can't be
+static bool jit_may_be_int(const Jit_Slot *slot)
+{
+  return !((slot->kind == JIT_SLOT_CONST && slot->constant.kind != VAL_INT)
+           || slot->kind == JIT_SLOT_BOOL);
+}
+
+/// guards `slot` (at stack `position`) is an int and returns where its payload is,
+/// ints too big for an immediate are loaded into `scratch`
+static Jit_Operand jit_int_operand(
+  Jit_Compiler *j, const Jit_Slot *slot, size_t position, Jit_Reg scratch
+)
+{
+  Jit_Operand operand = { .kind = JIT_OPERAND_REG, .imm = 0, .reg = slot->reg, .disp = 0 };
+  switch (slot->kind)
+  {
+    case JIT_SLOT_CONST:
+    {
+      int64_t n = slot->constant.as.integer;
+      if (n == (int32_t) n)
+      {
+        operand.kind = JIT_OPERAND_IMM;
+        operand.imm = (int32_t) n;
+      }
+      else
+      {
+        jit_mov_ri(j, scratch, n);
+        operand.reg = scratch;
+      }
+    } break;
+
+    case JIT_SLOT_MEMORY:
+    case JIT_SLOT_COPY:
+    {
+      Jit_Reg base = slot->kind == JIT_SLOT_MEMORY ? JIT_SLOTS : slot->reg;
+      size_t index = slot->kind == JIT_SLOT_MEMORY ? position : slot->index;
+      bool *known = base == JIT_GLOBALS ? &j->global_int[index] : &j->stack_int[index];
+      if (!*known)
+      {
+        jit_cmp_mem32(j, base, jit_disp(index), VAL_INT);
+        jit_deopt_if(j, JIT_CC_NE);
+        *known = true;
+      }
+      operand.kind = JIT_OPERAND_MEM;
+      operand.reg = base;
+      operand.disp = jit_disp(index) + JIT_PAYLOAD;
+    } break;
+
+    case JIT_SLOT_INT:
+    case JIT_SLOT_BOOL:
+    {
+    } break;
+  }
+  return operand;
+}
+
+/// jumps to `target` when the value at `base + disp` is falsy, `nil` or `false`
+static void jit_jump_if_falsy(Jit_Compiler *j, Jit_Reg base, int32_t disp, size_t target)
+{
+  jit_cmp_mem32(j, base, disp, VAL_NIL);
+  jit_jump_to(j, jit_jcc(j, JIT_CC_E), target);
+  jit_cmp_mem32(j, base, disp, VAL_BOOL);
+  size_t not_bool = jit_jcc(j, JIT_CC_NE);
+  jit_cmp_mem8(j, base, disp + JIT_PAYLOAD, 0);
+  jit_jump_to(j, jit_jcc(j, JIT_CC_E), target);
+  jit_patch(j, not_bool, j->code.len);
+}
+
+static void jit_compile_load_local(Jit_Compiler *j, size_t index)
+{
+  Jit_Slot *local = &j->stack[index];
+  if (local->kind == JIT_SLOT_CONST)
+  {
+    jit_push_const(j, local->constant);
+    return;
+  }
+
+  // NOTE(HS): copies are read from the local's slot, which has to be up to date
+  jit_spill(j, index);
+  Jit_Slot slot = { .kind = JIT_SLOT_COPY, .reg = JIT_SLOTS, .index = index, .constant = {0} };
+  jit_push_slot(j, slot);
+}
+
+static void jit_compile_store_local(Jit_Compiler *j, size_t index)
+{
+  size_t position = j->depth - 1;
+  Jit_Slot value = j->stack[position];
+  Jit_Slot *local = &j->stack[index];
+
+  if (local->kind != JIT_SLOT_MEMORY)
+  {
+    // NOTE(HS): nothing can have copied a local which isn't in its slot, so the new
+    // value simply replaces it (a value still in its own slot has to move over)
+    if (value.kind == JIT_SLOT_MEMORY)
+    {
+      jit_spill(j, index);
+    }
+    else
+    {
+      jit_release(j, local);
+      *local = value;
+      j->depth -= 1;
+      j->stack_int[j->depth] = false;
+      return;
+    }
+  }
+
+  if (value.kind == JIT_SLOT_COPY && value.reg == JIT_SLOTS && value.index == index)
+  {
+    jit_drop(j, 1);
+    return;
+  }
+
+  bool is_int = jit_slot_is_int(j, &value, position);
+  jit_detach_copies(j, JIT_SLOTS, index);
+  jit_write_slot(j, &value, position, JIT_SLOTS, index);
+  jit_drop(j, 1);
+  j->stack_int[index] = is_int;
+}
+
+static void jit_compile_store_global(Jit_Compiler *j, size_t index)
+{
+  size_t position = j->depth - 1;
+  Jit_Slot value = j->stack[position];
+
+  // NOTE(HS): only values which aren't objects are stored here, they need neither
+  // the collector's write barrier nor (as the global didn't hold a function either)
+  // call caches invalidating
+  if (value.kind == JIT_SLOT_CONST && value.constant.kind == VAL_OBJ)
+  {
+    jit_exit_here(j);
+    return;
+  }
+  if (value.kind == JIT_SLOT_MEMORY || value.kind == JIT_SLOT_COPY)
+  {
+    Jit_Reg base = value.kind == JIT_SLOT_MEMORY ? JIT_SLOTS : value.reg;
+    size_t from = value.kind == JIT_SLOT_MEMORY ? position : value.index;
+    if (!jit_slot_is_int(j, &value, position))
+    {
+      jit_cmp_mem32(j, base, jit_disp(from), VAL_OBJ);
+      jit_deopt_if(j, JIT_CC_E);
+    }
+  }
+  if (!j->global_int[index])
+  {
+    jit_cmp_mem32(j, JIT_GLOBALS, jit_disp(index), VAL_OBJ);
+    jit_deopt_if(j, JIT_CC_E);
+  }
+
+  bool is_int = jit_slot_is_int(j, &value, position);
+  if (!(value.kind == JIT_SLOT_COPY && value.reg == JIT_GLOBALS && value.index == index))
+  {
+    jit_detach_copies(j, JIT_GLOBALS, index);
+    jit_write_slot(j, &value, position, JIT_GLOBALS, index);
+  }
+  jit_drop(j, 1);
+  j->global_int[index] = is_int;
+}
+
+static void jit_compile_arith(Jit_Compiler *j, Opcode op)
+{
+  const Jit_Slot *lhs = &j->stack[j->depth - 2];
+  const Jit_Slot *rhs = &j->stack[j->depth - 1];
+  if (!jit_may_be_int(lhs) || !jit_may_be_int(rhs))
+  {
+    jit_exit_here(j);
+    return;
+  }
+
+  if (lhs->kind == JIT_SLOT_CONST && rhs->kind == JIT_SLOT_CONST && op != OPC_DIV)
+  {
+    int64_t a = lhs->constant.as.integer;
+    int64_t b = rhs->constant.as.integer;
+    int64_t result;
+    bool overflows =
+      op == OPC_ADD ? int_add_overflow(a, b, &result) :
+      op == OPC_SUB ? int_sub_overflow(a, b, &result) : int_mul_overflow(a, b, &result);
+    if (overflows)
+    {
+      jit_exit_here(j);
+      return;
+    }
+    jit_drop(j, 2);
+    jit_push_const(j, jit_constant(VAL_INT, result));
+    return;
+  }
+
+  Jit_Operand a = jit_int_operand(j, lhs, j->depth - 2, JIT_RAX);
+  Jit_Operand b = jit_int_operand(j, rhs, j->depth - 1, JIT_RCX);
+  jit_load_operand(j, JIT_RAX, a);
+
+  if (op == OPC_DIV)
+  {
+    // NOTE(HS): division by zero is an error and `INT64_MIN / -1` a bigint, both are
+    // left to the interpreter
+    int64_t divisor = rhs->kind == JIT_SLOT_CONST ? rhs->constant.as.integer : 0;
+    jit_load_operand(j, JIT_RCX, b);
+    if (divisor == 0 || divisor == -1)
+    {
+      Jit_Operand zero = { .kind = JIT_OPERAND_IMM, .imm = 0, .reg = JIT_RAX, .disp = 0 };
+      Jit_Operand minus_one = { .kind = JIT_OPERAND_IMM, .imm = -1, .reg = JIT_RAX, .disp = 0 };
+      Jit_Operand min = { .kind = JIT_OPERAND_REG, .imm = 0, .reg = JIT_RDX, .disp = 0 };
+      jit_alu(j, JIT_ALU_CMP, JIT_RCX, zero);
+      jit_deopt_if(j, JIT_CC_E);
+      jit_alu(j, JIT_ALU_CMP, JIT_RCX, minus_one);
+      size_t not_minus_one = jit_jcc(j, JIT_CC_NE);
+      jit_mov_ri(j, JIT_RDX, INT64_MIN);
+      jit_alu(j, JIT_ALU_CMP, JIT_RAX, min);
+      jit_deopt_if(j, JIT_CC_E);
+      jit_patch(j, not_minus_one, j->code.len);
+    }
+    jit_emit8(j, 0x48);   // cqo
+    jit_emit8(j, 0x99);
+    jit_rex(j, true, JIT_RAX, JIT_RCX, false);
+    jit_emit8(j, 0xF7);   // idiv rcx
+    jit_modrm_reg(j, 7, JIT_RCX);
+  }
+  else
+  {
+    Jit_Alu alu = op == OPC_ADD ? JIT_ALU_ADD : op == OPC_SUB ? JIT_ALU_SUB : JIT_ALU_IMUL;
+    jit_alu(j, alu, JIT_RAX, b);
+    jit_deopt_if(j, JIT_CC_O);
+  }
+
+  jit_drop(j, 2);
+  jit_push_reg(j, JIT_SLOT_INT, JIT_RAX);
+}
+
+static void jit_compile_negate(Jit_Compiler *j)
+{
+  const Jit_Slot *rhs = &j->stack[j->depth - 1];
+  if (!jit_may_be_int(rhs))
+  {
+    jit_exit_here(j);
+    return;
+  }
+  if (rhs->kind == JIT_SLOT_CONST && rhs->constant.as.integer != INT64_MIN)
+  {
+    int64_t n = rhs->constant.as.integer;
+    jit_drop(j, 1);
+    jit_push_const(j, jit_constant(VAL_INT, -n));
+    return;
+  }
+
+  jit_load_operand(j, JIT_RAX, jit_int_operand(j, rhs, j->depth - 1, JIT_RAX));
+  jit_rex(j, true, JIT_RAX, JIT_RAX, false);
+  jit_emit8(j, 0xF7);   // neg rax
+  jit_modrm_reg(j, 3, JIT_RAX);
+  jit_deopt_if(j, JIT_CC_O);
+
+  jit_drop(j, 1);
+  jit_push_reg(j, JIT_SLOT_INT, JIT_RAX);
+}
+
+static void jit_compile_not(Jit_Compiler *j)
+{
+  Jit_Slot value = j->stack[j->depth - 1];
+  switch (value.kind)
+  {
+    case JIT_SLOT_CONST:
+    {
+      jit_drop(j, 1);
+      jit_push_const(j, jit_constant(VAL_BOOL, !value_is_truthy(value.constant)));
+    } break;
+
+    case JIT_SLOT_INT:
+    {
+      jit_drop(j, 1);
+      jit_push_const(j, jit_constant(VAL_BOOL, false));
+    } break;
+
+    case JIT_SLOT_BOOL:
+    {
+      jit_rex(j, true, JIT_RAX, value.reg, false);
+      jit_emit8(j, 0x83);   // xor reg, 1
+      jit_modrm_reg(j, 6, value.reg);
+      jit_emit8(j, 1);
+    } break;
+
+    case JIT_SLOT_MEMORY:
+    case JIT_SLOT_COPY:
+    {
+      Jit_Reg base = value.kind == JIT_SLOT_MEMORY ? JIT_SLOTS : value.reg;
+      int32_t disp = jit_disp(value.kind == JIT_SLOT_MEMORY ? j->depth - 1 : value.index);
+      jit_mov_ri(j, JIT_RAX, 1);
+      jit_cmp_mem32(j, base, disp, VAL_NIL);
+      size_t is_nil = jit_jcc(j, JIT_CC_E);
+      jit_cmp_mem32(j, base, disp, VAL_BOOL);
+      size_t not_bool = jit_jcc(j, JIT_CC_NE);
+      jit_cmp_mem8(j, base, disp + JIT_PAYLOAD, 0);
+      size_t is_false = jit_jcc(j, JIT_CC_E);
+      jit_patch(j, not_bool, j->code.len);
+      jit_mov_ri(j, JIT_RAX, 0);
+      jit_patch(j, is_nil, j->code.len);
+      jit_patch(j, is_false, j->code.len);
+
+      jit_drop(j, 1);
+      jit_push_reg(j, JIT_SLOT_BOOL, JIT_RAX);
+    } break;
+  }
+}
+
+/// compiles a comparison, straight into a branch when a `JUMP_IF_FALSE` which doesn't
+/// start a block follows it. Returns the offset of the next instruction to compile.
+static size_t jit_compile_compare(Jit_Compiler *j, Opcode op, size_t next)
+{
+  const Jit_Slot *lhs = &j->stack[j->depth - 2];
+  const Jit_Slot *rhs = &j->stack[j->depth - 1];
+  if (!jit_may_be_int(lhs) || !jit_may_be_int(rhs))
+  {
+    jit_exit_here(j);
+    return next;
+  }
+
+  Jit_Cc cc;
+  switch (op)
+  {
+    case OPC_EQ:     { cc = JIT_CC_E; } break;
+    case OPC_NOT_EQ: { cc = JIT_CC_NE; } break;
+    case OPC_LT:     { cc = JIT_CC_L; } break;
+    case OPC_GT:     { cc = JIT_CC_G; } break;
+    case OPC_LTE:    { cc = JIT_CC_LE; } break;
+    default:         { cc = JIT_CC_GE; } break;
+  }
+
+  if (lhs->kind == JIT_SLOT_CONST && rhs->kind == JIT_SLOT_CONST)
+  {
+    int64_t a = lhs->constant.as.integer;
+    int64_t b = rhs->constant.as.integer;
+    bool result =
+      cc == JIT_CC_E ? a == b : cc == JIT_CC_NE ? a != b : cc == JIT_CC_L ? a < b :
+      cc == JIT_CC_G ? a > b : cc == JIT_CC_LE ? a <= b : a >= b;
+    jit_drop(j, 2);
+    jit_push_const(j, jit_constant(VAL_BOOL, result));
+    return next;
+  }
+
+  Jit_Operand a = jit_int_operand(j, lhs, j->depth - 2, JIT_RAX);
+  Jit_Operand b = jit_int_operand(j, rhs, j->depth - 1, JIT_RCX);
+  jit_load_operand(j, JIT_RAX, a);
+  jit_drop(j, 2);
+
+  Opcode raw;
+  bool fuse = next < j->chunk->code.len && !j->labels[next]
+    && jit_decode(j->chunk, next, &raw) == OPC_JUMP_IF_FALSE;
+  if (fuse)
+  {
+    // NOTE(HS): writing the stack back only moves values, the flags survive it
+    jit_alu(j, JIT_ALU_CMP, JIT_RAX, b);
+    jit_flush(j);
+    jit_jump_to(j, jit_jcc(j, jit_cc_invert(cc)), jit_jump_target(j->chunk, next, OPC_JUMP_IF_FALSE));
+    return next + opcode_length(raw);
+  }
+
+  jit_alu(j, JIT_ALU_CMP, JIT_RAX, b);
+  jit_emit8(j, 0x0F);   // setcc al
+  jit_emit8(j, (uint8_t) (0x90 | cc));
+  jit_modrm_reg(j, 0, JIT_RAX);
+  jit_emit8(j, 0x0F);   // movzx eax, al
+  jit_emit8(j, 0xB6);
+  jit_modrm_reg(j, JIT_RAX, JIT_RAX);
+  jit_push_reg(j, JIT_SLOT_BOOL, JIT_RAX);
+  return next;
+}
+
+static void jit_compile_jump_if_false(Jit_Compiler *j, size_t target)
+{
+  Jit_Slot cond = j->stack[j->depth - 1];
+  jit_drop(j, 1);
+  jit_flush(j);
+
+  // NOTE(HS): the condition was dropped first, so writing the stack back leaves its
+  // register and slot alone
+  switch (cond.kind)
+  {
+    case JIT_SLOT_CONST:
+    {
+      if (!value_is_truthy(cond.constant))
+      {
+        jit_jump_to(j, jit_jmp(j), target);
+        j->live = false;
+      }
+    } break;
+
+    case JIT_SLOT_INT:
+    {
+    } break;
+
+    case JIT_SLOT_BOOL:
+    {
+      jit_rex(j, true, cond.reg, cond.reg, false);
+      jit_emit8(j, 0x85);   // test reg, reg
+      jit_modrm_reg(j, cond.reg, cond.reg);
+      jit_jump_to(j, jit_jcc(j, JIT_CC_E), target);
+    } break;
+
+    case JIT_SLOT_MEMORY:
+    case JIT_SLOT_COPY:
+    {
+      Jit_Reg base = cond.kind == JIT_SLOT_MEMORY ? JIT_SLOTS : cond.reg;
+      size_t index = cond.kind == JIT_SLOT_MEMORY ? j->depth : cond.index;
+      jit_jump_if_falsy(j, base, jit_disp(index), target);
+    } break;
+  }
+}
+
+/// compiles the instruction at `j->offset`, returns the offset of the next one
+static size_t jit_compile_instruction(Jit_Compiler *j)
+{
+  const Chunk *chunk = j->chunk;
+  size_t offset = j->offset;
+  Opcode raw;
+  Opcode op = jit_decode(chunk, offset, &raw);
+  size_t next = offset + opcode_length(raw);
+
+  if (jit_is_exit(op, raw))
+  {
+    jit_exit_here(j);
+    return next;
+  }
+
+  switch (op)
+  {
+    case OPC_LOAD_CONST:
+    {
+      jit_push_const(j, chunk->constants.elems[jit_operand(chunk, offset, 0)]);
+    } break;
+
+    case OPC_LOAD_NIL:   { jit_push_const(j, jit_constant(VAL_NIL, 0)); } break;
+    case OPC_LOAD_TRUE:  { jit_push_const(j, jit_constant(VAL_BOOL, true)); } break;
+    case OPC_LOAD_FALSE: { jit_push_const(j, jit_constant(VAL_BOOL, false)); } break;
+    case OPC_POP:        { jit_drop(j, 1); } break;
+    case OPC_POPN:       { jit_drop(j, jit_operand(chunk, offset, 0)); } break;
+
+    case OPC_LOAD_GLOBAL:
+    {
+      Jit_Slot slot = {
+        .kind = JIT_SLOT_COPY, .reg = JIT_GLOBALS, .index = jit_operand(chunk, offset, 0),
+        .constant = {0},
+      };
+      jit_push_slot(j, slot);
+    } break;
+
+    case OPC_STORE_GLOBAL: { jit_compile_store_global(j, jit_operand(chunk, offset, 0)); } break;
+    case OPC_LOAD_LOCAL:   { jit_compile_load_local(j, jit_operand(chunk, offset, 0)); } break;
+    case OPC_STORE_LOCAL:  { jit_compile_store_local(j, jit_operand(chunk, offset, 0)); } break;
+    case OPC_NEGATE:       { jit_compile_negate(j); } break;
+    case OPC_NOT:          { jit_compile_not(j); } break;
+
+    case OPC_ADD: case OPC_SUB: case OPC_MUL: case OPC_DIV:
+    {
+      jit_compile_arith(j, op);
+    } break;
+
+    case OPC_EQ: case OPC_NOT_EQ: case OPC_LT: case OPC_GT: case OPC_LTE: case OPC_GTE:
+    {
+      next = jit_compile_compare(j, op, next);
+    } break;
+
+    case OPC_JUMP:
+    case OPC_LOOP:
+    {
+      jit_flush(j);
+      jit_jump_to(j, jit_jmp(j), jit_jump_target(chunk, offset, op));
+      j->live = false;
+    } break;
+
+    case OPC_JUMP_IF_FALSE:
+    {
+      jit_compile_jump_if_false(j, jit_jump_target(chunk, offset, op));
+    } break;
+
+    default:
+    {
+      assert(0 && "unreachable, every other instruction is an exit");
+    } break;
+  }
+  return next;
+}
+
+/// NOTE(HS): the code is entered through `entry(frame, code)`. The prologue keeps the
+/// callee saved registers it uses and jumps to `code`, every exit leaves through the
+/// epilogue straight after it.
+static void jit_compile_prologue(Jit_Compiler *j)
+{
+  static const Jit_Reg saved[] = { JIT_RBX, JIT_R12, JIT_R13, JIT_R14, JIT_R15 };
+  size_t saved_len = sizeof(saved) / sizeof(saved[0]);
+
+  for (size_t i = 0; i < saved_len; ++i)
+  {
+    jit_push(j, saved[i]);
+  }
+  jit_mov_rr(j, JIT_FRAME, JIT_RDI);
+  jit_load(j, JIT_SLOTS, JIT_FRAME, (int32_t) offsetof(Jit_Frame, slots));
+  jit_load(j, JIT_GLOBALS, JIT_FRAME, (int32_t) offsetof(Jit_Frame, globals));
+  jit_rex(j, false, JIT_RAX, JIT_RSI, false);
+  jit_emit8(j, 0xFF);   // jmp rsi
+  jit_modrm_reg(j, 4, JIT_RSI);
+
+  j->epilogue = j->code.len;
+  for (size_t i = saved_len; i > 0; --i)
+  {
+    jit_pop(j, saved[i - 1]);
+  }
+  jit_emit8(j, 0xC3);   // ret
+}
+
+static void jit_compile_body(Jit_Compiler *j)
+{
+  const Chunk *chunk = j->chunk;
+  size_t offset = 0;
+  while (offset < chunk->code.len)
+  {
+    Opcode raw;
+    jit_decode(chunk, offset, &raw);
+    if (j->depths[offset] == SIZE_MAX)
+    {
+      offset += opcode_length(raw);
+      continue;
+    }
+
+    if (j->labels[offset])
+    {
+      if (j->live)
+      {
+        jit_flush(j);
+      }
+      j->entries[offset].code = (uint32_t) j->code.len;
+      j->entries[offset].depth = (uint32_t) j->depths[offset];
+      j->depth = j->depths[offset];
+      j->regs_used = 0;
+      for (size_t i = 0; i < j->depth; ++i)
+      {
+        j->stack[i].kind = JIT_SLOT_MEMORY;
+      }
+      memset(j->stack_int, 0, (chunk->max_stack + 1) * sizeof(bool));
+      memset(j->global_int, 0, (chunk->global_count + 1) * sizeof(bool));
+      j->live = true;
+    }
+
+    if (!j->live)
+    {
+      offset += opcode_length(raw);
+      continue;
+    }
+
+    assert(j->depth == j->depths[offset]);
+    j->offset = offset;
+    j->stub = SIZE_MAX;
+    offset = jit_compile_instruction(j);
+  }
+
+  // NOTE(HS): the last instruction always returns, so there's nothing to fall off
+  assert(!j->live);
+}
+
+static void jit_compile_stubs(Jit_Compiler *j)
+{
+  for (size_t i = 0; i < j->stubs.len; ++i)
+  {
+    Jit_Stub *stub = &j->stubs.elems[i];
+    size_t start = j->code.len;
+    for (size_t p = 0; p < j->stub_patches.len; ++p)
+    {
+      if (j->stub_patches.elems[p].target == i)
+      {
+        jit_patch(j, j->stub_patches.elems[p].at, start);
+      }
+    }
+    jit_write_stack(j, stub->stack, stub->depth);
+    jit_emit_exit(j, stub->offset, stub->depth, true);
+  }
+}
+
+static bool jit_contains_loop(const Chunk *chunk)
+{
+  for (size_t offset = 0; offset < chunk->code.len; )
+  {
+    Opcode raw;
+    if (jit_decode(chunk, offset, &raw) == OPC_LOOP)
+    {
+      return true;
+    }
+    offset += opcode_length(raw);
+  }
+  return false;
+}
+
+///
+/// public functions
+///
+
+Jit_Code *jit_compile(const Chunk *chunk)
+{
+  // NOTE(HS): code without loops spends most of its time in calls, which are left to
+  // the interpreter, so isn't worth compiling
+  if (chunk->code.len == 0 || chunk->code.len >= UINT32_MAX || !jit_contains_loop(chunk))
+  {
+    return NULL;
+  }
+
+  size_t len = chunk->code.len;
+  Jit_Compiler j = {
+    .chunk = chunk,
+    .depths = tmalloc(len * sizeof(size_t)),
+    .labels = tcalloc(len, sizeof(bool)),
+    .stack = tcalloc(chunk->max_stack + 1, sizeof(Jit_Slot)),
+    .depth = 0,
+    .stack_int = tcalloc(chunk->max_stack + 1, sizeof(bool)),
+    .global_int = tcalloc(chunk->global_count + 1, sizeof(bool)),
+    .regs_used = 0,
+    .offset = 0,
+    .stub = SIZE_MAX,
+    .live = false,
+    .epilogue = 0,
+    .entries = tmalloc(len * sizeof(Jit_Entry)),
+  };
+  va_array_init(uint8_t, j.code);
+  va_array_init(Jit_Stub, j.stubs);
+  va_array_init(Jit_Patch, j.label_patches);
+  va_array_init(Jit_Patch, j.stub_patches);
+  for (size_t i = 0; i < len; ++i)
+  {
+    j.entries[i].code = JIT_NO_ENTRY;
+    j.entries[i].depth = 0;
+  }
+
+  Jit_Code *code = NULL;
+  if (jit_analyse(&j))
+  {
+    jit_compile_prologue(&j);
+    jit_compile_body(&j);
+    jit_compile_stubs(&j);
+    for (size_t i = 0; i < j.label_patches.len; ++i)
+    {
+      const Jit_Patch *patch = &j.label_patches.elems[i];
+      assert(j.entries[patch->target].code != JIT_NO_ENTRY);
+      jit_patch(&j, patch->at, j.entries[patch->target].code);
+    }
+
+    void *memory = mmap(
+      NULL, j.code.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (memory != MAP_FAILED)
+    {
+      memcpy(memory, j.code.elems, j.code.len);
+      if (mprotect(memory, j.code.len, PROT_READ | PROT_EXEC) == 0)
+      {
+        code = tmalloc(sizeof(Jit_Code));
+        code->code = memory;
+        code->size = j.code.len;
+        code->entries = j.entries;
+        code->entries_len = len;
+        code->deopts = 0;
+        j.entries = NULL;
+      }
+      else
+      {
+        munmap(memory, j.code.len);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < j.stubs.len; ++i)
+  {
+    tfree(j.stubs.elems[i].stack);
+  }
+  va_array_free(j.code);
+  va_array_free(j.stubs);
+  va_array_free(j.label_patches);
+  va_array_free(j.stub_patches);
+  tfree(j.depths);
+  tfree(j.labels);
+  tfree(j.stack);
+  tfree(j.stack_int);
+  tfree(j.global_int);
+  tfree(j.entries);
+  return code;
+}
+
+bool jit_enter(const Jit_Code *code, size_t offset, Jit_Frame *frame)
+{
+  if (offset >= code->entries_len || code->entries[offset].code == JIT_NO_ENTRY
+      || frame->sp != frame->slots + code->entries[offset].depth)
+  {
+    return false;
+  }
+
+  // NOTE(HS): converting between object and function pointers isn't ISO C
+  void (*entry)(Jit_Frame*, const uint8_t*);
+  memcpy(&entry, &code->code, sizeof(entry));
+  entry(frame, code->code + code->entries[offset].code);
+  return true;
+}
+
+#else
+
+Jit_Code *jit_compile(const Chunk *chunk)
+{
+  (void) chunk;
+  return NULL;
+}
+
+bool jit_enter(const Jit_Code *code, size_t offset, Jit_Frame *frame)
+{
+  (void) code;
+  (void) offset;
+  (void) frame;
+  return false;
+}
+
+#endif // JIT_SUPPORTED
@@ -1,9 +1,12 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_LEXER
 #include <assert.h>
 // TODO(HS): impl own c-string functions
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include "lexer.h"
 #include "lexer_internal.h"
+#include "util.h"
 
 void lexer_init(Lexer *lx, const char *program)
 {
@@ -20,6 +23,14 @@ void lexer_init(Lexer *lx, const char *program)
   lexer_read_char(lx);
 }
 
+void lexer_init_at(Lexer *lx, const char *program, size_t pos)
+{
+  lexer_init(lx, program);
+  assert(pos <= lx->program_len);
+  lx->read_pos = pos;
+  lexer_read_char(lx);
+}
+
 const char *token_kind_to_string(Token_Kind kind)
 {
   char *str = NULL;
@@ -59,6 +70,7 @@ Token lexer_next_token(Lexer *lx)
   case ']':  { token.kind = TK_RBRACKET; } break;
   case ';':  { token.kind = TK_SEMICOLON; } break;
   case ',':  { token.kind = TK_COMMA; } break;
+  case '@':  { token.kind = TK_AT; } break;
 
   case '+':  { token.kind = TK_PLUS; } break;
   case '-':  { token.kind = TK_MINUS; } break;
@@ -242,7 +254,14 @@ Token_Kind string_view_to_token_kind(String_View sv)
 
   Token_Kind kind;
   if      (lexer_sv_cmp_str(sv, "var"))     { kind = TK_VAR; }
-  else if (lexer_sv_cmp_str(sv, "println")) { kind = TK_PRINTLN; }
+  else if (lexer_sv_cmp_str(sv, "if"))      { kind = TK_IF; }
+  else if (lexer_sv_cmp_str(sv, "else"))    { kind = TK_ELSE; }
+  else if (lexer_sv_cmp_str(sv, "while"))   { kind = TK_WHILE; }
+  else if (lexer_sv_cmp_str(sv, "true"))    { kind = TK_TRUE; }
+  else if (lexer_sv_cmp_str(sv, "false"))   { kind = TK_FALSE; }
+  else if (lexer_sv_cmp_str(sv, "func"))    { kind = TK_FUNC; }
+  else if (lexer_sv_cmp_str(sv, "return"))  { kind = TK_RETURN; }
+  else if (lexer_sv_cmp_str(sv, "const"))   { kind = TK_CONST; }
   else                                      { kind = TK_IDENT; }
 
   return kind;
@@ -276,3 +295,73 @@ void token_to_string(Token t, char *buffer, int buffer_size)
   assert(bytes_written == bytes_to_write);
   buffer[bytes_to_write] = '\0';
 }
+
+void line_index_init(Line_Index *index, const char *program)
+{
+  va_array_init(size_t, *index);
+  size_t start = 0;
+  va_array_append(*index, start);
+  for (size_t i = 0; program[i] != '\0'; ++i)
+  {
+    if (program[i] == '\n')
+    {
+      size_t next = i + 1;
+      va_array_append(*index, next);
+    }
+  }
+}
+
+void line_index_free(Line_Index *index)
+{
+  va_array_free(*index);
+}
+
+Location line_index_location(const Line_Index *index, size_t pos)
+{
+  // NOTE(HS): the last line starting at or before `pos`
+  size_t lo = 0, hi = index->len;
+  while (hi - lo > 1)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->elems[mid] <= pos)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return make_location(pos, pos - index->elems[lo], lo);
+}
+
+void line_index_set_init(Line_Index_Set *set)
+{
+  va_array_init(Line_Index_Entry, *set);
+}
+
+void line_index_set_free(Line_Index_Set *set)
+{
+  for (size_t i = 0; i < set->len; ++i)
+  {
+    line_index_free(&set->elems[i].index);
+  }
+  va_array_free(*set);
+}
+
+Location line_index_set_location(Line_Index_Set *set, const char *program, size_t pos)
+{
+  // NOTE(HS): reports span few programs, a scan finds the index soon enough
+  for (size_t i = 0; i < set->len; ++i)
+  {
+    if (set->elems[i].program == program)
+    {
+      return line_index_location(&set->elems[i].index, pos);
+    }
+  }
+
+  Line_Index_Entry entry = { .program = program };
+  line_index_init(&entry.index, program);
+  va_array_append(*set, entry);
+  return line_index_location(&set->elems[set->len - 1].index, pos);
+}
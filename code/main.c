@@ -1,6 +1,226 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_DRIVER
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aot.h"
 #include "repl.h"
+#include "runner.h"
 
-int main(void)
+static void print_usage(const char *exe)
 {
-  repl_run();
+  fprintf(
+    stderr,
+    "Usage: %s [--dump-ast] [--dump-bytecode] [--dump-ir] [--no-quicken]\n"
+    "          [--no-superinstructions] [--no-jit] [-O|--optimise] [--lazy]\n"
+    "          [--profile-calls <path>] [--inline-profile <path>]\n"
+    "          [--profile-opcodes <path>] [--profile-memo] [--memo-capacity <entries>]\n"
+    "          [--profile-samples <path>] [--sample-rate <hz>]\n"
+    "          [--counters <path>] [--counters-json <path>] [--trace-phases <path>]\n"
+    "          [--stats] [--output-buffer <bytes>]\n"
+    "          [--flush auto|line|full] [--gc-max-pause <microseconds>] [file]\n"
+    "       %s build [-o <output>] [--emit-c <path>] [--cc <compiler>] file\n",
+    exe, exe
+  );
+}
+
+/// `tyger build`, compiles a script into a standalone executable
+static int build_main(const char *exe, int argc, char **argv)
+{
+  Aot_Options options = aot_default_options();
+  const char *path = NULL;
+
+  for (int i = 0; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+    {
+      options.output = argv[++i];
+    }
+    else if (strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc)
+    {
+      options.emit_c = argv[++i];
+    }
+    else if (strcmp(argv[i], "--cc") == 0 && i + 1 < argc)
+    {
+      options.cc = argv[++i];
+    }
+    else if (argv[i][0] == '-' || path)
+    {
+      print_usage(exe);
+      return 1;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+
+  if (!path)
+  {
+    print_usage(exe);
+    return 1;
+  }
+  return aot_build_file(path, options);
+}
+
+int main(int argc, char **argv)
+{
+  Runner_Options options = runner_default_options();
+  const char *path = NULL;
+
+  if (argc > 1 && strcmp(argv[1], "build") == 0)
+  {
+    return build_main(argv[0], argc - 2, argv + 2);
+  }
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--dump-ast") == 0)
+    {
+      options.dump_ast = true;
+    }
+    else if (strcmp(argv[i], "--dump-bytecode") == 0)
+    {
+      options.dump_bytecode = true;
+    }
+    else if (strcmp(argv[i], "--dump-ir") == 0)
+    {
+      options.dump_ir = true;
+    }
+    else if (strcmp(argv[i], "-O") == 0 || strcmp(argv[i], "--optimise") == 0)
+    {
+      options.optimise = true;
+    }
+    else if (strcmp(argv[i], "--no-quicken") == 0)
+    {
+      options.no_quicken = true;
+    }
+    else if (strcmp(argv[i], "--no-superinstructions") == 0)
+    {
+      options.no_superinstructions = true;
+    }
+    else if (strcmp(argv[i], "--no-jit") == 0)
+    {
+      options.no_jit = true;
+    }
+    else if (strcmp(argv[i], "--lazy") == 0)
+    {
+      options.lazy_functions = true;
+    }
+    else if (strcmp(argv[i], "--profile-calls") == 0 && i + 1 < argc)
+    {
+      options.profile_calls_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--inline-profile") == 0 && i + 1 < argc)
+    {
+      options.inline_profile_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--profile-opcodes") == 0 && i + 1 < argc)
+    {
+      options.profile_opcodes_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--profile-samples") == 0 && i + 1 < argc)
+    {
+      options.profile_samples_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--sample-rate") == 0 && i + 1 < argc)
+    {
+      char *end = NULL;
+      unsigned long long hz = strtoull(argv[++i], &end, 10);
+      if (*end != '\0' || hz == 0 || hz > 1000000)
+      {
+        print_usage(argv[0]);
+        return 1;
+      }
+      options.sample_hz = (uint32_t) hz;
+    }
+    else if (
+      (strcmp(argv[i], "--counters") == 0 || strcmp(argv[i], "--counters-json") == 0)
+      && i + 1 < argc
+    )
+    {
+      if (!EXEC_COUNTERS_ENABLED)
+      {
+        fprintf(stderr, "[ERROR] %s needs a build configured with -DTYGER_COUNTERS=ON\n", argv[i]);
+        return 1;
+      }
+      if (strcmp(argv[i], "--counters") == 0)
+      {
+        options.counters_path = argv[++i];
+      }
+      else
+      {
+        options.counters_json_path = argv[++i];
+      }
+    }
+    else if (strcmp(argv[i], "--trace-phases") == 0 && i + 1 < argc)
+    {
+      options.trace_phases_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--stats") == 0)
+    {
+      options.memory_stats = true;
+    }
+    else if (strcmp(argv[i], "--profile-memo") == 0)
+    {
+      options.profile_memo = true;
+    }
+    else if (strcmp(argv[i], "--memo-capacity") == 0 && i + 1 < argc)
+    {
+      char *end = NULL;
+      unsigned long long capacity = strtoull(argv[++i], &end, 10);
+      if (*end != '\0' || capacity == 0)
+      {
+        print_usage(argv[0]);
+        return 1;
+      }
+      options.memo_capacity = (size_t) capacity;
+    }
+    else if (strcmp(argv[i], "--output-buffer") == 0 && i + 1 < argc)
+    {
+      char *end = NULL;
+      unsigned long long capacity = strtoull(argv[++i], &end, 10);
+      if (*end != '\0')
+      {
+        print_usage(argv[0]);
+        return 1;
+      }
+      options.output_capacity = (size_t) capacity;
+    }
+    else if (strcmp(argv[i], "--gc-max-pause") == 0 && i + 1 < argc)
+    {
+      char *end = NULL;
+      unsigned long long us = strtoull(argv[++i], &end, 10);
+      if (*end != '\0')
+      {
+        print_usage(argv[0]);
+        return 1;
+      }
+      options.gc.max_pause_ns = (uint64_t) us * 1000;
+    }
+    else if (strcmp(argv[i], "--flush") == 0 && i + 1 < argc)
+    {
+      if (!output_flush_from_string(argv[++i], &options.output_flush))
+      {
+        print_usage(argv[0]);
+        return 1;
+      }
+    }
+    else if (argv[i][0] == '-' || path)
+    {
+      print_usage(argv[0]);
+      return 1;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+
+  if (path)
+  {
+    return runner_run_file(path, options);
+  }
+
+  repl_run(options);
+  return 0;
 }
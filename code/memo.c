@@ -0,0 +1,480 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memo.h"
+#include "bigint.h"
+
+/// entries allocated by a cache's first miss, doubled whenever they're all in use
+/// until the cache's capacity is reached
+#define MEMO_INITIAL_ENTRIES 16
+
+///
+/// internal functions
+///
+
+static uint32_t memo_mix(uint64_t x)
+{
+  // NOTE(HS): the finaliser of splitmix64, small ints differ only in their low bits
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return (uint32_t) x;
+}
+
+/// NOTE(HS): has to agree with `value_equals`, strings hash their contents whatever
+/// their form and bigints their digits, other objects are only equal to themselves
+static uint32_t memo_hash_value(Value v)
+{
+  switch (v.kind)
+  {
+  case VAL_NIL:       { return 0x9e3779b9u; } break;
+  case VAL_BOOL:      { return v.as.boolean ? 0x7f4a7c15u : 0x85ebca6bu; } break;
+  case VAL_INT:       { return memo_mix((uint64_t) v.as.integer); } break;
+  case VAL_SHORT_STR: { return string_hash(v.as.chars, v.short_len); } break;
+  case VAL_OBJ:
+  {
+    if (value_is_obj_kind(v, OBJ_STRING))
+    {
+      return value_as_string(v)->hash;
+    }
+    if (value_is_obj_kind(v, OBJ_ROPE))
+    {
+      String_View view = value_string_view(&v);
+      return string_hash(view.str, view.len);
+    }
+    if (value_is_bigint(v))
+    {
+      const Obj_Bigint *n = value_as_bigint(v);
+      return string_hash((const char*) n->limbs, n->len * sizeof(uint32_t)) ^ (uint32_t) n->negative;
+    }
+    return memo_mix((uint64_t) (uintptr_t) v.as.obj);
+  } break;
+  }
+  return 0;
+}
+
+static uint32_t memo_hash_args(const Value *args, size_t arity)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < arity; ++i)
+  {
+    h = (h ^ memo_hash_value(args[i])) * 16777619u;
+  }
+  return h;
+}
+
+static bool memo_keys_equal(const Value *keys, const Value *args, size_t arity)
+{
+  for (size_t i = 0; i < arity; ++i)
+  {
+    if (!value_equals(keys[i], args[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void memo_unlink_recency(Memo_Cache *cache, uint32_t index)
+{
+  Memo_Entry *entry = &cache->entries[index];
+  if (entry->newer == MEMO_NONE)
+  {
+    cache->newest = entry->older;
+  }
+  else
+  {
+    cache->entries[entry->newer].older = entry->older;
+  }
+  if (entry->older == MEMO_NONE)
+  {
+    cache->oldest = entry->newer;
+  }
+  else
+  {
+    cache->entries[entry->older].newer = entry->newer;
+  }
+}
+
+static void memo_link_newest(Memo_Cache *cache, uint32_t index)
+{
+  Memo_Entry *entry = &cache->entries[index];
+  entry->newer = MEMO_NONE;
+  entry->older = cache->newest;
+  if (cache->newest == MEMO_NONE)
+  {
+    cache->oldest = index;
+  }
+  else
+  {
+    cache->entries[cache->newest].newer = index;
+  }
+  cache->newest = index;
+}
+
+static void memo_unlink_bucket(Memo_Cache *cache, uint32_t index)
+{
+  uint32_t *link = &cache->buckets[cache->entries[index].hash & (cache->bucket_count - 1)];
+  while (*link != index)
+  {
+    assert(*link != MEMO_NONE);
+    link = &cache->entries[*link].chain;
+  }
+  *link = cache->entries[index].chain;
+}
+
+/// takes `index` out of both lists and puts it on the free list
+static void memo_remove(Memo_Cache *cache, uint32_t index)
+{
+  memo_unlink_bucket(cache, index);
+  memo_unlink_recency(cache, index);
+
+  Memo_Entry *entry = &cache->entries[index];
+  entry->generation += 1;
+  entry->ready = false;
+  entry->caller.cache = NULL;
+  entry->result = make_nil_value();
+  for (size_t i = 0; i < cache->arity; ++i)
+  {
+    cache->keys[index * cache->arity + i] = make_nil_value();
+  }
+  entry->chain = cache->free;
+  cache->free = index;
+  cache->used -= 1;
+}
+
+/// doubles the entries allocated (and the buckets with them), rechaining every entry
+/// in use
+static void memo_grow(Memo_Cache *cache)
+{
+  size_t allocated = cache->allocated == 0 ? MEMO_INITIAL_ENTRIES : cache->allocated * 2;
+  if (allocated > cache->capacity)
+  {
+    allocated = cache->capacity;
+  }
+
+  Memo_Entry *entries = trealloc(cache->entries, allocated * sizeof(Memo_Entry));
+  assert(entries);
+  cache->entries = entries;
+  if (cache->arity > 0)
+  {
+    Value *keys = trealloc(cache->keys, allocated * cache->arity * sizeof(Value));
+    assert(keys);
+    cache->keys = keys;
+  }
+
+  for (size_t i = cache->allocated; i < allocated; ++i)
+  {
+    cache->entries[i] = (Memo_Entry) {
+      .result = make_nil_value(),
+      .hash = 0,
+      .generation = 0,
+      .caller = { .cache = NULL, .index = 0, .generation = 0 },
+      .chain = i + 1 < allocated ? (uint32_t) (i + 1) : cache->free,
+      .newer = MEMO_NONE,
+      .older = MEMO_NONE,
+      .ready = false,
+    };
+    for (size_t j = 0; j < cache->arity; ++j)
+    {
+      cache->keys[i * cache->arity + j] = make_nil_value();
+    }
+  }
+  cache->free = (uint32_t) cache->allocated;
+  cache->allocated = allocated;
+
+  size_t bucket_count = 1;
+  while (bucket_count < allocated)
+  {
+    bucket_count *= 2;
+  }
+  tfree(cache->buckets);
+  cache->buckets = tmalloc(bucket_count * sizeof(uint32_t));
+  assert(cache->buckets);
+  cache->bucket_count = bucket_count;
+  for (size_t i = 0; i < bucket_count; ++i)
+  {
+    cache->buckets[i] = MEMO_NONE;
+  }
+
+  // NOTE(HS): every entry in use is on the recency list, unused ones are on the free
+  // list which shares `chain`
+  for (uint32_t i = cache->newest; i != MEMO_NONE; i = cache->entries[i].older)
+  {
+    uint32_t *bucket = &cache->buckets[cache->entries[i].hash & (bucket_count - 1)];
+    cache->entries[i].chain = *bucket;
+    *bucket = i;
+  }
+}
+
+/// an unused entry, evicting the least recently used one when the cache is full
+static uint32_t memo_take_entry(Memo_Cache *cache)
+{
+  if (cache->free == MEMO_NONE && cache->allocated < cache->capacity)
+  {
+    memo_grow(cache);
+  }
+  if (cache->free == MEMO_NONE)
+  {
+    assert(cache->oldest != MEMO_NONE);
+    memo_remove(cache, cache->oldest);
+    cache->stats.evictions += 1;
+  }
+
+  uint32_t index = cache->free;
+  cache->free = cache->entries[index].chain;
+  return index;
+}
+
+static Memo_Cache *memo_cache_new(const Obj_Function *function, size_t capacity)
+{
+  Memo_Cache *cache = tmalloc(sizeof(Memo_Cache));
+  assert(cache);
+  *cache = (Memo_Cache) {
+    .function = function,
+    .arity = function->arity,
+    .capacity = capacity == 0 ? 1 : capacity,
+    .entries = NULL,
+    .keys = NULL,
+    .allocated = 0,
+    .used = 0,
+    .free = MEMO_NONE,
+    .buckets = NULL,
+    .bucket_count = 0,
+    .newest = MEMO_NONE,
+    .oldest = MEMO_NONE,
+    .stats = { 0 },
+  };
+  return cache;
+}
+
+static void memo_cache_free(Memo_Cache *cache)
+{
+  tfree(cache->entries);
+  tfree(cache->keys);
+  tfree(cache->buckets);
+  tfree(cache);
+}
+
+static size_t memo_function_hash(const Obj_Function *function)
+{
+  return (size_t) memo_mix((uint64_t) (uintptr_t) function);
+}
+
+static Memo_Cache **memo_table_find_slot(
+  Memo_Cache **entries, size_t capacity, const Obj_Function *function
+)
+{
+  size_t index = memo_function_hash(function) & (capacity - 1);
+  while (entries[index] && entries[index]->function != function)
+  {
+    index = (index + 1) & (capacity - 1);
+  }
+  return &entries[index];
+}
+
+static void memo_table_grow(Memo_Table *table)
+{
+  size_t capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+  Memo_Cache **entries = tcalloc(capacity, sizeof(Memo_Cache*));
+  assert(entries);
+
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->entries[i])
+    {
+      *memo_table_find_slot(entries, capacity, table->entries[i]->function) = table->entries[i];
+    }
+  }
+
+  tfree(table->entries);
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+static const char *memo_cache_name(const Memo_Cache *cache)
+{
+  return cache->function->name ? cache->function->name->chars : "function";
+}
+
+/// most hits first, then by name
+static int memo_compare_hits(const void *a, const void *b)
+{
+  const Memo_Cache *lhs = *(const Memo_Cache* const*) a;
+  const Memo_Cache *rhs = *(const Memo_Cache* const*) b;
+  if (lhs->stats.hits != rhs->stats.hits)
+  {
+    return lhs->stats.hits < rhs->stats.hits ? 1 : -1;
+  }
+  return strcmp(memo_cache_name(lhs), memo_cache_name(rhs));
+}
+
+
+///
+/// public functions
+///
+
+void memo_table_init(Memo_Table *table)
+{
+  table->entries = NULL;
+  table->capacity = 0;
+  table->len = 0;
+}
+
+void memo_table_free(Memo_Table *table)
+{
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->entries[i])
+    {
+      memo_cache_free(table->entries[i]);
+    }
+  }
+  tfree(table->entries);
+  memo_table_init(table);
+}
+
+Memo_Cache *memo_table_cache(Memo_Table *table, const Obj_Function *function, size_t capacity)
+{
+  if (table->capacity > 0)
+  {
+    Memo_Cache *found = *memo_table_find_slot(table->entries, table->capacity, function);
+    if (found)
+    {
+      return found;
+    }
+  }
+
+  if ((table->len + 1) * 4 > table->capacity * 3)
+  {
+    memo_table_grow(table);
+  }
+  Memo_Cache **slot = memo_table_find_slot(table->entries, table->capacity, function);
+  *slot = memo_cache_new(function, capacity);
+  table->len += 1;
+  return *slot;
+}
+
+bool memo_cache_call(
+  Memo_Cache *cache, const Value *args, Memo_Ref caller, Value *result, Memo_Ref *ref
+)
+{
+  uint32_t hash = memo_hash_args(args, cache->arity);
+  if (cache->bucket_count > 0)
+  {
+    uint32_t index = cache->buckets[hash & (cache->bucket_count - 1)];
+    while (index != MEMO_NONE)
+    {
+      Memo_Entry *entry = &cache->entries[index];
+      if (entry->ready && entry->hash == hash &&
+          memo_keys_equal(&cache->keys[index * cache->arity], args, cache->arity))
+      {
+        memo_unlink_recency(cache, index);
+        memo_link_newest(cache, index);
+        cache->stats.hits += 1;
+        *result = entry->result;
+        return true;
+      }
+      index = entry->chain;
+    }
+  }
+
+  cache->stats.misses += 1;
+  uint32_t index = memo_take_entry(cache);
+  Memo_Entry *entry = &cache->entries[index];
+  entry->hash = hash;
+  entry->ready = false;
+  entry->caller = caller;
+  memcpy(&cache->keys[index * cache->arity], args, cache->arity * sizeof(Value));
+
+  uint32_t *bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+  entry->chain = *bucket;
+  *bucket = index;
+  memo_link_newest(cache, index);
+  cache->used += 1;
+
+  *ref = (Memo_Ref) { .cache = cache, .index = index, .generation = entry->generation };
+  return false;
+}
+
+// NOTE(HS): an evicted entry loses its link to its callers, whose entries then stay
+// pending until they're evicted in turn
+void memo_ref_fill(Memo_Ref ref, Value result)
+{
+  while (ref.cache)
+  {
+    Memo_Entry *entry = &ref.cache->entries[ref.index];
+    if (entry->generation != ref.generation)
+    {
+      return;
+    }
+    entry->result = result;
+    entry->ready = true;
+    ref = entry->caller;
+    entry->caller.cache = NULL;
+  }
+}
+
+void memo_ref_abandon(Memo_Ref ref)
+{
+  while (ref.cache && ref.cache->entries[ref.index].generation == ref.generation)
+  {
+    Memo_Ref caller = ref.cache->entries[ref.index].caller;
+    memo_remove(ref.cache, ref.index);
+    ref = caller;
+  }
+}
+
+void memo_table_mark(Gc *gc, const Memo_Table *table)
+{
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    const Memo_Cache *cache = table->entries[i];
+    if (!cache)
+    {
+      continue;
+    }
+    for (uint32_t index = cache->newest; index != MEMO_NONE; index = cache->entries[index].older)
+    {
+      gc_mark_value(gc, cache->entries[index].result);
+      for (size_t j = 0; j < cache->arity; ++j)
+      {
+        gc_mark_value(gc, cache->keys[index * cache->arity + j]);
+      }
+    }
+  }
+}
+
+void memo_table_write_stats(const Memo_Table *table, FILE *f)
+{
+  if (table->len == 0)
+  {
+    return;
+  }
+
+  Memo_Cache **caches = tmalloc(table->len * sizeof(Memo_Cache*));
+  assert(caches);
+  size_t len = 0;
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->entries[i])
+    {
+      caches[len++] = table->entries[i];
+    }
+  }
+  qsort(caches, len, sizeof(Memo_Cache*), memo_compare_hits);
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    const Memo_Cache *cache = caches[i];
+    fprintf(
+      f, "%llu %llu %llu %s\n",
+      (unsigned long long) cache->stats.hits, (unsigned long long) cache->stats.misses,
+      (unsigned long long) cache->stats.evictions, memo_cache_name(cache)
+    );
+  }
+  tfree(caches);
+}
@@ -0,0 +1,188 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_PROFILER
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "opcode_profile.h"
+
+///
+/// internal functions
+///
+
+// NOTE(HS): a run is packed into one key, the low byte is the length and every
+// following byte one opcode. Keys are never 0 as runs are at least 2 long, so 0 marks
+// an empty slot.
+static uint64_t sequence_key(const Opcode *ops, size_t len)
+{
+  assert(len >= 2 && len <= OPCODE_PROFILE_MAX_SEQUENCE);
+
+  uint64_t key = (uint64_t) len;
+  for (size_t i = 0; i < len; ++i)
+  {
+    key |= ((uint64_t) (uint8_t) ops[i]) << (8 * (i + 1));
+  }
+  return key;
+}
+
+static size_t sequence_key_len(uint64_t key)
+{
+  return (size_t) (key & 0xff);
+}
+
+static Opcode sequence_key_op(uint64_t key, size_t index)
+{
+  return (Opcode) ((key >> (8 * (index + 1))) & 0xff);
+}
+
+static size_t sequence_key_hash(uint64_t key)
+{
+  // NOTE(HS): fibonacci hashing, spreads the mostly small opcode bytes
+  return (size_t) ((key * 11400714819323198485ull) >> 32);
+}
+
+static Opcode_Sequence_Count *profile_find_slot(
+  Opcode_Sequence_Count *entries, size_t capacity, uint64_t key
+)
+{
+  size_t index = sequence_key_hash(key) & (capacity - 1);
+  while (entries[index].key != 0 && entries[index].key != key)
+  {
+    index = (index + 1) & (capacity - 1);
+  }
+  return &entries[index];
+}
+
+static void profile_grow(Opcode_Profile *profile)
+{
+  size_t capacity = profile->capacity == 0 ? 256 : profile->capacity * 2;
+  Opcode_Sequence_Count *entries = tcalloc(capacity, sizeof(Opcode_Sequence_Count));
+  assert(entries);
+
+  for (size_t i = 0; i < profile->capacity; ++i)
+  {
+    if (profile->entries[i].key != 0)
+    {
+      *profile_find_slot(entries, capacity, profile->entries[i].key) = profile->entries[i];
+    }
+  }
+
+  tfree(profile->entries);
+  profile->entries = entries;
+  profile->capacity = capacity;
+}
+
+static void profile_increment(Opcode_Profile *profile, const Opcode *ops, size_t len)
+{
+  if ((profile->len + 1) * 4 > profile->capacity * 3)
+  {
+    profile_grow(profile);
+  }
+
+  uint64_t key = sequence_key(ops, len);
+  Opcode_Sequence_Count *slot = profile_find_slot(profile->entries, profile->capacity, key);
+  if (slot->key == 0)
+  {
+    slot->key = key;
+    profile->len += 1;
+  }
+  slot->count += 1;
+}
+
+static int sequence_count_compare(const void *a, const void *b)
+{
+  const Opcode_Sequence_Count *lhs = a;
+  const Opcode_Sequence_Count *rhs = b;
+  if (lhs->count != rhs->count)
+  {
+    return lhs->count < rhs->count ? 1 : -1;
+  }
+  return lhs->key < rhs->key ? -1 : (lhs->key > rhs->key);
+}
+
+
+///
+/// public functions
+///
+
+void opcode_profile_init(Opcode_Profile *profile)
+{
+  memset(profile, 0, sizeof(*profile));
+}
+
+void opcode_profile_free(Opcode_Profile *profile)
+{
+  tfree(profile->entries);
+  memset(profile, 0, sizeof(*profile));
+}
+
+void opcode_profile_record(Opcode_Profile *profile, const uint8_t *instruction)
+{
+  // NOTE(HS): a quickened instruction whose guard failed is dispatched again at the
+  // same address in its generic form, that is still one instruction
+  if (instruction == profile->last)
+  {
+    return;
+  }
+
+  Opcode op = opcode_generic_form((Opcode) *instruction);
+  if (instruction != profile->expected)
+  {
+    profile->window_len = 0;
+  }
+
+  Opcode run[OPCODE_PROFILE_MAX_SEQUENCE];
+  for (size_t n = 1; n <= profile->window_len; ++n)
+  {
+    memcpy(run, profile->window + (profile->window_len - n), n * sizeof(Opcode));
+    run[n] = op;
+    profile_increment(profile, run, n + 1);
+  }
+
+  if (profile->window_len == OPCODE_PROFILE_MAX_SEQUENCE - 1)
+  {
+    memmove(profile->window, profile->window + 1, (profile->window_len - 1) * sizeof(Opcode));
+    profile->window_len -= 1;
+  }
+  profile->window[profile->window_len++] = op;
+
+  profile->last = instruction;
+  profile->expected = instruction + opcode_length(op);
+}
+
+uint64_t opcode_profile_count(const Opcode_Profile *profile, const Opcode *ops, size_t len)
+{
+  if (profile->capacity == 0)
+  {
+    return 0;
+  }
+
+  uint64_t key = sequence_key(ops, len);
+  return profile_find_slot(profile->entries, profile->capacity, key)->count;
+}
+
+void opcode_profile_write(const Opcode_Profile *profile, FILE *f)
+{
+  Opcode_Sequence_Count *sorted = tmalloc((profile->len + 1) * sizeof(Opcode_Sequence_Count));
+  assert(sorted);
+
+  size_t n = 0;
+  for (size_t i = 0; i < profile->capacity; ++i)
+  {
+    if (profile->entries[i].key != 0)
+    {
+      sorted[n++] = profile->entries[i];
+    }
+  }
+  qsort(sorted, n, sizeof(Opcode_Sequence_Count), sequence_count_compare);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    fprintf(f, "%llu", (unsigned long long) sorted[i].count);
+    for (size_t j = 0; j < sequence_key_len(sorted[i].key); ++j)
+    {
+      fprintf(f, " %s", opcode_to_string(sequence_key_op(sorted[i].key, j)));
+    }
+    fputc('\n', f);
+  }
+
+  tfree(sorted);
+}
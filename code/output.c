@@ -0,0 +1,136 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "output.h"
+#include "tmemory.h"
+
+///
+/// internal functions
+///
+
+static void output_write_fd(Output *out, const char *bytes, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t written = write(out->fd, bytes, len);
+    out->writes += 1;
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      // NOTE(HS): nowhere left to report the failure (e.g. a closed pipe), the
+      // output is dropped like `stdio` would
+      return;
+    }
+
+    bytes += written;
+    len -= (size_t) written;
+  }
+}
+
+
+///
+/// public functions
+///
+
+void output_init(Output *out, int fd, size_t capacity, Output_Flush flush)
+{
+  out->fd = fd;
+  out->buffer = capacity > 0 ? tmalloc(capacity) : NULL;
+  assert(capacity == 0 || out->buffer);
+  out->len = 0;
+  out->capacity = capacity;
+  out->writes = 0;
+
+  switch (flush)
+  {
+  case OUTPUT_FLUSH_AUTO: { out->line_buffered = isatty(fd); } break;
+  case OUTPUT_FLUSH_LINE: { out->line_buffered = true; } break;
+  case OUTPUT_FLUSH_FULL: { out->line_buffered = false; } break;
+  }
+}
+
+void output_free(Output *out)
+{
+  output_flush(out);
+  tfree(out->buffer);
+  out->buffer = NULL;
+  out->capacity = 0;
+}
+
+void output_write(Output *out, const char *bytes, size_t len)
+{
+  if (len == 0)
+  {
+    return;
+  }
+
+  if (len >= out->capacity)
+  {
+    output_flush(out);
+    output_write_fd(out, bytes, len);
+    return;
+  }
+
+  if (out->len + len > out->capacity)
+  {
+    output_flush(out);
+  }
+  memcpy(out->buffer + out->len, bytes, len);
+  out->len += len;
+
+  if (out->line_buffered && memchr(bytes, '\n', len))
+  {
+    output_flush(out);
+  }
+}
+
+void output_puts(Output *out, const char *str)
+{
+  output_write(out, str, strlen(str));
+}
+
+void output_putc(Output *out, char c)
+{
+  if (out->len < out->capacity && !(out->line_buffered && c == '\n'))
+  {
+    out->buffer[out->len++] = c;
+    return;
+  }
+  output_write(out, &c, 1);
+}
+
+void output_flush(Output *out)
+{
+  if (out->len > 0)
+  {
+    output_write_fd(out, out->buffer, out->len);
+    out->len = 0;
+  }
+}
+
+bool output_flush_from_string(const char *name, Output_Flush *flush)
+{
+  if (strcmp(name, "auto") == 0)
+  {
+    *flush = OUTPUT_FLUSH_AUTO;
+  }
+  else if (strcmp(name, "line") == 0)
+  {
+    *flush = OUTPUT_FLUSH_LINE;
+  }
+  else if (strcmp(name, "full") == 0)
+  {
+    *flush = OUTPUT_FLUSH_FULL;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
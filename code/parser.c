@@ -1,9 +1,12 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_PARSER
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "parser.h"
+#include "bigint.h"
 #include "lexer.h"
+#include "phase_trace.h"
 #include "util.h"
 
 // TODO(HS): refactor all instances of `va_array_next` out - may cause bugs if reallocs
@@ -33,6 +36,10 @@ static void parser_context_init(Parser_Context *ctx)
   va_array_init(char, ctx->evaluated_identifiers);
   va_array_init(Expression, ctx->expressions);
   va_array_init(char, ctx->strings);
+  va_array_init(Statement, ctx->statements);
+  va_array_init(Ident_Handle, ctx->params);
+  va_array_init(Func_Upvalue, ctx->upvalues);
+  va_array_init(Expression, ctx->arguments);
 }
 
 static inline void parser_next_token(Parser *p)
@@ -60,6 +67,8 @@ static inline int precidence_of(Token_Kind k)
 
   case TK_LT:
   case TK_GT:
+  case TK_LTE:
+  case TK_GTE:
   {
     precidence = PRECIDENCE_LESSGREATER;
   } break;
@@ -70,6 +79,11 @@ static inline int precidence_of(Token_Kind k)
     precidence = PRECIDENCE_EQUALS;
   } break;
 
+  case TK_LPAREN:
+  {
+    precidence = PRECIDENCE_CALL;
+  } break;
+
   default:
   {
     precidence = PRECIDENCE_LOWEST;
@@ -119,6 +133,9 @@ static inline Operator token_kind_to_operator(Token_Kind k)
   case TK_NOT_EQ:   { op = OP_NOT_EQ; } break;
   case TK_LT:       { op = OP_LT; } break;
   case TK_GT:       { op = OP_GT; } break;
+  case TK_LTE:      { op = OP_LTE; } break;
+  case TK_GTE:      { op = OP_GTE; } break;
+  case TK_BANG:     { op = OP_BANG; } break;
   default:
   {
     fprintf(stderr, "[ERROR] Cannot convert token %s to operator\n", token_kind_to_string(k));
@@ -128,17 +145,65 @@ static inline Operator token_kind_to_operator(Token_Kind k)
   return op;
 }
 
+static inline Tyger_Error parser_error(const Parser *p, Tyger_Error_Kind kind)
+{
+  Tyger_Error err = {
+    .kind = kind,
+    .location = p->cur_token.location,
+  };
+  return err;
+}
+
+/// copies `stmt` into `ctx->statements`, returning the handle to the copy
+static inline Statement_Handle parser_context_append_statement(Parser_Context *ctx, Statement stmt)
+{
+  Statement_Handle handle = va_array_next_handle(ctx->statements);
+  va_array_append(ctx->statements, stmt);
+  return handle;
+}
+
+/// steps over the block the current token opens by matching braces, leaving its closing
+/// brace as the current token
+static Tyger_Error parser_skip_block(Parser *p)
+{
+  Tyger_Error err = {0};
+
+  size_t depth = 1;
+  while (depth > 0)
+  {
+    parser_next_token(p);
+    switch (p->cur_token.kind)
+    {
+    case TK_LBRACE: { depth += 1; } break;
+    case TK_RBRACE: { depth -= 1; } break;
+    case TK_EOF:    { return parser_error(p, TYERR_SYNTAX); } break;
+    default: break;
+    }
+  }
+
+  return err;
+}
+
+static Program parser_program_new(void)
+{
+  Program program = {0};
+  va_array_init(Tyger_Error, program.errors);
+  va_array_init(Statement, program.statements);
+  return program;
+}
+
 // TODO(HS): decide where/when in `expr` lifetime I need to perform copy into backing
 // ctx buffer
 static Tyger_Error parse_expression(Parser *p, Parser_Context *ctx, Expression *expr, int precidence)
 {
   Tyger_Error err = {0};
+  Location location = p->cur_token.location;
 
   switch (p->cur_token.kind)
   {
   case TK_INTEGER:
   {
-    err = parse_int_expression(p, expr);
+    err = parse_int_expression(p, ctx, expr);
   } break;
 
   case TK_STRING:
@@ -146,37 +211,58 @@ static Tyger_Error parse_expression(Parser *p, Parser_Context *ctx, Expression *
     err = parse_string_expression(p, ctx, expr);
   } break;
 
-  // TODO(HS): add support for call expressions here
   case TK_IDENT:
   {
     err = parse_ident_expression(p, ctx, expr);
   } break;
 
-  // TODO(HS): maybe this is a bad idea and I should just do a hash lookup for global
-  // builtin functions (means `println` => TK_IDENT)
-  // NOTE(HS): builtin functions
-  case TK_PRINTLN:
+  case TK_TRUE:
+  case TK_FALSE:
+  {
+    err = parse_bool_expression(p, expr);
+  } break;
+
+  case TK_LPAREN:
+  {
+    err = parse_grouped_expression(p, ctx, expr);
+  } break;
+
+  case TK_MINUS:
+  case TK_BANG:
+  {
+    err = parse_prefix_expression(p, ctx, expr);
+  } break;
+
+  case TK_FUNC:
+  {
+    err = parse_func_expression(p, ctx, expr);
+  } break;
+
+  case TK_AT:
   {
-    err = parse_call_expression(p, ctx, expr);
+    err = parse_annotated_expression(p, ctx, expr);
   } break;
 
   default:
   {
-    Token_Kind k = p->cur_token.kind;
-    fprintf(
-      stderr, "[ERROR] Unexpected token kind encountererd whilst parsing: %i (%s)\n",
-      k, token_kind_to_string(k)
-    );
-    assert(0);
+    err = parser_error(p, TYERR_SYNTAX);
   } break;
   }
 
   if (err.kind == TYERR_NONE)
   {
+    expr->location = location;
     while (!peek_token_is(p, TK_SEMICOLON) && (precidence < peek_precidence(p)))
     {
       parser_next_token(p);
-      err = parse_infix_expression(p, ctx, expr);
+      if (cur_token_is(p, TK_LPAREN))
+      {
+        err = parse_call_expression(p, ctx, expr);
+      }
+      else
+      {
+        err = parse_infix_expression(p, ctx, expr);
+      }
       if (err.kind != TYERR_NONE)
       {
         return err;
@@ -196,19 +282,19 @@ static Tyger_Error parse_expression(Parser *p, Parser_Context *ctx, Expression *
 /// to_string functions
 ///
 
-const char *tyger_error_kind_to_string(Tyger_Error_Kind kind)
+const char *statement_kind_to_string(Statement_Kind kind)
 {
   const char *str;
 
   switch (kind)
   {
-#define X(NAME) case TYERR_##NAME: { str = #NAME; } break;
-    #include "defs/tyger-error-kind.def"
+#define X(NAME) case STMT_##NAME: { str = #NAME; } break;
+    #include "defs/statement-kind.def"
 #undef X
 
   default:
   {
-    fprintf(stderr, "[ERROR] Invalid error kind encountered: %i\n", kind);
+    fprintf(stderr, "[ERROR] Invalid statement kind encountered: %i\n", kind);
     str = NULL;
     assert(0);
   } break;
@@ -217,19 +303,19 @@ const char *tyger_error_kind_to_string(Tyger_Error_Kind kind)
   return str;
 }
 
-const char *statement_kind_to_string(Statement_Kind kind)
+const char *expression_kind_to_string(Expression_Kind kind)
 {
   const char *str;
 
   switch (kind)
   {
-#define X(NAME) case STMT_##NAME: { str = #NAME; } break;
-    #include "defs/statement-kind.def"
+#define X(NAME) case EXPR_##NAME: { str = #NAME; } break;
+    #include "defs/expression-kind.def"
 #undef X
 
   default:
   {
-    fprintf(stderr, "[ERROR] Invalid statement kind encountered: %i\n", kind);
+    fprintf(stderr, "[ERROR] Invalid expression kind encountered: %i\n", kind);
     str = NULL;
     assert(0);
   } break;
@@ -238,19 +324,19 @@ const char *statement_kind_to_string(Statement_Kind kind)
   return str;
 }
 
-const char *expression_kind_to_string(Expression_Kind kind)
+const char *binding_kind_to_string(Binding_Kind kind)
 {
   const char *str;
 
   switch (kind)
   {
-#define X(NAME) case EXPR_##NAME: { str = #NAME; } break;
-    #include "defs/expression-kind.def"
+#define X(NAME) case BINDING_##NAME: { str = #NAME; } break;
+    #include "defs/binding-kind.def"
 #undef X
 
   default:
   {
-    fprintf(stderr, "[ERROR] Invalid expression kind encountered: %i\n", kind);
+    fprintf(stderr, "[ERROR] Invalid binding kind encountered: %i\n", kind);
     str = NULL;
     assert(0);
   } break;
@@ -324,6 +410,33 @@ const Expression *expression_handle_to_expression(const Program *p, Expression_H
   return result;
 }
 
+const Statement *statement_handle_to_statement(const Program *p, Statement_Handle hndl)
+{
+  Statement *result = NULL;
+  if (hndl < p->context.statements.len)
+  {
+    result = &(p->context.statements.elems[hndl]);
+  }
+  return result;
+}
+
+Ident_Handle func_expression_param(const Program *p, const Func_Expression *fexpr, size_t index)
+{
+  assert(index < fexpr->params_len);
+  return p->context.params.elems[fexpr->params_first + index];
+}
+
+Func_Upvalue func_expression_upvalue(const Program *p, const Func_Expression *fexpr, size_t index)
+{
+  assert(index < fexpr->upvalues_len);
+  return p->context.upvalues.elems[fexpr->upvalues_first + index];
+}
+
+size_t func_expression_pos(const Func_Expression *fexpr)
+{
+  return fexpr->pos;
+}
+
 
 ///
 /// Parser functions
@@ -332,21 +445,31 @@ const Expression *expression_handle_to_expression(const Program *p, Expression_H
 void parser_init(Parser *p, Lexer *lx)
 {
   p->lexer = lx;
+  p->lazy_functions = false;
+  p->depth = 0;
   parser_next_token(p);
   parser_next_token(p);
 }
 
 Program parser_parse_program(Parser *p)
 {
+  // NOTE(HS): tokens are lexed as the parser asks for them, so lexing is timed as
+  // part of parsing
+  Phase_Scope phase = phase_begin("parse");
   Parser_Context ctx;
   parser_context_init(&ctx);
 
-  Program program = {0};
-  va_array_init(Tyger_Error, program.errors);
-  va_array_init(Statement, program.statements);
+  Program program = parser_program_new();
 
   while (p->cur_token.kind != TK_EOF)
   {
+    // NOTE(HS): stray semicolons (e.g. after a block) are empty statements
+    if (cur_token_is(p, TK_SEMICOLON))
+    {
+      parser_next_token(p);
+      continue;
+    }
+
     Statement stmt = {0};
     Tyger_Error err = parser_parse_statement(p, &ctx, &stmt);
 
@@ -362,14 +485,57 @@ Program parser_parse_program(Parser *p)
   }
 
   program.context = ctx;
+  phase_end(phase);
+  return program;
+}
+
+Program parser_parse_function(Parser *p)
+{
+  Phase_Scope phase = phase_begin("parse_function");
+  Parser_Context ctx;
+  parser_context_init(&ctx);
+  Program program = parser_program_new();
+
+  // NOTE(HS): the source carries on past the literal, which mustn't be parsed as the
+  // start of a larger expression
+  Location location = p->cur_token.location;
+  Expression expr;
+  Tyger_Error err = cur_token_is(p, TK_FUNC)
+    ? parse_func_expression(p, &ctx, &expr)
+    : parser_error(p, TYERR_SYNTAX);
+
+  if (err.kind != TYERR_NONE)
+  {
+    va_array_append(program.errors, err);
+  }
+  else
+  {
+    expr.location = location;
+    Expression_Handle handle = va_array_next_handle(ctx.expressions);
+    va_array_append(ctx.expressions, expr);
+
+    Statement stmt = {
+      .kind = STMT_EXPRESSION,
+      .location = location,
+      .statement.expression_statement = (Expression_Statement) {
+        .expression_handle = handle
+      }
+    };
+    va_array_append(program.statements, stmt);
+  }
+
+  program.context = ctx;
+  phase_end(phase);
   return program;
 }
 
 void program_free(Program *p)
 {
   { // free errors
-    // TODO(HS): when errors fleshed out a little more, compensate here (e.g. free
-    // any strings allocated for messages)
+    for (size_t i = 0; i < p->errors.len; ++i)
+    {
+      tyger_error_free(&(p->errors.elems[i]));
+    }
     va_array_free(p->errors);
   }
 
@@ -378,6 +544,10 @@ void program_free(Program *p)
     va_array_free(p->context.evaluated_identifiers);
     va_array_free(p->context.strings);
     va_array_free(p->context.expressions);
+    va_array_free(p->context.statements);
+    va_array_free(p->context.params);
+    va_array_free(p->context.upvalues);
+    va_array_free(p->context.arguments);
   }
 
   { // free statements
@@ -388,30 +558,66 @@ void program_free(Program *p)
 Tyger_Error parser_parse_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
 {
   Tyger_Error err = {0};
+  Location location = p->cur_token.location;
 
   switch (p->cur_token.kind)
   {
   case TK_VAR:
+  case TK_CONST:
   {
     err = parse_var_statement(p, ctx, stmt);
   } break;
 
+  case TK_RETURN:
+  {
+    err = parse_return_statement(p, ctx, stmt);
+  } break;
+
+  case TK_LBRACE:
+  {
+    err = parse_block_statement(p, ctx, stmt);
+  } break;
+
+  case TK_IF:
+  {
+    err = parse_if_statement(p, ctx, stmt);
+  } break;
+
+  case TK_WHILE:
+  {
+    err = parse_while_statement(p, ctx, stmt);
+  } break;
+
+  case TK_IDENT:
+  {
+    if (peek_token_is(p, TK_ASSIGN))
+    {
+      err = parse_assign_statement(p, ctx, stmt);
+    }
+    else
+    {
+      err = parse_expression_statement(p, ctx, stmt);
+    }
+  } break;
+
   default:
   {
     err = parse_expression_statement(p, ctx, stmt);
   } break;
   }
 
+  stmt->location = location;
   return err;
 }
 
 Tyger_Error parse_var_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
 {
   Tyger_Error err = {0};
+  bool is_const = cur_token_is(p, TK_CONST);
 
   if (!expect_peek(p, TK_IDENT))
   {
-    err.kind = TYERR_SYNTAX;
+    err = parser_error(p, TYERR_SYNTAX);
     return err;
   }
 
@@ -425,25 +631,31 @@ Tyger_Error parse_var_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
 
   if (!expect_peek(p, TK_ASSIGN))
   {
-    err.kind = TYERR_SYNTAX;
+    err = parser_error(p, TYERR_SYNTAX);
     return err;
   }
 
   if (expect_peek(p, TK_SEMICOLON))
   {
-    err.kind = TYERR_SYNTAX;
+    err = parser_error(p, TYERR_SYNTAX);
     return err;
   }
 
   parser_next_token(p);
 
-  Expression_Handle expression_handle = va_array_next_handle(ctx->expressions);
+  // NOTE(HS): handle must be taken after parsing, as sub-expressions of `expr` are
+  // appended to `ctx->expressions` first
   Expression expr;
   err = parse_expression(p, ctx, &expr, PRECIDENCE_LOWEST);
   if (err.kind != TYERR_NONE)
   {
     return err;
   }
+  if (expr.kind == EXPR_FUNC)
+  {
+    expr.expression.func_expression.name = ident_handle;
+  }
+  Expression_Handle expression_handle = va_array_next_handle(ctx->expressions);
   va_array_append(ctx->expressions, expr);
 
   if (peek_token_is(p, TK_SEMICOLON))
@@ -455,6 +667,7 @@ Tyger_Error parse_var_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
   stmt->statement.var_statement = (Var_Statement) {
     .ident_handle = ident_handle,
     .expression_handle = expression_handle,
+    .is_const = is_const,
   };
 
   return err;
@@ -486,23 +699,296 @@ Tyger_Error parse_expression_statement(Parser *p, Parser_Context *ctx, Statement
   return err;
 }
 
-// TODO(HS): handle overflow cases for INT64_MAX when parsing `- INT64_MIN`
-// NOTE(HS): this is probably something for eval time
-Tyger_Error parse_int_expression(Parser *p, Expression *expr)
+Tyger_Error parse_block_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
+{
+  // NOTE(HS): nested blocks append their own statements to `ctx->statements` whilst
+  // being parsed, so the statements of this block are collected separately and
+  // copied in afterwards to keep them contiguous.
+  Tyger_Error err = {0};
+
+  Statement_VaArray statements;
+  va_array_init(Statement, statements);
+
+  p->depth += 1;
+  parser_next_token(p);
+  while (!cur_token_is(p, TK_RBRACE))
+  {
+    if (cur_token_is(p, TK_EOF))
+    {
+      err = parser_error(p, TYERR_SYNTAX);
+      va_array_free(statements);
+      p->depth -= 1;
+      return err;
+    }
+
+    if (cur_token_is(p, TK_SEMICOLON))
+    {
+      parser_next_token(p);
+      continue;
+    }
+
+    Statement inner = {0};
+    err = parser_parse_statement(p, ctx, &inner);
+    if (err.kind != TYERR_NONE)
+    {
+      va_array_free(statements);
+      p->depth -= 1;
+      return err;
+    }
+    va_array_append(statements, inner);
+    parser_next_token(p);
+  }
+  p->depth -= 1;
+
+  Statement_Handle first = va_array_next_handle(ctx->statements);
+  va_array_append_n(ctx->statements, statements.elems, statements.len);
+
+  *stmt = (Statement) {
+    .kind = STMT_BLOCK,
+    .statement.block_statement = (Block_Statement) {
+      .first = first,
+      .len = statements.len,
+    }
+  };
+
+  va_array_free(statements);
+  return err;
+}
+
+Tyger_Error parse_assign_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
+{
+  Tyger_Error err = {0};
+
+  Ident_Handle ident_handle = va_array_next_handle(ctx->evaluated_identifiers);
+  va_array_append_n(ctx->evaluated_identifiers, p->cur_token.literal.str, p->cur_token.literal.len);
+  va_array_append_n(ctx->evaluated_identifiers, PARSER_NULL_TERMINATOR, 1);
+
+  if (!expect_peek(p, TK_ASSIGN))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    return err;
+  }
+  parser_next_token(p);
+
+  Expression expr;
+  err = parse_expression(p, ctx, &expr, PRECIDENCE_LOWEST);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+  Expression_Handle expression_handle = va_array_next_handle(ctx->expressions);
+  va_array_append(ctx->expressions, expr);
+
+  expect_peek(p, TK_SEMICOLON);
+
+  *stmt = (Statement) {
+    .kind = STMT_ASSIGN,
+    .statement.assign_statement = (Assign_Statement) {
+      .ident_handle = ident_handle,
+      .expression_handle = expression_handle,
+    }
+  };
+
+  return err;
+}
+
+/// parses `(condition) {`, leaving the parser on the opening brace of the body
+static Tyger_Error parse_condition(Parser *p, Parser_Context *ctx, Expression_Handle *handle)
 {
   Tyger_Error err = {0};
 
-  int64_t result = atoll(p->cur_token.literal.str);
-  if (result == 0 && !string_view_eq_str(p->cur_token.literal, "0"))
+  if (!expect_peek(p, TK_LPAREN))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    return err;
+  }
+  parser_next_token(p);
+
+  Expression condition;
+  err = parse_expression(p, ctx, &condition, PRECIDENCE_LOWEST);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+  *handle = va_array_next_handle(ctx->expressions);
+  va_array_append(ctx->expressions, condition);
+
+  if (!expect_peek(p, TK_RPAREN) || !expect_peek(p, TK_LBRACE))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    return err;
+  }
+
+  return err;
+}
+
+Tyger_Error parse_if_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
+{
+  Tyger_Error err = {0};
+
+  Expression_Handle condition;
+  err = parse_condition(p, ctx, &condition);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+
+  Statement consequence = {0};
+  Location consequence_location = p->cur_token.location;
+  err = parse_block_statement(p, ctx, &consequence);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+  consequence.location = consequence_location;
+
+  If_Statement is = {
+    .condition = condition,
+    .consequence = parser_context_append_statement(ctx, consequence),
+  };
+
+  if (peek_token_is(p, TK_ELSE))
+  {
+    parser_next_token(p);
+
+    Statement alternative = {0};
+    Location alternative_location = p->peek_token.location;
+    if (expect_peek(p, TK_IF))
+    {
+      err = parse_if_statement(p, ctx, &alternative);
+    }
+    else if (expect_peek(p, TK_LBRACE))
+    {
+      err = parse_block_statement(p, ctx, &alternative);
+    }
+    else
+    {
+      err = parser_error(p, TYERR_SYNTAX);
+    }
+
+    if (err.kind != TYERR_NONE)
+    {
+      return err;
+    }
+    alternative.location = alternative_location;
+
+    is.alternative = parser_context_append_statement(ctx, alternative);
+    is.has_alternative = true;
+  }
+
+  *stmt = (Statement) {
+    .kind = STMT_IF,
+    .statement.if_statement = is,
+  };
+
+  return err;
+}
+
+Tyger_Error parse_while_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
+{
+  Tyger_Error err = {0};
+
+  Expression_Handle condition;
+  err = parse_condition(p, ctx, &condition);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+
+  Statement body = {0};
+  Location body_location = p->cur_token.location;
+  err = parse_block_statement(p, ctx, &body);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+  body.location = body_location;
+
+  *stmt = (Statement) {
+    .kind = STMT_WHILE,
+    .statement.while_statement = (While_Statement) {
+      .condition = condition,
+      .body = parser_context_append_statement(ctx, body),
+    }
+  };
+
+  return err;
+}
+
+Tyger_Error parse_return_statement(Parser *p, Parser_Context *ctx, Statement *stmt)
+{
+  Tyger_Error err = {0};
+
+  Return_Statement rs = {0};
+  if (!peek_token_is(p, TK_SEMICOLON) && !peek_token_is(p, TK_RBRACE))
+  {
+    parser_next_token(p);
+
+    Expression expr;
+    err = parse_expression(p, ctx, &expr, PRECIDENCE_LOWEST);
+    if (err.kind != TYERR_NONE)
+    {
+      return err;
+    }
+    rs.expression_handle = va_array_next_handle(ctx->expressions);
+    rs.has_value = true;
+    va_array_append(ctx->expressions, expr);
+  }
+
+  expect_peek(p, TK_SEMICOLON);
+
+  *stmt = (Statement) {
+    .kind = STMT_RETURN,
+    .statement.return_statement = rs,
+  };
+
+  return err;
+}
+
+// NOTE(HS): literals are never negative, `-9223372036854775808` negates a bigint
+// literal at runtime which comes back as an int
+Tyger_Error parse_int_expression(Parser *p, Parser_Context *ctx, Expression *expr)
+{
+  Tyger_Error err = {0};
+  String_View literal = p->cur_token.literal;
+
+  if (literal.len == 0)
   {
     err.kind = TYERR_INVALID_INTEGER;
     return err;
   }
 
+  int64_t result = 0;
+  bool is_big = false;
+  for (size_t i = 0; i < literal.len; ++i)
+  {
+    char c = literal.str[i];
+    if (c < '0' || c > '9')
+    {
+      err.kind = TYERR_INVALID_INTEGER;
+      return err;
+    }
+    if (!is_big && (int_mul_overflow(result, 10, &result) || int_add_overflow(result, c - '0', &result)))
+    {
+      is_big = true;
+    }
+  }
+
+  String_Handle digits_handle = 0;
+  if (is_big)
+  {
+    result = 0;
+    digits_handle = va_array_next_handle(ctx->strings);
+    va_array_append_n(ctx->strings, literal.str, literal.len);
+    va_array_append_n(ctx->strings, PARSER_NULL_TERMINATOR, 1);
+  }
+
   *expr = (Expression) {
     .kind = EXPR_INT,
     .expression.int_expression = (Int_Expression) {
       .value = result,
+      .is_big = is_big,
+      .digits_handle = digits_handle,
     }
   };
 
@@ -539,6 +1025,7 @@ Tyger_Error parse_ident_expression(Parser *p, Parser_Context *ctx, Expression *e
 
   *expr = (Expression) {
     .kind = EXPR_IDENT,
+    .location = p->cur_token.location,
     .expression.ident_expression = (Ident_Expression) {
       .ident_handle = handle
     }
@@ -547,6 +1034,67 @@ Tyger_Error parse_ident_expression(Parser *p, Parser_Context *ctx, Expression *e
   return err;
 }
 
+Tyger_Error parse_bool_expression(Parser *p, Expression *expr)
+{
+  Tyger_Error err = {0};
+
+  *expr = (Expression) {
+    .kind = EXPR_BOOL,
+    .expression.bool_expression = (Bool_Expression) {
+      .value = cur_token_is(p, TK_TRUE),
+    }
+  };
+
+  return err;
+}
+
+Tyger_Error parse_grouped_expression(Parser *p, Parser_Context *ctx, Expression *expr)
+{
+  Tyger_Error err = {0};
+
+  parser_next_token(p);
+  err = parse_expression(p, ctx, expr, PRECIDENCE_LOWEST);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+
+  if (!expect_peek(p, TK_RPAREN))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    return err;
+  }
+
+  return err;
+}
+
+Tyger_Error parse_prefix_expression(Parser *p, Parser_Context *ctx, Expression *expr)
+{
+  Tyger_Error err = {0};
+
+  Operator op = token_kind_to_operator(p->cur_token.kind);
+  parser_next_token(p);
+
+  Expression rhs;
+  err = parse_expression(p, ctx, &rhs, PRECIDENCE_PREFIX);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+  Expression_Handle rhs_handle = va_array_next_handle(ctx->expressions);
+  va_array_append(ctx->expressions, rhs);
+
+  *expr = (Expression) {
+    .kind = EXPR_PREFIX,
+    .expression.prefix_expression = (Prefix_Expression) {
+      .op = op,
+      .rhs = rhs_handle,
+    }
+  };
+
+  return err;
+}
+
 Tyger_Error parse_infix_expression(Parser *p, Parser_Context *ctx, Expression *expr)
 {
   // NOTE(HS): Code does the following steps
@@ -569,6 +1117,7 @@ Tyger_Error parse_infix_expression(Parser *p, Parser_Context *ctx, Expression *e
   //
   Tyger_Error err = {0};
 
+  Location location = p->cur_token.location;
   int precidence = precidence_of(p->cur_token.kind);
   Operator op = token_kind_to_operator(p->cur_token.kind);
   parser_next_token(p);
@@ -587,6 +1136,7 @@ Tyger_Error parse_infix_expression(Parser *p, Parser_Context *ctx, Expression *e
 
   *expr = (Expression) {
     .kind = EXPR_INFIX,
+    .location = location,
     .expression.infix_expression = (Infix_Expression) {
       .op = op,
       .lhs = lhs_handle,
@@ -597,49 +1147,159 @@ Tyger_Error parse_infix_expression(Parser *p, Parser_Context *ctx, Expression *e
   return err;
 }
 
-// TODO(HS): function literal support in call expressions
-Tyger_Error parse_call_expression(Parser *p, Parser_Context *ctx, Expression *expr)
+Tyger_Error parse_func_expression(Parser *p, Parser_Context *ctx, Expression *expr)
 {
+  // NOTE(HS): parameters of nested function literals are appended to `ctx->params`
+  // whilst parsing the body, so they're collected first to keep them contiguous
   Tyger_Error err = {0};
+  size_t pos = p->cur_token.location.pos;
+
+  if (!expect_peek(p, TK_LPAREN))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    return err;
+  }
+
+  Ident_Handle_VaArray params;
+  va_array_init(Ident_Handle, params);
 
-  Expression function;
-  err = parse_ident_expression(p, ctx, &function);
+  if (!expect_peek(p, TK_RPAREN))
+  {
+    do
+    {
+      if (!expect_peek(p, TK_IDENT))
+      {
+        err = parser_error(p, TYERR_SYNTAX);
+        va_array_free(params);
+        return err;
+      }
+
+      Ident_Handle handle = va_array_next_handle(ctx->identifiers);
+      va_array_append_n(ctx->identifiers, p->cur_token.literal.str, p->cur_token.literal.len);
+      va_array_append_n(ctx->identifiers, PARSER_NULL_TERMINATOR, 1);
+      va_array_append(params, handle);
+    } while (expect_peek(p, TK_COMMA));
+
+    if (!expect_peek(p, TK_RPAREN))
+    {
+      err = parser_error(p, TYERR_SYNTAX);
+      va_array_free(params);
+      return err;
+    }
+  }
+
+  if (!expect_peek(p, TK_LBRACE))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    va_array_free(params);
+    return err;
+  }
+
+  // NOTE(HS): a lazy body is left as an empty block
+  Statement body = {
+    .kind = STMT_BLOCK,
+    .statement.block_statement = (Block_Statement) { .first = 0, .len = 0, .captures = false },
+  };
+  Location body_location = p->cur_token.location;
+  bool lazy = p->lazy_functions && p->depth == 0;
+  err = lazy ? parser_skip_block(p) : parse_block_statement(p, ctx, &body);
   if (err.kind != TYERR_NONE)
   {
+    va_array_free(params);
     return err;
   }
+  body.location = body_location;
 
-  Expression_Handle function_handle = va_array_next_handle(ctx->expressions);
-  va_array_append(ctx->expressions, function);
+  size_t params_first = ctx->params.len;
+  va_array_append_n(ctx->params, params.elems, params.len);
 
-  if (!expect_peek(p, TK_LPAREN))
+  *expr = (Expression) {
+    .kind = EXPR_FUNC,
+    .expression.func_expression = (Func_Expression) {
+      .params_first = params_first,
+      .params_len = params.len,
+      .body = parser_context_append_statement(ctx, body),
+      .name = FUNC_ANONYMOUS,
+      .memo = false,
+      .lazy = lazy,
+      .pos = pos,
+    }
+  };
+
+  va_array_free(params);
+  return err;
+}
+
+/// `@memo func(...) { ... }`, the only annotation so far
+Tyger_Error parse_annotated_expression(Parser *p, Parser_Context *ctx, Expression *expr)
+{
+  Tyger_Error err = {0};
+
+  if (!expect_peek(p, TK_IDENT) || !string_view_eq_str(p->cur_token.literal, "memo"))
+  {
+    err = parser_error(p, TYERR_SYNTAX);
+    return err;
+  }
+  if (!expect_peek(p, TK_FUNC))
   {
-    err.kind = TYERR_SYNTAX;
+    err = parser_error(p, TYERR_SYNTAX);
     return err;
   }
 
-  Argument_List args;
-  va_array_init(Expression, args);
-  err = parse_call_expression_args(p, ctx, &args);
+  // NOTE(HS): `@memo` functions are checked for purity as soon as they're resolved,
+  // which needs their bodies
+  bool lazy_functions = p->lazy_functions;
+  p->lazy_functions = false;
+  err = parse_func_expression(p, ctx, expr);
+  p->lazy_functions = lazy_functions;
+  if (err.kind == TYERR_NONE)
+  {
+    expr->expression.func_expression.memo = true;
+  }
+  return err;
+}
+
+/// parses the arguments of a call, `expr` is the callee and the current token the
+/// opening paren
+Tyger_Error parse_call_expression(Parser *p, Parser_Context *ctx, Expression *expr)
+{
+  Tyger_Error err = {0};
+
+  Location location = expr->location;
+  Expression_Handle function_handle = va_array_next_handle(ctx->expressions);
+  va_array_append(ctx->expressions, *expr);
+
+  // NOTE(HS): arguments may themselves contain calls, so they're collected on
+  // `ctx->arguments` (without allocating once it has grown) and then copied in
+  // together to keep them contiguous
+  size_t mark = ctx->arguments.len;
+  err = parse_call_expression_args(p, ctx);
   if (err.kind != TYERR_NONE)
   {
+    ctx->arguments.len = mark;
     return err;
   }
 
+  size_t args_len = ctx->arguments.len - mark;
+  Expression_Handle args_first = va_array_next_handle(ctx->expressions);
+  va_array_append_n(ctx->expressions, ctx->arguments.elems + mark, args_len);
+  ctx->arguments.len = mark;
+
   *expr = (Expression) {
     .kind = EXPR_CALL,
+    .location = location,
     .expression.call_expression = (Call_Expression) {
       .function = function_handle,
-      .args = args,
+      .args_first = args_first,
+      .args_len = args_len,
     }
   };
 
   return err;
 }
 
-// TODO(HS): may need to embed `Parser_Context` into the `Argument_List` struct
-// and then pass this into `parse_expression`
-Tyger_Error parse_call_expression_args(Parser *p, Parser_Context *ctx, Argument_List *args)
+/// pushes the arguments of a call onto `ctx->arguments`
+Tyger_Error parse_call_expression_args(Parser *p, Parser_Context *ctx)
 {
   Tyger_Error err = {0};
 
@@ -652,7 +1312,11 @@ Tyger_Error parse_call_expression_args(Parser *p, Parser_Context *ctx, Argument_
 
   Expression first_arg;
   err = parse_expression(p, ctx, &first_arg, PRECIDENCE_LOWEST);
-  va_array_append(*args, first_arg);
+  if (err.kind != TYERR_NONE)
+  {
+    return err;
+  }
+  va_array_append(ctx->arguments, first_arg);
 
   while (peek_token_is(p, TK_COMMA))
   {
@@ -666,12 +1330,12 @@ Tyger_Error parse_call_expression_args(Parser *p, Parser_Context *ctx, Argument_
       return err;
     }
 
-    va_array_append(*args, next_arg);
+    va_array_append(ctx->arguments, next_arg);
   }
 
   if (!expect_peek(p, TK_RPAREN))
   {
-    err.kind = TYERR_SYNTAX;
+    err = parser_error(p, TYERR_SYNTAX);
     return err;
   }
  
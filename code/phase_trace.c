@@ -0,0 +1,138 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_PROFILER
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "phase_trace.h"
+#include "tmemory.h"
+
+PHASE_THREAD_LOCAL Phase_Trace *phase_trace_current = NULL;
+
+// NOTE(HS): a thread keeps its trace when it stops recording, the generation tells
+// it whether that trace has since been freed by `phase_trace_free`
+static PHASE_THREAD_LOCAL Phase_Trace *thread_trace = NULL;
+static PHASE_THREAD_LOCAL uint64_t thread_generation = 0;
+
+static pthread_mutex_t traces_lock = PTHREAD_MUTEX_INITIALIZER;
+static Phase_Trace *traces = NULL;
+static uint32_t traces_len = 0;
+static uint64_t generation = 1;
+
+///
+/// internal functions
+///
+
+/// the calling thread's trace, allocated and added to `traces` the first time
+static Phase_Trace *phase_trace_thread(void)
+{
+  pthread_mutex_lock(&traces_lock);
+  if (!thread_trace || thread_generation != generation)
+  {
+    Phase_Trace *trace = tcalloc(1, sizeof(Phase_Trace));
+    assert(trace);
+    trace->tid = ++traces_len;
+    trace->next = traces;
+    traces = trace;
+
+    thread_trace = trace;
+    thread_generation = generation;
+  }
+  pthread_mutex_unlock(&traces_lock);
+  return thread_trace;
+}
+
+static void phase_write_event(FILE *f, const Phase_Trace *trace, const Phase_Event *event)
+{
+  // NOTE(HS): timestamps and durations are in microseconds, names are literals which
+  // never need escaping
+  fprintf(
+    f, ",\n{\"name\":\"%s\",\"cat\":\"tyger\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+    "\"pid\":%ld,\"tid\":%u}",
+    event->name, (double) event->start_ns / 1000.0, (double) event->duration_ns / 1000.0,
+    (long) getpid(), (unsigned) trace->tid
+  );
+}
+
+
+///
+/// public functions
+///
+
+void phase_trace_start(void)
+{
+  phase_trace_current = phase_trace_thread();
+}
+
+void phase_trace_stop(void)
+{
+  phase_trace_current = NULL;
+}
+
+void phase_trace_write(FILE *f)
+{
+  pthread_mutex_lock(&traces_lock);
+
+  uint64_t dropped = 0;
+  fprintf(
+    f, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,"
+    "\"args\":{\"name\":\"tyger\"}}",
+    (long) getpid()
+  );
+  for (const Phase_Trace *trace = traces; trace; trace = trace->next)
+  {
+    // NOTE(HS): once the ring has wrapped the oldest event is the one due to be
+    // overwritten next
+    uint64_t first = 0;
+    if (trace->recorded > PHASE_TRACE_CAPACITY)
+    {
+      first = trace->recorded - PHASE_TRACE_CAPACITY;
+      dropped += first;
+    }
+    for (uint64_t i = first; i < trace->recorded; ++i)
+    {
+      phase_write_event(f, trace, &trace->events[i % PHASE_TRACE_CAPACITY]);
+    }
+  }
+  fprintf(
+    f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu}}\n",
+    (unsigned long long) dropped
+  );
+
+  pthread_mutex_unlock(&traces_lock);
+}
+
+void phase_trace_free(void)
+{
+  pthread_mutex_lock(&traces_lock);
+  Phase_Trace *trace = traces;
+  while (trace)
+  {
+    Phase_Trace *next = trace->next;
+    tfree(trace);
+    trace = next;
+  }
+  traces = NULL;
+  traces_len = 0;
+  generation += 1;
+  pthread_mutex_unlock(&traces_lock);
+
+  phase_trace_current = NULL;
+  thread_trace = NULL;
+}
+
+uint64_t phase_trace_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+void phase_trace_record(Phase_Trace *trace, const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+  Phase_Event *event = &trace->events[trace->recorded % PHASE_TRACE_CAPACITY];
+  event->name = name;
+  event->start_ns = start_ns;
+  event->duration_ns = end_ns - start_ns;
+  trace->recorded += 1;
+}
@@ -0,0 +1,486 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RESOLVER
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "purity.h"
+#include "builtin.h"
+#include "tstrings.h"
+#include "util.h"
+
+typedef enum purity_state
+{
+  PURITY_UNKNOWN,
+  PURITY_CHECKING,
+  PURITY_PURE,
+  PURITY_IMPURE,
+} Purity_State;
+
+typedef struct purity_function
+{
+  const Func_Expression *fexpr;
+  Purity_State state;
+  char *reason;
+} Purity_Function;
+
+typedef struct purity_function_vaarray
+{
+  Purity_Function *elems;
+  size_t capacity;
+  size_t len;
+} Purity_Function_VaArray;
+
+/// what the program does with a global, `init` is NULL unless it was declared here
+typedef struct purity_global
+{
+  const Expression *init;
+  bool assigned;
+} Purity_Global;
+
+typedef struct purity_global_vaarray
+{
+  Purity_Global *elems;
+  size_t capacity;
+  size_t len;
+} Purity_Global_VaArray;
+
+/// NOTE(HS): functions are assumed pure whilst they're being checked, so recursion
+/// (direct or mutual) doesn't make a function impure. Whether they are then depends
+/// on the function the check started from, so they stay `PURITY_CHECKING` until it
+/// finishes. Impurity never depends on an assumption and is kept straight away.
+typedef struct purity
+{
+  const Program *prog;
+  Purity_Global_VaArray globals;
+  Purity_Function_VaArray functions;
+} Purity;
+
+static bool purity_check_function(Purity *pu, const Func_Expression *fexpr, char **reason);
+static bool purity_check_expression(Purity *pu, const Expression *expr, char **reason);
+
+///
+/// internal functions
+///
+
+static char *purity_reason(const char *fmt, const char *ident)
+{
+  String_Builder sb;
+  string_builder_init(&sb);
+  string_builder_append_fmt(&sb, fmt, ident);
+  char *reason = (char*) string_builder_to_cstring(&sb);
+  string_builder_free(&sb);
+  return reason;
+}
+
+static Purity_Global *purity_global(Purity *pu, size_t slot)
+{
+  while (pu->globals.len <= slot)
+  {
+    Purity_Global global = { .init = NULL, .assigned = false };
+    va_array_append(pu->globals, global);
+  }
+  return &pu->globals.elems[slot];
+}
+
+static void purity_record_statement(Purity *pu, const Statement *stmt, bool top_level)
+{
+  if (stmt->kind == STMT_VAR && top_level)
+  {
+    const Var_Statement *vs = &stmt->statement.var_statement;
+    if (vs->binding.kind == BINDING_GLOBAL)
+    {
+      purity_global(pu, vs->binding.slot)->init =
+        expression_handle_to_expression(pu->prog, vs->expression_handle);
+    }
+  }
+  else if (stmt->kind == STMT_ASSIGN)
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    if (as->binding.kind == BINDING_GLOBAL)
+    {
+      purity_global(pu, as->binding.slot)->assigned = true;
+    }
+  }
+}
+
+static void purity_init(Purity *pu, const Program *prog)
+{
+  pu->prog = prog;
+  va_array_init(Purity_Global, pu->globals);
+  va_array_init(Purity_Function, pu->functions);
+
+  // NOTE(HS): every statement, however deeply nested, is in one of the two arrays
+  for (size_t i = 0; i < prog->statements.len; ++i)
+  {
+    purity_record_statement(pu, &prog->statements.elems[i], true);
+  }
+  for (size_t i = 0; i < prog->context.statements.len; ++i)
+  {
+    purity_record_statement(pu, &prog->context.statements.elems[i], false);
+  }
+}
+
+static void purity_free(Purity *pu)
+{
+  for (size_t i = 0; i < pu->functions.len; ++i)
+  {
+    tfree(pu->functions.elems[i].reason);
+  }
+  va_array_free(pu->functions);
+  va_array_free(pu->globals);
+}
+
+static Purity_Function *purity_function(Purity *pu, const Func_Expression *fexpr)
+{
+  for (size_t i = 0; i < pu->functions.len; ++i)
+  {
+    if (pu->functions.elems[i].fexpr == fexpr)
+    {
+      return &pu->functions.elems[i];
+    }
+  }
+  Purity_Function function = { .fexpr = fexpr, .state = PURITY_UNKNOWN, .reason = NULL };
+  va_array_append(pu->functions, function);
+  return &pu->functions.elems[pu->functions.len - 1];
+}
+
+/// the global a pure function reads must hold the same value whenever it's called
+static bool purity_check_global(Purity *pu, const Ident_Expression *iexpr, char **reason)
+{
+  const char *name = ident_handle_to_evaluated_ident(pu->prog, iexpr->ident_handle);
+  if (iexpr->binding.declaration == BINDING_NO_DECLARATION)
+  {
+    *reason = purity_reason("reads the global `%s` declared by an earlier program", name);
+    return false;
+  }
+  if (purity_global(pu, iexpr->binding.slot)->assigned)
+  {
+    *reason = purity_reason("reads the global `%s`, which is reassigned", name);
+    return false;
+  }
+  return true;
+}
+
+static bool purity_check_call(Purity *pu, const Call_Expression *cexpr, char **reason)
+{
+  const Expression *callee = expression_handle_to_expression(pu->prog, cexpr->function);
+  if (callee->kind != EXPR_IDENT)
+  {
+    *reason = purity_reason("%s", "calls a function which isn't known to be pure");
+    return false;
+  }
+
+  const Ident_Expression *iexpr = &callee->expression.ident_expression;
+  const char *name = ident_handle_to_evaluated_ident(pu->prog, iexpr->ident_handle);
+  switch (iexpr->binding.kind)
+  {
+  case BINDING_BUILTIN:
+  {
+    if (!BUILTINS[iexpr->binding.slot].pure)
+    {
+      *reason = purity_reason("calls the builtin `%s`, which has side effects", name);
+      return false;
+    }
+  } break;
+
+  case BINDING_GLOBAL:
+  {
+    if (!purity_check_global(pu, iexpr, reason))
+    {
+      return false;
+    }
+    const Expression *init = purity_global(pu, iexpr->binding.slot)->init;
+    if (!init || init->kind != EXPR_FUNC)
+    {
+      *reason = purity_reason("calls `%s`, which isn't a function literal", name);
+      return false;
+    }
+
+    char *inner = NULL;
+    if (!purity_check_function(pu, &init->expression.func_expression, &inner))
+    {
+      String_Builder sb;
+      string_builder_init(&sb);
+      string_builder_append_fmt(&sb, "calls `%s`, which %s", name, inner);
+      *reason = (char*) string_builder_to_cstring(&sb);
+      string_builder_free(&sb);
+      tfree(inner);
+      return false;
+    }
+  } break;
+
+  default:
+  {
+    *reason = purity_reason("calls `%s`, which isn't known to be pure", name);
+    return false;
+  } break;
+  }
+
+  for (size_t i = 0; i < cexpr->args_len; ++i)
+  {
+    const Expression *arg = expression_handle_to_expression(pu->prog, cexpr->args_first + i);
+    if (!purity_check_expression(pu, arg, reason))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool purity_check_expression(Purity *pu, const Expression *expr, char **reason)
+{
+  bool pure = true;
+  switch (expr->kind)
+  {
+  case EXPR_INT:
+  case EXPR_STRING:
+  case EXPR_BOOL:
+  case EXPR_FUNC:
+  {
+    // NOTE(HS): making a closure runs none of its body
+  } break;
+
+  case EXPR_IDENT:
+  {
+    const Ident_Expression *iexpr = &expr->expression.ident_expression;
+    if (iexpr->binding.kind == BINDING_GLOBAL)
+    {
+      pure = purity_check_global(pu, iexpr, reason);
+    }
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+    pure = purity_check_expression(pu, expression_handle_to_expression(pu->prog, pexpr->rhs), reason);
+  } break;
+
+  case EXPR_INFIX:
+  {
+    const Infix_Expression *iexpr = &expr->expression.infix_expression;
+    pure =
+      purity_check_expression(pu, expression_handle_to_expression(pu->prog, iexpr->lhs), reason) &&
+      purity_check_expression(pu, expression_handle_to_expression(pu->prog, iexpr->rhs), reason);
+  } break;
+
+  case EXPR_CALL:
+  {
+    pure = purity_check_call(pu, &expr->expression.call_expression, reason);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Expression_Kind %s (%i)\n",
+      expression_kind_to_string(expr->kind), expr->kind
+    );
+    assert(0);
+  } break;
+  }
+  return pure;
+}
+
+static bool purity_check_statement(Purity *pu, const Statement *stmt, char **reason)
+{
+  const Program *prog = pu->prog;
+  bool pure = true;
+  switch (stmt->kind)
+  {
+  case STMT_VAR:
+  {
+    const Var_Statement *vs = &stmt->statement.var_statement;
+    pure = purity_check_expression(pu, expression_handle_to_expression(prog, vs->expression_handle), reason);
+  } break;
+
+  case STMT_EXPRESSION:
+  {
+    const Expression_Statement *es = &stmt->statement.expression_statement;
+    pure = purity_check_expression(pu, expression_handle_to_expression(prog, es->expression_handle), reason);
+  } break;
+
+  case STMT_BLOCK:
+  {
+    const Block_Statement *bs = &stmt->statement.block_statement;
+    for (size_t i = 0; i < bs->len && pure; ++i)
+    {
+      pure = purity_check_statement(pu, statement_handle_to_statement(prog, bs->first + i), reason);
+    }
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    if (as->binding.kind == BINDING_GLOBAL)
+    {
+      *reason = purity_reason("assigns the global `%s`", ident_handle_to_evaluated_ident(prog, as->ident_handle));
+      pure = false;
+    }
+    else
+    {
+      pure = purity_check_expression(pu, expression_handle_to_expression(prog, as->expression_handle), reason);
+    }
+  } break;
+
+  case STMT_IF:
+  {
+    const If_Statement *is = &stmt->statement.if_statement;
+    pure =
+      purity_check_expression(pu, expression_handle_to_expression(prog, is->condition), reason) &&
+      purity_check_statement(pu, statement_handle_to_statement(prog, is->consequence), reason) &&
+      (!is->has_alternative ||
+       purity_check_statement(pu, statement_handle_to_statement(prog, is->alternative), reason));
+  } break;
+
+  case STMT_WHILE:
+  {
+    const While_Statement *ws = &stmt->statement.while_statement;
+    pure =
+      purity_check_expression(pu, expression_handle_to_expression(prog, ws->condition), reason) &&
+      purity_check_statement(pu, statement_handle_to_statement(prog, ws->body), reason);
+  } break;
+
+  case STMT_RETURN:
+  {
+    const Return_Statement *rs = &stmt->statement.return_statement;
+    if (rs->has_value)
+    {
+      pure = purity_check_expression(pu, expression_handle_to_expression(prog, rs->expression_handle), reason);
+    }
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Statement_Kind %s (%i)\n",
+      statement_kind_to_string(stmt->kind), stmt->kind
+    );
+    assert(0);
+  } break;
+  }
+  return pure;
+}
+
+static bool purity_check_function(Purity *pu, const Func_Expression *fexpr, char **reason)
+{
+  Purity_Function *function = purity_function(pu, fexpr);
+  switch (function->state)
+  {
+  case PURITY_PURE:
+  case PURITY_CHECKING:
+  {
+    return true;
+  } break;
+
+  case PURITY_IMPURE:
+  {
+    *reason = purity_reason("%s", function->reason);
+    return false;
+  } break;
+
+  case PURITY_UNKNOWN:
+  {
+  } break;
+  }
+
+  function->state = PURITY_CHECKING;
+
+  // NOTE(HS): a captured variable may differ between closures of the same function,
+  // or change between calls, so capturing anything at all rules a function out
+  bool pure = true;
+  if (fexpr->upvalues_len > 0)
+  {
+    *reason = purity_reason("%s", "captures variables from an enclosing function");
+    pure = false;
+  }
+  else if (fexpr->lazy)
+  {
+    *reason = purity_reason("%s", "was only pre-parsed, so its body can't be checked");
+    pure = false;
+  }
+  else
+  {
+    pure = purity_check_statement(pu, statement_handle_to_statement(pu->prog, fexpr->body), reason);
+  }
+
+  // NOTE(HS): `functions` may have grown whilst checking the body
+  function = purity_function(pu, fexpr);
+  if (!pure)
+  {
+    function->state = PURITY_IMPURE;
+    function->reason = purity_reason("%s", *reason);
+  }
+  return pure;
+}
+
+/// checks `fexpr`, settling every function which was assumed pure along the way
+static bool purity_check_root(Purity *pu, const Func_Expression *fexpr, char **reason)
+{
+  bool pure = purity_check_function(pu, fexpr, reason);
+  for (size_t i = 0; i < pu->functions.len; ++i)
+  {
+    Purity_Function *function = &pu->functions.elems[i];
+    if (function->state == PURITY_CHECKING)
+    {
+      function->state = pure ? PURITY_PURE : PURITY_UNKNOWN;
+    }
+  }
+  return pure;
+}
+
+
+///
+/// public functions
+///
+
+void purity_check_program(Program *prog)
+{
+  Purity pu;
+  purity_init(&pu, prog);
+
+  for (size_t i = 0; i < prog->context.expressions.len; ++i)
+  {
+    const Expression *expr = &prog->context.expressions.elems[i];
+    if (expr->kind != EXPR_FUNC || !expr->expression.func_expression.memo)
+    {
+      continue;
+    }
+
+    char *reason = NULL;
+    if (!purity_check_root(&pu, &expr->expression.func_expression, &reason))
+    {
+      String_Builder sb;
+      string_builder_init(&sb);
+      string_builder_append_fmt(&sb, "`@memo` function is not pure, it %s", reason);
+      Tyger_Error err = {
+        .kind = TYERR_IMPURE_FUNCTION,
+        .location = expr->location,
+        .message = string_builder_to_cstring(&sb),
+      };
+      string_builder_free(&sb);
+      tfree(reason);
+      va_array_append(prog->errors, err);
+    }
+  }
+
+  purity_free(&pu);
+}
+
+bool purity_is_pure(const Program *prog, const Func_Expression *fexpr, char **reason)
+{
+  Purity pu;
+  purity_init(&pu, prog);
+
+  char *why = NULL;
+  bool pure = purity_check_root(&pu, fexpr, &why);
+  if (reason)
+  {
+    *reason = why;
+  }
+  else
+  {
+    tfree(why);
+  }
+
+  purity_free(&pu);
+  return pure;
+}
@@ -0,0 +1,667 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RESOLVER
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resolver.h"
+#include "builtin.h"
+#include "phase_trace.h"
+#include "purity.h"
+#include "tstrings.h"
+#include "util.h"
+#include "value.h"
+
+static void resolve_statement(Resolver *r, Program *prog, Statement *stmt);
+static void resolve_expression(Resolver *r, Program *prog, Expression *expr);
+
+///
+/// internal functions
+///
+
+static inline Expression *resolver_expression(Program *prog, Expression_Handle hndl)
+{
+  assert(hndl < prog->context.expressions.len);
+  return &(prog->context.expressions.elems[hndl]);
+}
+
+static inline Statement *resolver_statement(Program *prog, Statement_Handle hndl)
+{
+  assert(hndl < prog->context.statements.len);
+  return &(prog->context.statements.elems[hndl]);
+}
+
+static void resolver_error(
+  Program *prog, Tyger_Error_Kind kind, Location location, const char *fmt, const char *ident
+)
+{
+  String_Builder sb;
+  string_builder_init(&sb);
+  string_builder_append_fmt(&sb, fmt, ident);
+
+  Tyger_Error err = {
+    .kind = kind,
+    .location = location,
+    .message = string_builder_to_cstring(&sb),
+  };
+  string_builder_free(&sb);
+
+  va_array_append(prog->errors, err);
+}
+
+static bool resolver_find_global(const Resolver *r, const char *name, size_t *slot)
+{
+  if (r->global_index_capacity == 0)
+  {
+    return false;
+  }
+
+  size_t mask = r->global_index_capacity - 1;
+  uint32_t hash = string_hash(name, strlen(name));
+  for (size_t i = hash & mask; r->global_index[i] != 0; i = (i + 1) & mask)
+  {
+    const Resolver_Global *global = &r->globals.elems[r->global_index[i] - 1];
+    if (global->hash == hash && strcmp(global->name, name) == 0)
+    {
+      *slot = r->global_index[i] - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// rebuilds `global_index` from `globals`, with room for at least `len` of them
+static void resolver_reindex_globals(Resolver *r, size_t len)
+{
+  size_t capacity = 64;
+  while (len * 4 > capacity * 3)
+  {
+    capacity *= 2;
+  }
+
+  tfree(r->global_index);
+  r->global_index = tcalloc(capacity, sizeof(size_t));
+  assert(r->global_index);
+  r->global_index_capacity = capacity;
+
+  for (size_t slot = 0; slot < r->globals.len; ++slot)
+  {
+    size_t i = r->globals.elems[slot].hash & (capacity - 1);
+    while (r->global_index[i] != 0)
+    {
+      i = (i + 1) & (capacity - 1);
+    }
+    r->global_index[i] = slot + 1;
+  }
+}
+
+static size_t resolver_declare_global(
+  Resolver *r, const char *name, Ident_Handle declaration, bool is_const
+)
+{
+  size_t slot;
+  if (!resolver_find_global(r, name, &slot))
+  {
+    size_t len = strlen(name);
+    Resolver_Global global = {
+      .name = tmalloc(len + 1),
+      .hash = string_hash(name, len),
+      .declaration = declaration,
+    };
+    memcpy(global.name, name, len + 1);
+
+    slot = va_array_next_handle(r->globals);
+    va_array_append(r->globals, global);
+
+    // NOTE(HS): the index is rebuilt as a whole whenever it's three quarters full
+    if ((r->globals.len + 1) * 4 > r->global_index_capacity * 3)
+    {
+      resolver_reindex_globals(r, r->globals.len * 2);
+    }
+    else
+    {
+      size_t mask = r->global_index_capacity - 1;
+      size_t i = global.hash & mask;
+      while (r->global_index[i] != 0)
+      {
+        i = (i + 1) & mask;
+      }
+      r->global_index[i] = slot + 1;
+    }
+  }
+  r->globals.elems[slot].declaration = declaration;
+  r->globals.elems[slot].is_const = is_const;
+  return slot;
+}
+
+static bool resolver_find_local(const Resolver *r, const char *name, size_t *slot)
+{
+  for (size_t i = r->locals.len; i > 0; --i)
+  {
+    if (strcmp(r->locals.elems[i - 1].name, name) == 0)
+    {
+      *slot = i - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void resolver_begin_scope(Resolver *r)
+{
+  r->scope_depth += 1;
+}
+
+/// returns whether any of the scope's locals were captured
+static bool resolver_end_scope(Resolver *r)
+{
+  assert(r->scope_depth > 0);
+  r->scope_depth -= 1;
+
+  bool captured = false;
+  while (r->locals.len > 0 && r->locals.elems[r->locals.len - 1].scope_depth > r->scope_depth)
+  {
+    captured = captured || r->locals.elems[r->locals.len - 1].captured;
+    r->locals.len -= 1;
+  }
+  return captured;
+}
+
+/// adds an upvalue to the function at `function_depth` unless it already has it,
+/// returning its index
+static size_t resolver_add_upvalue(Resolver *r, size_t function_depth, bool is_local, size_t index)
+{
+  assert(function_depth > 0 && function_depth <= r->functions.len);
+  Func_Upvalue_VaArray *upvalues = &r->functions.elems[function_depth - 1].upvalues;
+  for (size_t i = 0; i < upvalues->len; ++i)
+  {
+    if (upvalues->elems[i].is_local == is_local && upvalues->elems[i].index == index)
+    {
+      return i;
+    }
+  }
+
+  Func_Upvalue upvalue = { .is_local = is_local, .index = index };
+  va_array_append(*upvalues, upvalue);
+  return upvalues->len - 1;
+}
+
+/// captures `locals[local_index]` from the current function, threading it through
+/// every function in between, and returns the current function's upvalue index
+static size_t resolver_capture(Resolver *r, size_t local_index)
+{
+  Resolver_Local *local = &r->locals.elems[local_index];
+  local->captured = true;
+
+  bool is_local = true;
+  size_t index = local->slot;
+  for (size_t depth = local->function_depth + 1; depth <= r->function_depth; ++depth)
+  {
+    index = resolver_add_upvalue(r, depth, is_local, index);
+    is_local = false;
+  }
+  return index;
+}
+
+/// declares `name` in the current scope, returns false (having reported an error)
+/// if it is already declared there
+static bool resolver_declare(
+  Resolver *r, Program *prog, const char *name, Ident_Handle declaration, bool is_const,
+  Location location, Binding *binding
+)
+{
+  if (r->scope_depth == 0)
+  {
+    size_t slot;
+    if (resolver_find_global(r, name, &slot) && r->globals.elems[slot].is_const)
+    {
+      resolver_error(
+        prog, TYERR_REDECLARED_IDENT, location, "constant `%s` cannot be redeclared", name
+      );
+      return false;
+    }
+
+    *binding = (Binding) {
+      .kind = BINDING_GLOBAL,
+      .depth = 0,
+      .slot = resolver_declare_global(r, name, declaration, is_const),
+      .declaration = declaration,
+    };
+    return true;
+  }
+
+  for (size_t i = r->locals.len; i > 0; --i)
+  {
+    const Resolver_Local *local = &r->locals.elems[i - 1];
+    if (local->scope_depth < r->scope_depth)
+    {
+      break;
+    }
+    if (strcmp(local->name, name) == 0)
+    {
+      resolver_error(
+        prog, TYERR_REDECLARED_IDENT, location,
+        "identifier `%s` is already declared in this scope", name
+      );
+      return false;
+    }
+  }
+
+  Resolver_Local local = {
+    .name = name,
+    .scope_depth = r->scope_depth,
+    .function_depth = r->function_depth,
+    .slot = r->locals.len - r->function_base,
+    .declaration = declaration,
+    .is_const = is_const,
+  };
+  *binding = (Binding) {
+    .kind = BINDING_LOCAL,
+    .depth = 0,
+    .slot = local.slot,
+    .declaration = declaration,
+  };
+  va_array_append(r->locals, local);
+  return true;
+}
+
+static void resolve_var_statement(Resolver *r, Program *prog, Statement *stmt)
+{
+  Var_Statement *vs = &stmt->statement.var_statement;
+  const char *name = ident_handle_to_ident(prog, vs->ident_handle);
+  Expression *initialiser = resolver_expression(prog, vs->expression_handle);
+
+  // NOTE(HS): the initialiser is resolved before the name is declared, so that
+  // `var x = x;` refers to any outer `x`. Function literals are the exception, they
+  // are declared first so they can call themselves.
+  if (initialiser->kind == EXPR_FUNC)
+  {
+    if (resolver_declare(r, prog, name, vs->ident_handle, vs->is_const, stmt->location, &vs->binding))
+    {
+      resolve_expression(r, prog, initialiser);
+    }
+    return;
+  }
+
+  resolve_expression(r, prog, initialiser);
+  resolver_declare(r, prog, name, vs->ident_handle, vs->is_const, stmt->location, &vs->binding);
+}
+
+static void resolve_return_statement(Resolver *r, Program *prog, Statement *stmt)
+{
+  const Return_Statement *rs = &stmt->statement.return_statement;
+  if (r->function_depth == 0)
+  {
+    resolver_error(
+      prog, TYERR_INVALID_RETURN, stmt->location, "`%s` outside of a function", "return"
+    );
+    return;
+  }
+
+  if (rs->has_value)
+  {
+    resolve_expression(r, prog, resolver_expression(prog, rs->expression_handle));
+  }
+}
+
+static void resolve_func_expression(Resolver *r, Program *prog, Expression *expr)
+{
+  Func_Expression *fexpr = &expr->expression.func_expression;
+
+  size_t function_base = r->function_base;
+  r->function_depth += 1;
+  r->function_base = r->locals.len;
+  Resolver_Function function = {0};
+  va_array_init(Func_Upvalue, function.upvalues);
+  va_array_append(r->functions, function);
+  resolver_begin_scope(r);
+
+  bool ok = true;
+  for (size_t i = 0; i < fexpr->params_len && ok; ++i)
+  {
+    Ident_Handle param = func_expression_param(prog, fexpr, i);
+    Binding binding;
+    ok = resolver_declare(
+      r, prog, ident_handle_to_ident(prog, param), param, false, expr->location, &binding
+    );
+    assert(!ok || binding.slot == i);
+  }
+
+  // NOTE(HS): a lazy literal is in a top level statement, so its body can only refer to
+  // globals and builtins, it's resolved when it's parsed on the first call against the
+  // globals declared by now
+  fexpr->visible_globals = r->globals.len;
+  if (ok && !fexpr->lazy)
+  {
+    resolve_statement(r, prog, resolver_statement(prog, fexpr->body));
+  }
+
+  // NOTE(HS): parameters are closed when the function returns, not at the end of
+  // their scope
+  resolver_end_scope(r);
+
+  r->functions.len -= 1;
+  Func_Upvalue_VaArray *upvalues = &r->functions.elems[r->functions.len].upvalues;
+  fexpr->upvalues_first = prog->context.upvalues.len;
+  fexpr->upvalues_len = upvalues->len;
+  va_array_append_n(prog->context.upvalues, upvalues->elems, upvalues->len);
+  va_array_free(*upvalues);
+
+  r->function_base = function_base;
+  r->function_depth -= 1;
+}
+
+/// looks `name` up in the enclosing scopes, innermost first, then the globals and
+/// finally the builtins. Locals of an enclosing function are captured.
+static bool resolver_lookup(Resolver *r, const char *name, Binding *binding)
+{
+  size_t slot;
+  if (resolver_find_local(r, name, &slot))
+  {
+    const Resolver_Local *local = &r->locals.elems[slot];
+    *binding = (Binding) {
+      .kind = BINDING_LOCAL,
+      .depth = r->function_depth - local->function_depth,
+      .slot = local->slot,
+      .declaration = local->declaration,
+    };
+    if (binding->depth > 0)
+    {
+      binding->kind = BINDING_UPVALUE;
+      binding->slot = resolver_capture(r, slot);
+    }
+    return true;
+  }
+
+  if (resolver_find_global(r, name, &slot) && slot < r->visible_globals)
+  {
+    *binding = (Binding) {
+      .kind = BINDING_GLOBAL,
+      .depth = 0,
+      .slot = slot,
+      .declaration = r->globals.elems[slot].declaration,
+    };
+    return true;
+  }
+
+  Builtin_Id id;
+  if (builtin_lookup(name, strlen(name), &id))
+  {
+    *binding = (Binding) {
+      .kind = BINDING_BUILTIN,
+      .depth = 0,
+      .slot = id,
+      .declaration = BINDING_NO_DECLARATION,
+    };
+    return true;
+  }
+
+  return false;
+}
+
+static void resolve_ident_expression(Resolver *r, Program *prog, Expression *expr)
+{
+  Ident_Expression *iexpr = &expr->expression.ident_expression;
+  const char *name = ident_handle_to_evaluated_ident(prog, iexpr->ident_handle);
+
+  if (!resolver_lookup(r, name, &iexpr->binding))
+  {
+    resolver_error(prog, TYERR_UNDEFINED_IDENT, expr->location, "undefined identifier `%s`", name);
+  }
+}
+
+static void resolve_assign_statement(Resolver *r, Program *prog, Statement *stmt)
+{
+  Assign_Statement *as = &stmt->statement.assign_statement;
+  const char *name = ident_handle_to_evaluated_ident(prog, as->ident_handle);
+  size_t local;
+
+  resolve_expression(r, prog, resolver_expression(prog, as->expression_handle));
+
+  if (!resolver_lookup(r, name, &as->binding))
+  {
+    resolver_error(prog, TYERR_UNDEFINED_IDENT, stmt->location, "undefined identifier `%s`", name);
+  }
+  else if (as->binding.kind == BINDING_BUILTIN)
+  {
+    resolver_error(
+      prog, TYERR_INVALID_ASSIGNMENT, stmt->location, "cannot assign to builtin `%s`", name
+    );
+  }
+  else if (
+    (as->binding.kind == BINDING_GLOBAL && r->globals.elems[as->binding.slot].is_const) ||
+    ((as->binding.kind == BINDING_LOCAL || as->binding.kind == BINDING_UPVALUE) &&
+     resolver_find_local(r, name, &local) && r->locals.elems[local].is_const)
+  )
+  {
+    resolver_error(
+      prog, TYERR_INVALID_ASSIGNMENT, stmt->location, "cannot assign to constant `%s`", name
+    );
+  }
+}
+
+static void resolve_statement(Resolver *r, Program *prog, Statement *stmt)
+{
+  switch (stmt->kind)
+  {
+  case STMT_VAR:
+  {
+    resolve_var_statement(r, prog, stmt);
+  } break;
+
+  case STMT_EXPRESSION:
+  {
+    Expression_Handle hndl = stmt->statement.expression_statement.expression_handle;
+    resolve_expression(r, prog, resolver_expression(prog, hndl));
+  } break;
+
+  case STMT_BLOCK:
+  {
+    Block_Statement *bs = &stmt->statement.block_statement;
+    resolver_begin_scope(r);
+    for (size_t i = 0; i < bs->len; ++i)
+    {
+      resolve_statement(r, prog, resolver_statement(prog, bs->first + i));
+    }
+    bs->captures = resolver_end_scope(r);
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    resolve_assign_statement(r, prog, stmt);
+  } break;
+
+  case STMT_IF:
+  {
+    const If_Statement *is = &stmt->statement.if_statement;
+    resolve_expression(r, prog, resolver_expression(prog, is->condition));
+    resolve_statement(r, prog, resolver_statement(prog, is->consequence));
+    if (is->has_alternative)
+    {
+      resolve_statement(r, prog, resolver_statement(prog, is->alternative));
+    }
+  } break;
+
+  case STMT_WHILE:
+  {
+    const While_Statement *ws = &stmt->statement.while_statement;
+    resolve_expression(r, prog, resolver_expression(prog, ws->condition));
+    resolve_statement(r, prog, resolver_statement(prog, ws->body));
+  } break;
+
+  case STMT_RETURN:
+  {
+    resolve_return_statement(r, prog, stmt);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Statement_Kind %s (%i)\n",
+      statement_kind_to_string(stmt->kind), stmt->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+static void resolve_expression(Resolver *r, Program *prog, Expression *expr)
+{
+  switch (expr->kind)
+  {
+  case EXPR_INT:
+  case EXPR_STRING:
+  case EXPR_BOOL:
+  {
+    // NOTE(HS): literals reference no variables
+  } break;
+
+  case EXPR_IDENT:
+  {
+    resolve_ident_expression(r, prog, expr);
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+    resolve_expression(r, prog, resolver_expression(prog, pexpr->rhs));
+  } break;
+
+  case EXPR_INFIX:
+  {
+    const Infix_Expression *iexpr = &expr->expression.infix_expression;
+    resolve_expression(r, prog, resolver_expression(prog, iexpr->lhs));
+    resolve_expression(r, prog, resolver_expression(prog, iexpr->rhs));
+  } break;
+
+  case EXPR_CALL:
+  {
+    Call_Expression *cexpr = &expr->expression.call_expression;
+    resolve_expression(r, prog, resolver_expression(prog, cexpr->function));
+    for (size_t i = 0; i < cexpr->args_len; ++i)
+    {
+      resolve_expression(r, prog, resolver_expression(prog, cexpr->args_first + i));
+    }
+  } break;
+
+  case EXPR_FUNC:
+  {
+    resolve_func_expression(r, prog, expr);
+  } break;
+
+  default:
+  {
+    fprintf(
+      stderr, "[ERROR] Unhandled Expression_Kind %s (%i)\n",
+      expression_kind_to_string(expr->kind), expr->kind
+    );
+    assert(0);
+  } break;
+  }
+}
+
+
+///
+/// public functions
+///
+
+void resolver_init(Resolver *r)
+{
+  va_array_init(Resolver_Global, r->globals);
+  r->global_index = NULL;
+  r->global_index_capacity = 0;
+  va_array_init(Resolver_Local, r->locals);
+  va_array_init(Resolver_Function, r->functions);
+  r->scope_depth = 0;
+  r->function_depth = 0;
+  r->function_base = 0;
+  r->visible_globals = SIZE_MAX;
+}
+
+void resolver_free(Resolver *r)
+{
+  for (size_t i = 0; i < r->globals.len; ++i)
+  {
+    tfree(r->globals.elems[i].name);
+  }
+  va_array_free(r->globals);
+  tfree(r->global_index);
+  va_array_free(r->locals);
+  va_array_free(r->functions);
+}
+
+void resolver_resolve_program(Resolver *r, Program *prog)
+{
+  assert(r->scope_depth == 0);
+  assert(r->locals.len == 0);
+  Phase_Scope phase = phase_begin("resolve");
+
+  size_t globals_len = r->globals.len;
+  size_t errors_len = prog->errors.len;
+
+  // NOTE(HS): globals declared by previously resolved programs have no declaration
+  // in this one. Whether they're const is kept, as redeclaring one changes it.
+  bool *was_const = tmalloc((globals_len + 1) * sizeof(bool));
+  assert(was_const);
+  for (size_t i = 0; i < r->globals.len; ++i)
+  {
+    r->globals.elems[i].declaration = BINDING_NO_DECLARATION;
+    was_const[i] = r->globals.elems[i].is_const;
+  }
+
+  for (size_t i = 0; i < prog->statements.len; ++i)
+  {
+    resolve_statement(r, prog, &(prog->statements.elems[i]));
+  }
+
+  if (prog->errors.len == errors_len)
+  {
+    purity_check_program(prog);
+  }
+
+  // NOTE(HS): a program with errors is never run, so any globals it declared are
+  // forgotten again, and those it redeclared are left as they were
+  if (prog->errors.len != errors_len)
+  {
+    for (size_t i = globals_len; i < r->globals.len; ++i)
+    {
+      tfree(r->globals.elems[i].name);
+    }
+    r->globals.len = globals_len;
+    resolver_reindex_globals(r, globals_len);
+    for (size_t i = 0; i < globals_len; ++i)
+    {
+      r->globals.elems[i].declaration = BINDING_NO_DECLARATION;
+      r->globals.elems[i].is_const = was_const[i];
+    }
+  }
+  tfree(was_const);
+  phase_end(phase);
+}
+
+void resolver_resolve_function(Resolver *r, Program *prog, size_t visible_globals)
+{
+  r->visible_globals = visible_globals;
+  resolver_resolve_program(r, prog);
+  r->visible_globals = SIZE_MAX;
+}
+
+size_t resolver_declare_host_global(Resolver *r, const char *name)
+{
+  return resolver_declare_global(r, name, BINDING_NO_DECLARATION, false);
+}
+
+size_t resolver_global_count(const Resolver *r)
+{
+  return r->globals.len;
+}
+
+const char *resolver_global_name(const Resolver *r, size_t slot)
+{
+  const char *result = NULL;
+  if (slot < r->globals.len)
+  {
+    result = r->globals.elems[slot].name;
+  }
+  return result;
+}
@@ -0,0 +1,458 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_DRIVER
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "runner.h"
+#include "lexer.h"
+#include "parser.h"
+#include "compiler.h"
+#include "trace.h"
+#include "opcode_profile.h"
+#include "phase_trace.h"
+#include "util.h"
+
+///
+/// internal functions
+///
+
+static void runner_report_error(const Runner *r, const char *source, const Tyger_Error *err)
+{
+  Location location = location_from_pos(err->source ? err->source : source, err->location.pos);
+  fprintf(
+    stderr, "%s:%zu:%zu: [ERROR] %s: %s\n",
+    r->source_name, location.line + 1, location.col + 1,
+    tyger_error_kind_to_string(err->kind), err->message ? err->message : "syntax error"
+  );
+}
+
+static void runner_write_profile(const Runner *r, const Opcode_Profile *profile)
+{
+  FILE *f = fopen(r->options.profile_opcodes_path, "a");
+  if (!f)
+  {
+    fprintf(stderr, "[ERROR] Could not open %s\n", r->options.profile_opcodes_path);
+    return;
+  }
+
+  opcode_profile_write(profile, f);
+  fclose(f);
+}
+
+static void runner_write_samples(const Runner *r, const char *source)
+{
+  FILE *f = fopen(r->options.profile_samples_path, "a");
+  if (!f)
+  {
+    fprintf(stderr, "[ERROR] Could not open %s\n", r->options.profile_samples_path);
+    return;
+  }
+
+  sample_profile_write(&r->sampler, source, f);
+  fclose(f);
+}
+
+static void runner_write_counters(const Runner *r, const char *source)
+{
+  const char *paths[] = { r->options.counters_path, r->options.counters_json_path };
+  for (size_t i = 0; i < 2; ++i)
+  {
+    if (!paths[i])
+    {
+      continue;
+    }
+
+    FILE *f = fopen(paths[i], "a");
+    if (!f)
+    {
+      fprintf(stderr, "[ERROR] Could not open %s\n", paths[i]);
+      continue;
+    }
+
+    if (i == 0)
+    {
+      exec_counters_write_report(&r->counters, source, f);
+    }
+    else
+    {
+      exec_counters_write_json(&r->counters, source, f);
+    }
+    fclose(f);
+  }
+}
+
+static void runner_write_phases(const Runner *r)
+{
+  FILE *f = fopen(r->options.trace_phases_path, "w");
+  if (!f)
+  {
+    fprintf(stderr, "[ERROR] Could not open %s\n", r->options.trace_phases_path);
+    return;
+  }
+
+  phase_trace_write(f);
+  fclose(f);
+}
+
+static void runner_write_call_profile(const Runner *r, const Chunk *chunk)
+{
+  FILE *f = fopen(r->options.profile_calls_path, "a");
+  if (!f)
+  {
+    fprintf(stderr, "[ERROR] Could not open %s\n", r->options.profile_calls_path);
+    return;
+  }
+
+  Call_Profile profile;
+  call_profile_init(&profile);
+  call_profile_collect(&profile, chunk);
+  call_profile_write(&profile, f);
+  call_profile_free(&profile);
+  fclose(f);
+}
+
+/// makes the runner's allocator (if it has one) the calling thread's, returning the
+/// allocator to restore afterwards
+static const Tyger_Allocator *runner_use_allocator(const Runner *r)
+{
+  return r->options.allocator
+    ? tyger_allocator_use(r->options.allocator)
+    : tyger_allocator_current();
+}
+
+static Compiler_Options runner_compiler_options(const Runner *r, const char *source)
+{
+  Compiler_Options options = compiler_default_options();
+  options.superinstructions = !(r->options.no_superinstructions || r->options.profile_opcodes_path);
+  options.optimise = r->options.optimise;
+  options.source = source;
+  if (r->options.inline_profile_path)
+  {
+    options.ir.call_profile = &r->inline_profile;
+  }
+  return options;
+}
+
+/// compiles a function whose body was only pre-parsed, see `VM.compile_lazy`
+///
+/// NOTE(HS): its literal is parsed again in full as a program of its own, and compiled
+/// straight into the function which was called
+static Tyger_Error runner_compile_lazy(void *context, Obj_Function *function)
+{
+  Runner *r = context;
+  Phase_Scope phase = phase_begin("compile_lazy");
+
+  Lexer lexer;
+  Parser parser;
+  lexer_init_at(&lexer, function->lazy_source, function->pos);
+  parser_init(&parser, &lexer);
+
+  Program program = parser_parse_function(&parser);
+  if (program.errors.len == 0)
+  {
+    resolver_resolve_function(&r->resolver, &program, function->lazy_globals);
+  }
+
+  Tyger_Error err = {0};
+  if (program.errors.len > 0)
+  {
+    // NOTE(HS): the message belongs to the program, which is about to be freed
+    err = program.errors.elems[0];
+    program.errors.elems[0].message = NULL;
+  }
+  else
+  {
+    const Statement *stmt = &program.statements.elems[0];
+    const Expression *expr =
+      expression_handle_to_expression(&program, stmt->statement.expression_statement.expression_handle);
+    err = compiler_compile_function(
+      &program, &expr->expression.func_expression, function,
+      runner_compiler_options(r, function->lazy_source)
+    );
+    if (err.kind == TYERR_NONE)
+    {
+      function->lazy_source = NULL;
+    }
+  }
+
+  program_free(&program);
+  phase_end(phase);
+  return err;
+}
+
+static void runner_read_inline_profile(Runner *r)
+{
+  FILE *f = fopen(r->options.inline_profile_path, "r");
+  if (!f || !call_profile_read(&r->inline_profile, f))
+  {
+    fprintf(stderr, "[ERROR] Could not read call profile %s\n", r->options.inline_profile_path);
+  }
+  if (f)
+  {
+    fclose(f);
+  }
+}
+
+
+///
+/// public functions
+///
+
+Runner_Options runner_default_options(void)
+{
+  Runner_Options options = {
+    .output_capacity = OUTPUT_DEFAULT_CAPACITY,
+    .output_flush = OUTPUT_FLUSH_AUTO,
+    .memo_capacity = MEMO_DEFAULT_CAPACITY,
+    .sample_hz = SAMPLE_PROFILE_DEFAULT_HZ,
+    .gc = gc_default_options(),
+  };
+  return options;
+}
+
+void runner_init(Runner *r, const char *source_name, Runner_Options options)
+{
+  r->options = options;
+  const Tyger_Allocator *previous = runner_use_allocator(r);
+  if (options.trace_phases_path)
+  {
+    phase_trace_start();
+  }
+  resolver_init(&r->resolver);
+  vm_init(&r->vm);
+  vm_set_output(&r->vm, STDOUT_FILENO, options.output_capacity, options.output_flush);
+  gc_set_options(&r->vm.gc, options.gc);
+  va_array_init(Chunk, r->chunks);
+  va_array_init(char*, r->sources);
+  call_profile_init(&r->inline_profile);
+  sample_profile_init(&r->sampler, options.sample_hz);
+  exec_counters_init(&r->counters);
+  r->vm.quicken = !options.no_quicken;
+  r->vm.jit = r->vm.jit && !options.no_jit;
+  r->vm.memo_capacity = options.memo_capacity;
+  r->vm.compile_lazy = runner_compile_lazy;
+  r->vm.compile_lazy_context = r;
+  r->source_name = source_name;
+  if (options.inline_profile_path)
+  {
+    runner_read_inline_profile(r);
+  }
+  tyger_allocator_use(previous);
+}
+
+void runner_free(Runner *r)
+{
+  const Tyger_Allocator *previous = runner_use_allocator(r);
+  if (r->options.profile_memo)
+  {
+    memo_table_write_stats(&r->vm.memo, stderr);
+  }
+  resolver_free(&r->resolver);
+  vm_free(&r->vm);
+  for (size_t i = 0; i < r->chunks.len; ++i)
+  {
+    chunk_free(&r->chunks.elems[i]);
+  }
+  va_array_free(r->chunks);
+  for (size_t i = 0; i < r->sources.len; ++i)
+  {
+    tfree(r->sources.elems[i]);
+  }
+  va_array_free(r->sources);
+  call_profile_free(&r->inline_profile);
+  sample_profile_free(&r->sampler);
+  exec_counters_free(&r->counters);
+
+  if (r->options.trace_phases_path)
+  {
+    phase_trace_stop();
+    runner_write_phases(r);
+    phase_trace_free();
+  }
+
+  if (r->options.memory_stats)
+  {
+    Tyger_Memory_Stats stats = tyger_memory_stats_collect();
+    tyger_memory_stats_write(&stats, stderr);
+  }
+  tyger_allocator_use(previous);
+}
+
+bool runner_run_source(Runner *r, const char *source)
+{
+  const Tyger_Allocator *previous = runner_use_allocator(r);
+
+  // NOTE(HS): functions may be called long after `source` is gone (e.g. by a later
+  // REPL line), their errors are located in it and those only pre-parsed are compiled
+  // from it
+  size_t len = strlen(source);
+  char *copy = tmalloc(len + 1);
+  assert(copy);
+  memcpy(copy, source, len + 1);
+  va_array_append(r->sources, copy);
+  source = copy;
+
+  Lexer lexer;
+  Parser parser;
+  lexer_init(&lexer, source);
+  parser_init(&parser, &lexer);
+  parser.lazy_functions = r->options.lazy_functions;
+
+  Program program = parser_parse_program(&parser);
+  if (program.errors.len == 0)
+  {
+    resolver_resolve_program(&r->resolver, &program);
+  }
+
+  if (r->options.dump_ast)
+  {
+    const char *yaml = program_to_string(&program, TRACE_YAML);
+    fprintf(stderr, "%s\n", yaml);
+    tfree((void*) yaml);
+  }
+
+  if (r->options.dump_ir && program.errors.len == 0)
+  {
+    const char *listing = program_to_string(&program, TRACE_IR);
+    fprintf(stderr, "%s\n", listing);
+    tfree((void*) listing);
+  }
+
+  bool ok = program.errors.len == 0;
+  for (size_t i = 0; i < program.errors.len; ++i)
+  {
+    runner_report_error(r, source, &program.errors.elems[i]);
+  }
+
+  if (ok)
+  {
+    Chunk chunk;
+    chunk_init(&chunk);
+
+    Compiler_Options compiler_options = runner_compiler_options(r, source);
+    Tyger_Error err = compiler_compile_program(&program, &chunk, compiler_options);
+    if (err.kind == TYERR_NONE)
+    {
+      if (r->options.dump_bytecode)
+      {
+        const char *listing = chunk_to_string(&chunk);
+        fprintf(stderr, "%s", listing);
+        tfree((void*) listing);
+      }
+
+      Opcode_Profile profile;
+      if (r->options.profile_opcodes_path)
+      {
+        opcode_profile_init(&profile);
+        r->vm.profile = &profile;
+      }
+
+      if (r->options.profile_samples_path)
+      {
+        if (sample_profile_start(&r->sampler))
+        {
+          r->vm.sampler = &r->sampler;
+        }
+        else
+        {
+          fprintf(stderr, "[ERROR] Could not start the sampling profiler\n");
+        }
+      }
+
+      if (r->options.counters_path || r->options.counters_json_path)
+      {
+        r->vm.counters = &r->counters;
+      }
+
+      err = vm_run(&r->vm, &chunk);
+      va_array_append(r->chunks, chunk);
+
+      if (r->vm.counters)
+      {
+        runner_write_counters(r, source);
+        exec_counters_clear(&r->counters);
+        r->vm.counters = NULL;
+      }
+
+      if (r->vm.sampler)
+      {
+        sample_profile_stop(&r->sampler);
+        runner_write_samples(r, source);
+        sample_profile_clear(&r->sampler);
+        r->vm.sampler = NULL;
+      }
+
+      if (r->options.profile_calls_path)
+      {
+        runner_write_call_profile(r, &chunk);
+      }
+
+      if (r->options.profile_opcodes_path)
+      {
+        runner_write_profile(r, &profile);
+        opcode_profile_free(&profile);
+        r->vm.profile = NULL;
+      }
+    }
+    else
+    {
+      chunk_free(&chunk);
+    }
+
+    if (err.kind != TYERR_NONE)
+    {
+      runner_report_error(r, source, &err);
+      tyger_error_free(&err);
+      ok = false;
+    }
+  }
+
+  program_free(&program);
+  tyger_allocator_use(previous);
+  return ok;
+}
+
+int runner_run_file(const char *path, Runner_Options options)
+{
+  char *source = read_entire_file(path);
+  if (!source)
+  {
+    fprintf(stderr, "[ERROR] Could not read file %s\n", path);
+    return 1;
+  }
+
+  Runner r;
+  runner_init(&r, path, options);
+  bool ok = runner_run_source(&r, source);
+  runner_free(&r);
+
+  tfree(source);
+  return ok ? 0 : 1;
+}
+
+char *read_entire_file(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    return NULL;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size < 0)
+  {
+    fclose(f);
+    return NULL;
+  }
+
+  char *buffer = tmalloc((size_t) size + 1);
+  assert(buffer);
+  size_t bytes_read = fread(buffer, 1, (size_t) size, f);
+  buffer[bytes_read] = '\0';
+
+  fclose(f);
+  return buffer;
+}
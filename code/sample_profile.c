@@ -0,0 +1,301 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_PROFILER
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sample_profile.h"
+#include "lexer.h"
+#include "tstrings.h"
+#include "util.h"
+
+#if SAMPLE_PROFILE_SUPPORTED
+#include <sys/time.h>
+#endif
+
+// NOTE(HS): there's only one `SIGPROF` per process, so only one profile can be
+// running at a time
+static Sample_Profile *active_profile = NULL;
+
+#if SAMPLE_PROFILE_SUPPORTED
+static struct sigaction previous_action;
+#endif
+
+/// a stack as written, stacks whose frames are on the same lines are written once
+typedef struct folded_stack
+{
+  const char *text;
+  uint64_t count;
+} Folded_Stack;
+
+///
+/// internal functions
+///
+
+#if SAMPLE_PROFILE_SUPPORTED
+static void sample_profile_signal(int signal)
+{
+  (void) signal;
+  if (active_profile)
+  {
+    active_profile->pending = 1;
+  }
+}
+#endif
+
+static uint32_t sample_stack_hash(const Sample_Frame *frames, size_t len)
+{
+  // NOTE(HS): FNV-1a over each frame's function and position
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i)
+  {
+    uint64_t parts[2] = { (uint64_t) (uintptr_t) frames[i].function, (uint64_t) frames[i].pos };
+    for (size_t p = 0; p < 2; ++p)
+    {
+      for (size_t b = 0; b < 8; ++b)
+      {
+        hash ^= (uint8_t) (parts[p] >> (8 * b));
+        hash *= 16777619u;
+      }
+    }
+  }
+  return hash;
+}
+
+static bool sample_stack_equal(
+  const Sample_Profile *profile, const Sample_Stack *stack, const Sample_Frame *frames, size_t len
+)
+{
+  if (stack->len != len)
+  {
+    return false;
+  }
+
+  const Sample_Frame *stored = &profile->frames.elems[stack->first];
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (stored[i].function != frames[i].function || stored[i].pos != frames[i].pos)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void sample_profile_reindex(Sample_Profile *profile)
+{
+  size_t capacity = profile->index_capacity == 0 ? 64 : profile->index_capacity * 2;
+  size_t *index = tcalloc(capacity, sizeof(size_t));
+  assert(index);
+
+  for (size_t i = 0; i < profile->stacks.len; ++i)
+  {
+    size_t slot = profile->stacks.elems[i].hash & (capacity - 1);
+    while (index[slot] != 0)
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    index[slot] = i + 1;
+  }
+
+  tfree(profile->index);
+  profile->index = index;
+  profile->index_capacity = capacity;
+}
+
+static void sample_fold_frame(
+  const Sample_Frame *frame, const char *source, Line_Index_Set *lines, String_Builder *sb
+)
+{
+  if (!frame->function)
+  {
+    string_builder_append(sb, "<script>");
+  }
+  else if (frame->function->name)
+  {
+    const Obj_String *name = frame->function->name;
+    string_builder_append_fmt(sb, "%.*s", (int) name->len, name->chars);
+  }
+  else
+  {
+    string_builder_append(sb, "<anonymous>");
+  }
+
+  // NOTE(HS): a function may have come from an earlier source than the script's
+  if (frame->function && frame->function->chunk.source)
+  {
+    source = frame->function->chunk.source;
+  }
+  string_builder_append_fmt(sb, ":%zu", line_index_set_location(lines, source, frame->pos).line + 1);
+}
+
+static int folded_stack_compare(const void *a, const void *b)
+{
+  const Folded_Stack *lhs = a;
+  const Folded_Stack *rhs = b;
+  return strcmp(lhs->text, rhs->text);
+}
+
+
+///
+/// public functions
+///
+
+void sample_profile_init(Sample_Profile *profile, uint32_t hz)
+{
+  profile->pending = 0;
+  profile->hz = hz == 0 ? SAMPLE_PROFILE_DEFAULT_HZ : hz;
+  profile->samples = 0;
+  va_array_init(Sample_Frame, profile->frames);
+  va_array_init(Sample_Stack, profile->stacks);
+  profile->index = NULL;
+  profile->index_capacity = 0;
+}
+
+void sample_profile_free(Sample_Profile *profile)
+{
+  if (active_profile == profile)
+  {
+    sample_profile_stop(profile);
+  }
+  va_array_free(profile->frames);
+  va_array_free(profile->stacks);
+  tfree(profile->index);
+  profile->index = NULL;
+  profile->index_capacity = 0;
+}
+
+bool sample_profile_start(Sample_Profile *profile)
+{
+#if SAMPLE_PROFILE_SUPPORTED
+  if (active_profile)
+  {
+    return false;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = sample_profile_signal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction(SIGPROF, &action, &previous_action) != 0)
+  {
+    return false;
+  }
+
+  active_profile = profile;
+  profile->pending = 0;
+
+  long interval = 1000000L / (long) profile->hz;
+  interval = interval > 0 ? interval : 1;
+  struct timeval period = { .tv_sec = interval / 1000000L, .tv_usec = interval % 1000000L };
+  struct itimerval timer = { .it_interval = period, .it_value = period };
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+  {
+    sigaction(SIGPROF, &previous_action, NULL);
+    active_profile = NULL;
+    return false;
+  }
+  return true;
+#else
+  (void) profile;
+  return false;
+#endif
+}
+
+void sample_profile_stop(Sample_Profile *profile)
+{
+#if SAMPLE_PROFILE_SUPPORTED
+  if (active_profile != profile)
+  {
+    return;
+  }
+
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  sigaction(SIGPROF, &previous_action, NULL);
+  active_profile = NULL;
+#endif
+  profile->pending = 0;
+}
+
+void sample_profile_record(Sample_Profile *profile, const Sample_Frame *frames, size_t len)
+{
+  profile->samples += 1;
+
+  if ((profile->stacks.len + 1) * 4 > profile->index_capacity * 3)
+  {
+    sample_profile_reindex(profile);
+  }
+
+  uint32_t hash = sample_stack_hash(frames, len);
+  size_t slot = hash & (profile->index_capacity - 1);
+  while (profile->index[slot] != 0)
+  {
+    Sample_Stack *stack = &profile->stacks.elems[profile->index[slot] - 1];
+    if (stack->hash == hash && sample_stack_equal(profile, stack, frames, len))
+    {
+      stack->count += 1;
+      return;
+    }
+    slot = (slot + 1) & (profile->index_capacity - 1);
+  }
+
+  Sample_Stack stack = { .first = profile->frames.len, .len = len, .hash = hash, .count = 1 };
+  va_array_append_n(profile->frames, frames, len);
+  va_array_append(profile->stacks, stack);
+  profile->index[slot] = profile->stacks.len;
+}
+
+void sample_profile_clear(Sample_Profile *profile)
+{
+  profile->samples = 0;
+  profile->frames.len = 0;
+  profile->stacks.len = 0;
+  if (profile->index)
+  {
+    memset(profile->index, 0, profile->index_capacity * sizeof(size_t));
+  }
+}
+
+void sample_profile_write(const Sample_Profile *profile, const char *source, FILE *f)
+{
+  Line_Index_Set lines;
+  line_index_set_init(&lines);
+
+  // NOTE(HS): stacks are recorded by position, calls from the same line (e.g. both
+  // of `f(n - 1) + f(n - 2)`) fold into one stack
+  Folded_Stack *folded = tcalloc(profile->stacks.len + 1, sizeof(Folded_Stack));
+  assert(folded);
+  for (size_t i = 0; i < profile->stacks.len; ++i)
+  {
+    const Sample_Stack *stack = &profile->stacks.elems[i];
+    String_Builder sb;
+    string_builder_init(&sb);
+    for (size_t j = 0; j < stack->len; ++j)
+    {
+      if (j > 0)
+      {
+        string_builder_append(&sb, ";");
+      }
+      sample_fold_frame(&profile->frames.elems[stack->first + j], source, &lines, &sb);
+    }
+    folded[i] = (Folded_Stack) { .text = string_builder_to_cstring(&sb), .count = stack->count };
+    string_builder_free(&sb);
+  }
+  qsort(folded, profile->stacks.len, sizeof(Folded_Stack), folded_stack_compare);
+
+  for (size_t i = 0; i < profile->stacks.len; ++i)
+  {
+    uint64_t count = folded[i].count;
+    while (i + 1 < profile->stacks.len && strcmp(folded[i].text, folded[i + 1].text) == 0)
+    {
+      tfree((void*) folded[i].text);
+      count += folded[++i].count;
+    }
+    fprintf(f, "%s %llu\n", folded[i].text, (unsigned long long) count);
+    tfree((void*) folded[i].text);
+  }
+
+  tfree(folded);
+  line_index_set_free(&lines);
+}
@@ -0,0 +1,143 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_COMPILER
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "superinstruction.h"
+
+#define X2(NAME, A, B) { OPC_##NAME, 2, { OPC_##A, OPC_##B } },
+#define X3(NAME, A, B, C) { OPC_##NAME, 3, { OPC_##A, OPC_##B, OPC_##C } },
+#define X4(NAME, A, B, C, D) { OPC_##NAME, 4, { OPC_##A, OPC_##B, OPC_##C, OPC_##D } },
+static const Superinstruction SUPERINSTRUCTIONS[] = {
+  #include "defs/superinstruction.def"
+  // NOTE(HS): sentinel so the table is never empty, it is excluded from the count
+  { OPC_COUNT, 0, { OPC_COUNT } },
+};
+#undef X2
+#undef X3
+#undef X4
+
+#define SUPERINSTRUCTION_COUNT ((sizeof(SUPERINSTRUCTIONS) / sizeof(SUPERINSTRUCTIONS[0])) - 1)
+
+///
+/// internal functions
+///
+
+/// returns the offset an instruction jumps to, or `SIZE_MAX` if it does not jump
+static size_t instruction_jump_target(const uint8_t *code, size_t offset)
+{
+  Opcode op = (Opcode) code[offset];
+  size_t end = offset + opcode_length(op);
+
+  switch (op)
+  {
+  case OPC_JUMP:
+  case OPC_JUMP_IF_FALSE:
+  {
+    return end + chunk_read_operand(code + offset + 1);
+  } break;
+
+  case OPC_LOOP:
+  {
+    return end - chunk_read_operand(code + offset + 1);
+  } break;
+
+  default:
+  {
+    return SIZE_MAX;
+  } break;
+  }
+}
+
+static bool superinstruction_matches(
+  const Superinstruction *s, const uint8_t *code, size_t len, size_t offset, const bool *is_target
+)
+{
+  for (size_t i = 0; i < s->len; ++i)
+  {
+    if (offset >= len || code[offset] != s->components[i])
+    {
+      return false;
+    }
+    if (i > 0 && is_target[offset])
+    {
+      return false;
+    }
+    offset += opcode_length((Opcode) code[offset]);
+  }
+  return offset <= len;
+}
+
+
+///
+/// public functions
+///
+
+const Superinstruction *superinstruction_table(size_t *count)
+{
+  *count = SUPERINSTRUCTION_COUNT;
+  return SUPERINSTRUCTIONS;
+}
+
+const Superinstruction *superinstruction_lookup(Opcode op)
+{
+  for (size_t i = 0; i < SUPERINSTRUCTION_COUNT; ++i)
+  {
+    if (SUPERINSTRUCTIONS[i].op == op)
+    {
+      return &SUPERINSTRUCTIONS[i];
+    }
+  }
+  return NULL;
+}
+
+void superinstructions_fuse(Chunk *chunk)
+{
+  uint8_t *code = chunk->code.elems;
+  size_t len = chunk->code.len;
+  if (SUPERINSTRUCTION_COUNT == 0 || len == 0)
+  {
+    return;
+  }
+
+  bool *is_target = tcalloc(len + 1, sizeof(bool));
+  assert(is_target);
+
+  for (size_t offset = 0; offset < len; offset += opcode_length((Opcode) code[offset]))
+  {
+    assert(!opcode_is_superinstruction((Opcode) code[offset]));
+    size_t target = instruction_jump_target(code, offset);
+    if (target != SIZE_MAX)
+    {
+      assert(target <= len);
+      is_target[target] = true;
+    }
+  }
+
+  size_t offset = 0;
+  while (offset < len)
+  {
+    const Superinstruction *fused = NULL;
+    for (size_t i = 0; i < SUPERINSTRUCTION_COUNT && !fused; ++i)
+    {
+      if (superinstruction_matches(&SUPERINSTRUCTIONS[i], code, len, offset, is_target))
+      {
+        fused = &SUPERINSTRUCTIONS[i];
+      }
+    }
+
+    if (!fused)
+    {
+      offset += opcode_length((Opcode) code[offset]);
+      continue;
+    }
+
+    size_t start = offset;
+    for (size_t i = 0; i < fused->len; ++i)
+    {
+      offset += opcode_length((Opcode) code[offset]);
+    }
+    code[start] = (uint8_t) fused->op;
+  }
+
+  tfree(is_target);
+}
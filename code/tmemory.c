@@ -0,0 +1,412 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_OTHER
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tmemory.h"
+
+/// the bits of `size_and_subsystem` holding the size, the subsystem is above them
+#define MEMORY_SIZE_BITS 56
+#define MEMORY_SIZE_MASK ((UINT64_C(1) << MEMORY_SIZE_BITS) - 1)
+
+/// in front of every block, padded so the block after it is aligned for any type
+///
+/// NOTE(HS): the subsystem shares a word with the size so the header stays 16 bytes
+typedef union memory_header
+{
+  struct
+  {
+    const Tyger_Allocator *allocator;
+    uint64_t size_and_subsystem;
+  } info;
+  long double align_ld;
+  void *align_ptr;
+  long long align_ll;
+} Memory_Header;
+
+// NOTE(HS): only the owning thread writes its counters, reports read them while it
+// does, hence relaxed atomic loads and stores, which are plain moves (not RMWs)
+#if defined(__GNUC__) || defined(__clang__)
+#define memory_load(COUNTER) __atomic_load_n(&(COUNTER), __ATOMIC_RELAXED)
+#define memory_store(COUNTER, VALUE) __atomic_store_n(&(COUNTER), (VALUE), __ATOMIC_RELAXED)
+#else
+#define memory_load(COUNTER) (COUNTER)
+#define memory_store(COUNTER, VALUE) ((COUNTER) = (VALUE))
+#endif
+#define memory_add(COUNTER, N) memory_store((COUNTER), memory_load(COUNTER) + (N))
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MEMORY_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define MEMORY_THREAD_LOCAL __declspec(thread)
+#else
+#define MEMORY_THREAD_LOCAL
+#endif
+
+/// one thread's share of a `Tyger_Memory_Usage`
+///
+/// NOTE(HS): a block freed on another thread than allocated it leaves this thread's
+/// current bytes negative, it's only the sum over every thread which can't be
+typedef struct memory_counts
+{
+  int64_t current_bytes;
+  uint64_t peak_bytes;
+  uint64_t allocations;
+  uint64_t reallocations;
+  uint64_t frees;
+} Memory_Counts;
+
+typedef enum memory_event
+{
+  MEMORY_EVENT_ALLOC,
+  MEMORY_EVENT_REALLOC,
+  MEMORY_EVENT_FREE,
+} Memory_Event;
+
+/// the counts of the thread which owns it, a thread which exits leaves its counters for
+/// the next one started to carry on from
+typedef struct memory_counters
+{
+  Memory_Counts total;
+  Memory_Counts subsystems[MEMORY_SUBSYSTEM_COUNT];
+  bool owned;
+  struct memory_counters *next;
+} Memory_Counters;
+
+static pthread_mutex_t memory_counters_lock = PTHREAD_MUTEX_INITIALIZER;
+static Memory_Counters *memory_counters = NULL;
+static pthread_once_t memory_counters_once = PTHREAD_ONCE_INIT;
+static pthread_key_t memory_counters_key;
+
+/// the calling thread's counters, NULL until it first allocates
+static MEMORY_THREAD_LOCAL Memory_Counters *memory_thread_counters = NULL;
+
+static void *memory_default_alloc(void *user, size_t size);
+static void *memory_default_realloc(void *user, void *ptr, size_t old_size, size_t new_size);
+static void memory_default_free(void *user, void *ptr, size_t size);
+
+static const Tyger_Allocator memory_default_allocator = {
+  .alloc = memory_default_alloc,
+  .realloc = memory_default_realloc,
+  .free = memory_default_free,
+  .user = NULL,
+};
+
+/// the calling thread's allocator, NULL for the default
+static MEMORY_THREAD_LOCAL const Tyger_Allocator *memory_allocator = NULL;
+
+///
+/// internal functions
+///
+
+static void *memory_default_alloc(void *user, size_t size)
+{
+  (void) user;
+  return malloc(size);
+}
+
+static void *memory_default_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+  (void) user;
+  (void) old_size;
+  return realloc(ptr, new_size);
+}
+
+static void memory_default_free(void *user, void *ptr, size_t size)
+{
+  (void) user;
+  (void) size;
+  free(ptr);
+}
+
+static Memory_Header *memory_header_of(void *ptr)
+{
+  return (Memory_Header*) ptr - 1;
+}
+
+static size_t memory_size_of(const Memory_Header *header)
+{
+  return (size_t) (header->info.size_and_subsystem & MEMORY_SIZE_MASK);
+}
+
+static uint32_t memory_subsystem_of(const Memory_Header *header)
+{
+  return (uint32_t) (header->info.size_and_subsystem >> MEMORY_SIZE_BITS);
+}
+
+static void memory_set_size(Memory_Header *header, size_t size, uint32_t subsystem)
+{
+  header->info.size_and_subsystem = (uint64_t) size | ((uint64_t) subsystem << MEMORY_SIZE_BITS);
+}
+
+/// whether a block of `size` bytes, and its header, can be allocated at all
+static bool memory_size_fits(size_t size)
+{
+  return size <= (size_t) -1 - sizeof(Memory_Header) && (uint64_t) size <= MEMORY_SIZE_MASK;
+}
+
+/// gives up the exiting thread's counters
+static void memory_counters_release(void *counters)
+{
+  pthread_mutex_lock(&memory_counters_lock);
+  ((Memory_Counters*) counters)->owned = false;
+  pthread_mutex_unlock(&memory_counters_lock);
+  memory_thread_counters = NULL;
+}
+
+static void memory_counters_key_create(void)
+{
+  int failed = pthread_key_create(&memory_counters_key, memory_counters_release);
+  assert(!failed);
+  (void) failed;
+}
+
+/// the calling thread's counters, taking ones an exited thread left or else adding
+/// new ones the first time
+///
+/// NOTE(HS): counters are allocated with `calloc`, as the allocations they count can't
+/// count themselves, and are never freed
+static Memory_Counters *memory_counters_thread(void)
+{
+  if (memory_thread_counters)
+  {
+    return memory_thread_counters;
+  }
+
+  pthread_once(&memory_counters_once, memory_counters_key_create);
+  pthread_mutex_lock(&memory_counters_lock);
+  Memory_Counters *counters = memory_counters;
+  while (counters && counters->owned)
+  {
+    counters = counters->next;
+  }
+  if (!counters)
+  {
+    counters = calloc(1, sizeof(Memory_Counters));
+    assert(counters);
+    counters->next = memory_counters;
+    memory_counters = counters;
+  }
+  counters->owned = true;
+  pthread_mutex_unlock(&memory_counters_lock);
+
+  pthread_setspecific(memory_counters_key, counters);
+  memory_thread_counters = counters;
+  return counters;
+}
+
+static void memory_count_size(Memory_Counts *counts, size_t old_size, size_t new_size)
+{
+  int64_t current = memory_load(counts->current_bytes) + (int64_t) new_size - (int64_t) old_size;
+  memory_store(counts->current_bytes, current);
+  if (current > 0 && (uint64_t) current > memory_load(counts->peak_bytes))
+  {
+    memory_store(counts->peak_bytes, (uint64_t) current);
+  }
+}
+
+/// counts `event` happening to a block of `subsystem` on the calling thread
+static void memory_account(Memory_Event event, uint32_t subsystem, size_t old_size, size_t new_size)
+{
+  Memory_Counters *counters = memory_counters_thread();
+  Memory_Counts *counts[] = { &counters->total, &counters->subsystems[subsystem] };
+  for (size_t i = 0; i < 2; ++i)
+  {
+    switch (event)
+    {
+      case MEMORY_EVENT_ALLOC:   { memory_add(counts[i]->allocations, 1); } break;
+      case MEMORY_EVENT_REALLOC: { memory_add(counts[i]->reallocations, 1); } break;
+      case MEMORY_EVENT_FREE:    { memory_add(counts[i]->frees, 1); } break;
+    }
+    memory_count_size(counts[i], old_size, new_size);
+  }
+}
+
+static void memory_usage_add(Tyger_Memory_Usage *usage, const Memory_Counts *counts, int64_t *current)
+{
+  *current += memory_load(counts->current_bytes);
+  usage->peak_bytes += memory_load(counts->peak_bytes);
+  usage->allocations += memory_load(counts->allocations);
+  usage->reallocations += memory_load(counts->reallocations);
+  usage->frees += memory_load(counts->frees);
+}
+
+/// what's left of the sum of every thread's current bytes, and its peak
+static void memory_usage_finish(Tyger_Memory_Usage *usage, int64_t current)
+{
+  usage->current_bytes = current > 0 ? (uint64_t) current : 0;
+  if (usage->peak_bytes < usage->current_bytes)
+  {
+    usage->peak_bytes = usage->current_bytes;
+  }
+}
+
+
+///
+/// public functions
+///
+
+const Tyger_Allocator *tyger_default_allocator(void)
+{
+  return &memory_default_allocator;
+}
+
+const Tyger_Allocator *tyger_allocator_use(const Tyger_Allocator *allocator)
+{
+  const Tyger_Allocator *previous = tyger_allocator_current();
+  memory_allocator = allocator;
+  return previous;
+}
+
+const Tyger_Allocator *tyger_allocator_current(void)
+{
+  return memory_allocator ? memory_allocator : &memory_default_allocator;
+}
+
+void *tyger_malloc(Tyger_Memory_Subsystem subsystem, size_t size)
+{
+  assert(subsystem < MEMORY_SUBSYSTEM_COUNT);
+  if (!memory_size_fits(size))
+  {
+    return NULL;
+  }
+
+  const Tyger_Allocator *allocator = tyger_allocator_current();
+  Memory_Header *header = allocator->alloc(allocator->user, sizeof(Memory_Header) + size);
+  if (!header)
+  {
+    return NULL;
+  }
+
+  header->info.allocator = allocator;
+  memory_set_size(header, size, (uint32_t) subsystem);
+  memory_account(MEMORY_EVENT_ALLOC, (uint32_t) subsystem, 0, size);
+  return header + 1;
+}
+
+void *tyger_calloc(Tyger_Memory_Subsystem subsystem, size_t count, size_t size)
+{
+  if (size != 0 && count > ((size_t) -1 - sizeof(Memory_Header)) / size)
+  {
+    return NULL;
+  }
+
+  void *ptr = tyger_malloc(subsystem, count * size);
+  if (ptr)
+  {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void *tyger_realloc(Tyger_Memory_Subsystem subsystem, void *ptr, size_t size)
+{
+  if (!ptr)
+  {
+    return tyger_malloc(subsystem, size);
+  }
+
+  if (!memory_size_fits(size))
+  {
+    return NULL;
+  }
+
+  Memory_Header *header = memory_header_of(ptr);
+  const Tyger_Allocator *allocator = header->info.allocator;
+  size_t old_size = memory_size_of(header);
+  uint32_t owner = memory_subsystem_of(header);
+  header = allocator->realloc(
+    allocator->user, header, sizeof(Memory_Header) + old_size, sizeof(Memory_Header) + size
+  );
+  if (!header)
+  {
+    return NULL;
+  }
+
+  memory_set_size(header, size, owner);
+  memory_account(MEMORY_EVENT_REALLOC, owner, old_size, size);
+  return header + 1;
+}
+
+void tyger_free(void *ptr)
+{
+  if (!ptr)
+  {
+    return;
+  }
+
+  Memory_Header *header = memory_header_of(ptr);
+  const Tyger_Allocator *allocator = header->info.allocator;
+  size_t size = memory_size_of(header);
+  uint32_t owner = memory_subsystem_of(header);
+  memory_account(MEMORY_EVENT_FREE, owner, size, 0);
+  allocator->free(allocator->user, header, sizeof(Memory_Header) + size);
+}
+
+Tyger_Memory_Stats tyger_memory_stats_collect(void)
+{
+  Tyger_Memory_Stats stats = {0};
+  int64_t total_current = 0;
+  int64_t currents[MEMORY_SUBSYSTEM_COUNT] = {0};
+
+  pthread_mutex_lock(&memory_counters_lock);
+  for (const Memory_Counters *counters = memory_counters; counters; counters = counters->next)
+  {
+    memory_usage_add(&stats.total, &counters->total, &total_current);
+    for (size_t i = 0; i < MEMORY_SUBSYSTEM_COUNT; ++i)
+    {
+      memory_usage_add(&stats.subsystems[i], &counters->subsystems[i], &currents[i]);
+    }
+  }
+  pthread_mutex_unlock(&memory_counters_lock);
+
+  memory_usage_finish(&stats.total, total_current);
+  for (size_t i = 0; i < MEMORY_SUBSYSTEM_COUNT; ++i)
+  {
+    memory_usage_finish(&stats.subsystems[i], currents[i]);
+  }
+  return stats;
+}
+
+const char *tyger_memory_subsystem_to_string(Tyger_Memory_Subsystem subsystem)
+{
+  const char *str;
+
+  switch (subsystem)
+  {
+#define X(NAME, DESCRIPTION) case MEMORY_##NAME: { str = DESCRIPTION; } break;
+    #include "defs/memory-subsystem.def"
+#undef X
+
+  default:
+  {
+    str = "unknown";
+  } break;
+  }
+
+  return str;
+}
+
+void tyger_memory_stats_write(const Tyger_Memory_Stats *stats, FILE *f)
+{
+  fprintf(
+    f, "%-10s %14s %14s %12s %12s %12s\n",
+    "memory", "current bytes", "peak bytes", "allocs", "reallocs", "frees"
+  );
+  for (size_t i = 0; i < MEMORY_SUBSYSTEM_COUNT + 1; ++i)
+  {
+    const Tyger_Memory_Usage *usage = i < MEMORY_SUBSYSTEM_COUNT ? &stats->subsystems[i] : &stats->total;
+    if (i < MEMORY_SUBSYSTEM_COUNT && usage->allocations == 0)
+    {
+      continue;
+    }
+    fprintf(
+      f, "%-10s %14llu %14llu %12llu %12llu %12llu\n",
+      i < MEMORY_SUBSYSTEM_COUNT ? tyger_memory_subsystem_to_string((Tyger_Memory_Subsystem) i) : "total",
+      (unsigned long long) usage->current_bytes, (unsigned long long) usage->peak_bytes,
+      (unsigned long long) usage->allocations, (unsigned long long) usage->reallocations,
+      (unsigned long long) usage->frees
+    );
+  }
+}
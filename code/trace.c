@@ -1,3 +1,4 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_TRACE
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -5,6 +6,9 @@
 #include <inttypes.h>
 #include "trace.h"
 #include "tstrings.h"
+#include "bigint.h"
+#include "ir.h"
+#include "phase_trace.h"
 
 #define TRACE_YAML_SPACES_PER_INDENT_LEVEL 4
 
@@ -16,12 +20,19 @@ static void yaml_print_expression(
   const Program *prog, const Expression *expr, String_Builder *sb, int *indent_level
 );
 
+static void yaml_print_binding(
+  const Binding *binding, String_Builder *sb, int indent_level, const char *field_indent
+);
+
 static void sexpr_print_statement(const Program *prog, const Statement *stmt, String_Builder *sb);
 static void sexpr_print_expression(const Program *prog, const Expression *expr, String_Builder *sb);
 
+static void ir_print_function(const Program *prog, const Func_Expression *fexpr, String_Builder *sb);
+
 const char *program_to_string(const Program *p, Trace_Format kind)
 {
   assert(p);
+  Phase_Scope phase = phase_begin("program_to_string");
   String_Builder sb;
   string_builder_init(&sb);
 
@@ -46,30 +57,49 @@ const char *program_to_string(const Program *p, Trace_Format kind)
       sexpr_print_statement(p, stmt, &sb);
     }
   } break;
+
+  case TRACE_IR:
+  {
+    ir_print_function(p, NULL, &sb);
+    for (size_t i = 0; i < p->context.expressions.len; ++i)
+    {
+      const Expression *expr = &p->context.expressions.elems[i];
+      if (expr->kind == EXPR_FUNC)
+      {
+        ir_print_function(p, &expr->expression.func_expression, &sb);
+      }
+    }
+  } break;
   }
 
   const char *buffer = string_builder_to_cstring(&sb);
+  string_builder_free(&sb);
+  phase_end(phase);
   return buffer;
 }
 
-static void check_buffer_and_resize(char *buffer, size_t *capacity, size_t len, size_t bytes_to_write)
+static void check_buffer_and_resize(String_Builder *sb, size_t bytes_to_write)
 {
-  if ((len + bytes_to_write) > *capacity)
+  if ((sb->len + bytes_to_write) > sb->capacity)
   {
-    size_t new_capacity = *capacity * 2;
-    char *new_buffer = realloc(buffer, new_capacity);
-    if (buffer != new_buffer)
+    size_t new_capacity = sb->capacity * 2;
+    while (new_capacity < sb->len + bytes_to_write)
+    {
+      new_capacity *= 2;
+    }
+    char *new_buffer = trealloc(sb->buffer, new_capacity);
+    if (sb->buffer != new_buffer)
     {
-      buffer = new_buffer;
+      sb->buffer = new_buffer;
     }
-    *capacity = new_capacity;
+    sb->capacity = new_capacity;
   }
 }
 
 static void yaml_print_indent(String_Builder *sb, int indent_level)
 {
   int num_spaces_to_indent = indent_level * TRACE_YAML_SPACES_PER_INDENT_LEVEL;
-  check_buffer_and_resize(sb->buffer, &sb->capacity, sb->len, num_spaces_to_indent);
+  check_buffer_and_resize(sb, num_spaces_to_indent);
   memset(&(sb->buffer[sb->len]), ' ', num_spaces_to_indent);
   sb->len += num_spaces_to_indent;
 }
@@ -81,6 +111,23 @@ static void yaml_print_header(const Program *p, String_Builder *sb)
 }
 
 
+/// NOTE(HS): bindings are only printed once the program has been through the resolver
+static void yaml_print_binding(
+  const Binding *binding, String_Builder *sb, int indent_level, const char *field_indent
+)
+{
+  if (binding->kind == BINDING_UNRESOLVED)
+  {
+    return;
+  }
+
+  yaml_print_indent(sb, indent_level);
+  string_builder_append_fmt(
+    sb, "%sbinding: { kind: %s, depth: %zu, slot: %zu }\n",
+    field_indent, binding_kind_to_string(binding->kind), binding->depth, binding->slot
+  );
+}
+
 // TODO(HS): improve num indent spaces calculation
 static void yaml_print_statement(
   const Program *prog, const Statement *stmt, String_Builder *sb, int *indent_level
@@ -99,6 +146,12 @@ static void yaml_print_statement(
 
     yaml_print_indent(sb, *indent_level);
     string_builder_append_fmt(sb, "  ident: %s\n", ident);
+    if (vs->is_const)
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append(sb, "  const: true\n");
+    }
+    yaml_print_binding(&vs->binding, sb, *indent_level, "  ");
     yaml_print_indent(sb, *indent_level);
     string_builder_append_fmt(sb, "  expression:\n");
     *indent_level += 1;
@@ -119,6 +172,95 @@ static void yaml_print_statement(
     *indent_level -= 1;
   } break;
 
+  case STMT_BLOCK:
+  {
+    const Block_Statement *bs = &stmt->statement.block_statement;
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  statements:\n");
+    *indent_level += 1;
+    for (size_t i = 0; i < bs->len; ++i)
+    {
+      const Statement *inner = statement_handle_to_statement(prog, bs->first + i);
+      yaml_print_statement(prog, inner, sb, indent_level);
+    }
+    *indent_level -= 1;
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    const char *ident = ident_handle_to_evaluated_ident(prog, as->ident_handle);
+    const Expression *expr = expression_handle_to_expression(prog, as->expression_handle);
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  ident: %s\n", ident);
+    yaml_print_binding(&as->binding, sb, *indent_level, "  ");
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  expression:\n");
+    *indent_level += 1;
+    yaml_print_expression(prog, expr, sb, indent_level);
+    *indent_level -= 1;
+  } break;
+
+  case STMT_IF:
+  {
+    const If_Statement *is = &stmt->statement.if_statement;
+    const Expression *condition = expression_handle_to_expression(prog, is->condition);
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  condition:\n");
+    *indent_level += 1;
+    yaml_print_expression(prog, condition, sb, indent_level);
+    *indent_level -= 1;
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  consequence:\n");
+    *indent_level += 1;
+    yaml_print_statement(prog, statement_handle_to_statement(prog, is->consequence), sb, indent_level);
+    *indent_level -= 1;
+
+    if (is->has_alternative)
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append_fmt(sb, "  alternative:\n");
+      *indent_level += 1;
+      yaml_print_statement(prog, statement_handle_to_statement(prog, is->alternative), sb, indent_level);
+      *indent_level -= 1;
+    }
+  } break;
+
+  case STMT_WHILE:
+  {
+    const While_Statement *ws = &stmt->statement.while_statement;
+    const Expression *condition = expression_handle_to_expression(prog, ws->condition);
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  condition:\n");
+    *indent_level += 1;
+    yaml_print_expression(prog, condition, sb, indent_level);
+    *indent_level -= 1;
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "  body:\n");
+    *indent_level += 1;
+    yaml_print_statement(prog, statement_handle_to_statement(prog, ws->body), sb, indent_level);
+    *indent_level -= 1;
+  } break;
+
+  case STMT_RETURN:
+  {
+    const Return_Statement *rs = &stmt->statement.return_statement;
+    if (rs->has_value)
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append_fmt(sb, "  expression:\n");
+      *indent_level += 1;
+      yaml_print_expression(prog, expression_handle_to_expression(prog, rs->expression_handle), sb, indent_level);
+      *indent_level -= 1;
+    }
+  } break;
+
   default:
   {
     fprintf(
@@ -141,8 +283,16 @@ static void yaml_print_expression(
   {
   case EXPR_INT:
   {
+    const Int_Expression *iexpr = &expr->expression.int_expression;
     yaml_print_indent(sb, *indent_level);
-    string_builder_append_fmt(sb, "    value: %" PRId64 "\n", expr->expression.int_expression.value);
+    if (iexpr->is_big)
+    {
+      string_builder_append_fmt(sb, "    value: %s\n", string_handle_to_cstring(prog, iexpr->digits_handle));
+    }
+    else
+    {
+      string_builder_append_fmt(sb, "    value: %" PRId64 "\n", iexpr->value);
+    }
   } break;
 
   case EXPR_STRING:
@@ -161,6 +311,30 @@ static void yaml_print_expression(
     const char *ident = ident_handle_to_evaluated_ident(prog, iexpr->ident_handle);
     yaml_print_indent(sb, *indent_level);
     string_builder_append_fmt(sb, "    ident: %s\n", ident);
+    yaml_print_binding(&iexpr->binding, sb, *indent_level, "    ");
+  } break;
+
+  case EXPR_BOOL:
+  {
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(
+      sb, "    value: %s\n", expr->expression.bool_expression.value ? "true" : "false"
+    );
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "    op: %s\n", operator_to_string(pexpr->op));
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "    rhs:\n");
+    *indent_level += 1;
+    const Expression *rhs = expression_handle_to_expression(prog, pexpr->rhs);
+    yaml_print_expression(prog, rhs, sb, indent_level);
+    *indent_level -= 1;
   } break;
 
   case EXPR_INFIX:
@@ -190,24 +364,70 @@ static void yaml_print_expression(
   {
     const Call_Expression *cexpr = &expr->expression.call_expression;
     const Expression *function = expression_handle_to_expression(prog, cexpr->function);
-    assert(function->kind == EXPR_IDENT);
-    Ident_Handle ident_handle = function->expression.ident_expression.ident_handle;
-    const char *ident = ident_handle_to_evaluated_ident(prog, ident_handle);
-    yaml_print_indent(sb, *indent_level);
-    string_builder_append_fmt(sb, "    name: %s\n", ident);
+    if (function->kind == EXPR_IDENT)
+    {
+      Ident_Handle ident_handle = function->expression.ident_expression.ident_handle;
+      const char *ident = ident_handle_to_evaluated_ident(prog, ident_handle);
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append_fmt(sb, "    name: %s\n", ident);
+      yaml_print_binding(&function->expression.ident_expression.binding, sb, *indent_level, "    ");
+    }
+    else
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append_fmt(sb, "    function:\n");
+      *indent_level += 1;
+      yaml_print_expression(prog, function, sb, indent_level);
+      *indent_level -= 1;
+    }
 
     yaml_print_indent(sb, *indent_level);
     string_builder_append_fmt(sb, "    args:\n");
 
     *indent_level += 1;
-    for (size_t i = 0; i < cexpr->args.len; ++i)
+    for (size_t i = 0; i < cexpr->args_len; ++i)
     {
-      const Expression *arg = &(cexpr->args.elems[i]);
+      const Expression *arg = expression_handle_to_expression(prog, cexpr->args_first + i);
       yaml_print_expression(prog, arg, sb, indent_level);
     }
     *indent_level -= 1;
   } break;
 
+  case EXPR_FUNC:
+  {
+    const Func_Expression *fexpr = &expr->expression.func_expression;
+    if (fexpr->name != FUNC_ANONYMOUS)
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append_fmt(sb, "    name: %s\n", ident_handle_to_ident(prog, fexpr->name));
+    }
+    if (fexpr->memo)
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append(sb, "    memo: true\n");
+    }
+    if (fexpr->lazy)
+    {
+      yaml_print_indent(sb, *indent_level);
+      string_builder_append(sb, "    lazy: true\n");
+    }
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "    params: [");
+    for (size_t i = 0; i < fexpr->params_len; ++i)
+    {
+      const char *param = ident_handle_to_ident(prog, func_expression_param(prog, fexpr, i));
+      string_builder_append_fmt(sb, "%s%s", (i > 0) ? ", " : "", param);
+    }
+    string_builder_append(sb, "]\n");
+
+    yaml_print_indent(sb, *indent_level);
+    string_builder_append_fmt(sb, "    body:\n");
+    *indent_level += 1;
+    yaml_print_statement(prog, statement_handle_to_statement(prog, fexpr->body), sb, indent_level);
+    *indent_level -= 1;
+  } break;
+
   default:
   {
     fprintf(
@@ -229,7 +449,7 @@ static void sexpr_print_statement(const Program *prog, const Statement *stmt, St
     const char *ident = ident_handle_to_ident(prog, vs->ident_handle);
     const Expression *expr = expression_handle_to_expression(prog, vs->expression_handle);
 
-    string_builder_append_fmt(sb, "(var %s ", ident);
+    string_builder_append_fmt(sb, "(%s %s ", vs->is_const ? "const" : "var", ident);
     sexpr_print_expression(prog, expr, sb);
     string_builder_append(sb, ")");
   } break;
@@ -244,6 +464,69 @@ static void sexpr_print_statement(const Program *prog, const Statement *stmt, St
     string_builder_append_fmt(sb, ")");
   } break;
 
+  case STMT_BLOCK:
+  {
+    const Block_Statement *bs = &stmt->statement.block_statement;
+    string_builder_append(sb, "(block");
+    for (size_t i = 0; i < bs->len; ++i)
+    {
+      const Statement *inner = statement_handle_to_statement(prog, bs->first + i);
+      string_builder_append(sb, " ");
+      sexpr_print_statement(prog, inner, sb);
+    }
+    string_builder_append(sb, ")");
+  } break;
+
+  case STMT_ASSIGN:
+  {
+    const Assign_Statement *as = &stmt->statement.assign_statement;
+    const char *ident = ident_handle_to_evaluated_ident(prog, as->ident_handle);
+    const Expression *expr = expression_handle_to_expression(prog, as->expression_handle);
+
+    string_builder_append_fmt(sb, "(assign %s ", ident);
+    sexpr_print_expression(prog, expr, sb);
+    string_builder_append(sb, ")");
+  } break;
+
+  case STMT_IF:
+  {
+    const If_Statement *is = &stmt->statement.if_statement;
+
+    string_builder_append(sb, "(if ");
+    sexpr_print_expression(prog, expression_handle_to_expression(prog, is->condition), sb);
+    string_builder_append(sb, " ");
+    sexpr_print_statement(prog, statement_handle_to_statement(prog, is->consequence), sb);
+    if (is->has_alternative)
+    {
+      string_builder_append(sb, " ");
+      sexpr_print_statement(prog, statement_handle_to_statement(prog, is->alternative), sb);
+    }
+    string_builder_append(sb, ")");
+  } break;
+
+  case STMT_WHILE:
+  {
+    const While_Statement *ws = &stmt->statement.while_statement;
+
+    string_builder_append(sb, "(while ");
+    sexpr_print_expression(prog, expression_handle_to_expression(prog, ws->condition), sb);
+    string_builder_append(sb, " ");
+    sexpr_print_statement(prog, statement_handle_to_statement(prog, ws->body), sb);
+    string_builder_append(sb, ")");
+  } break;
+
+  case STMT_RETURN:
+  {
+    const Return_Statement *rs = &stmt->statement.return_statement;
+    string_builder_append(sb, "(return");
+    if (rs->has_value)
+    {
+      string_builder_append(sb, " ");
+      sexpr_print_expression(prog, expression_handle_to_expression(prog, rs->expression_handle), sb);
+    }
+    string_builder_append(sb, ")");
+  } break;
+
   default:
   {
     fprintf(
@@ -263,7 +546,15 @@ static void sexpr_print_expression(const Program *prog, const Expression *expr,
   {
   case EXPR_INT:
   {
-    string_builder_append_fmt(sb, "%" PRId64 "", expr->expression.int_expression.value);
+    const Int_Expression *iexpr = &expr->expression.int_expression;
+    if (iexpr->is_big)
+    {
+      string_builder_append(sb, string_handle_to_cstring(prog, iexpr->digits_handle));
+    }
+    else
+    {
+      string_builder_append_fmt(sb, "%" PRId64 "", iexpr->value);
+    }
   } break;
 
   case EXPR_STRING:
@@ -282,6 +573,19 @@ static void sexpr_print_expression(const Program *prog, const Expression *expr,
     string_builder_append_fmt(sb, "%s", ident);
   } break;
 
+  case EXPR_BOOL:
+  {
+    string_builder_append(sb, expr->expression.bool_expression.value ? "true" : "false");
+  } break;
+
+  case EXPR_PREFIX:
+  {
+    const Prefix_Expression *pexpr = &expr->expression.prefix_expression;
+    string_builder_append_fmt(sb, "(%s ", operator_to_string(pexpr->op));
+    sexpr_print_expression(prog, expression_handle_to_expression(prog, pexpr->rhs), sb);
+    string_builder_append(sb, ")");
+  } break;
+
   case EXPR_INFIX:
   {
     string_builder_append(sb, "(");
@@ -302,17 +606,14 @@ static void sexpr_print_expression(const Program *prog, const Expression *expr,
   {
     const Call_Expression *cexpr = &expr->expression.call_expression;
     const Expression *function = expression_handle_to_expression(prog, cexpr->function);
-    assert(function->kind == EXPR_IDENT);
-    Ident_Handle ident_handle = function->expression.ident_expression.ident_handle;
-    const char *ident = ident_handle_to_evaluated_ident(prog, ident_handle);
+    sexpr_print_expression(prog, function, sb);
+    string_builder_append(sb, " [");
 
-    string_builder_append_fmt(sb, "%s [", ident);
-
-    for (size_t i = 0; i < cexpr->args.len; ++i)
+    for (size_t i = 0; i < cexpr->args_len; ++i)
     {
-      const Expression *arg = &(cexpr->args.elems[i]);
+      const Expression *arg = expression_handle_to_expression(prog, cexpr->args_first + i);
       sexpr_print_expression(prog, arg, sb);
-      if (!(i + 1 >= cexpr->args.len))
+      if (!(i + 1 >= cexpr->args_len))
       {
         string_builder_append_fmt(sb, " ; ");
       }
@@ -320,7 +621,21 @@ static void sexpr_print_expression(const Program *prog, const Expression *expr,
 
     string_builder_append(sb, "]");
   } break;
-  
+
+  case EXPR_FUNC:
+  {
+    const Func_Expression *fexpr = &expr->expression.func_expression;
+    string_builder_append(sb, fexpr->memo ? "(@memo func [" : fexpr->lazy ? "(lazy func [" : "(func [");
+    for (size_t i = 0; i < fexpr->params_len; ++i)
+    {
+      const char *param = ident_handle_to_ident(prog, func_expression_param(prog, fexpr, i));
+      string_builder_append_fmt(sb, "%s%s", (i > 0) ? " ; " : "", param);
+    }
+    string_builder_append(sb, "] ");
+    sexpr_print_statement(prog, statement_handle_to_statement(prog, fexpr->body), sb);
+    string_builder_append(sb, ")");
+  } break;
+
   default:
   {
     fprintf(
@@ -333,3 +648,143 @@ static void sexpr_print_expression(const Program *prog, const Expression *expr,
   } break;
   }
 }
+
+/// NOTE(HS): functions the IR can't represent are noted with the reason, the bytecode
+/// compiler handles them directly
+static void ir_print_function(const Program *prog, const Func_Expression *fexpr, String_Builder *sb)
+{
+  if (!fexpr)
+  {
+    string_builder_append(sb, "== <script> ==\n");
+  }
+  else if (fexpr->name != FUNC_ANONYMOUS)
+  {
+    string_builder_append_fmt(sb, "\n== %s ==\n", ident_handle_to_ident(prog, fexpr->name));
+  }
+  else
+  {
+    string_builder_append(sb, "\n== <anonymous> ==\n");
+  }
+
+  Ir_Function fn;
+  if (ir_build_function(&fn, prog, fexpr))
+  {
+    ir_optimise(&fn, ir_default_options());
+    ir_function_append(&fn, sb);
+  }
+  else
+  {
+    string_builder_append_fmt(sb, "; not optimised, %s\n", fn.unsupported);
+  }
+  ir_function_free(&fn);
+}
+
+static void chunk_print_constant(const Chunk *chunk, size_t index, String_Builder *sb)
+{
+  if (index >= chunk->constants.len)
+  {
+    string_builder_append(sb, "<invalid>");
+    return;
+  }
+
+  Value v = chunk->constants.elems[index];
+  switch (v.kind)
+  {
+  case VAL_NIL:  { string_builder_append(sb, "nil"); } break;
+  case VAL_BOOL: { string_builder_append(sb, v.as.boolean ? "true" : "false"); } break;
+  case VAL_INT:  { string_builder_append_fmt(sb, "%" PRId64, v.as.integer); } break;
+  case VAL_SHORT_STR:
+  {
+    string_builder_append_fmt(sb, "\"%.*s\"", (int) v.short_len, v.as.chars);
+  } break;
+
+  case VAL_OBJ:
+  {
+    if (value_is_string(v))
+    {
+      String_View str = value_string_view(&v);
+      string_builder_append_fmt(sb, "\"" SV_FMT "\"", SV_ARGS(str));
+    }
+    else if (value_is_function(v))
+    {
+      const Obj_String *name = value_as_function(v)->name;
+      string_builder_append_fmt(sb, name ? "<func %s>" : "<func>", name ? name->chars : "");
+    }
+    else if (value_is_bigint(v))
+    {
+      char *digits = bigint_to_decimal(value_as_bigint(v));
+      string_builder_append(sb, digits);
+      tfree(digits);
+    }
+    else
+    {
+      string_builder_append_fmt(sb, "<%s>", object_kind_to_string(v.as.obj->kind));
+    }
+  } break;
+
+  default:
+  {
+    assert(0 && "Invalid Value_Kind");
+  } break;
+  }
+}
+
+static void chunk_append_listing(const Chunk *chunk, String_Builder *sb)
+{
+  size_t offset = 0;
+  while (offset < chunk->code.len)
+  {
+    Opcode op = (Opcode) chunk->code.elems[offset];
+    string_builder_append_fmt(
+      sb, "%04zu %6zu %s", offset, chunk_position_of(chunk, offset), opcode_to_string(op)
+    );
+
+    size_t operands = opcode_operand_count(op);
+    for (size_t i = 0; i < operands; ++i)
+    {
+      const uint8_t *operand = &chunk->code.elems[offset + 1 + i * CHUNK_OPERAND_SIZE];
+      string_builder_append_fmt(sb, " %u", (unsigned) chunk_read_operand(operand));
+    }
+
+    if (op == OPC_LOAD_CONST || op == OPC_CLOSURE)
+    {
+      string_builder_append(sb, " ; ");
+      chunk_print_constant(chunk, chunk_read_operand(&chunk->code.elems[offset + 1]), sb);
+    }
+    else if (op == OPC_IS_FUNCTION)
+    {
+      size_t index = chunk_read_operand(&chunk->code.elems[offset + 1]);
+      const Obj_Function *expected = index < chunk->guards.len ? chunk->guards.elems[index] : NULL;
+      const Obj_String *name = expected ? expected->name : NULL;
+      string_builder_append_fmt(sb, name ? " ; <func %s>" : " ; <func>", name ? name->chars : "");
+    }
+
+    string_builder_append(sb, "\n");
+    offset += opcode_length(op);
+  }
+
+  // NOTE(HS): functions are listed after the chunk which contains them
+  for (size_t i = 0; i < chunk->constants.len; ++i)
+  {
+    if (value_is_function(chunk->constants.elems[i]))
+    {
+      string_builder_append(sb, "\n== ");
+      chunk_print_constant(chunk, i, sb);
+      string_builder_append(sb, " ==\n");
+      chunk_append_listing(&value_as_function(chunk->constants.elems[i])->chunk, sb);
+    }
+  }
+}
+
+const char *chunk_to_string(const Chunk *chunk)
+{
+  assert(chunk);
+  String_Builder sb;
+  string_builder_init(&sb);
+
+  chunk_append_listing(chunk, &sb);
+
+  const char *buffer = string_builder_to_cstring(&sb);
+  string_builder_free(&sb);
+  return buffer;
+}
@@ -1,3 +1,4 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_STRINGS
 #include <assert.h>
 #include <stdarg.h>
 #include <string.h>
@@ -65,11 +66,12 @@ void string_view_format_buffer(char *buffer, size_t buffer_len, String_View sv)
   assert(bytes_written == bytes_to_write);
 }
 
-void string_builder_init(String_Builder *sb)
+void string_builder_init_in(String_Builder *sb, Tyger_Memory_Subsystem subsystem)
 {
   sb->capacity = 2048;
   sb->len = 0;
-  sb->buffer = malloc(sizeof(char) * sb->capacity);
+  sb->subsystem = subsystem;
+  sb->buffer = tyger_malloc(subsystem, sizeof(char) * sb->capacity);
 }
 
 void string_builder_append(String_Builder *sb, const char *str)
@@ -79,10 +81,15 @@ void string_builder_append(String_Builder *sb, const char *str)
 
   int bytes_to_write = snprintf(NULL, 0, "%s", str);
 
-  if ((sb->len + bytes_to_write) > sb->capacity)
+  // NOTE(HS): `+ 1` as `snprintf` always writes the null terminator
+  if ((sb->len + bytes_to_write + 1) > sb->capacity)
   {
     size_t new_capacity = sb->capacity * 2;
-    char *new_buffer = realloc(sb->buffer, new_capacity);
+    while (new_capacity < sb->len + bytes_to_write + 1)
+    {
+      new_capacity *= 2;
+    }
+    char *new_buffer = trealloc(sb->buffer, new_capacity);
     if (sb->buffer != new_buffer)
     {
       sb->buffer = new_buffer;
@@ -107,10 +114,15 @@ void string_builder_append_fmt(String_Builder *sb, const char *fmt, ...)
   int bytes_to_write = vsnprintf(NULL, 0, fmt, args);
   va_end(args);
 
-  if ((sb->len + bytes_to_write) > sb->capacity)
+  // NOTE(HS): `+ 1` as `snprintf` always writes the null terminator
+  if ((sb->len + bytes_to_write + 1) > sb->capacity)
   {
     size_t new_capacity = sb->capacity * 2;
-    char *new_buffer = realloc(sb->buffer, new_capacity);
+    while (new_capacity < sb->len + bytes_to_write + 1)
+    {
+      new_capacity *= 2;
+    }
+    char *new_buffer = trealloc(sb->buffer, new_capacity);
     if (sb->buffer != new_buffer)
     {
       sb->buffer = new_buffer;
@@ -131,9 +143,18 @@ const char *string_builder_to_cstring(const String_Builder *sb)
 {
   assert(sb);
   assert(sb->buffer);
-  char *buffer = malloc(sizeof(char) * sb->len + 1);
+  char *buffer = tyger_malloc(sb->subsystem, sizeof(char) * sb->len + 1);
   assert(buffer);
   strncpy(buffer, sb->buffer, sb->len);
   buffer[sb->len] = '\0';
   return buffer;
 }
+
+void string_builder_free(String_Builder *sb)
+{
+  assert(sb);
+  tfree(sb->buffer);
+  sb->buffer = NULL;
+  sb->capacity = 0;
+  sb->len = 0;
+}
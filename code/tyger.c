@@ -0,0 +1,357 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_DRIVER
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tyger.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "util.h"
+
+// NOTE(HS): 0 is left for the empty program
+static uint64_t tyger_last_program_id = 0;
+
+///
+/// internal functions
+///
+
+static char *tyger_copy_string(const char *str)
+{
+  size_t len = strlen(str);
+  char *copy = tmalloc(len + 1);
+  assert(copy);
+  memcpy(copy, str, len + 1);
+  return copy;
+}
+
+/// makes `allocator` (if set) the calling thread's, returning the allocator to restore
+/// afterwards
+static const Tyger_Allocator *tyger_vm_enter_allocator(const Tyger_Allocator *allocator)
+{
+  return allocator ? tyger_allocator_use(allocator) : tyger_allocator_current();
+}
+
+/// the index of the instance's copy of the program `id`, its number of copies when it
+/// has none
+static size_t tyger_vm_chunk_index(const Tyger_VM *vm, uint64_t id)
+{
+  size_t i = 0;
+  while (i < vm->chunks.len && vm->chunks.elems[i].program_id != id)
+  {
+    i += 1;
+  }
+  return i;
+}
+
+/// the instance's copy of `program`, made the first time it runs it
+static Chunk *tyger_vm_chunk(Tyger_VM *vm, const Tyger_Program *program)
+{
+  size_t index = tyger_vm_chunk_index(vm, program->id);
+  if (index < vm->chunks.len)
+  {
+    return &vm->chunks.elems[index].chunk;
+  }
+
+  Tyger_VM_Chunk copy = { .program_id = program->id };
+  chunk_copy(&copy.chunk, &program->chunk);
+  va_array_append(vm->chunks, copy);
+  return &vm->chunks.elems[vm->chunks.len - 1].chunk;
+}
+
+/// the value the host gives the global `name`, from `globals` or else a registered
+/// function, false when it gives none
+static bool tyger_vm_host_global(
+  const Tyger_VM *vm, const char *name, const Tyger_Global *globals, size_t globals_len, Value *value
+)
+{
+  for (size_t i = 0; i < globals_len; ++i)
+  {
+    if (strcmp(globals[i].name, name) == 0)
+    {
+      *value = globals[i].value;
+      return true;
+    }
+  }
+
+  for (size_t i = 0; i < vm->hosts.len; ++i)
+  {
+    if (strcmp(vm->hosts.elems[i].name, name) == 0)
+    {
+      *value = make_obj_value(&vm->hosts.elems[i].function->obj);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+///
+/// public functions
+///
+
+Tyger_Compile_Options tyger_compile_default_options(void)
+{
+  Tyger_Compile_Options options = {
+    .host_globals = NULL,
+    .host_globals_len = 0,
+    .optimise = false,
+  };
+  return options;
+}
+
+Tyger_Error tyger_program_compile(Tyger_Program *program, const char *source, Tyger_Compile_Options options)
+{
+  *program = (Tyger_Program) {0};
+  program->id = __atomic_add_fetch(&tyger_last_program_id, 1, __ATOMIC_RELAXED);
+  program->source = tyger_copy_string(source);
+  chunk_init(&program->chunk);
+
+  // NOTE(HS): the host's globals are declared first, so take the first slots
+  Resolver resolver;
+  resolver_init(&resolver);
+  for (size_t i = 0; i < options.host_globals_len; ++i)
+  {
+    resolver_declare_host_global(&resolver, options.host_globals[i]);
+  }
+  size_t host_globals_len = resolver_global_count(&resolver);
+
+  Lexer lexer;
+  Parser parser;
+  lexer_init(&lexer, program->source);
+  parser_init(&parser, &lexer);
+
+  Program ast = parser_parse_program(&parser);
+  if (ast.errors.len == 0)
+  {
+    resolver_resolve_program(&resolver, &ast);
+  }
+
+  Tyger_Error err = {0};
+  if (ast.errors.len > 0)
+  {
+    // NOTE(HS): the message belongs to the program, which is about to be freed
+    err = ast.errors.elems[0];
+    ast.errors.elems[0].message = NULL;
+  }
+  else
+  {
+    Compiler_Options compiler_options = compiler_default_options();
+    compiler_options.optimise = options.optimise;
+    compiler_options.source = program->source;
+    err = compiler_compile_program(&ast, &program->chunk, compiler_options);
+  }
+
+  if (err.kind == TYERR_NONE)
+  {
+    program->global_count = resolver_global_count(&resolver);
+    program->host_globals_len = host_globals_len;
+    program->global_names = tmalloc((program->global_count + 1) * sizeof(char*));
+    assert(program->global_names);
+    for (size_t slot = 0; slot < program->global_count; ++slot)
+    {
+      program->global_names[slot] = tyger_copy_string(resolver_global_name(&resolver, slot));
+    }
+  }
+  else
+  {
+    err.location = location_from_pos(program->source, err.location.pos);
+    tyger_program_free(program);
+  }
+
+  program_free(&ast);
+  resolver_free(&resolver);
+  return err;
+}
+
+void tyger_program_free(Tyger_Program *program)
+{
+  for (size_t slot = 0; slot < program->global_count; ++slot)
+  {
+    tfree(program->global_names[slot]);
+  }
+  tfree(program->global_names);
+  chunk_free(&program->chunk);
+  tfree(program->source);
+  *program = (Tyger_Program) {0};
+}
+
+Tyger_VM_Options tyger_vm_default_options(void)
+{
+  Tyger_VM_Options options = {
+    .output_fd = STDOUT_FILENO,
+    .output_capacity = OUTPUT_DEFAULT_CAPACITY,
+    .output_flush = OUTPUT_FLUSH_AUTO,
+    .memo_capacity = MEMO_DEFAULT_CAPACITY,
+    .gc = gc_default_options(),
+    .allocator = NULL,
+  };
+  return options;
+}
+
+Tyger_VM *tyger_vm_create(Tyger_VM_Options options)
+{
+  const Tyger_Allocator *previous = tyger_vm_enter_allocator(options.allocator);
+
+  Tyger_VM *vm = tmalloc(sizeof(Tyger_VM));
+  assert(vm);
+  vm_init(&vm->vm);
+  vm_set_output(&vm->vm, options.output_fd, options.output_capacity, options.output_flush);
+  gc_set_options(&vm->vm.gc, options.gc);
+  vm->vm.quicken = !options.no_quicken;
+  vm->vm.jit = vm->vm.jit && !options.no_jit;
+  vm->vm.memo_capacity = options.memo_capacity;
+  vm->vm.host = vm;
+  vm->options = options;
+  va_array_init(Tyger_VM_Host, vm->hosts);
+  va_array_init(Tyger_VM_Chunk, vm->chunks);
+  vm->objects = NULL;
+  vm->program = NULL;
+
+  tyger_allocator_use(previous);
+  return vm;
+}
+
+void tyger_vm_destroy(Tyger_VM *vm)
+{
+  const Tyger_Allocator *previous = tyger_vm_enter_allocator(vm->options.allocator);
+
+  vm_free(&vm->vm);
+  for (size_t i = 0; i < vm->chunks.len; ++i)
+  {
+    chunk_free(&vm->chunks.elems[i].chunk);
+  }
+  va_array_free(vm->chunks);
+  for (size_t i = 0; i < vm->hosts.len; ++i)
+  {
+    tfree(vm->hosts.elems[i].name);
+  }
+  va_array_free(vm->hosts);
+  objects_free(vm->objects);
+  tfree(vm);
+
+  tyger_allocator_use(previous);
+}
+
+void tyger_vm_register(Tyger_VM *vm, const char *name, size_t arity, Tyger_Host_Fn fn, void *user)
+{
+  const Tyger_Allocator *previous = tyger_vm_enter_allocator(vm->options.allocator);
+
+  // NOTE(HS): a name registered again keeps its function, so the one it replaces
+  // doesn't pile up in `objects` for as long as the instance lives
+  bool replaced = false;
+  for (size_t i = 0; i < vm->hosts.len && !replaced; ++i)
+  {
+    if (strcmp(vm->hosts.elems[i].name, name) == 0)
+    {
+      vm_host_function_replace(&vm->vm, vm->hosts.elems[i].function, arity, fn, user);
+      replaced = true;
+    }
+  }
+  if (!replaced)
+  {
+    Obj_Function *function = vm_host_function_new(&vm->vm, &vm->objects, name, arity, fn, user);
+    Tyger_VM_Host host = { .name = tyger_copy_string(name), .function = function };
+    va_array_append(vm->hosts, host);
+  }
+
+  tyger_allocator_use(previous);
+}
+
+Tyger_Error tyger_vm_run(Tyger_VM *vm, const Tyger_Program *program, const Tyger_Global *globals, size_t globals_len)
+{
+  const Tyger_Allocator *previous = tyger_vm_enter_allocator(vm->options.allocator);
+  Chunk *chunk = tyger_vm_chunk(vm, program);
+
+  // NOTE(HS): slots mean something different to each program, so every run starts from
+  // the host's globals alone (the rest are nil)
+  vm->vm.globals.len = 0;
+  vm->vm.globals_version += 1;
+  vm->program = program;
+
+  Tyger_Error err = {0};
+  for (size_t slot = 0; slot < program->host_globals_len && err.kind == TYERR_NONE; ++slot)
+  {
+    Value value;
+    if (tyger_vm_host_global(vm, program->global_names[slot], globals, globals_len, &value))
+    {
+      gc_write_barrier(&vm->vm.gc, value);
+      va_array_append(vm->vm.globals, value);
+    }
+    else
+    {
+      char message[256];
+      snprintf(message, sizeof(message), "host global `%s` was not provided", program->global_names[slot]);
+      err = tyger_host_error(TYERR_UNDEFINED_IDENT, message);
+    }
+  }
+
+  if (err.kind == TYERR_NONE)
+  {
+    err = vm_run(&vm->vm, chunk);
+  }
+  if (err.kind != TYERR_NONE)
+  {
+    err.location = location_from_pos(err.source ? err.source : program->source, err.location.pos);
+  }
+
+  tyger_allocator_use(previous);
+  return err;
+}
+
+void tyger_vm_forget_program(Tyger_VM *vm, const Tyger_Program *program)
+{
+  const Tyger_Allocator *previous = tyger_vm_enter_allocator(vm->options.allocator);
+
+  // NOTE(HS): the globals may hold closures of the copy's functions
+  if (vm->program == program)
+  {
+    vm->vm.globals.len = 0;
+    vm->vm.globals_version += 1;
+    vm->program = NULL;
+  }
+
+  size_t index = tyger_vm_chunk_index(vm, program->id);
+  if (index < vm->chunks.len)
+  {
+    chunk_free(&vm->chunks.elems[index].chunk);
+    vm->chunks.elems[index] = vm->chunks.elems[vm->chunks.len - 1];
+    vm->chunks.len -= 1;
+  }
+
+  tyger_allocator_use(previous);
+}
+
+bool tyger_vm_get_global(const Tyger_VM *vm, const char *name, Value *value)
+{
+  const Tyger_Program *program = vm->program;
+  for (size_t slot = 0; program && slot < program->global_count; ++slot)
+  {
+    if (strcmp(program->global_names[slot], name) == 0 && slot < vm->vm.globals.len)
+    {
+      *value = vm->vm.globals.elems[slot];
+      return true;
+    }
+  }
+  return false;
+}
+
+Value tyger_vm_string(Tyger_VM *vm, const char *chars, size_t len)
+{
+  const Tyger_Allocator *previous = tyger_vm_enter_allocator(vm->options.allocator);
+  Value str = gc_string_new(&vm->vm.gc, chars, len);
+  tyger_allocator_use(previous);
+  return str;
+}
+
+Tyger_Error tyger_host_error(Tyger_Error_Kind kind, const char *message)
+{
+  Tyger_Error err = {
+    .kind = kind,
+    .location = { .pos = 0, .col = 0, .line = 0 },
+    .message = tyger_copy_string(message),
+  };
+  return err;
+}
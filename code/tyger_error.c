@@ -0,0 +1,50 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_OTHER
+#include <assert.h>
+#include <stdio.h>
+#include "tyger_error.h"
+#include "tmemory.h"
+
+void tyger_error_free(Tyger_Error *err)
+{
+  tfree((void*) err->message);
+  err->message = NULL;
+}
+
+const char *tyger_error_kind_to_string(Tyger_Error_Kind kind)
+{
+  const char *str;
+
+  switch (kind)
+  {
+#define X(NAME) case TYERR_##NAME: { str = #NAME; } break;
+    #include "defs/tyger-error-kind.def"
+#undef X
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid error kind encountered: %i\n", kind);
+    str = NULL;
+    assert(0);
+  } break;
+  }
+
+  return str;
+}
+
+Location location_from_pos(const char *program, size_t pos)
+{
+  Location location = { .pos = pos, .col = 0, .line = 0 };
+  for (size_t i = 0; i < pos && program[i] != '\0'; ++i)
+  {
+    if (program[i] == '\n')
+    {
+      location.line += 1;
+      location.col = 0;
+    }
+    else
+    {
+      location.col += 1;
+    }
+  }
+  return location;
+}
@@ -0,0 +1,383 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "value.h"
+#include "bigint.h"
+#include "chunk.h"
+#include "util.h"
+
+///
+/// internal functions
+///
+
+static Obj_String *obj_string_alloc(Obj **objects, size_t len)
+{
+  Obj_String *str = tmalloc(sizeof(Obj_String) + len + 1);
+  assert(str);
+
+  str->obj.kind = OBJ_STRING;
+  str->obj.color = OBJ_UNMANAGED;
+  str->obj.next = *objects;
+  str->len = len;
+  str->hash = 0;
+  str->interned = false;
+  str->chars = (char*) (str + 1);
+  str->chars[len] = '\0';
+
+  *objects = &str->obj;
+  return str;
+}
+
+
+///
+/// public functions
+///
+
+const char *value_kind_to_string(Value_Kind kind)
+{
+  const char *str;
+
+  switch (kind)
+  {
+#define X(NAME) case VAL_##NAME: { str = #NAME; } break;
+    #include "defs/value-kind.def"
+#undef X
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid value kind encountered: %i\n", kind);
+    str = NULL;
+    assert(0);
+  } break;
+  }
+
+  return str;
+}
+
+const char *object_kind_to_string(Object_Kind kind)
+{
+  const char *str;
+
+  switch (kind)
+  {
+#define X(NAME) case OBJ_##NAME: { str = #NAME; } break;
+    #include "defs/object-kind.def"
+#undef X
+
+  default:
+  {
+    fprintf(stderr, "[ERROR] Invalid object kind encountered: %i\n", kind);
+    str = NULL;
+    assert(0);
+  } break;
+  }
+
+  return str;
+}
+
+const char *value_type_name(Value v)
+{
+  const char *name;
+
+  switch (v.kind)
+  {
+  case VAL_NIL:  { name = "nil"; } break;
+  case VAL_BOOL: { name = "bool"; } break;
+  case VAL_INT:  { name = "int"; } break;
+  case VAL_SHORT_STR: { name = "string"; } break;
+  case VAL_OBJ:
+  {
+    switch (v.as.obj->kind)
+    {
+    case OBJ_STRING:   { name = "string"; } break;
+    case OBJ_ROPE:     { name = "string"; } break;
+    case OBJ_BIGINT:   { name = "int"; } break;
+    case OBJ_FUNCTION: { name = "func"; } break;
+    case OBJ_CLOSURE:  { name = "func"; } break;
+    default:         { name = "object"; } break;
+    }
+  } break;
+
+  default:
+  {
+    name = NULL;
+    assert(0 && "Invalid Value_Kind");
+  } break;
+  }
+
+  return name;
+}
+
+bool value_equals(Value a, Value b)
+{
+  if (a.kind != b.kind)
+  {
+    return false;
+  }
+
+  bool result = false;
+  switch (a.kind)
+  {
+  case VAL_NIL:  { result = true; } break;
+  case VAL_BOOL: { result = a.as.boolean == b.as.boolean; } break;
+  case VAL_INT:  { result = a.as.integer == b.as.integer; } break;
+  case VAL_OBJ:
+  {
+    if (a.as.obj == b.as.obj)
+    {
+      result = true;
+    }
+    else if (value_is_obj_kind(a, OBJ_STRING) && value_is_obj_kind(b, OBJ_STRING))
+    {
+      const Obj_String *lhs = value_as_string(a);
+      const Obj_String *rhs = value_as_string(b);
+      result =
+        !(lhs->interned && rhs->interned) &&
+        lhs->hash == rhs->hash &&
+        lhs->len == rhs->len &&
+        memcmp(lhs->chars, rhs->chars, lhs->len) == 0;
+    }
+    else if (value_is_string(a) && value_is_string(b) && value_string_len(a) == value_string_len(b))
+    {
+      String_View lhs = value_string_view(&a);
+      String_View rhs = value_string_view(&b);
+      result = memcmp(lhs.str, rhs.str, lhs.len) == 0;
+    }
+    else if (value_is_bigint(a) && value_is_bigint(b))
+    {
+      result = bigint_compare(a, b) == 0;
+    }
+  } break;
+
+  case VAL_SHORT_STR:
+  {
+    result = a.short_len == b.short_len && memcmp(a.as.chars, b.as.chars, a.short_len) == 0;
+  } break;
+
+  default:
+  {
+    assert(0 && "Invalid Value_Kind");
+  } break;
+  }
+
+  return result;
+}
+
+void value_write(Output *out, Value v)
+{
+  switch (v.kind)
+  {
+  case VAL_NIL:  { output_puts(out, "nil"); } break;
+  case VAL_BOOL: { output_puts(out, v.as.boolean ? "true" : "false"); } break;
+  case VAL_SHORT_STR: { output_write(out, v.as.chars, v.short_len); } break;
+  case VAL_INT:
+  {
+    char digits[24];
+    int len = snprintf(digits, sizeof(digits), "%" PRId64, v.as.integer);
+    output_write(out, digits, (size_t) len);
+  } break;
+
+  case VAL_OBJ:
+  {
+    switch (v.as.obj->kind)
+    {
+    case OBJ_STRING:
+    case OBJ_ROPE:
+    {
+      String_View str = value_string_view(&v);
+      output_write(out, str.str, str.len);
+    } break;
+
+    case OBJ_BIGINT:
+    {
+      char *digits = bigint_to_decimal(value_as_bigint(v));
+      output_puts(out, digits);
+      tfree(digits);
+    } break;
+
+    case OBJ_FUNCTION:
+    case OBJ_CLOSURE:
+    {
+      const Obj_Function *function = value_callee_function(v);
+      output_puts(out, "<func");
+      if (function->name)
+      {
+        output_putc(out, ' ');
+        output_write(out, function->name->chars, function->name->len);
+      }
+      output_putc(out, '>');
+    } break;
+
+    default:
+    {
+      fprintf(stderr, "[ERROR] Unhandled Object_Kind %s\n", object_kind_to_string(v.as.obj->kind));
+      assert(0);
+    } break;
+    }
+  } break;
+
+  default:
+  {
+    assert(0 && "Invalid Value_Kind");
+  } break;
+  }
+}
+
+uint32_t string_hash(const char *chars, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i)
+  {
+    h ^= (uint8_t) chars[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+Value value_string_new(Obj **objects, const char *chars, size_t len)
+{
+  if (len <= VALUE_SHORT_STRING_MAX)
+  {
+    return make_short_string_value(chars, len);
+  }
+  return make_obj_value(&obj_string_new(objects, chars, len)->obj);
+}
+
+Obj_String *obj_string_new(Obj **objects, const char *chars, size_t len)
+{
+  Obj_String *str = obj_string_alloc(objects, len);
+  memcpy(str->chars, chars, len);
+  str->hash = string_hash(str->chars, len);
+  return str;
+}
+
+Obj_String *obj_string_concat(Obj **objects, String_View lhs, String_View rhs)
+{
+  Obj_String *str = obj_string_alloc(objects, lhs.len + rhs.len);
+  memcpy(str->chars, lhs.str, lhs.len);
+  memcpy(str->chars + lhs.len, rhs.str, rhs.len);
+  str->hash = string_hash(str->chars, str->len);
+  return str;
+}
+
+Obj_Rope *obj_rope_new(Obj **objects, Value left, Value right)
+{
+  Obj_Rope *rope = tmalloc(sizeof(Obj_Rope));
+  assert(rope);
+
+  rope->obj.kind = OBJ_ROPE;
+  rope->obj.color = OBJ_UNMANAGED;
+  rope->obj.next = *objects;
+  rope->len = value_string_len(left) + value_string_len(right);
+  rope->left = left;
+  rope->right = right;
+  rope->flat = NULL;
+  rope->flat_counted = false;
+
+  *objects = &rope->obj;
+  return rope;
+}
+
+const char *obj_rope_flatten(Obj_Rope *rope)
+{
+  if (rope->flat)
+  {
+    return rope->flat;
+  }
+
+  char *flat = tmalloc(rope->len + 1);
+  assert(flat);
+  flat[rope->len] = '\0';
+
+  // NOTE(HS): the buffer is filled from the end, walking the tree right to left with
+  // an explicit stack as ropes built by appending in a loop are as deep as the loop
+  // is long. Ropes already flattened are copied from directly.
+  Value_VaArray pending;
+  va_array_init(Value, pending);
+  va_array_append(pending, rope->left);
+  va_array_append(pending, rope->right);
+
+  size_t end = rope->len;
+  while (pending.len > 0)
+  {
+    Value v = pending.elems[--pending.len];
+    if (value_is_obj_kind(v, OBJ_ROPE) && !value_as_rope(v)->flat)
+    {
+      va_array_append(pending, value_as_rope(v)->left);
+      va_array_append(pending, value_as_rope(v)->right);
+      continue;
+    }
+
+    String_View part = value_string_view(&v);
+    end -= part.len;
+    memcpy(flat + end, part.str, part.len);
+  }
+  assert(end == 0);
+  va_array_free(pending);
+
+  rope->flat = flat;
+  rope->left = make_nil_value();
+  rope->right = make_nil_value();
+  return flat;
+}
+
+size_t obj_size(const Obj *obj)
+{
+  size_t size = 0;
+
+  switch (obj->kind)
+  {
+  case OBJ_STRING:   { size = sizeof(Obj_String) + ((const Obj_String*) obj)->len + 1; } break;
+  case OBJ_FUNCTION: { size = sizeof(Obj_Function); } break;
+  case OBJ_BIGINT:   { size = sizeof(Obj_Bigint) + ((const Obj_Bigint*) obj)->len * sizeof(uint32_t); } break;
+  case OBJ_UPVALUE:  { size = sizeof(Obj_Upvalue); } break;
+  case OBJ_CLOSURE:
+  {
+    const Obj_Closure *closure = (const Obj_Closure*) obj;
+    size = sizeof(Obj_Closure) + closure->function->upvalue_count * sizeof(Obj_Upvalue*);
+  } break;
+  case OBJ_ROPE:
+  {
+    const Obj_Rope *rope = (const Obj_Rope*) obj;
+    size = sizeof(Obj_Rope) + (rope->flat ? rope->len + 1 : 0);
+  } break;
+
+  default:
+  {
+    assert(0 && "Invalid Object_Kind");
+  } break;
+  }
+
+  return size;
+}
+
+void obj_free(Obj *obj)
+{
+  switch (obj->kind)
+  {
+  case OBJ_FUNCTION: { obj_function_free((Obj_Function*) obj); } break;
+  case OBJ_ROPE:
+  {
+    tfree(((Obj_Rope*) obj)->flat);
+    tfree(obj);
+  } break;
+
+  default:
+  {
+    tfree(obj);
+  } break;
+  }
+}
+
+void objects_free(Obj *objects)
+{
+  while (objects)
+  {
+    Obj *next = objects->next;
+    obj_free(objects);
+    objects = next;
+  }
+}
@@ -0,0 +1,981 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "vm_internal.h"
+#include "bigint.h"
+#include "exec_counters.h"
+#include "builtin.h"
+#include "jit.h"
+#include "opcode_profile.h"
+#include "phase_trace.h"
+#include "sample_profile.h"
+#include "tstrings.h"
+#include "util.h"
+
+///
+/// internal functions
+///
+
+static Tyger_Error vm_runtime_error(
+  const Chunk *chunk, const uint8_t *instruction, Tyger_Error_Kind kind, const char *fmt, ...
+)
+{
+  String_Builder sb;
+  string_builder_init(&sb);
+
+  va_list args;
+  va_start(args, fmt);
+  char message[256];
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  string_builder_append(&sb, message);
+
+  size_t offset = (size_t) (instruction - chunk->code.elems);
+  Tyger_Error err = {
+    .kind = kind,
+    .location = { .pos = chunk_position_of(chunk, offset), .col = 0, .line = 0 },
+    .message = string_builder_to_cstring(&sb),
+    .source = chunk->source,
+  };
+  string_builder_free(&sb);
+
+  return err;
+}
+
+/// records the call stack, `ip` being where the running frame is
+static void vm_sample(const VM *vm, Sample_Profile *sampler, const uint8_t *ip)
+{
+  sampler->pending = 0;
+
+  size_t first = vm->frame_count > SAMPLE_PROFILE_MAX_DEPTH
+    ? vm->frame_count - SAMPLE_PROFILE_MAX_DEPTH
+    : 0;
+
+  Sample_Frame frames[SAMPLE_PROFILE_MAX_DEPTH];
+  size_t len = 0;
+  for (size_t i = first; i < vm->frame_count; ++i)
+  {
+    const Call_Frame *frame = &vm->frames[i];
+
+    // NOTE(HS): a frame which isn't running is at the instruction after its call
+    const uint8_t *at = i + 1 == vm->frame_count ? ip : frame->ip - 1;
+    size_t offset = (size_t) (at - frame->chunk->code.elems);
+
+    // NOTE(HS): the first frame runs the script, every other one a function's chunk
+    const Obj_Function *function = i == 0
+      ? NULL
+      : (const Obj_Function*) ((const char*) frame->chunk - offsetof(Obj_Function, chunk));
+
+    frames[len++] = (Sample_Frame) {
+      .function = function,
+      .pos = chunk_position_of(frame->chunk, offset),
+    };
+  }
+
+  sample_profile_record(sampler, frames, len);
+}
+
+/// compiles `function`, whose body was only pre-parsed, before its first call
+static Tyger_Error vm_compile_lazy(VM *vm, Obj_Function *function)
+{
+  if (!vm->compile_lazy)
+  {
+    const char *message = "function body was only pre-parsed and can't be compiled";
+    char *owned = tmalloc(strlen(message) + 1);
+    assert(owned);
+    strcpy(owned, message);
+    Tyger_Error err = {
+      .kind = TYERR_UNSUPPORTED,
+      .location = { .pos = function->pos, .col = 0, .line = 0 },
+      .message = owned,
+      .source = function->lazy_source,
+    };
+    return err;
+  }
+
+  // NOTE(HS): errors in the body are positions in the source it was written in
+  const char *source = function->lazy_source;
+  Tyger_Error err = vm->compile_lazy(vm->compile_lazy_context, function);
+  if (err.kind != TYERR_NONE && !err.source)
+  {
+    err.source = source;
+  }
+  assert(err.kind != TYERR_NONE || !function->lazy_source);
+
+  // NOTE(HS): the body can only use globals which have already been declared, by
+  // programs which have run
+  assert(err.kind != TYERR_NONE || function->chunk.global_count <= vm->globals.len);
+  return err;
+}
+
+/// compiles `chunk` now that it's hot, leaving it to the interpreter if it can't be
+static void vm_jit_compile(Chunk *chunk)
+{
+  Phase_Scope phase = phase_begin("jit");
+  chunk->jit = jit_compile(chunk);
+  chunk->jit_disabled = chunk->jit == NULL;
+  phase_end(phase);
+}
+
+/// a guard of `chunk`'s code failed, code whose guards keep failing is thrown away
+static void vm_jit_deopt(Chunk *chunk)
+{
+  chunk->jit->deopts += 1;
+  if (chunk->jit->deopts > JIT_MAX_DEOPTS)
+  {
+    jit_code_free(chunk->jit);
+    chunk->jit = NULL;
+    chunk->jit_disabled = true;
+  }
+}
+
+
+///
+/// public functions
+///
+
+Obj_Function *vm_host_function_new(
+  VM *vm, Obj **objects, const char *name, size_t arity, Tyger_Host_Fn fn, void *user
+)
+{
+  assert(vm->hosts.len < CHUNK_OPERAND_MAX);
+  Obj_String *function_name = obj_string_new(objects, name, strlen(name));
+  Obj_Function *function = obj_function_new(objects, function_name, arity);
+  chunk_write(&function->chunk, OPC_CALL_HOST, 0);
+  chunk_write_operand(&function->chunk, (uint16_t) vm->hosts.len, 0);
+  chunk_write(&function->chunk, OPC_RETURN, 0);
+  function->chunk.max_stack = arity + 1;
+
+  Vm_Host host = { .fn = fn, .user = user };
+  va_array_append(vm->hosts, host);
+  return function;
+}
+
+void vm_host_function_replace(VM *vm, Obj_Function *function, size_t arity, Tyger_Host_Fn fn, void *user)
+{
+  assert(function->chunk.code.elems[0] == OPC_CALL_HOST);
+  uint16_t index = chunk_read_operand(function->chunk.code.elems + 1);
+  vm->hosts.elems[index] = (Vm_Host) { .fn = fn, .user = user };
+  function->arity = arity;
+  function->chunk.arity = arity;
+  function->chunk.max_stack = arity + 1;
+}
+
+void vm_set_output(VM *vm, int fd, size_t capacity, Output_Flush flush)
+{
+  output_free(&vm->out);
+  output_init(&vm->out, fd, capacity, flush);
+}
+
+// NOTE(HS): `ip` always points at the byte after the opcode currently executing, so
+// `ip - 1` is the instruction itself
+#define VM_PUSH(V) (*sp++ = (V))
+#define VM_POP() (*--sp)
+#define VM_PEEK(N) (sp[-1 - (N)])
+#define VM_READ_OPERAND() (ip += CHUNK_OPERAND_SIZE, chunk_read_operand(ip - CHUNK_OPERAND_SIZE))
+
+/// offset of the executing instruction once its `OPERANDS` operands have been read
+#define VM_INSTRUCTION_OFFSET(OPERANDS) \
+  ((size_t) (ip - chunk->code.elems) - 1 - (OPERANDS) * CHUNK_OPERAND_SIZE)
+
+/// runs `COUNT` when the VM is counting what it executes, in builds without counters
+/// there is nothing to run or check
+#if EXEC_COUNTERS_ENABLED
+#define VM_COUNTING (counters != NULL)
+#define VM_COUNT(COUNT)                         \
+  do {                                          \
+    if (counters) {                             \
+      COUNT;                                    \
+    }                                           \
+  } while (0)
+#else
+#define VM_COUNTING false
+#define VM_COUNT(COUNT) do { } while (0)
+#endif
+
+/// rewrites the executing instruction into its specialised form `OP`
+///
+/// NOTE(HS): a superinstruction runs the generic form of its components and is never
+/// quickened, its first component's opcode byte is the superinstruction itself
+#define VM_QUICKEN(OP)                                                  \
+  do {                                                                  \
+    if (vm->quicken && !opcode_is_superinstruction((Opcode) instruction)) { \
+      ip[-1] = (uint8_t) (OP);                                          \
+    }                                                                   \
+  } while (0)
+
+/// a specialised instruction's guard failed, rewrite it back into its generic form
+/// `OP` and re-dispatch so the generic form handles (and possibly re-quickens) it
+#define VM_DEQUICKEN(OP)                        \
+  do {                                          \
+    ip -= 1;                                    \
+    *ip = (uint8_t) (OP);                       \
+  } while (0)
+
+/// lets the collector catch up with allocation, only used straight after an
+/// instruction which may allocate has pushed its result
+#define VM_GC_SAFEPOINT()                       \
+  do {                                          \
+    if (gc_should_step(&vm->gc)) {              \
+      vm_gc_step(vm, sp);                       \
+    }                                           \
+  } while (0)
+
+/// runs the running chunk's compiled code from `ip` (when it has any which can be
+/// entered there), carrying on from the instruction it stops at
+#define VM_JIT_ENTER()                                                  \
+  do {                                                                  \
+    if (jit && chunk->jit) {                                            \
+      Jit_Frame jit_frame = {                                           \
+        .slots = slots, .globals = globals, .sp = sp, .exit_offset = 0, .deopt = false, \
+      };                                                                \
+      if (jit_enter(chunk->jit, (size_t) (ip - chunk->code.elems), &jit_frame)) { \
+        sp = jit_frame.sp;                                              \
+        ip = chunk->code.elems + jit_frame.exit_offset;                 \
+        if (jit_frame.deopt) {                                          \
+          vm_jit_deopt(chunk);                                          \
+        }                                                               \
+      }                                                                 \
+    }                                                                   \
+  } while (0)
+
+/// counts a call or loop iteration of the running chunk, which is compiled once it
+/// reaches `vm->jit_threshold`, then enters its code
+#define VM_JIT_HOT()                                                    \
+  do {                                                                  \
+    if (jit && !chunk->jit && !chunk->jit_disabled                      \
+        && ++chunk->jit_hotness >= vm->jit_threshold) {                 \
+      vm_jit_compile(chunk);                                            \
+    }                                                                   \
+    VM_JIT_ENTER();                                                     \
+  } while (0)
+
+#define VM_RUNTIME_ERROR(KIND, ...) vm_runtime_error(chunk, ip - 1, (KIND), __VA_ARGS__)
+
+#define VM_BINARY_TYPE_ERROR(OP_STR, LHS, RHS)                          \
+  VM_RUNTIME_ERROR(                                                     \
+    TYERR_TYPE_MISMATCH, "unsupported operand types for %s: %s and %s", \
+    (OP_STR), value_type_name((LHS)), value_type_name((RHS))            \
+  )
+
+#define VM_BOTH_INT(LHS, RHS) ((LHS).kind == VAL_INT && (RHS).kind == VAL_INT)
+
+/// generic integer operator, quickens into `QUICK_OP` when both operands are ints,
+/// `INT_OP` handles two ints and `BIG_OP` any other pair of integers
+#define VM_GENERIC_INT_OP(QUICK_OP, OP_STR, INT_OP, BIG_OP)             \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    Value lhs = VM_PEEK(1);                                             \
+    if (VM_BOTH_INT(lhs, rhs)) {                                        \
+      VM_QUICKEN(QUICK_OP);                                             \
+      sp -= 1;                                                          \
+      INT_OP(lhs, rhs);                                                 \
+    } else if (value_is_integer(lhs) && value_is_integer(rhs)) {        \
+      sp -= 1;                                                          \
+      BIG_OP(lhs, rhs);                                                 \
+    } else {                                                            \
+      return VM_BINARY_TYPE_ERROR((OP_STR), lhs, rhs);                  \
+    }                                                                   \
+  } while (0)
+
+/// specialised integer operator, falls back to `GENERIC_OP` when the guard fails
+#define VM_QUICK_INT_OP(GENERIC_OP, INT_OP)                     \
+  do {                                                          \
+    Value rhs = VM_PEEK(0);                                     \
+    Value lhs = VM_PEEK(1);                                     \
+    if (!VM_BOTH_INT(lhs, rhs)) {                               \
+      VM_DEQUICKEN(GENERIC_OP);                                 \
+      break;                                                    \
+    }                                                           \
+    sp -= 1;                                                    \
+    INT_OP(lhs, rhs);                                           \
+  } while (0)
+
+/// checked int arithmetic, the result is promoted to a bigint on overflow
+///
+/// NOTE(HS): the overflow check compiles to a branch on the flags the operation sets
+/// itself, so an int result costs one instruction and a branch which isn't taken
+#define VM_INT_ARITH(LHS, RHS, OVERFLOWS, BIG_OP)                       \
+  do {                                                                  \
+    int64_t int_result;                                                 \
+    if (OVERFLOWS((LHS).as.integer, (RHS).as.integer, &int_result)) {   \
+      VM_BIG_ARITH((LHS), (RHS), BIG_OP);                               \
+    } else {                                                            \
+      sp[-1] = make_int_value(int_result);                              \
+    }                                                                   \
+  } while (0)
+
+/// bigints are allocated, so arithmetic on them is an allocating instruction
+#define VM_BIG_ARITH(LHS, RHS, BIG_OP)                                  \
+  do {                                                                  \
+    sp[-1] = BIG_OP(&vm->gc, (LHS), (RHS));                             \
+    VM_GC_SAFEPOINT();                                                  \
+  } while (0)
+
+#define VM_INT_CMP(LHS, RHS, CMP) (sp[-1] = make_bool_value((LHS).as.integer CMP (RHS).as.integer))
+#define VM_BIG_CMP(LHS, RHS, CMP) (sp[-1] = make_bool_value(bigint_compare((LHS), (RHS)) CMP 0))
+
+#define VM_INT_ADD(LHS, RHS) VM_INT_ARITH(LHS, RHS, int_add_overflow, bigint_add)
+#define VM_INT_SUB(LHS, RHS) VM_INT_ARITH(LHS, RHS, int_sub_overflow, bigint_sub)
+#define VM_INT_MUL(LHS, RHS) VM_INT_ARITH(LHS, RHS, int_mul_overflow, bigint_mul)
+#define VM_BIG_ADD(LHS, RHS) VM_BIG_ARITH(LHS, RHS, bigint_add)
+#define VM_BIG_SUB(LHS, RHS) VM_BIG_ARITH(LHS, RHS, bigint_sub)
+#define VM_BIG_MUL(LHS, RHS) VM_BIG_ARITH(LHS, RHS, bigint_mul)
+
+#define VM_INT_EQ(LHS, RHS)     VM_INT_CMP(LHS, RHS, ==)
+#define VM_INT_NOT_EQ(LHS, RHS) VM_INT_CMP(LHS, RHS, !=)
+#define VM_INT_LT(LHS, RHS)     VM_INT_CMP(LHS, RHS, <)
+#define VM_INT_GT(LHS, RHS)     VM_INT_CMP(LHS, RHS, >)
+#define VM_INT_LTE(LHS, RHS)    VM_INT_CMP(LHS, RHS, <=)
+#define VM_INT_GTE(LHS, RHS)    VM_INT_CMP(LHS, RHS, >=)
+#define VM_BIG_LT(LHS, RHS)     VM_BIG_CMP(LHS, RHS, <)
+#define VM_BIG_GT(LHS, RHS)     VM_BIG_CMP(LHS, RHS, >)
+#define VM_BIG_LTE(LHS, RHS)    VM_BIG_CMP(LHS, RHS, <=)
+#define VM_BIG_GTE(LHS, RHS)    VM_BIG_CMP(LHS, RHS, >=)
+
+/// `INT64_MIN / -1` is the one int division whose result isn't an int
+#define VM_INT_DIV_OVERFLOWS(LHS, RHS) ((LHS).as.integer == INT64_MIN && (RHS).as.integer == -1)
+
+///
+/// instruction bodies
+///
+/// NOTE(HS): each instruction's body is a macro so superinstructions can be built by
+/// running their components' bodies back to back, see `defs/superinstruction.def`
+///
+
+#define VM_OP_LOAD_CONST()                      \
+  do {                                          \
+    uint16_t index = VM_READ_OPERAND();         \
+    VM_PUSH(constants[index]);                  \
+  } while (0)
+
+#define VM_OP_LOAD_NIL()   VM_PUSH(make_nil_value())
+#define VM_OP_LOAD_TRUE()  VM_PUSH(make_bool_value(true))
+#define VM_OP_LOAD_FALSE() VM_PUSH(make_bool_value(false))
+
+#define VM_OP_POP() (sp -= 1)
+
+#define VM_OP_POPN()                            \
+  do {                                          \
+    uint16_t n = VM_READ_OPERAND();             \
+    sp -= n;                                    \
+  } while (0)
+
+/// NOTE(HS): the slots an optimised function keeps its values in, made when it's entered
+#define VM_OP_RESERVE()                         \
+  do {                                          \
+    uint16_t n = VM_READ_OPERAND();             \
+    for (uint16_t i = 0; i < n; ++i) {          \
+      VM_PUSH(make_nil_value());                \
+    }                                           \
+  } while (0)
+
+#define VM_OP_LOAD_GLOBAL()                     \
+  do {                                          \
+    uint16_t slot = VM_READ_OPERAND();          \
+    VM_PUSH(globals[slot]);                     \
+  } while (0)
+
+#define VM_OP_STORE_GLOBAL()                    \
+  do {                                          \
+    uint16_t slot = VM_READ_OPERAND();          \
+    if (value_callee_function(globals[slot])) { \
+      vm->globals_version += 1;                 \
+    }                                           \
+    globals[slot] = VM_POP();                   \
+    gc_write_barrier(&vm->gc, globals[slot]);   \
+  } while (0)
+
+#define VM_OP_LOAD_LOCAL()                      \
+  do {                                          \
+    uint16_t slot = VM_READ_OPERAND();          \
+    VM_PUSH(slots[slot]);                       \
+  } while (0)
+
+#define VM_OP_STORE_LOCAL()                     \
+  do {                                          \
+    uint16_t slot = VM_READ_OPERAND();          \
+    slots[slot] = VM_POP();                     \
+  } while (0)
+
+#define VM_OP_LOAD_UPVALUE()                    \
+  do {                                          \
+    uint16_t slot = VM_READ_OPERAND();          \
+    VM_PUSH(*upvalues[slot]->location);         \
+  } while (0)
+
+#define VM_OP_STORE_UPVALUE()                             \
+  do {                                                    \
+    uint16_t slot = VM_READ_OPERAND();                    \
+    *upvalues[slot]->location = VM_POP();                 \
+    gc_write_barrier(&vm->gc, *upvalues[slot]->location); \
+  } while (0)
+
+/// pops the `n` locals of a scope, some of which were captured
+#define VM_OP_CLOSE_UPVALUES()                  \
+  do {                                          \
+    uint16_t n = VM_READ_OPERAND();             \
+    sp -= n;                                    \
+    vm_close_upvalues(vm, sp);                  \
+  } while (0)
+
+#define VM_OP_NEGATE()                                                  \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    if (rhs.kind == VAL_INT && rhs.as.integer != INT64_MIN) {           \
+      sp[-1] = make_int_value(-rhs.as.integer);                         \
+    } else if (value_is_integer(rhs)) {                                 \
+      sp[-1] = bigint_negate(&vm->gc, rhs);                             \
+      VM_GC_SAFEPOINT();                                                \
+    } else {                                                            \
+      return VM_RUNTIME_ERROR(                                          \
+        TYERR_TYPE_MISMATCH, "unsupported operand type for -: %s", value_type_name(rhs) \
+      );                                                                \
+    }                                                                   \
+  } while (0)
+
+#define VM_OP_NOT() (sp[-1] = make_bool_value(!value_is_truthy(sp[-1])))
+
+#define VM_OP_ADD()                                                     \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    Value lhs = VM_PEEK(1);                                             \
+    if (VM_BOTH_INT(lhs, rhs)) {                                        \
+      VM_QUICKEN(OPC_ADD_INT_INT);                                      \
+      sp -= 1;                                                          \
+      VM_INT_ADD(lhs, rhs);                                             \
+    } else if (value_is_integer(lhs) && value_is_integer(rhs)) {        \
+      sp -= 1;                                                          \
+      VM_BIG_ADD(lhs, rhs);                                             \
+    } else if (value_is_string(lhs) && value_is_string(rhs)) {          \
+      VM_QUICKEN(OPC_CONCAT_STR_STR);                                   \
+      sp -= 1;                                                          \
+      sp[-1] = gc_string_concat(&vm->gc, lhs, rhs);                     \
+      VM_GC_SAFEPOINT();                                                \
+    } else {                                                            \
+      return VM_BINARY_TYPE_ERROR("+", lhs, rhs);                       \
+    }                                                                   \
+  } while (0)
+
+#define VM_OP_SUB() VM_GENERIC_INT_OP(OPC_SUB_INT_INT, "-", VM_INT_SUB, VM_BIG_SUB)
+#define VM_OP_MUL() VM_GENERIC_INT_OP(OPC_MUL_INT_INT, "*", VM_INT_MUL, VM_BIG_MUL)
+#define VM_OP_LT()  VM_GENERIC_INT_OP(OPC_LT_INT_INT, "<", VM_INT_LT, VM_BIG_LT)
+#define VM_OP_GT()  VM_GENERIC_INT_OP(OPC_GT_INT_INT, ">", VM_INT_GT, VM_BIG_GT)
+#define VM_OP_LTE() VM_GENERIC_INT_OP(OPC_LTE_INT_INT, "<=", VM_INT_LTE, VM_BIG_LTE)
+#define VM_OP_GTE() VM_GENERIC_INT_OP(OPC_GTE_INT_INT, ">=", VM_INT_GTE, VM_BIG_GTE)
+
+#define VM_OP_DIV()                                                     \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    Value lhs = VM_PEEK(1);                                             \
+    if (!(value_is_integer(lhs) && value_is_integer(rhs))) {            \
+      return VM_BINARY_TYPE_ERROR("/", lhs, rhs);                       \
+    }                                                                   \
+    if (rhs.kind == VAL_INT && rhs.as.integer == 0) {                   \
+      return VM_RUNTIME_ERROR(TYERR_DIVIDE_BY_ZERO, "division by zero"); \
+    }                                                                   \
+    sp -= 1;                                                            \
+    if (VM_BOTH_INT(lhs, rhs) && !VM_INT_DIV_OVERFLOWS(lhs, rhs)) {     \
+      VM_QUICKEN(OPC_DIV_INT_INT);                                      \
+      sp[-1] = make_int_value(lhs.as.integer / rhs.as.integer);         \
+    } else {                                                            \
+      VM_BIG_ARITH(lhs, rhs, bigint_div);                               \
+    }                                                                   \
+  } while (0)
+
+/// `==` and `!=` work on any values, only ints are worth specialising
+#define VM_EQUALITY_OP(QUICK_OP, NEGATE)                                \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    Value lhs = VM_PEEK(1);                                             \
+    if (VM_BOTH_INT(lhs, rhs)) {                                        \
+      VM_QUICKEN(QUICK_OP);                                             \
+    }                                                                   \
+    sp -= 1;                                                            \
+    sp[-1] = make_bool_value(value_equals(lhs, rhs) != (NEGATE));       \
+  } while (0)
+
+#define VM_OP_EQ()     VM_EQUALITY_OP(OPC_EQ_INT_INT, false)
+#define VM_OP_NOT_EQ() VM_EQUALITY_OP(OPC_NOT_EQ_INT_INT, true)
+
+#define VM_OP_JUMP()                            \
+  do {                                          \
+    uint16_t distance = VM_READ_OPERAND();      \
+    ip += distance;                             \
+  } while (0)
+
+#define VM_OP_JUMP_IF_FALSE()                                           \
+  do {                                                                  \
+    uint16_t distance = VM_READ_OPERAND();                              \
+    bool taken = !value_is_truthy(VM_POP());                            \
+    VM_COUNT(exec_counters_branch(counters, chunk, VM_INSTRUCTION_OFFSET(1), taken)); \
+    if (taken) {                                                        \
+      ip += distance;                                                   \
+    }                                                                   \
+  } while (0)
+
+#define VM_OP_LOOP()                            \
+  do {                                          \
+    uint16_t distance = VM_READ_OPERAND();      \
+    ip -= distance;                             \
+    VM_JIT_HOT();                               \
+  } while (0)
+
+/// calls a builtin, whose arguments are left on the stack for the duration of the
+/// call, arity was checked by the compiler
+#define VM_OP_CALL_NATIVE()                                             \
+  do {                                                                  \
+    uint16_t id = VM_READ_OPERAND();                                    \
+    uint16_t argc = VM_READ_OPERAND();                                  \
+    Value_Span args = { sp - argc, argc };                              \
+    Value result = make_nil_value();                                    \
+    Tyger_Error err = BUILTINS[id].fn(vm, args, &result);               \
+    if (err.kind != TYERR_NONE) {                                       \
+      Tyger_Error located = VM_RUNTIME_ERROR(err.kind, "%s", err.message); \
+      tyger_error_free(&err);                                           \
+      return located;                                                   \
+    }                                                                   \
+    sp = args.elems;                                                    \
+    VM_PUSH(result);                                                    \
+    VM_GC_SAFEPOINT();                                                  \
+  } while (0)
+
+/// calls host function `index` with the running frame's arguments, standing in for the
+/// whole body of a function made by `vm_host_function_new`. Errors are located at the
+/// call, in the caller's frame (whose `ip` is the return address).
+#define VM_OP_CALL_HOST()                                               \
+  do {                                                                  \
+    const Vm_Host *host = &vm->hosts.elems[VM_READ_OPERAND()];          \
+    Value_Span args = { slots, chunk->arity };                          \
+    Value result = make_nil_value();                                    \
+    Tyger_Error err = host->fn(vm->host, host->user, args, &result);    \
+    if (err.kind != TYERR_NONE) {                                       \
+      const Call_Frame *caller = &vm->frames[vm->frame_count - 2];      \
+      Tyger_Error located = vm_runtime_error(                           \
+        caller->chunk, caller->ip - 1, err.kind, "%s", err.message ? err.message : "host function failed" \
+      );                                                                \
+      tyger_error_free(&err);                                           \
+      return located;                                                   \
+    }                                                                   \
+    VM_PUSH(result);                                                    \
+    VM_GC_SAFEPOINT();                                                  \
+  } while (0)
+
+/// checks `CALLEE` can be called with `ARGC` arguments, only done when a call
+/// site's inline cache misses, which is also where a function which was only
+/// pre-parsed is compiled
+#define VM_CHECK_CALL(CALLEE, ARGC)                                     \
+  do {                                                                  \
+    Obj_Function *checked = value_callee_function((CALLEE));            \
+    if (!checked) {                                                     \
+      return VM_RUNTIME_ERROR(                                          \
+        TYERR_NOT_CALLABLE, "value of type %s is not callable", value_type_name((CALLEE)) \
+      );                                                                \
+    }                                                                   \
+    if (checked->arity != (ARGC)) {                                     \
+      return VM_RUNTIME_ERROR(                                          \
+        TYERR_ARITY_MISMATCH, "%s expects %zu argument(s) but was given %u", \
+        checked->name ? checked->name->chars : "function", checked->arity, (unsigned) (ARGC) \
+      );                                                                \
+    }                                                                   \
+    if (checked->lazy_source) {                                         \
+      Tyger_Error lazy_err = vm_compile_lazy(vm, checked);              \
+      if (lazy_err.kind != TYERR_NONE) {                                \
+        return lazy_err;                                                \
+      }                                                                 \
+    }                                                                   \
+  } while (0)
+
+/// pushes a frame for `FUNCTION` (called through `CLOSURE`, if not NULL), whose
+/// arguments start at `ARGS`, and jumps to the start of its code. A call to a `@memo`
+/// function whose result is cached is replaced by the result instead.
+#define VM_ENTER_FUNCTION(FUNCTION, CLOSURE, ARGS, BASE)                           \
+  do {                                                                             \
+    Obj_Function *callee = (FUNCTION);                                             \
+    VM_COUNT(exec_counters_call(counters, callee));                                \
+    size_t args_offset = (size_t) ((ARGS) - vm->stack);                            \
+    size_t base_offset = (size_t) ((BASE) - vm->stack);                            \
+    Memo_Ref memo = { .cache = NULL, .index = 0, .generation = 0 };                \
+    Value memo_result;                                                             \
+    if (callee->memo && vm_memo_call(vm, callee, (ARGS), memo, &memo_result, &memo)) { \
+      sp = vm->stack + base_offset;                                                \
+      VM_PUSH(memo_result);                                                        \
+      break;                                                                       \
+    }                                                                              \
+    size_t stack_len = args_offset + callee->chunk.max_stack;                      \
+    if (vm->frame_count == vm->frame_capacity || stack_len > vm->stack_capacity) { \
+      if (!vm_reserve(vm, vm->frame_count + 1, stack_len, &sp)) {                  \
+        return VM_RUNTIME_ERROR(TYERR_STACK_OVERFLOW, "stack overflow");           \
+      }                                                                            \
+      frame = &vm->frames[vm->frame_count - 1];                                    \
+      slots = frame->slots;                                                        \
+    }                                                                              \
+    frame->ip = ip;                                                                \
+    frame = &vm->frames[vm->frame_count++];                                        \
+    *frame = (Call_Frame) {                                                        \
+      .chunk = &callee->chunk,                                                     \
+      .ip = callee->chunk.code.elems,                                              \
+      .slots = vm->stack + args_offset,                                            \
+      .base = vm->stack + base_offset,                                             \
+      .closure = (CLOSURE),                                                        \
+      .memo = memo,                                                                \
+    };                                                                             \
+    chunk = frame->chunk;                                                          \
+    ip = frame->ip;                                                                \
+    slots = frame->slots;                                                          \
+    constants = chunk->constants.elems;                                            \
+    upvalues = frame->closure ? frame->closure->upvalues : NULL;                   \
+    VM_JIT_HOT();                                                                  \
+  } while (0)
+
+/// replaces the running frame with a call to `FUNCTION` (through `CLOSURE`, if not
+/// NULL) with the top `ARGC` values as its arguments, the stack doesn't grow
+///
+/// NOTE(HS): the callee and arguments are moved down to the frame's `base`, keeping
+/// the callee on the stack so the collector can see it. Variables of the frame being
+/// replaced have to be closed before they're overwritten. A cached result of a `@memo`
+/// callee is returned straight away, otherwise the callee's entry is chained in front
+/// of the frame's, the result fills both.
+#define VM_TAIL_ENTER_FUNCTION(FUNCTION, CLOSURE, CALLEE_VALUE, ARGC)   \
+  do {                                                                  \
+    Obj_Function *callee = (FUNCTION);                                  \
+    Value tail_callee = (CALLEE_VALUE);                                 \
+    VM_COUNT(exec_counters_call(counters, callee));                     \
+    if (callee->memo) {                                                 \
+      Memo_Ref memo;                                                    \
+      Value memo_result;                                                \
+      if (vm_memo_call(vm, callee, sp - (ARGC), frame->memo, &memo_result, &memo)) { \
+        VM_RETURN(memo_result);                                         \
+        break;                                                          \
+      }                                                                 \
+      frame->memo = memo;                                               \
+    }                                                                   \
+    if (vm->open_upvalues && vm->open_upvalues->location >= slots) {    \
+      vm_close_upvalues(vm, slots);                                     \
+    }                                                                   \
+    size_t stack_len = (size_t) (frame->base - vm->stack) + 1 + callee->chunk.max_stack; \
+    if (stack_len > vm->stack_capacity) {                               \
+      if (!vm_reserve(vm, vm->frame_count, stack_len, &sp)) {           \
+        return VM_RUNTIME_ERROR(TYERR_STACK_OVERFLOW, "stack overflow"); \
+      }                                                                 \
+    }                                                                   \
+    Value *base = frame->base;                                          \
+    memmove(base + 1, sp - (ARGC), (ARGC) * sizeof(Value));             \
+    base[0] = tail_callee;                                              \
+    sp = base + 1 + (ARGC);                                             \
+    frame->chunk = &callee->chunk;                                      \
+    frame->slots = base + 1;                                            \
+    frame->closure = (CLOSURE);                                         \
+    chunk = frame->chunk;                                               \
+    ip = chunk->code.elems;                                             \
+    slots = frame->slots;                                               \
+    constants = chunk->constants.elems;                                 \
+    upvalues = frame->closure ? frame->closure->upvalues : NULL;        \
+    VM_JIT_HOT();                                                       \
+  } while (0)
+
+/// finds the function `CALLEE_VALUE` calls (and its closure, if any), hits in the
+/// call site's inline cache skip the type and arity checks
+#define VM_LOOKUP_CALLEE(CALLEE_VALUE, ARGC, CACHE)                     \
+  Obj_Function *function = NULL;                                        \
+  Obj_Closure *closure = NULL;                                          \
+  if ((CALLEE_VALUE).kind == VAL_OBJ) {                                 \
+    const Obj *callee_obj = (CALLEE_VALUE).as.obj;                      \
+    if (callee_obj->kind == OBJ_CLOSURE) {                              \
+      closure = (Obj_Closure*) callee_obj;                              \
+      callee_obj = &closure->function->obj;                             \
+    }                                                                   \
+    for (size_t i = 0; i < (CACHE)->len; ++i) {                         \
+      if (&(CACHE)->entries[i]->obj == callee_obj) {                    \
+        function = (CACHE)->entries[i];                                 \
+        break;                                                          \
+      }                                                                 \
+    }                                                                   \
+  }                                                                     \
+  VM_COUNT(exec_counters_cache(counters, chunk, VM_INSTRUCTION_OFFSET(2), function != NULL)); \
+  if (!function) {                                                      \
+    VM_CHECK_CALL((CALLEE_VALUE), (ARGC));                              \
+    function = value_callee_function((CALLEE_VALUE));                   \
+    if ((CACHE)->len < CALL_CACHE_ENTRIES) {                            \
+      (CACHE)->entries[(CACHE)->len++] = function;                      \
+    } else {                                                            \
+      (CACHE)->megamorphic = true;                                      \
+    }                                                                   \
+  }
+
+/// fills the cache of a call to the global `SLOT` unless the global table is unchanged
+/// since it was last filled, in which case the call needs neither the global nor any
+/// checks
+#define VM_LOOKUP_GLOBAL_CALLEE(SLOT, ARGC, CACHE)                      \
+  VM_COUNT(exec_counters_cache(                                         \
+    counters, chunk, VM_INSTRUCTION_OFFSET(3),                          \
+    (CACHE)->len != 0 && (CACHE)->version == vm->globals_version        \
+  ));                                                                   \
+  if ((CACHE)->len == 0 || (CACHE)->version != vm->globals_version) {   \
+    VM_CHECK_CALL(globals[(SLOT)], (ARGC));                             \
+    (CACHE)->entries[0] = value_callee_function(globals[(SLOT)]);       \
+    (CACHE)->closure = value_is_closure(globals[(SLOT)]) ? value_as_closure(globals[(SLOT)]) : NULL; \
+    (CACHE)->len = 1;                                                   \
+    (CACHE)->version = vm->globals_version;                             \
+  }
+
+/// calls the callee below the arguments on the stack
+#define VM_OP_CALL()                                                    \
+  do {                                                                  \
+    uint16_t argc = VM_READ_OPERAND();                                  \
+    Call_Cache *cache = &chunk->call_caches.elems[VM_READ_OPERAND()];   \
+    Value callee_value = VM_PEEK(argc);                                 \
+    VM_LOOKUP_CALLEE(callee_value, argc, cache);                        \
+    VM_ENTER_FUNCTION(function, closure, sp - argc, sp - argc - 1);     \
+  } while (0)
+
+/// calls the function held by a global
+#define VM_OP_CALL_GLOBAL()                                             \
+  do {                                                                  \
+    uint16_t slot = VM_READ_OPERAND();                                  \
+    uint16_t argc = VM_READ_OPERAND();                                  \
+    Call_Cache *cache = &chunk->call_caches.elems[VM_READ_OPERAND()];   \
+    VM_LOOKUP_GLOBAL_CALLEE(slot, argc, cache);                         \
+    VM_ENTER_FUNCTION(cache->entries[0], cache->closure, sp - argc, sp - argc); \
+  } while (0)
+
+/// `return f(...)`, calls the callee below the arguments in place of the running call
+#define VM_OP_TAIL_CALL()                                               \
+  do {                                                                  \
+    uint16_t argc = VM_READ_OPERAND();                                  \
+    Call_Cache *cache = &chunk->call_caches.elems[VM_READ_OPERAND()];   \
+    Value callee_value = VM_PEEK(argc);                                 \
+    VM_LOOKUP_CALLEE(callee_value, argc, cache);                        \
+    VM_TAIL_ENTER_FUNCTION(function, closure, callee_value, argc);      \
+  } while (0)
+
+/// `return f(...)` where `f` is a global, see `TAIL_CALL`
+#define VM_OP_TAIL_CALL_GLOBAL()                                        \
+  do {                                                                  \
+    uint16_t slot = VM_READ_OPERAND();                                  \
+    uint16_t argc = VM_READ_OPERAND();                                  \
+    Call_Cache *cache = &chunk->call_caches.elems[VM_READ_OPERAND()];   \
+    VM_LOOKUP_GLOBAL_CALLEE(slot, argc, cache);                         \
+    VM_TAIL_ENTER_FUNCTION(cache->entries[0], cache->closure, globals[slot], argc); \
+  } while (0)
+
+/// creates a closure over the function constant `index`, capturing from the
+/// running frame
+#define VM_OP_CLOSURE()                                                   \
+  do {                                                                    \
+    uint16_t index = VM_READ_OPERAND();                                   \
+    Obj_Function *function = value_as_function(constants[index]);         \
+    Obj_Closure *closure = vm_closure_new(vm, function, slots, upvalues); \
+    VM_PUSH(make_obj_value(&closure->obj));                               \
+    VM_GC_SAFEPOINT();                                                    \
+  } while (0)
+
+/// replaces the callee on top of the stack with whether it's the function guard `index`
+/// expects, which an inlined copy of the function's body stands in for
+#define VM_OP_IS_FUNCTION()                                             \
+  do {                                                                  \
+    uint16_t index = VM_READ_OPERAND();                                 \
+    const Obj_Function *expected = chunk->guards.elems[index];          \
+    sp[-1] = make_bool_value(expected && value_callee_function(sp[-1]) == expected); \
+  } while (0)
+
+/// leaves `RESULT` in place of the running call and returns to its caller
+#define VM_RETURN(RESULT)                                            \
+  do {                                                               \
+    Value result = (RESULT);                                         \
+    if (vm->open_upvalues && vm->open_upvalues->location >= slots) { \
+      vm_close_upvalues(vm, slots);                                  \
+    }                                                                \
+    if (frame->memo.cache) {                                         \
+      memo_ref_fill(frame->memo, result);                            \
+    }                                                                \
+    vm->frame_count -= 1;                                            \
+    if (vm->frame_count == 0) {                                      \
+      assert(sp == vm->stack);                                       \
+      return ok;                                                     \
+    }                                                                \
+    sp = frame->base;                                                \
+    frame = &vm->frames[vm->frame_count - 1];                        \
+    chunk = frame->chunk;                                            \
+    ip = frame->ip;                                                  \
+    slots = frame->slots;                                            \
+    constants = chunk->constants.elems;                              \
+    upvalues = frame->closure ? frame->closure->upvalues : NULL;     \
+    VM_PUSH(result);                                                 \
+    VM_JIT_ENTER();                                                  \
+  } while (0)
+
+#define VM_OP_RETURN() VM_RETURN(VM_POP())
+
+#define VM_OP_ADD_INT_INT()    VM_QUICK_INT_OP(OPC_ADD, VM_INT_ADD)
+#define VM_OP_SUB_INT_INT()    VM_QUICK_INT_OP(OPC_SUB, VM_INT_SUB)
+#define VM_OP_MUL_INT_INT()    VM_QUICK_INT_OP(OPC_MUL, VM_INT_MUL)
+#define VM_OP_EQ_INT_INT()     VM_QUICK_INT_OP(OPC_EQ, VM_INT_EQ)
+#define VM_OP_NOT_EQ_INT_INT() VM_QUICK_INT_OP(OPC_NOT_EQ, VM_INT_NOT_EQ)
+#define VM_OP_LT_INT_INT()     VM_QUICK_INT_OP(OPC_LT, VM_INT_LT)
+#define VM_OP_GT_INT_INT()     VM_QUICK_INT_OP(OPC_GT, VM_INT_GT)
+#define VM_OP_LTE_INT_INT()    VM_QUICK_INT_OP(OPC_LTE, VM_INT_LTE)
+#define VM_OP_GTE_INT_INT()    VM_QUICK_INT_OP(OPC_GTE, VM_INT_GTE)
+
+#define VM_OP_DIV_INT_INT()                                             \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    Value lhs = VM_PEEK(1);                                             \
+    if (!VM_BOTH_INT(lhs, rhs) || rhs.as.integer == 0 || VM_INT_DIV_OVERFLOWS(lhs, rhs)) { \
+      VM_DEQUICKEN(OPC_DIV);                                            \
+      break;                                                            \
+    }                                                                   \
+    sp -= 1;                                                            \
+    sp[-1] = make_int_value(lhs.as.integer / rhs.as.integer);           \
+  } while (0)
+
+#define VM_OP_CONCAT_STR_STR()                                          \
+  do {                                                                  \
+    Value rhs = VM_PEEK(0);                                             \
+    Value lhs = VM_PEEK(1);                                             \
+    if (!(value_is_string(lhs) && value_is_string(rhs))) {              \
+      VM_DEQUICKEN(OPC_ADD);                                            \
+      break;                                                            \
+    }                                                                   \
+    sp -= 1;                                                            \
+    sp[-1] = gc_string_concat(&vm->gc, lhs, rhs);                       \
+    VM_GC_SAFEPOINT();                                                  \
+  } while (0)
+
+/// steps over the opcode byte of the next component of a superinstruction
+#define VM_NEXT_COMPONENT() (ip += 1)
+
+static Tyger_Error vm_execute(VM *vm, Chunk *chunk)
+{
+  Tyger_Error ok = {0};
+
+  // NOTE(HS): calls only check the depth once every frame is in use, so a limit below
+  // the current capacity takes effect by shrinking the frames
+  if (vm->frame_capacity > vm->max_call_depth)
+  {
+    vm->frame_capacity = vm->max_call_depth;
+  }
+
+  Value *sp = vm->stack;
+  vm->frame_count = 0;
+  if (!vm_reserve(vm, 1, chunk->max_stack, &sp))
+  {
+    const uint8_t *ip = chunk->code.elems + 1;
+    return VM_RUNTIME_ERROR(TYERR_STACK_OVERFLOW, "stack overflow");
+  }
+  vm_ensure_globals(vm, chunk->global_count);
+
+  // NOTE(HS): inline caches may hold functions (and global versions) of whichever
+  // VM last ran `chunk`
+  chunk_reset_call_caches(chunk);
+
+  vm->frame_count = 1;
+  Call_Frame *frame = &vm->frames[0];
+  *frame = (Call_Frame) {
+    .chunk = chunk,
+    .ip = chunk->code.elems,
+    .slots = vm->stack,
+    .base = vm->stack,
+    .closure = NULL,
+    .memo = { .cache = NULL, .index = 0, .generation = 0 },
+  };
+
+  uint8_t *ip = frame->ip;
+  Value *slots = frame->slots;
+  Obj_Upvalue **upvalues = NULL;
+  Value *globals = vm->globals.elems;
+  const Value *constants = chunk->constants.elems;
+  Opcode_Profile *profile = vm->profile;
+  Sample_Profile *sampler = vm->sampler;
+#if EXEC_COUNTERS_ENABLED
+  Exec_Counters *counters = vm->counters;
+#endif
+  bool hooked = profile || sampler || VM_COUNTING;
+
+  // NOTE(HS): profiles and counters see every instruction, so are only taken by the
+  // interpreter
+  bool jit = vm->jit && !profile && !VM_COUNTING;
+
+  for (;;)
+  {
+    if (hooked)
+    {
+      if (profile)
+      {
+        opcode_profile_record(profile, ip);
+      }
+      if (sampler && sampler->pending)
+      {
+        vm_sample(vm, sampler, ip);
+      }
+      VM_COUNT(counters->opcodes[*ip] += 1);
+    }
+
+    uint8_t instruction = *ip++;
+    switch ((Opcode) instruction)
+    {
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) case OPC_##NAME: { VM_OP_##NAME(); } break;
+      #include "defs/opcode.def"
+#undef X
+
+#define X2(NAME, A, B)                                                  \
+    case OPC_##NAME:                                                    \
+    {                                                                   \
+      VM_OP_##A(); VM_NEXT_COMPONENT(); VM_OP_##B();                    \
+    } break;
+#define X3(NAME, A, B, C)                                               \
+    case OPC_##NAME:                                                    \
+    {                                                                   \
+      VM_OP_##A(); VM_NEXT_COMPONENT(); VM_OP_##B();                    \
+      VM_NEXT_COMPONENT(); VM_OP_##C();                                 \
+    } break;
+#define X4(NAME, A, B, C, D)                                            \
+    case OPC_##NAME:                                                    \
+    {                                                                   \
+      VM_OP_##A(); VM_NEXT_COMPONENT(); VM_OP_##B();                    \
+      VM_NEXT_COMPONENT(); VM_OP_##C(); VM_NEXT_COMPONENT(); VM_OP_##D(); \
+    } break;
+      #include "defs/superinstruction.def"
+#undef X2
+#undef X3
+#undef X4
+
+    default:
+    {
+      fprintf(stderr, "[ERROR] Invalid opcode %i encountered\n", instruction);
+      assert(0);
+      return ok;
+    } break;
+    }
+  }
+}
+
+Tyger_Error vm_run(VM *vm, Chunk *chunk)
+{
+  Phase_Scope phase = phase_begin("run");
+  Tyger_Error err = vm_execute(vm, chunk);
+
+  // NOTE(HS): calls cut short by an error never fill their entries
+  for (size_t i = 0; i < vm->frame_count && err.kind != TYERR_NONE; ++i)
+  {
+    if (vm->frames[i].memo.cache)
+    {
+      memo_ref_abandon(vm->frames[i].memo);
+    }
+  }
+  vm->frame_count = 0;
+
+  // NOTE(HS): closures (e.g. in globals) may outlive the run, along with any
+  // variables of the script they captured
+  vm_close_upvalues(vm, vm->stack);
+
+  // NOTE(HS): the end of a run is the script's (or REPL line's) exit, anything still
+  // buffered has to be out before the caller reports errors or reads input
+  output_flush(&vm->out);
+  phase_end(phase);
+  return err;
+}
@@ -0,0 +1,229 @@
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_RUNTIME
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include "vm.h"
+#include "vm_internal.h"
+#include "jit.h"
+#include "util.h"
+
+// NOTE(HS): the VM's state (stack, frames, globals, upvalues and heap) apart from the
+// interpreter, which is all programs built with `tyger build` run on, so all they link
+
+///
+/// internal functions
+///
+
+/// NOTE(HS): a closure called through a global isn't on the stack, if the global is
+/// reassigned whilst it runs its frame is all that keeps it alive. Memoised arguments
+/// and results are only referred to by their caches.
+static void vm_mark_frames(Gc *gc, const void *context)
+{
+  const VM *vm = context;
+  for (size_t i = 0; i < vm->frame_count; ++i)
+  {
+    if (vm->frames[i].closure)
+    {
+      gc_mark_value(gc, make_obj_value(&vm->frames[i].closure->obj));
+    }
+  }
+  memo_table_mark(gc, &vm->memo);
+}
+
+/// the open upvalue for the variable in `slot`, shared with any closure which has
+/// already captured it
+static Obj_Upvalue *vm_capture_upvalue(VM *vm, Value *slot)
+{
+  Obj_Upvalue **link = &vm->open_upvalues;
+  while (*link && (*link)->location > slot)
+  {
+    link = &(*link)->next_open;
+  }
+  if (*link && (*link)->location == slot)
+  {
+    return *link;
+  }
+
+  Obj_Upvalue *upvalue = tmalloc(sizeof(Obj_Upvalue));
+  assert(upvalue);
+  upvalue->obj.kind = OBJ_UPVALUE;
+  upvalue->obj.next = vm->gc.objects;
+  upvalue->location = slot;
+  upvalue->closed = make_nil_value();
+  upvalue->next_open = *link;
+
+  vm->gc.objects = &upvalue->obj;
+  gc_track(&vm->gc, &upvalue->obj);
+  *link = upvalue;
+  return upvalue;
+}
+
+
+///
+/// public functions
+///
+
+void vm_init(VM *vm)
+{
+  vm->stack = tmalloc(VM_STACK_INITIAL * sizeof(Value));
+  assert(vm->stack);
+  vm->stack_capacity = VM_STACK_INITIAL;
+  vm->frames = tmalloc(VM_FRAMES_INITIAL * sizeof(Call_Frame));
+  assert(vm->frames);
+  vm->frame_capacity = VM_FRAMES_INITIAL;
+  vm->frame_count = 0;
+  vm->max_call_depth = VM_MAX_CALL_DEPTH;
+  va_array_init(Value, vm->globals);
+  vm->open_upvalues = NULL;
+  memo_table_init(&vm->memo);
+  vm->memo_capacity = MEMO_DEFAULT_CAPACITY;
+  vm->globals_version = 0;
+  gc_init(&vm->gc, gc_default_options());
+  output_init(&vm->out, STDOUT_FILENO, OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_AUTO);
+  vm->quicken = true;
+  vm->jit = JIT_SUPPORTED;
+  vm->jit_threshold = JIT_DEFAULT_THRESHOLD;
+  vm->profile = NULL;
+  vm->sampler = NULL;
+  vm->counters = NULL;
+  vm->compile_lazy = NULL;
+  vm->compile_lazy_context = NULL;
+  vm->hosts = (Vm_Host_VaArray) { NULL, 0, 0 };
+  vm->host = NULL;
+}
+
+void vm_free(VM *vm)
+{
+  output_free(&vm->out);
+  va_array_free(vm->globals);
+  gc_free(&vm->gc);
+  memo_table_free(&vm->memo);
+  va_array_free(vm->hosts);
+  tfree(vm->stack);
+  tfree(vm->frames);
+}
+
+void vm_ensure_globals(VM *vm, size_t count)
+{
+  while (vm->globals.len < count)
+  {
+    Value nil = make_nil_value();
+    va_array_append(vm->globals, nil);
+  }
+}
+
+void vm_gc_step(VM *vm, const Value *sp)
+{
+  Gc_Roots roots = {
+    vm->stack, (size_t) (sp - vm->stack), vm->globals.elems, vm->globals.len,
+    vm->open_upvalues, vm_mark_frames, vm
+  };
+  gc_step(&vm->gc, roots);
+}
+
+void vm_close_upvalues(VM *vm, Value *last)
+{
+  while (vm->open_upvalues && vm->open_upvalues->location >= last)
+  {
+    Obj_Upvalue *upvalue = vm->open_upvalues;
+    upvalue->closed = *upvalue->location;
+    upvalue->location = &upvalue->closed;
+    vm->open_upvalues = upvalue->next_open;
+    upvalue->next_open = NULL;
+    gc_write_barrier(&vm->gc, upvalue->closed);
+  }
+}
+
+bool vm_memo_call(
+  VM *vm, const Obj_Function *function, const Value *args, Memo_Ref caller,
+  Value *result, Memo_Ref *ref
+)
+{
+  Memo_Cache *cache = memo_table_cache(&vm->memo, function, vm->memo_capacity);
+  return memo_cache_call(cache, args, caller, result, ref);
+}
+
+Obj_Closure *vm_closure_new(
+  VM *vm, Obj_Function *function, Value *slots, Obj_Upvalue **enclosing
+)
+{
+  size_t count = function->upvalue_count;
+  Obj_Closure *closure = tmalloc(sizeof(Obj_Closure) + count * sizeof(Obj_Upvalue*));
+  assert(closure);
+  closure->obj.kind = OBJ_CLOSURE;
+  closure->function = function;
+  closure->upvalues = (Obj_Upvalue**) (closure + 1);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Upvalue_Desc *desc = &function->upvalues[i];
+    closure->upvalues[i] = desc->is_local
+      ? vm_capture_upvalue(vm, slots + desc->index)
+      : enclosing[desc->index];
+  }
+
+  // NOTE(HS): capturing links new upvalues into the heap, so the closure is only
+  // linked once they all exist
+  closure->obj.next = vm->gc.objects;
+  vm->gc.objects = &closure->obj;
+  gc_track(&vm->gc, &closure->obj);
+  return closure;
+}
+
+/// NOTE(HS): only the live part of the stack is copied, and pointers into the old
+/// stack are rebased whilst it's still allocated
+bool vm_reserve(VM *vm, size_t frame_count, size_t stack_len, Value **sp)
+{
+  if (frame_count > vm->frame_capacity)
+  {
+    if (frame_count > vm->max_call_depth)
+    {
+      return false;
+    }
+    size_t capacity = vm->frame_capacity * 2;
+    if (capacity > vm->max_call_depth)
+    {
+      capacity = vm->max_call_depth;
+    }
+    Call_Frame *frames = trealloc(vm->frames, capacity * sizeof(Call_Frame));
+    if (!frames)
+    {
+      return false;
+    }
+    vm->frames = frames;
+    vm->frame_capacity = capacity;
+  }
+
+  if (stack_len > vm->stack_capacity)
+  {
+    size_t capacity = vm->stack_capacity * 2;
+    while (capacity < stack_len)
+    {
+      capacity *= 2;
+    }
+    Value *old = vm->stack;
+    Value *stack = tmalloc(capacity * sizeof(Value));
+    if (!stack)
+    {
+      return false;
+    }
+    memcpy(stack, old, (size_t) (*sp - old) * sizeof(Value));
+
+    for (size_t i = 0; i < vm->frame_count; ++i)
+    {
+      vm->frames[i].slots = stack + (vm->frames[i].slots - old);
+      vm->frames[i].base = stack + (vm->frames[i].base - old);
+    }
+    for (Obj_Upvalue *upvalue = vm->open_upvalues; upvalue; upvalue = upvalue->next_open)
+    {
+      upvalue->location = stack + (upvalue->location - old);
+    }
+    *sp = stack + (*sp - old);
+
+    tfree(old);
+    vm->stack = stack;
+    vm->stack_capacity = capacity;
+  }
+
+  return true;
+}
@@ -0,0 +1,43 @@
+#ifndef TYGER_AOT_H_
+#define TYGER_AOT_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include "parser.h"
+#include "tstrings.h"
+
+typedef struct aot_options
+{
+  /// path of the executable built
+  const char *output;
+
+  /// when set, the generated C is kept at this path
+  const char *emit_c;
+
+  /// C compiler invoked, `$CC` (or `cc` when that isn't set) by default
+  const char *cc;
+
+  /// where `aot_runtime.h` and the headers it includes live, and the runtime library
+  /// programs are linked against, both those of the build `tyger` came from
+  const char *include_dir;
+  const char *runtime_lib;
+
+  /// further arguments to the C compiler, separated by spaces, by default the C flags
+  /// `tyger` was configured with as the runtime may need them (sanitizers, say)
+  const char *flags;
+} Aot_Options;
+
+Aot_Options aot_default_options(void);
+
+/// Lowers a program which has been through the resolver to a C99 translation unit
+/// running it on the runtime in `aot_runtime.h`, appended to `out`.
+///
+/// NOTE(HS): each function literal (and the script) becomes a C function following the
+/// same stack discipline as the bytecode compiler, so the program must also compile to
+/// bytecode without errors. `source` is embedded to report runtime errors with.
+void aot_generate(const Program *prog, const char *source, const char *source_name, String_Builder *out);
+
+/// generates C for the script at `path` and compiles it into a standalone executable,
+/// reporting errors on `stderr`, returns a process exit code
+int aot_build_file(const char *path, Aot_Options options);
+
+#endif // TYGER_AOT_H_
@@ -0,0 +1,266 @@
+#ifndef TYGER_AOT_RUNTIME_H_
+#define TYGER_AOT_RUNTIME_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parser.h"
+#include "value.h"
+#include "chunk.h"
+#include "bigint.h"
+#include "builtin.h"
+#include "gc.h"
+#include "vm.h"
+#include "vm_internal.h"
+
+/// C stack given to the thread a built program runs on for each call it may make
+/// (`VM_MAX_CALL_DEPTH` of them), calls fail with a stack overflow before it runs out
+#define AOT_STACK_BYTES_PER_CALL 1024
+
+/// a function literal of a built program, `Aot_Program.functions[0]` is the script
+typedef struct aot_function_desc
+{
+  Aot_Entry entry;
+
+  /// NULL for anonymous functions
+  const char *name;
+  size_t arity;
+  size_t max_stack;
+  bool memo;
+  const Upvalue_Desc *upvalues;
+  size_t upvalue_count;
+} Aot_Function_Desc;
+
+typedef enum aot_constant_kind
+{
+  AOT_CONST_STRING,
+  AOT_CONST_BIGINT,
+} Aot_Constant_Kind;
+
+/// a string literal (with its escapes expanded) or the digits of a bigint literal
+typedef struct aot_constant_desc
+{
+  Aot_Constant_Kind kind;
+  const char *chars;
+  size_t len;
+} Aot_Constant_Desc;
+
+/// Everything `tyger build` generates besides the function bodies, the constants and
+/// functions are made when the program starts
+///
+/// NOTE(HS): the source is kept so errors can be reported at a line and column, the
+/// same as the interpreter does
+typedef struct aot_program
+{
+  const char *source_name;
+  const char *source;
+  const Aot_Function_Desc *functions;
+  size_t functions_len;
+  const Aot_Constant_Desc *constants;
+  size_t constants_len;
+  size_t global_count;
+} Aot_Program;
+
+/// State of a running built program.
+///
+/// NOTE(HS): the generated code works on the VM's stack exactly as the bytecode would,
+/// so the collector sees every value the same way. Each function is a C function whose
+/// locals and temporaries are stack slots at offsets fixed when it was generated, its
+/// callee sits in the slot below its arguments and is replaced by its result. Calls
+/// are made through `aot_call`, which checks the callee and grows the stack like the
+/// interpreter does, and C calls nest as deeply as tyger's. Tail calls can't nest, a
+/// function making one moves the callee and arguments down in its own place and
+/// returns with `tail_call` set for `aot_call` to make the call instead.
+typedef struct aot
+{
+  VM vm;
+  const Aot_Program *program;
+
+  /// owns the functions and constants, which are never collected
+  Obj *objects;
+  Obj_Function **functions;
+  Value *constants;
+
+  /// calls in progress, counting the script
+  size_t depth;
+
+  /// the address on the C stack below which calls fail with a stack overflow
+  uintptr_t stack_limit;
+
+  /// set by `aot_tail_call`, with the call's argument count and source position
+  bool tail_call;
+  size_t tail_argc;
+  size_t tail_pos;
+
+  /// set whenever a runtime function returns false
+  Tyger_Error err;
+} Aot;
+
+/// runs `program` on a thread of its own, reporting any error on `stderr`, returns a
+/// process exit code
+int aot_main(const Aot_Program *program);
+
+/// calls the callee in stack slot `callee` with the `argc` values above it, leaving
+/// the result in its place
+bool aot_call(Aot *aot, size_t callee, size_t argc, size_t pos);
+
+/// `return f(...)` from the function whose arguments start at `slots`, see `Aot`
+bool aot_tail_call(Aot *aot, size_t slots, size_t callee, size_t argc, size_t pos);
+
+/// calls a builtin with the `argc` values from slot `args`, leaving the result in
+/// slot `args`
+bool aot_call_native(Aot *aot, Builtin_Id id, size_t args, size_t argc, size_t pos);
+
+/// the generic form of the binary instruction `op` on `lhs[0]` and `lhs[1]`, used
+/// when the operands aren't both ints, or overflow. The result replaces `lhs[0]`.
+bool aot_binary(Aot *aot, Opcode op, Value *lhs, size_t pos);
+bool aot_negate(Aot *aot, Value *operand, size_t pos);
+
+///
+/// operations used by generated code
+///
+/// NOTE(HS): every function is generated with `aot`, `slots` and `upvalues` as its
+/// parameters and `s` pointing at stack slot `slots`, which has to be reloaded after
+/// a call as the stack may have moved. Operands are slots of the running function.
+///
+
+#define AOT_RELOAD() (s = aot->vm.stack + slots)
+
+/// copies a value field by field
+///
+/// NOTE(HS): values are mostly copied straight after being made, by stores to their
+/// fields, a 16 byte copy would have to wait for those to reach memory rather than
+/// being forwarded from them
+#define AOT_COPY(DST, SRC) ((DST).kind = (SRC).kind, (DST).short_len = (SRC).short_len, (DST).as = (SRC).as)
+
+/// lets the collector catch up once an instruction which may allocate has left its
+/// result in the slot below `SP`
+#define AOT_GC_SAFEPOINT(SP)                    \
+  do {                                          \
+    if (gc_should_step(&aot->vm.gc)) {          \
+      vm_gc_step(&aot->vm, s + (SP));           \
+    }                                           \
+  } while (0)
+
+#define AOT_LOAD_LOCAL(D, SLOT) AOT_COPY(s[(D)], s[(SLOT)])
+#define AOT_LOAD_GLOBAL(D, SLOT) AOT_COPY(s[(D)], aot->vm.globals.elems[(SLOT)])
+#define AOT_LOAD_UPVALUE(D, SLOT) AOT_COPY(s[(D)], *upvalues[(SLOT)]->location)
+#define AOT_LOAD_FUNCTION(D, INDEX) (s[(D)] = make_obj_value(&aot->functions[(INDEX)]->obj))
+
+#define AOT_STORE_GLOBAL(SLOT, D)                         \
+  do {                                                    \
+    AOT_COPY(aot->vm.globals.elems[(SLOT)], s[(D)]);      \
+    gc_write_barrier(&aot->vm.gc, s[(D)]);                \
+  } while (0)
+
+#define AOT_STORE_LOCAL(SLOT, D) AOT_COPY(s[(SLOT)], s[(D)])
+
+#define AOT_STORE_UPVALUE(SLOT, D)                        \
+  do {                                                    \
+    AOT_COPY(*upvalues[(SLOT)]->location, s[(D)]);        \
+    gc_write_barrier(&aot->vm.gc, s[(D)]);                \
+  } while (0)
+
+/// the end of a block whose locals from slot `D` up were captured
+#define AOT_CLOSE_UPVALUES(D) vm_close_upvalues(&aot->vm, s + (D))
+
+#define AOT_CLOSURE(D, INDEX)                                           \
+  do {                                                                  \
+    Obj_Closure *closure = vm_closure_new(&aot->vm, aot->functions[(INDEX)], s, upvalues); \
+    s[(D)] = make_obj_value(&closure->obj);                             \
+    AOT_GC_SAFEPOINT((D) + 1);                                          \
+  } while (0)
+
+#define AOT_BOTH_INT(LHS) ((LHS)[0].kind == VAL_INT && (LHS)[1].kind == VAL_INT)
+
+#define AOT_INT_ARITH(L, OVERFLOWS, OP, POS)                            \
+  do {                                                                  \
+    Value *lhs = &s[(L)];                                               \
+    int64_t int_result;                                                 \
+    if (AOT_BOTH_INT(lhs) && !OVERFLOWS(lhs[0].as.integer, lhs[1].as.integer, &int_result)) { \
+      lhs[0] = make_int_value(int_result);                              \
+    } else if (!aot_binary(aot, (OP), lhs, (POS))) {                    \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+#define AOT_INT_CMP(L, CMP, OP, POS)                                    \
+  do {                                                                  \
+    Value *lhs = &s[(L)];                                               \
+    if (AOT_BOTH_INT(lhs)) {                                            \
+      lhs[0] = make_bool_value(lhs[0].as.integer CMP lhs[1].as.integer); \
+    } else if (!aot_binary(aot, (OP), lhs, (POS))) {                    \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+#define AOT_EQUALITY(L, NEGATE)                                         \
+  do {                                                                  \
+    Value *lhs = &s[(L)];                                               \
+    bool equal = AOT_BOTH_INT(lhs)                                      \
+      ? lhs[0].as.integer == lhs[1].as.integer                          \
+      : value_equals(lhs[0], lhs[1]);                                   \
+    lhs[0] = make_bool_value(equal != (NEGATE));                        \
+  } while (0)
+
+#define AOT_ADD(L, POS) AOT_INT_ARITH(L, int_add_overflow, OPC_ADD, POS)
+#define AOT_SUB(L, POS) AOT_INT_ARITH(L, int_sub_overflow, OPC_SUB, POS)
+#define AOT_MUL(L, POS) AOT_INT_ARITH(L, int_mul_overflow, OPC_MUL, POS)
+#define AOT_LT(L, POS)  AOT_INT_CMP(L, <, OPC_LT, POS)
+#define AOT_GT(L, POS)  AOT_INT_CMP(L, >, OPC_GT, POS)
+#define AOT_LTE(L, POS) AOT_INT_CMP(L, <=, OPC_LTE, POS)
+#define AOT_GTE(L, POS) AOT_INT_CMP(L, >=, OPC_GTE, POS)
+#define AOT_EQ(L, POS)     AOT_EQUALITY(L, false)
+#define AOT_NOT_EQ(L, POS) AOT_EQUALITY(L, true)
+
+/// `INT64_MIN / -1` is the one int division whose result isn't an int
+#define AOT_DIV(L, POS)                                                 \
+  do {                                                                  \
+    Value *lhs = &s[(L)];                                               \
+    if (AOT_BOTH_INT(lhs) && lhs[1].as.integer != 0                     \
+        && !(lhs[0].as.integer == INT64_MIN && lhs[1].as.integer == -1)) { \
+      lhs[0] = make_int_value(lhs[0].as.integer / lhs[1].as.integer);   \
+    } else if (!aot_binary(aot, OPC_DIV, lhs, (POS))) {                 \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+#define AOT_NEGATE(D, POS)                                              \
+  do {                                                                  \
+    if (s[(D)].kind == VAL_INT && s[(D)].as.integer != INT64_MIN) {     \
+      s[(D)] = make_int_value(-s[(D)].as.integer);                      \
+    } else if (!aot_negate(aot, &s[(D)], (POS))) {                      \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+#define AOT_NOT(D) (s[(D)] = make_bool_value(!value_is_truthy(s[(D)])))
+
+#define AOT_CALL(CALLEE, ARGC, POS)                             \
+  do {                                                          \
+    if (!aot_call(aot, slots + (CALLEE), (ARGC), (POS))) {      \
+      return false;                                             \
+    }                                                           \
+    AOT_RELOAD();                                               \
+  } while (0)
+
+#define AOT_CALL_NATIVE(ID, ARGS, ARGC, POS)                            \
+  do {                                                                  \
+    if (!aot_call_native(aot, (ID), slots + (ARGS), (ARGC), (POS))) {   \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+#define AOT_TAIL_CALL(CALLEE, ARGC, POS) \
+  return aot_tail_call(aot, slots, slots + (CALLEE), (ARGC), (POS))
+
+/// leaves the value in slot `D` in place of the running call
+#define AOT_RETURN(D)                                                   \
+  do {                                                                  \
+    AOT_COPY(s[-1], s[(D)]);                                            \
+    if (aot->vm.open_upvalues && aot->vm.open_upvalues->location >= s) { \
+      vm_close_upvalues(&aot->vm, s);                                   \
+    }                                                                   \
+    return true;                                                        \
+  } while (0)
+
+#endif // TYGER_AOT_RUNTIME_H_
@@ -0,0 +1,66 @@
+#ifndef TYGER_BIGINT_H_
+#define TYGER_BIGINT_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "value.h"
+#include "gc.h"
+
+/// operands at least this many limbs long are multiplied with Karatsuba rather than
+/// schoolbook multiplication
+#define BIGINT_KARATSUBA_THRESHOLD 32
+
+/// Arbitrary precision integer, only ever made for results which don't fit in an
+/// `int64_t`, so a value holding a small integer is always `VAL_INT` and an int never
+/// equals a bigint.
+///
+/// NOTE(HS): the magnitude is stored little endian in base 2^32, `limbs` points into
+/// the same allocation directly after the header and the top limb is never 0
+typedef struct obj_bigint
+{
+  Obj obj;
+  bool negative;
+  size_t len;
+  uint32_t *limbs;
+} Obj_Bigint;
+
+#define value_is_bigint(V) value_is_obj_kind((V), OBJ_BIGINT)
+#define value_as_bigint(V) ((Obj_Bigint*) (V).as.obj)
+
+/// whether `v` is an int of either size
+static inline bool value_is_integer(Value v)
+{
+  return v.kind == VAL_INT || value_is_bigint(v);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define int_add_overflow(A, B, RESULT) __builtin_add_overflow((A), (B), (RESULT))
+#define int_sub_overflow(A, B, RESULT) __builtin_sub_overflow((A), (B), (RESULT))
+#define int_mul_overflow(A, B, RESULT) __builtin_mul_overflow((A), (B), (RESULT))
+#else
+bool int_add_overflow(int64_t a, int64_t b, int64_t *result);
+bool int_sub_overflow(int64_t a, int64_t b, int64_t *result);
+bool int_mul_overflow(int64_t a, int64_t b, int64_t *result);
+#endif
+
+/// the arithmetic below takes ints of either size and returns an int of whichever
+/// size fits the result, bigints are allocated from `gc`
+Value bigint_add(Gc *gc, Value a, Value b);
+Value bigint_sub(Gc *gc, Value a, Value b);
+Value bigint_mul(Gc *gc, Value a, Value b);
+
+/// truncates towards zero like C, `b` must not be 0
+Value bigint_div(Gc *gc, Value a, Value b);
+Value bigint_negate(Gc *gc, Value a);
+
+/// returns <0, 0 or >0 as `a` is less than, equal to or greater than `b`
+int bigint_compare(Value a, Value b);
+
+/// parses a string of decimal digits, bigints are linked into `objects` (a chunk's
+/// constants) rather than collected
+Value bigint_from_decimal(Obj **objects, const char *digits, size_t len);
+
+/// decimal representation of `n`, which must be freed by the caller
+char *bigint_to_decimal(const Obj_Bigint *n);
+
+#endif // TYGER_BIGINT_H_
@@ -0,0 +1,66 @@
+#ifndef TYGER_BUILTIN_H_
+#define TYGER_BUILTIN_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parser.h"
+#include "value.h"
+
+struct vm;
+struct tyger_vm;
+
+/// arity of builtins which accept any number of arguments
+#define BUILTIN_VARIADIC (-1)
+
+typedef enum builtin_id
+{
+#define X(ID, NAME, ARITY, PURE) BUILTIN_##ID,
+  #include "defs/builtin.def"
+#undef X
+  BUILTIN_COUNT,
+} Builtin_Id;
+
+/// the arguments of a native call
+///
+/// NOTE(HS): `elems` points directly into the VM stack, so it is only valid until the
+/// builtin returns and must not be held on to
+typedef struct value_span
+{
+  Value *elems;
+  size_t len;
+} Value_Span;
+
+/// Native function ABI, the result is written to `*result` (which starts out `nil`).
+/// Errors are returned without a location, the VM fills in the position of the call.
+typedef Tyger_Error (*Builtin_Fn)(struct vm *vm, Value_Span args, Value *result);
+
+/// ABI of the functions an embedder registers (see `tyger_vm_register`), as
+/// `Builtin_Fn` but given the instance calling it and the `user` pointer it was
+/// registered with
+typedef Tyger_Error (*Tyger_Host_Fn)(struct tyger_vm *vm, void *user, Value_Span args, Value *result);
+
+typedef struct builtin
+{
+  const char *name;
+  size_t name_len;
+  /// number of arguments, or `BUILTIN_VARIADIC`
+  int arity;
+  /// has no side effects and its result depends only on its arguments
+  bool pure;
+  Builtin_Fn fn;
+} Builtin;
+
+/// indexed by `Builtin_Id`, the operand of `CALL_NATIVE`
+extern const Builtin BUILTINS[BUILTIN_COUNT];
+
+/// finds the builtin called `name` with a single probe of a perfect hash table,
+/// see `scripts/builtin_hash_gen.py`
+bool builtin_lookup(const char *name, size_t len, Builtin_Id *id);
+
+/// whether `argc` arguments are accepted by `builtin`
+static inline bool builtin_accepts(const Builtin *builtin, size_t argc)
+{
+  return builtin->arity == BUILTIN_VARIADIC || (size_t) builtin->arity == argc;
+}
+
+#endif // TYGER_BUILTIN_H_
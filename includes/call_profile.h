@@ -0,0 +1,51 @@
+#ifndef TYGER_CALL_PROFILE_H_
+#define TYGER_CALL_PROFILE_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "chunk.h"
+
+/// the sites of a profile which called more than one function
+#define CALL_PROFILE_POLYMORPHIC ((size_t) -1)
+
+/// a call site which only ever called the function compiled from one literal, both
+/// given by their source position
+typedef struct call_profile_entry
+{
+  size_t site;
+  size_t callee;
+} Call_Profile_Entry;
+
+/// The call sites of a run which were monomorphic, read from their inline caches (see
+/// `Call_Cache`) once it finishes. With `-O` calls at those sites are inlined, behind a
+/// guard which falls back to the call when it finds another function, see `ir_inline`.
+///
+/// NOTE(HS): sites and functions are identified by their position in the source, so a
+/// profile only applies to the source it was taken from. A `CALL_GLOBAL` cache only
+/// keeps the function it last called, a global which was reassigned part way through
+/// the run is seen as calling that one.
+typedef struct call_profile
+{
+  Call_Profile_Entry *elems;
+  size_t capacity;
+  size_t len;
+} Call_Profile;
+
+void call_profile_init(Call_Profile *profile);
+void call_profile_free(Call_Profile *profile);
+
+/// adds the call sites of `chunk`, and every function it contains, which have called
+/// exactly one function
+void call_profile_collect(Call_Profile *profile, const Chunk *chunk);
+
+/// the position of the literal the site at `site` called, `CALL_PROFILE_POLYMORPHIC`
+/// when it isn't in the profile or called more than one
+size_t call_profile_lookup(const Call_Profile *profile, size_t site);
+
+/// writes one `<site> <callee>` line per monomorphic site
+void call_profile_write(const Call_Profile *profile, FILE *f);
+
+/// reads a profile written by `call_profile_write`, returns false when it can't be
+bool call_profile_read(Call_Profile *profile, FILE *f);
+
+#endif // TYGER_CALL_PROFILE_H_
@@ -0,0 +1,246 @@
+#ifndef TYGER_CHUNK_H_
+#define TYGER_CHUNK_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "value.h"
+
+/// NOTE(HS): every instruction is a one byte opcode followed by `operands` 16 bit
+/// little endian operands. `stack_effect` is the net change in stack depth after
+/// executing the instruction, for instructions with a variable effect (e.g. `POPN`)
+/// the compiler accounts for the operand itself. `generic` is the instruction a
+/// quickened form falls back to (base instructions are their own generic form).
+///
+/// Superinstructions are numbered after every base instruction, see
+/// `defs/superinstruction.def`.
+typedef enum opcode
+{
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) OPC_##NAME,
+  #include "defs/opcode.def"
+#undef X
+#define X2(NAME, A, B) OPC_##NAME,
+#define X3(NAME, A, B, C) OPC_##NAME,
+#define X4(NAME, A, B, C, D) OPC_##NAME,
+  #include "defs/superinstruction.def"
+#undef X2
+#undef X3
+#undef X4
+  OPC_COUNT,
+} Opcode;
+
+/// number of base (non-super) instructions
+enum
+{
+  OPC_BASE_COUNT = 0
+#define X(NAME, OPERANDS, STACK_EFFECT, GENERIC) + 1
+  #include "defs/opcode.def"
+#undef X
+};
+
+typedef struct byte_vaarray
+{
+  uint8_t *elems;
+  size_t capacity;
+  size_t len;
+} Byte_VaArray;
+
+/// maps the instruction starting at `offset` (and all those up to the next entry)
+/// back to the source position of the node it was compiled from
+typedef struct chunk_position
+{
+  size_t offset;
+  size_t pos;
+} Chunk_Position;
+
+typedef struct chunk_position_vaarray
+{
+  Chunk_Position *elems;
+  size_t capacity;
+  size_t len;
+} Chunk_Position_VaArray;
+
+#define CALL_CACHE_ENTRIES 4
+
+/// Inline cache of the functions seen at one call site, the `cache` operand of
+/// `CALL` and `CALL_GLOBAL` indexes `Chunk.call_caches`.
+///
+/// NOTE(HS): every cached function has been checked against the arity of the
+/// site, so a hit is a direct call. `CALL` caches up to `CALL_CACHE_ENTRIES`
+/// functions by identity before going megamorphic (no more entries are added), a
+/// closure is cached by its function as each call sets up its own upvalues.
+/// `CALL_GLOBAL` caches one function, valid for as long as the VM's
+/// `globals_version` equals `version`.
+typedef struct call_cache
+{
+  struct obj_function *entries[CALL_CACHE_ENTRIES];
+
+  /// the closure `CALL_GLOBAL` calls, when its global holds one
+  struct obj_closure *closure;
+  size_t len;
+  uint64_t version;
+  bool megamorphic;
+} Call_Cache;
+
+typedef struct call_cache_vaarray
+{
+  Call_Cache *elems;
+  size_t capacity;
+  size_t len;
+} Call_Cache_VaArray;
+
+/// the functions the `IS_FUNCTION` guards of inlined calls expect, not owned
+typedef struct guard_vaarray
+{
+  struct obj_function **elems;
+  size_t capacity;
+  size_t len;
+} Guard_VaArray;
+
+typedef struct chunk
+{
+  Byte_VaArray code;
+  Value_VaArray constants;
+  Chunk_Position_VaArray positions;
+  Call_Cache_VaArray call_caches;
+  Guard_VaArray guards;
+  Obj *objects;
+  size_t max_stack;
+  size_t global_count;
+
+  /// the source `positions` are in, NULL when it isn't known (it isn't owned, whoever
+  /// compiled the chunk keeps it alive as long as the chunk)
+  const char *source;
+
+  /// values on the stack when the chunk starts running, the arguments of a function
+  size_t arity;
+
+  /// machine code compiled from the chunk once it's hot, see `jit.h`. `jit_hotness`
+  /// counts calls and loop iterations until then, `jit_disabled` is set for chunks
+  /// left to the interpreter (which couldn't be compiled, or whose guards kept failing)
+  struct jit_code *jit;
+  uint32_t jit_hotness;
+  bool jit_disabled;
+} Chunk;
+
+typedef struct chunk_vaarray
+{
+  Chunk *elems;
+  size_t capacity;
+  size_t len;
+} Chunk_VaArray;
+
+/// where a closure finds one of its upvalues when it is created, a slot of the
+/// enclosing frame when `is_local`, otherwise one of the enclosing closure's upvalues
+typedef struct upvalue_desc
+{
+  bool is_local;
+  size_t index;
+} Upvalue_Desc;
+
+struct aot;
+
+/// a function body compiled to C by `tyger build`, run with its arguments starting at
+/// stack slot `slots`, see `aot_runtime.h`
+typedef bool (*Aot_Entry)(struct aot *aot, size_t slots, Obj_Upvalue **upvalues);
+
+/// NOTE(HS): a function literal compiles into its own chunk, owned by the function
+/// object which is in turn a constant (and object) of the enclosing chunk. A function
+/// with `upvalue_count > 0` is only ever called through an `Obj_Closure`.
+typedef struct obj_function
+{
+  Obj obj;
+  size_t arity;
+  Obj_String *name;
+  Chunk chunk;
+  size_t upvalue_count;
+  Upvalue_Desc *upvalues;
+
+  /// set for `@memo` functions, whose results the VM caches, see `memo.h`
+  bool memo;
+
+  /// source position of the literal the function was compiled from
+  size_t pos;
+
+  /// the source of a function whose body was only pre-parsed, which is compiled from
+  /// the literal at `pos` on its first call (see `VM.compile_lazy`), NULL once it has
+  /// been. `chunk` is empty until then. Its body may only use the first `lazy_globals`
+  /// globals, those declared where the literal is (see `resolver_resolve_function`).
+  const char *lazy_source;
+  size_t lazy_globals;
+
+  /// runs the function in place of `chunk` (which is left empty) in programs built
+  /// ahead of time, NULL otherwise
+  Aot_Entry native;
+} Obj_Function;
+
+/// A function paired with the variables it captured, made at runtime by `CLOSURE`.
+/// Functions which capture nothing are never wrapped, they are called directly.
+///
+/// NOTE(HS): `upvalues` points into the same allocation, directly after the header
+typedef struct obj_closure
+{
+  Obj obj;
+  Obj_Function *function;
+  Obj_Upvalue **upvalues;
+} Obj_Closure;
+
+#define value_is_function(V) value_is_obj_kind((V), OBJ_FUNCTION)
+#define value_as_function(V) ((Obj_Function*) (V).as.obj)
+#define value_is_closure(V) value_is_obj_kind((V), OBJ_CLOSURE)
+#define value_as_closure(V) ((Obj_Closure*) (V).as.obj)
+
+/// the function called when `v` is called, or NULL when `v` isn't callable
+static inline Obj_Function *value_callee_function(Value v)
+{
+  Obj_Function *function = NULL;
+  if (value_is_function(v))
+  {
+    function = value_as_function(v);
+  }
+  else if (value_is_closure(v))
+  {
+    function = value_as_closure(v)->function;
+  }
+  return function;
+}
+
+#define CHUNK_OPERAND_SIZE 2
+#define CHUNK_OPERAND_MAX UINT16_MAX
+#define chunk_read_operand(CODE) ((uint16_t) ((CODE)[0] | ((CODE)[1] << 8)))
+
+void chunk_init(Chunk *chunk);
+void chunk_free(Chunk *chunk);
+
+void chunk_write(Chunk *chunk, uint8_t byte, size_t pos);
+void chunk_write_operand(Chunk *chunk, uint16_t operand, size_t pos);
+void chunk_patch_operand(Chunk *chunk, size_t offset, uint16_t operand);
+size_t chunk_add_constant(Chunk *chunk, Value value);
+size_t chunk_add_call_cache(Chunk *chunk);
+size_t chunk_position_of(const Chunk *chunk, size_t offset);
+
+/// empties the call caches of `chunk` and every function it contains
+void chunk_reset_call_caches(Chunk *chunk);
+
+/// Copies `from`, and every function in it, into `to`, which is initialised by the
+/// copy. The copy is as `from` was compiled, with empty call caches and no machine
+/// code, so instructions can be quickened and compiled without touching `from`.
+///
+/// NOTE(HS): the copied functions are all owned by `to`, every other constant (strings,
+/// big integers) is shared with `from`, which has to outlive the copy
+void chunk_copy(Chunk *to, const Chunk *from);
+
+Obj_Function *obj_function_new(Obj **objects, Obj_String *name, size_t arity);
+void obj_function_free(Obj_Function *function);
+
+const char *opcode_to_string(Opcode op);
+size_t opcode_operand_count(Opcode op);
+int opcode_stack_effect(Opcode op);
+size_t opcode_length(Opcode op);
+Opcode opcode_generic_form(Opcode op);
+
+static inline bool opcode_is_superinstruction(Opcode op)
+{
+  return (int) op >= (int) OPC_BASE_COUNT && op < OPC_COUNT;
+}
+
+#endif // TYGER_CHUNK_H_
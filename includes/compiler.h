@@ -0,0 +1,54 @@
+#ifndef TYGER_COMPILER_H_
+#define TYGER_COMPILER_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include "parser.h"
+#include "chunk.h"
+#include "ir.h"
+
+typedef struct compiler_options
+{
+  /// fuse common instruction sequences into superinstructions once compiled
+  bool superinstructions;
+
+  /// compile functions through the SSA IR, running the passes in `ir` over it, see
+  /// `ir.h`. Functions the IR can't represent are compiled directly from the AST.
+  bool optimise;
+  Ir_Options ir;
+
+  /// the source the program was parsed from, which the chunks' positions are in (see
+  /// `Chunk.source`) and the bodies of `lazy` function literals are compiled from when
+  /// first called, it has to outlive the chunk
+  const char *source;
+} Compiler_Options;
+
+struct compiler_functions;
+
+typedef struct compiler
+{
+  const Program *program;
+  Compiler_Options options;
+  Chunk *chunk;
+  size_t stack_depth;
+  size_t pos;
+  Tyger_Error err;
+
+  /// the functions compiled from each literal, shared by the compilers of every
+  /// function in the program
+  struct compiler_functions *functions;
+} Compiler;
+
+Compiler_Options compiler_default_options(void);
+
+/// compiles a program which has been through the resolver into `chunk`, returning
+/// the first error encountered (if any)
+Tyger_Error compiler_compile_program(const Program *prog, Chunk *chunk, Compiler_Options options);
+
+/// compiles the body of the literal `fexpr` into `function`, whose chunk is still
+/// empty, e.g. one which was only pre-parsed (see `Obj_Function.lazy_source`). The
+/// chunk is left empty again on error.
+Tyger_Error compiler_compile_function(
+  const Program *prog, const Func_Expression *fexpr, Obj_Function *function, Compiler_Options options
+);
+
+#endif // TYGER_COMPILER_H_
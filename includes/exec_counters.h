@@ -0,0 +1,71 @@
+#ifndef TYGER_EXEC_COUNTERS_H_
+#define TYGER_EXEC_COUNTERS_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "chunk.h"
+
+/// set when the VM can count what it executes, only in builds configured with
+/// `-DTYGER_COUNTERS=ON`, elsewhere the counting compiles to nothing
+#if defined(TYGER_COUNTERS)
+#define EXEC_COUNTERS_ENABLED 1
+#else
+#define EXEC_COUNTERS_ENABLED 0
+#endif
+
+/// the counts of one function (calls) or instruction (a branch taken and not taken,
+/// or a call site's inline cache hits and misses), `key` being the function or the
+/// chunk the instruction at `offset` is in
+typedef struct exec_site
+{
+  const void *key;
+  size_t offset;
+  uint64_t counts[2];
+} Exec_Site;
+
+/// open addressed, a NULL `key` marks an empty entry
+typedef struct exec_site_table
+{
+  Exec_Site *entries;
+  size_t capacity;
+  size_t len;
+} Exec_Site_Table;
+
+/// Exact counts of what a run executed: every instruction dispatched by opcode, calls
+/// per function, whether each conditional jump was taken and how often each call
+/// site's inline cache (see `Call_Cache`) held the callee.
+///
+/// NOTE(HS): opcodes are counted as dispatched, quickened and superinstructions
+/// included, a quickened instruction whose guard fails is counted again in its generic
+/// form. Machine code from the JIT counts nothing, so counting runs without it.
+typedef struct exec_counters
+{
+  uint64_t opcodes[OPC_COUNT];
+  Exec_Site_Table functions;
+  Exec_Site_Table branches;
+  Exec_Site_Table call_sites;
+} Exec_Counters;
+
+void exec_counters_init(Exec_Counters *counters);
+void exec_counters_free(Exec_Counters *counters);
+
+/// zeroes every count
+void exec_counters_clear(Exec_Counters *counters);
+
+void exec_counters_call(Exec_Counters *counters, const Obj_Function *function);
+void exec_counters_branch(Exec_Counters *counters, const Chunk *chunk, size_t offset, bool taken);
+void exec_counters_cache(Exec_Counters *counters, const Chunk *chunk, size_t offset, bool hit);
+
+/// the counts kept for `key` (and `offset`), NULL when there are none
+const Exec_Site *exec_counters_find(const Exec_Site_Table *table, const void *key, size_t offset);
+
+/// writes the counts as a report, each section most frequent first, with positions
+/// given as lines and columns (from 1) of the source each function was compiled from
+/// (see `Chunk.source`), or `source` where that isn't known
+void exec_counters_write_report(const Exec_Counters *counters, const char *source, FILE *f);
+
+/// writes the counts as a single line JSON object, see `exec_counters_write_report`
+void exec_counters_write_json(const Exec_Counters *counters, const char *source, FILE *f);
+
+#endif // TYGER_EXEC_COUNTERS_H_
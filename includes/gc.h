@@ -0,0 +1,172 @@
+#ifndef TYGER_GC_H_
+#define TYGER_GC_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "value.h"
+
+/// pause histogram bucket `i` counts steps shorter than `2^i` microseconds, the last
+/// bucket counts every longer step
+#define GC_PAUSE_BUCKETS 16
+
+/// strings created at runtime up to this long are interned, longer strings are rarely
+/// keys and aren't worth hashing up front
+#define GC_INTERN_MAX 40
+
+/// results of `+` longer than this are ropes, copying shorter strings is cheaper than
+/// keeping track of their halves
+#define GC_ROPE_MIN 256
+
+typedef enum gc_phase
+{
+  GC_IDLE,
+  GC_MARK,
+  GC_SWEEP,
+} Gc_Phase;
+
+typedef struct gc_options
+{
+  /// heap size in bytes at which the first cycle starts
+  size_t initial_threshold;
+
+  /// how far the heap may grow past what survived a cycle before the next one starts,
+  /// 200 waits until it has doubled
+  unsigned pause_percent;
+
+  /// bytes of marking or sweeping done per byte allocated during a cycle, 200 does
+  /// twice as much work as was allocated
+  unsigned step_percent;
+
+  /// time a single step may take before it yields back to the VM, 0 for no limit
+  uint64_t max_pause_ns;
+} Gc_Options;
+
+typedef struct gc_stats
+{
+  size_t heap_bytes;
+  size_t heap_objects;
+  size_t interned_strings;
+  uint64_t bytes_allocated;
+  uint64_t bytes_freed;
+  uint64_t objects_freed;
+  uint64_t cycles;
+  uint64_t steps;
+  uint64_t total_pause_ns;
+  uint64_t max_pause_ns;
+  uint64_t pause_histogram[GC_PAUSE_BUCKETS];
+} Gc_Stats;
+
+typedef struct gc_gray_stack
+{
+  Obj **elems;
+  size_t capacity;
+  size_t len;
+} Gc_Gray_Stack;
+
+/// Open addressed (linear probing) set of interned strings
+///
+/// NOTE(HS): the table doesn't keep its strings alive, they are removed as they are
+/// swept
+typedef struct gc_intern_table
+{
+  Obj_String **entries;
+  size_t capacity;
+  size_t len;
+} Gc_Intern_Table;
+
+struct gc;
+
+/// The values a collection starts from, given to every step as the VM stack and
+/// globals move as they grow
+///
+/// NOTE(HS): constants are owned by their chunk rather than the collected heap, and
+/// never refer to collected objects, so they never need scanning. Open upvalues are
+/// roots as the VM still refers to them after every closure using them has gone.
+/// `mark_extra` (if not NULL) is called with `context` whenever the stack is scanned,
+/// to mark anything else the VM refers to which isn't a value on the stack.
+typedef struct gc_roots
+{
+  const Value *stack;
+  size_t stack_len;
+  const Value *globals;
+  size_t globals_len;
+  Obj_Upvalue *open_upvalues;
+  void (*mark_extra)(struct gc *gc, const void *context);
+  const void *context;
+} Gc_Roots;
+
+/// Incremental tri-color mark and sweep collector for objects created at runtime.
+///
+/// Objects are white (unvisited), gray (reached, children not yet visited) or black
+/// (reached, children visited). A cycle marks in steps interleaved with the program,
+/// which may store a white object into something already black, so every store into
+/// a global or heap object goes through `gc_write_barrier`, which grays it. Stack
+/// slots change too often for a barrier so the stack is scanned again, in one go,
+/// before marking finishes.
+///
+/// NOTE(HS): there are two whites which swap at the end of marking, anything still
+/// the old white is garbage and anything allocated from then on is the new white, so
+/// sweeping can run incrementally alongside allocation
+typedef struct gc
+{
+  Obj *objects;
+  Gc_Options options;
+  Gc_Phase phase;
+  uint8_t white;
+
+  Gc_Intern_Table strings;
+  Gc_Gray_Stack gray;
+  size_t globals_scanned;
+  Obj **sweep;
+
+  size_t threshold;
+  int64_t debt;
+  Gc_Stats stats;
+} Gc;
+
+Gc_Options gc_default_options(void);
+
+void gc_init(Gc *gc, Gc_Options options);
+
+/// frees every object the collector owns
+void gc_free(Gc *gc);
+
+/// takes effect from the next step, `initial_threshold` only until the first cycle
+void gc_set_options(Gc *gc, Gc_Options options);
+
+/// hands `obj`, which was just linked into `gc->objects`, over to the collector
+void gc_track(Gc *gc, Obj *obj);
+
+/// makes a string value, short strings are stored inline without allocating and
+/// strings up to `GC_INTERN_MAX` bytes are interned
+Value gc_string_new(Gc *gc, const char *chars, size_t len);
+Value gc_string_concat(Gc *gc, Value lhs, Value rhs);
+
+/// whether enough has been allocated that the VM should call `gc_step` at its next
+/// safe point
+static inline bool gc_should_step(const Gc *gc)
+{
+  return gc->debt > 0;
+}
+
+/// does a bounded amount of collection work, proportional to what was allocated since
+/// the last step
+void gc_step(Gc *gc, Gc_Roots roots);
+
+/// finishes any cycle in progress then runs a whole cycle
+void gc_collect(Gc *gc, Gc_Roots roots);
+
+void gc_mark_value(Gc *gc, Value v);
+
+/// must be called with every value stored into a global or heap object
+static inline void gc_write_barrier(Gc *gc, Value v)
+{
+  if (gc->phase == GC_MARK && v.kind == VAL_OBJ && v.as.obj->color == gc->white)
+  {
+    gc_mark_value(gc, v);
+  }
+}
+
+Gc_Stats gc_get_stats(const Gc *gc);
+
+#endif // TYGER_GC_H_
@@ -0,0 +1,241 @@
+#ifndef TYGER_IR_H_
+#define TYGER_IR_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "call_profile.h"
+#include "parser.h"
+#include "tstrings.h"
+
+/// NOTE(HS): `PURE` instructions compute their result from their operands alone (they
+/// may still fail on operands of the wrong type), `LOAD` ones read a global or
+/// upvalue, `EFFECT` ones write one or call a function. A `TERMINATOR` ends its block.
+enum
+{
+  IR_PURE       = 1 << 0,
+  IR_LOAD       = 1 << 1,
+  IR_EFFECT     = 1 << 2,
+  IR_TERMINATOR = 1 << 3,
+};
+
+typedef enum ir_op
+{
+#define X(NAME, FLAGS) IR_##NAME,
+  #include "defs/ir-op.def"
+#undef X
+} Ir_Op;
+
+/// the runtime types a value may have, as a set
+typedef enum ir_type
+{
+  IR_TYPE_INT      = 1 << 0,
+  IR_TYPE_BIGINT   = 1 << 1,
+  IR_TYPE_STRING   = 1 << 2,
+  IR_TYPE_BOOL     = 1 << 3,
+  IR_TYPE_NIL      = 1 << 4,
+  IR_TYPE_FUNCTION = 1 << 5,
+
+  IR_TYPE_NUMBER   = IR_TYPE_INT | IR_TYPE_BIGINT,
+  IR_TYPE_ANY      = (1 << 6) - 1,
+} Ir_Type;
+
+/// values and blocks are both numbered from 0 in the order they were made
+typedef uint32_t Ir_Value;
+typedef uint32_t Ir_Block_Id;
+
+#define IR_NONE UINT32_MAX
+
+typedef struct ir_id_vaarray
+{
+  uint32_t *elems;
+  size_t capacity;
+  size_t len;
+} Ir_Id_VaArray;
+
+/// a string literal as written in the source, or the digits of a bigint literal
+typedef struct ir_literal
+{
+  const char *chars;
+  size_t len;
+} Ir_Literal;
+
+/// One instruction, which is also the value it computes.
+///
+/// NOTE(HS): `args` are the operands, a `CALL`'s callee comes first. `as.slot` is the
+/// global, upvalue, parameter or builtin an instruction refers to, and for a `PHI` the
+/// local it merges, whose `args[i]` comes from `preds[i]` of its block. `IS_FUNCTION`
+/// is the guard of an inlined call, whether its operand is the function compiled from
+/// `as.function`. An instruction
+/// which is optimised away is `removed`, uses of it read `replacement` instead when
+/// it was replaced by another value, see `ir_resolve`.
+typedef struct ir_instr
+{
+  Ir_Op op;
+  Ir_Block_Id block;
+  size_t pos;
+  Ir_Id_VaArray args;
+  union
+  {
+    int64_t integer;
+    bool boolean;
+    size_t slot;
+    Ir_Literal literal;
+    const Func_Expression *function;
+  } as;
+  Ir_Value replacement;
+  bool removed;
+
+  /// the types the value may have, see `ir_infer_types`
+  uint8_t type;
+} Ir_Instr;
+
+typedef struct ir_instr_vaarray
+{
+  Ir_Instr *elems;
+  size_t capacity;
+  size_t len;
+} Ir_Instr_VaArray;
+
+/// A basic block, its phis are kept apart from the rest of its instructions, the last
+/// of which is its terminator. A `BRANCH` goes to `succs[0]` when its operand is
+/// truthy and `succs[1]` otherwise.
+typedef struct ir_block
+{
+  Ir_Id_VaArray phis;
+  Ir_Id_VaArray instrs;
+  Ir_Id_VaArray preds;
+  Ir_Block_Id succs[2];
+  size_t succs_len;
+
+  /// immediate dominator and index in `Ir_Function.order`, see `ir_compute_order`
+  Ir_Block_Id idom;
+  size_t order;
+  bool removed;
+
+  /// while the IR is built, the value each local has at the end of the block and
+  /// whether every predecessor is known
+  Ir_Value *defs;
+  size_t defs_len;
+  Ir_Id_VaArray incomplete_phis;
+  bool sealed;
+} Ir_Block;
+
+typedef struct ir_block_vaarray
+{
+  Ir_Block *elems;
+  size_t capacity;
+  size_t len;
+} Ir_Block_VaArray;
+
+/// The SSA form of one function literal (or the script), built from the resolved AST.
+///
+/// NOTE(HS): locals become values, globals and upvalues stay in memory and are read and
+/// written by `LOAD_*` and `STORE_*`. A function whose own locals are captured by a
+/// closure is left to the bytecode compiler, as closures need those locals to stay in
+/// their frame slots.
+typedef struct ir_function
+{
+  const Program *program;
+
+  /// NULL for the script
+  const Func_Expression *fexpr;
+  size_t arity;
+
+  Ir_Instr_VaArray instrs;
+  Ir_Block_VaArray blocks;
+
+  /// every reachable block in reverse post order, loop bodies before their exits
+  Ir_Id_VaArray order;
+
+  /// why the function couldn't be built, when it couldn't
+  const char *unsupported;
+} Ir_Function;
+
+/// The literal each global of a program is only ever set to, if any, indexed by slot.
+/// Found once for the whole program so inlining into each of its functions doesn't
+/// search it again.
+typedef struct ir_globals
+{
+  const Func_Expression **literals;
+  size_t len;
+} Ir_Globals;
+
+void ir_globals_init(Ir_Globals *globals, const Program *prog);
+void ir_globals_free(Ir_Globals *globals);
+
+/// the passes `ir_optimise` runs
+typedef struct ir_options
+{
+  /// constant and copy propagation, folding branches on constants and dropping the
+  /// blocks they no longer reach
+  bool fold;
+
+  /// global value numbering of pure instructions, and loads within a block
+  bool gvn;
+
+  /// loop invariant code motion, into the block before the loop
+  bool licm;
+
+  /// dead code elimination
+  bool dce;
+
+  /// inlining of calls to small functions, see `ir_inline`. An inlined function has at
+  /// most `inline_max_size` instructions, a function grows by at most `inline_budget`
+  /// instructions, and calls in inlined code are inlined `inline_max_depth` deep.
+  bool inline_calls;
+  size_t inline_max_size;
+  size_t inline_budget;
+  size_t inline_max_depth;
+
+  /// sites seen calling one function, whose calls are inlined too, may be NULL
+  const Call_Profile *call_profile;
+
+  /// the globals of the program being optimised, `ir_inline` finds them itself
+  /// when NULL
+  const Ir_Globals *globals;
+} Ir_Options;
+
+Ir_Options ir_default_options(void);
+
+/// builds the IR of `fexpr` (the script when NULL) in `prog`, which has been through
+/// the resolver, returns false and sets `fn->unsupported` when it can't be
+bool ir_build_function(Ir_Function *fn, const Program *prog, const Func_Expression *fexpr);
+void ir_function_free(Ir_Function *fn);
+
+void ir_optimise(Ir_Function *fn, Ir_Options options);
+
+/// Replaces calls in `fn` with the body of the function they call, when that's a small
+/// function literal which captures nothing, isn't `@memo` and doesn't call itself.
+///
+/// NOTE(HS): the callee of a call is known when it's a literal in `fn`, otherwise it's
+/// the literal a global is only ever set to, or the one the site called in
+/// `call_profile`. The inlined body of either of those is only run when an
+/// `IS_FUNCTION` guard finds that literal's function is being called, the call is made
+/// as before otherwise. Inlined instructions keep their positions, errors in them are
+/// reported where they would be had the call been made.
+void ir_inline(Ir_Function *fn, Ir_Options options);
+
+/// the value a use of `v` reads, following replacements
+Ir_Value ir_resolve(const Ir_Function *fn, Ir_Value v);
+
+/// fills `order`, `idom` and `Ir_Block.order` for the blocks reachable from the entry
+void ir_compute_order(Ir_Function *fn);
+
+/// sets `Ir_Instr.type` of every instruction
+void ir_infer_types(Ir_Function *fn);
+
+/// whether the instruction may stop the program with an error, judged by the types of
+/// its operands
+bool ir_instr_may_fail(const Ir_Function *fn, const Ir_Instr *instr);
+
+/// gives every edge from a block with two successors to a block with two or more
+/// predecessors a block of its own, so copies into phis have somewhere to go
+void ir_split_critical_edges(Ir_Function *fn);
+
+size_t ir_op_flags(Ir_Op op);
+const char *ir_op_to_string(Ir_Op op);
+
+/// appends a listing of `fn` to `sb`
+void ir_function_append(const Ir_Function *fn, String_Builder *sb);
+
+#endif // TYGER_IR_H_
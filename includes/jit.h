@@ -0,0 +1,80 @@
+#ifndef TYGER_JIT_H_
+#define TYGER_JIT_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "chunk.h"
+#include "value.h"
+
+/// set when machine code can be generated for this target, the JIT is only built for
+/// x86-64 Linux and can be left out entirely by configuring with `-DTYGER_JIT=OFF`
+#if defined(TYGER_JIT) && defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+/// default for `VM.jit_threshold`, calls plus loop iterations before a chunk compiles
+#define JIT_DEFAULT_THRESHOLD 1000
+
+/// guard failures a chunk's code may have before it's thrown away and the chunk is
+/// left to the interpreter for good
+#define JIT_MAX_DEOPTS 64
+
+/// the interpreter state compiled code runs on, `sp` and `exit_offset` are where the
+/// interpreter carries on once it returns
+typedef struct jit_frame
+{
+  Value *slots;
+  Value *globals;
+  Value *sp;
+  uint32_t exit_offset;
+
+  /// set when the code returned because a guard failed, rather than reaching an
+  /// instruction it doesn't compile
+  bool deopt;
+} Jit_Frame;
+
+/// Machine code for one chunk, made by stitching together a template per instruction.
+///
+/// NOTE(HS): the code works on the same stack as the interpreter, so it can hand over
+/// between any two instructions. Within a block ints and bools are kept in registers
+/// (and locals are read straight from their slots) and only written to the stack at
+/// the end of the block, or when the code returns early. Calls, returns and anything
+/// which allocates return to the interpreter, which re-enters the code once the call
+/// returns or at the next loop iteration. Every int operation is guarded, a value of
+/// another type (or overflow) writes the stack back and returns to the interpreter
+/// at the instruction which failed, which then runs it as it always would.
+typedef struct jit_code
+{
+  uint8_t *code;
+  size_t size;
+
+  /// where the code for each instruction it can be entered at starts, by bytecode
+  /// offset
+  struct jit_entry *entries;
+  size_t entries_len;
+
+  uint64_t deopts;
+} Jit_Code;
+
+/// an instruction compiled code can be entered at, and the stack depth it expects
+/// there, `code` is `JIT_NO_ENTRY` for every other instruction
+typedef struct jit_entry
+{
+  uint32_t code;
+  uint32_t depth;
+} Jit_Entry;
+
+#define JIT_NO_ENTRY UINT32_MAX
+
+/// compiles `chunk`, returning NULL when it can't be (unsupported target, no loops
+/// worth compiling or executable memory unavailable)
+Jit_Code *jit_compile(const Chunk *chunk);
+void jit_code_free(Jit_Code *code);
+
+/// runs `code` from the instruction at `offset`, returns false without running
+/// anything when it can't be entered there
+bool jit_enter(const Jit_Code *code, size_t offset, Jit_Frame *frame);
+
+#endif // TYGER_JIT_H_
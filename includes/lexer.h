@@ -2,6 +2,7 @@
 #define TYGER_LEXER_H_
 #include <stddef.h>
 #include "tstrings.h"
+#include "tyger_error.h"
 
 typedef enum token_kind
 {
@@ -10,13 +11,6 @@ typedef enum token_kind
 #undef X
 } Token_Kind;
 
-typedef struct location
-{
-  size_t pos;
-  size_t col;
-  size_t line;
-} Location;
-
 typedef struct token
 {
   Location location;
@@ -36,11 +30,52 @@ typedef struct lexer
 } Lexer;
 
 void lexer_init(Lexer *lx, const char *program);
+
+/// starts lexing `program` part way through, at `pos`, tokens keep their position
+/// within the whole program
+void lexer_init_at(Lexer *lx, const char *program, size_t pos);
 Token lexer_next_token(Lexer *lx);
 const char *token_kind_to_string(Token_Kind kind);
 
 void token_to_string(Token t, char *buffer, int buffer_size);
 
+/// where every line of a program starts, for finding the locations of many positions
+/// without rescanning it for each one
+typedef struct line_index
+{
+  size_t *elems;
+  size_t capacity;
+  size_t len;
+} Line_Index;
+
+void line_index_init(Line_Index *index, const char *program);
+void line_index_free(Line_Index *index);
+
+/// the (0 based) line and column of `pos`, the same as `location_from_pos`
+Location line_index_location(const Line_Index *index, size_t pos);
+
+typedef struct line_index_entry
+{
+  const char *program;
+  Line_Index index;
+} Line_Index_Entry;
+
+/// line indexes of several programs, each made the first time a position in it is
+/// looked up, for reports whose positions may be in any of them (e.g. functions from
+/// different REPL lines)
+typedef struct line_index_set
+{
+  Line_Index_Entry *elems;
+  size_t capacity;
+  size_t len;
+} Line_Index_Set;
+
+void line_index_set_init(Line_Index_Set *set);
+void line_index_set_free(Line_Index_Set *set);
+
+/// the (0 based) line and column of `pos` within `program`
+Location line_index_set_location(Line_Index_Set *set, const char *program, size_t pos);
+
 #define LOCATION_FMT "Location{ .pos = %zu, .col = %zu, .line = %zu }"
 #define LOCATION_ARGS(L) (L).pos, (L).col, (L).line
 #define TOKEN_FMT "Token{ .kind = %s, .location = " LOCATION_FMT ", .literal = \"" SV_FMT "\" }"
@@ -0,0 +1,119 @@
+#ifndef TYGER_MEMO_H_
+#define TYGER_MEMO_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "value.h"
+#include "chunk.h"
+#include "gc.h"
+
+/// default for `VM.memo_capacity`, the most results cached per function
+#define MEMO_DEFAULT_CAPACITY 4096
+
+/// marks the end of a bucket chain or the recency list
+#define MEMO_NONE UINT32_MAX
+
+typedef struct memo_stats
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} Memo_Stats;
+
+/// a call's claim on the entry it fills when it returns, `cache` is NULL for calls to
+/// functions which aren't memoised
+typedef struct memo_ref
+{
+  struct memo_cache *cache;
+  uint32_t index;
+  uint32_t generation;
+} Memo_Ref;
+
+/// NOTE(HS): an entry is pending from the call which missed until it returns, pending
+/// entries are never hit. `generation` is bumped whenever the entry is reused, so a
+/// call whose entry was evicted whilst it ran doesn't fill someone else's.
+typedef struct memo_entry
+{
+  Value result;
+  uint32_t hash;
+  uint32_t generation;
+
+  /// the pending entry of the call which tail called this one, and so has the same
+  /// result
+  Memo_Ref caller;
+
+  /// next entry in the same bucket, then the entries used just after and before
+  uint32_t chain;
+  uint32_t newer;
+  uint32_t older;
+  bool ready;
+} Memo_Entry;
+
+/// The results of one `@memo` function keyed by its arguments, holding at most
+/// `capacity` of them and evicting the least recently used.
+///
+/// NOTE(HS): entry `i`'s arguments are `keys[i * arity..]`. Entries are allocated as
+/// they're needed (up to `capacity`) and chained from `buckets` by hash, both lists
+/// link entries by index.
+typedef struct memo_cache
+{
+  const Obj_Function *function;
+  size_t arity;
+  size_t capacity;
+
+  Memo_Entry *entries;
+  Value *keys;
+  size_t allocated;
+  size_t used;
+  uint32_t free;
+
+  uint32_t *buckets;
+  size_t bucket_count;
+
+  uint32_t newest;
+  uint32_t oldest;
+
+  Memo_Stats stats;
+} Memo_Cache;
+
+/// Open addressed (linear probing) map from each `@memo` function a VM has called to
+/// its cache
+///
+/// NOTE(HS): functions are keyed by address, which is only unique because the chunks
+/// owning them outlive the VM (as they must anyway, for globals referring to them)
+typedef struct memo_table
+{
+  Memo_Cache **entries;
+  size_t capacity;
+  size_t len;
+} Memo_Table;
+
+void memo_table_init(Memo_Table *table);
+void memo_table_free(Memo_Table *table);
+
+/// the cache of `function`, made with room for `capacity` results on its first call
+Memo_Cache *memo_table_cache(Memo_Table *table, const Obj_Function *function, size_t capacity);
+
+/// looks up the call of `cache`'s function with `args`. A hit sets `*result`, a miss
+/// adds a pending entry (evicting the least recently used one if the cache is full)
+/// and sets `*ref` to it. `caller` is the pending entry of a call making this one as
+/// a tail call, filled along with the new entry.
+bool memo_cache_call(
+  Memo_Cache *cache, const Value *args, Memo_Ref caller, Value *result, Memo_Ref *ref
+);
+
+/// stores the result of the call which made `ref` (and of the calls which tail called
+/// it), unless its entry has since been evicted
+void memo_ref_fill(Memo_Ref ref, Value result);
+
+/// removes the pending entries of a call which won't return, and of its tail callers
+void memo_ref_abandon(Memo_Ref ref);
+
+/// marks every argument and result cached, the caches are roots of the VM
+void memo_table_mark(Gc *gc, const Memo_Table *table);
+
+/// writes one `<hits> <misses> <evictions> <name>` line per cache
+void memo_table_write_stats(const Memo_Table *table, FILE *f);
+
+#endif // TYGER_MEMO_H_
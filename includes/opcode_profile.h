@@ -0,0 +1,47 @@
+#ifndef TYGER_OPCODE_PROFILE_H_
+#define TYGER_OPCODE_PROFILE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "chunk.h"
+
+/// longest run of adjacent instructions counted by the profiler
+#define OPCODE_PROFILE_MAX_SEQUENCE 4
+
+typedef struct opcode_sequence_count
+{
+  uint64_t key;
+  uint64_t count;
+} Opcode_Sequence_Count;
+
+/// Counts how often runs of 2 to `OPCODE_PROFILE_MAX_SEQUENCE` adjacent instructions
+/// are dispatched one after the other, used to choose superinstructions.
+///
+/// NOTE(HS): only runs which are also adjacent in the code are counted (a taken jump
+/// starts a new run), and quickened instructions are counted as their generic form,
+/// so every counted run is one the compiler could fuse
+typedef struct opcode_profile
+{
+  Opcode_Sequence_Count *entries;
+  size_t capacity;
+  size_t len;
+
+  const uint8_t *last;
+  const uint8_t *expected;
+  Opcode window[OPCODE_PROFILE_MAX_SEQUENCE - 1];
+  size_t window_len;
+} Opcode_Profile;
+
+void opcode_profile_init(Opcode_Profile *profile);
+void opcode_profile_free(Opcode_Profile *profile);
+
+/// records the dispatch of the instruction starting at `instruction`
+void opcode_profile_record(Opcode_Profile *profile, const uint8_t *instruction);
+
+/// returns how many times the run `ops[0..len]` was dispatched
+uint64_t opcode_profile_count(const Opcode_Profile *profile, const Opcode *ops, size_t len);
+
+/// writes one `<count> <OP> <OP>...` line per run, most frequent first
+void opcode_profile_write(const Opcode_Profile *profile, FILE *f);
+
+#endif // TYGER_OPCODE_PROFILE_H_
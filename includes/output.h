@@ -0,0 +1,50 @@
+#ifndef TYGER_OUTPUT_H_
+#define TYGER_OUTPUT_H_
+#include <stdbool.h>
+#include <stddef.h>
+
+#define OUTPUT_DEFAULT_CAPACITY (64 * 1024)
+
+typedef enum output_flush
+{
+  /// flush on newline when the output is a terminal, otherwise as `OUTPUT_FLUSH_FULL`
+  OUTPUT_FLUSH_AUTO,
+  /// flush after every write containing a newline
+  OUTPUT_FLUSH_LINE,
+  /// flush only when the buffer is full or on `output_flush`
+  OUTPUT_FLUSH_FULL,
+} Output_Flush;
+
+/// Buffer shared by every output builtin, written to a file descriptor with `write(2)`
+/// rather than through `stdio`, so a line of output is a `memcpy` instead of a locked
+/// `fprintf` call.
+///
+/// NOTE(HS): writes at least as large as the buffer skip it, any buffered bytes are
+/// flushed first and the write then goes straight to the descriptor
+typedef struct output
+{
+  int fd;
+  char *buffer;
+  size_t len;
+  size_t capacity;
+  bool line_buffered;
+
+  /// number of `write(2)` calls made, for tests and tuning
+  size_t writes;
+} Output;
+
+/// `capacity` of 0 leaves the output unbuffered
+void output_init(Output *out, int fd, size_t capacity, Output_Flush flush);
+
+/// flushes any buffered bytes before freeing the buffer
+void output_free(Output *out);
+
+void output_write(Output *out, const char *bytes, size_t len);
+void output_puts(Output *out, const char *str);
+void output_putc(Output *out, char c);
+void output_flush(Output *out);
+
+/// parses a flush policy name (`auto`, `line` or `full`), returning whether it was valid
+bool output_flush_from_string(const char *name, Output_Flush *flush);
+
+#endif // TYGER_OUTPUT_H_
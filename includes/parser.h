@@ -1,20 +1,16 @@
 #ifndef TYGER_PARSER_H_
 #define TYGER_PARSER_H_
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include "tstrings.h"
 #include "lexer.h"
+#include "tyger_error.h"
 
 typedef size_t Ident_Handle;
 typedef size_t Expression_Handle;
 typedef size_t String_Handle;
-
-typedef enum tyger_error_kind
-{
-#define X(NAME) TYERR_##NAME,
-  #include "defs/tyger-error-kind.def"
-#undef X
-} Tyger_Error_Kind;
+typedef size_t Statement_Handle;
 
 typedef enum statement_kind
 {
@@ -30,6 +26,13 @@ typedef enum expression_kind
 #undef X
 } Expression_Kind;
 
+typedef enum binding_kind
+{
+#define X(NAME) BINDING_##NAME,
+  #include "defs/binding-kind.def"
+#undef X
+} Binding_Kind;
+
 typedef enum
 {
 #define X(NAME, ...) OP_##NAME,
@@ -37,18 +40,41 @@ typedef enum
 #undef X
 } Operator;
 
-typedef struct tyger_error
+/// Sentinel for bindings which have no declaring `STMT_VAR` in the current program
+/// (builtins, or globals declared by a previously resolved program e.g. in the REPL)
+#define BINDING_NO_DECLARATION ((Ident_Handle) -1)
+
+/// Where the value of a variable lives at runtime, filled in by the resolver.
+///   - GLOBAL:  `slot` is the index into the global table
+///   - LOCAL:   `slot` is the index into the current frame, `depth` the number of
+///              function boundaries between the use and the declaration
+///   - UPVALUE: `slot` is the index into the current closure's upvalues, `depth` as
+///              for LOCAL
+///   - BUILTIN: `slot` is the index of the builtin function
+typedef struct binding
 {
-  Tyger_Error_Kind kind;
-} Tyger_Error;
+  Binding_Kind kind;
+  size_t depth;
+  size_t slot;
+  Ident_Handle declaration;
+} Binding;
 
 typedef struct expression Expression;
 
+/// NOTE(HS): literals too large for an `int64_t` keep their digits in
+/// `Parser_Context.strings` and become bigints when compiled
 typedef struct int_expression
 {
   int64_t value;
+  bool is_big;
+  String_Handle digits_handle;
 } Int_Expression;
 
+typedef struct bool_expression
+{
+  bool value;
+} Bool_Expression;
+
 typedef struct string_expression
 {
   String_Handle string_handle;
@@ -58,8 +84,15 @@ typedef struct string_expression
 typedef struct ident_expression
 {
   Ident_Handle ident_handle;
+  Binding binding;
 } Ident_Expression;
 
+typedef struct prefix_expression
+{
+  Operator op;
+  Expression_Handle rhs;
+} Prefix_Expression;
+
 typedef struct infix_expression
 {
   Operator op;
@@ -67,19 +100,63 @@ typedef struct infix_expression
   Expression_Handle rhs;
 } Infix_Expression;
 
-typedef struct argument_list
-{
-  Expression *elems;
-  size_t capacity;
-  size_t len;
-} Argument_List;
-
+/// NOTE(HS): arguments are stored contiguously in `Parser_Context.expressions` starting
+/// at `args_first`
 typedef struct call_expression
 {
   Expression_Handle function;
-  Argument_List args;
+  Expression_Handle args_first;
+  size_t args_len;
 } Call_Expression;
 
+/// Sentinel for function literals which are not directly bound to a name
+#define FUNC_ANONYMOUS ((Ident_Handle) -1)
+
+/// A variable captured by a function literal, filled in by the resolver. `index` is a
+/// slot of the enclosing function's frame when `is_local`, otherwise one of the
+/// enclosing function's own upvalues.
+typedef struct func_upvalue
+{
+  bool is_local;
+  size_t index;
+} Func_Upvalue;
+
+typedef struct func_upvalue_vaarray
+{
+  Func_Upvalue *elems;
+  size_t capacity;
+  size_t len;
+} Func_Upvalue_VaArray;
+
+/// NOTE(HS): parameters are stored contiguously in `Parser_Context.params` starting at
+/// `params_first`, each one a handle into `identifiers`. `body` is always a `STMT_BLOCK`.
+/// `name` is the identifier of the `var`/`const` the literal initialises, if any.
+/// Captured variables are likewise stored in `Parser_Context.upvalues` from
+/// `upvalues_first`, a literal which captures nothing compiles to a plain function.
+/// `memo` is set for literals annotated `@memo`, which must be pure (see `purity.h`).
+///
+/// The body of a `lazy` literal was only brace matched (see `Parser.lazy_functions`),
+/// `body` is an empty block. It's parsed from the source, starting at the literal, by
+/// `parser_parse_function` when the function is first called. `visible_globals`, set by
+/// the resolver, is how many globals were declared where the literal is, the only ones
+/// its body may then use.
+typedef struct func_expression
+{
+  size_t params_first;
+  size_t params_len;
+  size_t upvalues_first;
+  size_t upvalues_len;
+  Statement_Handle body;
+  Ident_Handle name;
+  bool memo;
+  bool lazy;
+  size_t visible_globals;
+
+  /// where the literal's `func` keyword is, which a `lazy` body is parsed again from.
+  /// Not the expression's location, which for e.g. `(func() {...})` is the paren.
+  size_t pos;
+} Func_Expression;
+
 typedef union uexpression
 {
   Int_Expression int_expression;
@@ -87,11 +164,15 @@ typedef union uexpression
   Ident_Expression ident_expression;
   Infix_Expression infix_expression;
   Call_Expression call_expression;
+  Bool_Expression bool_expression;
+  Prefix_Expression prefix_expression;
+  Func_Expression func_expression;
 } uExpression;
 
 struct expression
 {
   Expression_Kind kind;
+  Location location;
   uExpression expression;
 };
 
@@ -99,6 +180,8 @@ typedef struct var_statement
 {
   Ident_Handle ident_handle;
   Expression_Handle expression_handle;
+  Binding binding;
+  bool is_const;
 } Var_Statement;
 
 typedef struct expression_statement
@@ -106,15 +189,62 @@ typedef struct expression_statement
   Expression_Handle expression_handle;
 } Expression_Statement;
 
+/// NOTE(HS): block statements are stored contiguously in `Parser_Context.statements`,
+/// starting at `first`. `captures` is set by the resolver when a function literal
+/// captures one of the block's locals, which then have to be closed on exit.
+typedef struct block_statement
+{
+  Statement_Handle first;
+  size_t len;
+  bool captures;
+} Block_Statement;
+
+/// NOTE(HS): `ident_handle` is a handle into `evaluated_identifiers`, as the target
+/// of an assignment is a use of an existing variable
+typedef struct assign_statement
+{
+  Ident_Handle ident_handle;
+  Expression_Handle expression_handle;
+  Binding binding;
+} Assign_Statement;
+
+/// NOTE(HS): `consequence` is always a `STMT_BLOCK`, `alternative` is either a
+/// `STMT_BLOCK` or another `STMT_IF` (for `else if`)
+typedef struct if_statement
+{
+  Expression_Handle condition;
+  Statement_Handle consequence;
+  Statement_Handle alternative;
+  bool has_alternative;
+} If_Statement;
+
+typedef struct while_statement
+{
+  Expression_Handle condition;
+  Statement_Handle body;
+} While_Statement;
+
+typedef struct return_statement
+{
+  Expression_Handle expression_handle;
+  bool has_value;
+} Return_Statement;
+
 typedef union ustatement
 {
   Var_Statement var_statement;
   Expression_Statement expression_statement;
+  Block_Statement block_statement;
+  Assign_Statement assign_statement;
+  If_Statement if_statement;
+  While_Statement while_statement;
+  Return_Statement return_statement;
 } uStatement;
 
 typedef struct statement
 {
   Statement_Kind kind;
+  Location location;
   uStatement statement;
 } Statement;
 
@@ -146,6 +276,13 @@ typedef struct expression_vaarray
   size_t len;
 } Expression_VaArray;
 
+typedef struct ident_handle_vaarray
+{
+  Ident_Handle *elems;
+  size_t capacity;
+  size_t len;
+} Ident_Handle_VaArray;
+
 // TODO(HS): use a hash map for identifiers?
 typedef struct parser_context
 {
@@ -153,13 +290,27 @@ typedef struct parser_context
   String_VaArray evaluated_identifiers;
   Expression_VaArray expressions;
   String_VaArray strings;
+  Statement_VaArray statements;
+  Ident_Handle_VaArray params;
+  Func_Upvalue_VaArray upvalues;
+
+  /// arguments of the calls being parsed, nested calls push theirs above those of the
+  /// calls around them and pop them once they've been copied into `expressions`
+  Expression_VaArray arguments;
 } Parser_Context;
 
+/// NOTE(HS): with `lazy_functions` set the bodies of function literals in top level
+/// statements are pre-parsed, only matching braces to find where they end, so a body
+/// costs next to nothing until it's called. Literals anywhere else may capture locals,
+/// which the resolver has to see, and are always parsed in full. `depth` counts the
+/// blocks being parsed.
 typedef struct parser
 {
   Lexer *lexer;
   Token cur_token;
   Token peek_token;
+  bool lazy_functions;
+  size_t depth;
 } Parser;
 
 typedef struct program
@@ -171,27 +322,47 @@ typedef struct program
 
 void parser_init(Parser *p, Lexer *lx);
 Program parser_parse_program(Parser *p);
+
+/// parses the function literal the parser is at into a program of one expression
+/// statement, used to parse the body of a `lazy` literal from its source
+Program parser_parse_function(Parser *p);
 void program_free(Program *p);
 
-const char *tyger_error_kind_to_string(Tyger_Error_Kind kind);
 const char *statement_kind_to_string(Statement_Kind kind);
 const char *expression_kind_to_string(Expression_Kind kind);
 const char *operator_to_string(Operator op);
+const char *binding_kind_to_string(Binding_Kind kind);
 
 const char *ident_handle_to_ident(const Program *p, Ident_Handle hndl);
 const char *ident_handle_to_evaluated_ident(const Program *p, Ident_Handle hndl);
 const char *string_handle_to_cstring(const Program *p, String_Handle hndl);
 const Expression *expression_handle_to_expression(const Program *p, Expression_Handle hndl);
+const Statement *statement_handle_to_statement(const Program *p, Statement_Handle hndl);
+Ident_Handle func_expression_param(const Program *p, const Func_Expression *fexpr, size_t index);
+Func_Upvalue func_expression_upvalue(const Program *p, const Func_Expression *fexpr, size_t index);
+
+/// the source position of the literal `fexpr`
+size_t func_expression_pos(const Func_Expression *fexpr);
 
 Tyger_Error parser_parse_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
 Tyger_Error parse_var_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
 Tyger_Error parse_expression_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
+Tyger_Error parse_block_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
+Tyger_Error parse_assign_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
+Tyger_Error parse_if_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
+Tyger_Error parse_while_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
+Tyger_Error parse_return_statement(Parser *p, Parser_Context *ctx, Statement *stmt);
 
-Tyger_Error parse_int_expression(Parser *p, Expression *expr);
+Tyger_Error parse_int_expression(Parser *p, Parser_Context *ctx, Expression *expr);
 Tyger_Error parse_string_expression(Parser *p, Parser_Context *ctx, Expression *expr);
 Tyger_Error parse_ident_expression(Parser *p, Parser_Context *ctx, Expression *expr);
+Tyger_Error parse_bool_expression(Parser *p, Expression *expr);
+Tyger_Error parse_grouped_expression(Parser *p, Parser_Context *ctx, Expression *expr);
+Tyger_Error parse_prefix_expression(Parser *p, Parser_Context *ctx, Expression *expr);
 Tyger_Error parse_infix_expression(Parser *p, Parser_Context *ctx, Expression *lhs);
+Tyger_Error parse_func_expression(Parser *p, Parser_Context *ctx, Expression *expr);
+Tyger_Error parse_annotated_expression(Parser *p, Parser_Context *ctx, Expression *expr);
 Tyger_Error parse_call_expression(Parser *p, Parser_Context *ctx, Expression *expr);
-Tyger_Error parse_call_expression_args(Parser *p, Parser_Context *ctx, Argument_List *args);
+Tyger_Error parse_call_expression_args(Parser *p, Parser_Context *ctx);
 
 #endif // TYGER_PARSER_H_
@@ -0,0 +1,90 @@
+#ifndef TYGER_PHASE_TRACE_H_
+#define TYGER_PHASE_TRACE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/// events kept per thread, once full the oldest are overwritten
+#define PHASE_TRACE_CAPACITY 8192
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PHASE_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define PHASE_THREAD_LOCAL __declspec(thread)
+#else
+#define PHASE_THREAD_LOCAL
+#endif
+
+/// a phase which ran from `start_ns` for `duration_ns`, `name` is a string literal
+typedef struct phase_event
+{
+  const char *name;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+} Phase_Event;
+
+/// The phases (parsing, compiling, running, collecting...) one thread went through,
+/// the last `PHASE_TRACE_CAPACITY` of them.
+///
+/// NOTE(HS): a thread only records into its own trace, so recording takes no locks.
+/// Traces are kept (in a list of every thread's) until `phase_trace_free`, so one
+/// whose thread has finished can still be written.
+typedef struct phase_trace
+{
+  Phase_Event events[PHASE_TRACE_CAPACITY];
+
+  /// events recorded, the next goes in `events[recorded % PHASE_TRACE_CAPACITY]`
+  uint64_t recorded;
+  uint32_t tid;
+  struct phase_trace *next;
+} Phase_Trace;
+
+/// the calling thread's trace while it's recording, NULL otherwise
+extern PHASE_THREAD_LOCAL Phase_Trace *phase_trace_current;
+
+/// a phase started by `phase_begin`, `trace` is NULL when its thread wasn't recording
+typedef struct phase_scope
+{
+  Phase_Trace *trace;
+  const char *name;
+  uint64_t start_ns;
+} Phase_Scope;
+
+/// starts recording the calling thread's phases, into the trace it had before if any
+void phase_trace_start(void);
+
+/// stops recording the calling thread's phases, what was recorded is kept
+void phase_trace_stop(void);
+
+/// writes every thread's events as a Chrome `trace_event` JSON object
+void phase_trace_write(FILE *f);
+
+/// frees every thread's trace, none may be recording
+void phase_trace_free(void);
+
+uint64_t phase_trace_now_ns(void);
+void phase_trace_record(Phase_Trace *trace, const char *name, uint64_t start_ns, uint64_t end_ns);
+
+/// starts timing the phase `name` (a string literal), ended by `phase_end`
+///
+/// NOTE(HS): when the thread isn't recording the only cost is the branch on
+/// `phase_trace_current` (and the one on `trace` in `phase_end`)
+static inline Phase_Scope phase_begin(const char *name)
+{
+  Phase_Scope scope = { phase_trace_current, name, 0 };
+  if (scope.trace)
+  {
+    scope.start_ns = phase_trace_now_ns();
+  }
+  return scope;
+}
+
+static inline void phase_end(Phase_Scope scope)
+{
+  if (scope.trace)
+  {
+    phase_trace_record(scope.trace, scope.name, scope.start_ns, phase_trace_now_ns());
+  }
+}
+
+#endif // TYGER_PHASE_TRACE_H_
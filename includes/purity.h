@@ -0,0 +1,25 @@
+#ifndef TYGER_PURITY_H_
+#define TYGER_PURITY_H_
+#include <stdbool.h>
+#include "parser.h"
+
+/// Proves that a function literal is pure: calling it with the same arguments always
+/// gives the same result and does nothing else. A pure function
+///   - assigns no global and captures no variable (nor reads one it captured),
+///   - reads only globals declared in the same program which are never reassigned,
+///   - calls only builtins marked pure in `defs/builtin.def` and globals holding
+///     function literals which are themselves pure.
+///
+/// Only `@memo` functions (and the functions they call) are analysed, those which
+/// can't be proven pure are reported as errors in `prog->errors`.
+///
+/// NOTE(HS): `prog` must have been resolved without errors. Globals declared by
+/// earlier programs (e.g. REPL lines) may be reassigned by later ones, so they're
+/// never trusted.
+void purity_check_program(Program *prog);
+
+/// whether `fexpr` was proven pure, if it wasn't `reason` (if not NULL) is set to a
+/// description of the first impure thing it does, which must be freed by the caller
+bool purity_is_pure(const Program *prog, const Func_Expression *fexpr, char **reason);
+
+#endif // TYGER_PURITY_H_
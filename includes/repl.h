@@ -1,8 +1,9 @@
 #ifndef TYGER_REPL_H_
 #define TYGER_REPL_H_
+#include "runner.h"
 
 #define REPL_INPUT_BUFFER_SIZE 2048
 
-void repl_run(void);
+void repl_run(Runner_Options options);
 
 #endif // TYGER_REPL_H_
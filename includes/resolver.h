@@ -0,0 +1,105 @@
+#ifndef TYGER_RESOLVER_H_
+#define TYGER_RESOLVER_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parser.h"
+
+typedef struct resolver_local
+{
+  const char *name;
+  size_t scope_depth;
+  size_t function_depth;
+  size_t slot;
+  Ident_Handle declaration;
+  bool is_const;
+  bool captured;
+} Resolver_Local;
+
+typedef struct resolver_local_vaarray
+{
+  Resolver_Local *elems;
+  size_t capacity;
+  size_t len;
+} Resolver_Local_VaArray;
+
+/// the upvalues of a function literal being resolved, which may still grow when a
+/// function nested within it captures a variable from further out
+typedef struct resolver_function
+{
+  Func_Upvalue_VaArray upvalues;
+} Resolver_Function;
+
+typedef struct resolver_function_vaarray
+{
+  Resolver_Function *elems;
+  size_t capacity;
+  size_t len;
+} Resolver_Function_VaArray;
+
+typedef struct resolver_global
+{
+  char *name;
+  uint32_t hash;
+  Ident_Handle declaration;
+  bool is_const;
+} Resolver_Global;
+
+typedef struct resolver_global_vaarray
+{
+  Resolver_Global *elems;
+  size_t capacity;
+  size_t len;
+} Resolver_Global_VaArray;
+
+/// Binds every `EXPR_IDENT` in a program to the `STMT_VAR` which declared it and
+/// rewrites it into a global index or a frame slot, so nothing needs to look a
+/// variable up by name at runtime.
+///
+/// NOTE(HS): globals are kept between calls to `resolver_resolve_program` so that
+/// successive programs (e.g. REPL lines) can refer to each other's globals.
+///
+/// Local slots are relative to the function they're declared in, parameters taking
+/// slots `0..arity`; `function_base` is the index in `locals` of its first slot.
+///
+/// A local used from a nested function is captured as an upvalue of every function
+/// between the two, `functions[d - 1]` holding those of the function at depth `d`, so
+/// a closure only keeps the variables it (or a function within it) uses alive.
+///
+/// `global_index` is an open addressing table of `globals` by name, each entry a slot
+/// + 1 (0 when empty), so a program's globals are found in constant time however many
+/// there are.
+typedef struct resolver
+{
+  Resolver_Global_VaArray globals;
+  size_t *global_index;
+  size_t global_index_capacity;
+  Resolver_Local_VaArray locals;
+  Resolver_Function_VaArray functions;
+  size_t scope_depth;
+  size_t function_depth;
+  size_t function_base;
+
+  /// globals from this slot on are out of scope, see `resolver_resolve_function`
+  size_t visible_globals;
+} Resolver;
+
+void resolver_init(Resolver *r);
+void resolver_free(Resolver *r);
+
+/// resolves all identifiers in `prog`, any errors are appended to `prog->errors`
+void resolver_resolve_program(Resolver *r, Program *prog);
+
+/// resolves `prog`, the literal of a function whose body was only pre-parsed (see
+/// `parser_parse_function`), as it would have been where it's written: only the first
+/// `visible_globals` globals are in scope, those declared since are not
+void resolver_resolve_function(Resolver *r, Program *prog, size_t visible_globals);
+
+/// declares a global the embedder provides (see `tyger.h`), which programs resolved
+/// from then on may use and assign without declaring, returning its slot
+size_t resolver_declare_host_global(Resolver *r, const char *name);
+
+size_t resolver_global_count(const Resolver *r);
+const char *resolver_global_name(const Resolver *r, size_t slot);
+
+#endif // TYGER_RESOLVER_H_
@@ -0,0 +1,117 @@
+#ifndef TYGER_RUNNER_H_
+#define TYGER_RUNNER_H_
+#include <stdbool.h>
+#include "call_profile.h"
+#include "exec_counters.h"
+#include "resolver.h"
+#include "sample_profile.h"
+#include "tmemory.h"
+#include "vm.h"
+
+typedef struct runner_options
+{
+  bool dump_ast;
+  bool dump_bytecode;
+
+  /// only pre-parse the bodies of top level function literals, each is parsed and
+  /// compiled when it's first called, see `Parser.lazy_functions`
+  bool lazy_functions;
+
+  /// compile through the SSA IR and its optimisations, `dump_ir` lists the IR
+  bool optimise;
+  bool dump_ir;
+  bool no_quicken;
+  bool no_superinstructions;
+  bool no_jit;
+
+  /// when set, adjacent instruction counts are appended to this file after each run
+  /// and superinstructions are disabled, see `scripts/superinstruction_gen.py`
+  const char *profile_opcodes_path;
+
+  /// when set, the call sites which only called one function are appended to this file
+  /// after each run, and calls at the sites in `inline_profile_path` are inlined by
+  /// `optimise`, see `call_profile.h`
+  const char *profile_calls_path;
+  const char *inline_profile_path;
+
+  /// when set, the call stack is sampled `sample_hz` times a second of CPU time and the
+  /// stacks seen are appended to this file in folded form after each run, see
+  /// `sample_profile.h`
+  const char *profile_samples_path;
+  uint32_t sample_hz;
+
+  /// when set, the counts of what each run executed are appended to these files, as a
+  /// report and as a line of JSON. Only in builds with `EXEC_COUNTERS_ENABLED`, see
+  /// `exec_counters.h`.
+  const char *counters_path;
+  const char *counters_json_path;
+
+  /// when set, the time spent in each phase (parsing, compiling, running, collecting)
+  /// is recorded and written to this file by `runner_free`, as a Chrome `trace_event`
+  /// JSON object, see `phase_trace.h`
+  const char *trace_phases_path;
+
+  /// when set, the hits, misses and evictions of every `@memo` function's cache are
+  /// written to `stderr` by `runner_free`
+  bool profile_memo;
+
+  /// when set, the memory each subsystem allocated (see `tmemory.h`) is written to
+  /// `stderr` by `runner_free`, once it has freed everything it can
+  bool memory_stats;
+
+  /// most results cached per `@memo` function
+  size_t memo_capacity;
+
+  /// size of the output buffer in bytes (0 for unbuffered) and when it is flushed
+  size_t output_capacity;
+  Output_Flush output_flush;
+
+  Gc_Options gc;
+
+  /// when set, everything the runner allocates comes from this, it's made the calling
+  /// thread's allocator for the duration of each `runner_*` call (see `tmemory.h`)
+  const Tyger_Allocator *allocator;
+} Runner_Options;
+
+Runner_Options runner_default_options(void);
+
+typedef struct source_vaarray
+{
+  char **elems;
+  size_t capacity;
+  size_t len;
+} Source_VaArray;
+
+/// Drives a source string through the whole pipeline (parse, resolve, compile, run),
+/// keeping state between runs so successive sources (e.g. REPL lines) share globals
+///
+/// NOTE(HS): every chunk which ran is kept until `runner_free`, as globals may still
+/// refer to the strings and functions it owns. So is a copy of every source, which
+/// their positions are in (and with `lazy_functions`, they're compiled from).
+typedef struct runner
+{
+  Resolver resolver;
+  VM vm;
+  Chunk_VaArray chunks;
+  Source_VaArray sources;
+  Call_Profile inline_profile;
+  Sample_Profile sampler;
+  Exec_Counters counters;
+  Runner_Options options;
+  const char *source_name;
+} Runner;
+
+void runner_init(Runner *r, const char *source_name, Runner_Options options);
+void runner_free(Runner *r);
+
+/// runs `source`, reporting any errors on `stderr`, returns whether it succeeded
+bool runner_run_source(Runner *r, const char *source);
+
+/// runs the script at `path`, returning a process exit code
+int runner_run_file(const char *path, Runner_Options options);
+
+/// reads the whole file at `path` into a null terminated buffer, which must be
+/// freed by the caller, returns NULL on failure
+char *read_entire_file(const char *path);
+
+#endif // TYGER_RUNNER_H_
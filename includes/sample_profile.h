@@ -0,0 +1,99 @@
+#ifndef TYGER_SAMPLE_PROFILE_H_
+#define TYGER_SAMPLE_PROFILE_H_
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "chunk.h"
+
+/// set when samples can be taken on this target, they're driven by `SIGPROF` which
+/// needs `setitimer`
+#if defined(__linux__)
+#define SAMPLE_PROFILE_SUPPORTED 1
+#else
+#define SAMPLE_PROFILE_SUPPORTED 0
+#endif
+
+/// default samples per second of CPU time
+#define SAMPLE_PROFILE_DEFAULT_HZ 1000
+
+/// most frames kept per sample, deeper stacks lose their outermost frames
+#define SAMPLE_PROFILE_MAX_DEPTH 128
+
+/// a frame of a sampled stack, the function running in it (NULL for the script) and
+/// the source position of the instruction it was at
+typedef struct sample_frame
+{
+  const Obj_Function *function;
+  size_t pos;
+} Sample_Frame;
+
+typedef struct sample_frame_vaarray
+{
+  Sample_Frame *elems;
+  size_t capacity;
+  size_t len;
+} Sample_Frame_VaArray;
+
+/// a distinct stack, `frames[first..first + len]` outermost first, and how many
+/// samples found it
+typedef struct sample_stack
+{
+  size_t first;
+  size_t len;
+  uint32_t hash;
+  uint64_t count;
+} Sample_Stack;
+
+typedef struct sample_stack_vaarray
+{
+  Sample_Stack *elems;
+  size_t capacity;
+  size_t len;
+} Sample_Stack_VaArray;
+
+/// Samples the call stack of the running script every `1 / hz` seconds of CPU time,
+/// counting how often each distinct stack was seen.
+///
+/// NOTE(HS): the `SIGPROF` handler only sets `pending`, the VM takes the sample when
+/// it dispatches its next instruction so nothing is read whilst it's inconsistent.
+/// Machine code from the JIT doesn't check, time spent in it is put down to wherever
+/// the interpreter next is (usually the instruction after the loop or call).
+typedef struct sample_profile
+{
+  volatile sig_atomic_t pending;
+  uint32_t hz;
+  uint64_t samples;
+
+  Sample_Frame_VaArray frames;
+  Sample_Stack_VaArray stacks;
+
+  /// open addressed index into `stacks`, each slot holding its index + 1 (0 is empty)
+  size_t *index;
+  size_t index_capacity;
+} Sample_Profile;
+
+void sample_profile_init(Sample_Profile *profile, uint32_t hz);
+void sample_profile_free(Sample_Profile *profile);
+
+/// starts the timer, returns false when it can't be (e.g. another profile is already
+/// running, as there is only one `SIGPROF`)
+bool sample_profile_start(Sample_Profile *profile);
+
+/// stops the timer and restores the previous `SIGPROF` handler
+void sample_profile_stop(Sample_Profile *profile);
+
+/// counts one sample of the stack `frames[0..len]`, outermost first
+void sample_profile_record(Sample_Profile *profile, const Sample_Frame *frames, size_t len);
+
+/// forgets every sample taken
+void sample_profile_clear(Sample_Profile *profile);
+
+/// writes one `<script>:<line>;<function>:<line>... <count>` line per distinct stack
+/// of lines, sorted, the folded format read by flame graph tools. Lines are counted
+/// from 1 in the source each function was compiled from (see `Chunk.source`), or
+/// `source` for the script and functions whose source isn't known.
+void sample_profile_write(const Sample_Profile *profile, const char *source, FILE *f);
+
+#endif // TYGER_SAMPLE_PROFILE_H_
@@ -0,0 +1,30 @@
+#ifndef TYGER_SUPERINSTRUCTION_H_
+#define TYGER_SUPERINSTRUCTION_H_
+#include <stddef.h>
+#include "chunk.h"
+
+#define SUPERINSTRUCTION_MAX_COMPONENTS 4
+
+/// a fused sequence of base instructions, dispatched once for the whole sequence
+///
+/// NOTE(HS): fusing only rewrites the opcode byte of the first component, every other
+/// byte of the sequence is left in place. Jump distances and source positions are
+/// unaffected, and a runtime error in any component still reports that component.
+typedef struct superinstruction
+{
+  Opcode op;
+  size_t len;
+  Opcode components[SUPERINSTRUCTION_MAX_COMPONENTS];
+} Superinstruction;
+
+/// returns the superinstruction table, in the order they are tried when fusing
+const Superinstruction *superinstruction_table(size_t *count);
+
+/// returns the description of superinstruction `op`, or NULL for a base instruction
+const Superinstruction *superinstruction_lookup(Opcode op);
+
+/// rewrites runs of base instructions in `chunk` into superinstructions, a run is
+/// never fused across a jump target
+void superinstructions_fuse(Chunk *chunk);
+
+#endif // TYGER_SUPERINSTRUCTION_H_
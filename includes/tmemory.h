@@ -0,0 +1,102 @@
+#ifndef TYGER_TMEMORY_H_
+#define TYGER_TMEMORY_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum tyger_memory_subsystem
+{
+#define X(NAME, DESCRIPTION) MEMORY_##NAME,
+  #include "defs/memory-subsystem.def"
+#undef X
+  MEMORY_SUBSYSTEM_COUNT,
+} Tyger_Memory_Subsystem;
+
+/// the subsystem allocations made by the including file are accounted to, files set
+/// it before including anything
+///
+/// NOTE(HS): `va_array_*` and `string_builder_init` are macros so their allocations
+/// count against the file using them, rather than util.h or tstrings.c
+#ifndef TYGER_MEMORY_SUBSYSTEM
+#define TYGER_MEMORY_SUBSYSTEM MEMORY_OTHER
+#endif
+
+typedef struct tyger_memory_usage
+{
+  /// bytes allocated and not yet freed, and the most there have been at once
+  ///
+  /// NOTE(HS): the peak is the sum of each thread's, so exact for allocations made on
+  /// one thread, and otherwise at least the real one
+  uint64_t current_bytes;
+  uint64_t peak_bytes;
+
+  uint64_t allocations;
+  uint64_t reallocations;
+  uint64_t frees;
+} Tyger_Memory_Usage;
+
+typedef struct tyger_memory_stats
+{
+  Tyger_Memory_Usage total;
+  Tyger_Memory_Usage subsystems[MEMORY_SUBSYSTEM_COUNT];
+} Tyger_Memory_Stats;
+
+/// Where memory comes from, every allocation the library makes goes through one.
+/// `realloc` is given the block's old size and `free` its size, so allocators which
+/// keep no sizes (size classes, arenas, fixed pools) need no header of their own.
+/// `realloc` and `alloc` return NULL when out of memory.
+///
+/// NOTE(HS): an allocator is referred to, not copied, so must outlive every block it
+/// allocates, and be safe to call from every thread using it
+typedef struct tyger_allocator
+{
+  void *(*alloc)(void *user, size_t size);
+  void *(*realloc)(void *user, void *ptr, size_t old_size, size_t new_size);
+  void (*free)(void *user, void *ptr, size_t size);
+  void *user;
+} Tyger_Allocator;
+
+/// `malloc`, `realloc` and `free`, what every thread uses until told otherwise
+const Tyger_Allocator *tyger_default_allocator(void);
+
+/// Sets the allocator the calling thread's allocations come from (NULL for the
+/// default), returning the one it replaces so it can be restored.
+///
+/// NOTE(HS): each thread has its own, so interpreters on different threads can use
+/// different allocators. A block remembers its allocator and is always resized and
+/// freed through it, whichever the thread is using at the time.
+const Tyger_Allocator *tyger_allocator_use(const Tyger_Allocator *allocator);
+const Tyger_Allocator *tyger_allocator_current(void);
+
+/// Accounted replacements for `malloc`, `calloc`, `realloc` and `free`, every
+/// allocation the library makes goes through them. A block stays accounted to the
+/// subsystem which first allocated it, however it's resized and whoever frees it.
+///
+/// NOTE(HS): sizes and owners are kept in a header in front of each block, so blocks must only be
+/// resized and freed through these (or the `t*` macros below), and never passed to
+/// `free`. They return NULL when out of memory, as the functions they replace do.
+/// Blocks come from the calling thread's allocator, see `tyger_allocator_use`.
+void *tyger_malloc(Tyger_Memory_Subsystem subsystem, size_t size);
+void *tyger_calloc(Tyger_Memory_Subsystem subsystem, size_t count, size_t size);
+
+/// `ptr` may be NULL, in which case the block is accounted to `subsystem`
+void *tyger_realloc(Tyger_Memory_Subsystem subsystem, void *ptr, size_t size);
+void tyger_free(void *ptr);
+
+#define tmalloc(SIZE) tyger_malloc(TYGER_MEMORY_SUBSYSTEM, (SIZE))
+#define tcalloc(COUNT, SIZE) tyger_calloc(TYGER_MEMORY_SUBSYSTEM, (COUNT), (SIZE))
+#define trealloc(PTR, SIZE) tyger_realloc(TYGER_MEMORY_SUBSYSTEM, (PTR), (SIZE))
+#define tfree(PTR) tyger_free(PTR)
+
+/// the usage of every subsystem in the process so far
+///
+/// NOTE(HS): each thread counts its own allocations without synchronising, which this
+/// sums, so stats taken while other threads allocate may be mid update
+Tyger_Memory_Stats tyger_memory_stats_collect(void);
+
+const char *tyger_memory_subsystem_to_string(Tyger_Memory_Subsystem subsystem);
+
+/// writes one line of usage per subsystem which has allocated, and the total
+void tyger_memory_stats_write(const Tyger_Memory_Stats *stats, FILE *f);
+
+#endif // TYGER_TMEMORY_H_
@@ -1,13 +1,18 @@
 #ifndef TYGER_TRACE_H_
 #define TYGER_TRACE_H_
 #include "parser.h"
+#include "chunk.h"
 
 typedef enum trace_format
 {
   TRACE_YAML,
   TRACE_SEXPR,
+
+  /// the optimised IR of the script and each function literal, see `ir.h`
+  TRACE_IR,
 } Trace_Format;
 
 const char *program_to_string(const Program *p, Trace_Format format);
+const char *chunk_to_string(const Chunk *chunk);
 
 #endif // TYGER_TRACE_H_
@@ -2,6 +2,7 @@
 #define TYGER_TSTRINGS_H_
 #include <stdbool.h>
 #include <stddef.h>
+#include "tmemory.h"
 
 typedef struct string_view
 {
@@ -14,6 +15,9 @@ typedef struct string_builder
   char *buffer;
   size_t capacity;
   size_t len;
+
+  /// the subsystem the buffer, and strings made from it, are accounted to
+  Tyger_Memory_Subsystem subsystem;
 } String_Builder;
 
 #if defined(__cplusplus)
@@ -31,9 +35,12 @@ bool string_view_eq(String_View sv1, String_View sv2);
 bool string_view_eq_str(String_View sv, const char *str);
 void string_view_format_buffer(char *buffer, size_t buffer_len, String_View sv);
 
-void string_builder_init(String_Builder *sb);
+void string_builder_init_in(String_Builder *sb, Tyger_Memory_Subsystem subsystem);
+#define string_builder_init(SB) string_builder_init_in((SB), TYGER_MEMORY_SUBSYSTEM)
+
 void string_builder_append(String_Builder *sb, const char *str);
 void string_builder_append_fmt(String_Builder *sb, const char *fmt, ...);
 const char *string_builder_to_cstring(const String_Builder *sb);
+void string_builder_free(String_Builder *sb);
 
 #endif // TYGER_TSTRINGS_H_
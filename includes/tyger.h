@@ -0,0 +1,164 @@
+#ifndef TYGER_TYGER_H_
+#define TYGER_TYGER_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "builtin.h"
+#include "chunk.h"
+#include "gc.h"
+#include "output.h"
+#include "tmemory.h"
+#include "value.h"
+#include "vm.h"
+
+/// NOTE(HS): the API for embedding the interpreter. Source is compiled once into a
+/// `Tyger_Program`, which any number of instances (`Tyger_VM`s) then run, each with
+/// the globals and functions its host provides. Nothing here is shared between
+/// instances but programs, which are never changed once compiled, so instances can run
+/// on as many threads at once as there are instances.
+
+typedef struct tyger_compile_options
+{
+  /// names of the globals (values and functions) the host provides when the program is
+  /// run, which it may then use and assign without declaring them
+  const char *const *host_globals;
+  size_t host_globals_len;
+
+  /// compile functions through the SSA IR, see `Compiler_Options.optimise`
+  bool optimise;
+} Tyger_Compile_Options;
+
+Tyger_Compile_Options tyger_compile_default_options(void);
+
+/// A script compiled to bytecode, along with the names of its globals.
+///
+/// NOTE(HS): a program is immutable once compiled and may be run by any number of
+/// instances at once, on any threads. Instances quicken, cache and compile to machine
+/// code from their own copy of `chunk` (see `chunk_copy`), made the first time each
+/// runs the program. Values a program's run leaves behind may refer to its constants,
+/// so it has to outlive every instance which has run it, or be forgotten by each
+/// first (see `tyger_vm_forget_program`).
+typedef struct tyger_program
+{
+  /// unique to each compilation, so a program compiled where a freed one was isn't
+  /// mistaken for it by instances which ran the old one
+  uint64_t id;
+  char *source;
+  Chunk chunk;
+
+  /// the name of each global slot, the first `host_globals_len` are the host's
+  char **global_names;
+  size_t global_count;
+  size_t host_globals_len;
+} Tyger_Program;
+
+/// Compiles `source` into `program`, returning the first error in it (located by
+/// line and column), in which case `program` is left empty. The error's message
+/// belongs to the caller, see `tyger_error_free`.
+Tyger_Error tyger_program_compile(Tyger_Program *program, const char *source, Tyger_Compile_Options options);
+void tyger_program_free(Tyger_Program *program);
+
+typedef struct tyger_vm_options
+{
+  /// where the output builtins write, see `vm_set_output`
+  int output_fd;
+  size_t output_capacity;
+  Output_Flush output_flush;
+
+  bool no_quicken;
+  bool no_jit;
+  size_t memo_capacity;
+  Gc_Options gc;
+
+  /// when set, everything the instance allocates comes from this, it's made the
+  /// calling thread's allocator for the duration of each `tyger_vm_*` call
+  const Tyger_Allocator *allocator;
+} Tyger_VM_Options;
+
+Tyger_VM_Options tyger_vm_default_options(void);
+
+/// a global the host provides to a run, see `tyger_vm_run`
+typedef struct tyger_global
+{
+  const char *name;
+  Value value;
+} Tyger_Global;
+
+/// a function registered with `tyger_vm_register`
+typedef struct tyger_vm_host
+{
+  char *name;
+  Obj_Function *function;
+} Tyger_VM_Host;
+
+typedef struct tyger_vm_host_vaarray
+{
+  Tyger_VM_Host *elems;
+  size_t capacity;
+  size_t len;
+} Tyger_VM_Host_VaArray;
+
+/// an instance's copy of a program it has run
+typedef struct tyger_vm_chunk
+{
+  uint64_t program_id;
+  Chunk chunk;
+} Tyger_VM_Chunk;
+
+typedef struct tyger_vm_chunk_vaarray
+{
+  Tyger_VM_Chunk *elems;
+  size_t capacity;
+  size_t len;
+} Tyger_VM_Chunk_VaArray;
+
+/// One interpreter, with its own heap, globals and output.
+///
+/// NOTE(HS): an instance may only be used by one thread at a time, but different
+/// instances share nothing so can run at the same time. Values belong to the instance
+/// which made them, and only live as long as its globals (or stack) refer to them.
+typedef struct tyger_vm
+{
+  VM vm;
+  Tyger_VM_Options options;
+  Tyger_VM_Host_VaArray hosts;
+  Tyger_VM_Chunk_VaArray chunks;
+
+  /// owns the functions in `hosts`
+  Obj *objects;
+
+  /// the program run last, whose globals `tyger_vm_get_global` reads
+  const Tyger_Program *program;
+} Tyger_VM;
+
+Tyger_VM *tyger_vm_create(Tyger_VM_Options options);
+void tyger_vm_destroy(Tyger_VM *vm);
+
+/// Registers `fn` as the function `name`, taking `arity` arguments, which programs
+/// compiled with `name` as a host global can call. Registering a name again replaces
+/// the function from the next run.
+void tyger_vm_register(Tyger_VM *vm, const char *name, size_t arity, Tyger_Host_Fn fn, void *user);
+
+/// Runs `program` to completion, returning any runtime error (located by line and
+/// column). Every run starts with fresh globals, those the program was compiled to
+/// expect from the host are taken from `globals` by name, or failing that from the
+/// registered functions.
+Tyger_Error tyger_vm_run(Tyger_VM *vm, const Tyger_Program *program, const Tyger_Global *globals, size_t globals_len);
+
+/// Frees the instance's copy of `program`, which it keeps from the first run of it
+/// until it's destroyed. Once every instance which ran a program has forgotten it (or
+/// been destroyed) the program can be freed. Forgetting the program run last also
+/// forgets the globals it left.
+void tyger_vm_forget_program(Tyger_VM *vm, const Tyger_Program *program);
+
+/// the value the global `name` was left with by the last run, false when it had none
+bool tyger_vm_get_global(const Tyger_VM *vm, const char *name, Value *value);
+
+/// makes a string in the instance's heap, e.g. to pass as a global or return from a
+/// host function
+Value tyger_vm_string(Tyger_VM *vm, const char *chars, size_t len);
+
+/// an error for a host function to return, `message` is copied
+Tyger_Error tyger_host_error(Tyger_Error_Kind kind, const char *message);
+
+#endif // TYGER_TYGER_H_
@@ -0,0 +1,42 @@
+#ifndef TYGER_TYGER_ERROR_H_
+#define TYGER_TYGER_ERROR_H_
+#include <stddef.h>
+
+/// NOTE(HS): errors, and where in the source they happened, shared by the compiler and
+/// the runtime programs built with `tyger build` link
+
+typedef struct location
+{
+  size_t pos;
+  size_t col;
+  size_t line;
+} Location;
+
+typedef enum tyger_error_kind
+{
+#define X(NAME) TYERR_##NAME,
+  #include "defs/tyger-error-kind.def"
+#undef X
+} Tyger_Error_Kind;
+
+/// NOTE(HS): `message` is optional, when set it is owned by the error and freed as part
+/// of `program_free`
+typedef struct tyger_error
+{
+  Tyger_Error_Kind kind;
+  Location location;
+  const char *message;
+
+  /// the source `location` is in when it may not be the one being compiled or run,
+  /// e.g. a runtime error in a function from an earlier REPL line (see `Chunk.source`),
+  /// NULL otherwise. It isn't owned by the error.
+  const char *source;
+} Tyger_Error;
+
+void tyger_error_free(Tyger_Error *err);
+const char *tyger_error_kind_to_string(Tyger_Error_Kind kind);
+
+/// computes the (0 based) line and column of `pos` within `program`
+Location location_from_pos(const char *program, size_t pos);
+
+#endif // TYGER_TYGER_ERROR_H_
@@ -10,7 +10,30 @@ extern "C" {
   #include "repl.h"
   #include "tstrings.h"
   #include "parser.h"
+  #include "resolver.h"
   #include "trace.h"
+  #include "value.h"
+  #include "chunk.h"
+  #include "compiler.h"
+  #include "vm.h"
+  #include "runner.h"
+  #include "superinstruction.h"
+  #include "opcode_profile.h"
+  #include "call_profile.h"
+  #include "sample_profile.h"
+  #include "exec_counters.h"
+  #include "phase_trace.h"
+  #include "tmemory.h"
+  #include "builtin.h"
+  #include "output.h"
+  #include "gc.h"
+  #include "bigint.h"
+  #include "purity.h"
+  #include "memo.h"
+  #include "jit.h"
+  #include "aot.h"
+  #include "ir.h"
+  #include "tyger.h"
 }
 
 #endif // TYGER_TEST_HPP_
@@ -3,18 +3,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include "tmemory.h"
+
+/// returns the capacity (in elements) required to fit N more elements, doubling
+/// the current capacity until the array is large enough
+#define va_array_grow_capacity(DA, N) \
+  va_array_capacity_for((DA).capacity, (DA).len + (N))
+
+static inline size_t va_array_capacity_for(size_t capacity, size_t required)
+{
+  size_t new_capacity = capacity > 0 ? capacity : 32;
+  while (new_capacity < required)
+  {
+    new_capacity *= 2;
+  }
+  return new_capacity;
+}
 
 #define va_array_init(T, DA)                        \
   do {                                              \
     (DA).capacity = 32;                             \
     (DA).len = 0;                                   \
-    (DA).elems = malloc(sizeof(T) * (DA).capacity); \
+    (DA).elems = tmalloc(sizeof(T) * (DA).capacity); \
   } while (0)
 
 #define va_array_free(DA)                       \
   do {                                          \
     if ((DA).elems) {                           \
-      free((DA).elems);                         \
+      tfree((DA).elems);                        \
     }                                           \
     (DA).elems = NULL;                          \
     (DA).len = 0;                               \
@@ -25,8 +41,10 @@
 #define va_array_append(DA, ELEM)                               \
   do {                                                          \
     if ( (DA).len + 1 > (DA).capacity ) {                       \
-      size_t new_capacity = (DA).capacity * 2;                  \
-      void *new_buffer = realloc((DA).elems, new_capacity);     \
+      size_t new_capacity = va_array_grow_capacity((DA), 1);    \
+      void *new_buffer = trealloc(                               \
+        (DA).elems, new_capacity * sizeof((DA).elems[0])        \
+      );                                                        \
       if (new_buffer != (DA).elems) {                           \
         (DA).elems = new_buffer;                                \
       }                                                         \
@@ -40,8 +58,10 @@
 #define va_array_append_n(DA, ELEMS, N)                               \
   do {                                                                \
     if ( ((DA).len + (N)) > (DA).capacity ) {                         \
-      size_t new_capacity = (DA).capacity * 2;                        \
-      void *new_buffer = realloc((DA).elems, new_capacity);           \
+      size_t new_capacity = va_array_grow_capacity((DA), (N));        \
+      void *new_buffer = trealloc(                                     \
+        (DA).elems, new_capacity * sizeof((DA).elems[0])              \
+      );                                                              \
       if (new_buffer != (DA).elems) {                                 \
         (DA).elems = new_buffer;                                      \
       }                                                               \
@@ -0,0 +1,237 @@
+#ifndef TYGER_VALUE_H_
+#define TYGER_VALUE_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "output.h"
+#include "tstrings.h"
+
+typedef enum value_kind
+{
+#define X(NAME) VAL_##NAME,
+  #include "defs/value-kind.def"
+#undef X
+} Value_Kind;
+
+typedef enum object_kind
+{
+#define X(NAME) OBJ_##NAME,
+  #include "defs/object-kind.def"
+#undef X
+} Object_Kind;
+
+/// tri-color marking state of an object, see `gc.h`
+///
+/// NOTE(HS): objects owned by a chunk are freed with it and never collected, they
+/// stay `OBJ_UNMANAGED`
+typedef enum obj_color
+{
+  OBJ_UNMANAGED,
+  OBJ_WHITE_0,
+  OBJ_WHITE_1,
+  OBJ_GRAY,
+  OBJ_BLACK,
+} Obj_Color;
+
+/// Header shared by every heap allocated runtime object, `next` links all objects
+/// owned by the same VM (or chunk, for constants) so they can be freed together
+typedef struct obj
+{
+  Object_Kind kind;
+  uint8_t color;
+  struct obj *next;
+} Obj;
+
+/// NOTE(HS): `chars` points into the same allocation as the header, directly after
+/// it, and is always null terminated. Strings of at most `VALUE_SHORT_STRING_MAX`
+/// bytes are never objects, they are stored in the value itself.
+typedef struct obj_string
+{
+  Obj obj;
+  size_t len;
+  uint32_t hash;
+
+  /// set when the string is the one copy of its contents in the collector's intern
+  /// table, two interned strings are equal only when they are the same object
+  bool interned;
+  char *chars;
+} Obj_String;
+
+/// strings of at most this many bytes are stored inline, see `VAL_SHORT_STR`
+#define VALUE_SHORT_STRING_MAX 8
+
+typedef union uvalue
+{
+  bool boolean;
+  int64_t integer;
+  Obj *obj;
+  char chars[VALUE_SHORT_STRING_MAX];
+} uValue;
+
+/// NOTE(HS): `short_len` sits in what would otherwise be padding after `kind`, so
+/// short strings don't make values any bigger
+typedef struct value
+{
+  Value_Kind kind;
+  uint8_t short_len;
+  uValue as;
+} Value;
+
+/// A long string made by `+`, which only refers to its two halves (each either form
+/// of string, or another rope) until its bytes are needed. They are then copied once
+/// into `flat` and the halves let go.
+typedef struct obj_rope
+{
+  Obj obj;
+  size_t len;
+  Value left;
+  Value right;
+  char *flat;
+
+  /// set once the collector has added `flat` to the heap size
+  bool flat_counted;
+} Obj_Rope;
+
+/// A variable captured by a closure. While the variable is in scope it lives in its
+/// stack slot and `location` points there (the upvalue is open), when it goes out of
+/// scope its value is moved into `closed` and `location` points at that instead.
+///
+/// NOTE(HS): the VM keeps the open upvalues in a list through `next_open`, ordered
+/// from the top of the stack down, so every closure capturing the same variable
+/// shares one upvalue
+typedef struct obj_upvalue
+{
+  Obj obj;
+  Value *location;
+  Value closed;
+  struct obj_upvalue *next_open;
+} Obj_Upvalue;
+
+typedef struct value_vaarray
+{
+  Value *elems;
+  size_t capacity;
+  size_t len;
+} Value_VaArray;
+
+static inline Value make_nil_value(void)
+{
+  Value v;
+  v.kind = VAL_NIL;
+  v.as.integer = 0;
+  return v;
+}
+
+static inline Value make_bool_value(bool b)
+{
+  Value v;
+  v.kind = VAL_BOOL;
+  v.as.boolean = b;
+  return v;
+}
+
+static inline Value make_int_value(int64_t i)
+{
+  Value v;
+  v.kind = VAL_INT;
+  v.as.integer = i;
+  return v;
+}
+
+static inline Value make_short_string_value(const char *chars, size_t len)
+{
+  Value v;
+  v.kind = VAL_SHORT_STR;
+  v.short_len = (uint8_t) len;
+  memset(v.as.chars, 0, sizeof(v.as.chars));
+  memcpy(v.as.chars, chars, len);
+  return v;
+}
+
+static inline Value make_obj_value(Obj *obj)
+{
+  Value v;
+  v.kind = VAL_OBJ;
+  v.as.obj = obj;
+  return v;
+}
+
+static inline bool value_is_obj_kind(Value v, Object_Kind kind)
+{
+  return v.kind == VAL_OBJ && v.as.obj->kind == kind;
+}
+
+#define value_is_short_string(V) ((V).kind == VAL_SHORT_STR)
+#define value_is_string(V) \
+  (value_is_short_string(V) || value_is_obj_kind((V), OBJ_STRING) || value_is_obj_kind((V), OBJ_ROPE))
+
+/// only valid for string objects, use `value_string_view` for any form of string
+#define value_as_string(V) ((Obj_String*) (V).as.obj)
+#define value_as_rope(V) ((Obj_Rope*) (V).as.obj)
+#define value_as_upvalue(V) ((Obj_Upvalue*) (V).as.obj)
+
+/// copies the bytes of `rope` into one exactly sized buffer, unless it already has
+const char *obj_rope_flatten(Obj_Rope *rope);
+
+/// the contents of any form of string, flattening ropes
+///
+/// NOTE(HS): a short string's view points into `*v`, it is only valid while `*v` is
+static inline String_View value_string_view(const Value *v)
+{
+  if (value_is_short_string(*v))
+  {
+    return make_string_view(v->as.chars, v->short_len);
+  }
+  if (v->as.obj->kind == OBJ_ROPE)
+  {
+    Obj_Rope *rope = value_as_rope(*v);
+    return make_string_view(obj_rope_flatten(rope), rope->len);
+  }
+  const Obj_String *str = value_as_string(*v);
+  return make_string_view(str->chars, str->len);
+}
+
+/// length of any form of string, without flattening ropes
+static inline size_t value_string_len(Value v)
+{
+  if (value_is_short_string(v))
+  {
+    return v.short_len;
+  }
+  return v.as.obj->kind == OBJ_ROPE ? value_as_rope(v)->len : value_as_string(v)->len;
+}
+
+/// NOTE(HS): follows Monkey, only `nil` and `false` are falsy
+static inline bool value_is_truthy(Value v)
+{
+  return !(v.kind == VAL_NIL || (v.kind == VAL_BOOL && !v.as.boolean));
+}
+
+const char *value_kind_to_string(Value_Kind kind);
+const char *object_kind_to_string(Object_Kind kind);
+
+/// name of the runtime type of `v`, as shown to users in error messages
+const char *value_type_name(Value v);
+
+bool value_equals(Value a, Value b);
+void value_write(Output *out, Value v);
+
+/// FNV-1a hash of `len` bytes, cached by every string object
+uint32_t string_hash(const char *chars, size_t len);
+
+/// makes a string value, short strings are stored inline and long ones in a new
+/// object linked into `objects`
+Value value_string_new(Obj **objects, const char *chars, size_t len);
+
+Obj_String *obj_string_new(Obj **objects, const char *chars, size_t len);
+Obj_String *obj_string_concat(Obj **objects, String_View lhs, String_View rhs);
+Obj_Rope *obj_rope_new(Obj **objects, Value left, Value right);
+
+/// bytes allocated for `obj`, not counting anything it refers to
+size_t obj_size(const Obj *obj);
+void obj_free(Obj *obj);
+void objects_free(Obj *objects);
+
+#endif // TYGER_VALUE_H_
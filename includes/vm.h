@@ -0,0 +1,139 @@
+#ifndef TYGER_VM_H_
+#define TYGER_VM_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "parser.h"
+#include "chunk.h"
+#include "value.h"
+#include "output.h"
+#include "gc.h"
+#include "memo.h"
+#include "builtin.h"
+
+/// values and frames the stack starts with, both double whenever a call needs more
+#define VM_STACK_INITIAL 1024
+#define VM_FRAMES_INITIAL 64
+
+/// default for `VM.max_call_depth`
+#define VM_MAX_CALL_DEPTH (1 << 20)
+
+/// NOTE(HS): `slots` is where the frame's arguments (and then locals) start, `base`
+/// is where the call's result is left on return, one below `slots` when the callee
+/// was pushed onto the stack. `ip` is only up to date when the frame isn't running.
+/// `closure` is NULL unless the function called captures variables. `memo` is the
+/// cache entry the call's result goes into, for calls to `@memo` functions.
+typedef struct call_frame
+{
+  Chunk *chunk;
+  uint8_t *ip;
+  Value *slots;
+  Value *base;
+  Obj_Closure *closure;
+  Memo_Ref memo;
+} Call_Frame;
+
+/// a function registered by the embedder, called by `CALL_HOST` (see `vm_host_function_new`)
+typedef struct vm_host
+{
+  Tyger_Host_Fn fn;
+  void *user;
+} Vm_Host;
+
+typedef struct vm_host_vaarray
+{
+  Vm_Host *elems;
+  size_t capacity;
+  size_t len;
+} Vm_Host_VaArray;
+
+/// NOTE(HS): a call's arguments are its first locals, the callee's window of the stack
+/// starts where the caller pushed them so nothing is copied. The stack moves when it
+/// grows, so anything pointing into it (frames, open upvalues and the running frame's
+/// registers) is rebased at the same time.
+typedef struct vm
+{
+  Value *stack;
+  size_t stack_capacity;
+  Call_Frame *frames;
+  size_t frame_capacity;
+  size_t frame_count;
+
+  /// most frames the stack may hold before a call fails with a stack overflow
+  size_t max_call_depth;
+
+  Value_VaArray globals;
+
+  /// owns every object created while running, chunks own their constants
+  Gc gc;
+
+  /// upvalues whose variables are still on the stack, highest slot first
+  Obj_Upvalue *open_upvalues;
+
+  /// results of every `@memo` function called, each holding at most `memo_capacity`
+  Memo_Table memo;
+  size_t memo_capacity;
+
+  /// shared by every output builtin, stdout unless changed with `vm_set_output`
+  Output out;
+
+  /// bumped whenever a global holding a function is overwritten, invalidating the
+  /// inline caches of `CALL_GLOBAL` sites
+  uint64_t globals_version;
+
+  /// when set, generic instructions rewrite themselves in place into a type
+  /// specialised form once they have seen their operand types
+  bool quicken;
+
+  /// when set, chunks are compiled to machine code once they've made
+  /// `jit_threshold` calls and loop iterations, see `jit.h`
+  bool jit;
+  uint32_t jit_threshold;
+
+  /// when set, every dispatched instruction is recorded, see `opcode_profile.h`
+  struct opcode_profile *profile;
+
+  /// when set, the call stack is sampled whenever the profile's timer has fired, see
+  /// `sample_profile.h`
+  struct sample_profile *sampler;
+
+  /// when set, instructions, calls, branches and inline cache lookups are counted,
+  /// only in builds with `EXEC_COUNTERS_ENABLED` (see `exec_counters.h`)
+  struct exec_counters *counters;
+
+  /// compiles the body of a function which was only pre-parsed (see
+  /// `Obj_Function.lazy_source`) the first time it's called, returning any error in
+  /// it. Set by whatever parsed the program, as the runtime can't compile on its own.
+  Tyger_Error (*compile_lazy)(void *context, Obj_Function *function);
+  void *compile_lazy_context;
+
+  /// the functions `CALL_HOST` calls, and the instance embedding the VM they're given
+  Vm_Host_VaArray hosts;
+  struct tyger_vm *host;
+} VM;
+
+void vm_init(VM *vm);
+void vm_free(VM *vm);
+
+/// flushes the current output and replaces it with one writing to `fd`
+void vm_set_output(VM *vm, int fd, size_t capacity, Output_Flush flush);
+
+/// Makes a function which calls `fn` with its arguments, linked into `objects` (which
+/// must outlive the VM), whose body is a single `CALL_HOST`. Being an ordinary function
+/// it is called, cached and checked for arity like any other.
+Obj_Function *vm_host_function_new(
+  VM *vm, Obj **objects, const char *name, size_t arity, Tyger_Host_Fn fn, void *user
+);
+
+/// makes `function` (from `vm_host_function_new`) call `fn` with `arity` arguments
+/// instead, in place, so values already referring to it call the new one
+///
+/// NOTE(HS): only safe between runs, as inline caches aren't reset until the next
+void vm_host_function_replace(VM *vm, Obj_Function *function, size_t arity, Tyger_Host_Fn fn, void *user);
+
+/// runs `chunk` to completion, returning any runtime error
+///
+/// NOTE(HS): `chunk` is not const, quickening rewrites instructions in place
+Tyger_Error vm_run(VM *vm, Chunk *chunk);
+
+#endif // TYGER_VM_H_
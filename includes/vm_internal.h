@@ -0,0 +1,35 @@
+#ifndef TYGER_VM_INTERNAL_H_
+#define TYGER_VM_INTERNAL_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include "vm.h"
+
+/// NOTE(HS): the parts of the interpreter programs built with `tyger build` run on as
+/// well, see `aot_runtime.h`
+
+/// grows the global table to `count` globals, new globals are `nil`
+void vm_ensure_globals(VM *vm, size_t count);
+
+/// lets the collector catch up with allocation, `sp` is the top of the live stack
+void vm_gc_step(VM *vm, const Value *sp);
+
+/// moves every variable at or above `last` off the stack and into its upvalue
+void vm_close_upvalues(VM *vm, Value *last);
+
+/// looks a call to the `@memo` function `function` up in its cache, on a miss `*ref`
+/// is the entry its result goes into (see `memo_cache_call` for `caller`)
+bool vm_memo_call(
+  VM *vm, const Obj_Function *function, const Value *args, Memo_Ref caller,
+  Value *result, Memo_Ref *ref
+);
+
+/// captures the upvalues of `function` from the running frame, whose variables start
+/// at `slots` and whose own upvalues are `enclosing`
+Obj_Closure *vm_closure_new(VM *vm, Obj_Function *function, Value *slots, Obj_Upvalue **enclosing);
+
+/// makes room for `frame_count` frames and a stack of at least `stack_len` values,
+/// `*sp` is the top of the running frame. Fails once `max_call_depth` is reached or
+/// the stack can't be allocated.
+bool vm_reserve(VM *vm, size_t frame_count, size_t stack_len, Value **sp);
+
+#endif // TYGER_VM_INTERNAL_H_
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Generates `includes/defs/builtin-hash.def` from `includes/defs/builtin.def`.
+
+Finds a seed for which the FNV-1a hash of every builtin's name lands in its own slot
+of the smallest power of two sized table that fits them all, so looking a builtin up
+is one hash and one string compare. Must hash exactly as `builtin_slot` in
+`code/builtin.c` does.
+"""
+import argparse
+import pathlib
+import re
+import sys
+from typing import Dict, List, Optional, Tuple
+
+ROOT = pathlib.Path(__file__).resolve().parent.parent
+BUILTIN_DEF = ROOT / "includes" / "defs" / "builtin.def"
+
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+MAX_SEED = 1 << 20
+
+
+def read_builtins() -> List[Tuple[str, str]]:
+    """Returns the `(ID, NAME)` of every builtin in `builtin.def`."""
+    pattern = re.compile(r"^X\((\w+),\s*(\w+),", re.MULTILINE)
+    with open(BUILTIN_DEF, "r") as f:
+        return pattern.findall(f.read())
+
+
+def builtin_hash(name: str, seed: int) -> int:
+    h = (FNV_OFFSET_BASIS ^ seed) & 0xffffffff
+    for byte in name.encode():
+        h ^= byte
+        h = (h * FNV_PRIME) & 0xffffffff
+    return h
+
+
+def builtin_slot(name: str, seed: int, size: int) -> int:
+    # NOTE(HS): the low bits of FNV-1a only depend on the low bits of the seed, the
+    # high half is folded in so every bit of the seed matters
+    h = builtin_hash(name, seed)
+    return (h ^ (h >> 16)) & (size - 1)
+
+
+def find_seed(names: List[str], size: int) -> Optional[Tuple[int, Dict[str, int]]]:
+    for seed in range(MAX_SEED):
+        slots = {name: builtin_slot(name, seed, size) for name in names}
+        if len(set(slots.values())) == len(names):
+            return seed, slots
+    return None
+
+
+def render(builtins: List[Tuple[str, str]], seed: int, size: int, slots: Dict[str, int]) -> str:
+    lines = [
+        "// NOTE(HS): generated by scripts/builtin_hash_gen.py from defs/builtin.def,",
+        "// regenerate with the `builtin_hash` build target.",
+        f"#define BUILTIN_HASH_SEED {seed}u",
+        f"#define BUILTIN_HASH_SIZE {size}",
+        "// X(SLOT, ID)",
+        "#define BUILTIN_HASH_SLOTS(X) \\",
+    ]
+    entries = sorted((slots[name], ident) for ident, name in builtins)
+    rendered = [f"  X({slot}, {ident})" for slot, ident in entries]
+    width = max(len(r) for r in rendered)
+    for i, entry in enumerate(rendered):
+        lines.append(f"{entry.ljust(width)} \\" if i < len(rendered) - 1 else entry)
+    return "\n".join(lines) + "\n"
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        prog="builtin_hash_gen",
+        description="Generates the perfect hash table of builtin functions"
+    )
+
+    parser.add_argument(
+        "-o", "--output",
+        help="Where to write the definitions, stdout if not given",
+        type=str, action="store"
+    )
+
+    args = parser.parse_args()
+
+    builtins = read_builtins()
+    if not builtins:
+        sys.exit(f"[ERROR] no builtins found in {BUILTIN_DEF}")
+    names = [name for _, name in builtins]
+
+    size = 1
+    while size < len(names):
+        size *= 2
+
+    found = None
+    while found is None:
+        found = find_seed(names, size)
+        if found is None:
+            size *= 2
+
+    seed, slots = found
+    output = render(builtins, seed, size, slots)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(output)
+    else:
+        sys.stdout.write(output)
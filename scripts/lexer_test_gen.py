@@ -44,11 +44,17 @@ class TokenKind(E.Enum):
     STRING = E.auto()
     IDENT = E.auto()
 
-    # Keywords and Builtins
-    # ===== Keywords =====
+    # Keywords
+    # NOTE(HS): builtins (e.g. `println`) are identifiers, see `defs/builtin.def`
     VAR = E.auto()
-    # ===== Builtins =====
-    PRINTLN = E.auto()
+    IF = E.auto()
+    ELSE = E.auto()
+    WHILE = E.auto()
+    TRUE = E.auto()
+    FALSE = E.auto()
+    FUNC = E.auto()
+    RETURN = E.auto()
+    CONST = E.auto()
 
     def __str__(self) -> str:
         return self.name
@@ -100,7 +106,14 @@ ARITHMETIC_OP_TO_TOKEN_KIND: Dict[str, TokenKind] = {
 
 KEYWORD_OR_BUILTIN: Dict[str, TokenKind] = {
     'var': TokenKind.VAR,
-    'println': TokenKind.PRINTLN,
+    'if': TokenKind.IF,
+    'else': TokenKind.ELSE,
+    'while': TokenKind.WHILE,
+    'true': TokenKind.TRUE,
+    'false': TokenKind.FALSE,
+    'func': TokenKind.FUNC,
+    'return': TokenKind.RETURN,
+    'const': TokenKind.CONST,
 }
 
 
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""Generates `includes/defs/superinstruction.def` from opcode profiles.
+
+Profiles are the files written by `tyger --profile-opcodes <path>`, one
+`<count> <OP> <OP>...` line per run of adjacent instructions. Either pass existing
+profiles, or a tyger binary and a corpus directory to profile every `*.ty` in it.
+"""
+import argparse
+import os
+import pathlib
+import re
+import subprocess
+import sys
+import tempfile
+from collections import Counter
+from typing import Dict, List, Tuple
+
+ROOT = pathlib.Path(__file__).resolve().parent.parent
+OPCODE_DEF = ROOT / "includes" / "defs" / "opcode.def"
+
+# NOTE(HS): a superinstruction runs its components back to back, so only the last
+# component may transfer control
+CONTROL_FLOW = {"JUMP", "JUMP_IF_FALSE", "LOOP", "CALL", "CALL_GLOBAL", "RETURN"}
+NEVER_FUSED = {"RETURN"}
+MAX_COMPONENTS = 4
+
+Sequence = Tuple[str, ...]
+
+
+def read_base_opcodes() -> List[str]:
+    """Returns the base (non-quickened) opcodes from `opcode.def`."""
+    pattern = re.compile(r"X\((\w+),\s*-?\d+,\s*-?\d+,\s*(\w+)\)")
+    opcodes = []
+    with open(OPCODE_DEF, "r") as f:
+        for name, generic in pattern.findall(f.read()):
+            if name == generic:
+                opcodes.append(name)
+    return opcodes
+
+
+def read_profile(path: pathlib.Path, counts: Counter) -> None:
+    with open(path, "r") as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) < 3:
+                continue
+            counts[tuple(fields[1:])] += int(fields[0])
+
+
+def profile_corpus(tyger: str, corpus: pathlib.Path, counts: Counter) -> None:
+    scripts = sorted(corpus.glob("*.ty"))
+    if not scripts:
+        sys.exit(f"[ERROR] no *.ty scripts found in {corpus}")
+
+    with tempfile.TemporaryDirectory() as tmp:
+        profile = pathlib.Path(tmp) / "profile.txt"
+        for script in scripts:
+            result = subprocess.run(
+                [tyger, "--profile-opcodes", str(profile), str(script)],
+                stdout=subprocess.DEVNULL,
+            )
+            if result.returncode != 0:
+                sys.exit(f"[ERROR] {script} failed while profiling")
+        read_profile(profile, counts)
+
+
+def is_fusable(seq: Sequence, base: List[str]) -> bool:
+    if len(seq) < 2 or len(seq) > MAX_COMPONENTS:
+        return False
+    if any(op not in base or op in NEVER_FUSED for op in seq):
+        return False
+    return not any(op in CONTROL_FLOW for op in seq[:-1])
+
+
+def choose(counts: Counter, base: List[str], top: int) -> List[Tuple[Sequence, int]]:
+    """Picks the `top` sequences which save the most dispatches.
+
+    Fusing a run of `n` instructions saves `n - 1` dispatches each time it runs.
+    Once a sequence is picked the count of every candidate which can share an
+    instruction with it is reduced, the compiler fuses greedily so an instruction
+    is only ever part of one superinstruction.
+    """
+    candidates: Dict[Sequence, int] = {
+        seq: count for seq, count in counts.items() if is_fusable(seq, base)
+    }
+
+    chosen = []
+    while candidates and len(chosen) < top:
+        seq, count = max(candidates.items(), key=lambda kv: (kv[1] * (len(kv[0]) - 1), kv[0]))
+        if count <= 0:
+            break
+        chosen.append((seq, count))
+        del candidates[seq]
+
+        for other in list(candidates):
+            if overlaps(seq, other):
+                candidates[other] = max(0, candidates[other] - count)
+
+    # NOTE(HS): the compiler tries superinstructions in order, longest first means a
+    # run is never fused as a pair when the triple covering it is available
+    chosen.sort(key=lambda sc: (-len(sc[0]), -sc[1]))
+    return chosen
+
+
+def overlaps(a: Sequence, b: Sequence) -> bool:
+    """Whether runs `a` and `b` can share an instruction, one containing the other or
+    the end of one being the start of the other."""
+    def contains(big: Sequence, small: Sequence) -> bool:
+        return any(big[i:i + len(small)] == small for i in range(len(big) - len(small) + 1))
+
+    def chains(first: Sequence, second: Sequence) -> bool:
+        return any(first[-k:] == second[:k] for k in range(1, min(len(first), len(second))))
+
+    return contains(a, b) or contains(b, a) or chains(a, b) or chains(b, a)
+
+
+def render(chosen: List[Tuple[Sequence, int]]) -> str:
+    lines = [
+        "// NOTE(HS): generated by scripts/superinstruction_gen.py from opcode profiles of",
+        "// scripts/corpus, regenerate with the `superinstructions` build target.",
+        "// X<N>(NAME, COMPONENTS...), tried in order when fusing",
+    ]
+    entries = []
+    for seq, count in chosen:
+        name = "__".join(seq)
+        entries.append((f"X{len(seq)}({name}, {', '.join(seq)})", count))
+
+    width = max((len(e) for e, _ in entries), default=0)
+    for i, (entry, count) in enumerate(entries):
+        if i < len(entries) - 1:
+            lines.append(f"{entry.ljust(width)} \\")
+        else:
+            lines.append(entry)
+    return "\n".join(lines) + "\n"
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        prog="superinstruction_gen",
+        description="Generates superinstruction definitions from opcode profiles"
+    )
+
+    parser.add_argument(
+        "profiles", nargs="*",
+        help="Profiles written by `tyger --profile-opcodes`",
+    )
+
+    parser.add_argument(
+        "--tyger",
+        help="tyger binary used to profile the corpus",
+        type=str, action="store"
+    )
+
+    parser.add_argument(
+        "--corpus",
+        help="Directory of *.ty scripts to profile",
+        type=pathlib.Path, default=ROOT / "scripts" / "corpus", action="store"
+    )
+
+    parser.add_argument(
+        "-n", "--top",
+        help="How many superinstructions to generate",
+        type=int, default=8, action="store"
+    )
+
+    parser.add_argument(
+        "-o", "--output",
+        help="Where to write the definitions, stdout if not given",
+        type=str, action="store"
+    )
+
+    parser.add_argument(
+        "-v", "--verbose",
+        help="Print the chosen sequences and their counts to stderr",
+        action="store_true"
+    )
+
+    args = parser.parse_args()
+
+    counts: Counter = Counter()
+    for profile in args.profiles:
+        assert os.path.exists(profile)
+        read_profile(pathlib.Path(profile), counts)
+    if args.tyger:
+        profile_corpus(args.tyger, args.corpus, counts)
+    if not counts:
+        sys.exit("[ERROR] no profiles given, pass profile files or --tyger")
+
+    chosen = choose(counts, read_base_opcodes(), args.top)
+    if args.verbose:
+        for seq, count in chosen:
+            print(f"{count:>12} {' '.join(seq)}", file=sys.stderr)
+
+    output = render(chosen)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(output)
+    else:
+        sys.stdout.write(output)
@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../tests/parser_test_helper.hpp"
+
+/// output (stdout and stderr together) and exit code of a command
+struct Command_Run
+{
+  std::string output;
+  int status;
+};
+
+static Command_Run run_command(const std::string& command)
+{
+  Command_Run run{ "", -1 };
+  FILE *pipe = popen((command + " 2>&1").c_str(), "r");
+  if (!pipe)
+  {
+    return run;
+  }
+  char buf[4096];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), pipe)) > 0)
+  {
+    run.output.append(buf, n);
+  }
+  int status = pclose(pipe);
+  run.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return run;
+}
+
+/// a directory the scripts and executables of a test are written to, removed once the
+/// test finishes
+struct Scratch_Dir
+{
+  std::string path;
+
+  Scratch_Dir()
+  {
+    char tmpl[] = "/tmp/tyger_aot_XXXXXX";
+    const char *dir = mkdtemp(tmpl);
+    path = dir ? dir : "";
+  }
+
+  ~Scratch_Dir()
+  {
+    if (!path.empty())
+    {
+      std::string command = "rm -rf '" + path + "'";
+      (void) std::system(command.c_str());
+    }
+  }
+
+  std::string write(const std::string& name, const std::string& source) const
+  {
+    std::string file = path + "/" + name;
+    std::ofstream(file) << source;
+    return file;
+  }
+};
+
+static bool have_c_compiler(void)
+{
+  const char *cc = std::getenv("CC");
+  std::string command = std::string(cc ? cc : "cc") + " --version > /dev/null";
+  return run_command(command).status == 0;
+}
+
+/// runs `path` with the interpreter and as a built executable, expecting both to
+/// behave the same
+static void expect_same_as_interpreter(const Scratch_Dir& dir, const std::string& path)
+{
+  Command_Run interpreted = run_command(std::string(TYGER_EXE) + " '" + path + "'");
+
+  std::string exe = dir.path + "/program";
+  Command_Run built = run_command(std::string(TYGER_EXE) + " build -o '" + exe + "' '" + path + "'");
+  if (built.status == 0)
+  {
+    built = run_command("'" + exe + "'");
+  }
+
+  EXPECT_EQ(built.output, interpreted.output) << path;
+  EXPECT_EQ(built.status, interpreted.status) << path;
+  std::remove(exe.c_str());
+}
+
+TEST(AotTestSuite, Test_Generate_Function_Per_Literal)
+{
+  const char *input =
+    "var add = func(a, b) { return a + b; };\n"
+    "var twice = func(f) { return func(x) { return f(f(x)); }; };\n"
+    "println(twice(func(x) { return add(x, 1); })(1));\n";
+  SETUP_PARSER_TEST_CASE(input);
+  EXPECT_PROGRAM_PARSED_SUCCESS(p);
+  Resolver resolver;
+  resolver_init(&resolver);
+  resolver_resolve_program(&resolver, (Program*) &p);
+  EXPECT_EQ(p.errors.len, 0);
+
+  String_Builder sb;
+  string_builder_init(&sb);
+  aot_generate(&p, input, "test.ty", &sb);
+  const char *generated = string_builder_to_cstring(&sb);
+  std::string c{ generated };
+  tyger_free((void*) generated);
+  string_builder_free(&sb);
+
+  // the script and four function literals
+  for (const char *name : { "tyger_function_0", "tyger_function_4" })
+  {
+    EXPECT_NE(c.find(name), std::string::npos) << name;
+  }
+  EXPECT_EQ(c.find("tyger_function_5"), std::string::npos);
+  EXPECT_NE(c.find("#include \"aot_runtime.h\""), std::string::npos);
+  EXPECT_NE(c.find("aot_main(&PROGRAM)"), std::string::npos);
+  EXPECT_NE(c.find("AOT_TAIL_CALL("), std::string::npos);
+  EXPECT_NE(c.find("AOT_CLOSURE("), std::string::npos);
+  resolver_free(&resolver);
+  program_free(&p);
+}
+
+TEST(AotTestSuite, Test_Built_Programs_Match_Interpreter)
+{
+  if (!have_c_compiler())
+  {
+    GTEST_SKIP() << "no C compiler";
+  }
+  std::vector<const char *> test_cases{
+    // recursion, closures and upvalues closed at the end of a block
+    "var fib = func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); };\n"
+    "println(fib(20));\n",
+    "var mk = func(x) { var y = x * 2; return func(z) { y = y + z; return y; }; };\n"
+    "var c = mk(5); println(c(1), c(2));\n"
+    "var i = 0; var fs = 0; while (i < 3) { var j = i; fs = func() { return j; }; i = i + 1; }\n"
+    "println(fs());\n",
+    // strings, escapes and builtins
+    "var s = \"a\\tb?\\\"\" + \"c\\\\\"; println(s, len(s), type(s)); print(\"no newline\");\n",
+    // ints overflowing into bigints, and back
+    "var big = 9223372036854775807 + 1;\n"
+    "println(big, -big, big * big / 3, big - 1, type(big - 1));\n"
+    "println(-9223372036854775807 - 1, (-9223372036854775807 - 1) / -1);\n"
+    "println(123456789012345678901234567890 / 7);\n",
+    // tail calls don't grow the stack, memoised functions
+    "var loop = func(n, acc) { if (n == 0) { return acc; } return loop(n - 1, acc + n); };\n"
+    "println(loop(1000000, 0));\n"
+    "var m = @memo func(n) { if (n < 2) { return n; } return m(n - 1) + m(n - 2); };\n"
+    "println(m(90));\n",
+    // comparisons and truthiness
+    "println(1 == 1, \"a\" != \"b\", !true, 3 > 2, 2 <= 2, !0);\n"
+    "if (0) { println(\"zero\"); } else { println(\"not zero\"); }\n",
+    // runtime errors are reported at the same place
+    "println(1);\nprintln(1 / 0);\n",
+    "var f = func(a) { return a; };\nf(1, 2);\n",
+    "var x = 1;\nx();\n",
+    "println(1 + \"a\");\n",
+    "println(\"a\" < \"b\");\n",
+    "var deep = func(n) { return 1 + deep(n + 1); };\nprintln(deep(0));\n",
+    // compile errors
+    "println(x);\n",
+    "var x = ;\n",
+  };
+
+  Scratch_Dir dir;
+  ASSERT_FALSE(dir.path.empty());
+  for (const char *input : test_cases)
+  {
+    expect_same_as_interpreter(dir, dir.write("test.ty", input));
+  }
+}
+
+TEST(AotTestSuite, Test_Built_Corpus_Matches_Interpreter)
+{
+  if (!have_c_compiler())
+  {
+    GTEST_SKIP() << "no C compiler";
+  }
+  Scratch_Dir dir;
+  ASSERT_FALSE(dir.path.empty());
+  for (const char *name : { "collatz", "counting", "fizzbuzz", "globals", "strings" })
+  {
+    expect_same_as_interpreter(dir, std::string(TYGER_SOURCE_DIR) + "/scripts/corpus/" + name + ".ty");
+  }
+}
+
+TEST(AotTestSuite, Test_Emit_C)
+{
+  if (!have_c_compiler())
+  {
+    GTEST_SKIP() << "no C compiler";
+  }
+  Scratch_Dir dir;
+  ASSERT_FALSE(dir.path.empty());
+  std::string path = dir.write("hello.ty", "println(\"hello\");\n");
+  std::string c_path = dir.path + "/hello.c";
+
+  Command_Run built = run_command(std::string(TYGER_EXE) + " build --emit-c '" + c_path + "' '" + path + "'");
+  ASSERT_EQ(built.status, 0) << built.output;
+
+  // the executable is named after the script by default, the C is kept
+  Command_Run run = run_command("'" + dir.path + "/hello'");
+  EXPECT_EQ(run.output, "hello\n");
+  EXPECT_EQ(run.status, 0);
+  std::ifstream c_file(c_path);
+  EXPECT_TRUE(c_file.good());
+}
+
+/// everything in the file at `path`
+static std::string read_file(const std::string& path)
+{
+  std::ifstream file(path);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(AotTestSuite, Test_Build_Leaves_Existing_Files_Alone)
+{
+  if (!have_c_compiler())
+  {
+    GTEST_SKIP() << "no C compiler";
+  }
+  Scratch_Dir dir;
+  ASSERT_FALSE(dir.path.empty());
+
+  // NOTE(HS): the generated C used to be written to `<output>.c` and then removed
+  const std::string precious = "int precious = 1;\n";
+  std::string c_path = dir.write("main.c", precious);
+  std::string path = dir.write("a.ty", "println(\"built\");\n");
+  Command_Run built = run_command(std::string(TYGER_EXE) + " build -o '" + dir.path + "/main' '" + path + "'");
+  ASSERT_EQ(built.status, 0) << built.output;
+  EXPECT_EQ(read_file(c_path), precious);
+  EXPECT_EQ(run_command("'" + dir.path + "/main'").output, "built\n");
+
+  // a script named like C is built next to itself, not over itself
+  std::string script = dir.write("script.c", "println(\"script\");\n");
+  built = run_command(std::string(TYGER_EXE) + " build '" + script + "'");
+  ASSERT_EQ(built.status, 0) << built.output;
+  EXPECT_EQ(read_file(script), "println(\"script\");\n");
+  EXPECT_EQ(run_command("'" + dir.path + "/script'").output, "script\n");
+
+  built = run_command(std::string(TYGER_EXE) + " build --emit-c '" + script + "' '" + script + "'");
+  EXPECT_NE(built.status, 0);
+  EXPECT_NE(built.output.find("would overwrite"), std::string::npos) << built.output;
+  EXPECT_EQ(read_file(script), "println(\"script\");\n");
+}
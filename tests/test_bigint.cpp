@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "tyger_test.hpp"
+
+/// constants stay alive for the whole test, results are collected with `gc`
+class BigintTest : public ::testing::Test
+{
+protected:
+  Gc gc;
+  Obj *constants = NULL;
+
+  void SetUp() override
+  {
+    gc_init(&gc, gc_default_options());
+  }
+
+  void TearDown() override
+  {
+    objects_free(constants);
+    gc_free(&gc);
+  }
+
+  Value parse(const std::string& digits)
+  {
+    if (digits[0] == '-')
+    {
+      return bigint_negate(&gc, bigint_from_decimal(&constants, digits.data() + 1, digits.size() - 1));
+    }
+    return bigint_from_decimal(&constants, digits.data(), digits.size());
+  }
+
+  std::string decimal(Value v)
+  {
+    if (v.kind == VAL_INT)
+    {
+      return std::to_string(v.as.integer);
+    }
+    char *digits = bigint_to_decimal(value_as_bigint(v));
+    std::string result(digits);
+    tyger_free(digits);
+    return result;
+  }
+};
+
+static std::string random_digits(std::mt19937_64& rng, size_t len)
+{
+  std::string digits(len, '0');
+  for (size_t i = 0; i < len; ++i)
+  {
+    digits[i] = (char) ('0' + rng() % 10);
+  }
+  digits[0] = (char) ('1' + rng() % 9);
+  return digits;
+}
+
+TEST_F(BigintTest, Test_Int64_Boundaries)
+{
+  Value max = make_int_value(INT64_MAX);
+  Value min = make_int_value(INT64_MIN);
+  Value one = make_int_value(1);
+
+  Value above = bigint_add(&gc, max, one);
+  EXPECT_TRUE(value_is_bigint(above));
+  EXPECT_EQ(decimal(above), "9223372036854775808");
+
+  Value below = bigint_sub(&gc, min, one);
+  EXPECT_TRUE(value_is_bigint(below));
+  EXPECT_EQ(decimal(below), "-9223372036854775809");
+
+  EXPECT_EQ(decimal(bigint_mul(&gc, max, max)), "85070591730234615847396907784232501249");
+  EXPECT_EQ(decimal(bigint_mul(&gc, min, min)), "85070591730234615865843651857942052864");
+  EXPECT_EQ(decimal(bigint_div(&gc, min, make_int_value(-1))), "9223372036854775808");
+  EXPECT_EQ(decimal(bigint_negate(&gc, min)), "9223372036854775808");
+}
+
+TEST_F(BigintTest, Test_Results_Demote_To_Int)
+{
+  Value above = bigint_add(&gc, make_int_value(INT64_MAX), make_int_value(1));
+
+  Value back = bigint_sub(&gc, above, make_int_value(1));
+  EXPECT_EQ(back.kind, VAL_INT);
+  EXPECT_EQ(back.as.integer, INT64_MAX);
+
+  Value min = bigint_negate(&gc, above);
+  EXPECT_EQ(min.kind, VAL_INT);
+  EXPECT_EQ(min.as.integer, INT64_MIN);
+
+  Value zero = bigint_sub(&gc, above, above);
+  EXPECT_EQ(zero.kind, VAL_INT);
+  EXPECT_EQ(zero.as.integer, 0);
+
+  Value literal = parse("00042");
+  EXPECT_EQ(literal.kind, VAL_INT);
+  EXPECT_EQ(literal.as.integer, 42);
+  EXPECT_EQ(constants, nullptr) << "ints aren't allocated";
+}
+
+TEST_F(BigintTest, Test_Decimal_Round_Trip)
+{
+  std::mt19937_64 rng(35);
+  for (size_t len : { 19, 20, 27, 28, 100, 1000 })
+  {
+    std::string digits = random_digits(rng, len);
+    EXPECT_EQ(decimal(parse(digits)), digits);
+    EXPECT_EQ(decimal(parse("-" + digits)), "-" + digits);
+  }
+
+  // NOTE(HS): zero chunks in the middle must keep their leading zeros
+  std::string sparse = "1" + std::string(40, '0') + "7";
+  EXPECT_EQ(decimal(parse(sparse)), sparse);
+}
+
+TEST_F(BigintTest, Test_Signs)
+{
+  Value a = parse("100000000000000000000");
+  Value b = parse("-30000000000000000000");
+
+  EXPECT_EQ(decimal(bigint_add(&gc, a, b)), "70000000000000000000");
+  EXPECT_EQ(decimal(bigint_add(&gc, b, a)), "70000000000000000000");
+  EXPECT_EQ(decimal(bigint_sub(&gc, b, a)), "-130000000000000000000");
+  EXPECT_EQ(decimal(bigint_mul(&gc, a, b)), "-3000000000000000000000000000000000000000");
+  EXPECT_EQ(decimal(bigint_mul(&gc, b, b)), "900000000000000000000000000000000000000");
+  EXPECT_EQ(decimal(bigint_div(&gc, a, b)), "-3");
+  EXPECT_EQ(decimal(bigint_div(&gc, b, make_int_value(7))), "-4285714285714285714");
+  EXPECT_EQ(decimal(bigint_div(&gc, make_int_value(5), a)), "0");
+
+  EXPECT_LT(bigint_compare(b, a), 0);
+  EXPECT_GT(bigint_compare(a, make_int_value(INT64_MAX)), 0);
+  EXPECT_LT(bigint_compare(b, make_int_value(INT64_MIN)), 0);
+  EXPECT_EQ(bigint_compare(a, parse("100000000000000000000")), 0);
+  EXPECT_TRUE(value_equals(a, parse("100000000000000000000")));
+  EXPECT_FALSE(value_equals(a, b));
+}
+
+TEST_F(BigintTest, Test_Karatsuba_Products)
+{
+  // NOTE(HS): 10^n squared is easy to check and large enough to split many times
+  std::string ten_n = "1" + std::string(2000, '0');
+  Value square = bigint_mul(&gc, parse(ten_n), parse(ten_n));
+  EXPECT_EQ(decimal(square), "1" + std::string(4000, '0'));
+
+  // NOTE(HS): balanced, lopsided and schoolbook sized operands all have to agree with
+  // division and the difference of squares
+  std::mt19937_64 rng(1);
+  for (std::pair<size_t, size_t> lens : { std::make_pair(3000, 3000), std::make_pair(5000, 400), std::make_pair(400, 5000), std::make_pair(200, 150) })
+  {
+    Value a = parse(random_digits(rng, lens.first));
+    Value b = parse(random_digits(rng, lens.second));
+    Value product = bigint_mul(&gc, a, b);
+
+    EXPECT_EQ(bigint_compare(bigint_div(&gc, product, a), b), 0);
+    EXPECT_EQ(bigint_compare(bigint_div(&gc, product, b), a), 0);
+
+    Value one = make_int_value(1);
+    Value lhs = bigint_mul(&gc, bigint_add(&gc, a, one), bigint_sub(&gc, a, one));
+    Value rhs = bigint_sub(&gc, bigint_mul(&gc, a, a), one);
+    EXPECT_EQ(bigint_compare(lhs, rhs), 0);
+  }
+}
+
+TEST_F(BigintTest, Test_Collected)
+{
+  Value kept = bigint_mul(&gc, make_int_value(INT64_MAX), make_int_value(4));
+  bigint_mul(&gc, make_int_value(INT64_MAX), make_int_value(8));
+  EXPECT_EQ(gc_get_stats(&gc).heap_objects, 2);
+
+  Gc_Roots roots = { &kept, 1, NULL, 0, NULL, NULL, NULL };
+  gc_collect(&gc, roots);
+
+  Gc_Stats stats = gc_get_stats(&gc);
+  EXPECT_EQ(stats.heap_objects, 1);
+  EXPECT_EQ(stats.objects_freed, 1);
+  EXPECT_EQ(decimal(kept), "36893488147419103228");
+}
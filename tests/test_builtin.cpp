@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "tyger_test.hpp"
+
+TEST(BuiltinTestSuite, Test_Builtin_Lookup)
+{
+  // NOTE(HS): fails when defs/builtin-hash.def is stale, regenerate it with the
+  // `builtin_hash` build target
+  for (int i = 0; i < BUILTIN_COUNT; ++i)
+  {
+    const Builtin *builtin = &BUILTINS[i];
+    Builtin_Id id;
+    ASSERT_TRUE(builtin_lookup(builtin->name, builtin->name_len, &id)) << builtin->name;
+    EXPECT_EQ(id, i) << builtin->name;
+    EXPECT_EQ(std::strlen(builtin->name), builtin->name_len) << builtin->name;
+  }
+
+  std::vector<std::string> not_builtins{
+    "", "x", "printl", "printlnx", "Println", "lens", "typ", "var",
+  };
+  for (auto& name : not_builtins)
+  {
+    Builtin_Id id;
+    EXPECT_FALSE(builtin_lookup(name.c_str(), name.size(), &id)) << name;
+  }
+}
+
+TEST(BuiltinTestSuite, Test_Builtin_Flags)
+{
+  struct Flags_Test
+  {
+    Builtin_Id id;
+    int arity;
+    bool pure;
+  };
+
+  std::vector<Flags_Test> test_cases{
+    { BUILTIN_PRINTLN, BUILTIN_VARIADIC, false },
+    { BUILTIN_PRINT, BUILTIN_VARIADIC, false },
+    { BUILTIN_LEN, 1, true },
+    { BUILTIN_TYPE, 1, true },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    const Builtin *builtin = &BUILTINS[tc.id];
+    EXPECT_EQ(builtin->arity, tc.arity) << builtin->name;
+    EXPECT_EQ(builtin->pure, tc.pure) << builtin->name;
+    EXPECT_TRUE(builtin_accepts(builtin, tc.arity == BUILTIN_VARIADIC ? 3 : tc.arity)) << builtin->name;
+  }
+  EXPECT_FALSE(builtin_accepts(&BUILTINS[BUILTIN_LEN], 2));
+}
@@ -0,0 +1,394 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../tests/vm_test_helper.hpp"
+
+/// the IR of the script after the passes in `options`
+static std::string script_ir(const char *input, Ir_Options options)
+{
+  SETUP_PARSER_TEST_CASE(input);
+  EXPECT_PROGRAM_PARSED_SUCCESS(p);
+  Resolver resolver;
+  resolver_init(&resolver);
+  resolver_resolve_program(&resolver, (Program*) &p);
+  EXPECT_EQ(p.errors.len, 0);
+
+  Ir_Function fn;
+  EXPECT_TRUE(ir_build_function(&fn, &p, NULL)) << fn.unsupported;
+  ir_optimise(&fn, options);
+  String_Builder sb;
+  string_builder_init(&sb);
+  ir_function_append(&fn, &sb);
+  const char *listing = string_builder_to_cstring(&sb);
+  std::string ir{ listing };
+  tyger_free((void*) listing);
+  string_builder_free(&sb);
+  ir_function_free(&fn);
+  resolver_free(&resolver);
+  program_free(&p);
+  return ir;
+}
+
+static Ir_Options no_passes(void)
+{
+  Ir_Options options = ir_default_options();
+  options.fold = false;
+  options.gvn = false;
+  options.licm = false;
+  options.dce = false;
+  options.inline_calls = false;
+  return options;
+}
+
+static std::size_t count_of(const std::string& haystack, const std::string& needle)
+{
+  std::size_t count = 0;
+  for (std::size_t at = haystack.find(needle); at != std::string::npos; at = haystack.find(needle, at + 1))
+  {
+    count += 1;
+  }
+  return count;
+}
+
+static void expect_same_when_optimised(const char *input)
+{
+  // NOTE(HS): errors found compiling have to be the same too
+  Tyger_Error errs[2];
+  for (int optimise = 0; optimise < 2; ++optimise)
+  {
+    Chunk chunk;
+    chunk_init(&chunk);
+    Compiler_Options options = compiler_default_options();
+    options.optimise = optimise == 1;
+    errs[optimise] = compile_source(input, &chunk, options);
+    chunk_free(&chunk);
+  }
+  bool compiled = errs[0].kind == TYERR_NONE;
+  EXPECT_EQ(errs[1].kind, errs[0].kind) << input;
+  EXPECT_EQ(errs[1].location.pos, errs[0].location.pos) << input;
+  EXPECT_STREQ(errs[1].message, errs[0].message) << input;
+  tyger_error_free(&errs[0]);
+  tyger_error_free(&errs[1]);
+  if (!compiled)
+  {
+    return;
+  }
+
+  VM_Run plain = run_source(
+    input, true, 1, true, nullptr, nullptr, MEMO_DEFAULT_CAPACITY, true, JIT_DEFAULT_THRESHOLD, false
+  );
+  VM_Run optimised = run_source(
+    input, true, 1, true, nullptr, nullptr, MEMO_DEFAULT_CAPACITY, true, JIT_DEFAULT_THRESHOLD, true
+  );
+  EXPECT_EQ(optimised.output, plain.output) << input;
+  EXPECT_EQ(optimised.err.kind, plain.err.kind) << input;
+  EXPECT_EQ(optimised.err.location.pos, plain.err.location.pos) << input;
+  EXPECT_STREQ(optimised.err.message, plain.err.message) << input;
+
+  tyger_error_free(&plain.err);
+  tyger_error_free(&optimised.err);
+  chunk_free(&plain.chunk);
+  chunk_free(&optimised.chunk);
+}
+
+TEST(IrTestSuite, Test_Locals_Become_Phis)
+{
+  const char *input =
+    "var x = true;\n"
+    "{ var a = 1; if (x) { a = 2; } println(a); }\n";
+  std::string ir = script_ir(input, no_passes());
+  EXPECT_EQ(count_of(ir, "PHI"), 1) << ir;
+  EXPECT_NE(ir.find("BRANCH"), std::string::npos) << ir;
+}
+
+TEST(IrTestSuite, Test_Fold_Constants_And_Branches)
+{
+  const char *input =
+    "{ var a = 2 * 3; var b = a + 1;\n"
+    "  if (b == 7) { println(b); } else { println(0); }\n"
+    "  var i = 0; while (false) { i = i + 1; } println(i); }\n";
+  Ir_Options options = no_passes();
+  options.fold = true;
+  std::string ir = script_ir(input, options);
+  EXPECT_NE(ir.find("CONST_INT 7"), std::string::npos) << ir;
+  for (const char *gone : { "MUL", "ADD", "EQ", "BRANCH", "PHI" })
+  {
+    EXPECT_EQ(ir.find(gone), std::string::npos) << gone << "\n" << ir;
+  }
+}
+
+TEST(IrTestSuite, Test_Global_Value_Numbering)
+{
+  const char *input =
+    "var g = 1;\n"
+    "var f = func() {};\n"
+    "f();\n"
+    "{ var a = g; var b = g; println(a - b, a - b, a == b, b == a); }\n";
+  Ir_Options options = no_passes();
+  options.gvn = true;
+  std::string ir = script_ir(input, options);
+  EXPECT_EQ(count_of(ir, "LOAD_GLOBAL"), 1) << ir;
+  EXPECT_EQ(count_of(ir, "SUB"), 1) << ir;
+  EXPECT_EQ(count_of(ir, " EQ"), 1) << ir;
+}
+
+TEST(IrTestSuite, Test_Calls_Clobber_Known_Globals)
+{
+  const char *input =
+    "var g = 1;\n"
+    "var f = func() { g = 2; };\n"
+    "println(g); f(); println(g);\n";
+  Ir_Options options = no_passes();
+  options.gvn = true;
+  std::string ir = script_ir(input, options);
+
+  // NOTE(HS): the first `println` is given the value just stored
+  EXPECT_EQ(count_of(ir, "LOAD_GLOBAL 0"), 1) << ir;
+  EXPECT_GT(ir.find("LOAD_GLOBAL 0"), ir.find("CALL_GLOBAL 1")) << ir;
+}
+
+TEST(IrTestSuite, Test_Loop_Invariant_Code_Motion)
+{
+  const char *input =
+    "var n = 0;\n"
+    "var set = func() { n = 10; };\n"
+    "set();\n"
+    "{ var i = 0; var s = 0;\n"
+    "  while (i < n * 2) { if (n == 10) { s = s + 1; } i = i + 1; }\n"
+    "  println(s); }\n";
+  Ir_Options options = ir_default_options();
+  std::string ir = script_ir(input, options);
+
+  // NOTE(HS): the global is loaded once, `n * 2` may fail but is first in the loop
+  // header so moves too, both before the loop's first block
+  std::size_t loop = ir.find("PHI");
+  ASSERT_NE(loop, std::string::npos) << ir;
+  EXPECT_EQ(count_of(ir, "LOAD_GLOBAL"), 1) << ir;
+  EXPECT_LT(ir.find("LOAD_GLOBAL"), loop) << ir;
+  EXPECT_LT(ir.find("MUL"), loop) << ir;
+  EXPECT_LT(ir.find(" EQ"), loop) << ir;
+}
+
+TEST(IrTestSuite, Test_Fallible_Instructions_Stay_In_Loop_Body)
+{
+  const char *input =
+    "var n = 10;\n"
+    "{ var i = 0; while (i < 3) { println(i); i = i + n * 2; } }\n";
+  std::string ir = script_ir(input, ir_default_options());
+  std::size_t loop = ir.find("PHI");
+  ASSERT_NE(loop, std::string::npos) << ir;
+  EXPECT_GT(ir.find("MUL"), loop) << ir;
+}
+
+TEST(IrTestSuite, Test_Dead_Code_Elimination)
+{
+  const char *input =
+    "var g = 3;\n"
+    "{ var a = g == 3; var b = !a; var c = g - 1; println(1); }\n";
+  Ir_Options options = no_passes();
+  options.dce = true;
+  std::string ir = script_ir(input, options);
+  EXPECT_EQ(ir.find(" EQ"), std::string::npos) << ir;
+  EXPECT_EQ(ir.find("NOT"), std::string::npos) << ir;
+
+  // NOTE(HS): `g - 1` is kept, it fails when `g` isn't a number
+  EXPECT_NE(ir.find("SUB"), std::string::npos) << ir;
+}
+
+TEST(IrTestSuite, Test_Captured_Locals_Not_Optimised)
+{
+  const char *input =
+    "var mk = func(x) { var y = x; return func() { return y; }; };\n"
+    "println(mk(1)());\n";
+  SETUP_PARSER_TEST_CASE(input);
+  EXPECT_PROGRAM_PARSED_SUCCESS(p);
+  Resolver resolver;
+  resolver_init(&resolver);
+  resolver_resolve_program(&resolver, (Program*) &p);
+  const char *listing = program_to_string(&p, TRACE_IR);
+  std::string ir{ listing };
+  tyger_free((void*) listing);
+  resolver_free(&resolver);
+  program_free(&p);
+
+  EXPECT_NE(ir.find("== mk ==\n; not optimised"), std::string::npos) << ir;
+  EXPECT_NE(ir.find("LOAD_UPVALUE"), std::string::npos) << ir;
+}
+
+TEST(IrTestSuite, Test_Inline_Small_Functions)
+{
+  // a local bound once calls the literal directly, a global is guarded
+  const char *input =
+    "var sq = func(x) { return x * x; };\n"
+    "{ var add = func(a, b) { return a + b; }; println(add(20, 22)); }\n"
+    "println(sq(5));\n";
+  Ir_Options options = ir_default_options();
+  std::string ir = script_ir(input, options);
+  EXPECT_EQ(ir.find("CALL "), std::string::npos) << ir;
+  EXPECT_EQ(count_of(ir, "CONST_INT 42"), 1) << ir;
+  EXPECT_EQ(count_of(ir, "IS_FUNCTION sq"), 1) << ir;
+  EXPECT_EQ(count_of(ir, "CONST_INT 25"), 1) << ir;
+
+  options.inline_max_size = 0;
+  ir = script_ir(input, options);
+  EXPECT_EQ(ir.find("IS_FUNCTION"), std::string::npos) << ir;
+  EXPECT_EQ(count_of(ir, "CALL_GLOBAL"), 1) << ir;
+}
+
+TEST(IrTestSuite, Test_Recursive_Functions_Not_Inlined)
+{
+  const char *input =
+    "var fact = func(n) { if (n < 2) { return 1; } return n * fact(n - 1); };\n"
+    "println(fact(10));\n";
+  std::string ir = script_ir(input, ir_default_options());
+  EXPECT_EQ(ir.find("IS_FUNCTION"), std::string::npos) << ir;
+  EXPECT_EQ(count_of(ir, "CALL_GLOBAL"), 1) << ir;
+}
+
+TEST(IrTestSuite, Test_Inline_From_Call_Profile)
+{
+  // `f` is stored twice so only the profile says which function the call finds
+  std::string input =
+    "var f = func(x) { return x + 1; };\n"
+    "var g = func(n) { return f(n); };\n"
+    "f = func(x) { return x * 3; };\n"
+    "println(g(4));\n";
+  std::string ir = script_ir(input.c_str(), ir_default_options());
+  EXPECT_EQ(ir.find("IS_FUNCTION"), std::string::npos) << ir;
+
+  Call_Profile profile;
+  call_profile_init(&profile);
+  FILE *f = std::tmpfile();
+  std::fprintf(f, "%zu %zu\n", input.find("f(n)"), input.find("func(x) { return x * 3"));
+  std::rewind(f);
+  EXPECT_TRUE(call_profile_read(&profile, f));
+  std::fclose(f);
+  Ir_Options options = ir_default_options();
+  options.call_profile = &profile;
+  ir = script_ir(input.c_str(), options);
+  EXPECT_EQ(count_of(ir, "IS_FUNCTION"), 1) << ir;
+  EXPECT_EQ(count_of(ir, "CONST_INT 12"), 1) << ir;
+  EXPECT_EQ(ir.find("CONST_INT 5"), std::string::npos) << ir;
+  call_profile_free(&profile);
+}
+
+TEST(IrTestSuite, Test_Call_Profile_Collects_Monomorphic_Sites)
+{
+  std::string input =
+    "var f = func(x) { return x; };\n"
+    "var g = func(x) { return x; };\n"
+    "var call = func(k, x) { return k(x); }; var i = 0;\n"
+    "while (i < 4) { f(i); if (i < 2) { call(f, i); } else { call(g, i); } i = i + 1; }\n";
+  SETUP_PARSER_TEST_CASE(input.c_str());
+  EXPECT_PROGRAM_PARSED_SUCCESS(p);
+  Resolver resolver;
+  resolver_init(&resolver);
+  resolver_resolve_program(&resolver, (Program*) &p);
+  Chunk chunk;
+  chunk_init(&chunk);
+  Compiler_Options compiler_options = compiler_default_options();
+  Tyger_Error err = compiler_compile_program(&p, &chunk, compiler_options);
+  ASSERT_EQ(err.kind, TYERR_NONE);
+  VM vm;
+  vm_init(&vm);
+  err = vm_run(&vm, &chunk);
+  ASSERT_EQ(err.kind, TYERR_NONE);
+
+  Call_Profile profile;
+  call_profile_init(&profile);
+  call_profile_collect(&profile, &chunk);
+  EXPECT_EQ(call_profile_lookup(&profile, input.find("f(i)")), input.find("func"));
+  EXPECT_EQ(call_profile_lookup(&profile, input.find("k(x)")), CALL_PROFILE_POLYMORPHIC);
+
+  FILE *f = std::tmpfile();
+  call_profile_write(&profile, f);
+  std::rewind(f);
+  Call_Profile read;
+  call_profile_init(&read);
+  EXPECT_TRUE(call_profile_read(&read, f));
+  EXPECT_EQ(read.len, 3);
+  EXPECT_EQ(call_profile_lookup(&read, input.find("f(i)")), input.find("func"));
+  std::fclose(f);
+
+  call_profile_free(&read);
+  call_profile_free(&profile);
+  vm_free(&vm);
+  chunk_free(&chunk);
+  resolver_free(&resolver);
+  program_free(&p);
+}
+
+TEST(IrTestSuite, Test_Optimised_Programs_Match)
+{
+  std::vector<const char *> test_cases{
+    "var fib = func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); };\n"
+    "println(fib(20));\n",
+    "var f = func(n) { var s = 0; var i = 0; while (i < n) { var k = n * 2 + 1; s = s + i * k; i = i + 1; } return s; };\n"
+    "println(f(10), f(0));\n",
+    // phis which swap, nested loops, `if` without `else`
+    "{ var a = 1; var b = 2; var i = 0; while (i < 5) { var t = a; a = b; b = t; i = i + 1; } println(a, b); }\n"
+    "{ var i = 0; var n = 0; while (i < 4) { var j = 0; while (j < i) { n = n + j; j = j + 1; } i = i + 1; } println(n); }\n"
+    "{ var x = 0; if (x == 0) { x = 5; } println(x); if (!x) { println(\"no\"); } else { println(\"yes\"); } }\n",
+    // closures reading upvalues, captured locals left to the bytecode compiler
+    "var mk = func(x) { var y = x * 2; return func(z) { y = y + z; return y; }; };\n"
+    "var c = mk(5); println(c(1), c(2));\n"
+    "var add = func(a) { return func(b) { return a + b; }; }; println(add(1)(2));\n"
+    "var i = 0; var fs = 0; while (i < 3) { var j = i; fs = func() { return j; }; i = i + 1; }\n"
+    "println(fs());\n",
+    // strings, bigints, truthiness
+    "{ var s = \"a\\tb\"; var t = s + \"c\"; println(t, len(t), type(t), s == \"a\\tb\"); }\n"
+    "{ var big = 9223372036854775807; println(big + 1, big + 1 - 1, -big - 2, big * 0 + 0); }\n"
+    "println(123456789012345678901234567890 / 7, !0, !false, 1 == true, false == false);\n",
+    // tail calls and memoised functions
+    "var loop = func(n, acc) { if (n == 0) { return acc; } return loop(n - 1, acc + n); };\n"
+    "println(loop(100000, 0));\n"
+    "var m = @memo func(n) { if (n < 2) { return n; } return m(n - 1) + m(n - 2); };\n"
+    "println(m(90));\n",
+    // globals written in calls, code after `return`
+    "var g = 1; var h = 0; var bump = func() { h = h + g; g = g * -1; };\n"
+    "{ var i = 0; while (i < g + 3) { bump(); i = i + 1; } println(i, g, h); }\n"
+    "var early = func(x) { return x; println(\"unreachable\"); }; println(early(3));\n",
+    // calls as callees and arguments, deep expression trees
+    "var id = func(x) { return x; }; println(id(id)(id(1) + id(2) * id(3)));\n"
+    "{ var a = 1; var b = 2; println(((a + b) * (a - b)) - ((a * b) + (b - a)) * (a + b)); }\n",
+    // errors are reported at the same place
+    "{ var i = 0; var n = \"x\"; while (i < 10) { i = i + n * 2; } }\n",
+    "{ var i = 0; var n = \"x\"; while (i < n * 2) { i = i + 1; } }\n",
+    "{ var a = 1; var b = 0; println(a); println(a / b); }\n",
+    "var f = func(a) { return a; };\nf(1, 2);\n",
+    "{ var x = 1; x(); }\n",
+    "println(1 + \"a\");\n",
+    "var deep = func(n) { return 1 + deep(n + 1); };\nprintln(deep(0));\n",
+    // builtins used in the wrong way fall back to the bytecode compiler's errors
+    "println(len(1, 2));\n",
+    // inlined calls, guards which fail once the global is reassigned, errors in them
+    "var sq = func(x) { return x * x; }; var g = func(n) { return sq(n) + 1; };\n"
+    "println(g(3)); sq = func(x) { return -x; }; println(g(3));\n"
+    "var pick = func(c) { if (c) { return 1; } return 2; }; println(pick(true) + pick(false));\n"
+    "var none = func() { var a = 1; }; println(none());\n",
+    "var half = func(x) { return x / 2; };\nprintln(half(4), half(\"a\"));\n",
+    "{ var add = func(a, b) { return a + b; }; println(add(1, \"b\")); }\n",
+  };
+
+  for (const char *input : test_cases)
+  {
+    expect_same_when_optimised(input);
+  }
+}
+
+TEST(IrTestSuite, Test_Optimised_Corpus_Matches)
+{
+  for (const char *name : { "collatz", "counting", "fizzbuzz", "globals", "strings" })
+  {
+    std::string path = std::string(TYGER_SOURCE_DIR) + "/scripts/corpus/" + name + ".ty";
+    std::ifstream file(path);
+    std::stringstream source;
+    source << file.rdbuf();
+    std::string input = source.str();
+    ASSERT_FALSE(input.empty()) << path;
+    expect_same_when_optimised(input.c_str());
+  }
+}
@@ -71,7 +71,7 @@ const auto TEST_CASES = std::vector<Lexer_Test_Case>{
   Lexer_Test_Case{ Location{ 95, 0, 0 }, Literal{ (char*) "=", 1 }, TK_ASSIGN },
   Lexer_Test_Case{ Location{ 97, 0, 0 }, Literal{ (char*) "10", 2 }, TK_INTEGER },
   Lexer_Test_Case{ Location{ 99, 0, 0 }, Literal{ (char*) ";", 1 }, TK_SEMICOLON },
-  Lexer_Test_Case{ Location{ 101, 0, 0 }, Literal{ (char*) "println", 7 }, TK_PRINTLN },
+  Lexer_Test_Case{ Location{ 101, 0, 0 }, Literal{ (char*) "println", 7 }, TK_IDENT },
   Lexer_Test_Case{ Location{ 108, 0, 0 }, Literal{ (char*) "(", 1 }, TK_LPAREN },
   Lexer_Test_Case{ Location{ 109, 0, 0 }, Literal{ (char*) ")", 1 }, TK_RPAREN },
   Lexer_Test_Case{ Location{ 110, 0, 0 }, Literal{ (char*) ";", 1 }, TK_SEMICOLON },
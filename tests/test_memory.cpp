@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+#include "../tests/vm_test_helper.hpp"
+
+TEST(MemoryTestSuite, Test_Memory_Stats_Account_By_Subsystem)
+{
+  Tyger_Memory_Stats before = tyger_memory_stats_collect();
+  char *block = (char*) tyger_malloc(MEMORY_LEXER, 100);
+  ASSERT_NE(block, nullptr);
+  block = (char*) tyger_realloc(MEMORY_PARSER, block, 300);
+  ASSERT_NE(block, nullptr);
+  block = (char*) tyger_realloc(MEMORY_PARSER, block, 50);
+  ASSERT_NE(block, nullptr);
+
+  Tyger_Memory_Stats during = tyger_memory_stats_collect();
+  const Tyger_Memory_Usage &lexer = during.subsystems[MEMORY_LEXER];
+  const Tyger_Memory_Usage &lexer_before = before.subsystems[MEMORY_LEXER];
+  // NOTE(HS): a block stays with the subsystem which allocated it
+  EXPECT_EQ(lexer.current_bytes - lexer_before.current_bytes, 50);
+  EXPECT_GE(lexer.peak_bytes, lexer_before.current_bytes + 300);
+  EXPECT_EQ(lexer.allocations - lexer_before.allocations, 1);
+  EXPECT_EQ(lexer.reallocations - lexer_before.reallocations, 2);
+  EXPECT_EQ(during.subsystems[MEMORY_PARSER].allocations, before.subsystems[MEMORY_PARSER].allocations);
+  EXPECT_EQ(during.total.current_bytes - before.total.current_bytes, 50);
+
+  tyger_free(block);
+  Tyger_Memory_Stats after = tyger_memory_stats_collect();
+  EXPECT_EQ(after.subsystems[MEMORY_LEXER].current_bytes, lexer_before.current_bytes);
+  EXPECT_EQ(after.subsystems[MEMORY_LEXER].frees - lexer_before.frees, 1);
+  EXPECT_EQ(after.total.current_bytes, before.total.current_bytes);
+
+  FILE *report = std::tmpfile();
+  tyger_memory_stats_write(&after, report);
+  std::string text = read_all(report);
+  std::fclose(report);
+  EXPECT_NE(text.find("\nlexer "), std::string::npos);
+  EXPECT_NE(text.find("\ntotal "), std::string::npos);
+}
+
+TEST(MemoryTestSuite, Test_Memory_Stats_Account_A_Run)
+{
+  Tyger_Memory_Stats before = tyger_memory_stats_collect();
+  {
+    Runner r;
+    runner_init(&r, "<test>", runner_default_options());
+    ASSERT_TRUE(runner_run_source(&r, "var f = func(n) { return n * 2; };\nvar x = f(21);\n"));
+    runner_free(&r);
+  }
+  Tyger_Memory_Stats after = tyger_memory_stats_collect();
+
+  for (size_t subsystem : { MEMORY_PARSER, MEMORY_RESOLVER, MEMORY_COMPILER, MEMORY_RUNTIME })
+  {
+    EXPECT_GT(after.subsystems[subsystem].allocations, before.subsystems[subsystem].allocations)
+      << tyger_memory_subsystem_to_string((Tyger_Memory_Subsystem) subsystem);
+    EXPECT_EQ(after.subsystems[subsystem].current_bytes, before.subsystems[subsystem].current_bytes)
+      << tyger_memory_subsystem_to_string((Tyger_Memory_Subsystem) subsystem);
+  }
+  EXPECT_GT(after.total.peak_bytes, before.total.current_bytes);
+}
+
+TEST(MemoryTestSuite, Test_Memory_Stats_Sum_Every_Thread)
+{
+  Tyger_Memory_Stats before = tyger_memory_stats_collect();
+  std::vector<void*> blocks;
+  for (size_t t = 0; t < 3; ++t)
+  {
+    std::thread([&blocks]() { blocks.push_back(tyger_malloc(MEMORY_LEXER, 1000)); }).join();
+  }
+
+  Tyger_Memory_Stats during = tyger_memory_stats_collect();
+  EXPECT_EQ(during.subsystems[MEMORY_LEXER].current_bytes - before.subsystems[MEMORY_LEXER].current_bytes, 3000);
+  EXPECT_EQ(during.subsystems[MEMORY_LEXER].allocations - before.subsystems[MEMORY_LEXER].allocations, 3);
+
+  // NOTE(HS): freed on another thread than allocated them
+  for (void *block : blocks)
+  {
+    tyger_free(block);
+  }
+  Tyger_Memory_Stats after = tyger_memory_stats_collect();
+  EXPECT_EQ(after.subsystems[MEMORY_LEXER].current_bytes, before.subsystems[MEMORY_LEXER].current_bytes);
+  EXPECT_EQ(after.subsystems[MEMORY_LEXER].frees - before.subsystems[MEMORY_LEXER].frees, 3);
+  EXPECT_GE(after.subsystems[MEMORY_LEXER].peak_bytes, before.subsystems[MEMORY_LEXER].current_bytes + 1000);
+  EXPECT_EQ(after.total.current_bytes, before.total.current_bytes);
+}
+
+/// an allocator which keeps count of what it's asked for, checking the sizes it's
+/// given back are the ones it allocated
+struct Counting_Allocator
+{
+  std::unordered_map<void*, size_t> live;
+  size_t allocs = 0;
+  size_t reallocs = 0;
+  size_t frees = 0;
+  size_t wrong_sizes = 0;
+};
+
+static void *counting_alloc(void *user, size_t size)
+{
+  Counting_Allocator *counting = (Counting_Allocator*) user;
+  void *ptr = std::malloc(size);
+  counting->live[ptr] = size;
+  counting->allocs += 1;
+  return ptr;
+}
+
+static void *counting_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+  Counting_Allocator *counting = (Counting_Allocator*) user;
+  counting->wrong_sizes += counting->live.at(ptr) != old_size;
+  counting->live.erase(ptr);
+  void *new_ptr = std::realloc(ptr, new_size);
+  counting->live[new_ptr] = new_size;
+  counting->reallocs += 1;
+  return new_ptr;
+}
+
+static void counting_free(void *user, void *ptr, size_t size)
+{
+  Counting_Allocator *counting = (Counting_Allocator*) user;
+  counting->wrong_sizes += counting->live.at(ptr) != size;
+  counting->live.erase(ptr);
+  counting->frees += 1;
+  std::free(ptr);
+}
+
+TEST(MemoryTestSuite, Test_Allocator_Serves_A_Runner)
+{
+  Counting_Allocator counting;
+  Tyger_Allocator allocator = { counting_alloc, counting_realloc, counting_free, &counting };
+
+  Runner_Options options = runner_default_options();
+  options.allocator = &allocator;
+  options.lazy_functions = true;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  EXPECT_EQ(tyger_allocator_current(), tyger_default_allocator());
+  ASSERT_TRUE(runner_run_source(
+    &r,
+    "var repeat = func(n) { var s = \"\"; var i = 0; while (i < n) { s = s + \"x\"; i = i + 1; } return s; };\n"
+    "var adders = func(n) { var i = 0; while (i < n) { var add = func(x) { return x + i; }; i = add(1); } return i; };\n"
+    "var s = repeat(100);\n"
+    "var n = adders(100);\n"
+  ));
+  runner_free(&r);
+
+  EXPECT_GT(counting.allocs, 0);
+  EXPECT_GT(counting.reallocs, 0);
+  EXPECT_EQ(counting.frees, counting.allocs);
+  EXPECT_TRUE(counting.live.empty());
+  EXPECT_EQ(counting.wrong_sizes, 0);
+  EXPECT_EQ(tyger_allocator_current(), tyger_default_allocator());
+}
+
+TEST(MemoryTestSuite, Test_Allocator_Blocks_Return_To_Their_Allocator)
+{
+  Counting_Allocator counting;
+  Tyger_Allocator allocator = { counting_alloc, counting_realloc, counting_free, &counting };
+
+  const Tyger_Allocator *previous = tyger_allocator_use(&allocator);
+  EXPECT_EQ(previous, tyger_default_allocator());
+  EXPECT_EQ(tyger_allocator_current(), &allocator);
+  void *ours = tyger_malloc(MEMORY_OTHER, 24);
+  tyger_allocator_use(previous);
+
+  // NOTE(HS): switching back doesn't change where the block is resized and freed
+  void *theirs = tyger_malloc(MEMORY_OTHER, 24);
+  ours = tyger_realloc(MEMORY_OTHER, ours, 4096);
+  ASSERT_NE(ours, nullptr);
+  tyger_free(ours);
+  tyger_free(theirs);
+
+  EXPECT_EQ(counting.allocs, 1);
+  EXPECT_EQ(counting.reallocs, 1);
+  EXPECT_EQ(counting.frees, 1);
+  EXPECT_EQ(counting.wrong_sizes, 0);
+
+  // NOTE(HS): each thread has its own, starting with the default
+  tyger_allocator_use(&allocator);
+  const Tyger_Allocator *worker_allocator = nullptr;
+  std::thread worker([&]() {
+    worker_allocator = tyger_allocator_current();
+  });
+  worker.join();
+  tyger_allocator_use(nullptr);
+  EXPECT_EQ(worker_allocator, tyger_default_allocator());
+}
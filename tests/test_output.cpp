@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdio>
+#include "../tests/vm_test_helper.hpp"
+
+TEST(OutputTestSuite, Test_Output_Buffers_Until_Flushed)
+{
+  FILE *f = std::tmpfile();
+  Output out;
+  output_init(&out, fileno(f), 64, OUTPUT_FLUSH_FULL);
+
+  output_puts(&out, "hello");
+  output_putc(&out, '\n');
+  output_write(&out, "world\n", 6);
+  EXPECT_EQ(out.writes, 0);
+  EXPECT_EQ(read_all(f), "");
+
+  output_flush(&out);
+  EXPECT_EQ(out.writes, 1);
+  EXPECT_EQ(read_all(f), "hello\nworld\n");
+
+  output_free(&out);
+  std::fclose(f);
+}
+
+TEST(OutputTestSuite, Test_Output_Flushes_When_Full)
+{
+  FILE *f = std::tmpfile();
+  Output out;
+  output_init(&out, fileno(f), 8, OUTPUT_FLUSH_FULL);
+
+  output_puts(&out, "abcdef");
+  output_puts(&out, "ghijkl");
+  EXPECT_EQ(out.writes, 1);
+  EXPECT_EQ(read_all(f), "abcdef");
+
+  output_free(&out);
+  EXPECT_EQ(out.writes, 2);
+  EXPECT_EQ(read_all(f), "abcdefghijkl");
+  std::fclose(f);
+}
+
+TEST(OutputTestSuite, Test_Output_Large_Writes_Skip_Buffer)
+{
+  FILE *f = std::tmpfile();
+  Output out;
+  output_init(&out, fileno(f), 8, OUTPUT_FLUSH_FULL);
+
+  std::string large(32, 'x');
+  output_puts(&out, "ab");
+  output_write(&out, large.data(), large.size());
+  EXPECT_EQ(out.writes, 2);
+  EXPECT_EQ(out.len, 0);
+  EXPECT_EQ(read_all(f), "ab" + large);
+
+  output_free(&out);
+  std::fclose(f);
+}
+
+TEST(OutputTestSuite, Test_Output_Line_Flush)
+{
+  FILE *f = std::tmpfile();
+  Output out;
+  output_init(&out, fileno(f), 64, OUTPUT_FLUSH_LINE);
+
+  output_puts(&out, "a b");
+  EXPECT_EQ(out.writes, 0);
+  output_putc(&out, '\n');
+  EXPECT_EQ(out.writes, 1);
+  output_puts(&out, "c\nd");
+  EXPECT_EQ(out.writes, 2);
+  EXPECT_EQ(read_all(f), "a b\nc\nd");
+
+  output_free(&out);
+  std::fclose(f);
+}
+
+TEST(OutputTestSuite, Test_Output_Auto_Flush_Is_Full_For_Files)
+{
+  FILE *f = std::tmpfile();
+  Output out;
+  output_init(&out, fileno(f), 64, OUTPUT_FLUSH_AUTO);
+  EXPECT_FALSE(out.line_buffered);
+  output_free(&out);
+  std::fclose(f);
+}
+
+TEST(OutputTestSuite, Test_Output_Unbuffered)
+{
+  FILE *f = std::tmpfile();
+  Output out;
+  output_init(&out, fileno(f), 0, OUTPUT_FLUSH_FULL);
+
+  output_puts(&out, "a");
+  output_putc(&out, 'b');
+  EXPECT_EQ(out.writes, 2);
+  EXPECT_EQ(read_all(f), "ab");
+
+  output_free(&out);
+  std::fclose(f);
+}
+
+TEST(OutputTestSuite, Test_Output_Flush_From_String)
+{
+  Output_Flush flush;
+  ASSERT_TRUE(output_flush_from_string("auto", &flush));
+  EXPECT_EQ(flush, OUTPUT_FLUSH_AUTO);
+  ASSERT_TRUE(output_flush_from_string("line", &flush));
+  EXPECT_EQ(flush, OUTPUT_FLUSH_LINE);
+  ASSERT_TRUE(output_flush_from_string("full", &flush));
+  EXPECT_EQ(flush, OUTPUT_FLUSH_FULL);
+  EXPECT_FALSE(output_flush_from_string("never", &flush));
+}
@@ -32,8 +32,8 @@ TEST(ParserTestSuite, Test_Var_Statement)
     const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
     const char *prog_sexpr = program_to_string((Program*) &p, TRACE_SEXPR);
     DEFER({
-        delete prog_str;
-        delete prog_sexpr;
+        tyger_free((void*) prog_str);
+        tyger_free((void*) prog_sexpr);
         program_free((Program*) &p);
     });
 
@@ -73,6 +73,7 @@ TEST(ParserTestSuite, Test_Int_Expression)
     { "10;", "(10)" },
     { "100000;", "(100000)" },
     { "9223372036854775807;", "(9223372036854775807)" },
+    { "92233720368547758070;", "(92233720368547758070)" },
   };
 
   for (auto& tc : test_cases)
@@ -82,8 +83,8 @@ TEST(ParserTestSuite, Test_Int_Expression)
     const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
     const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
     DEFER({
-        delete prog_str;
-        delete act_ast;
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
         program_free((Program*) &p);
     });
 
@@ -127,7 +128,7 @@ TEST(ParserTestSuite, Test_String_Expression)
     SETUP_PARSER_TEST_CASE(tc.input.c_str());
     const char *prog_str = program_to_string(&p, TRACE_YAML);
     DEFER({
-        delete prog_str;
+        tyger_free((void*) prog_str);
         program_free((Program*) &p);
     });
 
@@ -171,8 +172,8 @@ TEST(ParserTestSuite, Test_Ident_Expression)
     const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
     const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
     DEFER({
-        delete prog_str;
-        delete act_ast;
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
         program_free((Program*) &p);
     });
 
@@ -219,8 +220,8 @@ TEST(ParserTestSuite, Test_Infix_Expression)
     const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
     const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
     DEFER({
-        delete prog_str;
-        delete act_ast;
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
         program_free((Program*) &p);
     });
 
@@ -302,8 +303,8 @@ TEST(ParserTestSuite, Test_Operator_Precidence)
     const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
     const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
     DEFER({
-        delete prog_str;
-        delete act_ast;
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
         program_free((Program*) &p);
     });
 
@@ -353,8 +354,8 @@ TEST(ParserTestSuite, Test_Call_Expression)
     const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
     const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
     DEFER({
-        delete prog_str;
-        delete act_ast;
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
         program_free((Program*) &p);
     });
 
@@ -370,10 +371,225 @@ TEST(ParserTestSuite, Test_Call_Expression)
     EXPECT_EXPRESSION_IS(expr, EXPR_CALL) << prog_str;
 
     const Call_Expression *ce = &(expr->expression.call_expression);
-    ASSERT_EQ(ce->args.len, tc.arg_count) << prog_str;
+    ASSERT_EQ(ce->args_len, tc.arg_count) << prog_str;
 
     std::string act_ast_string{act_ast};
     std::string exp_ast_string{tc.ast};
     EXPECT_EQ(act_ast_string, exp_ast_string) << prog_str;
   }
 }
+
+TEST(ParserTestSuite, Test_Block_Statement)
+{
+  struct Block_Test
+  {
+    const char *input;
+    std::size_t len;
+    const char *ast;
+  };
+
+  std::vector<Block_Test> test_cases{
+    { "{}", 0, "(block)" },
+    { "{ 1; }", 1, "(block (1))" },
+    { "{ var x = 1; x; }", 2, "(block (var x 1) (x))" },
+    { "{ var x = 1; { var y = x; } }", 2, "(block (var x 1) (block (var y x)))" },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    SETUP_PARSER_TEST_CASE(tc.input);
+    const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
+    const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
+    DEFER({
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
+        program_free((Program*) &p);
+    });
+
+    EXPECT_PROGRAM_PARSED_SUCCESS(p);
+    ENUMERATE_PARSER_ERRORS(p);
+    ASSERT_EQ(p.statements.len, 1) << prog_str;
+
+    Statement *stmt = &(p.statements.elems[0]);
+    EXPECT_STATEMENT_IS(stmt, STMT_BLOCK) << prog_str;
+    EXPECT_EQ(stmt->statement.block_statement.len, tc.len) << prog_str;
+
+    std::string act_ast_string{act_ast};
+    std::string exp_ast_string{tc.ast};
+    EXPECT_EQ(exp_ast_string, act_ast_string) << prog_str;
+  }
+}
+
+TEST(ParserTestSuite, Test_Control_Flow_Statements)
+{
+  struct Control_Flow_Test
+  {
+    const char *input;
+    Statement_Kind kind;
+    const char *ast;
+  };
+
+  std::vector<Control_Flow_Test> test_cases{
+    { "x = 1;", STMT_ASSIGN, "(assign x 1)" },
+    { "x = y + 1;", STMT_ASSIGN, "(assign x (+ y 1))" },
+    { "if (x) { 1; }", STMT_IF, "(if x (block (1)))" },
+    { "if (x < 1) { 1; } else { 2; }", STMT_IF, "(if (< x 1) (block (1)) (block (2)))" },
+    { "if (x) { 1; } else if (y) { 2; }", STMT_IF, "(if x (block (1)) (if y (block (2))))" },
+    { "while (x <= 10) { x = x + 1; }", STMT_WHILE, "(while (<= x 10) (block (assign x (+ x 1))))" },
+    { "true;", STMT_EXPRESSION, "(true)" },
+    { "!false;", STMT_EXPRESSION, "((! false))" },
+    { "-(1 + 2) * 3;", STMT_EXPRESSION, "((* (- (+ 1 2)) 3))" },
+    { "x >= 1 == true;", STMT_EXPRESSION, "((== (>= x 1) true))" },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    SETUP_PARSER_TEST_CASE(tc.input);
+    const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
+    const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
+    DEFER({
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
+        program_free((Program*) &p);
+    });
+
+    EXPECT_PROGRAM_PARSED_SUCCESS(p);
+    ENUMERATE_PARSER_ERRORS(p);
+    ASSERT_EQ(p.statements.len, 1) << prog_str;
+
+    Statement *stmt = &(p.statements.elems[0]);
+    EXPECT_STATEMENT_IS(stmt, tc.kind) << prog_str;
+
+    std::string act_ast_string{act_ast};
+    std::string exp_ast_string{tc.ast};
+    EXPECT_EQ(exp_ast_string, act_ast_string) << prog_str;
+  }
+}
+
+TEST(ParserTestSuite, Test_Function_Statements)
+{
+  struct Function_Test
+  {
+    const char *input;
+    Statement_Kind kind;
+    const char *ast;
+  };
+
+  std::vector<Function_Test> test_cases{
+    { "func() {};", STMT_EXPRESSION, "((func [] (block)))" },
+    { "var f = func(a, b) { return a + b; };", STMT_VAR, "(var f (func [a ; b] (block (return (+ a b)))))" },
+    { "const f = func() { return; };", STMT_VAR, "(const f (func [] (block (return))))" },
+    { "const x = 1;", STMT_VAR, "(const x 1)" },
+    { "return;", STMT_RETURN, "(return)" },
+    { "return 1 + 2;", STMT_RETURN, "(return (+ 1 2))" },
+    { "f(1, 2);", STMT_EXPRESSION, "(f [1 ; 2])" },
+    { "f(1)(2);", STMT_EXPRESSION, "(f [1] [2])" },
+    { "1 + f(2) * 3;", STMT_EXPRESSION, "((+ 1 (* f [2] 3)))" },
+    { "func(x) { return x; }(1);", STMT_EXPRESSION, "((func [x] (block (return x))) [1])" },
+    { "println(func(a) { return func(b) { return b; }; });", STMT_EXPRESSION,
+      "(println [(func [a] (block (return (func [b] (block (return b))))))])" },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    SETUP_PARSER_TEST_CASE(tc.input);
+    const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
+    const char *act_ast = program_to_string((Program*) &p, TRACE_SEXPR);
+    DEFER({
+        tyger_free((void*) prog_str);
+        tyger_free((void*) act_ast);
+        program_free((Program*) &p);
+    });
+
+    EXPECT_PROGRAM_PARSED_SUCCESS(p);
+    ENUMERATE_PARSER_ERRORS(p);
+    ASSERT_EQ(p.statements.len, 1) << prog_str;
+
+    Statement *stmt = &(p.statements.elems[0]);
+    EXPECT_STATEMENT_IS(stmt, tc.kind) << prog_str;
+
+    std::string act_ast_string{act_ast};
+    std::string exp_ast_string{tc.ast};
+    EXPECT_EQ(exp_ast_string, act_ast_string) << prog_str;
+  }
+}
+
+TEST(ParserTestSuite, Test_Lazy_Function_Bodies)
+{
+  struct Lazy_Test
+  {
+    const char *input;
+    const char *ast;
+  };
+
+  // NOTE(HS): only literals in top level statements are pre-parsed, nothing in their
+  // bodies is checked until they're parsed in full
+  std::vector<Lazy_Test> test_cases{
+    { "var f = func(a) { return a + ; };", "(var f (lazy func [a] (block)))" },
+    { "println(func(a) { return { func() {}; }; }(1));", "(println [(lazy func [a] (block)) [1]])" },
+    { "{ var g = func() { return 1; }; }", "(block (var g (func [] (block (return 1)))))" },
+    { "var m = @memo func(n) { return n; };", "(var m (@memo func [n] (block (return n))))" },
+    { "var f = (func() { return 1; });", "(var f (lazy func [] (block)))" },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    Lexer lexer;
+    Parser parser;
+    lexer_init(&lexer, tc.input);
+    parser_init(&parser, &lexer);
+    parser.lazy_functions = true;
+    Program p = parser_parse_program(&parser);
+    const char *act_ast = program_to_string(&p, TRACE_SEXPR);
+    DEFER({
+        tyger_free((void*) act_ast);
+        program_free((Program*) &p);
+    });
+
+    ENUMERATE_PARSER_ERRORS(p);
+    ASSERT_EQ(p.statements.len, 1);
+    EXPECT_EQ(std::string{act_ast}, std::string{tc.ast}) << tc.input;
+  }
+
+  {
+    Lexer lexer;
+    Parser parser;
+    lexer_init(&lexer, "var f = func() { { return 1; };");
+    parser_init(&parser, &lexer);
+    parser.lazy_functions = true;
+    Program p = parser_parse_program(&parser);
+    EXPECT_EQ(p.errors.len, 1);
+    program_free(&p);
+  }
+}
+
+TEST(ParserTestSuite, Test_Parse_Function_From_Source)
+{
+  // the literal is parsed on its own, stopping before the call which follows it
+  std::string input = "var x = 1;\nprintln(func(a, b) { return a * b; }(2, 3));\n";
+  std::size_t pos = input.find("func");
+
+  Lexer lexer;
+  Parser parser;
+  lexer_init_at(&lexer, input.c_str(), pos);
+  parser_init(&parser, &lexer);
+  Program p = parser_parse_function(&parser);
+  const char *act_ast = program_to_string(&p, TRACE_SEXPR);
+  DEFER({
+      tyger_free((void*) act_ast);
+      program_free((Program*) &p);
+  });
+
+  ENUMERATE_PARSER_ERRORS(p);
+  ASSERT_EQ(p.statements.len, 1);
+  EXPECT_EQ(std::string{act_ast}, "((func [a ; b] (block (return (* a b)))))");
+  EXPECT_EQ(p.statements.elems[0].location.pos, pos);
+
+  const Statement *body = statement_handle_to_statement(
+    &p,
+    expression_handle_to_expression(&p, p.statements.elems[0].statement.expression_statement.expression_handle)
+      ->expression.func_expression.body
+  );
+  const Statement *ret = statement_handle_to_statement(&p, body->statement.block_statement.first);
+  EXPECT_EQ(ret->location.pos, input.find("return"));
+}
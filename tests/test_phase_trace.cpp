@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdio>
+#include <thread>
+#include "../tests/vm_test_helper.hpp"
+
+static size_t count_occurrences(const std::string &haystack, const std::string &needle)
+{
+  size_t count = 0;
+  for (size_t at = haystack.find(needle); at != std::string::npos; at = haystack.find(needle, at + 1))
+  {
+    count += 1;
+  }
+  return count;
+}
+
+TEST(PhaseTraceTestSuite, Test_Phase_Trace_Records_Pipeline_Phases)
+{
+  EXPECT_EQ(phase_begin("idle").trace, nullptr);
+
+  Runner_Options options = runner_default_options();
+  options.optimise = true;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  phase_trace_start();
+  EXPECT_TRUE(runner_run_source(&r, "var sq = func(x) { return x * x; }; println(sq(7));"));
+  phase_trace_stop();
+  EXPECT_EQ(phase_trace_current, nullptr);
+
+  FILE *trace = std::tmpfile();
+  phase_trace_write(trace);
+  std::string json = read_all(trace);
+  std::fclose(trace);
+  phase_trace_free();
+
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0) << json;
+  // NOTE(HS): the script and `sq` are each optimised
+  for (const char *phase : { "parse", "resolve", "compile", "run" })
+  {
+    EXPECT_EQ(count_occurrences(json, std::string("\"name\":\"") + phase + "\""), 1) << phase;
+  }
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"optimise\""), 2);
+  EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(json.find("\"dropped_events\":0}"), std::string::npos);
+
+  runner_free(&r);
+  EXPECT_EQ(read_all(out), "49\n");
+  std::fclose(out);
+}
+
+TEST(PhaseTraceTestSuite, Test_Phase_Trace_Keeps_The_Latest_Events_Per_Thread)
+{
+  phase_trace_start();
+  for (size_t i = 0; i < PHASE_TRACE_CAPACITY + 5; ++i)
+  {
+    phase_end(phase_begin("main_phase"));
+  }
+  phase_trace_stop();
+
+  std::thread worker([]() {
+    phase_trace_start();
+    phase_end(phase_begin("worker_phase"));
+    phase_trace_stop();
+  });
+  worker.join();
+
+  FILE *trace = std::tmpfile();
+  phase_trace_write(trace);
+  std::string json = read_all(trace);
+  std::fclose(trace);
+  phase_trace_free();
+
+  EXPECT_EQ(count_occurrences(json, "\"main_phase\""), PHASE_TRACE_CAPACITY);
+  EXPECT_EQ(count_occurrences(json, "\"worker_phase\""), 1);
+  EXPECT_EQ(count_occurrences(json, "\"tid\":1}"), PHASE_TRACE_CAPACITY);
+  EXPECT_EQ(count_occurrences(json, "\"tid\":2}"), 1);
+  EXPECT_NE(json.find("\"dropped_events\":5}"), std::string::npos);
+}
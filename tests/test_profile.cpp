@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdio>
+#include <unistd.h>
+#include "../tests/vm_test_helper.hpp"
+
+TEST(ProfileTestSuite, Test_Sample_Profile_Folds_Stacks_By_Line)
+{
+  Runner_Options options = runner_default_options();
+  options.no_jit = true;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  const char *source =
+    "var f = func(n) { return n; };\n"
+    "var g = func(n) {\n"
+    "  return f(n) + f(n);\n"
+    "};\n";
+  ASSERT_TRUE(runner_run_source(&r, source));
+  const Obj_Function *f = chunk_function_constant(&r.chunks.elems[0], "f");
+  const Obj_Function *g = chunk_function_constant(&r.chunks.elems[0], "g");
+
+  // NOTE(HS): the two calls to `f` are at different positions on line 3
+  Sample_Frame left[] = { { nullptr, 72 }, { g, 56 }, { f, 18 } };
+  Sample_Frame right[] = { { nullptr, 72 }, { g, 65 }, { f, 18 } };
+  Sample_Frame top[] = { { nullptr, 0 } };
+
+  Sample_Profile profile;
+  sample_profile_init(&profile, 0);
+  EXPECT_EQ(profile.hz, SAMPLE_PROFILE_DEFAULT_HZ);
+  sample_profile_record(&profile, left, 3);
+  sample_profile_record(&profile, left, 3);
+  sample_profile_record(&profile, right, 3);
+  sample_profile_record(&profile, top, 1);
+  EXPECT_EQ(profile.samples, 4);
+  EXPECT_EQ(profile.stacks.len, 3);
+
+  FILE *folded = std::tmpfile();
+  sample_profile_write(&profile, source, folded);
+  EXPECT_EQ(read_all(folded), "<script>:1 1\n<script>:4;g:3;f:1 3\n");
+  std::fclose(folded);
+
+  sample_profile_clear(&profile);
+  EXPECT_EQ(profile.samples, 0);
+  EXPECT_EQ(profile.stacks.len, 0);
+  sample_profile_free(&profile);
+
+  runner_free(&r);
+  std::fclose(out);
+}
+
+TEST(ProfileTestSuite, Test_Sample_Profile_Lines_Are_In_Each_Functions_Source)
+{
+  Runner_Options options = runner_default_options();
+  options.no_jit = true;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  ASSERT_TRUE(runner_run_source(&r, "\n\nvar f = func(n) {\n  return n;\n};\n"));
+  const Obj_Function *f = chunk_function_constant(&r.chunks.elems[0], "f");
+
+  // NOTE(HS): a later line calling `f`, whose position is on line 4 of its own source
+  const char *source = "f(1);";
+  Sample_Frame frames[] = { { nullptr, 0 }, { f, 29 } };
+  Sample_Profile profile;
+  sample_profile_init(&profile, 0);
+  sample_profile_record(&profile, frames, 2);
+
+  FILE *folded = std::tmpfile();
+  sample_profile_write(&profile, source, folded);
+  EXPECT_EQ(read_all(folded), "<script>:1;f:4 1\n");
+  std::fclose(folded);
+
+  sample_profile_free(&profile);
+  runner_free(&r);
+  std::fclose(out);
+}
+
+#if SAMPLE_PROFILE_SUPPORTED
+TEST(ProfileTestSuite, Test_Sample_Profile_Samples_Running_Script)
+{
+  char path[] = "/tmp/tyger_samples_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  close(fd);
+
+  Runner_Options options = runner_default_options();
+  options.no_jit = true;
+  options.profile_samples_path = path;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  // NOTE(HS): long enough to be sampled at least once at the default rate
+  const char *source =
+    "var spin = func(n) {\n"
+    "  var i = 0;\n"
+    "  while (i < n) { i = i + 1; }\n"
+    "  return i;\n"
+    "};\n"
+    "println(spin(3000000));\n";
+  EXPECT_TRUE(runner_run_source(&r, source));
+  EXPECT_EQ(r.vm.sampler, nullptr);
+  runner_free(&r);
+  EXPECT_EQ(read_all(out), "3000000\n");
+  std::fclose(out);
+
+  FILE *folded = std::fopen(path, "r");
+  ASSERT_NE(folded, nullptr);
+  std::string stacks = read_all(folded);
+  std::fclose(folded);
+  std::remove(path);
+  EXPECT_NE(stacks.find("<script>:6;spin:3 "), std::string::npos) << stacks;
+}
+#endif
+
+TEST(ProfileTestSuite, Test_Exec_Counters_Report_And_Json)
+{
+  Runner_Options options = runner_default_options();
+  options.no_jit = true;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  const char *source =
+    "var f = func(n) { return n; };\n"
+    "var g = func(n) {\n"
+    "  return f(n) + f(n);\n"
+    "};\n";
+  ASSERT_TRUE(runner_run_source(&r, source));
+  const Obj_Function *f = chunk_function_constant(&r.chunks.elems[0], "f");
+  const Obj_Function *g = chunk_function_constant(&r.chunks.elems[0], "g");
+
+  Exec_Counters counters;
+  exec_counters_init(&counters);
+  counters.opcodes[OPC_LOAD_LOCAL] = 3;
+  counters.opcodes[OPC_RETURN] = 1;
+  exec_counters_call(&counters, f);
+  exec_counters_call(&counters, f);
+  exec_counters_call(&counters, g);
+  exec_counters_branch(&counters, &f->chunk, 0, true);
+  exec_counters_branch(&counters, &f->chunk, 0, false);
+  exec_counters_branch(&counters, &f->chunk, 0, false);
+  exec_counters_cache(&counters, &g->chunk, 0, true);
+
+  const Exec_Site *calls = exec_counters_find(&counters.functions, f, 0);
+  ASSERT_NE(calls, nullptr);
+  EXPECT_EQ(calls->counts[0], 2);
+  const Exec_Site *branch = exec_counters_find(&counters.branches, &f->chunk, 0);
+  ASSERT_NE(branch, nullptr);
+  EXPECT_EQ(branch->counts[0], 1);
+  EXPECT_EQ(branch->counts[1], 2);
+  EXPECT_EQ(exec_counters_find(&counters.call_sites, &f->chunk, 0), nullptr);
+
+  // NOTE(HS): the first instruction of each function is on the line it starts on
+  FILE *json = std::tmpfile();
+  exec_counters_write_json(&counters, source, json);
+  EXPECT_EQ(
+    read_all(json),
+    "{\"opcodes\":{\"LOAD_LOCAL\":3,\"RETURN\":1},"
+    "\"functions\":[{\"name\":\"f\",\"line\":1,\"col\":9,\"calls\":2},"
+    "{\"name\":\"g\",\"line\":2,\"col\":9,\"calls\":1}],"
+    "\"branches\":[{\"line\":1,\"col\":26,\"taken\":1,\"not_taken\":2}],"
+    "\"call_sites\":[{\"line\":3,\"col\":12,\"hits\":1,\"misses\":0}]}\n"
+  );
+  std::fclose(json);
+
+  FILE *report = std::tmpfile();
+  exec_counters_write_report(&counters, source, report);
+  std::string text = read_all(report);
+  std::fclose(report);
+  EXPECT_NE(text.find("instructions: 4\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("75.00%  LOAD_LOCAL\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("2  f 1:9\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("1:26 1 / 2 (33.33% taken)\n"), std::string::npos) << text;
+
+  exec_counters_clear(&counters);
+  EXPECT_EQ(counters.functions.len, 0);
+  EXPECT_EQ(exec_counters_find(&counters.functions, f, 0), nullptr);
+  exec_counters_free(&counters);
+
+  runner_free(&r);
+  std::fclose(out);
+}
+
+#if EXEC_COUNTERS_ENABLED
+TEST(ProfileTestSuite, Test_Exec_Counters_Count_Run)
+{
+  Runner_Options options = runner_default_options();
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  Exec_Counters counters;
+  exec_counters_init(&counters);
+  r.vm.counters = &counters;
+  const char *source =
+    "var f = func(n) { if (n < 3) { return 0; } return n; };\n"
+    "var i = 0; var sum = 0;\n"
+    "while (i < 10) { sum = sum + f(i); i = i + 1; }\n"
+    "println(sum);\n";
+  ASSERT_TRUE(runner_run_source(&r, source));
+  const Chunk *chunk = &r.chunks.elems[0];
+  const Obj_Function *f = chunk_function_constant(chunk, "f");
+
+  const Exec_Site *calls = exec_counters_find(&counters.functions, f, 0);
+  ASSERT_NE(calls, nullptr);
+  EXPECT_EQ(calls->counts[0], 10);
+
+  // NOTE(HS): `n < 3` jumps past the return for 7 of the 10 calls
+  ASSERT_EQ(counters.branches.len, 2);
+  uint64_t taken = 0, not_taken = 0;
+  for (size_t i = 0; i < counters.branches.capacity; ++i)
+  {
+    const Exec_Site *site = &counters.branches.entries[i];
+    if (site->key == &f->chunk)
+    {
+      taken += site->counts[0];
+      not_taken += site->counts[1];
+    }
+  }
+  EXPECT_EQ(taken, 7);
+  EXPECT_EQ(not_taken, 3);
+
+  // NOTE(HS): builtins are called without a cache
+  ASSERT_EQ(counters.call_sites.len, 1);
+  uint64_t hits = 0, misses = 0;
+  for (size_t i = 0; i < counters.call_sites.capacity; ++i)
+  {
+    hits += counters.call_sites.entries[i].counts[0];
+    misses += counters.call_sites.entries[i].counts[1];
+  }
+  EXPECT_EQ(hits, 9);
+  EXPECT_EQ(misses, 1);
+  EXPECT_EQ(counters.opcodes[OPC_CALL_NATIVE], 1);
+
+  r.vm.counters = NULL;
+  exec_counters_free(&counters);
+  runner_free(&r);
+  EXPECT_EQ(read_all(out), "42\n");
+  std::fclose(out);
+}
+#endif
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../tests/parser_test_helper.hpp"
+
+#define SETUP_PURITY_TEST_CASE(INPUT)                \
+  SETUP_PARSER_TEST_CASE(INPUT);                     \
+  Resolver resolver;                                 \
+  do {                                               \
+    resolver_init(&resolver);                        \
+    resolver_resolve_program(&resolver, &p);         \
+  } while (0)
+
+/// the function literal the `index`th top-level statement declares
+static const Func_Expression *nth_declared_function(const Program *p, std::size_t index)
+{
+  const Var_Statement *vs = &(p->statements.elems[index].statement.var_statement);
+  const Expression *expr = expression_handle_to_expression(p, vs->expression_handle);
+  EXPECT_EQ(expr->kind, EXPR_FUNC);
+  return &expr->expression.func_expression;
+}
+
+TEST(PurityTestSuite, Test_Pure_Memo_Functions)
+{
+  std::vector<const char *> test_cases{
+    "var fib = @memo func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); };",
+    "var f = @memo func(s) { var n = len(s); while (n > 0) { n = n - 1; } return type(s) + n; };",
+    "const k = 3; var f = @memo func(x) { return x * k; };",
+    "var sq = func(x) { return x * x; }; var f = @memo func(x) { return sq(x) + sq(x + 1); };",
+    "var inc = func(n) { return n + 1; };"
+    "var f = @memo func(n) { if (n == 0) { return 0; } return inc(f(n - 1)); };",
+    "var f = @memo func(x) { var g = func(y) { return y; }; return g; };",
+  };
+
+  for (auto input : test_cases)
+  {
+    SETUP_PURITY_TEST_CASE(input);
+    DEFER({
+        program_free((Program*) &p);
+        resolver_free((Resolver*) &resolver);
+    });
+
+    EXPECT_EQ(p.errors.len, 0) << input << (p.errors.len ? p.errors.elems[0].message : "");
+  }
+}
+
+TEST(PurityTestSuite, Test_Impure_Memo_Functions)
+{
+  struct Impure_Test
+  {
+    const char *input;
+    std::size_t pos;
+    const char *message;
+  };
+
+  std::vector<Impure_Test> test_cases{
+    {
+      "var n = 0; var f = @memo func(x) { n = x; return x; };", 19,
+      "`@memo` function is not pure, it assigns the global `n`"
+    },
+    {
+      "var f = @memo func(x) { println(x); return x; };", 8,
+      "`@memo` function is not pure, it calls the builtin `println`, which has side effects"
+    },
+    {
+      "var n = 0; var f = @memo func(x) { return x + n; }; n = 1;", 19,
+      "`@memo` function is not pure, it reads the global `n`, which is reassigned"
+    },
+    {
+      "var g = func(x) { print(x); return x; }; var f = @memo func(x) { return g(x); };", 49,
+      "`@memo` function is not pure, it calls `g`, which calls the builtin `print`, which has side effects"
+    },
+    {
+      "var g = 1; var f = @memo func(x) { return g(x); };", 19,
+      "`@memo` function is not pure, it calls `g`, which isn't a function literal"
+    },
+    {
+      "var f = @memo func(g) { return g(1); };", 8,
+      "`@memo` function is not pure, it calls `g`, which isn't known to be pure"
+    },
+    {
+      "var h = func(n) { return @memo func(x) { return x + n; }; };", 25,
+      "`@memo` function is not pure, it captures variables from an enclosing function"
+    },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    SETUP_PURITY_TEST_CASE(tc.input);
+    DEFER({
+        program_free((Program*) &p);
+        resolver_free((Resolver*) &resolver);
+    });
+
+    ASSERT_EQ(p.errors.len, 1) << tc.input;
+    const Tyger_Error *err = &(p.errors.elems[0]);
+    EXPECT_EQ(err->kind, TYERR_IMPURE_FUNCTION) << tc.input;
+    EXPECT_EQ(err->location.pos, tc.pos) << tc.input;
+    EXPECT_STREQ(err->message, tc.message) << tc.input;
+  }
+}
+
+TEST(PurityTestSuite, Test_Unannotated_Functions)
+{
+  SETUP_PURITY_TEST_CASE(
+    "var sq = func(x) { return x * x; };"
+    "var say = func(x) { println(x); };"
+    "var f = func(x) { return sq(x) + 1; };"
+  );
+  DEFER({
+      program_free((Program*) &p);
+      resolver_free((Resolver*) &resolver);
+  });
+
+  // NOTE(HS): impure functions are only errors when they're annotated
+  ASSERT_EQ(p.errors.len, 0);
+
+  char *reason = NULL;
+  EXPECT_TRUE(purity_is_pure(&p, nth_declared_function(&p, 0), &reason));
+  EXPECT_EQ(reason, nullptr);
+  EXPECT_TRUE(purity_is_pure(&p, nth_declared_function(&p, 2), &reason));
+
+  EXPECT_FALSE(purity_is_pure(&p, nth_declared_function(&p, 1), &reason));
+  ASSERT_NE(reason, nullptr);
+  EXPECT_STREQ(reason, "calls the builtin `println`, which has side effects");
+  tyger_free(reason);
+}
+
+TEST(PurityTestSuite, Test_Globals_Of_Earlier_Programs_Untrusted)
+{
+  Resolver resolver;
+  resolver_init(&resolver);
+  // NOTE(HS): `DEFER` copies what it refers to, the resolver's global index isn't
+  // allocated until its first global is declared
+  Resolver *resolver_ref = &resolver;
+  DEFER({ resolver_free(resolver_ref); });
+
+  std::vector<std::pair<const char *, std::size_t>> inputs{
+    { "var k = 2;", 0 },
+    { "var f = @memo func(x) { return x * k; };", 1 },
+  };
+  for (auto& input : inputs)
+  {
+    Lexer lexer;
+    Parser parser;
+    lexer_init(&lexer, input.first);
+    parser_init(&parser, &lexer);
+    Program p = parser_parse_program(&parser);
+    resolver_resolve_program(&resolver, &p);
+
+    ASSERT_EQ(p.errors.len, input.second) << input.first;
+    if (p.errors.len > 0)
+    {
+      EXPECT_STREQ(
+        p.errors.elems[0].message,
+        "`@memo` function is not pure, it reads the global `k` declared by an earlier program"
+      );
+    }
+    program_free(&p);
+  }
+}
+
+TEST(PurityTestSuite, Test_Memo_Annotates_Function_Literals)
+{
+  std::vector<const char *> test_cases{ "@memo 1;", "@pure func(x) { return x; };", "@ func() {};" };
+  for (auto input : test_cases)
+  {
+    SETUP_PARSER_TEST_CASE(input);
+    DEFER({ program_free((Program*) &p); });
+    EXPECT_GT(p.errors.len, 0) << input;
+  }
+}
@@ -0,0 +1,356 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "../tests/parser_test_helper.hpp"
+
+#define SETUP_RESOLVER_TEST_CASE(INPUT)              \
+  SETUP_PARSER_TEST_CASE(INPUT);                     \
+  Resolver resolver;                                 \
+  do {                                               \
+    resolver_init(&resolver);                        \
+    resolver_resolve_program(&resolver, &p);         \
+  } while (0)
+
+/// returns the ident expression of the `index`th top-level expression statement
+static const Expression *nth_statement_expression(const Program *p, std::size_t index)
+{
+  const Statement *stmt = &(p->statements.elems[index]);
+  return expression_handle_to_expression(
+    p, stmt->statement.expression_statement.expression_handle
+  );
+}
+
+TEST(ResolverTestSuite, Test_Global_Slots)
+{
+  SETUP_RESOLVER_TEST_CASE("var x = 1; var y = 2; x; y;");
+  DEFER({
+      program_free((Program*) &p);
+      resolver_free((Resolver*) &resolver);
+  });
+
+  ENUMERATE_PARSER_ERRORS(p);
+  ASSERT_EQ(p.statements.len, 4);
+  ASSERT_EQ(resolver_global_count(&resolver), 2);
+  EXPECT_STREQ(resolver_global_name(&resolver, 0), "x");
+  EXPECT_STREQ(resolver_global_name(&resolver, 1), "y");
+
+  const Var_Statement *x_decl = &(p.statements.elems[0].statement.var_statement);
+  const Var_Statement *y_decl = &(p.statements.elems[1].statement.var_statement);
+  EXPECT_EQ(x_decl->binding.kind, BINDING_GLOBAL);
+  EXPECT_EQ(x_decl->binding.slot, 0);
+  EXPECT_EQ(y_decl->binding.kind, BINDING_GLOBAL);
+  EXPECT_EQ(y_decl->binding.slot, 1);
+
+  const Expression *x = nth_statement_expression(&p, 2);
+  const Expression *y = nth_statement_expression(&p, 3);
+  ASSERT_EQ(x->kind, EXPR_IDENT);
+  ASSERT_EQ(y->kind, EXPR_IDENT);
+
+  const Binding *xb = &(x->expression.ident_expression.binding);
+  const Binding *yb = &(y->expression.ident_expression.binding);
+  EXPECT_EQ(xb->kind, BINDING_GLOBAL);
+  EXPECT_EQ(xb->slot, 0);
+  EXPECT_EQ(xb->declaration, x_decl->ident_handle);
+  EXPECT_EQ(yb->kind, BINDING_GLOBAL);
+  EXPECT_EQ(yb->slot, 1);
+  EXPECT_EQ(yb->declaration, y_decl->ident_handle);
+}
+
+TEST(ResolverTestSuite, Test_Global_Redeclaration_Reuses_Slot)
+{
+  SETUP_RESOLVER_TEST_CASE("var x = 1; var x = x + 1; x;");
+  DEFER({
+      program_free((Program*) &p);
+      resolver_free((Resolver*) &resolver);
+  });
+
+  ENUMERATE_PARSER_ERRORS(p);
+  ASSERT_EQ(resolver_global_count(&resolver), 1);
+
+  const Var_Statement *first = &(p.statements.elems[0].statement.var_statement);
+  const Var_Statement *second = &(p.statements.elems[1].statement.var_statement);
+  EXPECT_EQ(second->binding.slot, first->binding.slot);
+
+  // NOTE(HS): the `x` in the initialiser of the second declaration refers to the first
+  const Expression *init = expression_handle_to_expression(&p, second->expression_handle);
+  ASSERT_EQ(init->kind, EXPR_INFIX);
+  const Expression *lhs = expression_handle_to_expression(&p, init->expression.infix_expression.lhs);
+  EXPECT_EQ(lhs->expression.ident_expression.binding.declaration, first->ident_handle);
+
+  const Expression *x = nth_statement_expression(&p, 2);
+  EXPECT_EQ(x->expression.ident_expression.binding.declaration, second->ident_handle);
+}
+
+TEST(ResolverTestSuite, Test_Block_Locals)
+{
+  struct Local_Test
+  {
+    const char *input;
+    std::size_t slot;
+  };
+
+  // NOTE(HS): the final statement of the (last) block is always the ident under test
+  std::vector<Local_Test> test_cases{
+    { "{ var a = 1; a; }", 0 },
+    { "{ var a = 1; var b = 2; b; }", 1 },
+    { "{ var a = 1; { var b = 2; a; } }", 0 },
+    { "{ var a = 1; { var a = 2; a; } }", 1 },
+    { "{ var a = 1; } { var b = 2; b; }", 0 },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    SETUP_RESOLVER_TEST_CASE(tc.input);
+    const char *prog_str = program_to_string((Program*) &p, TRACE_YAML);
+    DEFER({
+        tyger_free((void*) prog_str);
+        program_free((Program*) &p);
+        resolver_free((Resolver*) &resolver);
+    });
+
+    ENUMERATE_PARSER_ERRORS(p);
+    EXPECT_EQ(resolver_global_count(&resolver), 0) << prog_str;
+
+    const Statement *block = &(p.statements.elems[p.statements.len - 1]);
+    while (true)
+    {
+      ASSERT_EQ(block->kind, STMT_BLOCK) << prog_str;
+      const Block_Statement *bs = &(block->statement.block_statement);
+      const Statement *last = statement_handle_to_statement(&p, bs->first + bs->len - 1);
+      if (last->kind != STMT_BLOCK)
+      {
+        block = last;
+        break;
+      }
+      block = last;
+    }
+
+    ASSERT_EQ(block->kind, STMT_EXPRESSION) << prog_str;
+    const Expression *expr = expression_handle_to_expression(
+      &p, block->statement.expression_statement.expression_handle
+    );
+    ASSERT_EQ(expr->kind, EXPR_IDENT) << prog_str;
+
+    const Binding *binding = &(expr->expression.ident_expression.binding);
+    EXPECT_EQ(binding->kind, BINDING_LOCAL) << prog_str;
+    EXPECT_EQ(binding->depth, 0) << prog_str;
+    EXPECT_EQ(binding->slot, tc.slot) << prog_str;
+  }
+}
+
+TEST(ResolverTestSuite, Test_Upvalues)
+{
+  SETUP_RESOLVER_TEST_CASE(
+    "var f = func(a) { var b = 1; return func() { return func() { return a + b; }; }; };"
+    "{ var c = 1; var g = func() { return c; }; }"
+  );
+  DEFER({
+      program_free((Program*) &p);
+      resolver_free((Resolver*) &resolver);
+  });
+
+  ENUMERATE_PARSER_ERRORS(p);
+
+  // NOTE(HS): the innermost literal captures `a` and `b` through the middle one,
+  // which captures them from `f`'s frame
+  std::vector<std::string> captures;
+  for (std::size_t i = 0; i < p.context.expressions.len; ++i)
+  {
+    const Expression *expr = &(p.context.expressions.elems[i]);
+    if (expr->kind != EXPR_FUNC)
+    {
+      continue;
+    }
+
+    std::string desc;
+    const Func_Expression *fexpr = &(expr->expression.func_expression);
+    for (std::size_t j = 0; j < fexpr->upvalues_len; ++j)
+    {
+      Func_Upvalue upvalue = func_expression_upvalue(&p, fexpr, j);
+      desc += (upvalue.is_local ? "L" : "U") + std::to_string(upvalue.index) + " ";
+    }
+    captures.push_back(desc);
+  }
+  std::sort(captures.begin(), captures.end());
+  EXPECT_EQ(captures, (std::vector<std::string>{ "", "L0 ", "L0 L1 ", "U0 U1 " }));
+
+  const Statement *block = &(p.statements.elems[1]);
+  ASSERT_EQ(block->kind, STMT_BLOCK);
+  EXPECT_TRUE(block->statement.block_statement.captures);
+
+  const Statement *g_decl = statement_handle_to_statement(&p, block->statement.block_statement.first + 1);
+  const Expression *g = expression_handle_to_expression(&p, g_decl->statement.var_statement.expression_handle);
+  const Statement *g_body = statement_handle_to_statement(&p, g->expression.func_expression.body);
+  const Statement *ret = statement_handle_to_statement(&p, g_body->statement.block_statement.first);
+  const Expression *c = expression_handle_to_expression(&p, ret->statement.return_statement.expression_handle);
+  ASSERT_EQ(c->kind, EXPR_IDENT);
+  EXPECT_EQ(c->expression.ident_expression.binding.kind, BINDING_UPVALUE);
+  EXPECT_EQ(c->expression.ident_expression.binding.depth, 1);
+  EXPECT_EQ(c->expression.ident_expression.binding.slot, 0);
+  EXPECT_FALSE(g_body->statement.block_statement.captures);
+}
+
+TEST(ResolverTestSuite, Test_Builtins)
+{
+  SETUP_RESOLVER_TEST_CASE("println(1);");
+  DEFER({
+      program_free((Program*) &p);
+      resolver_free((Resolver*) &resolver);
+  });
+
+  ENUMERATE_PARSER_ERRORS(p);
+
+  const Expression *call = nth_statement_expression(&p, 0);
+  ASSERT_EQ(call->kind, EXPR_CALL);
+  const Expression *function = expression_handle_to_expression(
+    &p, call->expression.call_expression.function
+  );
+  EXPECT_EQ(function->expression.ident_expression.binding.kind, BINDING_BUILTIN);
+}
+
+TEST(ResolverTestSuite, Test_Resolver_Errors)
+{
+  struct Error_Test
+  {
+    const char *input;
+    Tyger_Error_Kind kind;
+    std::size_t pos;
+  };
+
+  std::vector<Error_Test> test_cases{
+    { "x;", TYERR_UNDEFINED_IDENT, 0 },
+    { "var x = 1; x + y;", TYERR_UNDEFINED_IDENT, 15 },
+    { "var x = x;", TYERR_UNDEFINED_IDENT, 8 },
+    { "{ var a = 1; } a;", TYERR_UNDEFINED_IDENT, 15 },
+    { "println(foo);", TYERR_UNDEFINED_IDENT, 8 },
+    { "{ var a = 1; var a = 2; }", TYERR_REDECLARED_IDENT, 13 },
+    { "return 1;", TYERR_INVALID_RETURN, 0 },
+    { "const c = 1; c = 2;", TYERR_INVALID_ASSIGNMENT, 13 },
+    { "const c = 1; var c = 2;", TYERR_REDECLARED_IDENT, 13 },
+    { "{ const c = 1; c = 2; }", TYERR_INVALID_ASSIGNMENT, 15 },
+    { "var f = func(a, a) {};", TYERR_REDECLARED_IDENT, 8 },
+    { "{ const a = 1; var f = func() { a = 2; }; }", TYERR_INVALID_ASSIGNMENT, 32 },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    SETUP_RESOLVER_TEST_CASE(tc.input);
+    DEFER({
+        program_free((Program*) &p);
+        resolver_free((Resolver*) &resolver);
+    });
+
+    ASSERT_EQ(p.errors.len, 1) << tc.input;
+    const Tyger_Error *err = &(p.errors.elems[0]);
+    EXPECT_EQ(err->kind, tc.kind) << tc.input;
+    EXPECT_EQ(err->location.pos, tc.pos) << tc.input;
+    EXPECT_NE(err->message, nullptr) << tc.input;
+
+    // NOTE(HS): programs with errors never run, so none of their globals survive
+    EXPECT_EQ(resolver_global_count(&resolver), 0) << tc.input;
+  }
+}
+
+TEST(ResolverTestSuite, Test_Globals_Persist_Between_Programs)
+{
+  Resolver resolver;
+  resolver_init(&resolver);
+  // NOTE(HS): `DEFER` copies what it refers to, the resolver's global index isn't
+  // allocated until its first global is declared
+  Resolver *resolver_ref = &resolver;
+  DEFER({ resolver_free(resolver_ref); });
+
+  std::vector<const char *> inputs{ "var x = 1;", "var y = x;", "x + y;" };
+  for (auto input : inputs)
+  {
+    Lexer lexer;
+    Parser parser;
+    lexer_init(&lexer, input);
+    parser_init(&parser, &lexer);
+    Program p = parser_parse_program(&parser);
+    resolver_resolve_program(&resolver, &p);
+
+    EXPECT_EQ(p.errors.len, 0) << input;
+    program_free(&p);
+  }
+
+  EXPECT_EQ(resolver_global_count(&resolver), 2);
+}
+
+TEST(ResolverTestSuite, Test_Failed_Programs_Leave_Redeclared_Globals_Alone)
+{
+  Resolver resolver;
+  resolver_init(&resolver);
+  Resolver *resolver_ref = &resolver;
+  DEFER({ resolver_free(resolver_ref); });
+
+  std::vector<std::pair<const char *, size_t>> inputs{
+    { "var x = 1;", 0 },
+    { "const x = 2; println(nope);", 1 },
+    { "x = 3;", 0 },
+  };
+  for (auto input : inputs)
+  {
+    Lexer lexer;
+    Parser parser;
+    lexer_init(&lexer, input.first);
+    parser_init(&parser, &lexer);
+    Program p = parser_parse_program(&parser);
+    resolver_resolve_program(&resolver, &p);
+
+    EXPECT_EQ(p.errors.len, input.second) << input.first;
+    program_free(&p);
+  }
+
+  EXPECT_EQ(resolver_global_count(&resolver), 1);
+}
+
+TEST(ResolverTestSuite, Test_Function_Slots)
+{
+  SETUP_RESOLVER_TEST_CASE("var f = func(a, b) { var c = a; return f(b, c); };");
+  DEFER({
+      program_free((Program*) &p);
+      resolver_free((Resolver*) &resolver);
+  });
+
+  ENUMERATE_PARSER_ERRORS(p);
+  ASSERT_EQ(p.statements.len, 1);
+
+  const Var_Statement *f_decl = &(p.statements.elems[0].statement.var_statement);
+  EXPECT_EQ(f_decl->binding.kind, BINDING_GLOBAL);
+
+  const Expression *func = expression_handle_to_expression(&p, f_decl->expression_handle);
+  ASSERT_EQ(func->kind, EXPR_FUNC);
+  const Func_Expression *fexpr = &(func->expression.func_expression);
+  EXPECT_EQ(fexpr->params_len, 2);
+  EXPECT_EQ(fexpr->name, f_decl->ident_handle);
+
+  const Statement *body = statement_handle_to_statement(&p, fexpr->body);
+  ASSERT_EQ(body->kind, STMT_BLOCK);
+  ASSERT_EQ(body->statement.block_statement.len, 2);
+
+  // NOTE(HS): parameters take the first slots of the frame, locals follow them
+  const Statement *c_stmt = statement_handle_to_statement(&p, body->statement.block_statement.first);
+  const Var_Statement *c_decl = &(c_stmt->statement.var_statement);
+  EXPECT_EQ(c_decl->binding.kind, BINDING_LOCAL);
+  EXPECT_EQ(c_decl->binding.slot, 2);
+
+  const Expression *a = expression_handle_to_expression(&p, c_decl->expression_handle);
+  EXPECT_EQ(a->expression.ident_expression.binding.kind, BINDING_LOCAL);
+  EXPECT_EQ(a->expression.ident_expression.binding.slot, 0);
+  EXPECT_EQ(a->expression.ident_expression.binding.declaration, func_expression_param(&p, fexpr, 0));
+
+  // NOTE(HS): the function was declared before its body was resolved, so it can recurse
+  const Statement *ret = statement_handle_to_statement(&p, body->statement.block_statement.first + 1);
+  const Expression *call = expression_handle_to_expression(&p, ret->statement.return_statement.expression_handle);
+  ASSERT_EQ(call->kind, EXPR_CALL);
+  const Expression *callee = expression_handle_to_expression(&p, call->expression.call_expression.function);
+  EXPECT_EQ(callee->expression.ident_expression.binding.kind, BINDING_GLOBAL);
+  EXPECT_EQ(callee->expression.ident_expression.binding.declaration, f_decl->ident_handle);
+
+  const Expression *b = expression_handle_to_expression(&p, call->expression.call_expression.args_first);
+  EXPECT_EQ(b->expression.ident_expression.binding.slot, 1);
+}
@@ -0,0 +1,288 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include "tyger_test.hpp"
+
+static const char *const HOST_GLOBALS[] = { "base", "scale", "greet" };
+
+static const char *const SCRIPT =
+  "var total = 0;\n"
+  "var i = 0;\n"
+  "while (i < 1000) {\n"
+  "  total = total + scale(i) + base;\n"
+  "  i = i + 1;\n"
+  "}\n"
+  "var message = greet(\"tyger\");\n";
+
+/// `scale(x)`, multiplies by the int `user` points to
+static Tyger_Error host_scale(Tyger_VM *vm, void *user, Value_Span args, Value *result)
+{
+  (void) vm;
+  Tyger_Error ok = {};
+  if (args.elems[0].kind != VAL_INT)
+  {
+    return tyger_host_error(TYERR_TYPE_MISMATCH, "scale expects an int");
+  }
+  *result = make_int_value(args.elems[0].as.integer * *(const int64_t*) user);
+  return ok;
+}
+
+/// `greet(name)`, returns "hello, <name>"
+static Tyger_Error host_greet(Tyger_VM *vm, void *user, Value_Span args, Value *result)
+{
+  (void) user;
+  Tyger_Error ok = {};
+  String_View name = value_string_view(&args.elems[0]);
+  std::string greeting = "hello, " + std::string(name.str, name.len);
+  *result = tyger_vm_string(vm, greeting.c_str(), greeting.size());
+  return ok;
+}
+
+static Tyger_Program compile_script(const char *source)
+{
+  Tyger_Compile_Options options = tyger_compile_default_options();
+  options.host_globals = HOST_GLOBALS;
+  options.host_globals_len = sizeof(HOST_GLOBALS) / sizeof(HOST_GLOBALS[0]);
+
+  Tyger_Program program;
+  Tyger_Error err = tyger_program_compile(&program, source, options);
+  EXPECT_EQ(err.kind, TYERR_NONE) << (err.message ? err.message : "");
+  tyger_error_free(&err);
+  return program;
+}
+
+static size_t count_objects(const Obj *objects)
+{
+  size_t count = 0;
+  for (const Obj *obj = objects; obj; obj = obj->next)
+  {
+    count += 1;
+  }
+  return count;
+}
+
+static int64_t global_int(const Tyger_VM *vm, const char *name)
+{
+  Value value;
+  EXPECT_TRUE(tyger_vm_get_global(vm, name, &value));
+  EXPECT_EQ(value.kind, VAL_INT);
+  return value.as.integer;
+}
+
+static std::string global_string(const Tyger_VM *vm, const char *name)
+{
+  Value value;
+  EXPECT_TRUE(tyger_vm_get_global(vm, name, &value));
+  EXPECT_TRUE(value_is_string(value));
+  String_View sv = value_string_view(&value);
+  return std::string(sv.str, sv.len);
+}
+
+TEST(TygerTestSuite, Test_Program_Runs_With_Host_Globals_And_Functions)
+{
+  Tyger_Program program = compile_script(SCRIPT);
+  EXPECT_EQ(program.host_globals_len, 3);
+
+  int64_t factor = 3;
+  Tyger_VM *vm = tyger_vm_create(tyger_vm_default_options());
+  tyger_vm_register(vm, "scale", 1, host_scale, &factor);
+  tyger_vm_register(vm, "greet", 1, host_greet, nullptr);
+
+  for (int64_t base : { 10, 20 })
+  {
+    Tyger_Global globals[] = { { "base", make_int_value(base) } };
+    Tyger_Error err = tyger_vm_run(vm, &program, globals, 1);
+    EXPECT_EQ(err.kind, TYERR_NONE) << (err.message ? err.message : "");
+    tyger_error_free(&err);
+
+    EXPECT_EQ(global_int(vm, "total"), 3 * 499500 + 1000 * base);
+    EXPECT_EQ(global_string(vm, "message"), "hello, tyger");
+  }
+
+  // NOTE(HS): registering again replaces the function from the next run, reusing it
+  size_t objects = count_objects(vm->objects);
+  int64_t other_factor = 1;
+  tyger_vm_register(vm, "scale", 1, host_scale, &other_factor);
+  EXPECT_EQ(count_objects(vm->objects), objects);
+  Tyger_Global globals[] = { { "base", make_int_value(0) } };
+  Tyger_Error err = tyger_vm_run(vm, &program, globals, 1);
+  EXPECT_EQ(err.kind, TYERR_NONE);
+  EXPECT_EQ(global_int(vm, "total"), 499500);
+
+  Value value;
+  EXPECT_FALSE(tyger_vm_get_global(vm, "missing", &value));
+
+  tyger_vm_destroy(vm);
+  tyger_program_free(&program);
+}
+
+TEST(TygerTestSuite, Test_Programs_Compiled_Into_Freed_Storage_Are_Their_Own)
+{
+  int64_t factor = 2;
+  Tyger_VM *vm = tyger_vm_create(tyger_vm_default_options());
+  tyger_vm_register(vm, "scale", 1, host_scale, &factor);
+  tyger_vm_register(vm, "greet", 1, host_greet, nullptr);
+  Tyger_Global globals[] = { { "base", make_int_value(0) } };
+
+  Tyger_Program program = compile_script(SCRIPT);
+  Tyger_Error err = tyger_vm_run(vm, &program, globals, 1);
+  EXPECT_EQ(err.kind, TYERR_NONE);
+  EXPECT_EQ(global_int(vm, "total"), 2 * 499500);
+  uint64_t id = program.id;
+  tyger_program_free(&program);
+
+  // NOTE(HS): without forgetting the first, the instance keeps its copy
+  program = compile_script("var add = func(a, b) { return a + b; };\nvar total = add(scale(20), 1);\n");
+  EXPECT_NE(program.id, id);
+  err = tyger_vm_run(vm, &program, globals, 1);
+  EXPECT_EQ(err.kind, TYERR_NONE) << (err.message ? err.message : "");
+  tyger_error_free(&err);
+  EXPECT_EQ(global_int(vm, "total"), 41);
+  EXPECT_EQ(vm->chunks.len, 2);
+
+  Value value;
+  tyger_vm_forget_program(vm, &program);
+  EXPECT_EQ(vm->chunks.len, 1);
+  EXPECT_FALSE(tyger_vm_get_global(vm, "total", &value));
+  tyger_program_free(&program);
+
+  program = compile_script("var total = scale(base);\n");
+  for (int64_t run = 0; run < 3; ++run)
+  {
+    globals[0].value = make_int_value(run);
+    err = tyger_vm_run(vm, &program, globals, 1);
+    EXPECT_EQ(err.kind, TYERR_NONE);
+    EXPECT_EQ(global_int(vm, "total"), 2 * run);
+  }
+  EXPECT_EQ(vm->chunks.len, 2);
+  tyger_vm_forget_program(vm, &program);
+  tyger_program_free(&program);
+
+  tyger_vm_destroy(vm);
+}
+
+TEST(TygerTestSuite, Test_Errors_Are_Located)
+{
+  Tyger_Compile_Options options = tyger_compile_default_options();
+  Tyger_Program program;
+  Tyger_Error err = tyger_program_compile(&program, "var a = 1;\nvar b = a + ;\n", options);
+  EXPECT_EQ(err.kind, TYERR_SYNTAX);
+  EXPECT_EQ(err.location.line, 1);
+  EXPECT_EQ(program.source, nullptr);
+  tyger_error_free(&err);
+
+  err = tyger_program_compile(&program, "var a = base;\n", options);
+  EXPECT_EQ(err.kind, TYERR_UNDEFINED_IDENT);
+  tyger_error_free(&err);
+
+  // NOTE(HS): a host function's error is located at its call
+  program = compile_script("var a = 1;\nvar b = scale(\"x\");\n");
+  int64_t factor = 2;
+  Tyger_VM *vm = tyger_vm_create(tyger_vm_default_options());
+  tyger_vm_register(vm, "scale", 1, host_scale, &factor);
+  tyger_vm_register(vm, "greet", 1, host_greet, nullptr);
+  Tyger_Global globals[] = { { "base", make_int_value(0) } };
+
+  err = tyger_vm_run(vm, &program, globals, 1);
+  EXPECT_EQ(err.kind, TYERR_TYPE_MISMATCH);
+  EXPECT_STREQ(err.message, "scale expects an int");
+  EXPECT_EQ(err.location.line, 1);
+  EXPECT_EQ(err.location.col, 8);
+  tyger_error_free(&err);
+
+  err = tyger_vm_run(vm, &program, nullptr, 0);
+  EXPECT_EQ(err.kind, TYERR_UNDEFINED_IDENT);
+  EXPECT_STREQ(err.message, "host global `base` was not provided");
+  tyger_error_free(&err);
+
+  tyger_vm_destroy(vm);
+  tyger_program_free(&program);
+}
+
+TEST(TygerTestSuite, Test_Instances_Write_Their_Own_Output)
+{
+  FILE *f = std::tmpfile();
+  Tyger_VM_Options options = tyger_vm_default_options();
+  options.output_fd = fileno(f);
+
+  Tyger_Program program = compile_script("println(greet(\"world\"), base);\n");
+  Tyger_VM *vm = tyger_vm_create(options);
+  tyger_vm_register(vm, "greet", 1, host_greet, nullptr);
+  Tyger_Global globals[] = { { "base", make_int_value(7) }, { "scale", make_nil_value() } };
+  Tyger_Error err = tyger_vm_run(vm, &program, globals, 2);
+  EXPECT_EQ(err.kind, TYERR_NONE);
+  tyger_vm_destroy(vm);
+
+  std::rewind(f);
+  char line[64] = {};
+  ASSERT_NE(std::fgets(line, sizeof(line), f), nullptr);
+  EXPECT_STREQ(line, "hello, world 7\n");
+  std::fclose(f);
+  tyger_program_free(&program);
+}
+
+TEST(TygerTestSuite, Test_Concurrent_Instances_Share_A_Program)
+{
+  Tyger_Compile_Options options = tyger_compile_default_options();
+  options.host_globals = HOST_GLOBALS;
+  options.host_globals_len = sizeof(HOST_GLOBALS) / sizeof(HOST_GLOBALS[0]);
+  options.optimise = true;
+  Tyger_Program program;
+  Tyger_Error err = tyger_program_compile(&program, SCRIPT, options);
+  ASSERT_EQ(err.kind, TYERR_NONE);
+
+  std::vector<uint8_t> code(program.chunk.code.elems, program.chunk.code.elems + program.chunk.code.len);
+
+  const size_t threads_len = 4;
+  const size_t runs = 25;
+  std::vector<size_t> correct(threads_len, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threads_len; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      int64_t factor = (int64_t) t + 1;
+      Tyger_VM_Options vm_options = tyger_vm_default_options();
+      vm_options.gc.initial_threshold = 1024;
+      Tyger_VM *vm = tyger_vm_create(vm_options);
+      tyger_vm_register(vm, "scale", 1, host_scale, &factor);
+      tyger_vm_register(vm, "greet", 1, host_greet, nullptr);
+
+      for (size_t run = 0; run < runs; ++run)
+      {
+        int64_t base = (int64_t) (t * 100 + run);
+        Tyger_Global globals[] = { { "base", make_int_value(base) } };
+        Tyger_Error run_err = tyger_vm_run(vm, &program, globals, 1);
+        Value total;
+        if (run_err.kind == TYERR_NONE && tyger_vm_get_global(vm, "total", &total)
+            && total.as.integer == factor * 499500 + 1000 * base)
+        {
+          correct[t] += 1;
+        }
+        tyger_error_free(&run_err);
+      }
+      tyger_vm_destroy(vm);
+    });
+  }
+  for (std::thread &thread : threads)
+  {
+    thread.join();
+  }
+
+  for (size_t t = 0; t < threads_len; ++t)
+  {
+    EXPECT_EQ(correct[t], runs) << "thread " << t;
+  }
+
+  // NOTE(HS): quickening and caching happened in each instance's copy
+  ASSERT_EQ(program.chunk.code.len, code.size());
+  EXPECT_EQ(std::memcmp(program.chunk.code.elems, code.data(), code.size()), 0);
+  for (size_t i = 0; i < program.chunk.call_caches.len; ++i)
+  {
+    EXPECT_EQ(program.chunk.call_caches.elems[i].len, 0);
+  }
+  EXPECT_EQ(program.chunk.jit, nullptr);
+  tyger_program_free(&program);
+}
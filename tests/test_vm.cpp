@@ -0,0 +1,1201 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+#include "../tests/vm_test_helper.hpp"
+
+static std::vector<Opcode> chunk_opcodes(const Chunk *chunk)
+{
+  std::vector<Opcode> ops{};
+  for (std::size_t offset = 0; offset < chunk->code.len; )
+  {
+    Opcode op = (Opcode) chunk->code.elems[offset];
+    ops.push_back(op);
+    offset += opcode_length(op);
+  }
+  return ops;
+}
+
+static bool chunk_contains(const Chunk *chunk, Opcode op)
+{
+  for (Opcode o : chunk_opcodes(chunk))
+  {
+    if (o == op)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST(VMTestSuite, Test_Program_Output)
+{
+  struct Output_Test
+  {
+    const char *input;
+    const char *output;
+  };
+
+  std::vector<Output_Test> test_cases{
+    { "println(1 + 2 * 3);", "7\n" },
+    { "println((1 + 2) * 3, 7 / 2, 7 - 10);", "9 3 -3\n" },
+    { "println(\"Hello\" + \", \" + \"World\");", "Hello, World\n" },
+    { "println(1 < 2, 2 <= 2, 3 > 4, 3 >= 4, 1 == 1, 1 != 1);", "true true false false true false\n" },
+    { "println(\"a\" == \"a\", \"a\" != \"b\", 1 == \"1\");", "true true false\n" },
+    { "println(-5, !true, !0, -(-3));", "-5 false false 3\n" },
+    { "println();", "\n" },
+    { "var x = 10; x = x * 2; println(x);", "20\n" },
+    { "var x = 1; if (x == 1) { println(\"one\"); } else { println(\"other\"); }", "one\n" },
+    { "var x = 2; if (x == 1) { println(\"one\"); } else if (x == 2) { println(\"two\"); }", "two\n" },
+    { "var i = 0; var sum = 0; while (i < 10) { sum = sum + i; i = i + 1; } println(sum);", "45\n" },
+    { "{ var a = 1; { var b = a + 1; a = b * 10; } println(a); }", "20\n" },
+    { "var s = \"\"; var i = 0; while (i < 3) { s = s + \"ab\"; i = i + 1; } println(s);", "ababab\n" },
+    { "println(\"tab\\there\");", "tab\there\n" },
+    { "var add = func(a, b) { return a + b; }; println(add(1, 2));", "3\n" },
+    { "var fib = func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }; println(fib(15));", "610\n" },
+    { "var f = func() {}; println(f(), f);", "nil <func f>\n" },
+    { "println(func(x) { return x * 2; }(21));", "42\n" },
+    { "var apply = func(f, x) { return f(x); }; println(apply(func(x) { return x + 1; }, 1));", "2\n" },
+    { "var f = func(n) { { var a = n + 1; { var b = a * 2; return b; } } }; println(f(1), f(2));", "4 6\n" },
+    { "var f = func(n) { var i = 0; while (true) { if (i == n) { return i; } i = i + 1; } }; println(f(5));", "5\n" },
+    { "{ var g = func(x) { return x - 1; }; println(g(1)); }", "0\n" },
+    { "print(1, 2); print(\"a\"); println();", "1 2a\n" },
+    { "println(len(\"hello\"), len(\"\"), len(\"a\\tb\"));", "5 0 3\n" },
+    { "println(type(1), type(\"s\"), type(true), type(print()), type(func() {}));", "int string bool nil func\n" },
+    { "var len = func(x) { return 42; }; println(len(\"abc\"));", "42\n" },
+    { "println(9223372036854775807 + 1, -9223372036854775807 - 2);", "9223372036854775808 -9223372036854775809\n" },
+    { "println(-9223372036854775808, type(-9223372036854775808), -(-9223372036854775808));", "-9223372036854775808 int 9223372036854775808\n" },
+    { "var f = 1; var i = 1; while (i <= 30) { f = f * i; i = i + 1; } println(f, f / 1307674368000);", "265252859812191058636308480000000 202843204931727360000\n" },
+    { "var big = 100000000000000000000; println(big - big + 1, big > 1, big == big * 1, type(big));", "1 true true int\n" },
+    { "var mk = func() { var n = 0; return func() { n = n + 1; return n; }; }; var a = mk(); var b = mk(); println(a(), a(), b(), type(a));", "1 2 1 func\n" },
+    { "var add = func(x) { return func(y) { return func(z) { return x + y + z; }; }; }; println(add(1)(2)(3));", "6\n" },
+    { "{ var fib = func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }; println(fib(15)); }", "610\n" },
+    { "var f = func() { var x = 1; var get = func() { return x; }; var set = func(v) { x = v; }; set(5); return get() + x; }; println(f());", "10\n" },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    VM_Run run = run_source(tc.input);
+    DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+    EXPECT_EQ(run.err.kind, TYERR_NONE) << tc.input;
+    EXPECT_EQ(run.output, std::string{tc.output}) << tc.input;
+  }
+}
+
+TEST(VMTestSuite, Test_Runtime_Errors)
+{
+  struct Error_Test
+  {
+    const char *input;
+    Tyger_Error_Kind kind;
+    std::size_t pos;
+  };
+
+  std::vector<Error_Test> test_cases{
+    { "println(1 / 0);", TYERR_DIVIDE_BY_ZERO, 10 },
+    { "var x = 1 + \"a\";", TYERR_TYPE_MISMATCH, 10 },
+    { "var x = \"a\" < \"b\";", TYERR_TYPE_MISMATCH, 12 },
+    { "-\"a\";", TYERR_TYPE_MISMATCH, 0 },
+    { "var x = 1; x();", TYERR_NOT_CALLABLE, 11 },
+    { "var f = func(a) {}; f();", TYERR_ARITY_MISMATCH, 20 },
+    { "var f = func(a) {}; var g = f; g(1, 2);", TYERR_ARITY_MISMATCH, 31 },
+    { "var f = func(n) { return 1 + f(n + 1); }; f(0);", TYERR_STACK_OVERFLOW, 29 },
+    { "println(len(1));", TYERR_TYPE_MISMATCH, 8 },
+    { "println(99999999999999999999 / 0);", TYERR_DIVIDE_BY_ZERO, 29 },
+    { "println(99999999999999999999 + \"a\");", TYERR_TYPE_MISMATCH, 29 },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    VM_Run run = run_source(tc.input);
+    DEFER({
+        chunk_free((Chunk*) &run.chunk);
+        tyger_error_free((Tyger_Error*) &run.err);
+    });
+
+    EXPECT_EQ(run.err.kind, tc.kind) << tc.input;
+    EXPECT_EQ(run.err.location.pos, tc.pos) << tc.input;
+  }
+}
+
+TEST(VMTestSuite, Test_Runtime_Errors_Are_Located_In_Their_Functions_Source)
+{
+  // NOTE(HS): as REPL lines are, each run with the same globals
+  const char *sources[] = {
+    "var d = func(x) { return 10 / x; };",
+    "println(d(0));",
+  };
+
+  Resolver resolver;
+  resolver_init(&resolver);
+  VM vm;
+  vm_init(&vm);
+  FILE *out = std::tmpfile();
+  vm_set_output(&vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  Chunk chunks[2];
+  Tyger_Error err{};
+  for (std::size_t i = 0; i < 2; ++i)
+  {
+    SETUP_PARSER_TEST_CASE(sources[i]);
+    EXPECT_PROGRAM_PARSED_SUCCESS(p);
+    resolver_resolve_program(&resolver, &p);
+
+    Compiler_Options options = compiler_default_options();
+    options.source = sources[i];
+    chunk_init(&chunks[i]);
+    err = compiler_compile_program(&p, &chunks[i], options);
+    EXPECT_EQ(err.kind, TYERR_NONE);
+    EXPECT_EQ(chunks[i].source, sources[i]);
+    err = vm_run(&vm, &chunks[i]);
+    program_free(&p);
+  }
+
+  EXPECT_EQ(err.kind, TYERR_DIVIDE_BY_ZERO);
+  EXPECT_EQ(err.source, sources[0]);
+  Location location = location_from_pos(err.source, err.location.pos);
+  EXPECT_EQ(location.line, 0);
+  EXPECT_EQ(location.col, 28);
+  tyger_error_free(&err);
+
+  vm_free(&vm);
+  chunk_free(&chunks[0]);
+  chunk_free(&chunks[1]);
+  resolver_free(&resolver);
+  std::fclose(out);
+}
+
+TEST(VMTestSuite, Test_Quickening_Int_Loop)
+{
+  const char *input = "var i = 0; while (i < 100) { i = i + 1; } println(i);";
+  VM_Run run = run_source(input, true, 1, false);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  EXPECT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "100\n");
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_LT_INT_INT));
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_ADD_INT_INT));
+  EXPECT_FALSE(chunk_contains(&run.chunk, OPC_LT));
+  EXPECT_FALSE(chunk_contains(&run.chunk, OPC_ADD));
+}
+
+TEST(VMTestSuite, Test_Quickening_Strings)
+{
+  const char *input = "var s = \"\"; var i = 0; while (i < 4) { s = s + \"x\"; i = i + 1; } println(s);";
+  VM_Run run = run_source(input, true, 1, false);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  EXPECT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "xxxx\n");
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_CONCAT_STR_STR));
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_ADD_INT_INT));
+}
+
+TEST(VMTestSuite, Test_Quickening_Guard_Fallback)
+{
+  // NOTE(HS): the `+` in the loop quickens to ADD_INT_INT on the first iterations, then
+  // `x` becomes a string and the guard has to fall back to the generic instruction
+  const char *input =
+    "var x = 0; var i = 0;"
+    "while (i < 6) { if (i == 3) { x = \"s\"; } x = x + x; i = i + 1; }"
+    "println(x);";
+  VM_Run run = run_source(input, true, 1, false);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  EXPECT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "ssssssss\n");
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_CONCAT_STR_STR));
+}
+
+TEST(VMTestSuite, Test_Quickened_Chunk_Reruns)
+{
+  // NOTE(HS): quickened code must still be correct when the chunk runs a second time
+  // with different operand types reaching the same instruction
+  const char *input = "var i = 0; while (i < 3) { i = i + 1; } println(i + 1, \"a\" + \"b\");";
+  VM_Run run = run_source(input, true, 2);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  EXPECT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "4 ab\n");
+}
+
+TEST(VMTestSuite, Test_Quickening_Disabled)
+{
+  const char *input = "var i = 0; var s = \"\"; while (i < 10) { i = i + 1; s = s + \"a\"; } println(i, s);";
+  VM_Run quick = run_source(input, true, 1, false);
+  VM_Run generic = run_source(input, false, 1, false);
+  DEFER({
+      chunk_free((Chunk*) &quick.chunk);
+      chunk_free((Chunk*) &generic.chunk);
+  });
+
+  EXPECT_EQ(quick.err.kind, TYERR_NONE);
+  EXPECT_EQ(generic.err.kind, TYERR_NONE);
+  EXPECT_EQ(quick.output, generic.output);
+
+  for (Opcode op : chunk_opcodes(&generic.chunk))
+  {
+    EXPECT_NE(op, OPC_ADD_INT_INT);
+    EXPECT_NE(op, OPC_LT_INT_INT);
+    EXPECT_NE(op, OPC_CONCAT_STR_STR);
+  }
+}
+
+/// writes the components of `s` into `chunk`, every operand being 0
+static void write_superinstruction_components(Chunk *chunk, const Superinstruction *s)
+{
+  for (std::size_t i = 0; i < s->len; ++i)
+  {
+    chunk_write(chunk, (uint8_t) s->components[i], i);
+    for (std::size_t j = 0; j < opcode_operand_count(s->components[i]); ++j)
+    {
+      chunk_write_operand(chunk, 0, i);
+    }
+  }
+}
+
+TEST(VMTestSuite, Test_Superinstruction_Fusion)
+{
+  std::size_t count = 0;
+  const Superinstruction *table = superinstruction_table(&count);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const Superinstruction *s = &table[i];
+    Chunk chunk;
+    chunk_init(&chunk);
+    DEFER({ chunk_free((Chunk*) &chunk); });
+
+    write_superinstruction_components(&chunk, s);
+    chunk_write(&chunk, OPC_RETURN, 0);
+    std::vector<uint8_t> before(chunk.code.elems, chunk.code.elems + chunk.code.len);
+
+    superinstructions_fuse(&chunk);
+    EXPECT_TRUE(opcode_is_superinstruction((Opcode) chunk.code.elems[0]));
+    ASSERT_EQ(superinstruction_lookup((Opcode) chunk.code.elems[0]), s) << opcode_to_string(s->op);
+    EXPECT_EQ(opcode_generic_form(s->op), s->components[0]);
+
+    // NOTE(HS): only the first opcode byte is rewritten
+    for (std::size_t j = 1; j < before.size(); ++j)
+    {
+      EXPECT_EQ(chunk.code.elems[j], before[j]) << opcode_to_string(s->op);
+    }
+  }
+}
+
+TEST(VMTestSuite, Test_Superinstruction_Not_Fused_Across_Jump_Target)
+{
+  std::size_t count = 0;
+  const Superinstruction *table = superinstruction_table(&count);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const Superinstruction *s = &table[i];
+    Chunk chunk;
+    chunk_init(&chunk);
+    DEFER({ chunk_free((Chunk*) &chunk); });
+
+    // NOTE(HS): jump over the first component, landing on the second
+    std::size_t first_len = opcode_length(s->components[0]);
+    chunk_write(&chunk, OPC_JUMP, 0);
+    chunk_write_operand(&chunk, (uint16_t) first_len, 0);
+    write_superinstruction_components(&chunk, s);
+    chunk_write(&chunk, OPC_RETURN, 0);
+
+    superinstructions_fuse(&chunk);
+    std::size_t first = opcode_length(OPC_JUMP);
+    EXPECT_EQ(chunk.code.elems[first], (uint8_t) s->components[0]) << opcode_to_string(s->op);
+  }
+}
+
+TEST(VMTestSuite, Test_Superinstructions_Match_Unfused_Output)
+{
+  const char *inputs[] = {
+    "{ var i = 0; var total = 0; while (i < 100) { total = total + i; i = i + 1; } println(total); }",
+    "var i = 0; while (i < 10) { i = i + 1; } println(i);",
+    "{ var n = 27; var steps = 0; while (n != 1) { if (n - (n / 2) * 2 == 0) { n = n / 2; } else { n = 3 * n + 1; } steps = steps + 1; } println(steps); }",
+    "{ var s = \"\"; var i = 0; while (i < 3) { s = s + \"ab\"; i = i + 1; } println(s); }",
+  };
+
+  for (const char *input : inputs)
+  {
+    VM_Run fused = run_source(input, true, 2, true);
+    VM_Run unfused = run_source(input, true, 2, false);
+    DEFER({
+        chunk_free((Chunk*) &fused.chunk);
+        chunk_free((Chunk*) &unfused.chunk);
+    });
+
+    EXPECT_EQ(fused.err.kind, TYERR_NONE) << input;
+    EXPECT_EQ(fused.output, unfused.output) << input;
+    EXPECT_EQ(fused.chunk.code.len, unfused.chunk.code.len) << input;
+  }
+}
+
+TEST(VMTestSuite, Test_Superinstruction_Runtime_Error_Position)
+{
+  // NOTE(HS): the division is a component of a fused sequence, the error should still
+  // point at the `/` rather than the start of the sequence
+  const char *input = "{ var x = 1; var y = x / 0; }";
+  VM_Run fused = run_source(input, true, 1, true);
+  VM_Run unfused = run_source(input, true, 1, false);
+  DEFER({
+      chunk_free((Chunk*) &fused.chunk);
+      chunk_free((Chunk*) &unfused.chunk);
+      tyger_error_free((Tyger_Error*) &fused.err);
+      tyger_error_free((Tyger_Error*) &unfused.err);
+  });
+
+  EXPECT_EQ(fused.err.kind, TYERR_DIVIDE_BY_ZERO);
+  EXPECT_EQ(fused.err.location.pos, unfused.err.location.pos);
+  EXPECT_EQ(fused.err.location.pos, 23);
+}
+
+TEST(VMTestSuite, Test_Opcode_Profile)
+{
+  const char *input = "{ var i = 0; while (i < 10) { i = i + 1; } }";
+  Opcode_Profile profile;
+  opcode_profile_init(&profile);
+  VM_Run run = run_source(input, true, 1, false, &profile);
+  DEFER({
+      chunk_free((Chunk*) &run.chunk);
+      opcode_profile_free((Opcode_Profile*) &profile);
+  });
+
+  struct Profile_Test
+  {
+    std::vector<Opcode> ops;
+    uint64_t count;
+  };
+
+  std::vector<Profile_Test> test_cases{
+    { { OPC_LOAD_LOCAL, OPC_LOAD_CONST }, 21 },
+    { { OPC_LOAD_LOCAL, OPC_LOAD_CONST, OPC_LT }, 11 },
+    { { OPC_LOAD_LOCAL, OPC_LOAD_CONST, OPC_LT, OPC_JUMP_IF_FALSE }, 11 },
+    { { OPC_LOAD_LOCAL, OPC_LOAD_CONST, OPC_ADD, OPC_STORE_LOCAL }, 10 },
+    { { OPC_LOAD_CONST, OPC_LOAD_LOCAL }, 1 },
+    { { OPC_JUMP_IF_FALSE, OPC_LOAD_LOCAL }, 10 },
+    // NOTE(HS): a taken jump isn't an adjacent pair, so these are never counted
+    { { OPC_LOOP, OPC_LOAD_LOCAL }, 0 },
+    { { OPC_JUMP_IF_FALSE, OPC_POPN }, 0 },
+    // NOTE(HS): quickened instructions are counted as their generic form
+    { { OPC_LOAD_CONST, OPC_LT_INT_INT }, 0 },
+  };
+
+  EXPECT_EQ(run.err.kind, TYERR_NONE);
+  for (auto& tc : test_cases)
+  {
+    EXPECT_EQ(opcode_profile_count(&profile, tc.ops.data(), tc.ops.size()), tc.count)
+      << opcode_to_string(tc.ops[0]) << " " << opcode_to_string(tc.ops[1]);
+  }
+}
+
+/// the inline cache of the `index`th call site compiled into `chunk`
+static const Call_Cache *chunk_call_cache(const Chunk *chunk, std::size_t index)
+{
+  EXPECT_LT(index, chunk->call_caches.len);
+  return &chunk->call_caches.elems[index];
+}
+
+TEST(VMTestSuite, Test_Call_Global_Inline_Cache)
+{
+  VM_Run run = run_source(
+    "var f = func(x) { return x + 1; }; var i = 0; var n = 0;"
+    "while (i < 10) { n = f(n); i = i + 1; } println(n);"
+  );
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "10\n");
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_CALL_GLOBAL));
+
+  const Call_Cache *cache = chunk_call_cache(&run.chunk, 0);
+  EXPECT_EQ(cache->len, 1);
+  EXPECT_EQ(cache->entries[0], chunk_function_constant(&run.chunk, "f"));
+  EXPECT_EQ(cache->version, 0);
+}
+
+TEST(VMTestSuite, Test_Call_Global_Cache_Invalidated_By_Redefinition)
+{
+  // NOTE(HS): the same call site calls `f` before and after it's reassigned
+  VM_Run run = run_source(
+    "var f = func() { return 1; }; var g = func() { return 2; }; var i = 0;"
+    "while (i < 4) { println(f()); if (i == 1) { f = g; } i = i + 1; }"
+  );
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "1\n1\n2\n2\n");
+
+  const Call_Cache *cache = chunk_call_cache(&run.chunk, 0);
+  EXPECT_EQ(cache->len, 1);
+  EXPECT_EQ(cache->entries[0], chunk_function_constant(&run.chunk, "g"));
+  EXPECT_EQ(cache->version, 1);
+}
+
+TEST(VMTestSuite, Test_Call_Global_Cache_Not_Invalidated_By_Other_Globals)
+{
+  VM_Run run = run_source(
+    "var f = func(x) { return x; }; var i = 0;"
+    "while (i < 3) { f(i); i = i + 1; }"
+  );
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE);
+  const Call_Cache *cache = chunk_call_cache(&run.chunk, 0);
+  EXPECT_EQ(cache->len, 1);
+  EXPECT_EQ(cache->version, 0);
+}
+
+TEST(VMTestSuite, Test_Call_Inline_Cache_Polymorphic)
+{
+  struct Cache_Test
+  {
+    const char *input;
+    const char *output;
+    std::size_t len;
+    bool megamorphic;
+  };
+
+  // NOTE(HS): `apply` calls its argument through a local, so its call site sees every
+  // function passed to it. The call is in tail position, tail calls share `CALL`'s cache.
+  std::vector<Cache_Test> test_cases{
+    {
+      "var apply = func(f) { return f(); };"
+      "var a = func() { return 1; }; println(apply(a), apply(a));",
+      "1 1\n", 1, false
+    },
+    {
+      "var apply = func(f) { return f(); };"
+      "var a = func() { return 1; }; var b = func() { return 2; };"
+      "println(apply(a), apply(b), apply(a));",
+      "1 2 1\n", 2, false
+    },
+    {
+      "var apply = func(f) { return f(); };"
+      "println(apply(func() { return 1; }), apply(func() { return 2; }), apply(func() { return 3; }),"
+      "  apply(func() { return 4; }), apply(func() { return 5; }), apply(func() { return 6; }));",
+      "1 2 3 4 5 6\n", CALL_CACHE_ENTRIES, true
+    },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    VM_Run run = run_source(tc.input);
+    DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+    ASSERT_EQ(run.err.kind, TYERR_NONE) << tc.input;
+    EXPECT_EQ(run.output, std::string{tc.output}) << tc.input;
+
+    const Obj_Function *apply = chunk_function_constant(&run.chunk, "apply");
+    ASSERT_NE(apply, nullptr);
+    ASSERT_TRUE(chunk_contains(&apply->chunk, OPC_TAIL_CALL)) << tc.input;
+
+    const Call_Cache *cache = chunk_call_cache(&apply->chunk, 0);
+    EXPECT_EQ(cache->len, tc.len) << tc.input;
+    EXPECT_EQ(cache->megamorphic, tc.megamorphic) << tc.input;
+  }
+}
+
+TEST(VMTestSuite, Test_Call_Cache_Reset_Between_VMs)
+{
+  VM_Run run = run_source(
+    "var f = func() { return 1; }; var g = func() { return 2; };"
+    "println(f()); f = g; println(f());",
+    true, 2
+  );
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "1\n2\n");
+}
+
+TEST(VMTestSuite, Test_Builtin_Arity_Checked_At_Compile_Time)
+{
+  SETUP_PARSER_TEST_CASE("len(\"a\", \"b\");");
+  EXPECT_PROGRAM_PARSED_SUCCESS(p);
+
+  Resolver resolver;
+  resolver_init(&resolver);
+  resolver_resolve_program(&resolver, (Program*) &p);
+
+  Chunk chunk;
+  chunk_init(&chunk);
+  Tyger_Error err = compiler_compile_program(&p, &chunk, compiler_default_options());
+  DEFER({
+      tyger_error_free((Tyger_Error*) &err);
+      chunk_free((Chunk*) &chunk);
+      resolver_free((Resolver*) &resolver);
+      program_free((Program*) &p);
+  });
+
+  EXPECT_EQ(err.kind, TYERR_ARITY_MISMATCH);
+  EXPECT_EQ(err.location.pos, 0);
+}
+
+TEST(VMTestSuite, Test_Builtin_Values_Are_Compile_Errors)
+{
+  const char *inputs[] = {
+    "println(println);",
+    "var x = println;",
+    "len + 1;",
+    "if (println) {}",
+  };
+  for (const char *input : inputs)
+  {
+    SETUP_PARSER_TEST_CASE(input);
+    EXPECT_PROGRAM_PARSED_SUCCESS(p);
+
+    Resolver resolver;
+    resolver_init(&resolver);
+    resolver_resolve_program(&resolver, (Program*) &p);
+
+    Chunk chunk;
+    chunk_init(&chunk);
+    Tyger_Error err = compiler_compile_program(&p, &chunk, compiler_default_options());
+    EXPECT_EQ(err.kind, TYERR_SYNTAX) << input;
+    EXPECT_STREQ(err.message, "builtin functions can only be called") << input;
+
+    tyger_error_free(&err);
+    chunk_free(&chunk);
+    resolver_free(&resolver);
+    program_free(&p);
+  }
+}
+
+TEST(VMTestSuite, Test_Builtin_Calls_Compile_To_Native_Calls)
+{
+  VM_Run run = run_source("println(len(\"ab\"));");
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE);
+  EXPECT_EQ(run.output, "2\n");
+
+  std::vector<Opcode> expected{
+    OPC_LOAD_CONST, OPC_CALL_NATIVE, OPC_CALL_NATIVE, OPC_POP, OPC_LOAD_NIL, OPC_RETURN,
+  };
+  EXPECT_EQ(chunk_opcodes(&run.chunk), expected);
+}
+
+TEST(VMTestSuite, Test_Garbage_Collected_While_Running)
+{
+  const char *input =
+    "var keep = \"\";"
+    "var i = 0;"
+    "while (i < 20000) {"
+    "  var s = \"abcdefghijklmnopqrstuvwx\" + \"ABCDEFGHIJKLMNOPQRSTUVWX\";"
+    "  if (i == 10000) { keep = s + \"!\"; }"
+    "  i = i + 1;"
+    "}"
+    "println(keep, len(keep));";
+
+  Gc_Options options = gc_default_options();
+  options.initial_threshold = 4096;
+  VM_Run run = run_source(input, true, 1, true, nullptr, &options);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "abcdefghijklmnopqrstuvwxABCDEFGHIJKLMNOPQRSTUVWX! 49\n");
+
+  Gc_Stats stats = run.gc_stats;
+  EXPECT_GT(stats.cycles, 0);
+  EXPECT_GT(stats.objects_freed, 19000);
+  EXPECT_LT(stats.heap_bytes, 16 * 1024);
+  EXPECT_EQ(stats.bytes_allocated - stats.bytes_freed, stats.heap_bytes);
+}
+
+TEST(VMTestSuite, Test_Short_And_Interned_Strings_Share_Storage)
+{
+  const char *input =
+    "var i = 0;"
+    "var same = true;"
+    "while (i < 1000) {"
+    "  var tag = \"ab\" + \"cd\";"
+    "  var key = \"key-\" + \"abcdefgh\";"
+    "  same = same == (key == \"key-abcdefgh\") == (tag == \"abcd\");"
+    "  i = i + 1;"
+    "}"
+    "println(same, type(i), type(\"abcdefgh\" + \"i\"));";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "true int string\n");
+
+  // NOTE(HS): "abcd" and every type name fit in a value, "key-abcdefgh" and
+  // "abcdefghi" are interned once each
+  EXPECT_EQ(run.gc_stats.heap_objects, 2);
+  EXPECT_EQ(run.gc_stats.interned_strings, 2);
+}
+
+TEST(VMTestSuite, Test_Appending_In_A_Loop_Builds_A_Rope)
+{
+  const char *input =
+    "var report = \"\";"
+    "var i = 0;"
+    "while (i < 20000) {"
+    "  report = report + \"line of the report\\n\";"
+    "  i = i + 1;"
+    "}"
+    "println(len(report), report == report + \"\");";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "380000 true\n");
+}
+
+TEST(VMTestSuite, Test_Closures_Capture_Each_Iteration)
+{
+  const char *input =
+    "var first = 0; var second = 0;"
+    "{"
+    "  var i = 0;"
+    "  while (i < 2) {"
+    "    var j = i * 10;"
+    "    var f = func() { return j; };"
+    "    if (i == 0) { first = f; } else { second = f; }"
+    "    i = i + 1;"
+    "  }"
+    "}"
+    "println(first(), second());";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "0 10\n");
+  EXPECT_TRUE(chunk_contains(&run.chunk, OPC_CLOSE_UPVALUES));
+}
+
+TEST(VMTestSuite, Test_Functions_Without_Captures_Allocate_Nothing)
+{
+  const char *input =
+    "var twice = func(x) { var g = func(y) { return y * 2; }; return g(x); };"
+    "println(twice(4));";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "8\n");
+  EXPECT_EQ(run.gc_stats.bytes_allocated, 0);
+}
+
+TEST(VMTestSuite, Test_Closures_Collected_While_Running)
+{
+  const char *input =
+    "var mk = func(n) { return func() { return n; }; };"
+    "var keep = 0;"
+    "var i = 0;"
+    "while (i < 20000) {"
+    "  var f = mk(i);"
+    "  if (i == 1234) { keep = f; }"
+    "  i = i + 1;"
+    "}"
+    "println(keep());";
+
+  Gc_Options options = gc_default_options();
+  options.initial_threshold = 4096;
+  VM_Run run = run_source(input, true, 1, true, nullptr, &options);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "1234\n");
+
+  // NOTE(HS): every call to `mk` makes a closure and one upvalue, only `keep`'s survive
+  Gc_Stats stats = run.gc_stats;
+  EXPECT_GT(stats.cycles, 0);
+  EXPECT_GT(stats.objects_freed, 39000);
+  EXPECT_EQ(stats.bytes_allocated - stats.bytes_freed, stats.heap_bytes);
+}
+
+TEST(VMTestSuite, Test_Recursion_Grows_Stack)
+{
+  const char *input =
+    "var sum = func(n) { if (n == 0) { return 0; } return n + sum(n - 1); };"
+    "println(sum(100000));";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "5000050000\n");
+  EXPECT_GE(run.frame_capacity, 100001);
+  EXPECT_GT(run.stack_capacity, VM_STACK_INITIAL);
+}
+
+TEST(VMTestSuite, Test_Open_Upvalues_Follow_Stack)
+{
+  // NOTE(HS): `x` is captured but still on the stack whilst `deep` moves the stack
+  const char *input =
+    "var deep = func(n) { if (n == 0) { return 0; } return 1 + deep(n - 1); };"
+    "var f = func() {"
+    "  var x = 1;"
+    "  var get = func() { return x; };"
+    "  deep(10000);"
+    "  x = x + 1;"
+    "  return get();"
+    "};"
+    "println(f());";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "2\n");
+  EXPECT_GT(run.stack_capacity, VM_STACK_INITIAL);
+}
+
+TEST(VMTestSuite, Test_Calls_Reuse_Stack)
+{
+  const char *input =
+    "var fib = func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); };"
+    "println(fib(20));";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "6765\n");
+  EXPECT_EQ(run.stack_capacity, VM_STACK_INITIAL);
+  EXPECT_EQ(run.frame_capacity, VM_FRAMES_INITIAL);
+  EXPECT_EQ(run.gc_stats.bytes_allocated, 0);
+}
+
+TEST(VMTestSuite, Test_Tail_Calls_Reuse_Frame)
+{
+  struct Tail_Test
+  {
+    const char *input;
+    const char *output;
+  };
+
+  std::vector<Tail_Test> test_cases{
+    {
+      "var loop = func(n, acc) { if (n == 0) { return acc; } return loop(n - 1, acc + n); };"
+      "println(loop(1000000, 0));",
+      "500000500000\n"
+    },
+    {
+      "var odd = 0;"
+      "var even = func(n) { if (n == 0) { return true; } return odd(n - 1); };"
+      "odd = func(n) { if (n == 0) { return false; } return even(n - 1); };"
+      "println(even(100001), odd(100001));",
+      "false true\n"
+    },
+    {
+      "var count = func(n) {"
+      "  var step = func(k) { if (k == 0) { return \"done\"; } return step(k - 1); };"
+      "  return step(n);"
+      "};"
+      "println(count(100000));",
+      "done\n"
+    },
+    // NOTE(HS): `x` has to be closed before the tail call overwrites `g`'s frame
+    {
+      "var id = func(f) { return f; };"
+      "var g = func(x) { var h = func() { return x; }; return id(h); };"
+      "println(g(5)());",
+      "5\n"
+    },
+    {
+      "var g = func(s) { return len(s); };"
+      "println(g(\"abc\"));",
+      "3\n"
+    },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    VM_Run run = run_source(tc.input);
+    DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+    ASSERT_EQ(run.err.kind, TYERR_NONE) << tc.input << (run.err.message ? run.err.message : "");
+    EXPECT_EQ(run.output, std::string{tc.output}) << tc.input;
+    EXPECT_EQ(run.stack_capacity, VM_STACK_INITIAL) << tc.input;
+    EXPECT_EQ(run.frame_capacity, VM_FRAMES_INITIAL) << tc.input;
+  }
+}
+
+TEST(VMTestSuite, Test_Running_Closure_Survives_Reassignment)
+{
+  // NOTE(HS): once `f` is reassigned the running closure is only held by its frame
+  const char *input =
+    "var f = 0;"
+    "var mk = func(n) {"
+    "  return func() { f = 0; var j = 0; while (j < 5000) { mk(j); j = j + 1; } return n; };"
+    "};"
+    "f = mk(7);"
+    "println(f());";
+
+  Gc_Options options = gc_default_options();
+  options.initial_threshold = 1024;
+  VM_Run run = run_source(input, true, 1, true, nullptr, &options);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "7\n");
+  EXPECT_GT(run.gc_stats.cycles, 0);
+}
+
+TEST(VMTestSuite, Test_Memo_Caches_Results)
+{
+  struct Memo_Test
+  {
+    const char *input;
+    const char *output;
+    const char *stats;
+  };
+
+  std::vector<Memo_Test> test_cases{
+    {
+      "var fib = @memo func(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); };"
+      "println(fib(90));",
+      "2880067194370816120\n",
+      "88 91 0 fib\n"
+    },
+    // NOTE(HS): every call of a tail recursive chain has the same result, so each
+    // gets an entry even though they share a frame
+    {
+      "var fact = @memo func(n, acc) { if (n == 0) { return acc; } return fact(n - 1, acc * n); };"
+      "println(fact(20, 1), fact(20, 1), fact(5, 2432902008176640000 / 120));",
+      "2432902008176640000 2432902008176640000 2432902008176640000\n",
+      "2 21 0 fact\n"
+    },
+    {
+      "var sq = func(x) { return x * x; };"
+      "var f = @memo func(x, y) { return sq(x) + y; };"
+      "var g = @memo func(s) { return len(s); };"
+      "println(f(1, 2), f(2, 1), f(1, 2), g(\"a\"), g(\"a\" + \"\"), g(\"b\"));",
+      "3 5 3 1 1 1\n",
+      "1 2 0 f\n1 2 0 g\n"
+    },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    VM_Run run = run_source(tc.input);
+    DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+    ASSERT_EQ(run.err.kind, TYERR_NONE) << tc.input << (run.err.message ? run.err.message : "");
+    EXPECT_EQ(run.output, std::string{tc.output}) << tc.input;
+    EXPECT_EQ(run.memo_stats, std::string{tc.stats}) << tc.input;
+  }
+}
+
+TEST(VMTestSuite, Test_Memo_Evicts_Least_Recently_Used)
+{
+  const char *input =
+    "var sq = @memo func(x) { return x * x; };"
+    "println(sq(1), sq(2), sq(1), sq(3), sq(1), sq(2));";
+
+  VM_Run run = run_source(input, true, 1, true, nullptr, nullptr, 2);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "1 4 1 9 1 4\n");
+  // NOTE(HS): `sq(3)` evicts 2 rather than 1, which was used more recently
+  EXPECT_EQ(run.memo_stats, "2 4 2 sq\n");
+}
+
+TEST(VMTestSuite, Test_Memo_Tail_Calls_Reuse_Frame)
+{
+  // NOTE(HS): the chain of pending entries is longer than the cache, so the entries of
+  // the outermost calls are evicted before they return and the second call misses too
+  const char *input =
+    "var loop = @memo func(n, acc) { if (n == 0) { return acc; } return loop(n - 1, acc + n); };"
+    "println(loop(100000, 0), loop(100000, 0), loop(1, 5000049999));";
+
+  VM_Run run = run_source(input, true, 1, true, nullptr, nullptr, 1000);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "5000050000 5000050000 5000050000\n");
+  EXPECT_EQ(run.stack_capacity, VM_STACK_INITIAL);
+  EXPECT_EQ(run.frame_capacity, VM_FRAMES_INITIAL);
+  EXPECT_EQ(run.memo_stats, "1 200002 199002 loop\n") << "`loop(1, 5000049999)` is still cached";
+}
+
+TEST(VMTestSuite, Test_Memo_Entries_Survive_Collection)
+{
+  // NOTE(HS): the keys and results are long strings only the cache refers to once
+  // each call returns
+  const char *input =
+    "var wrap = @memo func(s) { return \"<\" + s + \">\"; };"
+    "var i = 0;"
+    "var total = 0;"
+    "while (i < 2000) {"
+    "  var key = \"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\" + \"A\";"
+    "  if (i > 999) { key = \"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\" + \"B\"; }"
+    "  total = total + len(wrap(key));"
+    "  i = i + 1;"
+    "}"
+    "println(total, wrap(\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\" + \"A\"));";
+
+  Gc_Options options = gc_default_options();
+  options.initial_threshold = 4096;
+  VM_Run run = run_source(input, true, 1, true, nullptr, &options);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  ASSERT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+  EXPECT_EQ(run.output, "110000 <abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzA>\n");
+  EXPECT_GT(run.gc_stats.cycles, 0);
+  EXPECT_EQ(run.memo_stats, "1999 2 0 wrap\n");
+}
+
+TEST(VMTestSuite, Test_Memo_Call_Cut_Short_By_Error)
+{
+  const char *input =
+    "var f = @memo func(x) { return x / 0; };"
+    "f(1);";
+
+  VM_Run run = run_source(input);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+
+  EXPECT_NE(run.err.kind, TYERR_NONE);
+  tyger_error_free(&run.err);
+  EXPECT_EQ(run.memo_stats, "0 1 0 f\n");
+}
+
+/// runs `input` compiling every chunk on its first call or loop iteration, and again
+/// with the JIT turned off
+static std::pair<VM_Run, VM_Run> run_source_jit(const char *input)
+{
+  VM_Run jitted = run_source(input, true, 1, true, nullptr, nullptr, MEMO_DEFAULT_CAPACITY, true, 1);
+  VM_Run interpreted = run_source(input, true, 1, true, nullptr, nullptr, MEMO_DEFAULT_CAPACITY, false);
+  return { jitted, interpreted };
+}
+
+TEST(VMTestSuite, Test_Jit_Matches_Interpreter)
+{
+  std::vector<const char *> test_cases{
+    "var i = 0; var s = 0; while (i < 5000) { s = s + i * i - i / 3; i = i + 1; } println(s);",
+    "var f = func(n) { var s = 0; var i = 0; while (i < n) { s = s + i; i = i + 1; } return s; };"
+    "println(f(1000)); println(f(5000));",
+    "var x = 1; var i = 0; while (i < 100) { x = x * 7; i = i + 1; } println(x); println(-x);",
+    "var m = 0 - 9223372036854775807 - 1; var i = 0 - 5;"
+    "while (i < 6) { if (i != 0) { println(17 / i); println(m / i); println(-(m / i)); } i = i + 1; }",
+    "var c = 0; while (c < 5) { var a = 9223372036854775807; var b = a - c; println(b + c + 1); c = c + 1; }",
+    "var i = 0; var n = 0; var b = false;"
+    "while (i < 10) { if (!b) { n = n + 1; } if (b) { n = n + 100; } b = i == 4; i = i + 1; }"
+    "println(n); println(b);",
+    "var s = \"\"; var i = 0; while (i < 20) { s = s + \"ab\"; i = i + 1; } println(len(s));",
+    "var sq = func(x) { return x * x; }; var i = 0; var t = 0;"
+    "while (i < 100) { t = t + sq(i); i = i + 1; } println(t);",
+    "var f = func() { var t = 0; var i = 0;"
+    "  while (i < 30) { var j = 0; while (j < i) { var k = j * 2; t = t + k; j = j + 1; } i = i + 1; }"
+    "  return t; };"
+    "println(f());",
+    "var f = func(n) { var i = 0; var last = 0;"
+    "  while (i < n) { var k = i; last = func() { return k; }; i = i + 1; } return last; };"
+    "println(f(10)());",
+    "var i = 0; var c = 0;"
+    "while (i < 10) { if (\"a\" == \"a\") { c = c + 1; } if (i == true) { c = c + 100; } i = i + 1; }"
+    "println(c);",
+    "var g = func(n) { var i = n; var a = 0; while (0 < i) { var t = i - 1; i = t; a = a - t; } return a; };"
+    "println(g(10)); println(g(0));",
+    "var i = 0; while (i < 10) { i = i + 1; if (i == 5) { i = i + true; } }",
+    "var i = 10; var r = 0; while (i > 0 - 3) { r = r + 100 / i; i = i - 1; } println(r);",
+  };
+
+  for (auto input : test_cases)
+  {
+    auto runs = run_source_jit(input);
+    VM_Run& jitted = runs.first;
+    VM_Run& interpreted = runs.second;
+    DEFER({
+        chunk_free((Chunk*) &jitted.chunk);
+        chunk_free((Chunk*) &interpreted.chunk);
+        tyger_error_free((Tyger_Error*) &jitted.err);
+        tyger_error_free((Tyger_Error*) &interpreted.err);
+    });
+
+    EXPECT_EQ(jitted.output, interpreted.output) << input;
+    EXPECT_EQ(jitted.err.kind, interpreted.err.kind) << input;
+    if (jitted.err.kind != TYERR_NONE && interpreted.err.kind != TYERR_NONE)
+    {
+      EXPECT_STREQ(jitted.err.message, interpreted.err.message) << input;
+      EXPECT_EQ(jitted.err.location.pos, interpreted.err.location.pos) << input;
+    }
+  }
+}
+
+TEST(VMTestSuite, Test_Jit_Compiles_Hot_Loops)
+{
+  if (!JIT_SUPPORTED)
+  {
+    GTEST_SKIP() << "no JIT for this target";
+  }
+
+  const char *input =
+    "var f = func(n) { var s = 0; var i = 0; while (i < n) { s = s + i; i = i + 1; } return s; };"
+    "var g = func(n) { return n + 1; };"
+    "var i = 0; while (i < 10) { f(3); g(i); i = i + 1; }";
+
+  VM_Run run = run_source(input, true, 1, true, nullptr, nullptr, MEMO_DEFAULT_CAPACITY, true, 5);
+  DEFER({ chunk_free((Chunk*) &run.chunk); });
+  ASSERT_EQ(run.err.kind, TYERR_NONE);
+
+  const Obj_Function *f = chunk_function_constant(&run.chunk, "f");
+  const Obj_Function *g = chunk_function_constant(&run.chunk, "g");
+  EXPECT_NE(run.chunk.jit, nullptr);
+  EXPECT_NE(f->chunk.jit, nullptr);
+  EXPECT_EQ(f->chunk.jit_hotness, 5);
+
+  // NOTE(HS): code without loops is left to the interpreter
+  EXPECT_EQ(g->chunk.jit, nullptr);
+  EXPECT_TRUE(g->chunk.jit_disabled);
+}
+
+TEST(VMTestSuite, Test_Jit_Discards_Code_Whose_Guards_Fail)
+{
+  if (!JIT_SUPPORTED)
+  {
+    GTEST_SKIP() << "no JIT for this target";
+  }
+
+  // NOTE(HS): `f` is compiled for ints, then only ever called with strings
+  const char *input =
+    "var f = func(x) { var i = 0; while (i < 3) { x = x + x; i = i + 1; } return x; };"
+    "f(1);"
+    "var j = 0; while (j < 100) { f(\"ab\"); j = j + 1; }"
+    "println(f(\"a\"));";
+
+  auto runs = run_source_jit(input);
+  VM_Run& jitted = runs.first;
+  VM_Run& interpreted = runs.second;
+  DEFER({
+      chunk_free((Chunk*) &jitted.chunk);
+      chunk_free((Chunk*) &interpreted.chunk);
+  });
+
+  ASSERT_EQ(jitted.err.kind, TYERR_NONE);
+  EXPECT_EQ(jitted.output, "aaaaaaaa\n");
+  EXPECT_EQ(jitted.output, interpreted.output);
+
+  const Obj_Function *f = chunk_function_constant(&jitted.chunk, "f");
+  EXPECT_EQ(f->chunk.jit, nullptr);
+  EXPECT_TRUE(f->chunk.jit_disabled);
+}
+
+TEST(VMTestSuite, Test_Lazy_Functions_Compile_On_First_Call)
+{
+  Runner_Options options = runner_default_options();
+  options.lazy_functions = true;
+  options.no_jit = true;
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  // NOTE(HS): the source is overwritten between runs, as the REPL's input buffer is
+  char source[256];
+  std::snprintf(
+    source, sizeof(source), "%s",
+    "var broken = func() { return 1 + ; };\n"
+    "var sq = func(x) { return x * x; };\n"
+    "var twice = func(f, x) { return f(f(x)); };\n"
+    "println(twice(sq, 3));\n"
+  );
+  EXPECT_TRUE(runner_run_source(&r, source));
+  ASSERT_EQ(r.chunks.len, 1);
+  const Chunk *chunk = &r.chunks.elems[0];
+  const Obj_Function *broken = chunk_function_constant(chunk, "broken");
+  const Obj_Function *sq = chunk_function_constant(chunk, "sq");
+  EXPECT_NE(broken->lazy_source, nullptr);
+  EXPECT_EQ(broken->chunk.code.len, 0);
+  EXPECT_EQ(sq->lazy_source, nullptr);
+  EXPECT_GT(sq->chunk.code.len, 0);
+
+  std::snprintf(source, sizeof(source), "%s", "println(sq(5));");
+  EXPECT_TRUE(runner_run_source(&r, source));
+  std::snprintf(source, sizeof(source), "%s", "broken();");
+  EXPECT_FALSE(runner_run_source(&r, source));
+  EXPECT_NE(broken->lazy_source, nullptr);
+
+  runner_free(&r);
+  EXPECT_EQ(read_all(out), "81\n25\n");
+  std::fclose(out);
+}
+
+/// runs `source` through a runner, returning whether it succeeded and its output
+TEST(VMTestSuite, Test_Failed_Input_Leaves_Redeclared_Globals_Alone)
+{
+  Runner r;
+  runner_init(&r, "<test>", runner_default_options());
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+  char source[256];
+  std::snprintf(source, sizeof(source), "%s", "var x = 1;");
+  EXPECT_TRUE(runner_run_source(&r, source));
+  std::snprintf(source, sizeof(source), "%s", "const x = 2; println(nope);");
+  EXPECT_FALSE(runner_run_source(&r, source));
+  std::snprintf(source, sizeof(source), "%s", "x = 3;");
+  EXPECT_TRUE(runner_run_source(&r, source));
+  std::snprintf(source, sizeof(source), "%s", "println(x);");
+  EXPECT_TRUE(runner_run_source(&r, source));
+
+  runner_free(&r);
+  EXPECT_EQ(read_all(out), "3\n");
+  std::fclose(out);
+}
+
+static std::pair<bool, std::string> run_with_runner(const char *source, Runner_Options options)
+{
+  Runner r;
+  runner_init(&r, "<test>", options);
+  FILE *out = std::tmpfile();
+  vm_set_output(&r.vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+  bool ok = runner_run_source(&r, source);
+  runner_free(&r);
+  std::string output = read_all(out);
+  std::fclose(out);
+  return { ok, output };
+}
+
+TEST(VMTestSuite, Test_Lazy_Functions_Match_Eager_Ones)
+{
+  struct Parity_Test
+  {
+    const char *input;
+    bool ok;
+    const char *output;
+  };
+
+  std::vector<Parity_Test> test_cases{
+    { "var f = (func() { return 1; }); println(f());", true, "1\n" },
+    { "println((func() { return 2; })());", true, "2\n" },
+    { "var g = ((func(x) { return x * 3; })); println(g(4));", true, "12\n" },
+
+    // NOTE(HS): bodies only see the globals declared before them, however late they're
+    // compiled
+    { "var f = func() { return y; }; println(f()); var y = 1;", false, "" },
+    {
+      "var even = func(n) { if (n == 0) { return true; } return odd(n - 1); };\n"
+      "var odd = func(n) { if (n == 0) { return false; } return even(n - 1); };\n"
+      "println(even(4));",
+      false, ""
+    },
+    { "var h = func() { return len(\"ab\"); }; var len = 5; println(h());", true, "2\n" },
+    { "var k = func() { return k; }; println(k() == k);", true, "true\n" },
+  };
+
+  for (auto& tc : test_cases)
+  {
+    Runner_Options options = runner_default_options();
+    std::pair<bool, std::string> eager = run_with_runner(tc.input, options);
+    options.lazy_functions = true;
+    std::pair<bool, std::string> lazy = run_with_runner(tc.input, options);
+
+    EXPECT_EQ(eager.first, tc.ok) << tc.input;
+    EXPECT_EQ(eager.second, tc.output) << tc.input;
+    EXPECT_EQ(lazy, eager) << tc.input;
+  }
+}
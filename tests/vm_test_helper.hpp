@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "parser_test_helper.hpp"
+
+/// result of compiling and running a snippet, the chunk is kept so tests can inspect
+/// how it was rewritten by quickening
+struct VM_Run
+{
+  Tyger_Error err;
+  std::string output;
+  Chunk chunk;
+  Gc_Stats gc_stats;
+  size_t stack_capacity;
+  size_t frame_capacity;
+
+  /// see `memo_table_write_stats`
+  std::string memo_stats;
+};
+
+/// everything written to `f`, which is rewound first
+inline std::string read_all(FILE *f)
+{
+  std::string out{};
+  std::rewind(f);
+  int c;
+  while ((c = std::fgetc(f)) != EOF)
+  {
+    out.push_back((char) c);
+  }
+  return out;
+}
+
+/// parses, resolves and compiles `input` into `chunk`, returning any error compiling it
+/// (which belongs to the caller)
+inline Tyger_Error compile_source(const char *input, Chunk *chunk, Compiler_Options options)
+{
+  SETUP_PARSER_TEST_CASE(input);
+  EXPECT_PROGRAM_PARSED_SUCCESS(p);
+
+  Resolver resolver;
+  resolver_init(&resolver);
+  resolver_resolve_program(&resolver, &p);
+  EXPECT_EQ(p.errors.len, 0);
+
+  Tyger_Error err = compiler_compile_program(&p, chunk, options);
+  resolver_free(&resolver);
+  program_free(&p);
+  return err;
+}
+
+/// compiles and runs `input` `runs` times against the same chunk, returning the output
+/// of the final run. The chunk and error belong to the caller.
+inline VM_Run run_source(
+  const char *input, bool quicken = true, int runs = 1, bool superinstructions = true,
+  Opcode_Profile *profile = nullptr, const Gc_Options *gc_options = nullptr,
+  std::size_t memo_capacity = MEMO_DEFAULT_CAPACITY, bool jit = true,
+  std::uint32_t jit_threshold = JIT_DEFAULT_THRESHOLD, bool optimise = false
+)
+{
+  VM_Run run{};
+  chunk_init(&run.chunk);
+
+  Compiler_Options options = compiler_default_options();
+  options.superinstructions = superinstructions;
+  options.optimise = optimise;
+  run.err = compile_source(input, &run.chunk, options);
+  EXPECT_EQ(run.err.kind, TYERR_NONE) << (run.err.message ? run.err.message : "");
+
+  for (int i = 0; i < runs && run.err.kind == TYERR_NONE; ++i)
+  {
+    VM vm;
+    vm_init(&vm);
+    vm.quicken = quicken;
+    vm.profile = profile;
+    vm.memo_capacity = memo_capacity;
+    vm.jit = vm.jit && jit;
+    vm.jit_threshold = jit_threshold;
+    if (gc_options)
+    {
+      gc_set_options(&vm.gc, *gc_options);
+    }
+    FILE *out = std::tmpfile();
+    vm_set_output(&vm, fileno(out), OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+
+    run.err = vm_run(&vm, &run.chunk);
+    run.output = read_all(out);
+    run.gc_stats = gc_get_stats(&vm.gc);
+    run.stack_capacity = vm.stack_capacity;
+    run.frame_capacity = vm.frame_capacity;
+
+    FILE *stats = std::tmpfile();
+    memo_table_write_stats(&vm.memo, stats);
+    run.memo_stats = read_all(stats);
+    std::fclose(stats);
+
+    vm_free(&vm);
+    std::fclose(out);
+  }
+
+  return run;
+}
+
+/// the function constant of `chunk` named `name`
+inline const Obj_Function *chunk_function_constant(const Chunk *chunk, const char *name)
+{
+  for (std::size_t i = 0; i < chunk->constants.len; ++i)
+  {
+    Value v = chunk->constants.elems[i];
+    if (value_is_function(v) && value_as_function(v)->name &&
+        std::string{value_as_function(v)->name->chars} == name)
+    {
+      return value_as_function(v);
+    }
+  }
+  ADD_FAILURE() << "no function constant " << name;
+  return nullptr;
+}